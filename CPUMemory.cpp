@@ -59,6 +59,11 @@ char* CPUMemory::GetHandlePtr(AllocHandle handle)
 	return FindHandleAlloc(allocs, handle, &ndx).destPtr;
 }
 
+uint64_t CPUMemory::BytesAvailable()
+{
+	return initAlloc - clientDataOffset - memUsed;
+}
+
 void CPUMemory::ZeroData(AllocHandle handle, uint64_t size)
 {
 	memset(CPUMemory::GetHandlePtr<void>(handle), 0, size);
@@ -220,8 +225,8 @@ void RemoveAlloc(AllocBuffer* allocs, uint32_t ndx, CPUMemory::AllocHandle handl
 			std::swap(allocs->allocSet[i], allocs->allocSet[i + 1]);
 		}
 
-		// Update handles
-		for (uint32_t i = (ndx + 1); i < allocs->numAllocs; i++)
+		// Update handles (shifted allocs now sit in [ndx, numAllocs - 1); the freed alloc is bubbled past them, and its handle stays empty)
+		for (uint32_t i = ndx; i < (allocs->numAllocs - 1); i++)
 		{
 			(*allocs->allocSet[i].internalHandle)--;
 		}
@@ -1,10 +1,12 @@
 #pragma once
 
+#include <stddef.h>
 #include <stdint.h>
 #include <type_traits>
 #include <concepts>
 #include <assert.h>
 #include <limits>
+#include <string.h>
 
 #undef min
 #undef max
@@ -238,6 +240,9 @@ class CPUMemory
 		static void Init();
 		static void DeInit();
 
+		// Bytes left for allocations: the pool less its scratch + bookkeeping, and everything allocated so far
+		static uint64_t BytesAvailable();
+
 	private:
 		static void Free(AllocHandle handle);
 	public:
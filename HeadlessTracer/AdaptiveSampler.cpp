@@ -0,0 +1,80 @@
+#include "AdaptiveSampler.h"
+#include "ProgressiveFilm.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
+void AdaptiveSampler::Init(uint32_t filmWidth, uint32_t filmHeight, uint32_t tileSizePx)
+{
+	width = filmWidth;
+	height = filmHeight;
+	tileSize = tileSizePx;
+	tilesX = (width + tileSize - 1) / tileSize;
+	tilesY = (height + tileSize - 1) / tileSize;
+	tileErrors = CPUMemory::AllocateArray<double>(static_cast<uint64_t>(tilesX) * tilesY);
+}
+
+void AdaptiveSampler::DeInit()
+{
+	CPUMemory::Free(tileErrors);
+}
+
+uint64_t AdaptiveSampler::Plan(const ProgressiveFilm& film, uint64_t budget, uint32_t maxPixelSamples, CPUMemory::ArrayAllocHandle<uint32_t> outPixelSamples)
+{
+	// Nothing allocates while planning, so the arrays are resolved once
+	assert(outPixelSamples.arrayLen == static_cast<uint64_t>(width) * height);
+	uint32_t* pixelSamples = &outPixelSamples[0];
+	double* errors = &tileErrors[0];
+
+	double totalError = 0.0;
+	for (uint32_t t = 0; t < tilesX * tilesY; t++)
+	{
+		const uint32_t x0 = (t % tilesX) * tileSize, y0 = (t / tilesX) * tileSize;
+		double error = 0.0;
+		for (uint32_t y = y0; y < std::min(y0 + tileSize, height); y++)
+		{
+			for (uint32_t x = x0; x < std::min(x0 + tileSize, width); x++)
+			{
+				error += film.Estimate(y * width + x).RelativeVariance();
+			}
+		}
+		errors[t] = error;
+		totalError += error;
+	}
+
+	// Shares are handed out in row-major tile order, carrying the fractions left over from each tile into the next, so the plan spends
+	// the whole budget (caps aside) and doesn't depend on anything but the film
+	const double evenError = evenShare * totalError / (tilesX * tilesY);
+	const double weightSum = totalError + evenError * tilesX * tilesY;
+	double carried = 0.0;
+	uint64_t planned = 0;
+	for (uint32_t t = 0; t < tilesX * tilesY; t++)
+	{
+		const uint32_t x0 = (t % tilesX) * tileSize, y0 = (t / tilesX) * tileSize;
+		const uint32_t x1 = std::min(x0 + tileSize, width), y1 = std::min(y0 + tileSize, height);
+		const uint32_t numPixels = (x1 - x0) * (y1 - y0);
+
+		// An error-free film (flat lighting, or nothing hit) spreads the budget evenly
+		const double share = (weightSum > 0.0) ? budget * (errors[t] + evenError) / weightSum : static_cast<double>(budget) / (tilesX * tilesY);
+		const double wanted = share + carried;
+		const uint64_t tileSamples = std::min(static_cast<uint64_t>(std::floor(wanted)), static_cast<uint64_t>(numPixels) * maxPixelSamples);
+		carried = wanted - static_cast<double>(tileSamples);
+		carried = std::min(carried, 1.0); // Capped tiles don't push their excess onto their neighbours
+
+		// Leftover samples go to a run of pixels starting at an offset that moves from pass to pass (the tile's first pixel's sample
+		// count), so they don't pile up in the tile's corner
+		const uint32_t perPixel = static_cast<uint32_t>(tileSamples / numPixels), extra = static_cast<uint32_t>(tileSamples % numPixels);
+		const uint32_t firstExtra = film.Estimate(y0 * width + x0).samples % numPixels;
+		uint32_t i = 0;
+		for (uint32_t y = y0; y < y1; y++)
+		{
+			for (uint32_t x = x0; x < x1; x++, i++)
+			{
+				pixelSamples[y * width + x] = perPixel + (((i + numPixels - firstExtra) % numPixels < extra) ? 1 : 0);
+			}
+		}
+		planned += tileSamples;
+	}
+	return planned;
+}
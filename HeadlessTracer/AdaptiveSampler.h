@@ -0,0 +1,33 @@
+#pragma once
+
+#include "../CPUMemory.h"
+
+#include <stdint.h>
+
+class ProgressiveFilm;
+
+// Spreads each progressive pass's samples over the image by estimated error, rather than evenly
+// - The image splits into small square tiles; each tile's error is the sum of its pixels' relative variances (their running estimates
+//   in ProgressiveFilm), and a pass's budget is shared between tiles in proportion to it (plus a small even share, so tiles whose first
+//   samples happened to agree aren't starved for good)
+// - Every pixel in a tile takes the same number of samples (give or take one, where the tile's share doesn't divide evenly), capped
+//   per pass so a few noisy tiles can't take a whole pass
+// - Plans depend only on the film, so adaptive renders are as deterministic as uniform ones: each pixel still takes its own stream's
+//   first N samples, whatever N ends up being
+class AdaptiveSampler
+{
+	public:
+		static constexpr double evenShare = 0.05; // Fraction of the mean tile error every tile gets on top of its own
+
+		void Init(uint32_t width, uint32_t height, uint32_t tileSize);
+		void DeInit();
+
+		// Fills [outPixelSamples] (one count per pixel, allocated by the caller) with about [budget] samples, at most [maxPixelSamples]
+		// per pixel; returns how many were planned (less than [budget] where tiles hit the cap)
+		uint64_t Plan(const ProgressiveFilm& film, uint64_t budget, uint32_t maxPixelSamples, CPUMemory::ArrayAllocHandle<uint32_t> outPixelSamples);
+
+	private:
+		uint32_t width = 0, height = 0, tileSize = 0;
+		uint32_t tilesX = 0, tilesY = 0;
+		CPUMemory::ArrayAllocHandle<double> tileErrors;
+};
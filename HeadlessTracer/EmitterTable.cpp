@@ -0,0 +1,116 @@
+#include "EmitterTable.h"
+
+#include <cassert>
+#include <cmath>
+
+void EmitterTable::Init(uint64_t maxEmitters)
+{
+	assert(entries.arrayLen == 0 && numEmitters == 0);
+	if (maxEmitters > 0)
+	{
+		entries = CPUMemory::AllocateArray<EmitterAliasEntry>(maxEmitters);
+	}
+}
+
+void EmitterTable::DeInit()
+{
+	// Freed in reverse, so neither allocation moves while the other's freed
+	if (triEmitters.arrayLen > 0)
+	{
+		CPUMemory::Free(triEmitters);
+	}
+	if (entries.arrayLen > 0)
+	{
+		CPUMemory::Free(entries);
+	}
+	triEmitters = {};
+	entries = {};
+	numEmitters = 0;
+}
+
+void EmitterTable::AddTriangles(const GeoTypes::Vertex3D* vts, const IndexedTriangle* tris, uint64_t firstTri, uint64_t numTris, float radiance)
+{
+	for (uint64_t i = firstTri; i < firstTri + numTris; i++)
+	{
+		const float4 p0 = vts[tris[i].xyz.x].pos, p1 = vts[tris[i].xyz.y].pos, p2 = vts[tris[i].xyz.z].pos;
+		const float e1[3] = { p1.x - p0.x, p1.y - p0.y, p1.z - p0.z };
+		const float e2[3] = { p2.x - p0.x, p2.y - p0.y, p2.z - p0.z };
+		const float n[3] = { e1[1] * e2[2] - e1[2] * e2[1], e1[2] * e2[0] - e1[0] * e2[2], e1[0] * e2[1] - e1[1] * e2[0] };
+		const float area = 0.5f * std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+		if (area > 0.0f)
+		{
+			EmitterAliasEntry entry = {};
+			entry.tri = static_cast<uint32_t>(i);
+			entry.radiance = radiance;
+			entry.area = area;
+			assert(numEmitters < entries.arrayLen);
+			entries[numEmitters++] = entry;
+		}
+	}
+}
+
+void EmitterTable::Build(Weighting weighting, uint64_t numSceneTris)
+{
+	assert(triEmitters.arrayLen == 0 && numSceneTris > 0);
+	triEmitters = CPUMemory::AllocateArray<uint32_t>(numSceneTris);
+	CPUMemory::FlushData(triEmitters); // Every byte set, so every triangle starts out UINT32_MAX
+	if (numEmitters == 0)
+	{
+		return;
+	}
+
+	// The scratch below only allocates after the table (and is freed in reverse), so nothing moves while these are held
+	EmitterAliasEntry* emitters = &entries[0];
+	uint32_t* emitterNdces = &triEmitters[0];
+	double weightSum = 0.0;
+	for (uint32_t i = 0; i < numEmitters; i++)
+	{
+		weightSum += (weighting == Weighting::Power) ? static_cast<double>(emitters[i].radiance) * emitters[i].area : 1.0;
+	}
+
+	// Vose: slots under a full share take their remainder from one over it, which then goes back on whichever list its own share now
+	// puts it on; whatever's left when either list runs out is a full share (give or take rounding), and keeps its own slot
+	// - [small] + [large] are stacks; each emitter is on at most one of them at a time
+	CPUMemory::ArrayAllocHandle<double> sharesHandle = CPUMemory::AllocateArray<double>(numEmitters);
+	CPUMemory::ArrayAllocHandle<uint32_t> smallHandle = CPUMemory::AllocateArray<uint32_t>(numEmitters);
+	CPUMemory::ArrayAllocHandle<uint32_t> largeHandle = CPUMemory::AllocateArray<uint32_t>(numEmitters);
+	double* shares = &sharesHandle[0];
+	uint32_t* small = &smallHandle[0];
+	uint32_t* large = &largeHandle[0];
+	uint32_t numSmall = 0, numLarge = 0;
+	for (uint32_t i = 0; i < numEmitters; i++)
+	{
+		const double weight = (weighting == Weighting::Power) ? static_cast<double>(emitters[i].radiance) * emitters[i].area : 1.0;
+		emitters[i].pdf = static_cast<float>(weight / weightSum);
+		emitters[i].alias = i;
+		emitters[i].threshold = 1.0f;
+		shares[i] = weight / weightSum * numEmitters;
+		(shares[i] < 1.0) ? (small[numSmall++] = i) : (large[numLarge++] = i);
+		emitterNdces[emitters[i].tri] = i;
+	}
+	while (numSmall > 0 && numLarge > 0)
+	{
+		const uint32_t under = small[--numSmall], over = large[numLarge - 1];
+		emitters[under].threshold = static_cast<float>(shares[under]);
+		emitters[under].alias = over;
+		shares[over] -= 1.0 - shares[under];
+		if (shares[over] < 1.0)
+		{
+			numLarge--;
+			small[numSmall++] = over;
+		}
+	}
+	CPUMemory::Free(largeHandle);
+	CPUMemory::Free(smallHandle);
+	CPUMemory::Free(sharesHandle);
+}
+
+double EmitterTable::Power() const
+{
+	double power = 0.0;
+	for (uint32_t i = 0; i < numEmitters; i++)
+	{
+		power += static_cast<double>(entries[i].radiance) * entries[i].area * 3.14159265358979;
+	}
+	return power;
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <stdint.h>
+#include "../CPUMemory.h"
+#include "../SandboxApp/GeoTypes.h"
+#include "../Shaders/SharedLightSampling.hlsli"
+
+// Emissive triangles for next-event estimation, extracted from the scene's light models at load, and the alias table the tracer picks
+// them through (see SharedLightSampling.hlsli)
+// - Tables are built with Vose's method: every slot holds one emitter plus, where that emitter's share falls short of a full slot, an
+//   alias topping it up, so picks are O(1) for any number of emitters
+// - Zero-area triangles aren't listed (they can't be sampled or hit), and neither is anything outside the light models
+// - [TriEmitters] maps every scene triangle to its emitter (UINT32_MAX for non-emitters), so hits can find what they hit
+// - Tables live in CPUMemory, with room for every triangle the light models hold reserved up front (zero-area ones just leave it unused)
+class EmitterTable
+{
+	public:
+		enum class Weighting
+		{
+			Uniform, // Every emitter equally likely
+			Power // In proportion to radiance * area
+		};
+
+		// Reserve room for up to [maxEmitters] emitters; tables are initialised once, before anything's added
+		void Init(uint64_t maxEmitters);
+		void DeInit();
+
+		// List triangles [firstTri, firstTri + numTris) of [tris] as emitters with [radiance]
+		void AddTriangles(const GeoTypes::Vertex3D* vts, const IndexedTriangle* tris, uint64_t firstTri, uint64_t numTris, float radiance);
+
+		// Lay the listed emitters out as an alias table, weighed by [weighting], and map the scene's [numSceneTris] triangles to them
+		void Build(Weighting weighting, uint64_t numSceneTris);
+
+		// Pointers into CPUMemory, so they're only good until something allocated before the table is freed
+		uint32_t NumEmitters() const { return numEmitters; }
+		const EmitterAliasEntry* Entries() const { return (entries.arrayLen > 0) ? &entries[0] : nullptr; }
+		const uint32_t* TriEmitters() const { return (triEmitters.arrayLen > 0) ? &triEmitters[0] : nullptr; }
+
+		// Total emitted power (radiance * area * pi, summed over every emitter)
+		double Power() const;
+
+	private:
+		CPUMemory::ArrayAllocHandle<EmitterAliasEntry> entries; // [maxEmitters] long, the first [numEmitters] listed
+		CPUMemory::ArrayAllocHandle<uint32_t> triEmitters;
+		uint32_t numEmitters = 0;
+};
@@ -0,0 +1,105 @@
+#include "ImageIO.h"
+#include "ProgressiveFilm.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstdio>
+#include <cstring>
+
+bool EndsWith(const char* str, const char* suffix)
+{
+	const size_t strLen = strlen(str), suffixLen = strlen(suffix);
+	return strLen >= suffixLen && strcmp(str + strLen - suffixLen, suffix) == 0;
+}
+
+bool WriteImage(const char* path, CPUMemory::ArrayAllocHandle<float> rgbHandle, uint32_t width, uint32_t height)
+{
+	assert(rgbHandle.arrayLen == static_cast<uint64_t>(width) * height * 3);
+	FILE* file = fopen(path, "wb");
+	if (file == nullptr)
+	{
+		return false;
+	}
+
+	if (EndsWith(path, ".ppm"))
+	{
+		fprintf(file, "P6\n%u %u\n255\n", width, height);
+		CPUMemory::ArrayAllocHandle<uint8_t> rowHandle = CPUMemory::AllocateArray<uint8_t>(width * 3);
+		const float* rgb = &rgbHandle[0];
+		uint8_t* row = &rowHandle[0];
+		for (uint32_t y = height; y > 0; y--)
+		{
+			for (uint32_t i = 0; i < width * 3; i++)
+			{
+				row[i] = static_cast<uint8_t>(std::clamp(rgb[(y - 1) * width * 3 + i], 0.0f, 1.0f) * 255.0f + 0.5f);
+			}
+			fwrite(row, 1, width * 3, file);
+		}
+		CPUMemory::Free(rowHandle);
+	}
+	else
+	{
+		// Negative scale marks little-endian data
+		fprintf(file, "PF\n%u %u\n-1.0\n", width, height);
+		fwrite(&rgbHandle[0], sizeof(float), rgbHandle.arrayLen, file);
+	}
+
+	fclose(file);
+	return true;
+}
+
+bool ReadPFM(const char* path, CPUMemory::ArrayAllocHandle<float>* outRGB, uint32_t* outWidth, uint32_t* outHeight)
+{
+	FILE* file = fopen(path, "rb");
+	if (file == nullptr)
+	{
+		return false;
+	}
+
+	char magic[3] = {};
+	float scale = 0.0f;
+	const bool headerRead = fscanf(file, "%2s %u %u %f", magic, outWidth, outHeight, &scale) == 4 && fgetc(file) != EOF;
+	bool read = false;
+	if (headerRead && strcmp(magic, "PF") == 0 && scale < 0.0f)
+	{
+		// Sizes are checked against the file before anything is allocated, so a bad header can't overrun CPUMemory's pool
+		const uint64_t numValues = static_cast<uint64_t>(*outWidth) * *outHeight * 3;
+		const long dataStart = ftell(file);
+		fseek(file, 0, SEEK_END);
+		const bool sized = dataStart >= 0 && numValues > 0 && static_cast<uint64_t>(ftell(file) - dataStart) >= numValues * sizeof(float);
+		fseek(file, dataStart, SEEK_SET);
+		if (sized)
+		{
+			*outRGB = CPUMemory::AllocateArray<float>(numValues);
+			read = fread(&(*outRGB)[0], sizeof(float), numValues, file) == numValues;
+			if (!read)
+			{
+				CPUMemory::Free(*outRGB);
+			}
+		}
+	}
+	fclose(file);
+	return read;
+}
+
+void SampleHeatmap(const ProgressiveFilm& film, bool scaled, CPUMemory::ArrayAllocHandle<float> outRGB)
+{
+	const uint32_t numPixels = film.Width() * film.Height();
+	uint32_t maxSamples = 1;
+	for (uint32_t i = 0; i < numPixels; i++)
+	{
+		maxSamples = std::max(maxSamples, film.Estimate(i).samples);
+	}
+
+	assert(outRGB.arrayLen == static_cast<uint64_t>(numPixels) * 3);
+	float* rgb = &outRGB[0];
+	for (uint32_t i = 0; i < numPixels; i++)
+	{
+		const float samples = static_cast<float>(film.Estimate(i).samples);
+		const float heat = 3.0f * samples / maxSamples;
+		for (uint32_t c = 0; c < 3; c++)
+		{
+			rgb[i * 3 + c] = scaled ? std::clamp(heat - c, 0.0f, 1.0f) : samples;
+		}
+	}
+}
@@ -0,0 +1,24 @@
+#pragma once
+
+#include "../CPUMemory.h"
+
+#include <stdint.h>
+
+class ProgressiveFilm;
+
+// Image files for the headless renderer
+// - Images hold rgb per pixel in film order (row zero is RaySetup's -y edge, presented at the bottom), as ProgressiveFilm resolves them
+// - .pfm keeps the raw film response (PFM scanlines run bottom-to-top, which is film order already); .ppm clamps it to 8 bits
+
+bool EndsWith(const char* str, const char* suffix);
+
+// Writes [rgb] ([width] * [height] pixels) as a .ppm where [path] ends in one, or as a little-endian .pfm otherwise
+bool WriteImage(const char* path, CPUMemory::ArrayAllocHandle<float> rgb, uint32_t width, uint32_t height);
+
+// Reads a little-endian colour PFM (as [WriteImage] writes them) into a new allocation at [outRGB], in film order; the caller frees it
+// (nothing is allocated when the read fails)
+bool ReadPFM(const char* path, CPUMemory::ArrayAllocHandle<float>* outRGB, uint32_t* outWidth, uint32_t* outHeight);
+
+// Sample counts per pixel as an image ([outRGB] holds three floats per pixel): raw counts (in every channel), or scaled to the largest
+// count along a black-red-yellow-white ramp
+void SampleHeatmap(const ProgressiveFilm& film, bool scaled, CPUMemory::ArrayAllocHandle<float> outRGB);
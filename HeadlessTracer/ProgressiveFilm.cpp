@@ -0,0 +1,123 @@
+#include "ProgressiveFilm.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
+// Seed one xoshiro128+ stream per pixel with splitmix64 (as the sandbox seeds its GPU streams, see Render.cpp), filling all four words
+static void SeedPixel(uint64_t seed, uint64_t pixelNdx, uint32_t outState[4])
+{
+	uint64_t state = seed ^ (pixelNdx * 0x9e3779b97f4a7c15ull);
+	for (uint32_t i = 0; i < 4; i += 2)
+	{
+		state += 0x9e3779b97f4a7c15ull;
+		uint64_t z = state;
+		z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+		z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+		z ^= z >> 31;
+		outState[i] = static_cast<uint32_t>(z);
+		outState[i + 1] = static_cast<uint32_t>(z >> 32);
+	}
+}
+
+void PixelEstimate::AddSample(const float film[3], float filterWeight)
+{
+	samples++;
+	if (filterWeight <= 0.0f)
+	{
+		return;
+	}
+
+	// [film] carries the filter weight already; the filter-weighted mean of what's left is exactly the pixel's resolved luminance
+	const double luminance = (0.2126 * film[0] + 0.7152 * film[1] + 0.0722 * film[2]) / filterWeight;
+	const double prevWeightSum = weightSum;
+	weightSum += filterWeight;
+	weightSqSum += static_cast<double>(filterWeight) * filterWeight;
+	const double delta = luminance - mean;
+	const double step = delta * filterWeight / weightSum;
+	mean += step;
+	m2 += prevWeightSum * delta * step;
+}
+
+double PixelEstimate::MeanVariance() const
+{
+	// Unbiased for reliability weights; the mean's variance then scales down by the effective sample count (weightSum^2 / weightSqSum)
+	const double denominator = weightSum - weightSqSum / std::max(weightSum, 1e-30);
+	if (samples < 2 || denominator <= 0.0)
+	{
+		return 0.0;
+	}
+	return (m2 / denominator) * (weightSqSum / (weightSum * weightSum));
+}
+
+double PixelEstimate::RelativeVariance() const
+{
+	return MeanVariance() / (mean * mean + ProgressiveFilm::relativeOffset);
+}
+
+void ProgressiveFilm::Init(uint32_t filmWidth, uint32_t filmHeight, uint64_t seed)
+{
+	width = filmWidth;
+	height = filmHeight;
+	const size_t numPixels = static_cast<size_t>(width) * height;
+	sums = CPUMemory::AllocateArray<float>(numPixels * 4);
+	prngStates = CPUMemory::AllocateArray<uint32_t>(numPixels * 4);
+	estimates = CPUMemory::AllocateArray<PixelEstimate>(numPixels);
+	CPUMemory::ZeroData(sums);
+	CPUMemory::ZeroData(estimates);
+
+	uint32_t* states = &prngStates[0];
+	for (size_t i = 0; i < numPixels; i++)
+	{
+		SeedPixel(seed, i, &states[i * 4]);
+	}
+}
+
+void ProgressiveFilm::DeInit()
+{
+	CPUMemory::Free(estimates);
+	CPUMemory::Free(prngStates);
+	CPUMemory::Free(sums);
+}
+
+void ProgressiveFilm::AddSample(uint32_t pixelNdx, const float sampleSums[4])
+{
+	float* pixelSums = &sums[static_cast<size_t>(pixelNdx) * 4];
+	for (uint32_t c = 0; c < 4; c++)
+	{
+		pixelSums[c] += sampleSums[c];
+	}
+	estimates[pixelNdx].AddSample(sampleSums, sampleSums[3]);
+}
+
+double ProgressiveFilm::RelativeError() const
+{
+	if (estimates.arrayLen == 0)
+	{
+		return 0.0;
+	}
+
+	const PixelEstimate* pixelEstimates = &estimates[0];
+	double relativeVariance = 0.0;
+	for (size_t i = 0; i < estimates.arrayLen; i++)
+	{
+		relativeVariance += pixelEstimates[i].RelativeVariance();
+	}
+	return std::sqrt(relativeVariance / estimates.arrayLen);
+}
+
+void ProgressiveFilm::Resolve(CPUMemory::ArrayAllocHandle<float> outRGB) const
+{
+	const size_t numPixels = static_cast<size_t>(width) * height;
+	assert(outRGB.arrayLen == numPixels * 3);
+	const float* pixelSums = &sums[0];
+	float* rgb = &outRGB[0];
+	for (size_t i = 0; i < numPixels; i++)
+	{
+		const float weight = pixelSums[i * 4 + 3];
+		for (uint32_t c = 0; c < 3; c++)
+		{
+			rgb[i * 3 + c] = (weight != 0.0f) ? pixelSums[i * 4 + c] / weight : 0.0f;
+		}
+	}
+}
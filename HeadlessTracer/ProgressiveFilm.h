@@ -0,0 +1,60 @@
+#pragma once
+
+#include "../CPUMemory.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Progressive film for the headless renderer: per-pixel sums and PRNG streams carried from pass to pass, plus running estimates of
+// each pixel's mean + variance, so renders can stop once they've converged
+// - Samples land in a pixel one at a time, in the order its stream produced them, so a film that has taken N samples per pixel holds
+//   exactly what one N-sample render would have, for any pass sizes, thread counts, or tile orders
+// - Variance is tracked on each sample's luminance with West's weighted form of Welford's update (samples are weighted by the
+//   reconstruction filter, as the resolved colour is); the variance of a pixel's mean comes from Kish's effective sample count
+// - Relative error is against luminance, offset so near-black pixels don't dominate: sqrt(variance / (mean^2 + [relativeOffset]))
+
+struct PixelEstimate
+{
+	double weightSum, weightSqSum;
+	double mean; // Filter-weighted mean luminance
+	double m2; // Weighted sum of squared differences from [mean]
+	uint32_t samples;
+
+	void AddSample(const float film[3], float filterWeight);
+
+	// Variance of [mean] as an estimate (zero until there are two samples)
+	double MeanVariance() const;
+	double RelativeVariance() const;
+};
+
+class ProgressiveFilm
+{
+	public:
+		static constexpr double relativeOffset = 0.01;
+		static constexpr uint64_t bytesPerPixel = 4 * sizeof(float) + 4 * sizeof(uint32_t) + sizeof(PixelEstimate); // Allocated by [Init]
+
+		// Seeds one stream per pixel from [seed] and the pixel's index alone (see SeedPixel in ProgressiveFilm.cpp)
+		void Init(uint32_t width, uint32_t height, uint64_t seed);
+		void DeInit();
+
+		// [sampleSums] is one finished sample through [pixelNdx], as ShadePath adds it (filter-weighted rgb + filter weight)
+		void AddSample(uint32_t pixelNdx, const float sampleSums[4]);
+
+		// RMS of every pixel's relative error
+		double RelativeError() const;
+
+		// Filter-normalised rgb per pixel, in film order ([outRGB] holds three floats per pixel)
+		void Resolve(CPUMemory::ArrayAllocHandle<float> outRGB) const;
+
+		uint32_t* PixelStream(uint32_t pixelNdx) { return &prngStates[static_cast<size_t>(pixelNdx) * 4]; }
+		const PixelEstimate& Estimate(uint32_t pixelNdx) const { return estimates[pixelNdx]; }
+		CPUMemory::ArrayAllocHandle<float> Sums() const { return sums; }
+		uint32_t Width() const { return width; }
+		uint32_t Height() const { return height; }
+
+	private:
+		uint32_t width = 0, height = 0;
+		CPUMemory::ArrayAllocHandle<float> sums; // Filter-weighted rgb + filter weight per pixel
+		CPUMemory::ArrayAllocHandle<uint32_t> prngStates; // Four words per pixel
+		CPUMemory::ArrayAllocHandle<PixelEstimate> estimates;
+};
@@ -0,0 +1,344 @@
+#include "RenderDriver.h"
+#include "TraceKernel.h"
+#include "ProgressiveFilm.h"
+#include "../SandboxApp/PacketBVH.h"
+
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <cstring>
+
+using Clock = std::chrono::steady_clock;
+
+constexpr float shaderMaxDistance = 9999.0f; // As the shader traversal's closest-hit search starts
+
+const char* const traceModeNames[static_cast<uint32_t>(TraceMode::Count)] = { "shader", "single", "packet", "wavefront" };
+
+// One thread's tile of paths, the batch buffers PacketBVH modes trace them through, and the thread's counts for the current render
+struct TilePaths
+{
+	CPUMemory::ArrayAllocHandle<TracePath> paths; // One per pixel of the tile, row by row
+	CPUMemory::ArrayAllocHandle<float> sampleSums; // Each path's film response, as ShadePath adds it (four per path)
+	CPUMemory::ArrayAllocHandle<uint32_t> active, stillActive; // Paths with a ray to trace at the current depth
+	CPUMemory::ArrayAllocHandle<PacketBVH::Ray> rays;
+	CPUMemory::ArrayAllocHandle<PacketBVH::Hit> hits;
+	CPUMemory::ArrayAllocHandle<uint32_t> order;
+	CPUMemory::ArrayAllocHandle<uint64_t> sortScratch;
+
+	// As [RenderResult]'s
+	CPUMemory::ArrayAllocHandle<uint64_t> depthRays;
+	CPUMemory::ArrayAllocHandle<double> depthMs;
+	CPUMemory::ArrayAllocHandle<uint64_t> pathBounces;
+	uint64_t rouletteEnded;
+	uint64_t shadowRays;
+};
+
+// A tile's view of its thread's [TilePaths], resolved once per tile (nothing allocates or frees while tiles run, so the pointers stay valid)
+struct TileBatch
+{
+	TracePath* paths;
+	float* sampleSums;
+	uint32_t* active;
+	uint32_t* stillActive;
+	uint32_t numActive;
+	PacketBVH::Ray* rays;
+	PacketBVH::Hit* hits;
+	uint32_t* order;
+	uint64_t* sortScratch;
+};
+
+void RenderContext::InitTiles(uint32_t numThreads)
+{
+	const uint32_t maxPaths = tileSize * tileSize;
+	const uint32_t numDepths = settings->maxBounces + 1;
+	threadTiles = CPUMemory::AllocateArray<TilePaths>(numThreads);
+	for (uint32_t t = 0; t < numThreads; t++)
+	{
+		TilePaths& tilePaths = threadTiles[t];
+		tilePaths.paths = CPUMemory::AllocateArray<TracePath>(maxPaths);
+		tilePaths.sampleSums = CPUMemory::AllocateArray<float>(maxPaths * 4);
+		tilePaths.active = CPUMemory::AllocateArray<uint32_t>(maxPaths);
+		tilePaths.stillActive = CPUMemory::AllocateArray<uint32_t>(maxPaths);
+		tilePaths.rays = CPUMemory::AllocateArray<PacketBVH::Ray>(maxPaths);
+		tilePaths.hits = CPUMemory::AllocateArray<PacketBVH::Hit>(maxPaths);
+		tilePaths.order = CPUMemory::AllocateArray<uint32_t>(maxPaths);
+		tilePaths.sortScratch = CPUMemory::AllocateArray<uint64_t>(maxPaths * 2);
+		tilePaths.depthRays = CPUMemory::AllocateArray<uint64_t>(numDepths);
+		tilePaths.depthMs = CPUMemory::AllocateArray<double>(numDepths);
+		tilePaths.pathBounces = CPUMemory::AllocateArray<uint64_t>(numDepths);
+	}
+}
+
+void RenderContext::DeInitTiles()
+{
+	for (uint32_t t = static_cast<uint32_t>(threadTiles.arrayLen); t > 0; t--)
+	{
+		const TilePaths tilePaths = threadTiles[t - 1];
+		CPUMemory::Free(tilePaths.pathBounces);
+		CPUMemory::Free(tilePaths.depthMs);
+		CPUMemory::Free(tilePaths.depthRays);
+		CPUMemory::Free(tilePaths.sortScratch);
+		CPUMemory::Free(tilePaths.order);
+		CPUMemory::Free(tilePaths.hits);
+		CPUMemory::Free(tilePaths.rays);
+		CPUMemory::Free(tilePaths.stillActive);
+		CPUMemory::Free(tilePaths.active);
+		CPUMemory::Free(tilePaths.sampleSums);
+		CPUMemory::Free(tilePaths.paths);
+	}
+	CPUMemory::Free(threadTiles);
+}
+
+void RenderResult::Init(uint32_t numDepths)
+{
+	depthRays = CPUMemory::AllocateArray<uint64_t>(numDepths);
+	depthMs = CPUMemory::AllocateArray<double>(numDepths);
+	pathBounces = CPUMemory::AllocateArray<uint64_t>(numDepths);
+	Clear();
+}
+
+void RenderResult::DeInit()
+{
+	CPUMemory::Free(pathBounces);
+	CPUMemory::Free(depthMs);
+	CPUMemory::Free(depthRays);
+}
+
+void RenderResult::Clear()
+{
+	CPUMemory::ZeroData(depthRays);
+	CPUMemory::ZeroData(depthMs);
+	CPUMemory::ZeroData(pathBounces);
+	rouletteEnded = 0;
+	renderMs = 0.0;
+	totalRays = 0;
+	shadowRays = 0;
+	numThreads = 0;
+	tileStats = {};
+}
+
+// Traces each active path's ray at [depth], writing [hits] in [active] order
+static void TraceDepth(const RenderContext& context, TraceMode mode, uint32_t depth, uint32_t tileWidth, uint32_t tileHeight, TileBatch& batch)
+{
+	const uint32_t numActive = batch.numActive;
+	if (mode == TraceMode::Shader)
+	{
+		for (uint32_t i = 0; i < numActive; i++)
+		{
+			PacketBVH::Hit& hit = batch.hits[i];
+			hit.tri = TraceShaderRay(*context.kernelScene, batch.paths[batch.active[i]], &hit.t);
+		}
+		return;
+	}
+
+	for (uint32_t i = 0; i < numActive; i++)
+	{
+		const TracePath& path = batch.paths[batch.active[i]];
+		batch.rays[i] = { float4(path.origin[0], path.origin[1], path.origin[2], 0.0f), float4(path.dir[0], path.dir[1], path.dir[2], 0.0f), 0.0f, shaderMaxDistance };
+	}
+
+	// Camera rays leave one point through neighbouring pixels, so square tiles of them make tight packets; when every path starts a
+	// sample together, [active] still lists the whole tile in pixel order at depth zero (adaptive passes can start some pixels' samples
+	// without their neighbours', and those camera rays trace as later depths' do)
+	if (depth == 0 && mode != TraceMode::Single && numActive == tileWidth * tileHeight)
+	{
+		const uint32_t side = context.packetSide;
+		PacketBVH::Ray packetRays[PacketBVH::maxPacketRays];
+		PacketBVH::Hit packetHits[PacketBVH::maxPacketRays];
+		uint32_t packetPaths[PacketBVH::maxPacketRays];
+		for (uint32_t tileY = 0; tileY < tileHeight; tileY += side)
+		{
+			for (uint32_t tileX = 0; tileX < tileWidth; tileX += side)
+			{
+				uint32_t numRays = 0;
+				for (uint32_t y = tileY; y < std::min(tileY + side, tileHeight); y++)
+				{
+					for (uint32_t x = tileX; x < std::min(tileX + side, tileWidth); x++)
+					{
+						packetPaths[numRays] = y * tileWidth + x;
+						packetRays[numRays++] = batch.rays[y * tileWidth + x];
+					}
+				}
+				context.packetBVH->ClosestHitPacket(packetRays, numRays, packetHits);
+				for (uint32_t i = 0; i < numRays; i++)
+				{
+					batch.hits[packetPaths[i]] = packetHits[i];
+				}
+			}
+		}
+		return;
+	}
+
+	if (mode == TraceMode::Wavefront)
+	{
+		context.packetBVH->SortStream(batch.rays, numActive, batch.sortScratch, batch.order);
+		context.packetBVH->ClosestHitStream(batch.rays, batch.order, numActive, batch.hits);
+		return;
+	}
+
+	for (uint32_t i = 0; i < numActive; i++)
+	{
+		context.packetBVH->ClosestHit(batch.rays[i], &batch.hits[i]);
+	}
+}
+
+// Every path in a tile finishes sample [s] (bounce depth by bounce depth) before any starts sample [s + 1], so each pixel draws from its
+// stream in the same order as [TracePixel]
+void Render(const RenderContext& context, TraceMode mode, uint32_t numSamples, ProgressiveFilm* film, RenderResult* outResult, const uint32_t* pixelSamples)
+{
+	const TraceKernelSettings& settings = *context.settings;
+	const uint32_t numDepths = settings.maxBounces + 1;
+	const uint32_t numThreads = context.scheduler->NumThreads();
+	assert(numThreads <= context.threadTiles.arrayLen && outResult->depthRays.arrayLen == numDepths);
+
+	RenderResult& result = *outResult;
+	result.Clear();
+	result.numThreads = numThreads;
+	for (uint32_t t = 0; t < numThreads; t++)
+	{
+		TilePaths& tilePaths = context.threadTiles[t];
+		CPUMemory::ZeroData(tilePaths.depthRays);
+		CPUMemory::ZeroData(tilePaths.depthMs);
+		CPUMemory::ZeroData(tilePaths.pathBounces);
+		tilePaths.rouletteEnded = 0;
+		tilePaths.shadowRays = 0;
+	}
+
+	const Clock::time_point renderStart = Clock::now();
+
+	// Pixels carry their own streams (in [film], between renders), so neither the tile order nor which thread runs a tile changes the image
+	result.tileStats = context.scheduler->Run(settings.width, settings.height, context.tileSize, context.tileOrder, [&](const TileScheduler::Tile& tile, uint32_t threadNdx)
+	{
+		TilePaths& tilePaths = context.threadTiles[threadNdx];
+		uint64_t* threadRays = &tilePaths.depthRays[0];
+		double* threadMs = &tilePaths.depthMs[0];
+		uint64_t* threadPathBounces = &tilePaths.pathBounces[0];
+		TileBatch batch = { &tilePaths.paths[0], &tilePaths.sampleSums[0], &tilePaths.active[0], &tilePaths.stillActive[0], 0, &tilePaths.rays[0], &tilePaths.hits[0],
+							&tilePaths.order[0], &tilePaths.sortScratch[0] };
+
+		const uint32_t x0 = tile.x0, y0 = tile.y0;
+		const uint32_t width = tile.x1 - tile.x0, height = tile.y1 - tile.y0;
+		auto pixelNdx = [&](uint32_t pathNdx) { return (y0 + pathNdx / width) * settings.width + x0 + pathNdx % width; };
+		uint32_t tileSamples = numSamples;
+		if (pixelSamples != nullptr)
+		{
+			tileSamples = 0;
+			for (uint32_t i = 0; i < width * height; i++)
+			{
+				tileSamples = std::max(tileSamples, pixelSamples[pixelNdx(i)]);
+			}
+		}
+		if (tileSamples == 0)
+		{
+			return;
+		}
+
+		for (uint32_t i = 0; i < width * height; i++)
+		{
+			memcpy(batch.paths[i].prngState, film->PixelStream(pixelNdx(i)), sizeof(batch.paths[i].prngState));
+		}
+
+		for (uint32_t s = 0; s < tileSamples; s++)
+		{
+			batch.numActive = 0;
+			for (uint32_t i = 0; i < width * height; i++)
+			{
+				if (pixelSamples != nullptr && pixelSamples[pixelNdx(i)] <= s)
+				{
+					continue;
+				}
+				BeginPath(settings, x0 + i % width, y0 + i / width, &batch.paths[i]);
+				memset(&batch.sampleSums[i * 4], 0, 4 * sizeof(float));
+				batch.active[batch.numActive++] = i;
+			}
+
+			for (uint32_t depth = 0; batch.numActive > 0; depth++)
+			{
+				const Clock::time_point traceStart = Clock::now();
+				TraceDepth(context, mode, depth, width, height, batch);
+				threadMs[depth] += std::chrono::duration<double, std::milli>(Clock::now() - traceStart).count();
+				threadRays[depth] += batch.numActive;
+
+				uint32_t numStillActive = 0;
+				for (uint32_t i = 0; i < batch.numActive; i++)
+				{
+					const uint32_t pathNdx = batch.active[i];
+					float* sampleSums = &batch.sampleSums[pathNdx * 4];
+					if (ShadePath(*context.kernelScene, settings, &batch.paths[pathNdx], depth, batch.hits[i].tri, batch.hits[i].t, sampleSums))
+					{
+						batch.stillActive[numStillActive++] = pathNdx;
+					}
+					else
+					{
+						film->AddSample(pixelNdx(pathNdx), sampleSums);
+						tilePaths.shadowRays += batch.paths[pathNdx].shadowRays;
+						threadPathBounces[depth]++;
+						tilePaths.rouletteEnded += batch.paths[pathNdx].rouletteEnded ? 1 : 0;
+					}
+				}
+				std::swap(batch.active, batch.stillActive);
+				batch.numActive = numStillActive;
+			}
+		}
+
+		for (uint32_t i = 0; i < width * height; i++)
+		{
+			memcpy(film->PixelStream(pixelNdx(i)), batch.paths[i].prngState, sizeof(batch.paths[i].prngState));
+		}
+	});
+	result.renderMs = std::chrono::duration<double, std::milli>(Clock::now() - renderStart).count();
+
+	for (uint32_t t = 0; t < numThreads; t++)
+	{
+		const TilePaths& tilePaths = context.threadTiles[t];
+		result.shadowRays += tilePaths.shadowRays;
+		result.totalRays += tilePaths.shadowRays;
+		result.rouletteEnded += tilePaths.rouletteEnded;
+		for (uint32_t d = 0; d < numDepths; d++)
+		{
+			result.depthRays[d] += tilePaths.depthRays[d];
+			result.depthMs[d] += tilePaths.depthMs[d];
+			result.pathBounces[d] += tilePaths.pathBounces[d];
+			result.totalRays += tilePaths.depthRays[d];
+		}
+	}
+}
+
+void AddPass(RenderResult* total, const RenderResult& pass, bool firstPass)
+{
+	// The first pass's tile stats start the render's off (steals are added below)
+	if (firstPass)
+	{
+		total->Clear();
+		total->tileStats = pass.tileStats;
+		total->tileStats.numSteals = 0;
+		total->tileStats.stolenTiles = 0;
+	}
+
+	for (size_t d = 0; d < pass.depthRays.arrayLen; d++)
+	{
+		total->depthRays[d] += pass.depthRays[d];
+		total->depthMs[d] += pass.depthMs[d];
+		total->pathBounces[d] += pass.pathBounces[d];
+	}
+	total->numThreads = pass.numThreads;
+	total->renderMs += pass.renderMs;
+	total->totalRays += pass.totalRays;
+	total->shadowRays += pass.shadowRays;
+	total->rouletteEnded += pass.rouletteEnded;
+	total->tileStats.numSteals += pass.tileStats.numSteals;
+	total->tileStats.stolenTiles += pass.tileStats.stolenTiles;
+	total->tileStats.minThreadTiles = std::min(total->tileStats.minThreadTiles, pass.tileStats.minThreadTiles);
+	total->tileStats.maxThreadTiles = std::max(total->tileStats.maxThreadTiles, pass.tileStats.maxThreadTiles);
+}
+
+double MeanPathBounces(const RenderResult& result)
+{
+	uint64_t numPaths = 0, numBounces = 0;
+	for (size_t d = 0; d < result.pathBounces.arrayLen; d++)
+	{
+		numPaths += result.pathBounces[d];
+		numBounces += result.pathBounces[d] * d;
+	}
+	return (numPaths > 0) ? static_cast<double>(numBounces) / numPaths : 0.0;
+}
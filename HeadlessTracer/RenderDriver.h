@@ -0,0 +1,77 @@
+#pragma once
+
+#include "../CPUMemory.h"
+#include "../SandboxApp/TileScheduler.h"
+
+#include <stdint.h>
+
+struct TraceKernelScene;
+struct TraceKernelSettings;
+class PacketBVH;
+class ProgressiveFilm;
+struct TilePaths; // One thread's tile of paths (see RenderDriver.cpp)
+
+// Render driver for the headless renderer: paths advance a bounce at a time over tiles of pixels (on a TileScheduler pool), so each
+// bounce depth's rays can be traced together, through the shader's skip-link traversal or PacketBVH (see [TraceMode])
+// - Every path in a tile finishes sample [s] before any starts sample [s + 1], and pixels keep their streams in the film between
+//   renders, so neither the mode, the tile order, nor which thread runs a tile changes the image
+// - Buffers are allocated once for a whole session of renders (CPUMemory never reuses handles, so progressive renders can't allocate
+//   per pass): each thread's tile buffers with [RenderContext::InitTiles], and each result's per-depth counts with [RenderResult::Init]
+
+enum class TraceMode
+{
+	Shader, // The shader's skip-link traversal (the reference)
+	Single, // One ray at a time through PacketBVH
+	Packet, // Camera rays in NxN frustum-culled packets, bounces one at a time
+	Wavefront, // Camera packets, then each depth's bounces sorted into streams
+	Count
+};
+
+extern const char* const traceModeNames[static_cast<uint32_t>(TraceMode::Count)];
+
+struct RenderContext
+{
+	const TraceKernelScene* kernelScene;
+	const TraceKernelSettings* settings;
+	const PacketBVH* packetBVH;
+	TileScheduler* scheduler;
+	uint32_t packetSide;
+	uint32_t tileSize;
+	TileScheduler::TileOrder tileOrder;
+	CPUMemory::ArrayAllocHandle<TilePaths> threadTiles;
+
+	// Allocates tile buffers for up to [numThreads] threads, sized by [tileSize] and [settings]' bounces
+	void InitTiles(uint32_t numThreads);
+	void DeInitTiles();
+};
+
+// Rays traced at each bounce depth and the thread time spent tracing them (shading excluded); shadow rays are traced while shading,
+// and only counted in [shadowRays] + [totalRays]
+// Paths are counted by the bounces they took before ending ([pathBounces]), and by whether roulette ended them
+struct RenderResult
+{
+	CPUMemory::ArrayAllocHandle<uint64_t> depthRays; // One per bounce depth, as are [depthMs] + [pathBounces]
+	CPUMemory::ArrayAllocHandle<double> depthMs;
+	CPUMemory::ArrayAllocHandle<uint64_t> pathBounces;
+	uint64_t rouletteEnded;
+	double renderMs;
+	uint64_t totalRays;
+	uint64_t shadowRays;
+	uint32_t numThreads;
+	TileScheduler::RunStats tileStats;
+
+	void Init(uint32_t numDepths);
+	void DeInit();
+	void Clear();
+};
+
+// Adds [numSamples] samples per pixel to [film] a tile at a time (or [pixelSamples]' counts, one per pixel, where given), on
+// [context.scheduler]'s threads, and counts them into [outResult] (cleared first); each pixel draws from its stream in the same order as
+// [TracePixel]
+void Render(const RenderContext& context, TraceMode mode, uint32_t numSamples, ProgressiveFilm* film, RenderResult* outResult, const uint32_t* pixelSamples = nullptr);
+
+// Adds a progressive pass's rays + times to the render's [total]; tile stats are the busiest + quietest thread's over any one pass
+void AddPass(RenderResult* total, const RenderResult& pass, bool firstPass);
+
+// Mean bounces per path in [result]
+double MeanPathBounces(const RenderResult& result);
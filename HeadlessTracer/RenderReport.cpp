@@ -0,0 +1,235 @@
+#include "RenderReport.h"
+#include "TraceKernel.h"
+#include "ProgressiveFilm.h"
+#include "ImageIO.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstdio>
+#include <cstring>
+
+uint32_t RenderScaling(const RenderContext& context, TraceMode mode, uint32_t numSamples, uint32_t numThreads, uint64_t seed, ProgressiveFilm* outFilm,
+					   RenderResult* outResult, ScalingStep outSteps[maxScalingSteps])
+{
+	const TraceKernelSettings& settings = *context.settings;
+	ProgressiveFilm oneThreadFilm;
+	uint32_t numSteps = 0;
+	for (uint32_t threads = 1; ; threads = std::min(threads * 2, numThreads))
+	{
+		assert(numSteps < maxScalingSteps);
+		context.scheduler->Init(threads);
+		ProgressiveFilm film;
+		film.Init(settings.width, settings.height, seed);
+		Render(context, mode, numSamples, &film, outResult);
+		context.scheduler->DeInit();
+
+		// Only the one-thread film is kept to compare against (besides the full count's, which is returned)
+		const bool firstStep = (numSteps == 0), lastStep = (threads == numThreads);
+		if (firstStep)
+		{
+			oneThreadFilm = film;
+		}
+		ScalingStep& step = outSteps[numSteps++];
+		step.numThreads = outResult->numThreads;
+		step.renderMs = outResult->renderMs;
+		step.totalRays = outResult->totalRays;
+		step.tileStats = outResult->tileStats;
+		step.matches = (CPUMemory::CompareData(film.Sums(), oneThreadFilm.Sums()) == 0);
+
+		if (lastStep)
+		{
+			if (!firstStep)
+			{
+				oneThreadFilm.DeInit();
+			}
+			*outFilm = film;
+			return numSteps;
+		}
+		if (!firstStep)
+		{
+			film.DeInit();
+		}
+	}
+}
+
+void PrintScalingReport(const ScalingStep* steps, uint32_t numSteps)
+{
+	printf("%-8s %10s %10s %9s %11s %8s %14s  %s\n", "threads", "ms", "Mrays/s", "speedup", "efficiency", "steals", "tiles/thread", "image");
+	for (uint32_t i = 0; i < numSteps; i++)
+	{
+		const ScalingStep& step = steps[i];
+		const double speedup = steps[0].renderMs / step.renderMs;
+		printf("%-8u %10.1f %10.2f %8.2fx %10.1f%% %8u %8u-%-5u  %s\n", step.numThreads, step.renderMs, step.totalRays / (step.renderMs * 1000.0), speedup,
+			   100.0 * speedup / step.numThreads, step.tileStats.numSteals, step.tileStats.minThreadTiles, step.tileStats.maxThreadTiles,
+			   step.matches ? "matches" : "DIFFERS");
+	}
+}
+
+void PrintPathBounces(const RenderResult& result, const TraceKernelSettings& settings)
+{
+	uint64_t numPaths = 0;
+	for (size_t d = 0; d < result.pathBounces.arrayLen; d++)
+	{
+		numPaths += result.pathBounces[d];
+	}
+	if (numPaths == 0)
+	{
+		return;
+	}
+
+	printf("  %.2f bounces per path", MeanPathBounces(result));
+	settings.roulette ? printf(" (roulette after %u, ending %.1f%% of paths):", settings.rouletteMinBounces, 100.0 * result.rouletteEnded / numPaths) : printf(":");
+	for (size_t d = 0; d < result.pathBounces.arrayLen; d++)
+	{
+		if (result.pathBounces[d] > 0)
+		{
+			printf(" %zu %.3g%%", d, 100.0 * result.pathBounces[d] / numPaths);
+		}
+	}
+	printf("\n");
+}
+
+void PrintDepthReport(const RenderResult* results, const bool* rendered)
+{
+	const uint32_t singleNdx = static_cast<uint32_t>(TraceMode::Single);
+	printf("%-8s", "depth");
+	for (uint32_t m = 0; m < static_cast<uint32_t>(TraceMode::Count); m++)
+	{
+		if (rendered[m])
+		{
+			printf("%24s", traceModeNames[m]);
+		}
+	}
+	printf("   (Mrays/s per thread, x single rays)\n");
+
+	auto rate = [](uint64_t rays, double ms) { return (ms > 0.0) ? static_cast<double>(rays) / (ms * 1000.0) : 0.0; };
+	const size_t numDepths = results[singleNdx].depthRays.arrayLen;
+	for (size_t d = 0; d <= numDepths; d++)
+	{
+		const bool total = (d == numDepths);
+		if (!total && results[singleNdx].depthRays[d] == 0)
+		{
+			continue;
+		}
+
+		total ? printf("%-8s", "all") : printf("%-8zu", d);
+		for (uint32_t m = 0; m < static_cast<uint32_t>(TraceMode::Count); m++)
+		{
+			if (!rendered[m])
+			{
+				continue;
+			}
+			uint64_t rays = 0, singleRays = 0;
+			double ms = 0.0, singleMs = 0.0;
+			for (size_t i = (total ? 0 : d); i < (total ? numDepths : d + 1); i++)
+			{
+				rays += results[m].depthRays[i];
+				ms += results[m].depthMs[i];
+				singleRays += results[singleNdx].depthRays[i];
+				singleMs += results[singleNdx].depthMs[i];
+			}
+			const double mraysPerSec = rate(rays, ms), singleRate = rate(singleRays, singleMs);
+			printf("%15.2f (%5.2fx)", mraysPerSec, (singleRate > 0.0) ? mraysPerSec / singleRate : 0.0);
+		}
+		printf("\n");
+	}
+}
+
+void RenderComparison(const RenderContext& context, uint32_t numSamples, uint64_t seed, ProgressiveFilm* outFilm, RenderResult* outResults,
+					  double* outRelativeErrors, uint32_t* outNumDiffering)
+{
+	// Modes render in order, so single rays' sums are kept for the PacketBVH modes after them
+	const TraceKernelSettings& settings = *context.settings;
+	const uint64_t numPixels = static_cast<uint64_t>(settings.width) * settings.height;
+	CPUMemory::ArrayAllocHandle<float> singleSums = CPUMemory::AllocateArray<float>(numPixels * 4);
+	for (uint32_t m = 0; m < static_cast<uint32_t>(TraceMode::Count); m++)
+	{
+		const TraceMode mode = static_cast<TraceMode>(m);
+		ProgressiveFilm film;
+		film.Init(settings.width, settings.height, seed);
+		Render(context, mode, numSamples, &film, &outResults[m]);
+		outRelativeErrors[m] = film.RelativeError();
+		outNumDiffering[m] = 0;
+		if (mode == TraceMode::Single)
+		{
+			CPUMemory::CopyData(film.Sums(), singleSums);
+		}
+		else if (mode != TraceMode::Shader)
+		{
+			const float* modeSums = &film.Sums()[0];
+			const float* singlePixelSums = &singleSums[0];
+			for (uint64_t i = 0; i < numPixels; i++)
+			{
+				outNumDiffering[m] += (memcmp(&modeSums[i * 4], &singlePixelSums[i * 4], 4 * sizeof(float)) != 0) ? 1 : 0;
+			}
+		}
+
+		if (mode == TraceMode::Shader)
+		{
+			*outFilm = film;
+		}
+		else
+		{
+			film.DeInit();
+		}
+	}
+	CPUMemory::Free(singleSums);
+}
+
+void PrintModeDifferences(const uint32_t* numDiffering)
+{
+	// PacketBVH modes find the same hit distances, so their images only differ from single rays' where triangles tie
+	for (uint32_t m = static_cast<uint32_t>(TraceMode::Packet); m < static_cast<uint32_t>(TraceMode::Count); m++)
+	{
+		printf("%s image: %u pixels differ from single rays'\n", traceModeNames[m], numDiffering[m]);
+	}
+}
+
+void PrintReferenceError(const char* referencePath, CPUMemory::ArrayAllocHandle<float> rgbHandle, uint32_t width, uint32_t height)
+{
+	// relMSE is squared error over the reference's squared value (offset, as relative error is)
+	// Colour noise on its own is the squared error of each pixel's chromaticity (rgb over r + g + b), which brightness noise doesn't
+	// touch; pixels black in either image are left out of it
+	CPUMemory::ArrayAllocHandle<float> referenceHandle;
+	uint32_t referenceWidth = 0, referenceHeight = 0;
+	const bool read = ReadPFM(referencePath, &referenceHandle, &referenceWidth, &referenceHeight);
+	if (!read || referenceWidth != width || referenceHeight != height)
+	{
+		fprintf(stderr, "couldn't read a %ux%u PFM from %s\n", width, height, referencePath);
+		if (read)
+		{
+			CPUMemory::Free(referenceHandle);
+		}
+		return;
+	}
+
+	const float* rgb = &rgbHandle[0];
+	const float* reference = &referenceHandle[0];
+	const size_t numValues = rgbHandle.arrayLen;
+	double relMSE = 0.0;
+	for (size_t i = 0; i < numValues; i++)
+	{
+		const double error = static_cast<double>(rgb[i]) - reference[i];
+		relMSE += error * error / (static_cast<double>(reference[i]) * reference[i] + ProgressiveFilm::relativeOffset);
+	}
+
+	double chromaMSE = 0.0;
+	size_t numChromaPixels = 0;
+	for (size_t i = 0; i < numValues; i += 3)
+	{
+		const double sum = static_cast<double>(rgb[i]) + rgb[i + 1] + rgb[i + 2];
+		const double referenceSum = static_cast<double>(reference[i]) + reference[i + 1] + reference[i + 2];
+		if (sum <= 0.0 || referenceSum <= 0.0)
+		{
+			continue;
+		}
+		for (uint32_t c = 0; c < 3; c++)
+		{
+			const double error = rgb[i + c] / sum - reference[i + c] / referenceSum;
+			chromaMSE += error * error;
+		}
+		numChromaPixels++;
+	}
+	printf("relMSE against %s: %.6g (chromaticity MSE %.6g)\n", referencePath, relMSE / numValues, chromaMSE / std::max(numChromaPixels, static_cast<size_t>(1)));
+	CPUMemory::Free(referenceHandle);
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include "RenderDriver.h"
+
+#include <stdint.h>
+
+// Reports for the headless renderer's renders, and the harnesses that render one image at a range of thread counts or with every mode
+// - Harnesses free each film once it's been measured, so they hold at most two at once (films come out of CPUMemory's pool)
+
+// One thread count's render in a scaling run
+struct ScalingStep
+{
+	uint32_t numThreads;
+	double renderMs;
+	uint64_t totalRays;
+	TileScheduler::RunStats tileStats;
+	bool matches; // The film's sums match the one-thread render's exactly
+};
+constexpr uint32_t maxScalingSteps = 9; // 1, 2, 4.. threads up to TileScheduler::maxThreads (or a count short of the next power of two)
+
+// Renders [numSamples] samples per pixel with 1, 2, 4.. threads up to [numThreads], each on a fresh pool in [context.scheduler] (so
+// idle workers can't steal) and into a fresh film seeded from [seed]; the full count's film (for the caller to DeInit) + result (into
+// [outResult], which has to be initialised) are the ones returned
+// Returns the number of [outSteps] filled
+uint32_t RenderScaling(const RenderContext& context, TraceMode mode, uint32_t numSamples, uint32_t numThreads, uint64_t seed, ProgressiveFilm* outFilm,
+					   RenderResult* outResult, ScalingStep outSteps[maxScalingSteps]);
+
+// Speedup + parallel efficiency against one thread; every thread count has to produce the one-thread image exactly
+void PrintScalingReport(const ScalingStep* steps, uint32_t numSteps);
+
+// How many bounces [result]'s paths took before ending (as a share of them, for every length any reached), and how many roulette ended
+void PrintPathBounces(const RenderResult& result, const TraceKernelSettings& settings);
+
+// Tracing throughput per bounce depth for each mode rendered, with speedups over single rays (per thread: thread time spent tracing)
+void PrintDepthReport(const RenderResult* results, const bool* rendered);
+
+// Renders [numSamples] samples per pixel with every mode on [context.scheduler]'s threads (already started), into [outResults] (one per
+// mode, initialised) and films seeded from [seed]; the shader traversal's film is the one returned (for the caller to DeInit)
+// - [outRelativeErrors] takes each mode's relative error, and [outNumDiffering] how many pixels in each PacketBVH mode's image differ
+//   from single rays' (zero for the others)
+void RenderComparison(const RenderContext& context, uint32_t numSamples, uint64_t seed, ProgressiveFilm* outFilm, RenderResult* outResults,
+					  double* outRelativeErrors, uint32_t* outNumDiffering);
+
+// How many pixels each PacketBVH mode's image has that differ from single rays' (see [RenderComparison])
+void PrintModeDifferences(const uint32_t* numDiffering);
+
+// relMSE of [rgb] against the PFM at [referencePath], as denoising comparisons measure it, plus its colour noise on its own
+void PrintReferenceError(const char* referencePath, CPUMemory::ArrayAllocHandle<float> rgb, uint32_t width, uint32_t height);
@@ -0,0 +1,114 @@
+#pragma once
+
+#include <stdint.h>
+#include <cmath>
+
+// Just enough HLSL for shared shader code to compile as C++ (see Shaders/SharedPlatform.h)
+// - Vector/matrix types match HLSL's sizes and layouts (no padding), so structs declared in shared headers keep their GPU layouts
+// - Operators are component-wise, with scalars broadcast; matrices only need row access (as triHit uses them)
+// - Everything lives in [ShaderCode], where shader-code translation units also include the shared headers; that keeps these types
+//   (and the shared structs declared with them) apart from Math.h's CPU types
+namespace ShaderCode
+{
+	using uint = uint32_t;
+
+	struct float2
+	{
+		float x, y;
+		float2() = default;
+		constexpr float2(float _x, float _y) : x(_x), y(_y) {}
+	};
+
+	struct float3
+	{
+		float x, y, z;
+		float3() = default;
+		constexpr float3(float _x, float _y, float _z) : x(_x), y(_y), z(_z) {}
+		constexpr float3(float2 xy, float _z) : x(xy.x), y(xy.y), z(_z) {}
+
+		float& operator[](uint i) { return (&x)[i]; }
+		float operator[](uint i) const { return (&x)[i]; }
+	};
+
+	struct float4
+	{
+		float x, y, z, w;
+		float4() = default;
+		constexpr float4(float _x, float _y, float _z, float _w) : x(_x), y(_y), z(_z), w(_w) {}
+		constexpr float4(float3 xyz, float _w) : x(xyz.x), y(xyz.y), z(xyz.z), w(_w) {}
+	};
+
+	struct uint2
+	{
+		uint x, y;
+		uint2() = default;
+		constexpr uint2(uint _x, uint _y) : x(_x), y(_y) {}
+	};
+
+	struct uint3
+	{
+		uint x, y, z;
+		uint3() = default;
+		constexpr uint3(uint _x, uint _y, uint _z) : x(_x), y(_y), z(_z) {}
+	};
+
+	struct uint4
+	{
+		uint x, y, z, w;
+		uint4() = default;
+		constexpr uint4(uint _x, uint _y, uint _z, uint _w) : x(_x), y(_y), z(_z), w(_w) {}
+	};
+
+	struct float3x3
+	{
+		float3 rows[3];
+		float3x3() = default;
+		constexpr float3x3(float3 r0, float3 r1, float3 r2) : rows{ r0, r1, r2 } {}
+
+		float3& operator[](uint i) { return rows[i]; }
+		const float3& operator[](uint i) const { return rows[i]; }
+	};
+
+	// Component-wise arithmetic
+	inline float2 operator+(float2 a, float2 b) { return float2(a.x + b.x, a.y + b.y); }
+	inline float2 operator-(float2 a, float2 b) { return float2(a.x - b.x, a.y - b.y); }
+	inline float2 operator*(float2 a, float2 b) { return float2(a.x * b.x, a.y * b.y); }
+	inline float2 operator/(float2 a, float2 b) { return float2(a.x / b.x, a.y / b.y); }
+	inline float2 operator*(float2 a, float s) { return float2(a.x * s, a.y * s); }
+	inline float2 operator/(float2 a, float s) { return float2(a.x / s, a.y / s); }
+	inline float2& operator+=(float2& a, float2 b) { a = a + b; return a; }
+	inline float2& operator-=(float2& a, float2 b) { a = a - b; return a; }
+	inline float2& operator*=(float2& a, float s) { a = a * s; return a; }
+
+	inline float3 operator-(float3 a) { return float3(-a.x, -a.y, -a.z); }
+	inline float3 operator+(float3 a, float3 b) { return float3(a.x + b.x, a.y + b.y, a.z + b.z); }
+	inline float3 operator-(float3 a, float3 b) { return float3(a.x - b.x, a.y - b.y, a.z - b.z); }
+	inline float3 operator*(float3 a, float3 b) { return float3(a.x * b.x, a.y * b.y, a.z * b.z); }
+	inline float3 operator*(float3 a, float s) { return float3(a.x * s, a.y * s, a.z * s); }
+	inline float3 operator*(float s, float3 a) { return a * s; }
+	inline float3 operator/(float3 a, float s) { return float3(a.x / s, a.y / s, a.z / s); }
+	inline float3& operator+=(float3& a, float3 b) { a = a + b; return a; }
+	inline float3& operator-=(float3& a, float3 b) { a = a - b; return a; }
+	inline float3& operator*=(float3& a, float s) { a = a * s; return a; }
+
+	// Intrinsics
+	using std::exp;
+	using std::floor;
+	using std::sqrt;
+	using std::tan;
+	using std::sin;
+	using std::cos;
+
+	inline float min(float a, float b) { return (a < b) ? a : b; }
+	inline float max(float a, float b) { return (a > b) ? a : b; }
+	inline uint min(uint a, uint b) { return (a < b) ? a : b; }
+	inline float abs(float a) { return std::fabs(a); }
+	inline float2 abs(float2 a) { return float2(std::fabs(a.x), std::fabs(a.y)); }
+	inline float sign(float a) { return (a > 0.0f) ? 1.0f : ((a < 0.0f) ? -1.0f : 0.0f); }
+	inline float lerp(float a, float b, float t) { return a + (b - a) * t; }
+	inline float3 lerp(float3 a, float3 b, float t) { return a + (b - a) * t; }
+	inline float dot(float3 a, float3 b) { return a.x * b.x + a.y * b.y + a.z * b.z; }
+	inline float length(float3 a) { return std::sqrt(dot(a, a)); }
+	inline float3 normalize(float3 a) { return a / length(a); }
+	inline float3 cross(float3 a, float3 b) { return float3(a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x); }
+}
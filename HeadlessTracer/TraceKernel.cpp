@@ -0,0 +1,419 @@
+#include "TraceKernel.h"
+#include "ShaderTypes.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#if !defined(TRACE_KERNEL_SIMD_SCALAR) && (defined(__SSE2__) || defined(_M_X64))
+#define TRACE_KERNEL_SSE
+#include <immintrin.h>
+#endif
+
+// Shared shader code compiles here as C++ (see SharedPlatform.h); nothing else in this file may include the shared headers (or Math.h,
+// which pulls in shaderMath.h), since they'd then resolve outside [ShaderCode]
+// The shared functions aren't inline, so they're named apart in [ShaderCode::Kernel], clear of other translation units' copies (e.g. the
+// BxDF tests, which link against this file)
+#define CPU_SHADER_CODE
+namespace ShaderCode
+{
+namespace Kernel
+{
+#include "../Shaders/SharedStructs.h"
+#include "../Shaders/SharedGeoStructs.h"
+#include "../Shaders/SharedPRNG_Code.h"
+#include "../Shaders/materials.h"
+#include "../Shaders/SharedRaySetup.hlsli"
+#include "../Shaders/SharedIntersections.hlsli"
+#include "../Shaders/SharedHeroWavelengths.hlsli"
+#include "../Shaders/SharedBxDFs.hlsli"
+#include "../Shaders/SharedLightSampling.hlsli"
+}
+}
+
+using namespace ShaderCode;
+using namespace ShaderCode::Kernel;
+
+static_assert(traceKernelHeroWavelengths == HERO_WAVELENGTHS, "Paths should carry every hero wavelength");
+
+const TraceKernelBxDF traceKernelBxDFs[traceKernelNumBxDFs] =
+{
+	{ "lambert", BXDF_ID_DIFFUSE_LAMBERT },
+	{ "oren-nayar", BXDF_ID_DIFFUSE_OREN_NAYAR },
+	{ "mirror", BXDF_ID_SPECULAR_CLASSICAL_SMOOTH },
+	{ "conductor", BXDF_ID_SPECULAR_COOK_TORRANCE },
+	{ "dielectric", BXDF_ID_DIELECTRIC_ROUGH },
+};
+static_assert(sizeof(Vertex3D) == 48 && sizeof(IndexedTriangle) == 16 && sizeof(ComputeBVH_SkipNode) == 32 && sizeof(EmitterAliasEntry) == 24,
+			  "Shared layouts should match the CPU's");
+
+// Rotate [v] by unit quaternion [q]
+static float3 Rotate(float3 v, float4 q)
+{
+	const float3 u = float3(q.x, q.y, q.z);
+	const float3 t = cross(u, v) * 2.0f;
+	return v + t * q.w + cross(u, t);
+}
+
+// Tangent frame around unit [n] (Duff et al. 2017, which has no singularities); BxDFs work in it, with [n] as +z
+static void TangentFrame(float3 n, float3& outTangent, float3& outBitangent)
+{
+	const float s = (n.z >= 0.0f) ? 1.0f : -1.0f;
+	const float a = -1.0f / (s + n.z);
+	const float b = n.x * n.y * a;
+	outTangent = float3(1.0f + s * n.x * n.x * a, s * b, -s * n.x);
+	outBitangent = float3(b, s + n.y * n.y * a, -n.y);
+}
+
+// Closest hit along [ray] nearer than [maxDistance], walking skip links as ComputeShader.hlsl does; returns the hit triangle, or
+// UINT32_MAX for misses; [anyHit] searches return the first hit they find instead (for shadow rays, which only need to know there is one)
+static uint32_t FirstHit(const TraceKernelScene& scene, const Ray& ray, float maxDistance, bool anyHit, float& outDistance)
+{
+	const Vertex3D* vts = static_cast<const Vertex3D*>(scene.vertices);
+	const IndexedTriangle* tris = static_cast<const IndexedTriangle*>(scene.tris);
+	const ComputeBVH_SkipNode* nodes = static_cast<const ComputeBVH_SkipNode*>(scene.nodes);
+
+	uint32_t hitTri = UINT32_MAX;
+	outDistance = maxDistance;
+
+	const ComputeBVH_SkipNode& root = nodes[0];
+	const uint end = (root.triCount == 0) ? root.skipOrFirstTri : 1;
+	uint nodeNdx = 0;
+	while (nodeNdx < end)
+	{
+		const ComputeBVH_SkipNode& node = nodes[nodeNdx];
+		if (!aabbHit(ray, node.boundsMin, node.boundsMax))
+		{
+			nodeNdx = (node.triCount == 0) ? node.skipOrFirstTri : nodeNdx + 1;
+			continue;
+		}
+
+		for (uint i = 0; i < node.triCount; i++)
+		{
+			const uint triNdx = scene.triList[node.skipOrFirstTri + i];
+			const IndexedTriangle& tri = tris[triNdx];
+			const float3x3 verts = float3x3(float3(vts[tri.xyz.x].pos.x, vts[tri.xyz.x].pos.y, vts[tri.xyz.x].pos.z),
+											float3(vts[tri.xyz.y].pos.x, vts[tri.xyz.y].pos.y, vts[tri.xyz.y].pos.z),
+											float3(vts[tri.xyz.z].pos.x, vts[tri.xyz.z].pos.y, vts[tri.xyz.z].pos.z));
+
+			float distance = 0.0f;
+			float3 bary = float3(0.0f, 0.0f, 0.0f);
+			if (triHit(verts, ray, distance, bary) && distance < outDistance)
+			{
+				outDistance = distance;
+				hitTri = triNdx;
+				if (anyHit)
+				{
+					return hitTri;
+				}
+			}
+		}
+		nodeNdx++;
+	}
+	return hitTri;
+}
+
+// Corners of [triNdx]
+static float3x3 TriangleVerts(const TraceKernelScene& scene, uint32_t triNdx)
+{
+	const Vertex3D* vts = static_cast<const Vertex3D*>(scene.vertices);
+	const IndexedTriangle& tri = static_cast<const IndexedTriangle*>(scene.tris)[triNdx];
+	const float4 p0 = vts[tri.xyz.x].pos, p1 = vts[tri.xyz.y].pos, p2 = vts[tri.xyz.z].pos;
+	return float3x3(float3(p0.x, p0.y, p0.z), float3(p1.x, p1.y, p1.z), float3(p2.x, p2.y, p2.z));
+}
+
+// Front-face normal of the triangle [verts]; front faces are clockwise, as D3D culls them (and as the loaders wind every model,
+// flipping OBJ's counter-clockwise faces), so closed meshes' normals point out
+static float3 TriangleNormal(const float3x3& verts)
+{
+	return normalize(cross(verts[2] - verts[0], verts[1] - verts[0]));
+}
+
+// Geometric normal of [triNdx] (scene meshes needn't carry vertex normals), facing against [dir]; [outFrontFace] is true where it
+// didn't need flipping (rays entering closed meshes)
+static float3 FacingNormal(const TraceKernelScene& scene, uint32_t triNdx, float3 dir, bool& outFrontFace)
+{
+	const float3 n = TriangleNormal(TriangleVerts(scene, triNdx));
+	outFrontFace = !(dot(n, dir) > 0.0f);
+	return outFrontFace ? n : -n;
+}
+
+// Next-event estimation from [hitPoint]: picks an emitter through the alias table and a point on it, and returns the point's
+// MIS-weighted contribution (f * |cos| * radiance * weight / pdf, before throughput + spectral response) where a shadow ray reaches it
+// unoccluded; zero where it doesn't, or where the BxDF can't scatter towards it (delta lobes never can)
+static float SampleEmitter(const TraceKernelScene& scene, const TraceKernelSettings& settings, const BxDFParams& bxdf, float3 hitPoint, float3 normal,
+						   float3 tangent, float3 bitangent, float3 wo, GPU_PRNG_Channel& prngChannel, uint32_t& shadowRays)
+{
+	const EmitterAliasEntry* emitters = static_cast<const EmitterAliasEntry*>(scene.emitters);
+	float fraction = 0.0f;
+	const uint slot = EmitterTableSlot(rand(prngChannel), scene.numEmitters, fraction);
+	const EmitterAliasEntry& emitter = emitters[ResolveEmitterAlias(emitters[slot], slot, fraction)];
+	const float3x3 lightVerts = TriangleVerts(scene, emitter.tri);
+	const float3 lightPoint = SampleTrianglePoint(lightVerts[0], lightVerts[1], lightVerts[2], rand2d(prngChannel));
+
+	const float3 toLight = lightPoint - hitPoint;
+	const float distance = length(toLight);
+	const float3 wiWorld = toLight / distance;
+	const float lightPdf = EmitterSolidAnglePdf(emitter.pdf, emitter.area, distance, -dot(wiWorld, TriangleNormal(lightVerts)));
+	const float3 wi = float3(dot(wiWorld, tangent), dot(wiWorld, bitangent), dot(wiWorld, normal));
+	const float f = EvalBxDF(bxdf, wo, wi);
+	if (!(lightPdf > 0.0f && f > 0.0f))
+	{
+		return 0.0f;
+	}
+
+	// Shadow rays start off whichever side they leave (as bounces do), and stop short of the light by the same offset, so neither end
+	// finds its own surface
+	Ray shadowRay;
+	shadowRay.origin = hitPoint + normal * ((wi.z > 0.0f) ? settings.rayOffset : -settings.rayOffset);
+	const float3 shadowSpan = lightPoint - shadowRay.origin;
+	const float shadowLength = length(shadowSpan);
+	shadowRay.dir = shadowSpan / shadowLength;
+	ResolveRayTransforms(shadowRay);
+	float occluderDistance = 0.0f;
+	shadowRays++;
+	if (FirstHit(scene, shadowRay, shadowLength - settings.rayOffset, true, occluderDistance) != UINT32_MAX)
+	{
+		return 0.0f;
+	}
+	return f * std::fabs(wi.z) * emitter.radiance * PowerHeuristic(lightPdf, BxDFPdf(bxdf, wo, wi)) / lightPdf;
+}
+
+// ResolveHeroSpectralColor for [path] (with [radiance] per wavelength), four lookups at once: every wavelength's constraint index +
+// blend factor from one multiply, then one rgb lerp per wavelength; runs the shared code's operations in the same order, so it only
+// differs where the compiler fuses them differently. Wavelengths on the curve's last constraint take the shared code (their right
+// response depends on the curve's tail)
+static float3 ResolveHeroFilm(const FilmSPD_Piecewise& filmSPD, const TracePath& path, const float radiance[HERO_WAVELENGTHS])
+{
+	const float4 wavelengths = float4(path.spectralSamples[0], path.spectralSamples[1], path.spectralSamples[2], path.spectralSamples[3]);
+	const float4 pdfRatios = float4(path.pdfRatios[0], path.pdfRatios[1], path.pdfRatios[2], path.pdfRatios[3]);
+#ifdef TRACE_KERNEL_SSE
+	const __m128 intervals = _mm_mul_ps(_mm_set1_ps(static_cast<float>(MAX_FILM_CURVE_CONSTRAINT)), _mm_loadu_ps(path.spectralSamples));
+	const __m128i constraints = _mm_cvttps_epi32(intervals); // Truncation is floor here (wavelengths are never negative)
+	const __m128 blends = _mm_sub_ps(intervals, _mm_cvtepi32_ps(constraints));
+
+	alignas(16) uint32_t constraintNdx[HERO_WAVELENGTHS];
+	alignas(16) float blend[HERO_WAVELENGTHS];
+	_mm_store_si128(reinterpret_cast<__m128i*>(constraintNdx), constraints);
+	_mm_store_ps(blend, blends);
+	if (constraintNdx[0] < MAX_FILM_CURVE_CONSTRAINT && constraintNdx[1] < MAX_FILM_CURVE_CONSTRAINT &&
+		constraintNdx[2] < MAX_FILM_CURVE_CONSTRAINT && constraintNdx[3] < MAX_FILM_CURVE_CONSTRAINT)
+	{
+		__m128 film = _mm_setzero_ps();
+		for (uint32_t i = 0; i < HERO_WAVELENGTHS; i++)
+		{
+			const __m128 left = _mm_loadu_ps(&filmSPD.spd_sample[constraintNdx[i]].x);
+			const __m128 right = _mm_loadu_ps(&filmSPD.spd_sample[constraintNdx[i] + 1].x);
+			const __m128 response = _mm_add_ps(left, _mm_mul_ps(_mm_sub_ps(right, left), _mm_set1_ps(blend[i])));
+			const __m128 weighted = _mm_mul_ps(response, _mm_set1_ps(radiance[i]));
+			film = (i == 0) ? weighted : _mm_add_ps(film, weighted);
+		}
+		film = _mm_mul_ps(film, _mm_set1_ps(HeroMISWeight(pdfRatios)));
+
+		alignas(16) float rgb[4];
+		_mm_store_ps(rgb, film);
+		return float3(rgb[0], rgb[1], rgb[2]);
+	}
+#endif
+	return ResolveHeroSpectralColor(wavelengths, float4(radiance[0], radiance[1], radiance[2], radiance[3]), pdfRatios, filmSPD);
+}
+
+void BeginPath(const TraceKernelSettings& settings, uint32_t x, uint32_t y, TracePath* path)
+{
+	const float3 cameraPos = float3(settings.cameraPosition[0], settings.cameraPosition[1], settings.cameraPosition[2]);
+	const float4 cameraRotation = float4(settings.cameraRotation[0], settings.cameraRotation[1], settings.cameraRotation[2], settings.cameraRotation[3]);
+	const float2 imageDims = float2(static_cast<float>(settings.width), static_cast<float>(settings.height));
+
+	GPU_PRNG_Channel prngChannel;
+	for (uint32_t i = 0; i < GPU_PRNG_STREAM_STATE_SIZE; i++)
+	{
+		prngChannel.state[i] = path->prngState[i];
+	}
+
+	float spectralSample = 0.0f;
+	const float4 lensSample = RaySetup(float2(static_cast<float>(x), static_cast<float>(y)), settings.vfov, imageDims, static_cast<float>(settings.spp), prngChannel, spectralSample);
+	const float3 dir = Rotate(float3(lensSample.x, lensSample.y, lensSample.z), cameraRotation);
+	for (uint32_t a = 0; a < 3; a++)
+	{
+		path->origin[a] = cameraPos[a];
+		path->dir[a] = dir[a];
+	}
+	const float4 wavelengths = (settings.wavelengths == HERO_WAVELENGTHS) ? HeroWavelengths(spectralSample) : float4(spectralSample, 0.0f, 0.0f, 0.0f);
+	const float spectralSamples[HERO_WAVELENGTHS] = { wavelengths.x, wavelengths.y, wavelengths.z, wavelengths.w };
+	for (uint32_t i = 0; i < HERO_WAVELENGTHS; i++)
+	{
+		path->throughput[i] = 1.0f;
+		path->spectralSamples[i] = spectralSamples[i];
+		path->pdfRatios[i] = 1.0f;
+		path->radiance[i] = 0.0f;
+	}
+	path->filterWeight = lensSample.w;
+	path->bxdfPdf = 0.0f;
+	path->shadowRays = 0;
+	path->rouletteEnded = false;
+
+	for (uint32_t i = 0; i < GPU_PRNG_STREAM_STATE_SIZE; i++)
+	{
+		path->prngState[i] = prngChannel.state[i];
+	}
+}
+
+uint32_t TraceShaderRay(const TraceKernelScene& scene, const TracePath& path, float* outDistance)
+{
+	Ray ray;
+	ray.origin = float3(path.origin[0], path.origin[1], path.origin[2]);
+	ray.dir = float3(path.dir[0], path.dir[1], path.dir[2]);
+	ResolveRayTransforms(ray);
+	return FirstHit(scene, ray, 9999.0f, false, *outDistance); // As far as the shader's closest-hit search starts
+}
+
+bool ShadePath(const TraceKernelScene& scene, const TraceKernelSettings& settings, TracePath* path, uint32_t bounce, uint32_t hitTri, float distance, float outSums[4])
+{
+	const MaterialSPD_Piecewise surfaceSPD = {}; // Scene materials aren't resolved yet (ResolveMaterialSPDResponse is flat)
+	if (hitTri == UINT32_MAX)
+	{
+		for (uint32_t i = 0; i < settings.wavelengths; i++)
+		{
+			path->radiance[i] += path->throughput[i] * settings.skyRadiance;
+		}
+	}
+	else
+	{
+		const float3 origin = float3(path->origin[0], path->origin[1], path->origin[2]), dir = float3(path->dir[0], path->dir[1], path->dir[2]);
+		bool frontFace = true;
+		const float3 normal = FacingNormal(scene, hitTri, dir, frontFace);
+
+		// Emitters light paths reaching their front faces; where light sampling could have found the same point, the BxDF sample that
+		// did takes its power-heuristic share
+		const uint32_t emitterNdx = (scene.numEmitters > 0) ? scene.triEmitters[hitTri] : UINT32_MAX;
+		if (emitterNdx != UINT32_MAX && frontFace)
+		{
+			const EmitterAliasEntry& emitter = static_cast<const EmitterAliasEntry*>(scene.emitters)[emitterNdx];
+			const float weight = (settings.sampleLights && path->bxdfPdf > 0.0f) ?
+								 PowerHeuristic(path->bxdfPdf, EmitterSolidAnglePdf(emitter.pdf, emitter.area, distance, -dot(dir, normal))) : 1.0f;
+			for (uint32_t i = 0; i < settings.wavelengths; i++)
+			{
+				path->radiance[i] += path->throughput[i] * emitter.radiance * weight;
+			}
+		}
+
+		if (bounce < settings.maxBounces)
+		{
+			GPU_PRNG_Channel prngChannel;
+			for (uint32_t i = 0; i < GPU_PRNG_STREAM_STATE_SIZE; i++)
+			{
+				prngChannel.state[i] = path->prngState[i];
+			}
+
+			float3 tangent, bitangent;
+			TangentFrame(normal, tangent, bitangent);
+
+			BxDFParams bxdf;
+			bxdf.id = settings.bxdf;
+			bxdf.albedo = settings.albedo;
+			bxdf.roughness = settings.roughness;
+			bxdf.eta = (settings.bxdf == BXDF_ID_DIELECTRIC_ROUGH && !frontFace) ? 1.0f / settings.ior : settings.ior;
+			bxdf.k = settings.extinction;
+
+			const float3 wo = float3(-dot(dir, tangent), -dot(dir, bitangent), -dot(dir, normal));
+			const float3 hitPoint = origin + dir * distance;
+			if (settings.sampleLights && scene.numEmitters > 0)
+			{
+				const float lightSample = SampleEmitter(scene, settings, bxdf, hitPoint, normal, tangent, bitangent, wo, prngChannel, path->shadowRays);
+				for (uint32_t i = 0; i < settings.wavelengths && lightSample > 0.0f; i++)
+				{
+					path->radiance[i] += path->throughput[i] * lightSample * ResolveMaterialSPDResponse(path->spectralSamples[i], surfaceSPD);
+				}
+			}
+
+			const float2 u = rand2d(prngChannel);
+			const float uLobe = BxDFSamplesLobes(bxdf.id) ? rand(prngChannel) : 0.0f;
+			const BxDFSample sample = SampleBxDF(bxdf, wo, u, uLobe);
+			const bool roulette = settings.roulette && bounce >= settings.rouletteMinBounces;
+			const float uRoulette = roulette ? rand(prngChannel) : 0.0f;
+			for (uint32_t i = 0; i < GPU_PRNG_STREAM_STATE_SIZE; i++)
+			{
+				path->prngState[i] = prngChannel.state[i];
+			}
+
+			// Failed samples (reflections below the surface, etc.) end the path
+			if (sample.weight > 0.0f)
+			{
+				// No BxDF samples by wavelength (see SharedBxDFs.hlsli), so every wavelength takes the hero's sample at the same density,
+				// and [path->pdfRatios] stay as they are
+				for (uint32_t i = 0; i < settings.wavelengths; i++)
+				{
+					path->throughput[i] *= sample.weight * ResolveMaterialSPDResponse(path->spectralSamples[i], surfaceSPD);
+				}
+				path->bxdfPdf = sample.delta ? 0.0f : sample.pdf;
+
+				// Roulette keeps paths in proportion to the most they can still carry at any wavelength; survivors carry what the ones
+				// it ended would have, on average
+				float survival = 1.0f;
+				if (roulette)
+				{
+					float maxThroughput = 0.0f;
+					for (uint32_t i = 0; i < settings.wavelengths; i++)
+					{
+						maxThroughput = std::max(maxThroughput, path->throughput[i]);
+					}
+					survival = std::min(maxThroughput, 1.0f);
+				}
+
+				if (uRoulette < survival)
+				{
+					for (uint32_t i = 0; i < settings.wavelengths && roulette; i++)
+					{
+						path->throughput[i] /= survival;
+					}
+
+					// Transmitted rays start off the far side
+					const float3 bounceOrigin = hitPoint + normal * ((sample.wi.z > 0.0f) ? settings.rayOffset : -settings.rayOffset);
+					const float3 bounceDir = normalize(tangent * sample.wi.x + bitangent * sample.wi.y + normal * sample.wi.z);
+					for (uint32_t a = 0; a < 3; a++)
+					{
+						path->origin[a] = bounceOrigin[a];
+						path->dir[a] = bounceDir[a];
+					}
+					return true;
+				}
+				path->rouletteEnded = true;
+			}
+		}
+	}
+
+	const FilmSPD_Piecewise& filmSPD = *static_cast<const FilmSPD_Piecewise*>(scene.filmSPD);
+	const float3 film = (settings.wavelengths == HERO_WAVELENGTHS) ? ResolveHeroFilm(filmSPD, *path, path->radiance) * path->filterWeight :
+																	   ResolveSpectralColor(path->spectralSamples[0], filmSPD) * (path->radiance[0] * path->filterWeight);
+	outSums[0] += film.x;
+	outSums[1] += film.y;
+	outSums[2] += film.z;
+	outSums[3] += path->filterWeight;
+	return false;
+}
+
+uint64_t TracePixel(const TraceKernelScene& scene, const TraceKernelSettings& settings, uint32_t x, uint32_t y, uint32_t prngState[4], float outSums[4])
+{
+	TracePath path;
+	memcpy(path.prngState, prngState, sizeof(path.prngState));
+
+	uint64_t numRays = 0;
+	for (uint32_t s = 0; s < settings.spp; s++)
+	{
+		BeginPath(settings, x, y, &path);
+		for (uint32_t bounce = 0; ; bounce++)
+		{
+			numRays++;
+			float distance = 0.0f;
+			const uint32_t hitTri = TraceShaderRay(scene, path, &distance);
+			if (!ShadePath(scene, settings, &path, bounce, hitTri, distance, outSums))
+			{
+				break;
+			}
+		}
+		numRays += path.shadowRays;
+	}
+
+	memcpy(prngState, path.prngState, sizeof(path.prngState));
+	return numRays;
+}
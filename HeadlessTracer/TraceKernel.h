@@ -0,0 +1,100 @@
+#pragma once
+
+#include <stdint.h>
+
+// Per-pixel path tracing for the headless renderer, built from the same shared shader code as ComputeShader.hlsl (RaySetup, triHit,
+// aabbHit, ResolveSpectralColor, ResolveMaterialSPDResponse, HeroWavelengths, SampleBxDF); TraceKernel.cpp compiles that code as C++
+// in its own namespace, so this interface only passes scene data through its shared GPU layouts
+// - Camera rays come from RaySetup (jittered + filter-weighted, with one spectral sample each), turned by the camera's rotation; paths
+//   either keep that one wavelength (as the compute path does) or take it as the hero of HERO_WAVELENGTHS (see
+//   SharedHeroWavelengths.hlsli), rotated around the spectrum and averaged evenly
+// - Geometry is traced through the skip-linked BVH, exactly as the compute path walks it; vertices are taken as given, so callers bake
+//   any model transforms into them first (the headless renderer does, for every model)
+// - Every surface takes one BxDF from SharedBxDFs.hlsli (Lambert by default), sampled in a tangent frame around the geometric normal,
+//   and the sky is uniform; each path's radiance is scaled by the film's response at each of its wavelengths, and paths end when they
+//   escape, run out of bounces, draw a failed BxDF sample, or (with [TraceKernelSettings::roulette]) lose at Russian roulette
+// - Roulette starts after [TraceKernelSettings::rouletteMinBounces]: paths survive each bounce with their brightest wavelength's
+//   throughput as the probability (capped at one), and survivors divide their throughput by it, so dim paths end early without
+//   biasing the image; [TraceKernelSettings::maxBounces] still caps every path
+// - Scenes can also hold emissive triangles (see EmitterTable.h), which light paths that hit their front faces; with
+//   [TraceKernelSettings::sampleLights], every bounce also samples one through the emitter table and traces a shadow ray to it
+//   (next-event estimation), weighing both strategies with the power heuristic (see SharedLightSampling.hlsli); shadow rays are traced
+//   here through the shader traversal, whichever traversal traces a path's other rays
+// - Hero paths resolve their film response with SSE where it's available (one lerp across rgb per wavelength, matching the shared
+//   code's operations in order); builds without it, or defining TRACE_KERNEL_SIMD_SCALAR, use ResolveHeroSpectralColor as written
+struct TraceKernelScene
+{
+	const void* vertices; // GeoTypes::Vertex3D
+	const void* tris; // IndexedTriangle
+	const void* nodes; // ComputeBVH_SkipNode, as StacklessBVH stores them
+	const uint32_t* triList;
+	const void* filmSPD; // FilmSPD_Piecewise
+	const void* emitters; // EmitterAliasEntry, as EmitterTable lays them out
+	const uint32_t* triEmitters; // Each triangle's emitter, or UINT32_MAX
+	uint32_t numEmitters;
+};
+
+struct TraceKernelSettings
+{
+	uint32_t width, height;
+	uint32_t spp;
+	float vfov; // Radians
+	float cameraPosition[3];
+	float cameraRotation[4]; // Quaternion (sin(0.5 * angle) * axis, cos(0.5 * angle))
+	float albedo; // Scales every surface's spectral response
+	float skyRadiance;
+	uint32_t maxBounces;
+	float rayOffset; // Bounced rays start this far off their surface (triHit has no minimum distance, so they'd hit it again)
+	uint32_t wavelengths; // Per path: 1 (the compute path's single spectral sample) or [traceKernelHeroWavelengths]
+	uint32_t bxdf; // BXDF_ID_* (see SharedBxDFs.hlsli)
+	float roughness;
+	float ior; // Dielectrics' inside over outside, or conductors' real ior
+	float extinction; // Conductors' imaginary ior
+	bool sampleLights; // Next-event estimation, for scenes with emitters; without it, only BxDF samples find them
+	bool roulette; // Russian roulette; without it, paths run until they escape, fail a sample, or reach [maxBounces]
+	uint32_t rouletteMinBounces; // Bounces every path takes before roulette can end it
+};
+
+constexpr uint32_t traceKernelHeroWavelengths = 4; // HERO_WAVELENGTHS, for code outside the shared headers
+
+// The BxDFs surfaces can take, by name (their ids come from SharedBxDFs.hlsli, which only TraceKernel.cpp can include)
+struct TraceKernelBxDF
+{
+	const char* name;
+	uint32_t id;
+};
+constexpr uint32_t traceKernelNumBxDFs = 5;
+extern const TraceKernelBxDF traceKernelBxDFs[traceKernelNumBxDFs]; // Lambert first
+
+// One path between bounces: the ray it traces next, and what it has gathered so far
+// - Paths run in stages (camera ray, then trace + shade per bounce), so drivers can trace whole batches of paths at once through
+//   other traversals (see RenderDriver.h's tracing modes) and still shade exactly as [TracePixel] does
+struct TracePath
+{
+	float origin[3], dir[3]; // In the vertices' space; [dir] is unit length
+	float throughput[traceKernelHeroWavelengths]; // Per wavelength; single-wavelength paths only use the first
+	float spectralSamples[traceKernelHeroWavelengths]; // The hero first
+	float pdfRatios[traceKernelHeroWavelengths]; // Each wavelength's path pdf over the hero's; always 1, since nothing samples by wavelength yet
+	float radiance[traceKernelHeroWavelengths]; // Gathered so far, per wavelength
+	float bxdfPdf; // Solid-angle pdf of the BxDF sample [dir] came from, for MIS at emitters it hits; zero for camera rays + delta samples
+	uint32_t shadowRays; // Traced so far this sample
+	bool rouletteEnded; // Russian roulette ended the path (rather than an escape, a failed sample, or the bounce limit)
+	float filterWeight;
+	uint32_t prngState[4]; // The pixel's xoshiro128+ stream (see SharedPRNG_Code.h), carried from sample to sample
+};
+
+// Starts the next sample through pixel [x, y] at [path] (with the pixel's stream already in [path->prngState]): its camera ray, from RaySetup
+void BeginPath(const TraceKernelSettings& settings, uint32_t x, uint32_t y, TracePath* path);
+
+// Closest hit along [path]'s ray through the skip-linked BVH, as ComputeShader.hlsl walks it; misses return UINT32_MAX
+uint32_t TraceShaderRay(const TraceKernelScene& scene, const TracePath& path, float* outDistance);
+
+// Shades [path]'s hit ([hitTri] at [distance]; UINT32_MAX for misses) after [bounce] bounces; returns true with the bounced ray in
+// [path], or false once the path has ended, after adding its filter-weighted film response to [outSums] (rgb) and its filter weight to
+// [outSums[3]]
+bool ShadePath(const TraceKernelScene& scene, const TraceKernelSettings& settings, TracePath* path, uint32_t bounce, uint32_t hitTri, float distance, float outSums[4]);
+
+// Trace [settings.spp] samples through pixel [x, y] (one path at a time, through the stages above), adding to [outSums] as [ShadePath]
+// does; [prngState] is the pixel's stream, and comes back advanced
+// Returns the number of rays traced (camera rays + bounces + shadow rays)
+uint64_t TracePixel(const TraceKernelScene& scene, const TraceKernelSettings& settings, uint32_t x, uint32_t y, uint32_t prngState[4], float outSums[4]);
@@ -0,0 +1,786 @@
+#include "TraceKernel.h"
+#include "ProgressiveFilm.h"
+#include "AdaptiveSampler.h"
+#include "EmitterTable.h"
+#include "ImageIO.h"
+#include "RenderDriver.h"
+#include "RenderReport.h"
+#include "../CPUMemory.h"
+#include "../SandboxApp/Scene.h"
+#include "../SandboxApp/SceneBuffers.h"
+#include "../SandboxApp/SceneLoader.h"
+#include "../SandboxApp/Bounds.h"
+#include "../SandboxApp/BVH.h"
+#include "../SandboxApp/StacklessBVH.h"
+#include "../SandboxApp/PacketBVH.h"
+#include "../SandboxApp/TileScheduler.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+
+// Headless CPU reference renderer: loads a DXRSS scene (or a single OBJ/DXRS model) through Scene + SceneLoader, builds the compute
+// path's skip-linked BVH, and path traces it with the shared shader code (see TraceKernel.h) on every hardware thread
+// - Pixels own their PRNG streams, seeded from [--seed] and the pixel's index alone, so images are identical for any thread count
+// - Renders can run progressively ([--pass]): the film keeps every pixel's stream + running mean/variance between passes (see
+//   ProgressiveFilm.h), and passes stop at a relative-error target ([--error]) or time budget ([--time]); a film that reaches N spp
+//   holds exactly the one-pass N spp image
+// - Paths carry one wavelength (as the compute path's do) or four hero wavelengths averaged evenly ([--spectral hero]; see
+//   SharedHeroWavelengths.hlsli); surfaces all take one BxDF from SharedBxDFs.hlsli ([--bxdf], Lambert by default)
+// - Paths run to [--bounces], or end earlier by Russian roulette on their throughput once they've taken [--roulette] bounces; every
+//   render reports how many bounces its paths took
+// - Models are traced in world space: each one's transform (translation, rotation + scale) is baked into its vertices after loading;
+//   the compute path doesn't apply model transforms yet, so the two only agree for scenes whose models sit at the identity
+// - Light models ([--light]) join the scene as emitters, placed by their own translation + scale, and every triangle they load becomes
+//   an emitter with [--emission] radiance; paths find them by BxDF sampling alone, or with next-event estimation through a
+//   power-weighted (or uniform) alias table ([--light-sampling])
+// - Tiles run on a TileScheduler pool, dealt along a Hilbert curve by default ([--order]); [--scaling] renders with 1, 2, 4.. threads
+//   up to the full count, and reports speedup + parallel efficiency against one thread (checking every image matches; see
+//   RenderReport.h)
+// - Paths advance a bounce at a time over tiles of pixels, so each bounce depth's rays can be traced together (see RenderDriver.h);
+//   [--mode] picks how: through the shader's skip-link traversal (the reference), one ray at a time through PacketBVH, with camera
+//   rays in NxN packets (frustum-culled; bounces one at a time), or as a wavefront (camera packets, then each depth's bounces sorted
+//   into streams); [--mode compare] renders with each and reports Mrays/s per depth against single rays
+// - Images come out the way the sandbox presents them (rows flipped from RaySetup's +y-down film; see ImageIO.h); .pfm keeps the raw
+//   film response, .ppm clamps it to 8 bits
+
+using Clock = std::chrono::steady_clock;
+
+constexpr uint64_t maxVerts = 1024 * 1024; // As Geo's scene mirrors
+constexpr uint64_t maxTris = maxVerts;
+constexpr uint32_t progressiveMaxSpp = 65536; // Progressive renders' sample cap, without [--spp]
+constexpr uint32_t defaultPassSpp = 4;
+constexpr uint32_t minErrorSpp = 8; // Variance estimates from fewer samples are too noisy to stop on (or to plan adaptive passes with)
+constexpr uint32_t maxAdaptivePassScale = 8; // Adaptive passes give any one pixel at most this many times the pass's mean spp
+constexpr uint32_t maxLights = 8; // Light models per render
+
+static const char* tileOrderNames[] = { "row", "morton", "hilbert" };
+static const char* lightSamplingNames[] = { "bsdf", "uniform", "power" }; // BxDF sampling only, or NEE through either table weighting
+
+struct LightModel
+{
+	const char* path;
+	float position[3];
+	float scale;
+};
+
+struct Options
+{
+	const char* scenePath = nullptr;
+	const char* outPath = "headless.pfm";
+	uint32_t width = 640, height = 480;
+	uint32_t spp = 0; // Zero for the scene's own
+	uint64_t seed = 1;
+	uint32_t threads = 0; // Zero for one per hardware thread
+	uint32_t bounces = 8;
+	bool roulette = false;
+	uint32_t rouletteMinBounces = 3; // Bounces before roulette can end a path
+	float albedo = 0.75f;
+	float sky = 1.0f;
+	float fovDegrees = 0.0f; // Zero for the scene's own
+	uint32_t wavelengths = 1; // Per path: one (as the compute path samples) or hero wavelengths (see SharedHeroWavelengths.hlsli)
+	uint32_t bxdf = 0; // Index into traceKernelBxDFs
+	float roughness = 0.5f;
+	float ior = 1.5f;
+	float extinction = 3.0f;
+	LightModel lights[maxLights] = {};
+	uint32_t numLights = 0;
+	float emission = 10.0f; // Light models' radiance
+	uint32_t lightSampling = 2; // Index into lightSamplingNames
+	bool cameraSet = false;
+	float camera[3] = {};
+	TraceMode mode = TraceMode::Shader;
+	bool compare = false; // Render with every mode
+	uint32_t packetSide = 8; // Camera packets hold packetSide x packetSide rays
+	uint32_t tileSize = 64; // Pixels per tile side; each tile's paths (one sample at a time) form a depth's packets/streams
+	TileScheduler::TileOrder tileOrder = TileScheduler::TileOrder::Hilbert;
+	bool scaling = false; // Render at 1, 2, 4.. threads
+	uint32_t passSpp = 0; // Samples per progressive pass; zero renders every sample in one pass
+	float targetError = 0.0f; // Stop passes once the film's relative error reaches this (zero for no target)
+	float timeBudget = 0.0f; // Seconds; stop passes before the next would overrun this (zero for no budget)
+	bool adaptive = false; // Spread progressive passes' samples by estimated error (see AdaptiveSampler.h)
+	uint32_t adaptiveTile = 8; // Pixels per adaptive tile side
+	const char* heatmapPath = nullptr; // Per-pixel sample counts
+	const char* referencePath = nullptr; // PFM to measure the render's relMSE against
+};
+
+static void PrintUsage()
+{
+	fprintf(stderr, "usage: HeadlessTracer <scene.dxrss | model.obj | model.dxrs> [options]\n"
+					"  --out <path.pfm|path.ppm>  output image (default headless.pfm)\n"
+					"  --width <n> --height <n>   image size (default 640x480)\n"
+					"  --spp <n>                  samples per pixel (default: the scene's, or 16)\n"
+					"  --seed <n>                 PRNG seed (default 1)\n"
+					"  --threads <n>              worker threads (default: one per hardware thread)\n"
+					"  --bounces <n>              bounces after the camera ray (default 8); the cap on roulette paths too\n"
+					"  --roulette <n>             end paths by Russian roulette on their throughput after n bounces (default off)\n"
+					"  --albedo <f>               surface reflectance (default 0.75)\n"
+					"  --sky <f>                  sky radiance (default 1)\n"
+					"  --fov <degrees>            vertical field of view (default: the scene's)\n"
+					"  --spectral <name>          wavelengths per path: single (default, as the compute path) or hero (4, averaged)\n"
+					"  --bxdf <name>              surface BxDF: lambert (default), oren-nayar, mirror, conductor (GGX), or dielectric (rough)\n"
+					"  --roughness <f>            oren-nayar/conductor/dielectric roughness (default 0.5)\n"
+					"  --ior <f>                  dielectric ior, or conductor's real ior (default 1.5)\n"
+					"  --extinction <f>           conductor's imaginary ior (default 3)\n"
+					"  --light <model> <x> <y> <z> <scale>\n"
+					"                             add an emissive model, placed at x y z and scaled (up to 8)\n"
+					"  --emission <f>             light models' radiance (default 10)\n"
+					"  --light-sampling <name>    bsdf (light models are only found by bounces), or next-event estimation\n"
+					"                             picking emitters uniformly or by power (default)\n"
+					"  --camera <x> <y> <z>       camera position (default: the scene's; model files are framed from -z)\n"
+					"  --mode <name>              traversal: shader (default), single, packet, wavefront, or compare (all of them, with\n"
+					"                             Mrays/s per bounce depth; writes the shader image)\n"
+					"  --packet <4|8>             camera packet size for packet/wavefront modes (default 8x8)\n"
+					"  --tile <n>                 tile size in pixels (default 64)\n"
+					"  --order <name>             tile order: row, morton, or hilbert (default)\n"
+					"  --scaling                  render at 1, 2, 4.. threads up to --threads, with speedups over one thread\n"
+					"  --pass <n>                 render progressively, n samples per pixel per pass (default 4 with --error/--time)\n"
+					"  --error <f>                stop passes once the film's relative error reaches f\n"
+					"  --time <seconds>           stop passes before the next would overrun this budget\n"
+					"                             (progressive renders stop at --spp mean samples per pixel, or 65536 without it)\n"
+					"  --adaptive                 spread progressive passes' samples over tiles by estimated error\n"
+					"  --adaptive-tile <n>        adaptive tile size in pixels (default 8)\n"
+					"  --heatmap <path.pfm|.ppm>  write per-pixel sample counts (raw in .pfm, scaled to the maximum in .ppm)\n"
+					"  --reference <path.pfm>     report the render's relMSE against this image\n");
+}
+
+static bool ParseOptions(int argc, char** argv, Options* outOptions)
+{
+	Options& options = *outOptions;
+	for (int i = 1; i < argc; i++)
+	{
+		const char* arg = argv[i];
+		const bool hasValue = (i + 1 < argc);
+		if (arg[0] != '-')
+		{
+			options.scenePath = arg;
+		}
+		else if (strcmp(arg, "--out") == 0 && hasValue)
+		{
+			options.outPath = argv[++i];
+		}
+		else if (strcmp(arg, "--width") == 0 && hasValue)
+		{
+			options.width = static_cast<uint32_t>(atoi(argv[++i]));
+		}
+		else if (strcmp(arg, "--height") == 0 && hasValue)
+		{
+			options.height = static_cast<uint32_t>(atoi(argv[++i]));
+		}
+		else if (strcmp(arg, "--spp") == 0 && hasValue)
+		{
+			options.spp = static_cast<uint32_t>(atoi(argv[++i]));
+		}
+		else if (strcmp(arg, "--seed") == 0 && hasValue)
+		{
+			options.seed = strtoull(argv[++i], nullptr, 10);
+		}
+		else if (strcmp(arg, "--threads") == 0 && hasValue)
+		{
+			options.threads = static_cast<uint32_t>(atoi(argv[++i]));
+		}
+		else if (strcmp(arg, "--bounces") == 0 && hasValue)
+		{
+			options.bounces = static_cast<uint32_t>(atoi(argv[++i]));
+		}
+		else if (strcmp(arg, "--roulette") == 0 && hasValue)
+		{
+			options.roulette = true;
+			options.rouletteMinBounces = static_cast<uint32_t>(atoi(argv[++i]));
+		}
+		else if (strcmp(arg, "--albedo") == 0 && hasValue)
+		{
+			options.albedo = static_cast<float>(atof(argv[++i]));
+		}
+		else if (strcmp(arg, "--sky") == 0 && hasValue)
+		{
+			options.sky = static_cast<float>(atof(argv[++i]));
+		}
+		else if (strcmp(arg, "--fov") == 0 && hasValue)
+		{
+			options.fovDegrees = static_cast<float>(atof(argv[++i]));
+		}
+		else if (strcmp(arg, "--spectral") == 0 && hasValue)
+		{
+			const char* name = argv[++i];
+			if (strcmp(name, "single") == 0 || strcmp(name, "hero") == 0)
+			{
+				options.wavelengths = (strcmp(name, "hero") == 0) ? traceKernelHeroWavelengths : 1;
+			}
+			else
+			{
+				fprintf(stderr, "unrecognised spectral sampling %s\n", name);
+				return false;
+			}
+		}
+		else if (strcmp(arg, "--bxdf") == 0 && hasValue)
+		{
+			const char* name = argv[++i];
+			bool known = false;
+			for (uint32_t b = 0; b < traceKernelNumBxDFs; b++)
+			{
+				if (strcmp(name, traceKernelBxDFs[b].name) == 0)
+				{
+					options.bxdf = b;
+					known = true;
+				}
+			}
+			if (!known)
+			{
+				fprintf(stderr, "unrecognised BxDF %s\n", name);
+				return false;
+			}
+		}
+		else if (strcmp(arg, "--roughness") == 0 && hasValue)
+		{
+			options.roughness = static_cast<float>(atof(argv[++i]));
+		}
+		else if (strcmp(arg, "--ior") == 0 && hasValue)
+		{
+			options.ior = static_cast<float>(atof(argv[++i]));
+		}
+		else if (strcmp(arg, "--extinction") == 0 && hasValue)
+		{
+			options.extinction = static_cast<float>(atof(argv[++i]));
+		}
+		else if (strcmp(arg, "--light") == 0 && i + 5 < argc)
+		{
+			if (options.numLights == maxLights)
+			{
+				fprintf(stderr, "scenes take up to %u light models\n", maxLights);
+				return false;
+			}
+			LightModel& light = options.lights[options.numLights++];
+			light.path = argv[++i];
+			for (uint32_t a = 0; a < 3; a++)
+			{
+				light.position[a] = static_cast<float>(atof(argv[++i]));
+			}
+			light.scale = static_cast<float>(atof(argv[++i]));
+		}
+		else if (strcmp(arg, "--emission") == 0 && hasValue)
+		{
+			options.emission = static_cast<float>(atof(argv[++i]));
+		}
+		else if (strcmp(arg, "--light-sampling") == 0 && hasValue)
+		{
+			const char* name = argv[++i];
+			bool known = false;
+			for (uint32_t l = 0; l < 3; l++)
+			{
+				if (strcmp(name, lightSamplingNames[l]) == 0)
+				{
+					options.lightSampling = l;
+					known = true;
+				}
+			}
+			if (!known)
+			{
+				fprintf(stderr, "unrecognised light sampling %s\n", name);
+				return false;
+			}
+		}
+		else if (strcmp(arg, "--camera") == 0 && i + 3 < argc)
+		{
+			options.cameraSet = true;
+			for (uint32_t a = 0; a < 3; a++)
+			{
+				options.camera[a] = static_cast<float>(atof(argv[++i]));
+			}
+		}
+		else if (strcmp(arg, "--mode") == 0 && hasValue)
+		{
+			const char* name = argv[++i];
+			options.compare = (strcmp(name, "compare") == 0);
+			bool known = options.compare;
+			for (uint32_t m = 0; m < static_cast<uint32_t>(TraceMode::Count); m++)
+			{
+				if (strcmp(name, traceModeNames[m]) == 0)
+				{
+					options.mode = static_cast<TraceMode>(m);
+					known = true;
+				}
+			}
+			if (!known)
+			{
+				fprintf(stderr, "unrecognised mode %s\n", name);
+				return false;
+			}
+		}
+		else if (strcmp(arg, "--packet") == 0 && hasValue)
+		{
+			options.packetSide = static_cast<uint32_t>(atoi(argv[++i]));
+			if (options.packetSide != 4 && options.packetSide != 8)
+			{
+				fprintf(stderr, "packets are 4x4 or 8x8\n");
+				return false;
+			}
+		}
+		else if (strcmp(arg, "--tile") == 0 && hasValue)
+		{
+			options.tileSize = static_cast<uint32_t>(atoi(argv[++i]));
+			if (options.tileSize == 0 || options.tileSize > 256)
+			{
+				fprintf(stderr, "tiles are 1 to 256 pixels square\n");
+				return false;
+			}
+		}
+		else if (strcmp(arg, "--order") == 0 && hasValue)
+		{
+			const char* name = argv[++i];
+			bool known = false;
+			for (uint32_t o = 0; o < 3; o++)
+			{
+				if (strcmp(name, tileOrderNames[o]) == 0)
+				{
+					options.tileOrder = static_cast<TileScheduler::TileOrder>(o);
+					known = true;
+				}
+			}
+			if (!known)
+			{
+				fprintf(stderr, "unrecognised tile order %s\n", name);
+				return false;
+			}
+		}
+		else if (strcmp(arg, "--scaling") == 0)
+		{
+			options.scaling = true;
+		}
+		else if (strcmp(arg, "--pass") == 0 && hasValue)
+		{
+			options.passSpp = static_cast<uint32_t>(atoi(argv[++i]));
+		}
+		else if (strcmp(arg, "--error") == 0 && hasValue)
+		{
+			options.targetError = static_cast<float>(atof(argv[++i]));
+		}
+		else if (strcmp(arg, "--time") == 0 && hasValue)
+		{
+			options.timeBudget = static_cast<float>(atof(argv[++i]));
+		}
+		else if (strcmp(arg, "--adaptive") == 0)
+		{
+			options.adaptive = true;
+		}
+		else if (strcmp(arg, "--adaptive-tile") == 0 && hasValue)
+		{
+			options.adaptiveTile = std::max(atoi(argv[++i]), 1);
+		}
+		else if (strcmp(arg, "--heatmap") == 0 && hasValue)
+		{
+			options.heatmapPath = argv[++i];
+		}
+		else if (strcmp(arg, "--reference") == 0 && hasValue)
+		{
+			options.referencePath = argv[++i];
+		}
+		else
+		{
+			fprintf(stderr, "unrecognised option %s\n", arg);
+			return false;
+		}
+	}
+	if (options.scaling && options.compare)
+	{
+		fprintf(stderr, "--scaling renders one mode\n");
+		return false;
+	}
+	if (options.passSpp == 0 && (options.targetError > 0.0f || options.timeBudget > 0.0f || options.adaptive))
+	{
+		options.passSpp = defaultPassSpp;
+	}
+	if (options.passSpp > 0 && (options.scaling || options.compare))
+	{
+		fprintf(stderr, "progressive renders don't compare modes or thread counts\n");
+		return false;
+	}
+	return options.scenePath != nullptr && options.width > 0 && options.height > 0;
+}
+
+int main(int argc, char** argv)
+{
+	Options options;
+	if (!ParseOptions(argc, argv, &options))
+	{
+		PrintUsage();
+		return 1;
+	}
+
+	for (uint32_t l = 0; l <= options.numLights; l++)
+	{
+		const char* path = (l == 0) ? options.scenePath : options.lights[l - 1].path;
+		FILE* file = fopen(path, "rb");
+		if (file == nullptr)
+		{
+			fprintf(stderr, "couldn't open %s\n", path);
+			return 1;
+		}
+		fclose(file);
+	}
+
+	CPUMemory::Init();
+	const Clock::time_point loadStart = Clock::now();
+
+	// Scenes load through the same paths as the sandbox; single models become one-model scenes with the default camera/film
+	const bool isSceneFile = EndsWith(options.scenePath, ".dxrss");
+	CPUMemory::ArrayAllocHandle<Scene::Model> models = {};
+	if (!isSceneFile)
+	{
+		models = CPUMemory::AllocateArray<Scene::Model>(1);
+		models[0].path = options.scenePath;
+		models[0].fmt = EndsWith(options.scenePath, ".obj") ? OBJ : DXRS;
+		models[0].transformations.translationAndScale = float4(0.0f, 0.0f, 0.0f, 1.0f);
+		models[0].transformations.rotation = float4(0.0f, 0.0f, 0.0f, 1.0f);
+	}
+	Scene scene = isSceneFile ? Scene(options.scenePath) : Scene(models, 1);
+	const uint32_t firstLightModel = scene.numModels;
+	for (uint32_t l = 0; l < options.numLights; l++)
+	{
+		const LightModel& light = options.lights[l];
+		Scene::Model model;
+		model.path = light.path;
+		model.fmt = EndsWith(light.path, ".obj") ? OBJ : DXRS;
+		model.transformations.translationAndScale = float4(light.position[0], light.position[1], light.position[2], light.scale);
+		model.transformations.rotation = float4(0.0f, 0.0f, 0.0f, 1.0f);
+		scene.AddModel(model);
+	}
+
+	SceneBuffers mirror;
+	LoadScene(scene, mirror, maxVerts, maxTris);
+
+	// Every model (light models included) is traced where its world transform puts it, so transforms are baked into the vertices here
+	GeoTypes::Vertex3D* sceneVts = reinterpret_cast<GeoTypes::Vertex3D*>(&mirror.BufferContents(SceneBuffers::VBUFFER)[0]);
+	for (uint32_t m = 0; m < mirror.NumModels(); m++)
+	{
+		TransformVertices(&sceneVts[mirror.ModelFirstVert(m)].pos, mirror.ModelNumVerts(m), sizeof(GeoTypes::Vertex3D), scene.graph.GetWorldTransform(m));
+	}
+	const uint32_t numTris = static_cast<uint32_t>(mirror.NumTris());
+	if (numTris == 0)
+	{
+		fprintf(stderr, "%s has no triangles\n", options.scenePath);
+		return 1;
+	}
+
+	const Clock::time_point buildStart = Clock::now();
+	const GeoTypes::Vertex3D* vts = reinterpret_cast<const GeoTypes::Vertex3D*>(&mirror.BufferContents(SceneBuffers::VBUFFER)[0]);
+	const IndexedTriangle* tris = reinterpret_cast<const IndexedTriangle*>(&mirror.BufferContents(SceneBuffers::TRIBUFFER)[0]);
+	uint64_t numLightTris = 0;
+	for (uint32_t m = firstLightModel; m < mirror.NumModels(); m++)
+	{
+		numLightTris += mirror.ModelNumTris(m);
+	}
+	EmitterTable emitters;
+	emitters.Init(numLightTris);
+	for (uint32_t m = firstLightModel; m < mirror.NumModels(); m++)
+	{
+		emitters.AddTriangles(vts, tris, mirror.ModelFirstTri(m), mirror.ModelNumTris(m), options.emission);
+	}
+	emitters.Build((options.lightSampling == 1) ? EmitterTable::Weighting::Uniform : EmitterTable::Weighting::Power, numTris);
+
+	BVH bvh;
+	bvh.BuildBinnedSAH(&vts[0].pos, mirror.NumVerts(), sizeof(GeoTypes::Vertex3D), tris, numTris, BVH::BinnedSAHSettings());
+	StacklessBVH stackless;
+	stackless.Build(bvh, &vts[0].pos, mirror.NumVerts(), sizeof(GeoTypes::Vertex3D), tris);
+
+	// PacketBVH modes trace a tree with leaves sized to fill their 8-wide triangle packets
+	const bool needsPacketBVH = options.compare || options.mode != TraceMode::Shader;
+	PacketBVH packetBVH;
+	if (needsPacketBVH)
+	{
+		BVH::BinnedSAHSettings packetSettings;
+		packetSettings.leafTris = 8;
+		packetSettings.maxLeafTris = 16;
+		BVH packetSource;
+		packetSource.BuildBinnedSAH(&vts[0].pos, mirror.NumVerts(), sizeof(GeoTypes::Vertex3D), tris, numTris, packetSettings);
+		packetBVH.Build(packetSource, &vts[0].pos, mirror.NumVerts(), sizeof(GeoTypes::Vertex3D), tris);
+		packetSource.DeInit();
+	}
+	bvh.DeInit();
+
+	// Freeing the source BVHs moved the encodings allocated after them, so their addresses are only resolved from here on
+	const ComputeBVH_SkipNode* nodes = &stackless.Nodes()[0];
+
+	TraceKernelScene kernelScene;
+	kernelScene.vertices = vts;
+	kernelScene.tris = tris;
+	kernelScene.nodes = nodes;
+	kernelScene.triList = &stackless.TriList()[0];
+	kernelScene.filmSPD = &scene.filmCMF;
+	kernelScene.emitters = emitters.Entries();
+	kernelScene.triEmitters = emitters.TriEmitters();
+	kernelScene.numEmitters = emitters.NumEmitters();
+
+	TraceKernelSettings settings;
+	settings.width = options.width;
+	settings.height = options.height;
+	const bool progressive = (options.passSpp > 0);
+	settings.spp = (options.spp > 0) ? options.spp : (progressive ? progressiveMaxSpp : ((isSceneFile && scene.spp > 0) ? scene.spp : 16));
+	settings.vfov = (options.fovDegrees > 0.0f) ? options.fovDegrees * (3.14159265f / 180.0f) : scene.vfov;
+	settings.albedo = options.albedo;
+	settings.skyRadiance = options.sky;
+	settings.maxBounces = options.bounces;
+	settings.roulette = options.roulette;
+	settings.rouletteMinBounces = options.rouletteMinBounces;
+	settings.wavelengths = options.wavelengths;
+	settings.bxdf = traceKernelBxDFs[options.bxdf].id;
+	settings.roughness = options.roughness;
+	settings.ior = options.ior;
+	settings.extinction = options.extinction;
+	settings.sampleLights = (options.lightSampling != 0);
+
+	// Framing + ray offsets work from the BVH's root bounds, which cover the baked (world-space) vertices
+	const float3 boundsMin = nodes[0].boundsMin, boundsMax = nodes[0].boundsMax;
+	const float centre[3] = { 0.5f * (boundsMin.x + boundsMax.x), 0.5f * (boundsMin.y + boundsMax.y), 0.5f * (boundsMin.z + boundsMax.z) };
+	const float extent[3] = { boundsMax.x - boundsMin.x, boundsMax.y - boundsMin.y, boundsMax.z - boundsMin.z };
+	const float radius = 0.5f * std::sqrt(extent[0] * extent[0] + extent[1] * extent[1] + extent[2] * extent[2]);
+	settings.rayOffset = 1e-4f * radius;
+
+	const float4 cameraRotation = scene.cameraRotation;
+	settings.cameraRotation[0] = cameraRotation.x;
+	settings.cameraRotation[1] = cameraRotation.y;
+	settings.cameraRotation[2] = cameraRotation.z;
+	settings.cameraRotation[3] = cameraRotation.w;
+	if (options.cameraSet)
+	{
+		memcpy(settings.cameraPosition, options.camera, sizeof(options.camera));
+	}
+	else if (isSceneFile)
+	{
+		settings.cameraPosition[0] = scene.cameraPosition.x;
+		settings.cameraPosition[1] = scene.cameraPosition.y;
+		settings.cameraPosition[2] = scene.cameraPosition.z;
+	}
+	else
+	{
+		// Back off along -z (the film looks down +z) until the bounding sphere fits the vertical field of view
+		settings.cameraPosition[0] = centre[0];
+		settings.cameraPosition[1] = centre[1];
+		settings.cameraPosition[2] = centre[2] - radius / std::sin(0.5f * settings.vfov);
+		for (uint32_t i = 0; i < 4; i++)
+		{
+			settings.cameraRotation[i] = (i == 3) ? 1.0f : 0.0f;
+		}
+	}
+
+	const Clock::time_point renderStart = Clock::now();
+	RenderContext context;
+	context.kernelScene = &kernelScene;
+	context.settings = &settings;
+	context.packetBVH = &packetBVH;
+	context.packetSide = options.packetSide;
+	context.tileSize = options.tileSize;
+	context.tileOrder = options.tileOrder;
+	const uint32_t numThreads = std::min((options.threads > 0) ? options.threads : std::max(std::thread::hardware_concurrency(), 1u), TileScheduler::maxThreads);
+	context.InitTiles(numThreads);
+
+	// Films and images come out of CPUMemory's pool after the scene, so check the most a render holds at once fits before starting: two
+	// films while scaling runs + comparisons render (the one-thread film, or the shader film + single rays' sums, beside the current
+	// one), or adaptive passes' sample counts + tile errors beside the film; then the written film, its resolved image, and the
+	// reference (heatmaps reuse the image's buffer)
+	const uint64_t numPixels = static_cast<uint64_t>(settings.width) * settings.height;
+	const uint64_t renderBytes = ((options.scaling || options.compare) ? 2 : 1) * ProgressiveFilm::bytesPerPixel + (options.compare ? 4 * sizeof(float) : 0) +
+								 (options.adaptive ? sizeof(uint32_t) + sizeof(double) : 0);
+	const uint64_t reportBytes = ProgressiveFilm::bytesPerPixel + ((options.referencePath != nullptr) ? 2 : 1) * 3 * sizeof(float);
+	const uint64_t filmBytes = numPixels * std::max(renderBytes, reportBytes);
+	if (filmBytes > CPUMemory::BytesAvailable())
+	{
+		fprintf(stderr, "%ux%u films need %.1fMiB, and only %.1fMiB are left after the scene\n", settings.width, settings.height, filmBytes / (1024.0 * 1024.0),
+				CPUMemory::BytesAvailable() / (1024.0 * 1024.0));
+		return 1;
+	}
+
+	// Comparisons render with every mode; the shader traversal's image is the one written, and [film] holds it
+	RenderResult results[static_cast<uint32_t>(TraceMode::Count)];
+	double relativeErrors[static_cast<uint32_t>(TraceMode::Count)] = {};
+	uint32_t numDiffering[static_cast<uint32_t>(TraceMode::Count)] = {};
+	bool rendered[static_cast<uint32_t>(TraceMode::Count)] = {};
+	for (RenderResult& result : results)
+	{
+		result.Init(settings.maxBounces + 1);
+	}
+	ScalingStep scalingSteps[maxScalingSteps];
+	uint32_t numScalingSteps = 0;
+	const uint32_t writtenMode = static_cast<uint32_t>(options.compare ? TraceMode::Shader : options.mode);
+	ProgressiveFilm film;
+	double filmSpp = settings.spp; // Mean samples per pixel the written film holds
+	uint32_t numPasses = 1;
+	TileScheduler scheduler;
+	context.scheduler = &scheduler;
+	if (options.scaling)
+	{
+		numScalingSteps = RenderScaling(context, options.mode, settings.spp, numThreads, options.seed, &film, &results[writtenMode], scalingSteps);
+	}
+	else if (progressive)
+	{
+		// Passes of [passSpp] samples per pixel (on average, for adaptive passes) until the film converges to [--error], the next pass
+		// would overrun [--time], or it holds [settings.spp] samples per pixel on average; pass boundaries don't change what each pixel's
+		// samples are, so uniform films match a one-pass render of however many samples they reached
+		// - Adaptive renders take uniform passes until every pixel has [minErrorSpp] samples (so there are variance estimates to go
+		//   on), then let AdaptiveSampler plan each pass
+		RenderResult& total = results[writtenMode];
+		film.Init(settings.width, settings.height, options.seed);
+		scheduler.Init(numThreads);
+		AdaptiveSampler sampler;
+		CPUMemory::ArrayAllocHandle<uint32_t> pixelSamples;
+		if (options.adaptive)
+		{
+			sampler.Init(settings.width, settings.height, options.adaptiveTile);
+			pixelSamples = CPUMemory::AllocateArray<uint32_t>(numPixels);
+		}
+		RenderResult pass;
+		pass.Init(settings.maxBounces + 1);
+		const uint64_t maxSamples = settings.spp * numPixels;
+		uint64_t filmSamples = 0;
+		uint32_t uniformSpp = 0;
+		numPasses = 0;
+		printf("%-6s %10s %10s %12s %14s\n", "pass", "mean spp", "ms", "rel. error", "bounces/path");
+		while (filmSamples < maxSamples)
+		{
+			if (options.adaptive && uniformSpp >= minErrorSpp)
+			{
+				const uint64_t budget = std::min(options.passSpp * numPixels, maxSamples - filmSamples);
+				const uint64_t planned = sampler.Plan(film, budget, options.passSpp * maxAdaptivePassScale, pixelSamples);
+				if (planned == 0)
+				{
+					break;
+				}
+				Render(context, options.mode, 0, &film, &pass, &pixelSamples[0]);
+				filmSamples += planned;
+			}
+			else
+			{
+				const uint32_t passSpp = static_cast<uint32_t>(std::min<uint64_t>(options.passSpp, (maxSamples - filmSamples) / numPixels));
+				Render(context, options.mode, passSpp, &film, &pass);
+				uniformSpp += passSpp;
+				filmSamples += passSpp * numPixels;
+			}
+			AddPass(&total, pass, numPasses == 0);
+			filmSpp = static_cast<double>(filmSamples) / numPixels;
+			numPasses++;
+
+			const double error = film.RelativeError();
+			printf("%-6u %10.2f %10.1f %12.5f %14.2f\n", numPasses, filmSpp, total.renderMs, error, MeanPathBounces(pass));
+			if (options.targetError > 0.0f && uniformSpp >= minErrorSpp && error <= options.targetError)
+			{
+				break;
+			}
+			if (options.timeBudget > 0.0f && total.renderMs + pass.renderMs > options.timeBudget * 1000.0)
+			{
+				break;
+			}
+		}
+		pass.DeInit();
+		if (options.adaptive)
+		{
+			CPUMemory::Free(pixelSamples);
+			sampler.DeInit();
+		}
+		scheduler.DeInit();
+	}
+	else if (options.compare)
+	{
+		scheduler.Init(numThreads);
+		RenderComparison(context, settings.spp, options.seed, &film, results, relativeErrors, numDiffering);
+		scheduler.DeInit();
+		for (bool& modeRendered : rendered)
+		{
+			modeRendered = true;
+		}
+	}
+	else
+	{
+		scheduler.Init(numThreads);
+		film.Init(settings.width, settings.height, options.seed);
+		Render(context, options.mode, settings.spp, &film, &results[writtenMode]);
+		scheduler.DeInit();
+	}
+	rendered[writtenMode] = true;
+	relativeErrors[writtenMode] = film.RelativeError();
+
+	CPUMemory::ArrayAllocHandle<float> rgb = CPUMemory::AllocateArray<float>(numPixels * 3);
+	film.Resolve(rgb);
+	const bool written = WriteImage(options.outPath, rgb, settings.width, settings.height);
+
+	auto ms = [](Clock::time_point a, Clock::time_point b) { return std::chrono::duration<double, std::milli>(b - a).count(); };
+	printf("%s: %llu verts, %u tris, %u BVH nodes", options.scenePath, static_cast<unsigned long long>(mirror.NumVerts()), numTris, stackless.NumNodes());
+	needsPacketBVH ? printf(" (%u packet BVH nodes, %u leaf packets)\n", packetBVH.NumNodes(), packetBVH.NumPackets()) : printf("\n");
+	printf("load %.1fms, BVH build %.1fms\n", ms(loadStart, buildStart), ms(buildStart, renderStart));
+	if (options.numLights > 0)
+	{
+		printf("%u emitters from %u light models (power %.4g), light sampling: %s\n", emitters.NumEmitters(), options.numLights, emitters.Power(),
+			   lightSamplingNames[options.lightSampling]);
+	}
+	for (uint32_t m = 0; m < static_cast<uint32_t>(TraceMode::Count); m++)
+	{
+		if (!rendered[m])
+		{
+			continue;
+		}
+		const RenderResult& modeResult = results[m];
+		printf("%s render %ux%u @ %.4g spp, %u bounces, %s, %u wavelengths, %u threads: %.1fms, %llu rays (%.2f Mrays/s, %.2f Msamples/s), relative error %.5f\n", traceModeNames[m],
+			   settings.width, settings.height, filmSpp, settings.maxBounces, traceKernelBxDFs[options.bxdf].name, settings.wavelengths, modeResult.numThreads, modeResult.renderMs, static_cast<unsigned long long>(modeResult.totalRays),
+			   modeResult.totalRays / (modeResult.renderMs * 1000.0), (static_cast<double>(settings.width) * settings.height * filmSpp) / (modeResult.renderMs * 1000.0),
+			   relativeErrors[m]);
+		if (modeResult.shadowRays > 0)
+		{
+			printf("  %llu shadow rays (%.2f per sample)\n", static_cast<unsigned long long>(modeResult.shadowRays),
+				   modeResult.shadowRays / (static_cast<double>(settings.width) * settings.height * filmSpp));
+		}
+		PrintPathBounces(modeResult, settings);
+		printf("  %u %ux%u tiles per pass (%s order), %u passes, %u steals moving %u tiles, %u-%u tiles per thread per pass\n", modeResult.tileStats.numTiles,
+			   options.tileSize, options.tileSize, tileOrderNames[static_cast<uint32_t>(options.tileOrder)], numPasses, modeResult.tileStats.numSteals, modeResult.tileStats.stolenTiles,
+			   modeResult.tileStats.minThreadTiles, modeResult.tileStats.maxThreadTiles);
+	}
+	if (options.scaling)
+	{
+		PrintScalingReport(scalingSteps, numScalingSteps);
+	}
+	if (options.compare)
+	{
+		PrintModeDifferences(numDiffering);
+		PrintDepthReport(results, rendered);
+	}
+	if (options.referencePath != nullptr)
+	{
+		PrintReferenceError(options.referencePath, rgb, settings.width, settings.height);
+	}
+
+	bool heatmapWritten = true;
+	if (options.heatmapPath != nullptr)
+	{
+		// The resolved image has been written + measured by now, so its buffer takes the heatmap
+		SampleHeatmap(film, !EndsWith(options.heatmapPath, ".pfm"), rgb);
+		heatmapWritten = WriteImage(options.heatmapPath, rgb, settings.width, settings.height);
+		heatmapWritten ? printf("wrote %s\n", options.heatmapPath) : fprintf(stderr, "couldn't write %s\n", options.heatmapPath);
+	}
+	if (!written)
+	{
+		fprintf(stderr, "couldn't write %s\n", options.outPath);
+	}
+	else
+	{
+		printf("wrote %s\n", options.outPath);
+	}
+
+	CPUMemory::Free(rgb);
+	film.DeInit();
+	for (RenderResult& result : results)
+	{
+		result.DeInit();
+	}
+	context.DeInitTiles();
+	if (needsPacketBVH)
+	{
+		packetBVH.DeInit();
+	}
+	stackless.DeInit();
+	emitters.DeInit();
+	mirror.DeInit();
+	CPUMemory::DeInit();
+	return (written && heatmapWritten) ? 0 : 1;
+}
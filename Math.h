@@ -10,6 +10,7 @@
 using matrix = glm::mat4x4;
 using vec4 = glm::vec4;
 using float4 = glm::vec4;
+using float3 = glm::vec3;
 using frac = glm::frac;
 
 #define vec4FromFloat4(f4) f4
@@ -21,6 +22,7 @@ using frac = glm::frac;
 using matrix = DirectX::XMMATRIX;
 using vec4 = DirectX::XMVECTOR;
 using float4 = DirectX::XMFLOAT4;
+using float3 = DirectX::XMFLOAT3;
 using uint4 = DirectX::XMUINT4;
 #define cross DirectX::XMVector3Cross
 
@@ -33,6 +35,59 @@ using uint4 = DirectX::XMUINT4;
 
 #define normalize(u) DirectX::XMVector3Normalize(u)
 
+#else
+
+// Headless builds without DirectXMath (e.g. HeadlessTracer on Linux); plain structs with the same layouts as the DX12 types above,
+// and scalar versions of the few vector ops CPU code uses
+#include <stdint.h>
+
+struct float4
+{
+	float x, y, z, w;
+	float4() = default;
+	constexpr float4(float _x, float _y, float _z, float _w) : x(_x), y(_y), z(_z), w(_w) {}
+};
+
+struct float3
+{
+	float x, y, z;
+	float3() = default;
+	constexpr float3(float _x, float _y, float _z) : x(_x), y(_y), z(_z) {}
+};
+
+struct uint4
+{
+	uint32_t x, y, z, w;
+	uint4() = default;
+	constexpr uint4(uint32_t _x, uint32_t _y, uint32_t _z, uint32_t _w) : x(_x), y(_y), z(_z), w(_w) {}
+};
+
+struct vec4
+{
+	float x, y, z, w;
+};
+
+namespace ScalarMath
+{
+	inline vec4 Cross3(vec4 u, vec4 v) { return vec4({ u.y * v.z - u.z * v.y, u.z * v.x - u.x * v.z, u.x * v.y - u.y * v.x, 0.0f }); }
+	inline vec4 Normalize3(vec4 u)
+	{
+		const float len = std::sqrt(u.x * u.x + u.y * u.y + u.z * u.z);
+		return vec4({ u.x / len, u.y / len, u.z / len, u.w / len }); // XMVector3Normalize scales all four lanes
+	}
+}
+
+#define cross ScalarMath::Cross3
+
+#define vec4FromFloat4(f4) vec4({ (f4)->x, (f4)->y, (f4)->z, (f4)->w })
+#define float4FromVec4(f4, v4) *(f4) = float4((v4).x, (v4).y, (v4).z, (v4).w)
+
+#define vec4Subtract(u, v) vec4({ (u).x - (v).x, (u).y - (v).y, (u).z - (v).z, (u).w - (v).w })
+#define vec4Add(u, v) vec4({ (u).x + (v).x, (u).y + (v).y, (u).z + (v).z, (u).w + (v).w })
+#define vec4Div(u, v) vec4({ (u).x / (v).x, (u).y / (v).y, (u).z / (v).z, (u).w / (v).w })
+
+#define normalize(u) ScalarMath::Normalize3(u)
+
 #endif
 
 #ifndef SHADER_MATH
@@ -0,0 +1,676 @@
+#include "ASReport.h"
+#include "BVH.h"
+#include "StacklessBVH.h"
+#include "WideBVH.h"
+#include "SparseOctree.h"
+#include "Intersection.h"
+
+#include <algorithm>
+#include <bit>
+#include <cassert>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+
+// Generic tree every structure is flattened into, in depth-first preorder (so a node's subtree is [index, subtreeEnd))
+struct ReportNode
+{
+	float bmin[3], bmax[3];
+	uint32_t firstChild, numChildren; // Into [ReportTree::children]
+	uint32_t numSlots; // Branching factor (zero for leaves)
+	uint32_t firstRef, numRefs; // Into the structure's triangle list (leaves)
+	uint32_t depth;
+	uint32_t subtreeEnd;
+};
+
+struct ReportTree
+{
+	ReportNode* nodes;
+	uint32_t numNodes;
+	uint32_t* children;
+	uint32_t numChildren;
+	const uint32_t* triList;
+};
+
+// Node waiting to be flattened; [childSlot] is where its generic index goes in [ReportTree::children] (none for the root)
+struct FlattenItem
+{
+	uint32_t source; // Structure-specific (see each Flatten*)
+	uint32_t depth;
+	uint32_t childSlot;
+	float bmin[3], bmax[3];
+	uint32_t firstRef, numRefs;
+};
+
+static ReportNode& EmitNode(ReportTree& tree, const FlattenItem& item, const float* bmin, const float* bmax)
+{
+	const uint32_t ndx = tree.numNodes++;
+	if (item.childSlot != UINT32_MAX)
+	{
+		tree.children[item.childSlot] = ndx;
+	}
+
+	ReportNode& node = tree.nodes[ndx];
+	memset(&node, 0, sizeof(node));
+	memcpy(node.bmin, bmin, sizeof(node.bmin));
+	memcpy(node.bmax, bmax, sizeof(node.bmax));
+	node.depth = item.depth;
+	return node;
+}
+
+static void EmitEmptyTree(ReportTree& tree)
+{
+	const float bmin[3] = { FLT_MAX, FLT_MAX, FLT_MAX }, bmax[3] = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+	FlattenItem root = {};
+	root.childSlot = UINT32_MAX;
+	EmitNode(tree, root, bmin, bmax);
+}
+
+// Binary trees (ComputeBVH_Node/ComputeBVH_SkipNode); [rightChild] and [firstTri] decode the encoding
+template<typename Node, typename RightChildFn, typename FirstTriFn>
+static void FlattenBinary(const Node* nodes, RightChildFn rightChild, FirstTriFn firstTri, ReportTree& tree, FlattenItem* stack)
+{
+	uint32_t stackSize = 1;
+	stack[0] = {};
+	stack[0].childSlot = UINT32_MAX;
+	while (stackSize > 0)
+	{
+		const FlattenItem item = stack[--stackSize];
+		const Node& source = nodes[item.source];
+		ReportNode& node = EmitNode(tree, item, &source.boundsMin.x, &source.boundsMax.x);
+		if (source.triCount > 0)
+		{
+			node.firstRef = firstTri(source);
+			node.numRefs = source.triCount;
+			continue;
+		}
+
+		node.firstChild = tree.numChildren;
+		node.numChildren = 2;
+		node.numSlots = 2;
+		tree.numChildren += 2;
+
+		// Right first, so the left subtree is emitted first
+		const uint32_t children[2] = { item.source + 1, rightChild(item.source) };
+		for (uint32_t i = 2; i-- > 0;)
+		{
+			FlattenItem& child = stack[stackSize++];
+			child = {};
+			child.source = children[i];
+			child.depth = item.depth + 1;
+			child.childSlot = node.firstChild + i;
+		}
+	}
+}
+
+// Wide BVH nodes ([source] is the wide node), plus their leaf slots ([source] is UINT32_MAX, with bounds + triangles in the item)
+static void FlattenWide(const WideBVH& bvh, ReportTree& tree, FlattenItem* stack)
+{
+	const ComputeWideBVH_Node* nodes = &bvh.Nodes()[0];
+	uint32_t stackSize = 1;
+	stack[0] = {};
+	stack[0].childSlot = UINT32_MAX;
+	for (uint32_t a = 0; a < 3; a++)
+	{
+		stack[0].bmin[a] = FLT_MAX;
+		stack[0].bmax[a] = -FLT_MAX;
+	}
+
+	const uint8_t* rootMeta = reinterpret_cast<const uint8_t*>(nodes[0].meta);
+	for (uint32_t slot = 0; slot < WideBVH::width; slot++)
+	{
+		if (rootMeta[slot] != 0)
+		{
+			float bmin[3], bmax[3];
+			WideBVH::ChildBounds(nodes[0], slot, bmin, bmax);
+			for (uint32_t a = 0; a < 3; a++)
+			{
+				stack[0].bmin[a] = std::min(stack[0].bmin[a], bmin[a]);
+				stack[0].bmax[a] = std::max(stack[0].bmax[a], bmax[a]);
+			}
+		}
+	}
+
+	while (stackSize > 0)
+	{
+		const FlattenItem item = stack[--stackSize];
+		ReportNode& node = EmitNode(tree, item, item.bmin, item.bmax);
+		if (item.source == UINT32_MAX)
+		{
+			node.firstRef = item.firstRef;
+			node.numRefs = item.numRefs;
+			continue;
+		}
+
+		const ComputeWideBVH_Node& source = nodes[item.source];
+		const uint8_t* meta = reinterpret_cast<const uint8_t*>(source.meta);
+		const uint32_t imask = source.exponentsAndImask >> 24;
+		node.firstChild = tree.numChildren;
+		node.numSlots = WideBVH::width;
+		for (uint32_t slot = 0; slot < WideBVH::width; slot++)
+		{
+			node.numChildren += (meta[slot] != 0) ? 1 : 0;
+		}
+		tree.numChildren += node.numChildren;
+
+		// Pushed in reverse, so slots are emitted in order
+		uint32_t childNdx = node.numChildren;
+		for (uint32_t slot = WideBVH::width; slot-- > 0;)
+		{
+			if (meta[slot] == 0)
+			{
+				continue;
+			}
+
+			FlattenItem& child = stack[stackSize++];
+			child = {};
+			child.depth = item.depth + 1;
+			child.childSlot = node.firstChild + (--childNdx);
+			WideBVH::ChildBounds(source, slot, child.bmin, child.bmax);
+			if (imask & (1u << slot))
+			{
+				child.source = source.childBase + static_cast<uint32_t>(std::popcount(imask & ((1u << slot) - 1)));
+			}
+			else
+			{
+				child.source = UINT32_MAX;
+				child.firstRef = source.triBase + (meta[slot] & 0x1f);
+				child.numRefs = static_cast<uint32_t>(std::popcount(static_cast<uint32_t>(meta[slot] >> 5)));
+			}
+		}
+	}
+}
+
+static void FlattenOctree(const SparseOctree& octree, ReportTree& tree, FlattenItem* stack)
+{
+	const ComputeAS_Node* nodes = &octree.Nodes()[0];
+	uint32_t stackSize = 1;
+	stack[0] = {};
+	stack[0].childSlot = UINT32_MAX;
+	while (stackSize > 0)
+	{
+		const FlattenItem item = stack[--stackSize];
+		const ComputeAS_Node& source = nodes[item.source];
+		ReportNode& node = EmitNode(tree, item, &source.boundsMin.x, &source.boundsMax.x);
+		if (source.childMask == 0)
+		{
+			node.firstRef = source.firstChild + 1;
+			node.numRefs = tree.triList[source.firstChild];
+			continue;
+		}
+
+		node.firstChild = tree.numChildren;
+		node.numChildren = static_cast<uint32_t>(std::popcount(source.childMask));
+		node.numSlots = 8;
+		tree.numChildren += node.numChildren;
+		for (uint32_t i = node.numChildren; i-- > 0;)
+		{
+			FlattenItem& child = stack[stackSize++];
+			child = {};
+			child.source = source.firstChild + i;
+			child.depth = item.depth + 1;
+			child.childSlot = node.firstChild + i;
+		}
+	}
+}
+
+static double HalfArea(const float* bmin, const float* bmax)
+{
+	const double dx = std::max(bmax[0] - bmin[0], 0.0f), dy = std::max(bmax[1] - bmin[1], 0.0f), dz = std::max(bmax[2] - bmin[2], 0.0f);
+	return dx * dy + dy * dz + dz * dx;
+}
+
+static double TriangleArea(const double* v0, const double* v1, const double* v2)
+{
+	const double e0[3] = { v1[0] - v0[0], v1[1] - v0[1], v1[2] - v0[2] }, e1[3] = { v2[0] - v0[0], v2[1] - v0[1], v2[2] - v0[2] };
+	const double c[3] = { e0[1] * e1[2] - e0[2] * e1[1], e0[2] * e1[0] - e0[0] * e1[2], e0[0] * e1[1] - e0[1] * e1[0] };
+	return 0.5 * std::sqrt(c[0] * c[0] + c[1] * c[1] + c[2] * c[2]);
+}
+
+// Area of the part of triangle [verts] inside the box (Sutherland-Hodgman against each slab plane); each plane adds a vertex at most
+static double ClippedArea(const double (&verts)[3][3], const float* bmin, const float* bmax)
+{
+	double poly[9][3], clipped[9][3];
+	uint32_t numVerts = 3;
+	memcpy(poly, verts, sizeof(verts));
+	for (uint32_t plane = 0; plane < 6 && numVerts > 0; plane++)
+	{
+		const uint32_t a = plane / 2;
+		const bool isMax = (plane % 2) == 1;
+		const double bound = isMax ? bmax[a] : bmin[a];
+		auto inside = [&](const double* v) { return isMax ? (v[a] <= bound) : (v[a] >= bound); };
+
+		uint32_t numClipped = 0;
+		for (uint32_t i = 0; i < numVerts; i++)
+		{
+			const double* cur = poly[i];
+			const double* next = poly[(i + 1) % numVerts];
+			const bool curIn = inside(cur), nextIn = inside(next);
+			if (curIn)
+			{
+				memcpy(clipped[numClipped++], cur, sizeof(clipped[0]));
+			}
+			if (curIn != nextIn)
+			{
+				const double s = (bound - cur[a]) / (next[a] - cur[a]);
+				for (uint32_t k = 0; k < 3; k++)
+				{
+					clipped[numClipped][k] = cur[k] + s * (next[k] - cur[k]);
+				}
+				clipped[numClipped][a] = bound;
+				numClipped++;
+			}
+		}
+		memcpy(poly, clipped, numClipped * sizeof(clipped[0]));
+		numVerts = numClipped;
+	}
+
+	double area = 0.0;
+	for (uint32_t i = 1; i + 1 < numVerts; i++)
+	{
+		area += TriangleArea(poly[0], poly[i], poly[i + 1]);
+	}
+	return area;
+}
+
+// Everything but memory + ray statistics, from the flattened tree
+static void Summarise(const ReportTree& tree, uint32_t numTris, const float4* positions, uint64_t strideBytes, const IndexedTriangle* tris, const ASReport::Settings& settings,
+					  ASReport::Report* report)
+{
+	ReportNode* nodes = tree.nodes;
+	for (uint32_t n = tree.numNodes; n-- > 0;)
+	{
+		nodes[n].subtreeEnd = n + 1;
+		for (uint32_t c = nodes[n].firstChild; c < nodes[n].firstChild + nodes[n].numChildren; c++)
+		{
+			nodes[n].subtreeEnd = std::max(nodes[n].subtreeEnd, nodes[tree.children[c]].subtreeEnd);
+		}
+	}
+
+	const double rootArea = HalfArea(nodes[0].bmin, nodes[0].bmax);
+	double sahCost = 0.0;
+	uint64_t numSlots = 0, numUsedSlots = 0;
+	for (uint32_t n = 0; n < tree.numNodes; n++)
+	{
+		const ReportNode& node = nodes[n];
+		const double areaRatio = (numTris > 0 && rootArea > 0.0) ? HalfArea(node.bmin, node.bmax) / rootArea : 1.0;
+		const uint32_t depthBin = std::min(node.depth, ASReport::maxDepthBins - 1);
+		report->depth = std::max(report->depth, node.depth);
+		if (node.numSlots == 0)
+		{
+			report->numLeaves++;
+			report->leavesPerDepth[depthBin]++;
+			report->leafOccupancy[std::min(node.numRefs, ASReport::leafOccupancyBins - 1)]++;
+			report->maxLeafTris = std::max(report->maxLeafTris, node.numRefs);
+			report->emptyLeaves += (node.numRefs == 0) ? 1 : 0;
+			report->numTriRefs += node.numRefs;
+			sahCost += areaRatio * node.numRefs * settings.triangleCost;
+		}
+		else
+		{
+			report->numInterior++;
+			report->interiorPerDepth[depthBin]++;
+			numSlots += node.numSlots;
+			numUsedSlots += node.numChildren;
+			sahCost += areaRatio * settings.traversalCost;
+		}
+	}
+	report->sahCost = static_cast<float>(sahCost);
+	report->meanLeafTris = (report->numLeaves > 0) ? static_cast<float>(static_cast<double>(report->numTriRefs) / report->numLeaves) : 0.0f;
+	report->emptySlotFraction = (numSlots > 0) ? static_cast<float>(static_cast<double>(numSlots - numUsedSlots) / numSlots) : 0.0f;
+	report->epo = -1.0f;
+	if (!settings.computeEPO || numTris == 0)
+	{
+		return;
+	}
+
+	// Leaves listing each triangle (usually one), so subtree membership is a range check
+	auto leafStarts = CPUMemory::AllocateArray<uint32_t>(numTris + 1);
+	auto triLeaves = CPUMemory::AllocateArray<uint32_t>(std::max<uint64_t>(report->numTriRefs, 1));
+	auto stack = CPUMemory::AllocateArray<uint32_t>(tree.numNodes);
+	uint32_t* starts = &leafStarts[0];
+	uint32_t* leaves = &triLeaves[0];
+	uint32_t* pending = &stack[0];
+	memset(starts, 0, (numTris + 1) * sizeof(uint32_t));
+	for (uint32_t n = 0; n < tree.numNodes; n++)
+	{
+		for (uint32_t i = nodes[n].firstRef; i < nodes[n].firstRef + nodes[n].numRefs; i++)
+		{
+			starts[tree.triList[i] + 1]++;
+		}
+	}
+	for (uint32_t t = 0; t < numTris; t++)
+	{
+		starts[t + 1] += starts[t];
+	}
+	for (uint32_t n = 0; n < tree.numNodes; n++)
+	{
+		for (uint32_t i = nodes[n].firstRef; i < nodes[n].firstRef + nodes[n].numRefs; i++)
+		{
+			leaves[starts[tree.triList[i]]++] = n; // Advances each start to the next triangle's; shifted back below
+		}
+	}
+	for (uint32_t t = numTris; t > 0; t--)
+	{
+		starts[t] = starts[t - 1];
+	}
+	starts[0] = 0;
+
+	// Each triangle walks every box it overlaps, adding its clipped area wherever it isn't part of the subtree
+	const uint8_t* positionBytes = reinterpret_cast<const uint8_t*>(positions);
+	double totalArea = 0.0, overlapCost = 0.0;
+	for (uint32_t t = 0; t < numTris; t++)
+	{
+		const uint32_t ndx[3] = { tris[t].xyz.x, tris[t].xyz.y, tris[t].xyz.z };
+		double verts[3][3];
+		float triMin[3] = { FLT_MAX, FLT_MAX, FLT_MAX }, triMax[3] = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+		for (uint32_t k = 0; k < 3; k++)
+		{
+			const float4& v = *reinterpret_cast<const float4*>(positionBytes + ndx[k] * strideBytes);
+			const float p[3] = { v.x, v.y, v.z };
+			for (uint32_t a = 0; a < 3; a++)
+			{
+				verts[k][a] = p[a];
+				triMin[a] = std::min(triMin[a], p[a]);
+				triMax[a] = std::max(triMax[a], p[a]);
+			}
+		}
+		totalArea += TriangleArea(verts[0], verts[1], verts[2]);
+
+		uint32_t stackSize = 1;
+		pending[0] = 0;
+		while (stackSize > 0)
+		{
+			const ReportNode& node = nodes[pending[--stackSize]];
+			if (triMin[0] > node.bmax[0] || triMin[1] > node.bmax[1] || triMin[2] > node.bmax[2] || triMax[0] < node.bmin[0] || triMax[1] < node.bmin[1] ||
+				triMax[2] < node.bmin[2])
+			{
+				continue;
+			}
+
+			const uint32_t nodeNdx = static_cast<uint32_t>(&node - nodes);
+			bool inSubtree = false;
+			for (uint32_t i = starts[t]; i < starts[t + 1] && !inSubtree; i++)
+			{
+				inSubtree = (leaves[i] >= nodeNdx && leaves[i] < node.subtreeEnd);
+			}
+
+			if (!inSubtree)
+			{
+				const double area = ClippedArea(verts, node.bmin, node.bmax);
+				if (area <= 0.0)
+				{
+					continue; // Children sit inside their parents' boxes, so they can't overlap the triangle either
+				}
+				overlapCost += area * ((node.numSlots > 0) ? settings.traversalCost : settings.triangleCost * node.numRefs);
+			}
+
+			for (uint32_t c = node.firstChild; c < node.firstChild + node.numChildren; c++)
+			{
+				pending[stackSize++] = tree.children[c];
+			}
+		}
+	}
+	report->epo = (totalArea > 0.0) ? static_cast<float>(overlapCost / totalArea) : 0.0f;
+
+	CPUMemory::Free(stack);
+	CPUMemory::Free(triLeaves);
+	CPUMemory::Free(leafStarts);
+}
+
+// Flattens through [flatten] (into scratch sized for [maxNodes] generic nodes), then summarises
+template<typename FlattenFn>
+static void AnalyseTree(uint32_t maxNodes, const uint32_t* triList, uint32_t numTris, const float4* positions, uint64_t strideBytes, const IndexedTriangle* tris,
+						const ASReport::Settings& settings, ASReport::Report* report, FlattenFn flatten)
+{
+	auto nodes = CPUMemory::AllocateArray<ReportNode>(maxNodes);
+	auto children = CPUMemory::AllocateArray<uint32_t>(maxNodes);
+	auto stack = CPUMemory::AllocateArray<FlattenItem>(maxNodes);
+
+	ReportTree tree = {};
+	tree.nodes = &nodes[0];
+	tree.children = &children[0];
+	tree.triList = triList;
+	if (numTris == 0)
+	{
+		EmitEmptyTree(tree);
+	}
+	else
+	{
+		flatten(tree, &stack[0]);
+	}
+	assert(tree.numNodes <= maxNodes);
+
+	Summarise(tree, numTris, positions, strideBytes, tris, settings, report);
+
+	CPUMemory::Free(stack);
+	CPUMemory::Free(children);
+	CPUMemory::Free(nodes);
+}
+
+static void BeginReport(const char* structure, uint32_t numNodes, uint32_t numTris, const ASReport::Settings& settings, ASReport::Report* report)
+{
+	memset(report, 0, sizeof(*report));
+	report->label = settings.label;
+	report->structure = structure;
+	report->numNodes = numNodes;
+	report->numTris = numTris;
+	report->numRays = settings.numRays;
+}
+
+template<typename RayType>
+static RayType ConvertRay(const ASReport::Ray& ray)
+{
+	return { ray.origin, ray.dir, ray.tMin, ray.tMax };
+}
+
+static void FinishRays(uint64_t numNodesRead, uint64_t numTriTests, ASReport::Report* report)
+{
+	report->nodesPerRay = (report->numRays > 0) ? static_cast<float>(static_cast<double>(numNodesRead) / report->numRays) : 0.0f;
+	report->trisPerRay = (report->numRays > 0) ? static_cast<float>(static_cast<double>(numTriTests) / report->numRays) : 0.0f;
+}
+
+static void TraceStackless(const StacklessBVH& bvh, StacklessBVH::Traversal traversal, const ASReport::Settings& settings, ASReport::Report* report)
+{
+	uint64_t numNodesRead = 0, numTriTests = 0;
+	for (uint32_t r = 0; r < settings.numRays; r++)
+	{
+		StacklessBVH::Hit hit;
+		StacklessBVH::TraceCounts counts;
+		report->numHits += bvh.ClosestHit(ConvertRay<StacklessBVH::Ray>(settings.rays[r]), &hit, traversal, &counts) ? 1 : 0;
+		numNodesRead += counts.nodes;
+		numTriTests += counts.triTests;
+	}
+	FinishRays(numNodesRead, numTriTests, report);
+}
+
+void ASReport::Analyse(const BVH& bvh, const float4* positions, uint64_t strideBytes, const IndexedTriangle* tris, const Settings& settings, Report* outReport)
+{
+	BeginReport("binary BVH", bvh.NumNodes(), bvh.NumTris(), settings, outReport);
+	outReport->nodeBytes = bvh.GetStats().nodeBytes;
+	outReport->triListBytes = bvh.GetStats().triListBytes;
+
+	const ComputeBVH_Node* nodes = &bvh.Nodes()[0];
+	AnalyseTree(bvh.NumNodes(), &bvh.TriList()[0], bvh.NumTris(), positions, strideBytes, tris, settings, outReport, [&](ReportTree& tree, FlattenItem* stack)
+	{
+		FlattenBinary(nodes, [&](uint32_t n) { return nodes[n].rightOrFirstTri; }, [](const ComputeBVH_Node& node) { return node.rightOrFirstTri; }, tree, stack);
+	});
+
+	// Stack traversal over the skip-linked copy visits the same nodes as an ordered walk over this one
+	if (settings.numRays > 0)
+	{
+		StacklessBVH stackless;
+		stackless.Build(bvh, positions, UINT64_MAX, strideBytes, tris); // The vertex count isn't known here, so indices go unchecked
+		TraceStackless(stackless, StacklessBVH::Traversal::Stack, settings, outReport);
+		stackless.DeInit();
+	}
+}
+
+void ASReport::Analyse(const StacklessBVH& bvh, const float4* positions, uint64_t strideBytes, const IndexedTriangle* tris, const Settings& settings, Report* outReport)
+{
+	BeginReport("stackless BVH", bvh.NumNodes(), bvh.NumTris(), settings, outReport);
+	outReport->nodeBytes = static_cast<uint64_t>(bvh.NumNodes()) * sizeof(ComputeBVH_SkipNode);
+	outReport->triListBytes = static_cast<uint64_t>(bvh.TriListLen()) * sizeof(uint32_t);
+
+	const ComputeBVH_SkipNode* nodes = &bvh.Nodes()[0];
+	AnalyseTree(bvh.NumNodes(), &bvh.TriList()[0], bvh.NumTris(), positions, strideBytes, tris, settings, outReport, [&](ReportTree& tree, FlattenItem* stack)
+	{
+		FlattenBinary(nodes, [&](uint32_t n) { return StacklessBVH::RightChild(nodes, n); }, [](const ComputeBVH_SkipNode& node) { return node.skipOrFirstTri; }, tree,
+					  stack);
+	});
+	TraceStackless(bvh, StacklessBVH::Traversal::SkipLinks, settings, outReport);
+}
+
+void ASReport::Analyse(const WideBVH& bvh, const float4* positions, uint64_t strideBytes, const IndexedTriangle* tris, const Settings& settings, Report* outReport)
+{
+	const WideBVH::Stats& stats = bvh.GetStats();
+	BeginReport("8-wide BVH", bvh.NumNodes(), bvh.NumTris(), settings, outReport);
+	outReport->nodeBytes = stats.nodeBytes;
+	outReport->triListBytes = stats.triListBytes;
+	outReport->otherBytes = bvh.LeafTris().arrayLen * sizeof(IndexedTriangle);
+
+	// Every wide node, plus a generic leaf per leaf slot
+	const uint32_t maxNodes = bvh.NumNodes() * (WideBVH::width + 1);
+	AnalyseTree(maxNodes, &bvh.TriList()[0], bvh.NumTris(), positions, strideBytes, tris, settings, outReport, [&](ReportTree& tree, FlattenItem* stack)
+	{
+		FlattenWide(bvh, tree, stack);
+	});
+
+	// Logging without storage counts node/triangle list reads
+	uint64_t numNodesRead = 0, numTriTests = 0;
+	for (uint32_t r = 0; r < settings.numRays; r++)
+	{
+		WideBVH::Hit hit;
+		WideBVH::TraceLog log = {};
+		outReport->numHits += bvh.ClosestHit(ConvertRay<WideBVH::Ray>(settings.rays[r]), &hit, &log) ? 1 : 0;
+		numNodesRead += log.numNodes;
+		numTriTests += log.numTris;
+	}
+	FinishRays(numNodesRead, numTriTests, outReport);
+}
+
+void ASReport::Analyse(const SparseOctree& octree, const float4* positions, uint64_t strideBytes, const IndexedTriangle* tris, uint32_t numTris, const Settings& settings,
+					   Report* outReport)
+{
+	const SparseOctree::Stats& stats = octree.GetStats();
+	BeginReport("sparse octree", octree.NumNodes(), numTris, settings, outReport);
+	outReport->nodeBytes = stats.nodeBytes;
+	outReport->triListBytes = stats.triListBytes;
+
+	const uint32_t* triList = &octree.TriList()[0];
+	AnalyseTree(octree.NumNodes(), triList, numTris, positions, strideBytes, tris, settings, outReport, [&](ReportTree& tree, FlattenItem* stack)
+	{
+		FlattenOctree(octree, tree, stack);
+	});
+
+	// As ComputeShader.hlsl walks it (children pushed in reverse octant order, each popped node testing its own box), with distance culling
+	const ComputeAS_Node* nodes = &octree.Nodes()[0];
+	const uint8_t* positionBytes = reinterpret_cast<const uint8_t*>(positions);
+	uint64_t numNodesRead = 0, numTriTests = 0;
+	for (uint32_t r = 0; r < settings.numRays && numTris > 0; r++)
+	{
+		const Ray& ray = settings.rays[r];
+		const RayPrecomp rp = PrecomputeRay(ray.origin, ray.dir);
+		float tMax = ray.tMax;
+		bool found = false;
+
+		uint32_t stack[AS_OCTREE_STACK_SIZE];
+		uint32_t stackSize = 1;
+		stack[0] = 0;
+		while (stackSize > 0)
+		{
+			const ComputeAS_Node& node = nodes[stack[--stackSize]];
+			numNodesRead++;
+			float entry;
+			if (!RayBox(&node.boundsMin.x, &node.boundsMax.x, rp, ray.tMin, tMax, &entry))
+			{
+				continue;
+			}
+
+			if (node.childMask != 0)
+			{
+				const uint32_t numChildren = static_cast<uint32_t>(std::popcount(node.childMask));
+				for (uint32_t i = numChildren; i-- > 0;)
+				{
+					stack[stackSize++] = node.firstChild + i;
+				}
+				continue;
+			}
+
+			const uint32_t count = triList[node.firstChild];
+			numTriTests += count;
+			for (uint32_t i = node.firstChild + 1; i <= node.firstChild + count; i++)
+			{
+				const uint4& ndx = tris[triList[i]].xyz;
+				float t, u, v;
+				if (RayTriangle(rp, *reinterpret_cast<const float4*>(positionBytes + ndx.x * strideBytes), *reinterpret_cast<const float4*>(positionBytes + ndx.y * strideBytes),
+								*reinterpret_cast<const float4*>(positionBytes + ndx.z * strideBytes), ray.tMin, tMax, &t, &u, &v) && (!found || t < tMax))
+				{
+					tMax = t;
+					found = true;
+				}
+			}
+		}
+		outReport->numHits += found ? 1 : 0;
+	}
+	FinishRays(numNodesRead, numTriTests, outReport);
+}
+
+// Histogram entries up to the last non-zero one
+static void WriteHistogram(FILE* file, const uint32_t* bins, uint32_t numBins)
+{
+	uint32_t used = numBins;
+	while (used > 1 && bins[used - 1] == 0)
+	{
+		used--;
+	}
+
+	fprintf(file, "[");
+	for (uint32_t i = 0; i < used; i++)
+	{
+		fprintf(file, (i > 0) ? ", %u" : "%u", bins[i]);
+	}
+	fprintf(file, "]");
+}
+
+void ASReport::WriteJSON(const Report& report, FILE* file, uint32_t indent)
+{
+	char pad[16] = {};
+	memset(pad, '\t', std::min(indent, 14u));
+	const uint64_t totalBytes = report.nodeBytes + report.triListBytes + report.otherBytes;
+
+	fprintf(file, "%s{\n", pad);
+	fprintf(file, "%s\t\"label\": \"%s\",\n", pad, report.label);
+	fprintf(file, "%s\t\"structure\": \"%s\",\n", pad, report.structure);
+	fprintf(file, "%s\t\"nodes\": %u,\n", pad, report.numNodes);
+	fprintf(file, "%s\t\"interiorNodes\": %u,\n", pad, report.numInterior);
+	fprintf(file, "%s\t\"leaves\": %u,\n", pad, report.numLeaves);
+	fprintf(file, "%s\t\"triangles\": %u,\n", pad, report.numTris);
+	fprintf(file, "%s\t\"triangleRefs\": %llu,\n", pad, static_cast<unsigned long long>(report.numTriRefs));
+	fprintf(file, "%s\t\"depth\": %u,\n", pad, report.depth);
+	fprintf(file, "%s\t\"interiorPerDepth\": ", pad);
+	WriteHistogram(file, report.interiorPerDepth, maxDepthBins);
+	fprintf(file, ",\n%s\t\"leavesPerDepth\": ", pad);
+	WriteHistogram(file, report.leavesPerDepth, maxDepthBins);
+	fprintf(file, ",\n%s\t\"leafOccupancy\": ", pad);
+	WriteHistogram(file, report.leafOccupancy, leafOccupancyBins);
+	fprintf(file, ",\n%s\t\"meanLeafTris\": %.6g,\n", pad, report.meanLeafTris);
+	fprintf(file, "%s\t\"maxLeafTris\": %u,\n", pad, report.maxLeafTris);
+	fprintf(file, "%s\t\"emptyLeaves\": %u,\n", pad, report.emptyLeaves);
+	fprintf(file, "%s\t\"emptySlotFraction\": %.6g,\n", pad, report.emptySlotFraction);
+	fprintf(file, "%s\t\"sahCost\": %.6g,\n", pad, report.sahCost);
+	if (report.epo >= 0.0f)
+	{
+		fprintf(file, "%s\t\"epo\": %.6g,\n", pad, report.epo);
+	}
+	else
+	{
+		fprintf(file, "%s\t\"epo\": null,\n", pad);
+	}
+	fprintf(file, "%s\t\"memory\": { \"nodeBytes\": %llu, \"triListBytes\": %llu, \"otherBytes\": %llu, \"bytesPerTriangle\": %.6g },\n", pad,
+			static_cast<unsigned long long>(report.nodeBytes), static_cast<unsigned long long>(report.triListBytes), static_cast<unsigned long long>(report.otherBytes),
+			(report.numTris > 0) ? static_cast<double>(totalBytes) / report.numTris : 0.0);
+	fprintf(file, "%s\t\"rays\": { \"count\": %u, \"hits\": %u, \"nodesPerRay\": %.6g, \"trianglesPerRay\": %.6g }\n", pad, report.numRays, report.numHits,
+			report.nodesPerRay, report.trisPerRay);
+	fprintf(file, "%s}", pad);
+}
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdio.h>
+#include "../CPUMemory.h"
+#include "../Math.h"
+#include "../Shaders/SharedStructs.h"
+
+class BVH;
+class StacklessBVH;
+class WideBVH;
+class SparseOctree;
+
+// Quality/statistics reports over built acceleration structures (the compute path's binary BVH, in either encoding, the 8-wide BVH and
+// the sparse octree), written as JSON so AS changes can be tracked between runs
+// - Every structure is first flattened into a generic tree (wide BVH leaf slots become leaf nodes of their own), so statistics mean the
+//   same thing across structures: depth histograms, leaf occupancy, empty child slots, memory, and SAH cost (interior nodes cost
+//   [traversalCost] and leaves [triangleCost] per triangle reference, both weighted by surface area relative to the root)
+// - EPO (end-point overlap, Aila et al. 2013) is the SAH-weighted surface area of triangles (or their pieces) inside each node's box
+//   without belonging to its subtree, relative to the mesh's total area; it catches the overlap SAH can't see, since rays reaching
+//   those pieces still have to enter the node (the octree lists triangles in every cell they touch, so it only scores above zero
+//   from boundary contacts). Triangles are clipped to every box they overlap, so it's the slowest statistic by far
+// - Ray statistics come from each structure's own closest-hit traversal over [rays]: ordered stack walks for the binary BVH, skip
+//   links for the stackless encoding (as ComputeShader.hlsl runs them), the wide BVH's compressed traversal, and the octree walk
+//   from ComputeShader.hlsl with distance culling; nodes count once per node record read
+// - Scratch allocates through CPUMemory, so nothing else should allocate/free while a report runs
+class ASReport
+{
+	public:
+		static constexpr uint32_t maxDepthBins = AS_BVH_MAX_DEPTH + 16; // Past the deepest level any structure reaches
+		static constexpr uint32_t leafOccupancyBins = 17; // Leaves holding 0-15 triangles, then 16 or more
+
+		struct Ray
+		{
+			float4 origin; // w unused
+			float4 dir; // w unused; needn't be normalized (distances are in units of |dir|)
+			float tMin, tMax;
+		};
+
+		struct Settings
+		{
+			const char* label = ""; // Copied into the report (e.g. the scene's name)
+			float traversalCost = 1.0f; // Relative to one ray/triangle test, as BVH::BinnedSAHSettings
+			float triangleCost = 1.0f;
+			bool computeEPO = true;
+			const Ray* rays = nullptr;
+			uint32_t numRays = 0;
+		};
+
+		struct Report
+		{
+			const char* label;
+			const char* structure;
+			uint32_t numNodes; // Node records stored by the structure
+			uint32_t numInterior, numLeaves; // Generic tree (see above)
+			uint32_t numTris;
+			uint64_t numTriRefs; // Leaf triangle references; duplicated (spatially split/straddling) triangles count once per leaf
+			uint32_t depth; // Deepest level reached (the root is level zero)
+			uint32_t interiorPerDepth[maxDepthBins];
+			uint32_t leavesPerDepth[maxDepthBins];
+			uint32_t leafOccupancy[leafOccupancyBins];
+			uint32_t maxLeafTris;
+			float meanLeafTris;
+			uint32_t emptyLeaves;
+			float emptySlotFraction; // Unused child slots, out of every interior node's branching factor (2 or 8)
+			float sahCost;
+			float epo; // Negative when skipped
+			uint64_t nodeBytes, triListBytes, otherBytes; // [otherBytes]: e.g. the wide BVH's leaf-order triangles
+			uint32_t numRays, numHits;
+			float nodesPerRay, trisPerRay;
+		};
+
+		// Positions/triangles must be the ones the structure was built over
+		static void Analyse(const BVH& bvh, const float4* positions, uint64_t strideBytes, const IndexedTriangle* tris, const Settings& settings, Report* outReport);
+		static void Analyse(const StacklessBVH& bvh, const float4* positions, uint64_t strideBytes, const IndexedTriangle* tris, const Settings& settings, Report* outReport);
+		static void Analyse(const WideBVH& bvh, const float4* positions, uint64_t strideBytes, const IndexedTriangle* tris, const Settings& settings, Report* outReport);
+		static void Analyse(const SparseOctree& octree, const float4* positions, uint64_t strideBytes, const IndexedTriangle* tris, uint32_t numTris, const Settings& settings,
+							Report* outReport);
+
+		// Writes [report] as one JSON object (histograms trimmed to the levels/sizes that occur), each line indented by [indent] tabs
+		static void WriteJSON(const Report& report, FILE* file, uint32_t indent = 0);
+};
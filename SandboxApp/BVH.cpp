@@ -0,0 +1,2131 @@
+#include "BVH.h"
+
+#include <immintrin.h>
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cassert>
+#include <cfloat>
+#include <cstring>
+#include <limits>
+#include <thread>
+
+// Below these amounts of work per thread, spawning threads costs more than it saves
+constexpr uint64_t minRefsPerThread = 16 * 1024;
+constexpr uint32_t minParallelBinRefs = 64 * 1024;
+constexpr uint32_t minTaskRefs = 1024;
+constexpr uint32_t maxThreads = 64;
+
+// Triangle bounds; the triangle's ID rides in the (otherwise unused) w lane of [bmin], so SIMD loads pick it up as a junk float that
+// never reaches a result
+struct alignas(16) PrimRef
+{
+	float bmin[3];
+	uint32_t tri;
+	float bmax[3];
+	uint32_t pad;
+};
+
+struct Bin
+{
+	__m128 bmin, bmax;
+	uint32_t count;
+};
+
+struct BinSet
+{
+	Bin bins[3][BVH::numBins];
+};
+
+// A node waiting to be built: [slot] is its place in the scratch node array (see [BuildBinnedSAH]), and its references are
+// [first, first + count); centroids are doubled (bmin + bmax) throughout, which orders/bins them the same way for one less multiply
+struct BuildTask
+{
+	uint32_t slot, first, count, depth;
+	__m128 centroidMin, centroidMax;
+};
+
+// CPUMemory doesn't align allocations, so SIMD-heavy scratch over-allocates and rounds its base address up to 16 bytes
+template<typename type>
+static CPUMemory::ArrayAllocHandle<uint8_t> AllocateAligned(uint64_t numElts)
+{
+	return CPUMemory::AllocateArray<uint8_t>(numElts * sizeof(type) + 16); // Padded by a whole vector, so later allocations keep their alignment
+}
+
+template<typename type>
+static type* AlignedData(CPUMemory::ArrayAllocHandle<uint8_t>& handle)
+{
+	return reinterpret_cast<type*>((reinterpret_cast<uintptr_t>(&handle[0]) + 15) & ~uintptr_t(15));
+}
+
+// Split [numItems] into contiguous ranges across up to [numThreads] threads, calling [fn(thread, first, end)] for each; returns how
+// many threads ran
+template<typename rangeFn>
+static uint32_t ParallelRanges(uint64_t numItems, uint64_t minItemsPerThread, uint32_t numThreads, rangeFn fn)
+{
+	numThreads = static_cast<uint32_t>(std::min<uint64_t>({ numThreads, maxThreads, std::max<uint64_t>(numItems / minItemsPerThread, 1u) }));
+	if (numThreads <= 1)
+	{
+		fn(0u, uint64_t(0), numItems);
+		return 1;
+	}
+
+	std::thread threads[maxThreads] = {};
+	const uint64_t itemsPerThread = numItems / numThreads;
+	for (uint32_t t = 0; t < numThreads; t++)
+	{
+		const uint64_t first = t * itemsPerThread;
+		const uint64_t end = (t == numThreads - 1) ? numItems : first + itemsPerThread;
+		threads[t] = std::thread(fn, t, first, end);
+	}
+
+	for (uint32_t t = 0; t < numThreads; t++)
+	{
+		threads[t].join();
+	}
+	return numThreads;
+}
+
+// Run [fn(task)] for tasks [0, numTasks) across up to [numThreads] threads, each pulling the next task as it finishes one (so tasks
+// should be sorted largest first)
+template<typename taskFn>
+static void RunTasks(uint64_t numTasks, uint32_t numThreads, taskFn fn)
+{
+	std::atomic<uint64_t> nextTask = 0;
+	auto worker = [&nextTask, numTasks, &fn]()
+	{
+		for (uint64_t t = nextTask++; t < numTasks; t = nextTask++)
+		{
+			fn(t);
+		}
+	};
+
+	const uint32_t numWorkers = static_cast<uint32_t>(std::min<uint64_t>({ numThreads, maxThreads, numTasks }));
+	std::thread threads[maxThreads] = {};
+	for (uint32_t w = 1; w < numWorkers; w++)
+	{
+		threads[w] = std::thread(worker);
+	}
+	worker();
+	for (uint32_t w = 1; w < numWorkers; w++)
+	{
+		threads[w].join();
+	}
+}
+
+// Fill [refs] from the mesh (or from boxes, when [boxMins] is set), and find its bounds + doubled-centroid bounds
+static void BuildPrimRefs(const float4* positions, uint64_t strideBytes, const IndexedTriangle* tris, const float4* boxMins, const float4* boxMaxs, uint32_t numTris,
+						  uint32_t numThreads, PrimRef* refs, __m128* outMin, __m128* outMax, __m128* outCentroidMin, __m128* outCentroidMax)
+{
+	struct alignas(16) Partial
+	{
+		__m128 bmin, bmax, cmin, cmax;
+	};
+	Partial partials[maxThreads];
+
+	const uint32_t numRefThreads = ParallelRanges(numTris, minRefsPerThread, numThreads, [=, &partials](uint32_t t, uint64_t first, uint64_t end)
+	{
+		__m128 bmin = _mm_set1_ps(std::numeric_limits<float>::infinity()), bmax = _mm_set1_ps(-std::numeric_limits<float>::infinity());
+		__m128 cmin = bmin, cmax = bmax;
+		for (uint64_t i = first; i < end; i++)
+		{
+			__m128 lo, hi;
+			if (boxMins != nullptr)
+			{
+				lo = _mm_loadu_ps(&boxMins[i].x);
+				hi = _mm_loadu_ps(&boxMaxs[i].x);
+			}
+			else
+			{
+				const uint4& ndx = tris[i].xyz;
+				const __m128 v0 = _mm_loadu_ps(reinterpret_cast<const float*>(reinterpret_cast<const uint8_t*>(positions) + ndx.x * strideBytes));
+				const __m128 v1 = _mm_loadu_ps(reinterpret_cast<const float*>(reinterpret_cast<const uint8_t*>(positions) + ndx.y * strideBytes));
+				const __m128 v2 = _mm_loadu_ps(reinterpret_cast<const float*>(reinterpret_cast<const uint8_t*>(positions) + ndx.z * strideBytes));
+				lo = _mm_min_ps(_mm_min_ps(v0, v1), v2);
+				hi = _mm_max_ps(_mm_max_ps(v0, v1), v2);
+			}
+			const __m128 centroid = _mm_add_ps(lo, hi);
+			bmin = _mm_min_ps(bmin, lo);
+			bmax = _mm_max_ps(bmax, hi);
+			cmin = _mm_min_ps(cmin, centroid);
+			cmax = _mm_max_ps(cmax, centroid);
+
+			_mm_store_ps(refs[i].bmin, lo);
+			_mm_store_ps(refs[i].bmax, hi);
+			refs[i].tri = static_cast<uint32_t>(i);
+			refs[i].pad = 0;
+		}
+		partials[t] = { bmin, bmax, cmin, cmax };
+	});
+
+	Partial total = partials[0];
+	for (uint32_t t = 1; t < numRefThreads; t++)
+	{
+		total.bmin = _mm_min_ps(total.bmin, partials[t].bmin);
+		total.bmax = _mm_max_ps(total.bmax, partials[t].bmax);
+		total.cmin = _mm_min_ps(total.cmin, partials[t].cmin);
+		total.cmax = _mm_max_ps(total.cmax, partials[t].cmax);
+	}
+	*outMin = total.bmin;
+	*outMax = total.bmax;
+	*outCentroidMin = total.cmin;
+	*outCentroidMax = total.cmax;
+}
+
+static uint32_t ResolveThreadCount(uint32_t numThreads)
+{
+	return std::min((numThreads == 0) ? std::max(std::thread::hardware_concurrency(), 1u) : numThreads, maxThreads);
+}
+
+static float HalfArea(__m128 bmin, __m128 bmax)
+{
+	alignas(16) float d[4];
+	_mm_store_ps(d, _mm_sub_ps(bmax, bmin));
+	return d[0] * d[1] + d[1] * d[2] + d[2] * d[0];
+}
+
+// Doubles here, since extents past ~1e19 overflow float products
+static double HalfArea(const ComputeBVH_Node& node)
+{
+	const double dx = node.boundsMax.x - node.boundsMin.x, dy = node.boundsMax.y - node.boundsMin.y, dz = node.boundsMax.z - node.boundsMin.z;
+	return dx * dy + dy * dz + dz * dx;
+}
+
+static uint32_t CeilLog2(uint32_t x)
+{
+	uint32_t log = 0;
+	while ((1ull << log) < x)
+	{
+		log++;
+	}
+	return log;
+}
+
+static void StoreBounds(ComputeBVH_Node& node, __m128 bmin, __m128 bmax)
+{
+	alignas(16) float lo[4], hi[4];
+	_mm_store_ps(lo, bmin);
+	_mm_store_ps(hi, bmax);
+	node.boundsMin = float3(lo[0], lo[1], lo[2]);
+	node.boundsMax = float3(hi[0], hi[1], hi[2]);
+}
+
+// Bin coordinates for a reference along all three axes (binning and partitioning both come through here, so they always agree)
+static __m128i BinIndices(const PrimRef& ref, __m128 centroidMin, __m128 binScale)
+{
+	const __m128 centroid = _mm_add_ps(_mm_load_ps(ref.bmin), _mm_load_ps(ref.bmax));
+	const __m128i ndx = _mm_cvttps_epi32(_mm_mul_ps(_mm_sub_ps(centroid, centroidMin), binScale));
+	return _mm_max_epi32(_mm_min_epi32(ndx, _mm_set1_epi32(BVH::numBins - 1)), _mm_setzero_si128());
+}
+
+static void ClearBins(BinSet* bins)
+{
+	for (uint32_t axis = 0; axis < 3; axis++)
+	{
+		for (Bin& bin : bins->bins[axis])
+		{
+			bin.bmin = _mm_set1_ps(std::numeric_limits<float>::infinity());
+			bin.bmax = _mm_set1_ps(-std::numeric_limits<float>::infinity());
+			bin.count = 0;
+		}
+	}
+}
+
+// Accumulate references [first, end) into [bins]
+static void BinRefs(const PrimRef* refs, uint64_t first, uint64_t end, __m128 centroidMin, __m128 binScale, BinSet* bins)
+{
+	ClearBins(bins);
+	for (uint64_t r = first; r < end; r++)
+	{
+		const __m128 bmin = _mm_load_ps(refs[r].bmin);
+		const __m128 bmax = _mm_load_ps(refs[r].bmax);
+		alignas(16) int32_t ndx[4];
+		_mm_store_si128(reinterpret_cast<__m128i*>(ndx), BinIndices(refs[r], centroidMin, binScale));
+		for (uint32_t axis = 0; axis < 3; axis++)
+		{
+			Bin& bin = bins->bins[axis][ndx[axis]];
+			bin.bmin = _mm_min_ps(bin.bmin, bmin);
+			bin.bmax = _mm_max_ps(bin.bmax, bmax);
+			bin.count++;
+		}
+	}
+}
+
+struct Split
+{
+	uint32_t axis, bin; // References in bins below [bin] go left
+	float cost;
+	uint32_t leftCount;
+	__m128 leftMin, leftMax, rightMin, rightMax;
+};
+
+// Cheapest split across all three axes by the SAH; returns false when every candidate leaves a side empty
+static bool FindSplit(const BinSet& bins, float parentHalfArea, float traversalCost, float triangleCost, Split* outSplit)
+{
+	outSplit->cost = std::numeric_limits<float>::infinity();
+	const float areaScale = (parentHalfArea > 0.0f) ? triangleCost / parentHalfArea : 0.0f;
+	for (uint32_t axis = 0; axis < 3; axis++)
+	{
+		// Sweep from the right first, keeping each split's right-hand side, then sweep from the left and cost each split
+		__m128 rightMin[BVH::numBins], rightMax[BVH::numBins];
+		uint32_t rightCount[BVH::numBins];
+		__m128 accumMin = _mm_set1_ps(std::numeric_limits<float>::infinity()), accumMax = _mm_set1_ps(-std::numeric_limits<float>::infinity());
+		uint32_t accumCount = 0;
+		for (uint32_t b = BVH::numBins - 1; b > 0; b--)
+		{
+			const Bin& bin = bins.bins[axis][b];
+			accumMin = _mm_min_ps(accumMin, bin.bmin);
+			accumMax = _mm_max_ps(accumMax, bin.bmax);
+			accumCount += bin.count;
+			rightMin[b] = accumMin;
+			rightMax[b] = accumMax;
+			rightCount[b] = accumCount;
+		}
+
+		accumMin = _mm_set1_ps(std::numeric_limits<float>::infinity());
+		accumMax = _mm_set1_ps(-std::numeric_limits<float>::infinity());
+		accumCount = 0;
+		for (uint32_t b = 1; b < BVH::numBins; b++)
+		{
+			const Bin& bin = bins.bins[axis][b - 1];
+			accumMin = _mm_min_ps(accumMin, bin.bmin);
+			accumMax = _mm_max_ps(accumMax, bin.bmax);
+			accumCount += bin.count;
+			if (accumCount == 0 || rightCount[b] == 0)
+			{
+				continue;
+			}
+
+			const float cost = traversalCost + (HalfArea(accumMin, accumMax) * accumCount + HalfArea(rightMin[b], rightMax[b]) * rightCount[b]) * areaScale;
+			if (cost < outSplit->cost)
+			{
+				outSplit->axis = axis;
+				outSplit->bin = b;
+				outSplit->cost = cost;
+				outSplit->leftCount = accumCount;
+				outSplit->leftMin = accumMin;
+				outSplit->leftMax = accumMax;
+				outSplit->rightMin = rightMin[b];
+				outSplit->rightMax = rightMax[b];
+			}
+		}
+	}
+	return outSplit->cost < std::numeric_limits<float>::infinity();
+}
+
+// Bounds + doubled-centroid bounds for references [first, end)
+static void RangeBounds(const PrimRef* refs, uint64_t first, uint64_t end, __m128* outMin, __m128* outMax, __m128* outCentroidMin, __m128* outCentroidMax)
+{
+	__m128 bmin = _mm_set1_ps(std::numeric_limits<float>::infinity()), bmax = _mm_set1_ps(-std::numeric_limits<float>::infinity());
+	__m128 cmin = bmin, cmax = bmax;
+	for (uint64_t r = first; r < end; r++)
+	{
+		const __m128 lo = _mm_load_ps(refs[r].bmin);
+		const __m128 hi = _mm_load_ps(refs[r].bmax);
+		const __m128 centroid = _mm_add_ps(lo, hi);
+		bmin = _mm_min_ps(bmin, lo);
+		bmax = _mm_max_ps(bmax, hi);
+		cmin = _mm_min_ps(cmin, centroid);
+		cmax = _mm_max_ps(cmax, centroid);
+	}
+	*outMin = bmin;
+	*outMax = bmax;
+	*outCentroidMin = cmin;
+	*outCentroidMax = cmax;
+}
+
+// Scales mapping doubled centroids onto bins; flat axes get zero, which drops every reference into their first bin (so they never split)
+static __m128 BinScale(__m128 centroidMin, __m128 centroidMax)
+{
+	alignas(16) float extent[4];
+	_mm_store_ps(extent, _mm_sub_ps(centroidMax, centroidMin));
+	alignas(16) float scale[4] = {};
+	for (uint32_t axis = 0; axis < 3; axis++)
+	{
+		scale[axis] = (extent[axis] > 0.0f) ? (BVH::numBins * (1.0f - 1e-5f)) / extent[axis] : 0.0f;
+	}
+	return _mm_load_ps(scale);
+}
+
+// Shared build state; scratch nodes are indexed by slot
+struct BuildContext
+{
+	PrimRef* refs;
+	ComputeBVH_Node* scratch;
+	BinSet* threadBins; // One set per thread, for parallel binning
+	uint32_t numThreads;
+	BVH::BinnedSAHSettings settings;
+};
+
+// Split [task] into [outLeft]/[outRight], or turn it into a leaf (returns false)
+// Nodes for a range of n references fit in 2n - 1 slots; a node at slot s keeps its left child at s + 1 and its right child at s + 2L
+// (L references on the left), so subtrees own disjoint slot ranges and can build concurrently; leaves leave the rest of their range
+// unused, and those gaps are squeezed out after the build
+static bool SplitTask(const BuildContext& ctx, const BuildTask& task, bool parallelBinning, BuildTask* outLeft, BuildTask* outRight)
+{
+	ComputeBVH_Node& node = ctx.scratch[task.slot];
+	const BVH::BinnedSAHSettings& settings = ctx.settings;
+	auto makeLeaf = [&]()
+	{
+		node.rightOrFirstTri = task.first;
+		node.triCount = task.count;
+		return false;
+	};
+
+	if (task.count <= settings.leafTris)
+	{
+		return makeLeaf();
+	}
+
+	// Binned SAH, unless the depth limit is close enough that only balanced splits can stay under it
+	Split split = {};
+	bool medianSplit = (task.depth + CeilLog2(task.count) >= AS_BVH_MAX_DEPTH - 1);
+	if (!medianSplit)
+	{
+		const __m128 binScale = BinScale(task.centroidMin, task.centroidMax);
+		BinSet bins;
+		if (parallelBinning)
+		{
+			const PrimRef* refs = ctx.refs;
+			BinSet* threadBins = ctx.threadBins;
+			const __m128 centroidMin = task.centroidMin;
+			const uint32_t numBinThreads = ParallelRanges(task.count, minRefsPerThread, ctx.numThreads, [=](uint32_t t, uint64_t first, uint64_t end)
+			{
+				BinRefs(refs, task.first + first, task.first + end, centroidMin, binScale, &threadBins[t]);
+			});
+
+			bins = threadBins[0];
+			for (uint32_t t = 1; t < numBinThreads; t++)
+			{
+				for (uint32_t axis = 0; axis < 3; axis++)
+				{
+					for (uint32_t b = 0; b < BVH::numBins; b++)
+					{
+						Bin& bin = bins.bins[axis][b];
+						const Bin& other = threadBins[t].bins[axis][b];
+						bin.bmin = _mm_min_ps(bin.bmin, other.bmin);
+						bin.bmax = _mm_max_ps(bin.bmax, other.bmax);
+						bin.count += other.count;
+					}
+				}
+			}
+		}
+		else
+		{
+			BinRefs(ctx.refs, task.first, task.first + task.count, task.centroidMin, binScale, &bins);
+		}
+
+		const float leafCost = task.count * settings.triangleCost;
+		const bool canSplit = FindSplit(bins, static_cast<float>(HalfArea(node)), settings.traversalCost, settings.triangleCost, &split);
+		if (task.count <= settings.maxLeafTris && (!canSplit || split.cost >= leafCost))
+		{
+			return makeLeaf();
+		}
+		medianSplit = !canSplit;
+	}
+
+	PrimRef* refs = ctx.refs + task.first;
+	__m128 leftCentroidMin, leftCentroidMax, rightCentroidMin, rightCentroidMax;
+	if (!medianSplit)
+	{
+		// Partition around the split, collecting child centroid bounds on the way
+		const __m128 binScale = BinScale(task.centroidMin, task.centroidMax);
+		leftCentroidMin = rightCentroidMin = _mm_set1_ps(std::numeric_limits<float>::infinity());
+		leftCentroidMax = rightCentroidMax = _mm_set1_ps(-std::numeric_limits<float>::infinity());
+		uint32_t i = 0, j = task.count;
+		while (i < j)
+		{
+			alignas(16) int32_t ndx[4];
+			_mm_store_si128(reinterpret_cast<__m128i*>(ndx), BinIndices(refs[i], task.centroidMin, binScale));
+			const __m128 centroid = _mm_add_ps(_mm_load_ps(refs[i].bmin), _mm_load_ps(refs[i].bmax));
+			if (static_cast<uint32_t>(ndx[split.axis]) < split.bin)
+			{
+				leftCentroidMin = _mm_min_ps(leftCentroidMin, centroid);
+				leftCentroidMax = _mm_max_ps(leftCentroidMax, centroid);
+				i++;
+			}
+			else
+			{
+				rightCentroidMin = _mm_min_ps(rightCentroidMin, centroid);
+				rightCentroidMax = _mm_max_ps(rightCentroidMax, centroid);
+				j--;
+				std::swap(refs[i], refs[j]);
+			}
+		}
+		assert(i == split.leftCount);
+	}
+	else
+	{
+		// Object median along the widest centroid axis (or just down the middle, when every centroid matches)
+		alignas(16) float extent[4];
+		_mm_store_ps(extent, _mm_sub_ps(task.centroidMax, task.centroidMin));
+		const uint32_t axis = (extent[0] >= extent[1] && extent[0] >= extent[2]) ? 0 : ((extent[1] >= extent[2]) ? 1 : 2);
+		split.leftCount = task.count / 2;
+		if (extent[axis] > 0.0f)
+		{
+			std::nth_element(refs, refs + split.leftCount, refs + task.count, [axis](const PrimRef& a, const PrimRef& b)
+			{
+				return (a.bmin[axis] + a.bmax[axis]) < (b.bmin[axis] + b.bmax[axis]);
+			});
+		}
+
+		RangeBounds(refs, 0, split.leftCount, &split.leftMin, &split.leftMax, &leftCentroidMin, &leftCentroidMax);
+		RangeBounds(refs, split.leftCount, task.count, &split.rightMin, &split.rightMax, &rightCentroidMin, &rightCentroidMax);
+	}
+
+	*outLeft = { task.slot + 1, task.first, split.leftCount, task.depth + 1, leftCentroidMin, leftCentroidMax };
+	*outRight = { task.slot + 2 * split.leftCount, task.first + split.leftCount, task.count - split.leftCount, task.depth + 1, rightCentroidMin, rightCentroidMax };
+	StoreBounds(ctx.scratch[outLeft->slot], split.leftMin, split.leftMax);
+	StoreBounds(ctx.scratch[outRight->slot], split.rightMin, split.rightMax);
+
+	node.rightOrFirstTri = outRight->slot;
+	node.triCount = 0;
+	return true;
+}
+
+void BVH::BuildBinnedSAH(const float4* positions, [[maybe_unused]] uint64_t numVerts, uint64_t strideBytes, const IndexedTriangle* tris, uint32_t _numTris, const BinnedSAHSettings& settings)
+{
+	assert(TriIndicesInRange(tris, _numTris, numVerts));
+	BuildBinnedSAH({ positions, strideBytes, tris, nullptr, nullptr }, _numTris, settings);
+}
+
+void BVH::BuildBinnedSAH(const float4* boxMins, const float4* boxMaxs, uint32_t numBoxes, const BinnedSAHSettings& settings)
+{
+	BuildBinnedSAH({ nullptr, 0, nullptr, boxMins, boxMaxs }, numBoxes, settings);
+}
+
+bool BVH::TriIndicesInRange(const IndexedTriangle* tris, uint32_t numTris, uint64_t numVerts)
+{
+	for (uint32_t i = 0; i < numTris; i++)
+	{
+		if (tris[i].xyz.x >= numVerts || tris[i].xyz.y >= numVerts || tris[i].xyz.z >= numVerts)
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+void BVH::BuildBinnedSAH(const PrimSource& prims, uint32_t _numTris, const BinnedSAHSettings& settings)
+{
+	lastBuilder = Builder::BinnedSAH;
+	binnedSAHSettings = settings;
+	builtOverBoxes = (prims.boxMins != nullptr);
+	numTris = _numTris;
+	stats = {};
+
+	BuildContext ctx;
+	ctx.settings = settings;
+	ctx.settings.leafTris = std::max(settings.leafTris, 1u);
+	ctx.settings.maxLeafTris = std::max(settings.maxLeafTris, ctx.settings.leafTris);
+	ctx.numThreads = ResolveThreadCount(settings.numThreads);
+	if (settings.spatialSplits && !builtOverBoxes && numTris > 0)
+	{
+		BuildSpatialSplits(prims, ctx.settings);
+		return;
+	}
+	triListLen = numTris;
+
+	// Scratch: references, gapped nodes (see [SplitTask]), per-thread bins, and the frontier of subtrees handed out to threads
+	const uint64_t numSlots = std::max<uint64_t>(static_cast<uint64_t>(numTris) * 2, 2) - 1;
+	const uint32_t taskRefs = (ctx.numThreads > 1) ? std::max(minTaskRefs, numTris / (ctx.numThreads * 8)) : UINT32_MAX;
+	const uint64_t maxFrontier = (ctx.numThreads > 1) ? (static_cast<uint64_t>(numTris) / taskRefs) * 4 + 2 : 1;
+	auto refs = AllocateAligned<PrimRef>(std::max(numTris, 1u));
+	auto scratch = CPUMemory::AllocateArray<ComputeBVH_Node>(numSlots);
+	auto threadBins = AllocateAligned<BinSet>(ctx.numThreads);
+	auto frontier = AllocateAligned<BuildTask>(maxFrontier);
+	ctx.refs = AlignedData<PrimRef>(refs);
+	ctx.scratch = &scratch[0];
+	ctx.threadBins = AlignedData<BinSet>(threadBins);
+
+	// References + root bounds; slots start out unused (see [SplitTask])
+	__m128 rootMin = _mm_setzero_ps(), rootMax = _mm_setzero_ps(), rootCentroidMin = _mm_setzero_ps(), rootCentroidMax = _mm_setzero_ps();
+	{
+		BuildPrimRefs(prims.positions, prims.strideBytes, prims.tris, prims.boxMins, prims.boxMaxs, numTris, ctx.numThreads, ctx.refs, &rootMin, &rootMax, &rootCentroidMin,
+					  &rootCentroidMax);
+
+		ComputeBVH_Node* scratchData = ctx.scratch;
+		ParallelRanges(numSlots, minRefsPerThread, ctx.numThreads, [=](uint32_t, uint64_t first, uint64_t end)
+		{
+			for (uint64_t s = first; s < end; s++)
+			{
+				scratchData[s].triCount = UINT32_MAX;
+			}
+		});
+		StoreBounds(scratchData[0], rootMin, rootMax);
+	}
+
+	// Top of the tree on this thread (binning large nodes across threads), handing subtrees below [taskRefs] references to the
+	// frontier; children are visited depth-first, left first, so the stack never holds more than one task per level
+	// Lopsided splits can shed more small subtrees than the frontier was sized for; past that, they just build here
+	uint64_t numFrontier = 0;
+	{
+		BuildTask stack[AS_BVH_MAX_DEPTH + 1];
+		uint32_t stackSize = 1;
+		stack[0] = { 0, 0, numTris, 0, rootCentroidMin, rootCentroidMax };
+		while (stackSize > 0)
+		{
+			BuildTask task = stack[--stackSize];
+			while (true)
+			{
+				if (task.count <= taskRefs && task.count > ctx.settings.leafTris && numFrontier < maxFrontier)
+				{
+					AlignedData<BuildTask>(frontier)[numFrontier++] = task;
+					break;
+				}
+
+				BuildTask left, right;
+				if (!SplitTask(ctx, task, (ctx.numThreads > 1) && (task.count >= minParallelBinRefs), &left, &right))
+				{
+					break;
+				}
+
+				stack[stackSize++] = right;
+				task = left;
+			}
+		}
+	}
+
+	// Subtrees, largest first, pulled by each thread in turn
+	if (numFrontier > 0)
+	{
+		BuildTask* frontierData = AlignedData<BuildTask>(frontier);
+		std::sort(frontierData, frontierData + numFrontier, [](const BuildTask& a, const BuildTask& b) { return a.count > b.count; });
+
+		RunTasks(numFrontier, ctx.numThreads, [&ctx, frontierData](uint64_t t)
+		{
+			BuildTask stack[AS_BVH_MAX_DEPTH + 1];
+			uint32_t stackSize = 1;
+			stack[0] = frontierData[t];
+			while (stackSize > 0)
+			{
+				BuildTask task = stack[--stackSize];
+				BuildTask left, right;
+				while (SplitTask(ctx, task, false, &left, &right))
+				{
+					stack[stackSize++] = right;
+					task = left;
+				}
+			}
+		});
+	}
+
+	// Squeeze unused slots out; they're skipped in order, so the array stays depth-first and right children just shift down
+	auto remap = CPUMemory::AllocateArray<uint32_t>(numSlots);
+	uint32_t numNodes = 0;
+	{
+		const ComputeBVH_Node* scratchData = &scratch[0];
+		uint32_t* remapData = &remap[0];
+		for (uint64_t s = 0; s < numSlots; s++)
+		{
+			remapData[s] = numNodes;
+			numNodes += (scratchData[s].triCount != UINT32_MAX) ? 1 : 0;
+		}
+	}
+
+	// Empty meshes still get a root: an empty leaf with inverted bounds, so no ray ever enters it
+	if (numTris == 0)
+	{
+		numNodes = 1;
+		scratch[0].boundsMin = float3(FLT_MAX, FLT_MAX, FLT_MAX);
+		scratch[0].boundsMax = float3(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+		scratch[0].rightOrFirstTri = 0;
+		scratch[0].triCount = 0;
+	}
+
+	nodes = CPUMemory::AllocateArray<ComputeBVH_Node>(numNodes);
+	triList = CPUMemory::AllocateArray<uint32_t>(std::max(numTris, 1u));
+	{
+		const ComputeBVH_Node* scratchData = &scratch[0];
+		const uint32_t* remapData = &remap[0];
+		ComputeBVH_Node* nodeData = &nodes[0];
+		for (uint64_t s = 0; s < numSlots; s++)
+		{
+			const ComputeBVH_Node& node = scratchData[s];
+			if (node.triCount != UINT32_MAX)
+			{
+				ComputeBVH_Node& dst = nodeData[remapData[s]];
+				dst = node;
+				if (node.triCount == 0 && numTris > 0)
+				{
+					dst.rightOrFirstTri = remapData[node.rightOrFirstTri];
+				}
+			}
+		}
+
+		const PrimRef* refData = AlignedData<PrimRef>(refs);
+		uint32_t* triListData = &triList[0];
+		triListData[0] = 0;
+		for (uint32_t i = 0; i < numTris; i++)
+		{
+			triListData[i] = refData[i].tri;
+		}
+	}
+
+	// Scratch goes in reverse allocation order (outputs were allocated after it, so they shift down as it goes)
+	CPUMemory::Free(remap);
+	CPUMemory::Free(frontier);
+	CPUMemory::Free(threadBins);
+	CPUMemory::Free(scratch);
+	CPUMemory::Free(refs);
+
+	stats.numNodes = numNodes;
+	ResolveStats(ctx.settings.traversalCost, ctx.settings.triangleCost);
+}
+
+// Spatial splits
+/////////////////
+
+constexpr uint32_t spatialNoParent = UINT32_MAX;
+
+// A node waiting to be built by [BuildSpatialSplits]: its references are [first, first + count), with room to grow to [capacity] as
+// spatial splits duplicate them; right children carry the [parent] waiting on their node index
+struct SpatialTask
+{
+	uint32_t first, count, capacity, depth;
+	uint32_t parent;
+};
+
+struct SpatialContext
+{
+	PrimRef* refs;
+	PrimRef* tmpRefs; // Partitioning space
+	const uint8_t* positionBytes;
+	uint64_t strideBytes;
+	const IndexedTriangle* tris;
+	float rootHalfArea;
+	BVH::BinnedSAHSettings settings;
+};
+
+struct SpatialBin
+{
+	float bmin[3], bmax[3];
+	uint32_t entries, exits; // References starting/ending in this bin
+};
+
+struct SpatialSplit
+{
+	uint32_t axis, bin; // References ending below [bin] go left, ones starting at/past it go right, and the rest straddle the plane
+	float cost, plane;
+	uint32_t leftCount, rightCount; // Straddling references count on both sides
+	float leftMin[3], leftMax[3], rightMin[3], rightMax[3];
+};
+
+static float HalfArea(const float* bmin, const float* bmax)
+{
+	const float dx = bmax[0] - bmin[0], dy = bmax[1] - bmin[1], dz = bmax[2] - bmin[2];
+	return dx * dy + dy * dz + dz * dx;
+}
+
+static void GrowBounds(float* bmin, float* bmax, const float* otherMin, const float* otherMax)
+{
+	for (uint32_t a = 0; a < 3; a++)
+	{
+		bmin[a] = std::min(bmin[a], otherMin[a]);
+		bmax[a] = std::max(bmax[a], otherMax[a]);
+	}
+}
+
+static void LoadTriangle(const SpatialContext& ctx, uint32_t tri, float (*outVerts)[3])
+{
+	const uint4& ndx = ctx.tris[tri].xyz;
+	const uint32_t vertNdces[3] = { ndx.x, ndx.y, ndx.z };
+	for (uint32_t k = 0; k < 3; k++)
+	{
+		const float* p = reinterpret_cast<const float*>(ctx.positionBytes + vertNdces[k] * ctx.strideBytes);
+		outVerts[k][0] = p[0];
+		outVerts[k][1] = p[1];
+		outVerts[k][2] = p[2];
+	}
+}
+
+// Bounds of the piece of a triangle lying between [lo] and [hi] along [axis], within [ref]'s bounds (references can already be pieces
+// of their triangles); returns false if there's nothing there
+// Edge crossings are rounded outwards along the other two axes (without leaving their edge's extent), so pieces never come out smaller
+// than their geometry
+static bool ClipTriangle(const float (*verts)[3], uint32_t axis, float lo, float hi, const PrimRef& ref, float* outMin, float* outMax)
+{
+	for (uint32_t a = 0; a < 3; a++)
+	{
+		outMin[a] = std::numeric_limits<float>::infinity();
+		outMax[a] = -std::numeric_limits<float>::infinity();
+	}
+
+	for (uint32_t e = 0; e < 3; e++)
+	{
+		const float* a = verts[e];
+		const float* b = verts[(e + 1) % 3];
+		if (a[axis] >= lo && a[axis] <= hi)
+		{
+			GrowBounds(outMin, outMax, a, a);
+		}
+
+		const float planes[2] = { lo, hi };
+		for (float plane : planes)
+		{
+			if ((a[axis] < plane && b[axis] > plane) || (a[axis] > plane && b[axis] < plane))
+			{
+				const float t = (plane - a[axis]) / (b[axis] - a[axis]);
+				float crossMin[3], crossMax[3];
+				for (uint32_t k = 0; k < 3; k++)
+				{
+					const float p = a[k] + (b[k] - a[k]) * t;
+					const float slack = (std::abs(a[k]) + std::abs(b[k])) * (1.0f / (1 << 20));
+					crossMin[k] = (k == axis) ? plane : std::max(p - slack, std::min(a[k], b[k]));
+					crossMax[k] = (k == axis) ? plane : std::min(p + slack, std::max(a[k], b[k]));
+				}
+				GrowBounds(outMin, outMax, crossMin, crossMax);
+			}
+		}
+	}
+
+	bool valid = true;
+	for (uint32_t a = 0; a < 3; a++)
+	{
+		outMin[a] = std::max(outMin[a], ref.bmin[a]);
+		outMax[a] = std::min(outMax[a], ref.bmax[a]);
+		valid = valid && (outMin[a] <= outMax[a]);
+	}
+	return valid;
+}
+
+static uint32_t SpatialBinIndex(float p, float nodeMin, float invBinWidth)
+{
+	return static_cast<uint32_t>(std::clamp(static_cast<int32_t>((p - nodeMin) * invBinWidth), 0, static_cast<int32_t>(BVH::numBins) - 1));
+}
+
+// Cheapest spatial split across all three axes by the SAH (Stich et al. 2009); references are chopped into every bin they pass through,
+// so bins only grow by the pieces of their triangles inside them
+static bool FindSpatialSplit(const SpatialContext& ctx, const SpatialTask& task, const float* nodeMin, const float* nodeMax, SpatialSplit* outSplit)
+{
+	const BVH::BinnedSAHSettings& settings = ctx.settings;
+	const float parentHalfArea = HalfArea(nodeMin, nodeMax);
+	const float areaScale = (parentHalfArea > 0.0f) ? settings.triangleCost / parentHalfArea : 0.0f;
+	const PrimRef* refs = ctx.refs + task.first;
+	outSplit->cost = std::numeric_limits<float>::infinity();
+	for (uint32_t axis = 0; axis < 3; axis++)
+	{
+		const float extent = nodeMax[axis] - nodeMin[axis];
+		if (!(extent > 0.0f))
+		{
+			continue;
+		}
+
+		const float binWidth = extent / BVH::numBins, invBinWidth = BVH::numBins / extent;
+		SpatialBin bins[BVH::numBins];
+		for (SpatialBin& bin : bins)
+		{
+			for (uint32_t a = 0; a < 3; a++)
+			{
+				bin.bmin[a] = std::numeric_limits<float>::infinity();
+				bin.bmax[a] = -std::numeric_limits<float>::infinity();
+			}
+			bin.entries = bin.exits = 0;
+		}
+
+		for (uint32_t r = 0; r < task.count; r++)
+		{
+			const PrimRef& ref = refs[r];
+			const uint32_t entry = SpatialBinIndex(ref.bmin[axis], nodeMin[axis], invBinWidth), exit = SpatialBinIndex(ref.bmax[axis], nodeMin[axis], invBinWidth);
+			bins[entry].entries++;
+			bins[exit].exits++;
+			if (entry == exit)
+			{
+				GrowBounds(bins[entry].bmin, bins[entry].bmax, ref.bmin, ref.bmax);
+				continue;
+			}
+
+			// The outer bins take everything past their inner planes, so nothing's lost to rounding in the bin indices above
+			float verts[3][3];
+			LoadTriangle(ctx, ref.tri, verts);
+			for (uint32_t b = entry; b <= exit; b++)
+			{
+				const float lo = (b == entry) ? -std::numeric_limits<float>::infinity() : nodeMin[axis] + binWidth * b;
+				const float hi = (b == exit) ? std::numeric_limits<float>::infinity() : nodeMin[axis] + binWidth * (b + 1);
+				float pieceMin[3], pieceMax[3];
+				if (ClipTriangle(verts, axis, lo, hi, ref, pieceMin, pieceMax))
+				{
+					GrowBounds(bins[b].bmin, bins[b].bmax, pieceMin, pieceMax);
+				}
+			}
+		}
+
+		// Same sweeps as [FindSplit]: right-hand sides first, then each plane's cost from the left
+		float rightMin[BVH::numBins][3], rightMax[BVH::numBins][3];
+		uint32_t rightCount[BVH::numBins];
+		float accumMin[3] = { INFINITY, INFINITY, INFINITY }, accumMax[3] = { -INFINITY, -INFINITY, -INFINITY };
+		uint32_t accumCount = 0;
+		for (uint32_t b = BVH::numBins - 1; b > 0; b--)
+		{
+			GrowBounds(accumMin, accumMax, bins[b].bmin, bins[b].bmax);
+			accumCount += bins[b].exits;
+			memcpy(rightMin[b], accumMin, sizeof(accumMin));
+			memcpy(rightMax[b], accumMax, sizeof(accumMax));
+			rightCount[b] = accumCount;
+		}
+
+		for (uint32_t a = 0; a < 3; a++)
+		{
+			accumMin[a] = INFINITY;
+			accumMax[a] = -INFINITY;
+		}
+		accumCount = 0;
+		for (uint32_t b = 1; b < BVH::numBins; b++)
+		{
+			GrowBounds(accumMin, accumMax, bins[b - 1].bmin, bins[b - 1].bmax);
+			accumCount += bins[b - 1].entries;
+			if (accumCount == 0 || rightCount[b] == 0 || accumMin[0] > accumMax[0] || rightMin[b][0] > rightMax[b][0])
+			{
+				continue;
+			}
+
+			const float cost = settings.traversalCost + (HalfArea(accumMin, accumMax) * accumCount + HalfArea(rightMin[b], rightMax[b]) * rightCount[b]) * areaScale;
+			if (cost < outSplit->cost)
+			{
+				outSplit->axis = axis;
+				outSplit->bin = b;
+				outSplit->cost = cost;
+				outSplit->plane = nodeMin[axis] + binWidth * b;
+				outSplit->leftCount = accumCount;
+				outSplit->rightCount = rightCount[b];
+				memcpy(outSplit->leftMin, accumMin, sizeof(accumMin));
+				memcpy(outSplit->leftMax, accumMax, sizeof(accumMax));
+				memcpy(outSplit->rightMin, rightMin[b], sizeof(accumMin));
+				memcpy(outSplit->rightMax, rightMax[b], sizeof(accumMax));
+			}
+		}
+	}
+	return outSplit->cost < std::numeric_limits<float>::infinity();
+}
+
+// Partitions [task]'s references around [split], duplicating references that straddle it unless moving them whole to one side is
+// cheaper ("unsplitting"); left references end up from [task.first], right ones backwards from the end of its capacity. Returns false
+// (with the references untouched) if a side came out empty
+static bool PartitionSpatial(const SpatialContext& ctx, const SpatialTask& task, const float* nodeMin, const float* nodeMax, const SpatialSplit& split,
+							 uint32_t* outLeftCount, uint32_t* outRightCount)
+{
+	PrimRef* refs = ctx.refs + task.first;
+	memcpy(ctx.tmpRefs, refs, task.count * sizeof(PrimRef));
+
+	const uint32_t axis = split.axis;
+	const float invBinWidth = BVH::numBins / (nodeMax[axis] - nodeMin[axis]);
+	float leftMin[3], leftMax[3], rightMin[3], rightMax[3];
+	memcpy(leftMin, split.leftMin, sizeof(leftMin));
+	memcpy(leftMax, split.leftMax, sizeof(leftMax));
+	memcpy(rightMin, split.rightMin, sizeof(rightMin));
+	memcpy(rightMax, split.rightMax, sizeof(rightMax));
+	uint32_t leftCount = split.leftCount, rightCount = split.rightCount; // Estimates for unsplitting, as references are placed
+	uint32_t numLeft = 0, numRight = 0;
+	auto placeLeft = [&](const PrimRef& ref) { refs[numLeft++] = ref; };
+	auto placeRight = [&](const PrimRef& ref) { refs[task.capacity - 1 - numRight++] = ref; };
+	for (uint32_t r = 0; r < task.count; r++)
+	{
+		const PrimRef& ref = ctx.tmpRefs[r];
+		const uint32_t entry = SpatialBinIndex(ref.bmin[axis], nodeMin[axis], invBinWidth), exit = SpatialBinIndex(ref.bmax[axis], nodeMin[axis], invBinWidth);
+		if (exit < split.bin)
+		{
+			placeLeft(ref);
+			continue;
+		}
+		else if (entry >= split.bin)
+		{
+			placeRight(ref);
+			continue;
+		}
+
+		// Straddling: compare duplicating against moving it whole to either side
+		float grownLeftMin[3], grownLeftMax[3], grownRightMin[3], grownRightMax[3];
+		memcpy(grownLeftMin, leftMin, sizeof(leftMin));
+		memcpy(grownLeftMax, leftMax, sizeof(leftMax));
+		memcpy(grownRightMin, rightMin, sizeof(rightMin));
+		memcpy(grownRightMax, rightMax, sizeof(rightMax));
+		GrowBounds(grownLeftMin, grownLeftMax, ref.bmin, ref.bmax);
+		GrowBounds(grownRightMin, grownRightMax, ref.bmin, ref.bmax);
+		const float leftArea = HalfArea(leftMin, leftMax), rightArea = HalfArea(rightMin, rightMax);
+		const float splitCost = leftArea * leftCount + rightArea * rightCount;
+		const float leftOnlyCost = HalfArea(grownLeftMin, grownLeftMax) * leftCount + rightArea * (rightCount - 1);
+		const float rightOnlyCost = leftArea * (leftCount - 1) + HalfArea(grownRightMin, grownRightMax) * rightCount;
+		if (leftOnlyCost < splitCost && leftOnlyCost <= rightOnlyCost)
+		{
+			memcpy(leftMin, grownLeftMin, sizeof(leftMin));
+			memcpy(leftMax, grownLeftMax, sizeof(leftMax));
+			rightCount--;
+			placeLeft(ref);
+			continue;
+		}
+		else if (rightOnlyCost < splitCost)
+		{
+			memcpy(rightMin, grownRightMin, sizeof(rightMin));
+			memcpy(rightMax, grownRightMax, sizeof(rightMax));
+			leftCount--;
+			placeRight(ref);
+			continue;
+		}
+
+		float verts[3][3];
+		LoadTriangle(ctx, ref.tri, verts);
+		PrimRef leftPiece = ref, rightPiece = ref;
+		const bool hasLeft = ClipTriangle(verts, axis, -std::numeric_limits<float>::infinity(), split.plane, ref, leftPiece.bmin, leftPiece.bmax);
+		const bool hasRight = ClipTriangle(verts, axis, split.plane, std::numeric_limits<float>::infinity(), ref, rightPiece.bmin, rightPiece.bmax);
+		if (hasLeft && hasRight)
+		{
+			placeLeft(leftPiece);
+			placeRight(rightPiece);
+		}
+		else if (hasRight)
+		{
+			placeRight(ref);
+		}
+		else
+		{
+			placeLeft(ref);
+		}
+	}
+
+	if (numLeft == 0 || numRight == 0)
+	{
+		memcpy(refs, ctx.tmpRefs, task.count * sizeof(PrimRef));
+		return false;
+	}
+	*outLeftCount = numLeft;
+	*outRightCount = numRight;
+	return true;
+}
+
+// Split [task] into [outLeft]/[outRight] by the cheapest of a binned object split, a spatial split (see [FindSpatialSplit]) and a leaf,
+// falling back to object medians near the depth limit; returns false for leaves
+static bool SplitSpatialTask(const SpatialContext& ctx, const SpatialTask& task, __m128 nodeMin, __m128 nodeMax, __m128 centroidMin, __m128 centroidMax,
+							 SpatialTask* outLeft, SpatialTask* outRight)
+{
+	const BVH::BinnedSAHSettings& settings = ctx.settings;
+	if (task.count <= settings.leafTris)
+	{
+		return false;
+	}
+
+	PrimRef* refs = ctx.refs + task.first;
+	uint32_t leftCount = 0, rightCount = 0;
+	uint32_t rightStart = 0; // Right references start here (relative to [task.first]), before being moved after the left ones' share of the capacity
+	bool split = false;
+	if (task.depth + CeilLog2(task.count) < AS_BVH_MAX_DEPTH - 1)
+	{
+		const __m128 binScale = BinScale(centroidMin, centroidMax);
+		BinSet bins;
+		BinRefs(ctx.refs, task.first, task.first + task.count, centroidMin, binScale, &bins);
+		Split objectSplit = {};
+		const bool canObjectSplit = FindSplit(bins, HalfArea(nodeMin, nodeMax), settings.traversalCost, settings.triangleCost, &objectSplit);
+
+		// Spatial splits only where object splits leave children overlapping (and there's still room for the references they'd add)
+		float overlapArea = 0.0f;
+		if (canObjectSplit)
+		{
+			const __m128 overlapMin = _mm_max_ps(objectSplit.leftMin, objectSplit.rightMin), overlapMax = _mm_min_ps(objectSplit.leftMax, objectSplit.rightMax);
+			overlapArea = ((_mm_movemask_ps(_mm_cmple_ps(overlapMin, overlapMax)) & 0x7) == 0x7) ? HalfArea(overlapMin, overlapMax) : 0.0f;
+		}
+
+		alignas(16) float bmin[4], bmax[4];
+		_mm_store_ps(bmin, nodeMin);
+		_mm_store_ps(bmax, nodeMax);
+		SpatialSplit spatialSplit = {};
+		const bool canSpatialSplit = (!canObjectSplit || overlapArea > settings.splitAlpha * ctx.rootHalfArea) && FindSpatialSplit(ctx, task, bmin, bmax, &spatialSplit) &&
+									 spatialSplit.leftCount + spatialSplit.rightCount <= task.capacity;
+
+		const float leafCost = task.count * settings.triangleCost;
+		const float bestCost = std::min(canObjectSplit ? objectSplit.cost : std::numeric_limits<float>::infinity(),
+										canSpatialSplit ? spatialSplit.cost : std::numeric_limits<float>::infinity());
+		if (task.count <= settings.maxLeafTris && !(bestCost < leafCost))
+		{
+			return false;
+		}
+
+		if (canSpatialSplit && (!canObjectSplit || spatialSplit.cost < objectSplit.cost))
+		{
+			split = PartitionSpatial(ctx, task, bmin, bmax, spatialSplit, &leftCount, &rightCount);
+			rightStart = task.capacity - rightCount;
+		}
+
+		if (!split && canObjectSplit)
+		{
+			// Same partition as [SplitTask], writing right references backwards from the end of the capacity
+			memcpy(ctx.tmpRefs, refs, task.count * sizeof(PrimRef));
+			for (uint32_t r = 0; r < task.count; r++)
+			{
+				alignas(16) int32_t ndx[4];
+				_mm_store_si128(reinterpret_cast<__m128i*>(ndx), BinIndices(ctx.tmpRefs[r], centroidMin, binScale));
+				if (static_cast<uint32_t>(ndx[objectSplit.axis]) < objectSplit.bin)
+				{
+					refs[leftCount++] = ctx.tmpRefs[r];
+				}
+				else
+				{
+					refs[task.capacity - 1 - rightCount++] = ctx.tmpRefs[r];
+				}
+			}
+			assert(leftCount == objectSplit.leftCount);
+			rightStart = task.capacity - rightCount;
+			split = true;
+		}
+	}
+
+	if (!split)
+	{
+		// Object median along the widest centroid axis, as in [SplitTask]
+		alignas(16) float extent[4];
+		_mm_store_ps(extent, _mm_sub_ps(centroidMax, centroidMin));
+		const uint32_t axis = (extent[0] >= extent[1] && extent[0] >= extent[2]) ? 0 : ((extent[1] >= extent[2]) ? 1 : 2);
+		leftCount = task.count / 2;
+		rightCount = task.count - leftCount;
+		rightStart = leftCount;
+		if (extent[axis] > 0.0f)
+		{
+			std::nth_element(refs, refs + leftCount, refs + task.count, [axis](const PrimRef& a, const PrimRef& b)
+			{
+				return (a.bmin[axis] + a.bmax[axis]) < (b.bmin[axis] + b.bmax[axis]);
+			});
+		}
+	}
+
+	// Share out the spare capacity by reference counts, moving the right references up against the left ones' share
+	const uint32_t spare = task.capacity - leftCount - rightCount;
+	const uint32_t leftCapacity = leftCount + static_cast<uint32_t>((static_cast<uint64_t>(spare) * leftCount) / (leftCount + rightCount));
+	memmove(refs + leftCapacity, refs + rightStart, rightCount * sizeof(PrimRef));
+
+	*outLeft = { task.first, leftCount, leftCapacity, task.depth + 1, spatialNoParent };
+	*outRight = { task.first + leftCapacity, rightCount, task.capacity - leftCapacity, task.depth + 1, spatialNoParent };
+	return true;
+}
+
+void BVH::BuildSpatialSplits(const PrimSource& prims, const BinnedSAHSettings& settings)
+{
+	// Scratch: references (with room for the budget's duplicates) + partitioning space, then nodes (leaves hold at least one reference
+	// each) + the triangle list, both filled depth-first
+	const uint64_t budgetRefs = static_cast<uint64_t>(static_cast<double>(numTris) * std::clamp(settings.splitBudget, 0.0f, 4.0f));
+	const uint32_t maxRefs = static_cast<uint32_t>(std::min<uint64_t>(numTris + budgetRefs, UINT32_MAX / 2));
+	auto refs = AllocateAligned<PrimRef>(maxRefs);
+	auto tmpRefs = AllocateAligned<PrimRef>(maxRefs);
+	auto scratch = CPUMemory::AllocateArray<ComputeBVH_Node>(2ull * maxRefs - 1);
+	auto scratchTriList = CPUMemory::AllocateArray<uint32_t>(maxRefs);
+
+	SpatialContext ctx;
+	ctx.refs = AlignedData<PrimRef>(refs);
+	ctx.tmpRefs = AlignedData<PrimRef>(tmpRefs);
+	ctx.positionBytes = reinterpret_cast<const uint8_t*>(prims.positions);
+	ctx.strideBytes = prims.strideBytes;
+	ctx.tris = prims.tris;
+	ctx.settings = settings;
+
+	__m128 rootMin, rootMax, rootCentroidMin, rootCentroidMax;
+	BuildPrimRefs(prims.positions, prims.strideBytes, prims.tris, nullptr, nullptr, numTris, ResolveThreadCount(settings.numThreads), ctx.refs, &rootMin, &rootMax,
+				  &rootCentroidMin, &rootCentroidMax);
+	ctx.rootHalfArea = HalfArea(rootMin, rootMax);
+
+	// Depth-first, left first: nodes are numbered as they're reached, and right children patch their parents once they are
+	ComputeBVH_Node* scratchData = &scratch[0];
+	uint32_t* scratchTriData = &scratchTriList[0];
+	uint32_t numNodes = 0, numListed = 0;
+	SpatialTask stack[AS_BVH_MAX_DEPTH + 1];
+	uint32_t stackSize = 1;
+	stack[0] = { 0, numTris, maxRefs, 0, spatialNoParent };
+	while (stackSize > 0)
+	{
+		SpatialTask task = stack[--stackSize];
+		while (true)
+		{
+			const uint32_t nodeNdx = numNodes++;
+			if (task.parent != spatialNoParent)
+			{
+				scratchData[task.parent].rightOrFirstTri = nodeNdx;
+			}
+
+			__m128 bmin, bmax, centroidMin, centroidMax;
+			RangeBounds(ctx.refs, task.first, task.first + task.count, &bmin, &bmax, &centroidMin, &centroidMax);
+			StoreBounds(scratchData[nodeNdx], bmin, bmax);
+
+			SpatialTask left, right;
+			if (!SplitSpatialTask(ctx, task, bmin, bmax, centroidMin, centroidMax, &left, &right))
+			{
+				scratchData[nodeNdx].rightOrFirstTri = numListed;
+				scratchData[nodeNdx].triCount = task.count;
+				for (uint32_t r = 0; r < task.count; r++)
+				{
+					scratchTriData[numListed++] = ctx.refs[task.first + r].tri;
+				}
+				break;
+			}
+
+			scratchData[nodeNdx].triCount = 0;
+			right.parent = nodeNdx;
+			stack[stackSize++] = right;
+			task = left;
+		}
+	}
+
+	nodes = CPUMemory::AllocateArray<ComputeBVH_Node>(numNodes);
+	triList = CPUMemory::AllocateArray<uint32_t>(numListed);
+	memcpy(&nodes[0], &scratch[0], numNodes * sizeof(ComputeBVH_Node));
+	memcpy(&triList[0], &scratchTriList[0], numListed * sizeof(uint32_t));
+	triListLen = numListed;
+
+	CPUMemory::Free(scratchTriList);
+	CPUMemory::Free(scratch);
+	CPUMemory::Free(tmpRefs);
+	CPUMemory::Free(refs);
+
+	stats.numNodes = numNodes;
+	ResolveStats(settings.traversalCost, settings.triangleCost);
+}
+
+// Linear BVH
+/////////////
+
+// Radix tree children are either branches (indices into [LBVHNode]s) or leaves (single triangles, by sorted position), flagged here
+constexpr uint32_t lbvhLeafFlag = 0x80000000u;
+constexpr uint32_t lbvhNoParent = UINT32_MAX;
+constexpr uint64_t minSortKeysPerThread = 64 * 1024;
+
+// Radix tree branches; bounds/costs/counts are filled in bottom-up (see [ResolveLBVHNodes]), and branches cheaper as a single leaf
+// are [collapsed] in the output
+struct LBVHNode
+{
+	float bmin[3];
+	uint32_t left;
+	float bmax[3];
+	uint32_t right;
+	uint32_t parent;
+	uint32_t triCount;
+	uint32_t nodeCount; // Output nodes for this subtree
+	uint32_t height; // Output levels below this node
+	float cost; // SAH cost, scaled by half-area rather than normalised
+	uint32_t collapsed;
+};
+
+struct LBVHContext
+{
+	PrimRef* refs; // In mesh order
+	PrimRef* sortedRefs; // In Morton order; radix tree leaves index these
+	LBVHNode* nodes;
+	uint32_t* leafParents;
+	uint32_t* arrivals; // Bottom-up passes' visit counters, one per branch
+	uint32_t numTris;
+	uint32_t maxLeafTris;
+	uint32_t treeletSize;
+	float traversalCost, triangleCost;
+};
+
+struct LBVHChild
+{
+	__m128 bmin, bmax;
+	float cost;
+	uint32_t triCount, nodeCount, height;
+};
+
+static LBVHChild GetLBVHChild(const LBVHContext& ctx, uint32_t child)
+{
+	LBVHChild info;
+	if (child & lbvhLeafFlag)
+	{
+		const PrimRef& ref = ctx.sortedRefs[child & ~lbvhLeafFlag];
+		info.bmin = _mm_load_ps(ref.bmin);
+		info.bmax = _mm_load_ps(ref.bmax);
+		info.cost = HalfArea(info.bmin, info.bmax) * ctx.triangleCost;
+		info.triCount = 1;
+		info.nodeCount = 1;
+		info.height = 0;
+	}
+	else
+	{
+		const LBVHNode& node = ctx.nodes[child];
+		info.bmin = _mm_loadu_ps(node.bmin);
+		info.bmax = _mm_loadu_ps(node.bmax);
+		info.cost = node.cost;
+		info.triCount = node.triCount;
+		info.nodeCount = node.nodeCount;
+		info.height = node.height;
+	}
+	return info;
+}
+
+// Resolve a branch from its (finished) children
+static void UpdateLBVHNode(const LBVHContext& ctx, uint32_t n)
+{
+	LBVHNode& node = ctx.nodes[n];
+	const uint32_t left = node.left, right = node.right;
+	const LBVHChild l = GetLBVHChild(ctx, left), r = GetLBVHChild(ctx, right);
+	const __m128 bmin = _mm_min_ps(l.bmin, r.bmin), bmax = _mm_max_ps(l.bmax, r.bmax);
+	_mm_storeu_ps(node.bmin, bmin); // The w lanes land on [left]/[right], restored below
+	_mm_storeu_ps(node.bmax, bmax);
+	node.left = left;
+	node.right = right;
+
+	const float area = HalfArea(bmin, bmax);
+	const float splitCost = ctx.traversalCost * area + l.cost + r.cost;
+	const float leafCost = ctx.triangleCost * area * (l.triCount + r.triCount);
+	node.triCount = l.triCount + r.triCount;
+	node.collapsed = (node.triCount <= ctx.maxLeafTris && leafCost <= splitCost) ? 1 : 0;
+	node.cost = node.collapsed ? leafCost : splitCost;
+	node.nodeCount = node.collapsed ? 1 : 1 + l.nodeCount + r.nodeCount;
+	node.height = node.collapsed ? 0 : 1 + std::max(l.height, r.height);
+}
+
+static void SetLBVHParent(const LBVHContext& ctx, uint32_t child, uint32_t parent)
+{
+	if (child & lbvhLeafFlag)
+	{
+		ctx.leafParents[child & ~lbvhLeafFlag] = parent;
+	}
+	else
+	{
+		ctx.nodes[child].parent = parent;
+	}
+}
+
+// Rebuild treelet [s] (a set of treelet leaves) under branch [n] from the splits found by [RestructureTreelet]
+static void LinkTreelet(const LBVHContext& ctx, uint32_t n, uint32_t s, const uint8_t* splits, const uint32_t* leaves, const uint32_t* branches, uint32_t* nextBranch)
+{
+	const uint32_t sides[2] = { splits[s], s ^ splits[s] };
+	uint32_t children[2];
+	for (uint32_t i = 0; i < 2; i++)
+	{
+		if ((sides[i] & (sides[i] - 1)) == 0)
+		{
+			children[i] = leaves[std::countr_zero(sides[i])];
+		}
+		else
+		{
+			children[i] = branches[(*nextBranch)++];
+			LinkTreelet(ctx, children[i], sides[i], splits, leaves, branches, nextBranch);
+		}
+		SetLBVHParent(ctx, children[i], n);
+	}
+
+	ctx.nodes[n].left = children[0];
+	ctx.nodes[n].right = children[1];
+	UpdateLBVHNode(ctx, n);
+}
+
+// Grow a treelet under [root] by repeatedly opening its largest branch, then rebuild it with the cheapest topology over the same leaves
+// (exhaustively, by dynamic programming over leaf subsets); the branches it opened are reused for the new topology
+static void RestructureTreelet(const LBVHContext& ctx, uint32_t root)
+{
+	uint32_t leaves[BVH::maxTreeletSize], branches[BVH::maxTreeletSize];
+	float leafAreas[BVH::maxTreeletSize];
+	uint32_t numLeaves = 2, numBranches = 0;
+	leaves[0] = ctx.nodes[root].left;
+	leaves[1] = ctx.nodes[root].right;
+	for (uint32_t i = 0; i < 2; i++)
+	{
+		const LBVHChild child = GetLBVHChild(ctx, leaves[i]);
+		leafAreas[i] = (leaves[i] & lbvhLeafFlag) ? -1.0f : HalfArea(child.bmin, child.bmax);
+	}
+
+	while (numLeaves < ctx.treeletSize)
+	{
+		uint32_t largest = UINT32_MAX;
+		for (uint32_t i = 0; i < numLeaves; i++)
+		{
+			if (leafAreas[i] >= 0.0f && (largest == UINT32_MAX || leafAreas[i] > leafAreas[largest]))
+			{
+				largest = i;
+			}
+		}
+
+		if (largest == UINT32_MAX)
+		{
+			break;
+		}
+
+		const LBVHNode& opened = ctx.nodes[leaves[largest]];
+		branches[numBranches++] = leaves[largest];
+		leaves[largest] = opened.left;
+		leaves[numLeaves] = opened.right;
+		for (uint32_t i : { largest, numLeaves })
+		{
+			const LBVHChild child = GetLBVHChild(ctx, leaves[i]);
+			leafAreas[i] = (leaves[i] & lbvhLeafFlag) ? -1.0f : HalfArea(child.bmin, child.bmax);
+		}
+		numLeaves++;
+	}
+
+	if (numLeaves < 4)
+	{
+		return; // Three leaves or less only have one topology (up to mirroring)
+	}
+
+	// Subset bounds/costs, built up from each subset minus its lowest leaf
+	constexpr uint32_t maxSubsets = 1u << BVH::maxTreeletSize;
+	alignas(16) __m128 subsetMin[maxSubsets], subsetMax[maxSubsets];
+	float costs[maxSubsets];
+	uint8_t splits[maxSubsets];
+	const uint32_t numSubsets = 1u << numLeaves;
+	for (uint32_t i = 0; i < numLeaves; i++)
+	{
+		const LBVHChild child = GetLBVHChild(ctx, leaves[i]);
+		subsetMin[1u << i] = child.bmin;
+		subsetMax[1u << i] = child.bmax;
+		costs[1u << i] = child.cost;
+	}
+
+	for (uint32_t s = 1; s < numSubsets; s++)
+	{
+		const uint32_t lowest = s & (0u - s);
+		if (s == lowest)
+		{
+			continue;
+		}
+
+		subsetMin[s] = _mm_min_ps(subsetMin[s ^ lowest], subsetMin[lowest]);
+		subsetMax[s] = _mm_max_ps(subsetMax[s ^ lowest], subsetMax[lowest]);
+
+		// Partitions are symmetric, so only consider the ones which keep the lowest leaf on the left
+		float bestCost = std::numeric_limits<float>::infinity();
+		uint32_t bestSplit = lowest;
+		for (uint32_t p = (s - 1) & s; p > 0; p = (p - 1) & s)
+		{
+			if ((p & lowest) != 0 && costs[p] + costs[s ^ p] < bestCost)
+			{
+				bestCost = costs[p] + costs[s ^ p];
+				bestSplit = p;
+			}
+		}
+		costs[s] = ctx.traversalCost * HalfArea(subsetMin[s], subsetMax[s]) + bestCost;
+		splits[s] = static_cast<uint8_t>(bestSplit);
+	}
+
+	// Only relink when that's an improvement; ties keep the radix tree's topology
+	const LBVHChild l = GetLBVHChild(ctx, ctx.nodes[root].left), r = GetLBVHChild(ctx, ctx.nodes[root].right);
+	const float currentCost = ctx.traversalCost * HalfArea(_mm_min_ps(l.bmin, r.bmin), _mm_max_ps(l.bmax, r.bmax)) + l.cost + r.cost;
+	if (costs[numSubsets - 1] < currentCost * (1.0f - 1e-6f))
+	{
+		uint32_t nextBranch = 0;
+		LinkTreelet(ctx, root, numSubsets - 1, splits, leaves, branches, &nextBranch);
+	}
+}
+
+// Resolve every branch bottom-up: each leaf climbs towards the root, stopping at branches it reaches first (the second arrival has
+// both children finished, and carries on); with [restructure], subtrees with enough triangles are restructured as they complete
+static void ResolveLBVHNodes(const LBVHContext& ctx, uint32_t numThreads, bool restructure)
+{
+	memset(ctx.arrivals, 0, (ctx.numTris - 1) * sizeof(uint32_t));
+	ParallelRanges(ctx.numTris, minRefsPerThread, numThreads, [ctx, restructure](uint32_t, uint64_t first, uint64_t end)
+	{
+		for (uint64_t i = first; i < end; i++)
+		{
+			uint32_t n = ctx.leafParents[i];
+			while (n != lbvhNoParent)
+			{
+				if (std::atomic_ref<uint32_t>(ctx.arrivals[n]).fetch_add(1, std::memory_order_acq_rel) == 0)
+				{
+					break;
+				}
+
+				UpdateLBVHNode(ctx, n);
+				if (restructure && ctx.nodes[n].triCount >= ctx.treeletSize)
+				{
+					RestructureTreelet(ctx, n);
+				}
+				n = ctx.nodes[n].parent;
+			}
+		}
+	});
+}
+
+// Length of the prefix shared by sorted keys [i] and [j], with positions breaking ties between duplicate keys (Karras 2012)
+template<typename keyType>
+static int32_t CommonPrefix(const keyType* keys, int64_t numKeys, int64_t i, int64_t j)
+{
+	if (static_cast<uint64_t>(j) >= static_cast<uint64_t>(numKeys))
+	{
+		return -1;
+	}
+
+	// 32-bit keys append their positions for a branch-free 64-bit compare
+	if constexpr (sizeof(keyType) == 4)
+	{
+		return std::countl_zero(((static_cast<uint64_t>(keys[i]) << 32) | static_cast<uint64_t>(i)) ^ ((static_cast<uint64_t>(keys[j]) << 32) | static_cast<uint64_t>(j)));
+	}
+	else
+	{
+		return (keys[i] == keys[j]) ? static_cast<int32_t>(64 + std::countl_zero(static_cast<uint32_t>(i ^ j))) : std::countl_zero(keys[i] ^ keys[j]);
+	}
+}
+
+// Spread the low 10 bits of [v] to every third bit
+static uint32_t SpreadBits10(uint32_t v)
+{
+	v = (v * 0x00010001u) & 0xFF0000FFu;
+	v = (v * 0x00000101u) & 0x0F00F00Fu;
+	v = (v * 0x00000011u) & 0xC30C30C3u;
+	v = (v * 0x00000005u) & 0x49249249u;
+	return v;
+}
+
+// Spread the low 21 bits of [v] to every third bit
+static uint64_t SpreadBits21(uint64_t v)
+{
+	v &= 0x1fffff;
+	v = (v | (v << 32)) & 0x1f00000000ffffull;
+	v = (v | (v << 16)) & 0x1f0000ff0000ffull;
+	v = (v | (v << 8)) & 0x100f00f00f00f00full;
+	v = (v | (v << 4)) & 0x10c30c30c30c30c3ull;
+	v = (v | (v << 2)) & 0x1249249249249249ull;
+	return v;
+}
+
+// LSD radix sort, eight bits per pass, over the low [numBits] of [keys] (carrying [vals] along); passes split keys into the same
+// per-thread ranges for counting and scattering, and scatter digit-major, so equal keys keep their order; returns true if the results
+// ended up in [tmpKeys]/[tmpVals]
+template<typename keyType>
+static bool RadixSort(keyType* keys, uint32_t* vals, keyType* tmpKeys, uint32_t* tmpVals, uint32_t numKeys, uint32_t numBits, uint32_t numThreads)
+{
+	uint32_t histograms[maxThreads][256];
+	bool inTmp = false;
+	for (uint32_t shift = 0; shift < numBits; shift += 8)
+	{
+		const keyType* srcKeys = inTmp ? tmpKeys : keys;
+		const uint32_t* srcVals = inTmp ? tmpVals : vals;
+		keyType* dstKeys = inTmp ? keys : tmpKeys;
+		uint32_t* dstVals = inTmp ? vals : tmpVals;
+
+		const uint32_t numSortThreads = ParallelRanges(numKeys, minSortKeysPerThread, numThreads, [=, &histograms](uint32_t t, uint64_t first, uint64_t end)
+		{
+			uint32_t* counts = histograms[t];
+			memset(counts, 0, sizeof(histograms[t]));
+			for (uint64_t i = first; i < end; i++)
+			{
+				counts[(srcKeys[i] >> shift) & 0xff]++;
+			}
+		});
+
+		// Skip passes where every key shares a digit (common for the top bits)
+		bool trivialPass = false;
+		uint32_t offset = 0;
+		for (uint32_t digit = 0; digit < 256; digit++)
+		{
+			uint32_t digitCount = 0;
+			for (uint32_t t = 0; t < numSortThreads; t++)
+			{
+				const uint32_t count = histograms[t][digit];
+				histograms[t][digit] = offset;
+				offset += count;
+				digitCount += count;
+			}
+			trivialPass |= (digitCount == numKeys);
+		}
+
+		if (trivialPass)
+		{
+			continue;
+		}
+
+		ParallelRanges(numKeys, minSortKeysPerThread, numThreads, [=, &histograms](uint32_t t, uint64_t first, uint64_t end)
+		{
+			uint32_t* offsets = histograms[t];
+			for (uint64_t i = first; i < end; i++)
+			{
+				const uint32_t dst = offsets[(srcKeys[i] >> shift) & 0xff]++;
+				dstKeys[dst] = srcKeys[i];
+				dstVals[dst] = srcVals[i];
+			}
+		});
+		inTmp = !inTmp;
+	}
+	return inTmp;
+}
+
+// Morton codes -> sorted triangle order + radix tree (Karras 2012); keys are 32-bit for 30-bit codes, or 64-bit for 63-bit codes
+template<typename keyType>
+static void SortAndLinkLBVH(const LBVHContext& ctx, __m128 centroidMin, __m128 centroidMax, uint32_t numThreads)
+{
+	const uint32_t numTris = ctx.numTris;
+	constexpr uint32_t bitsPerAxis = (sizeof(keyType) == 4) ? 10 : 21;
+
+	// Sort scratch, freed (in reverse, off the top of CPUMemory) before returning
+	auto keys = CPUMemory::AllocateArray<keyType>(numTris);
+	auto tmpKeys = CPUMemory::AllocateArray<keyType>(numTris);
+	auto vals = CPUMemory::AllocateArray<uint32_t>(numTris);
+	auto tmpVals = CPUMemory::AllocateArray<uint32_t>(numTris);
+
+	// Quantise centroids within the (per-axis) centroid bounds
+	{
+		alignas(16) float extent[4], scale[4] = {};
+		_mm_store_ps(extent, _mm_sub_ps(centroidMax, centroidMin));
+		for (uint32_t axis = 0; axis < 3; axis++)
+		{
+			scale[axis] = (extent[axis] > 0.0f) ? ((1u << bitsPerAxis) * (1.0f - 1e-6f)) / extent[axis] : 0.0f;
+		}
+
+		const PrimRef* refs = ctx.refs;
+		keyType* keyData = &keys[0];
+		uint32_t* valData = &vals[0];
+		const __m128 quantScale = _mm_load_ps(scale);
+		ParallelRanges(numTris, minRefsPerThread, numThreads, [=](uint32_t, uint64_t first, uint64_t end)
+		{
+			const __m128i maxCell = _mm_set1_epi32((1 << bitsPerAxis) - 1);
+			for (uint64_t i = first; i < end; i++)
+			{
+				const __m128 centroid = _mm_add_ps(_mm_load_ps(refs[i].bmin), _mm_load_ps(refs[i].bmax));
+				const __m128i cell = _mm_max_epi32(_mm_min_epi32(_mm_cvttps_epi32(_mm_mul_ps(_mm_sub_ps(centroid, centroidMin), quantScale)), maxCell), _mm_setzero_si128());
+				alignas(16) uint32_t xyz[4];
+				_mm_store_si128(reinterpret_cast<__m128i*>(xyz), cell);
+				if constexpr (sizeof(keyType) == 4)
+				{
+					keyData[i] = (SpreadBits10(xyz[0]) << 2) | (SpreadBits10(xyz[1]) << 1) | SpreadBits10(xyz[2]);
+				}
+				else
+				{
+					keyData[i] = (SpreadBits21(xyz[0]) << 2) | (SpreadBits21(xyz[1]) << 1) | SpreadBits21(xyz[2]);
+				}
+				valData[i] = static_cast<uint32_t>(i);
+			}
+		});
+	}
+
+	const bool sortedInTmp = RadixSort(&keys[0], &vals[0], &tmpKeys[0], &tmpVals[0], numTris, bitsPerAxis * 3, numThreads);
+	const keyType* sortedKeys = sortedInTmp ? &tmpKeys[0] : &keys[0];
+
+	// Gather references into sorted order, so everything downstream walks them front to back
+	{
+		const uint32_t* order = sortedInTmp ? &tmpVals[0] : &vals[0];
+		ParallelRanges(numTris, minRefsPerThread, numThreads, [ctx, order](uint32_t, uint64_t first, uint64_t end)
+		{
+			for (uint64_t i = first; i < end; i++)
+			{
+				ctx.sortedRefs[i] = ctx.refs[order[i]];
+			}
+		});
+	}
+
+	// Every branch finds its own range + split from the sorted keys, independently of the others
+	ParallelRanges(numTris - 1, minRefsPerThread, numThreads, [ctx, sortedKeys, numTris](uint32_t, uint64_t first, uint64_t end)
+	{
+		const int64_t numKeys = numTris;
+		for (int64_t i = static_cast<int64_t>(first); i < static_cast<int64_t>(end); i++)
+		{
+			// Direction + far end of the range (grown exponentially, then refined by binary search)
+			const int64_t d = (CommonPrefix(sortedKeys, numKeys, i, i + 1) > CommonPrefix(sortedKeys, numKeys, i, i - 1)) ? 1 : -1;
+			const int32_t minPrefix = CommonPrefix(sortedKeys, numKeys, i, i - d);
+			int64_t maxLen = 2;
+			while (CommonPrefix(sortedKeys, numKeys, i, i + maxLen * d) > minPrefix)
+			{
+				maxLen *= 2;
+			}
+
+			int64_t len = 0;
+			for (int64_t step = maxLen / 2; step > 0; step /= 2)
+			{
+				if (CommonPrefix(sortedKeys, numKeys, i, i + (len + step) * d) > minPrefix)
+				{
+					len += step;
+				}
+			}
+			const int64_t j = i + len * d;
+
+			// Split: the last key sharing more than the range's common prefix with [i]
+			const int32_t nodePrefix = CommonPrefix(sortedKeys, numKeys, i, j);
+			int64_t split = 0;
+			int64_t step = len;
+			do
+			{
+				step = (step + 1) / 2;
+				if (CommonPrefix(sortedKeys, numKeys, i, i + (split + step) * d) > nodePrefix)
+				{
+					split += step;
+				}
+			} while (step > 1);
+			const int64_t gamma = i + split * d + std::min<int64_t>(d, 0);
+
+			LBVHNode& node = ctx.nodes[i];
+			node.left = (std::min(i, j) == gamma) ? static_cast<uint32_t>(gamma) | lbvhLeafFlag : static_cast<uint32_t>(gamma);
+			node.right = (std::max(i, j) == gamma + 1) ? static_cast<uint32_t>(gamma + 1) | lbvhLeafFlag : static_cast<uint32_t>(gamma + 1);
+			SetLBVHParent(ctx, node.left, static_cast<uint32_t>(i));
+			SetLBVHParent(ctx, node.right, static_cast<uint32_t>(i));
+		}
+	});
+	ctx.nodes[0].parent = lbvhNoParent;
+
+	CPUMemory::Free(tmpVals);
+	CPUMemory::Free(vals);
+	CPUMemory::Free(tmpKeys);
+	CPUMemory::Free(keys);
+}
+
+// Force-collapse branches at the traversal depth limit, recounting output nodes above them; only needed for pathological trees
+static uint32_t LimitLBVHDepth(const LBVHContext& ctx, uint32_t child, uint32_t depth)
+{
+	if ((child & lbvhLeafFlag) || ctx.nodes[child].collapsed)
+	{
+		return 1;
+	}
+
+	LBVHNode& node = ctx.nodes[child];
+	if (depth >= AS_BVH_MAX_DEPTH - 1)
+	{
+		node.collapsed = 1;
+		node.nodeCount = 1;
+		node.height = 0;
+		return 1;
+	}
+
+	node.nodeCount = 1 + LimitLBVHDepth(ctx, node.left, depth + 1) + LimitLBVHDepth(ctx, node.right, depth + 1);
+	return node.nodeCount;
+}
+
+static uint32_t LBVHParent(const LBVHContext& ctx, uint32_t child)
+{
+	return (child & lbvhLeafFlag) ? ctx.leafParents[child & ~lbvhLeafFlag] : ctx.nodes[child].parent;
+}
+
+// List the triangles under [child] (in left-to-right order), walking parent links instead of keeping a stack; where we came from
+// decides where to go next
+static uint32_t ListLBVHTris(const LBVHContext& ctx, uint32_t child, uint32_t* outTris)
+{
+	const uint32_t exit = LBVHParent(ctx, child);
+	uint32_t numListed = 0;
+	uint32_t curr = child, prev = exit;
+	while (true)
+	{
+		uint32_t next;
+		if (curr & lbvhLeafFlag)
+		{
+			outTris[numListed++] = ctx.sortedRefs[curr & ~lbvhLeafFlag].tri;
+			next = prev;
+		}
+		else
+		{
+			const LBVHNode& node = ctx.nodes[curr];
+			next = (prev == node.parent) ? node.left : (prev == node.left) ? node.right : node.parent;
+		}
+
+		if (curr == child && next == exit)
+		{
+			return numListed;
+		}
+		prev = curr;
+		curr = next;
+	}
+}
+
+struct LBVHEmitTask
+{
+	uint32_t child, out, firstTri;
+};
+
+// Write [task]'s subtree depth-first into [nodes]/[triList]; subtrees below [maxTaskTris] triangles go to [frontier] instead (while it
+// has room), for threads to finish
+static void EmitLBVH(const LBVHContext& ctx, LBVHEmitTask task, ComputeBVH_Node* nodes, uint32_t* triList, uint32_t maxTaskTris, LBVHEmitTask* frontier,
+					 uint64_t maxFrontier, uint64_t* numFrontier)
+{
+	LBVHEmitTask stack[AS_BVH_MAX_DEPTH + 1];
+	uint32_t stackSize = 1;
+	stack[0] = task;
+	while (stackSize > 0)
+	{
+		task = stack[--stackSize];
+		while (true)
+		{
+			const LBVHChild info = GetLBVHChild(ctx, task.child);
+			if (info.triCount <= maxTaskTris && *numFrontier < maxFrontier)
+			{
+				frontier[(*numFrontier)++] = task;
+				break;
+			}
+
+			ComputeBVH_Node& out = nodes[task.out];
+			StoreBounds(out, info.bmin, info.bmax);
+			if ((task.child & lbvhLeafFlag) || ctx.nodes[task.child].collapsed)
+			{
+				out.rightOrFirstTri = task.firstTri;
+				out.triCount = ListLBVHTris(ctx, task.child, triList + task.firstTri);
+				break;
+			}
+
+			const LBVHNode& node = ctx.nodes[task.child];
+			const LBVHChild left = GetLBVHChild(ctx, node.left);
+			const LBVHEmitTask leftTask = { node.left, task.out + 1, task.firstTri };
+			const LBVHEmitTask rightTask = { node.right, task.out + 1 + left.nodeCount, task.firstTri + left.triCount };
+			out.rightOrFirstTri = rightTask.out;
+			out.triCount = 0;
+
+			stack[stackSize++] = rightTask;
+			task = leftTask;
+		}
+	}
+}
+
+void BVH::BuildLBVH(const float4* positions, [[maybe_unused]] uint64_t numVerts, uint64_t strideBytes, const IndexedTriangle* tris, uint32_t _numTris, const LBVHSettings& settings)
+{
+	assert(TriIndicesInRange(tris, _numTris, numVerts));
+	BuildLBVH({ positions, strideBytes, tris, nullptr, nullptr }, _numTris, settings);
+}
+
+void BVH::BuildLBVH(const float4* boxMins, const float4* boxMaxs, uint32_t numBoxes, const LBVHSettings& settings)
+{
+	BuildLBVH({ nullptr, 0, nullptr, boxMins, boxMaxs }, numBoxes, settings);
+}
+
+void BVH::BuildLBVH(const PrimSource& prims, uint32_t _numTris, const LBVHSettings& settings)
+{
+	lastBuilder = Builder::LBVH;
+	lbvhSettings = settings;
+	builtOverBoxes = (prims.boxMins != nullptr);
+	numTris = _numTris;
+	triListLen = _numTris;
+	stats = {};
+
+	LBVHContext ctx = {};
+	ctx.numTris = numTris;
+	ctx.maxLeafTris = std::max(settings.maxLeafTris, 1u);
+	ctx.treeletSize = (settings.treeletPasses > 0) ? std::min(settings.treeletSize, maxTreeletSize) : 0;
+	ctx.traversalCost = settings.traversalCost;
+	ctx.triangleCost = settings.triangleCost;
+	const uint32_t numThreads = ResolveThreadCount(settings.numThreads);
+
+	// Scratch, in one allocation so it comes off the top of CPUMemory in one go
+	const uint64_t numScratchTris = std::max(numTris, 1u);
+	auto scratch = CPUMemory::AllocateArray<uint8_t>(numScratchTris * (2 * sizeof(PrimRef) + sizeof(LBVHNode) + 2 * sizeof(uint32_t)) + 16);
+	{
+		uint8_t* base = reinterpret_cast<uint8_t*>((reinterpret_cast<uintptr_t>(&scratch[0]) + 15) & ~uintptr_t(15));
+		ctx.refs = reinterpret_cast<PrimRef*>(base);
+		ctx.sortedRefs = ctx.refs + numScratchTris;
+		ctx.nodes = reinterpret_cast<LBVHNode*>(ctx.sortedRefs + numScratchTris);
+		ctx.leafParents = reinterpret_cast<uint32_t*>(ctx.nodes + numScratchTris);
+		ctx.arrivals = ctx.leafParents + numScratchTris;
+	}
+
+	__m128 rootMin, rootMax, centroidMin, centroidMax;
+	BuildPrimRefs(prims.positions, prims.strideBytes, prims.tris, prims.boxMins, prims.boxMaxs, numTris, numThreads, ctx.refs, &rootMin, &rootMax, &centroidMin, &centroidMax);
+
+	// Radix trees need two triangles; smaller meshes become a single leaf (inverted bounds for empty meshes, so no ray enters it)
+	if (numTris < 2)
+	{
+		nodes = CPUMemory::AllocateArray<ComputeBVH_Node>(1);
+		triList = CPUMemory::AllocateArray<uint32_t>(1);
+		nodes[0].boundsMin = float3(FLT_MAX, FLT_MAX, FLT_MAX);
+		nodes[0].boundsMax = float3(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+		if (numTris > 0)
+		{
+			StoreBounds(nodes[0], rootMin, rootMax);
+		}
+		nodes[0].rightOrFirstTri = 0;
+		nodes[0].triCount = numTris;
+		triList[0] = 0;
+		CPUMemory::Free(scratch);
+
+		stats.numNodes = 1;
+		ResolveStats(ctx.traversalCost, ctx.triangleCost);
+		return;
+	}
+
+	if (settings.wideCodes)
+	{
+		SortAndLinkLBVH<uint64_t>(ctx, centroidMin, centroidMax, numThreads);
+	}
+	else
+	{
+		SortAndLinkLBVH<uint32_t>(ctx, centroidMin, centroidMax, numThreads);
+	}
+
+	ResolveLBVHNodes(ctx, numThreads, false);
+	for (uint32_t pass = 0; pass < settings.treeletPasses && ctx.treeletSize >= 4; pass++)
+	{
+		ResolveLBVHNodes(ctx, numThreads, true);
+	}
+
+	if (ctx.nodes[0].height >= AS_BVH_MAX_DEPTH)
+	{
+		LimitLBVHDepth(ctx, 0, 0);
+	}
+
+	// Depth-first output; the top of the tree is written here, and subtrees below [maxTaskTris] triangles are finished across threads
+	const uint32_t numNodes = ctx.nodes[0].nodeCount;
+	nodes = CPUMemory::AllocateArray<ComputeBVH_Node>(numNodes);
+	triList = CPUMemory::AllocateArray<uint32_t>(numTris);
+	{
+		const uint32_t maxTaskTris = (numThreads > 1) ? std::max(minTaskRefs, numTris / (numThreads * 8)) : 0;
+		const uint64_t maxFrontier = (numThreads > 1) ? (numTris / maxTaskTris) * 4 + 2 : 0;
+		auto frontier = CPUMemory::AllocateArray<LBVHEmitTask>(std::max<uint64_t>(maxFrontier, 1));
+		LBVHEmitTask* frontierData = &frontier[0];
+		ComputeBVH_Node* nodeData = &nodes[0];
+		uint32_t* triListData = &triList[0];
+
+		uint64_t numFrontier = 0;
+		EmitLBVH(ctx, { 0, 0, 0 }, nodeData, triListData, maxTaskTris, frontierData, maxFrontier, &numFrontier);
+		std::sort(frontierData, frontierData + numFrontier, [&ctx](const LBVHEmitTask& a, const LBVHEmitTask& b)
+		{
+			return GetLBVHChild(ctx, a.child).triCount > GetLBVHChild(ctx, b.child).triCount;
+		});
+
+		RunTasks(numFrontier, numThreads, [&ctx, frontierData, nodeData, triListData](uint64_t t)
+		{
+			uint64_t noFrontier = 0;
+			EmitLBVH(ctx, frontierData[t], nodeData, triListData, 0, nullptr, 0, &noFrontier);
+		});
+		CPUMemory::Free(frontier);
+	}
+	CPUMemory::Free(scratch);
+
+	stats.numNodes = numNodes;
+	ResolveStats(ctx.traversalCost, ctx.triangleCost);
+}
+
+// Refitting
+////////////
+
+// Refit subtrees are handed out by node count alone (not thread count), so refit SAH costs sum in the same order for any number of threads
+constexpr uint32_t refitTaskNodes = 4096;
+
+struct RefitContext
+{
+	ComputeBVH_Node* nodes;
+	const uint32_t* triList;
+	const float4* positions;
+	uint64_t strideBytes;
+	const IndexedTriangle* tris;
+	float traversalCost, triangleCost;
+};
+
+// Subtrees are contiguous in depth-first order, so [first, end) covers one; [areaCost] accumulates node area * node cost, [unitCost] the
+// same costs without areas (see [BVH::Refit])
+struct RefitRange
+{
+	uint32_t first, end;
+	double areaCost, unitCost;
+};
+
+// Recompute bounds for [n] from its triangles (leaves) or children (branches, which must already be refit), and return its SAH cost
+// over its half-area
+static float RefitNode(const RefitContext& ctx, uint32_t n, double* outArea)
+{
+	ComputeBVH_Node& node = ctx.nodes[n];
+	__m128 bmin, bmax;
+	if (node.triCount > 0)
+	{
+		bmin = _mm_set1_ps(std::numeric_limits<float>::infinity());
+		bmax = _mm_set1_ps(-std::numeric_limits<float>::infinity());
+		const uint8_t* positionBytes = reinterpret_cast<const uint8_t*>(ctx.positions);
+		for (uint32_t i = 0; i < node.triCount; i++)
+		{
+			const uint4& ndx = ctx.tris[ctx.triList[node.rightOrFirstTri + i]].xyz;
+			const __m128 v0 = _mm_loadu_ps(reinterpret_cast<const float*>(positionBytes + ndx.x * ctx.strideBytes));
+			const __m128 v1 = _mm_loadu_ps(reinterpret_cast<const float*>(positionBytes + ndx.y * ctx.strideBytes));
+			const __m128 v2 = _mm_loadu_ps(reinterpret_cast<const float*>(positionBytes + ndx.z * ctx.strideBytes));
+			bmin = _mm_min_ps(bmin, _mm_min_ps(_mm_min_ps(v0, v1), v2));
+			bmax = _mm_max_ps(bmax, _mm_max_ps(_mm_max_ps(v0, v1), v2));
+		}
+	}
+	else
+	{
+		// The w lanes pick up child indices/counts as junk floats, which StoreBounds drops
+		const ComputeBVH_Node& left = ctx.nodes[n + 1];
+		const ComputeBVH_Node& right = ctx.nodes[node.rightOrFirstTri];
+		bmin = _mm_min_ps(_mm_loadu_ps(&left.boundsMin.x), _mm_loadu_ps(&right.boundsMin.x));
+		bmax = _mm_max_ps(_mm_loadu_ps(&left.boundsMax.x), _mm_loadu_ps(&right.boundsMax.x));
+	}
+	StoreBounds(node, bmin, bmax);
+
+	*outArea = HalfArea(node);
+	return (node.triCount > 0) ? ctx.triangleCost * node.triCount : ctx.traversalCost;
+}
+
+// Refit every node in [range], back to front (children always follow their parents in depth-first order)
+static void RefitRangeNodes(const RefitContext& ctx, RefitRange* range)
+{
+	double areaCost = 0.0, unitCost = 0.0;
+	for (uint32_t n = range->end; n > range->first; n--)
+	{
+		double area;
+		const float cost = RefitNode(ctx, n - 1, &area);
+		areaCost += area * cost;
+		unitCost += cost;
+	}
+	range->areaCost = areaCost;
+	range->unitCost = unitCost;
+}
+
+bool BVH::Refit(const float4* positions, uint64_t numVerts, uint64_t strideBytes, const IndexedTriangle* tris, const RefitSettings& settings)
+{
+	assert(!builtOverBoxes); // Box trees (e.g. TLASes) are cheap enough to rebuild
+	if (numTris == 0)
+	{
+		return false; // Nothing to move; empty trees keep their inverted root bounds
+	}
+
+	RefitContext ctx = {};
+	ctx.nodes = &nodes[0];
+	ctx.triList = &triList[0];
+	ctx.positions = positions;
+	ctx.strideBytes = strideBytes;
+	ctx.tris = tris;
+	ctx.traversalCost = sahTraversalCost;
+	ctx.triangleCost = sahTriangleCost;
+
+	// Split the tree into subtrees of up to [refitTaskNodes] nodes, found top-down (a left child's subtree ends where its sibling starts,
+	// and a right child's where its parent's does); when the range list fills, subtrees refit immediately instead
+	const uint32_t numNodes = stats.numNodes;
+	const uint64_t maxRanges = (numNodes / refitTaskNodes) * 4 + 2;
+	auto ranges = CPUMemory::AllocateArray<RefitRange>(maxRanges);
+	RefitRange* rangeData = &ranges[0];
+	uint64_t numRanges = 0;
+	double areaCost = 0.0, unitCost = 0.0;
+	{
+		RefitRange stack[AS_BVH_MAX_DEPTH + 1];
+		uint32_t stackSize = 1;
+		stack[0] = { 0, numNodes, 0.0, 0.0 };
+		while (stackSize > 0)
+		{
+			RefitRange range = stack[--stackSize];
+			if (range.end - range.first <= refitTaskNodes)
+			{
+				if (numRanges < maxRanges)
+				{
+					rangeData[numRanges++] = range;
+				}
+				else
+				{
+					RefitRangeNodes(ctx, &range);
+					areaCost += range.areaCost;
+					unitCost += range.unitCost;
+				}
+				continue;
+			}
+
+			const uint32_t right = ctx.nodes[range.first].rightOrFirstTri;
+			stack[stackSize++] = { right, range.end, 0.0, 0.0 };
+			stack[stackSize++] = { range.first + 1, right, 0.0, 0.0 };
+		}
+	}
+
+	RunTasks(numRanges, ResolveThreadCount(settings.numThreads), [&ctx, rangeData](uint64_t r)
+	{
+		RefitRangeNodes(ctx, &rangeData[r]);
+	});
+
+	for (uint64_t r = 0; r < numRanges; r++)
+	{
+		areaCost += rangeData[r].areaCost;
+		unitCost += rangeData[r].unitCost;
+	}
+	CPUMemory::Free(ranges);
+
+	// Then the nodes above them, children first: a post-order walk that skips the subtrees handled above
+	{
+		struct Pending
+		{
+			uint32_t first, end;
+			bool childrenDone;
+		};
+		Pending stack[(AS_BVH_MAX_DEPTH + 1) * 2]; // The path down, plus right siblings waiting on it
+		uint32_t stackSize = 0;
+		if (numNodes > refitTaskNodes)
+		{
+			stack[stackSize++] = { 0, numNodes, false };
+		}
+
+		while (stackSize > 0)
+		{
+			Pending& pending = stack[stackSize - 1];
+			if (pending.childrenDone)
+			{
+				double area;
+				const float cost = RefitNode(ctx, pending.first, &area);
+				areaCost += area * cost;
+				unitCost += cost;
+				stackSize--;
+				continue;
+			}
+
+			pending.childrenDone = true;
+			const Pending parent = pending;
+			const uint32_t right = ctx.nodes[parent.first].rightOrFirstTri;
+			if (parent.end - right > refitTaskNodes)
+			{
+				stack[stackSize++] = { right, parent.end, false };
+			}
+			if (right - (parent.first + 1) > refitTaskNodes)
+			{
+				stack[stackSize++] = { parent.first + 1, right, false };
+			}
+		}
+	}
+
+	// Same normalisation as [ResolveStats]
+	const double rootArea = HalfArea(ctx.nodes[0]);
+	stats.sahCost = static_cast<float>((rootArea > 0.0) ? areaCost / rootArea : unitCost);
+
+	if (builtSAHCost > 0.0f && stats.sahCost > builtSAHCost * settings.maxSAHGrowth)
+	{
+		Rebuild(positions, numVerts, strideBytes, tris);
+		return true;
+	}
+	return false;
+}
+
+void BVH::Rebuild(const float4* positions, uint64_t numVerts, uint64_t strideBytes, const IndexedTriangle* tris)
+{
+	const uint32_t rebuildTris = numTris;
+	DeInit();
+	if (lastBuilder == Builder::LBVH)
+	{
+		BuildLBVH(positions, numVerts, strideBytes, tris, rebuildTris, lbvhSettings);
+	}
+	else
+	{
+		BuildBinnedSAH(positions, numVerts, strideBytes, tris, rebuildTris, binnedSAHSettings);
+	}
+}
+
+void BVH::ResolveStats(float traversalCost, float triangleCost)
+{
+	const ComputeBVH_Node* nodeData = &nodes[0];
+	const double rootArea = HalfArea(nodeData[0]);
+
+	struct Pending
+	{
+		uint32_t node, depth;
+	};
+	Pending stack[AS_BVH_MAX_DEPTH + 1];
+	uint32_t stackSize = 1;
+	stack[0] = { 0, 0 };
+
+	double sahCost = 0.0;
+	while (stackSize > 0)
+	{
+		Pending pending = stack[--stackSize];
+		while (true)
+		{
+			const ComputeBVH_Node& node = nodeData[pending.node];
+			const double areaRatio = (numTris > 0 && rootArea > 0.0) ? HalfArea(node) / rootArea : 1.0;
+			stats.depth = std::max(stats.depth, pending.depth);
+			if (node.triCount > 0 || numTris == 0)
+			{
+				stats.numLeaves++;
+				stats.maxLeafTris = std::max(stats.maxLeafTris, node.triCount);
+				sahCost += areaRatio * node.triCount * triangleCost;
+				break;
+			}
+
+			sahCost += areaRatio * traversalCost;
+			stack[stackSize++] = { node.rightOrFirstTri, pending.depth + 1 };
+			pending = { pending.node + 1, pending.depth + 1 };
+		}
+	}
+
+	stats.sahCost = static_cast<float>(sahCost);
+	sahTraversalCost = traversalCost;
+	sahTriangleCost = triangleCost;
+	builtSAHCost = stats.sahCost;
+	stats.nodeBytes = stats.numNodes * sizeof(ComputeBVH_Node);
+	stats.triListBytes = static_cast<uint64_t>(triListLen) * sizeof(uint32_t);
+}
+
+void BVH::DeInit()
+{
+	CPUMemory::Free(triList);
+	CPUMemory::Free(nodes);
+	triList = {};
+	nodes = {};
+	numTris = 0;
+	triListLen = 0;
+	stats = {};
+	builtSAHCost = 0.0f;
+}
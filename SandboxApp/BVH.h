@@ -0,0 +1,137 @@
+#pragma once
+
+#include <stdint.h>
+#include "../CPUMemory.h"
+#include "../Math.h"
+#include "../Shaders/SharedStructs.h"
+
+// CPU-side BVH builders for the compute AS (see ComputeBVH_Node in SharedStructs.h)
+// - Output is a depth-first node array plus a triangle list (triangle IDs in leaf order); both are uploaded as-is
+// - [BuildBinnedSAH] splits top-down with the binned surface area heuristic (Wald 2007): [numBins] centroid bins per axis, filled
+//   four lanes at a time; large nodes bin across threads, and once there's enough independent work, subtrees build as separate tasks
+//   across [numThreads] threads (zero for one per hardware thread)
+// - With [spatialSplits], binned SAH builds also weigh spatial splits (Stich et al. 2009): nodes whose best object split leaves children
+//   overlapping by more than [splitAlpha] of the root's area bin along planes too, chopping triangles at bin boundaries (so each piece
+//   gets the bounds of the part of the triangle it holds), and the cheaper split wins; triangles straddling a spatial split are
+//   duplicated into both children (or moved whole into one, when that's cheaper), up to [splitBudget] extra references overall. These
+//   builds run on one thread, and only over triangles; leaf bounds then only cover their triangles' pieces, and triangles can be listed
+//   more than once
+// - [BuildLBVH] trades tree quality for build speed (Karras 2012): triangles are sorted along a Morton curve through their centroids
+//   with a parallel radix sort, and every branch of the resulting radix tree is found independently; bounds/costs are then resolved
+//   bottom-up, optionally restructuring small treelets towards lower SAH costs as they're finished (Karras & Aila 2013), and cheap
+//   subtrees collapse into leaves
+// - [Refit] moves the tree along with its geometry without changing its topology: bounds are recomputed bottom-up (subtrees in parallel,
+//   then the nodes above them), and the tree is rebuilt with its last builder + settings once refitting has grown its SAH cost too far
+// - Builds allocate through CPUMemory, so nothing else should allocate/free while one runs
+class BVH
+{
+	public:
+		static constexpr uint32_t numBins = 16;
+
+		struct BinnedSAHSettings
+		{
+			uint32_t leafTris = 4; // Nodes this small always become leaves
+			uint32_t maxLeafTris = 16; // Nodes up to this size become leaves when splitting them costs more (by the SAH) than testing every triangle
+			float traversalCost = 1.0f; // Relative to one ray/triangle test
+			float triangleCost = 1.0f;
+			uint32_t numThreads = 0;
+			bool spatialSplits = false;
+			float splitAlpha = 1e-5f; // Child overlap (relative to the root's surface area) past which spatial splits are considered
+			float splitBudget = 0.3f; // Extra references allowed by spatial splits, relative to the triangle count
+		};
+
+		static constexpr uint32_t maxTreeletSize = 8;
+
+		struct LBVHSettings
+		{
+			bool wideCodes = false; // 63-bit Morton codes (21 bits per axis) rather than 30-bit (10 per axis); finer ordering, twice the sorting passes
+			uint32_t treeletSize = 0; // Leaves per restructured treelet, up to [maxTreeletSize]; zero (or [treeletPasses] zero) skips restructuring
+			uint32_t treeletPasses = 1;
+			uint32_t maxLeafTris = 8; // Subtrees up to this size collapse into leaves when that's cheaper by the SAH
+			float traversalCost = 1.0f; // Relative to one ray/triangle test
+			float triangleCost = 1.0f;
+			uint32_t numThreads = 0;
+		};
+
+		struct RefitSettings
+		{
+			float maxSAHGrowth = 1.5f; // Rebuild once the refit tree's SAH cost passes this multiple of the freshly-built tree's
+			uint32_t numThreads = 0;
+		};
+
+		struct Stats
+		{
+			uint32_t numNodes;
+			uint32_t numLeaves;
+			uint32_t depth; // Deepest level reached (the root is level zero)
+			uint32_t maxLeafTris;
+			float sahCost; // Expected cost per ray (in the build's traversal/triangle cost units), for rays which hit the root
+			uint64_t nodeBytes;
+			uint64_t triListBytes;
+		};
+
+		// [positions] are strided (e.g. &vbuffer[0].pos), and indexed by [tris]
+		void BuildBinnedSAH(const float4* positions, uint64_t numVerts, uint64_t strideBytes, const IndexedTriangle* tris, uint32_t numTris, const BinnedSAHSettings& settings);
+		void BuildLBVH(const float4* positions, uint64_t numVerts, uint64_t strideBytes, const IndexedTriangle* tris, uint32_t numTris, const LBVHSettings& settings);
+
+		// Builds over boxes rather than triangles (e.g. instance bounds, for a two-level AS); the triangle list indexes boxes instead
+		void BuildBinnedSAH(const float4* boxMins, const float4* boxMaxs, uint32_t numBoxes, const BinnedSAHSettings& settings);
+		void BuildLBVH(const float4* boxMins, const float4* boxMaxs, uint32_t numBoxes, const LBVHSettings& settings);
+
+		// Debug check for anything built over triangles: every index in [tris] addresses one of the [numVerts] positions
+		static bool TriIndicesInRange(const IndexedTriangle* tris, uint32_t numTris, uint64_t numVerts);
+
+		// Positions/triangles must be the ones the tree was built over (box-built trees can't be refit), after any movement (e.g. animated vertices, or instances already
+		// transformed into scene space); returns true if refitting degraded the tree enough to trigger a rebuild
+		// Refit leaves bound whole triangles, so spatially-split trees lose their clipped bounds until they're rebuilt
+		bool Refit(const float4* positions, uint64_t numVerts, uint64_t strideBytes, const IndexedTriangle* tris, const RefitSettings& settings);
+		void DeInit();
+
+		CPUMemory::ArrayAllocHandle<ComputeBVH_Node> Nodes() const { return nodes; }
+		CPUMemory::ArrayAllocHandle<uint32_t> TriList() const { return triList; }
+		uint32_t NumNodes() const { return stats.numNodes; }
+		uint32_t NumTris() const { return numTris; }
+		uint32_t TriListLen() const { return triListLen; } // Past [NumTris] when spatial splits duplicated references
+		const Stats& GetStats() const { return stats; }
+		float SAHGrowth() const { return (builtSAHCost > 0.0f) ? stats.sahCost / builtSAHCost : 1.0f; } // Since the last build
+
+	private:
+		// Triangles (positions + indices), or boxes when [boxMins] is set
+		struct PrimSource
+		{
+			const float4* positions;
+			uint64_t strideBytes;
+			const IndexedTriangle* tris;
+			const float4* boxMins;
+			const float4* boxMaxs;
+		};
+
+		void BuildBinnedSAH(const PrimSource& prims, uint32_t numPrims, const BinnedSAHSettings& settings);
+		void BuildLBVH(const PrimSource& prims, uint32_t numPrims, const LBVHSettings& settings);
+		void BuildSpatialSplits(const PrimSource& prims, const BinnedSAHSettings& settings);
+
+		// Fills [stats] from the finished tree
+		void ResolveStats(float traversalCost, float triangleCost);
+
+		// Repeats the last build over moved geometry
+		void Rebuild(const float4* positions, uint64_t numVerts, uint64_t strideBytes, const IndexedTriangle* tris);
+
+		enum class Builder
+		{
+			BinnedSAH,
+			LBVH
+		};
+
+		CPUMemory::ArrayAllocHandle<ComputeBVH_Node> nodes;
+		CPUMemory::ArrayAllocHandle<uint32_t> triList;
+		uint32_t numTris = 0;
+		uint32_t triListLen = 0;
+		Stats stats = {};
+
+		Builder lastBuilder = Builder::BinnedSAH;
+		bool builtOverBoxes = false;
+		BinnedSAHSettings binnedSAHSettings;
+		LBVHSettings lbvhSettings;
+		float sahTraversalCost = 1.0f, sahTriangleCost = 1.0f;
+		float builtSAHCost = 0.0f;
+};
@@ -0,0 +1,157 @@
+#include "Bounds.h"
+
+#include <immintrin.h>
+#include <algorithm>
+#include <limits>
+#include <thread>
+
+// Below this many vertices per thread, spawning threads costs more than it saves
+constexpr uint64_t minVertsPerThread = 256 * 1024;
+
+// Columns of the (scaled) rotation matrix for an SQT transform, plus its translation; w lanes are zero so they never disturb xyz
+struct SSE_Transform
+{
+	__m128 c0, c1, c2, t;
+};
+
+SSE_Transform SSE_TransformFromSQT(const transform& xform)
+{
+	const float x = xform.rotation.x, y = xform.rotation.y, z = xform.rotation.z, w = xform.rotation.w;
+	const float s = xform.translationAndScale.w;
+
+	// Same convention as SceneGraph (v' = q * v * q^-1)
+	SSE_Transform sse;
+	sse.c0 = _mm_setr_ps((1.0f - 2.0f * (y * y + z * z)) * s, 2.0f * (x * y + w * z) * s, 2.0f * (x * z - w * y) * s, 0.0f);
+	sse.c1 = _mm_setr_ps(2.0f * (x * y - w * z) * s, (1.0f - 2.0f * (x * x + z * z)) * s, 2.0f * (y * z + w * x) * s, 0.0f);
+	sse.c2 = _mm_setr_ps(2.0f * (x * z + w * y) * s, 2.0f * (y * z - w * x) * s, (1.0f - 2.0f * (x * x + y * y)) * s, 0.0f);
+	sse.t = _mm_setr_ps(xform.translationAndScale.x, xform.translationAndScale.y, xform.translationAndScale.z, 0.0f);
+	return sse;
+}
+
+__m128 SSE_ApplyTransform(const SSE_Transform& xform, __m128 p)
+{
+	const __m128 px = _mm_shuffle_ps(p, p, _MM_SHUFFLE(0, 0, 0, 0));
+	const __m128 py = _mm_shuffle_ps(p, p, _MM_SHUFFLE(1, 1, 1, 1));
+	const __m128 pz = _mm_shuffle_ps(p, p, _MM_SHUFFLE(2, 2, 2, 2));
+	return _mm_fmadd_ps(xform.c2, pz, _mm_fmadd_ps(xform.c1, py, _mm_fmadd_ps(xform.c0, px, xform.t)));
+}
+
+// Reduce vertices [first, first + num) into [outMin]/[outMax]
+template<bool transformed>
+void ReduceRange(const uint8_t* base, uint64_t first, uint64_t num, uint64_t strideBytes, const SSE_Transform& xform, __m128* outMin, __m128* outMax)
+{
+	__m128 minA = _mm_set1_ps(std::numeric_limits<float>::infinity());
+	__m128 maxA = _mm_set1_ps(-std::numeric_limits<float>::infinity());
+	__m128 minB = minA;
+	__m128 maxB = maxA;
+
+	const uint8_t* v = base + first * strideBytes;
+	const uint64_t numPairs = num / 2;
+	for (uint64_t i = 0; i < numPairs; i++)
+	{
+		__m128 a = _mm_loadu_ps(reinterpret_cast<const float*>(v));
+		__m128 b = _mm_loadu_ps(reinterpret_cast<const float*>(v + strideBytes));
+		if constexpr (transformed)
+		{
+			a = SSE_ApplyTransform(xform, a);
+			b = SSE_ApplyTransform(xform, b);
+		}
+
+		minA = _mm_min_ps(minA, a);
+		maxA = _mm_max_ps(maxA, a);
+		minB = _mm_min_ps(minB, b);
+		maxB = _mm_max_ps(maxB, b);
+		v += strideBytes * 2;
+	}
+
+	if (num & 1)
+	{
+		__m128 a = _mm_loadu_ps(reinterpret_cast<const float*>(v));
+		if constexpr (transformed)
+		{
+			a = SSE_ApplyTransform(xform, a);
+		}
+
+		minA = _mm_min_ps(minA, a);
+		maxA = _mm_max_ps(maxA, a);
+	}
+
+	*outMin = _mm_min_ps(minA, minB);
+	*outMax = _mm_max_ps(maxA, maxB);
+}
+
+template<bool transformed>
+void ReduceBounds(const float4* positions, uint64_t numVerts, uint64_t strideBytes, const SSE_Transform& xform, float4* outMin, float4* outMax)
+{
+	const uint8_t* base = reinterpret_cast<const uint8_t*>(positions);
+
+	__m128 mn, mx;
+	const uint64_t numThreads = std::min<uint64_t>(std::min(64u, std::max(std::thread::hardware_concurrency(), 1u)), numVerts / minVertsPerThread);
+	if (numThreads <= 1)
+	{
+		ReduceRange<transformed>(base, 0, numVerts, strideBytes, xform, &mn, &mx);
+	}
+	else
+	{
+		std::thread threads[64] = {};
+		__m128 threadMin[64], threadMax[64];
+
+		const uint64_t vertsPerThread = numVerts / numThreads;
+		for (uint64_t t = 0; t < numThreads; t++)
+		{
+			const uint64_t first = t * vertsPerThread;
+			const uint64_t num = (t == numThreads - 1) ? (numVerts - first) : vertsPerThread;
+			threads[t] = std::thread(ReduceRange<transformed>, base, first, num, strideBytes, std::cref(xform), threadMin + t, threadMax + t);
+		}
+
+		mn = _mm_set1_ps(std::numeric_limits<float>::infinity());
+		mx = _mm_set1_ps(-std::numeric_limits<float>::infinity());
+		for (uint64_t t = 0; t < numThreads; t++)
+		{
+			threads[t].join();
+			mn = _mm_min_ps(mn, threadMin[t]);
+			mx = _mm_max_ps(mx, threadMax[t]);
+		}
+	}
+
+	// Vertex w is documented as unused, so don't trust it
+	const __m128 xyzMask = _mm_castsi128_ps(_mm_setr_epi32(-1, -1, -1, 0));
+	_mm_storeu_ps(&outMin->x, _mm_and_ps(mn, xyzMask));
+	_mm_storeu_ps(&outMax->x, _mm_and_ps(mx, xyzMask));
+}
+
+void VertexBounds(const float4* positions, uint64_t numVerts, uint64_t strideBytes, float4* outMin, float4* outMax)
+{
+	const SSE_Transform identity = {};
+	ReduceBounds<false>(positions, numVerts, strideBytes, identity, outMin, outMax);
+}
+
+void TransformedVertexBounds(const float4* positions, uint64_t numVerts, uint64_t strideBytes, transform xform, float4* outMin, float4* outMax)
+{
+	ReduceBounds<true>(positions, numVerts, strideBytes, SSE_TransformFromSQT(xform), outMin, outMax);
+}
+
+void TransformVertices(float4* positions, uint64_t numVerts, uint64_t strideBytes, transform xform)
+{
+	const SSE_Transform sse = SSE_TransformFromSQT(xform);
+	uint8_t* v = reinterpret_cast<uint8_t*>(positions);
+	for (uint64_t i = 0; i < numVerts; i++)
+	{
+		float* pos = reinterpret_cast<float*>(v);
+		const float w = pos[3];
+		_mm_storeu_ps(pos, SSE_ApplyTransform(sse, _mm_loadu_ps(pos)));
+		pos[3] = w;
+		v += strideBytes;
+	}
+}
+
+void BoundsUnion(float4* aMin, float4* aMax, float4 bMin, float4 bMax)
+{
+	aMin->x = std::min(aMin->x, bMin.x);
+	aMin->y = std::min(aMin->y, bMin.y);
+	aMin->z = std::min(aMin->z, bMin.z);
+
+	aMax->x = std::max(aMax->x, bMax.x);
+	aMax->y = std::max(aMax->y, bMax.y);
+	aMax->z = std::max(aMax->z, bMax.z);
+}
@@ -0,0 +1,25 @@
+#pragma once
+
+#include <stdint.h>
+#include "../Math.h"
+
+// AABB reductions over vertex positions
+// - Positions are read in place from vertex structs [strideBytes] apart (position first, xyz + unused w)
+// - Each thread reduces its own range with SSE min/max (four lanes per vertex, two accumulators for ILP); large inputs are split across
+//   hardware threads, small ones (most meshes) stay on the calling thread
+// - Results are exact (min/max are order-independent, so thread count never changes the answer); w is always zero
+// - Empty inputs produce inverted bounds (+inf min, -inf max), which are the identity for unions
+
+// Object-space bounds
+void VertexBounds(const float4* positions, uint64_t numVerts, uint64_t strideBytes, float4* outMin, float4* outMax);
+
+// World-space bounds after SQT [xform]
+// These come from transformed vertices, not a transformed box, so they stay tight under rotation
+void TransformedVertexBounds(const float4* positions, uint64_t numVerts, uint64_t strideBytes, transform xform, float4* outMin, float4* outMax);
+
+// Applies SQT [xform] to positions in place (e.g. baking a model's placement into its vertices), with the same arithmetic as
+// [TransformedVertexBounds]; w is left as it was
+void TransformVertices(float4* positions, uint64_t numVerts, uint64_t strideBytes, transform xform);
+
+// [a] U [b], written back into [a]
+void BoundsUnion(float4* aMin, float4* aMax, float4 bMin, float4 bMax);
@@ -1,101 +1,63 @@
 #include "Geo.h"
-#include "GeoLoader.h"
+#include "SceneLoader.h"
 #include "..\CPUMemory.h"
 
 XPlatUtils::BakedGeoBuffers viewGeo = {};
 CPUMemory::ArrayAllocHandle<XPlatUtils::BakedGeoBuffers> sceneBuffers = {};
 
-CPUMemory::ArrayAllocHandle<CPUMemory::ArrayAllocHandle<Material>> sceneMaterials = {};
-CPUMemory::ArrayAllocHandle<uint32_t> materialsPerScene = {};
+// CPU-side copies of each scene's compute buffers (see SceneBuffers.h), and the scenes they describe (so edits can reach both)
+CPUMemory::ArrayAllocHandle<SceneBuffers> sceneMirrors = {};
+Scene* loadedScenes = nullptr;
 
-constexpr uint32_t maxVerts = 1024 * 1024; // About a million verts - most of our scenes should be much smaller
-CPUMemory::ArrayAllocHandle<Geo::Vertex3D> models = {};
-CPUMemory::ArrayAllocHandle<uint64_t> ndces = {};
+constexpr uint32_t maxVerts = 1024 * 1024; // About a million verts per scene - most of our scenes should be much smaller
+constexpr uint32_t maxTris = maxVerts; // Closed meshes have about twice as many triangles as vertices, so this is roughly half as generous
+CPUMemory::ArrayAllocHandle<uint64_t> ndces = {}; // Loader scratch; triangles are stored in each scene's mirror once models are added
 
 CPUMemory::ArrayAllocHandle<Geo::Vertex2D> viewVts;
 CPUMemory::ArrayAllocHandle<uint16_t> viewNdces;
 
+// Point the scene's vbuffer description at its mirror
+void ResolveSceneGeo(uint32_t sceneNdx)
+{
+    SceneBuffers& mirror = sceneMirrors[sceneNdx];
+
+    // Resolve scene geo label
+    const uint8_t labelSize = sizeof("sceneGeo") + 4; // Probably need less than four decimal characters to capture scene count ^_^'
+    wchar_t label[labelSize] = {};
+    wsprintf(label, L"sceneGeo_%i", sceneNdx);
+
+    // VBuffer setup
+    StandardResrcFmts fmts[3] = { StandardResrcFmts::FP32_4, StandardResrcFmts::FP32_4, StandardResrcFmts::FP32_4 }; // Considering whether to compress these - *probably* sticking with FP32_4
+    VertexEltSemantics semantics[3] = { VertexEltSemantics::POSITION, VertexEltSemantics::TEXCOORD, VertexEltSemantics::NORMAL };
+    sceneBuffers[sceneNdx].vbufferDesc.init<Geo::Vertex3D>(fmts, semantics, mirror.BufferContents(SceneBuffers::VBUFFER), static_cast<uint32_t>(mirror.NumVerts()), label);
+
+    // Triangles live in the mirror's tribuffer (IndexedTriangle, see SharedStructs.h); nothing rasterizes scene geometry yet, so there's
+    // no scene ibuffer to describe
+}
+
 void Geo::Init(uint32_t numScenes, Scene* scenes)
 {
+    loadedScenes = scenes;
+
     // Allocate scene memory
     sceneBuffers = CPUMemory::AllocateArray<XPlatUtils::BakedGeoBuffers>(numScenes);
-
-    // Allocate material pointer + count memory
-    sceneMaterials = CPUMemory::AllocateArray<CPUMemory::ArrayAllocHandle<Material>>(numScenes);
-    materialsPerScene = CPUMemory::AllocateArray<uint32_t>(numScenes);
-
-    // Load scenes by loading each model individually & compacting as we go
-    models = CPUMemory::AllocateArray<Vertex3D>(maxVerts);
+    sceneMirrors = CPUMemory::AllocateArray<SceneBuffers>(numScenes);
     ndces = CPUMemory::AllocateArray<uint64_t>(maxVerts);
 
-    uint64_t vtsWriteOffset = 0;
-    uint64_t ndcesWriteOffset = 0;
+    // Load scenes by loading each model individually & compacting as we go
     for (uint32_t i = 0; i < numScenes; i++)
     {
-        sceneMaterials[i] = CPUMemory::AllocateArray<Material>(scenes[i].numModels);
-
-        uint64_t numSceneVts = 0;
-        uint64_t numSceneNdces = 0;
+        sceneMirrors[i].Init(maxVerts, maxTris, MAX_SUPPORTED_OBJ_TRANSFORMS);
         for (uint32_t j = 0; j < scenes[i].numModels; j++)
         {
-            uint64_t numModelVts = 0;
-            uint64_t numModelNdces = 0;
-
-            MeshLoadParams params = {};
-            params.outVerts = models + vtsWriteOffset;
-            params.outNumVts = &numModelVts;
-            params.outNdces = &ndces[0] + ndcesWriteOffset;
-            params.outNumNdces = &numModelNdces;
-            params.inNdxOffset = numModelNdces;
-
-            params.outSpectralTexAddr = &sceneMaterials[i][j].spectralData;
-            params.outSpectralTexFootprint = &sceneMaterials[i][j].spectralDataSize;
-            params.outSpectralTexWidth = &sceneMaterials[i][j].spectralTexX;
-            params.outSpectralTexHeight = &sceneMaterials[i][j].spectralTexY;
-
-            params.outRoughnessTexAddr = &sceneMaterials[i][j].roughnessData;
-            params.outRoughnessFootprint = &sceneMaterials[i][j].roughnessDataSize;
-            params.outRoughnessTexWidth = &sceneMaterials[i][j].roughnessTexX;
-            params.outRoughnessTexHeight = &sceneMaterials[i][j].roughnessTexY;
-            params.inMaterialID = j;
-
-            Scene::Model& m = scenes[i].models[j];
-            if (m.fmt == OBJ)
-            {
-                GeoLoader::LoadObj(m.path, params);
-            }
-            else if (m.fmt == DXRS)
-            {
-                GeoLoader::LoadDXRS(m.path, params);
-            }
-
-            numSceneVts += numModelVts;
-            numSceneNdces += numModelNdces;
+            LoadSceneModel(sceneMirrors[i], scenes[i].models[j], &ndces[0]);
         }
 
-        materialsPerScene[i] = scenes[i].numModels; // True for now, possibly not forever (but also we have no way to support multi-material models)
-
-        // Resolve scene geo label
-        const uint8_t labelSize = sizeof("sceneGeo") + 4; // Probably need less than four decimal characters to capture scene count ^_^'
-        wchar_t label[labelSize] = {};
-        wsprintf(label, L"sceneGeo_%i", i);
+        // Everything's about to be uploaded in full, so there's nothing to patch yet
+        sceneMirrors[i].ClearPatches();
 
-        // VBuffer setup
-        StandardResrcFmts fmts[3] = { StandardResrcFmts::FP32_4, StandardResrcFmts::FP32_4, StandardResrcFmts::FP32_4 }; // Considering whether to compress these - *probably* sticking with FP32_4
-        VertexEltSemantics semantics[3] = { VertexEltSemantics::POSITION, VertexEltSemantics::TEXCOORD, VertexEltSemantics::NORMAL };
-        sceneBuffers[i].vbufferDesc.init<Vertex3D>(fmts, semantics, (models + vtsWriteOffset).GetBytesHandle(), static_cast<uint32_t>(numSceneVts), label);
-
-        // IBuffer setup
-        sceneBuffers[i].ibufferDesc.fmt = StandardIBufferFmts::U32;
-        sceneBuffers[i].ibufferDesc.stride = sizeof(uint32_t);
-        sceneBuffers[i].ibufferDesc.dimensions[0] = static_cast<uint32_t>(numSceneNdces);
-
-        ndces.arrayLen = sceneBuffers[i].ibufferDesc.dimensions[0]; // Appropriately scale declared index data length (length held by the memory manager is still size * maxVerts)
-        sceneBuffers[i].ibufferDesc.srcData = (ndces + ndcesWriteOffset).GetBytesHandle();
-
-        // Walk through CPU-side model/index buffers
-        vtsWriteOffset += numSceneVts;
-        ndcesWriteOffset += numSceneNdces;
+        FitSceneBounds(scenes[i], sceneMirrors[i]);
+        ResolveSceneGeo(i);
     }
 
     // See: https://learn.microsoft.com/en-us/windows/win32/direct3d9/viewports-and-clipping
@@ -161,6 +123,48 @@ XPlatUtils::BakedGeoBuffers& Geo::SceneGeo(uint32_t sceneNdx)
 
 void Geo::SceneMaterialList(CPUMemory::ArrayAllocHandle<Material>& outMaterials, uint32_t* outNumMaterials, uint32_t sceneNdx)
 {
-    outMaterials = sceneMaterials[sceneNdx];
-    *outNumMaterials = materialsPerScene[sceneNdx];
+    outMaterials = sceneMirrors[sceneNdx].Materials();
+    *outNumMaterials = sceneMirrors[sceneNdx].NumModels();
+}
+
+SceneBuffers& Geo::SceneMirror(uint32_t sceneNdx)
+{
+    return sceneMirrors[sceneNdx];
+}
+
+uint32_t Geo::AddModel(uint32_t sceneNdx, Scene::Model model)
+{
+    LoadSceneModel(sceneMirrors[sceneNdx], model, &ndces[0]);
+
+    const uint32_t modelNdx = loadedScenes[sceneNdx].AddModel(model);
+    assert(modelNdx + 1 == sceneMirrors[sceneNdx].NumModels());
+
+    FitSceneBounds(loadedScenes[sceneNdx], sceneMirrors[sceneNdx]);
+    ResolveSceneGeo(sceneNdx);
+    return modelNdx;
+}
+
+void Geo::RemoveModel(uint32_t sceneNdx, uint32_t modelNdx)
+{
+    const Material removedMaterial = sceneMirrors[sceneNdx].ModelMaterial(modelNdx);
+    sceneMirrors[sceneNdx].RemoveModel(modelNdx);
+    FreeMaterialTextures(removedMaterial);
+
+    loadedScenes[sceneNdx].RemoveModel(modelNdx);
+    FitSceneBounds(loadedScenes[sceneNdx], sceneMirrors[sceneNdx]);
+    ResolveSceneGeo(sceneNdx);
+}
+
+void Geo::MoveModel(uint32_t sceneNdx, uint32_t modelNdx, transform modelTransform)
+{
+    // Vertices stay in object space, so moves only change transforms + bounds (nothing to patch)
+    loadedScenes[sceneNdx].MoveModel(modelNdx, modelTransform);
+    FitSceneBounds(loadedScenes[sceneNdx], sceneMirrors[sceneNdx]);
+}
+
+void Geo::ReplaceMaterial(uint32_t sceneNdx, uint32_t modelNdx, const Material& material)
+{
+    const Material replacedMaterial = sceneMirrors[sceneNdx].ModelMaterial(modelNdx);
+    sceneMirrors[sceneNdx].ReplaceMaterial(modelNdx, material);
+    FreeMaterialTextures(replacedMaterial);
 }
@@ -4,16 +4,26 @@
 #include "..\GPUResource.h"
 #include "Scene.h"
 #include "Materials.h"
+#include "GeoTypes.h"
+#include "SceneBuffers.h"
 
-class Geo
+class Geo : public GeoTypes
 {
 public:
-#include "..\Shaders\SharedGeoStructs.h" // Icky namespacing hack
-
 	static void Init(uint32_t numScenes, Scene* scenes);
 	
 	static XPlatUtils::BakedGeoBuffers& ViewGeo();
 	static XPlatUtils::BakedGeoBuffers& SceneGeo(uint32_t sceneNdx);
 	static void SceneMaterialList(CPUMemory::ArrayAllocHandle<Material>& outMaterials, uint32_t* outNumMaterials, uint32_t sceneNdx);
+
+	// CPU copies of the scene's compute buffers; edits below record what they touch there, as patches for the GPU copies
+	static SceneBuffers& SceneMirror(uint32_t sceneNdx);
+
+	// Scene editing (geometry, materials, and the scene passed to [Init] are all kept in sync)
+	// Materials passed to [ReplaceMaterial] (and their textures) are owned by Geo afterwards
+	static uint32_t AddModel(uint32_t sceneNdx, Scene::Model model);
+	static void RemoveModel(uint32_t sceneNdx, uint32_t modelNdx);
+	static void MoveModel(uint32_t sceneNdx, uint32_t modelNdx, transform modelTransform);
+	static void ReplaceMaterial(uint32_t sceneNdx, uint32_t modelNdx, const Material& material);
 };
 
@@ -1,9 +1,21 @@
 #include "GeoLoader.h"
-#include "..\CPUMemory.h"
+#include "../CPUMemory.h"
 #include "Materials.h"
 
 #include <fstream>
 #include <filesystem>
+#include <cstring>
+#include <stdio.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+// Headless builds (e.g. HeadlessTracer on Linux) have no debugger output, so loader messages go to stderr
+static void OutputDebugStringA(const char* str)
+{
+	fputs(str, stderr);
+}
+#endif
 
 constexpr uint64_t maxNumVts = 0;
 constexpr uint64_t maxNumNdces = 0;
@@ -24,8 +36,8 @@ struct DXRS_Header
 
 struct DXRS_Vertex3D
 {
-	DirectX::XMFLOAT3 xyz;
-	DirectX::XMFLOAT3 n;
+	float3 xyz;
+	float3 n;
 	float u, v;
 };
 
@@ -141,14 +153,14 @@ void GeoLoader::LoadObj(const char* path, MeshLoadParams params)
 		}
 		else if (line[0] == 'l')
 		{
-			sprintf_s(err, "DXRSandbox does not support OBJ files with polyline attributes; failed to load OBJ\n");
+			snprintf(err, sizeof(err), "DXRSandbox does not support OBJ files with polyline attributes; failed to load OBJ\n");
 			OutputDebugStringA(err);
 			loadFailed = true;
 			break;
 		}
 		else if (memcmp(line, "cstype", 7) == 0)
 		{
-			sprintf_s(err, "DXRSandbox does not support OBJ files with curved geometry; failed to load OBJ\n");
+			snprintf(err, sizeof(err), "DXRSandbox does not support OBJ files with curved geometry; failed to load OBJ\n");
 			OutputDebugStringA(err);
 			loadFailed = true;
 			break;
@@ -245,14 +257,14 @@ void GeoLoader::LoadObj(const char* path, MeshLoadParams params)
 
 			if (attribStride == &facesStride && *attribStride > 4)
 			{
-				sprintf_s(err, "DXRSandbox does not support OBJ files with more than 4 edges/face (quads are triangulated); failed to load OBJ\n");
+				snprintf(err, sizeof(err), "DXRSandbox does not support OBJ files with more than 4 edges/face (quads are triangulated); failed to load OBJ\n");
 				OutputDebugStringA(err);
 
 				loadFailed = true;
 			}
 			else if (attribStride == &facesStride && *attribStride != lastAttribStride && lastAttribStride != 0)
 			{
-				sprintf_s(err, "DXRSandbox does not support OBJ files with varying edges/face; failed to load OBJ\n");
+				snprintf(err, sizeof(err), "DXRSandbox does not support OBJ files with varying edges/face; failed to load OBJ\n");
 				OutputDebugStringA(err);
 
 				loadFailed = true;
@@ -299,7 +311,7 @@ void GeoLoader::LoadObj(const char* path, MeshLoadParams params)
 			params.outVerts[i / vertStride].pos = float4(verts[i], verts[i + 1], verts[i + 2], 0.0f);
 
 #ifdef _DEBUG
-			sprintf_s(verticesPrintable, "file source vertex %u = (%.f, %.f, %.f)\n", i / vertStride, verts[i], verts[i + 1], verts[i + 2]);
+			snprintf(verticesPrintable, sizeof(verticesPrintable), "file source vertex %u = (%.f, %.f, %.f)\n", i / vertStride, verts[i], verts[i + 1], verts[i + 2]);
 			OutputDebugStringA(verticesPrintable);
 #endif
 
@@ -325,11 +337,11 @@ void GeoLoader::LoadObj(const char* path, MeshLoadParams params)
 		{
 			if (facesStride == 4)
 			{
-				sprintf_s(indicesPrintable, "source geometry indices (%u-%u) = (%zu, %zu, %zu, %zu)\n", i, i + 4, params.outNdces[i], params.outNdces[i + 1], params.outNdces[i + 2], params.outNdces[i + 3]);
+				snprintf(indicesPrintable, sizeof(indicesPrintable), "source geometry indices (%u-%u) = (%zu, %zu, %zu, %zu)\n", i, i + 4, params.outNdces[i], params.outNdces[i + 1], params.outNdces[i + 2], params.outNdces[i + 3]);
 			}
 			else
 			{
-				sprintf_s(indicesPrintable, "source geometry indices (%u-%u) = (%zu, %zu, %zu)\n", i, i + 3, params.outNdces[i], params.outNdces[i + 1], params.outNdces[i + 2]);
+				snprintf(indicesPrintable, sizeof(indicesPrintable), "source geometry indices (%u-%u) = (%zu, %zu, %zu)\n", i, i + 3, params.outNdces[i], params.outNdces[i + 1], params.outNdces[i + 2]);
 			}
 
 			OutputDebugStringA(indicesPrintable);
@@ -404,13 +416,13 @@ void GeoLoader::LoadObj(const char* path, MeshLoadParams params)
 #ifdef _DEBUG
 			for (uint32_t i = 0; i < triNdcesFront; i += 3)
 			{
-				sprintf_s(indicesPrintable, "triangulated geometry indices (%u-%u) = (%zu, %zu, %zu)\n", i, i + 3, params.outNdces[i], params.outNdces[i + 1], params.outNdces[i + 2]);
+				snprintf(indicesPrintable, sizeof(indicesPrintable), "triangulated geometry indices (%u-%u) = (%zu, %zu, %zu)\n", i, i + 3, params.outNdces[i], params.outNdces[i + 1], params.outNdces[i + 2]);
 				OutputDebugStringA(indicesPrintable);
 			}
 
 			for (uint32_t i = 0; i < uvTriNdcesFront; i += 3)
 			{
-				sprintf_s(indicesPrintable, "triangulated uv indices (%u-%u) = (%zu, %zu, %zu)\n", i, i + 3, uvNdces[i].attrib, uvNdces[i + 1].attrib, uvNdces[i + 2].attrib);
+				snprintf(indicesPrintable, sizeof(indicesPrintable), "triangulated uv indices (%u-%u) = (%zu, %zu, %zu)\n", i, i + 3, uvNdces[i].attrib, uvNdces[i + 1].attrib, uvNdces[i + 2].attrib);
 				OutputDebugStringA(indicesPrintable);
 			}
 #endif
@@ -489,7 +501,7 @@ void GeoLoader::LoadObj(const char* path, MeshLoadParams params)
 		for (uint32_t i = 0; i < *params.outNumVts; i++)
 		{
 			VertMeta& metaVert = vertMetaBuff[i];
-			Geo::Vertex3D& vert = params.outVerts[i];
+			GeoTypes::Vertex3D& vert = params.outVerts[i];
 
 			vec4 nAvg = vec4({ 0.0f, 0.0f, 0.0f, 0.0f });
 			for (uint32_t j = 0; j < metaVert.numConnectedTris; j++)
@@ -520,6 +532,12 @@ void GeoLoader::LoadObj(const char* path, MeshLoadParams params)
 		CPUMemory::Free(uvNdces);
 	}
 
+	// Rebase indices onto the scene's vertex buffer (vertex lookups above are model-local, so this happens last)
+	for (uint64_t i = 0; i < *params.outNumNdces; i++)
+	{
+		params.outNdces[i] += params.inNdxOffset;
+	}
+
 	// Free unneeded geometry allocations
 	CPUMemory::Free(modelData);
 	CPUMemory::Free(verts);
@@ -527,21 +545,22 @@ void GeoLoader::LoadObj(const char* path, MeshLoadParams params)
 	CPUMemory::Free(normals);
 	CPUMemory::Free(faces);
 
-	// Generate placeholder spectral texture (assumed white)
-	*params.outSpectralTexWidth = 1024;
-	*params.outSpectralTexHeight = 1024;
-	*params.outSpectralTexFootprint = sizeof(MaterialSPD_Piecewise) * *params.outSpectralTexWidth * *params.outSpectralTexHeight;
-
-	*params.outSpectralTexAddr = CPUMemory::AllocateArray<MaterialSPD_Piecewise>(*params.outSpectralTexWidth * *params.outSpectralTexHeight);
-	CPUMemory::FlushData(*params.outSpectralTexAddr); // BLINDING, Spectralon white, yay
+	// OBJ imports are white + smooth everywhere, so there's nothing worth putting in a texture; describe them with a constant material
+	// instead (a 1024x1024 placeholder costs ~20MiB per model, which adds up fast in larger scenes)
+	*params.outUniformMaterial = true;
+	memset(params.outUniformSPD->points, 0xff, sizeof(MaterialSPD_Piecewise)); // BLINDING, Spectralon white, yay
+	*params.outUniformRoughness = 0.0f;
 
-	// Generate placeholder roughness texture (assumed smooth)
-	*params.outRoughnessTexWidth = 1024;
-	*params.outRoughnessTexHeight = 1024;
-	*params.outRoughnessFootprint = sizeof(float) * *params.outRoughnessTexWidth * *params.outRoughnessTexHeight;
+	// No texture data for uniform materials
+	*params.outSpectralTexWidth = 0;
+	*params.outSpectralTexHeight = 0;
+	*params.outSpectralTexFootprint = 0;
+	*params.outSpectralTexAddr = {};
 
-	*params.outRoughnessTexAddr = CPUMemory::AllocateArray<float>(*params.outRoughnessTexWidth * *params.outRoughnessTexHeight);
-	CPUMemory::ZeroData(*params.outRoughnessTexAddr);
+	*params.outRoughnessTexWidth = 0;
+	*params.outRoughnessTexHeight = 0;
+	*params.outRoughnessFootprint = 0;
+	*params.outRoughnessTexAddr = {};
 
 	// Return/end function - all data loaded/generated
 	//////////////////////////////////////////////////
@@ -571,6 +590,11 @@ void GeoLoader::LoadDXRS(const char* path, MeshLoadParams params)
 	*(params.outRoughnessTexWidth) = header.roughnessTexWidth;
 	*(params.outRoughnessTexHeight) = header.roughnessTexHeight;
 
+	// DXRS models are expected to carry painted (textured) materials
+	*(params.outUniformMaterial) = false;
+	*(params.outUniformRoughness) = 0.0f;
+	memset(params.outUniformSPD->points, 0, sizeof(MaterialSPD_Piecewise));
+
 	// Allocate memory for spectral/roughness textures
 	*params.outSpectralTexAddr = CPUMemory::AllocateArray<MaterialSPD_Piecewise>(header.spectralTexWidth * header.spectralTexHeight);
 	*params.outRoughnessTexAddr = CPUMemory::AllocateArray<float>(header.roughnessTexWidth * header.roughnessTexHeight);
@@ -605,10 +629,13 @@ void GeoLoader::LoadDXRS(const char* path, MeshLoadParams params)
 	}
 
 	// Copy-out ndces
-	char* ndces = &(fileLocal + fOffset)[0];
-	uint64_t ndxFootprint = sizeof(uint32_t) * header.numNdces;
-	memcpy(params.outNdces, ndces, ndxFootprint);
-	fOffset += ndxFootprint;
+	// DXRS stores 32-bit indices; widen them into our 64-bit index stream, rebasing onto the scene's vertex buffer as we go
+	const uint32_t* ndces = reinterpret_cast<const uint32_t*>(&(fileLocal + fOffset)[0]);
+	for (uint64_t i = 0; i < header.numNdces; i++)
+	{
+		params.outNdces[i] = ndces[i] + params.inNdxOffset;
+	}
+	fOffset += sizeof(uint32_t) * header.numNdces;
 
 	// Copy-out spectral data
 	char* spectra = &(fileLocal + fOffset)[0];
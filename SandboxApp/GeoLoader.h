@@ -1,11 +1,12 @@
 #pragma once
 
-#include "Geo.h"
+#include "../CPUMemory.h"
+#include "GeoTypes.h"
 #include "Materials.h"
 
 struct MeshLoadParams
 {
-	CPUMemory::ArrayAllocHandle<Geo::Vertex3D> outVerts;
+	CPUMemory::ArrayAllocHandle<GeoTypes::Vertex3D> outVerts;
 	uint64_t* outNumVts;
 	uint64_t* outNdces;
 	uint64_t* outNumNdces;
@@ -21,6 +22,12 @@ struct MeshLoadParams
 
 	uint16_t* outRoughnessTexWidth;
 	uint16_t* outRoughnessTexHeight;
+
+	// Constant material properties, used instead of the textures above when [outUniformMaterial] is set
+	bool* outUniformMaterial;
+	MaterialSPD_Piecewise* outUniformSPD;
+	float* outUniformRoughness;
+
 	uint16_t inMaterialID;
 };
 
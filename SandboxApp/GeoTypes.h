@@ -0,0 +1,9 @@
+#pragma once
+
+#include "../Math.h"
+
+// Shared vertex layouts, without Geo's GPU-resource dependencies (so CPU-only code and tests can work with scene geometry directly)
+struct GeoTypes
+{
+#include "../Shaders/SharedGeoStructs.h" // Icky namespacing hack
+};
@@ -0,0 +1,240 @@
+#pragma once
+
+#include <stdint.h>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include "../Math.h"
+
+// Scalar intersection/distance kernels for CPU-side queries (see SceneQuery)
+// Kept header-only + inline so traversal loops can inline them, and so tests can check acceleration structures against brute-force
+// loops over exactly the same arithmetic
+
+// Slab-test far distances are scaled up by 1 + 2 * gamma(3) (PBR 3rd ed., 3.9.2), so rounding can't reject boxes that rays graze
+constexpr float robustFarScale = 1.0f + 2.0f * (3.0f * std::numeric_limits<float>::epsilon() * 0.5f) / (1.0f - 3.0f * std::numeric_limits<float>::epsilon() * 0.5f);
+
+struct Vec3
+{
+	float x, y, z;
+};
+
+inline Vec3 ToVec3(const float4& v) { return { v.x, v.y, v.z }; }
+inline Vec3 Sub3(Vec3 a, Vec3 b) { return { a.x - b.x, a.y - b.y, a.z - b.z }; }
+inline Vec3 Add3(Vec3 a, Vec3 b) { return { a.x + b.x, a.y + b.y, a.z + b.z }; }
+inline Vec3 Scale3(Vec3 a, float s) { return { a.x * s, a.y * s, a.z * s }; }
+inline float Dot3(Vec3 a, Vec3 b) { return a.x * b.x + a.y * b.y + a.z * b.z; }
+inline Vec3 Cross3(Vec3 a, Vec3 b) { return { a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x }; }
+
+// Returns [x] unchanged, but as a separately rounded value: g++ fuses multiplies into later adds/subtracts by default
+// (-ffp-contract=fast), and whether it does depends on the surrounding code, so products that must round the same way in the scalar
+// and SIMD triangle tests (see IntersectionSIMD.h) pass through here first; MSVC only contracts under /fp:contract or /fp:fast
+template<typename T>
+inline T SeparatelyRounded(T x)
+{
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+	__asm__("" : "+x"(x));
+#elif defined(__GNUC__) && defined(__aarch64__)
+	__asm__("" : "+w"(x));
+#endif
+	return x;
+}
+
+// Per-ray constants for slab tests + the watertight triangle test
+struct RayPrecomp
+{
+	float org[3];
+	float invDir[3];
+	uint32_t kx, ky, kz; // Shear axes; [kz] is the dominant direction axis
+	float Sx, Sy, Sz;
+};
+
+inline RayPrecomp PrecomputeRay(float4 origin, float4 direction)
+{
+	RayPrecomp rp;
+	const float dir[3] = { direction.x, direction.y, direction.z };
+	rp.org[0] = origin.x;
+	rp.org[1] = origin.y;
+	rp.org[2] = origin.z;
+	for (uint32_t a = 0; a < 3; a++)
+	{
+		rp.invDir[a] = 1.0f / dir[a];
+	}
+
+	// Shear/scale so the ray runs down +z from the origin (Woop, Benthin & Wald 2013)
+	rp.kz = (std::abs(dir[0]) > std::abs(dir[1])) ? ((std::abs(dir[0]) > std::abs(dir[2])) ? 0 : 2) : ((std::abs(dir[1]) > std::abs(dir[2])) ? 1 : 2);
+	rp.kx = (rp.kz + 1) % 3;
+	rp.ky = (rp.kx + 1) % 3;
+	if (dir[rp.kz] < 0.0f)
+	{
+		std::swap(rp.kx, rp.ky); // Preserve winding
+	}
+
+	rp.Sx = dir[rp.kx] / dir[rp.kz];
+	rp.Sy = dir[rp.ky] / dir[rp.kz];
+	rp.Sz = 1.0f / dir[rp.kz];
+	return rp;
+}
+
+inline bool RayBox(const float* bmin, const float* bmax, const RayPrecomp& rp, float tMin, float tMax, float* outEntry)
+{
+	for (uint32_t a = 0; a < 3; a++)
+	{
+		float t0 = (bmin[a] - rp.org[a]) * rp.invDir[a];
+		float t1 = (bmax[a] - rp.org[a]) * rp.invDir[a];
+		if (t0 > t1)
+		{
+			std::swap(t0, t1);
+		}
+		t1 *= robustFarScale;
+
+		// Written so NaNs (zero direction components on a slab boundary) leave the interval alone
+		tMin = (t0 > tMin) ? t0 : tMin;
+		tMax = (t1 < tMax) ? t1 : tMax;
+	}
+
+	*outEntry = tMin;
+	return tMin <= tMax;
+}
+
+// Watertight ray/triangle intersection (Woop, Benthin & Wald 2013); edges shared between triangles are never missed by both
+inline bool RayTriangle(const RayPrecomp& rp, const float4& v0, const float4& v1, const float4& v2, float tMin, float tMax, float* outT, float* outU, float* outV)
+{
+	const float A[3] = { v0.x - rp.org[0], v0.y - rp.org[1], v0.z - rp.org[2] };
+	const float B[3] = { v1.x - rp.org[0], v1.y - rp.org[1], v1.z - rp.org[2] };
+	const float C[3] = { v2.x - rp.org[0], v2.y - rp.org[1], v2.z - rp.org[2] };
+
+	const float Ax = A[rp.kx] - SeparatelyRounded(rp.Sx * A[rp.kz]);
+	const float Ay = A[rp.ky] - SeparatelyRounded(rp.Sy * A[rp.kz]);
+	const float Bx = B[rp.kx] - SeparatelyRounded(rp.Sx * B[rp.kz]);
+	const float By = B[rp.ky] - SeparatelyRounded(rp.Sy * B[rp.kz]);
+	const float Cx = C[rp.kx] - SeparatelyRounded(rp.Sx * C[rp.kz]);
+	const float Cy = C[rp.ky] - SeparatelyRounded(rp.Sy * C[rp.kz]);
+
+	// Edge functions in double: float products are exact there, so the result can't depend on whether the compiler fuses the
+	// multiply-subtract (fused + unfused float versions round differently, which breaks the exact negation between neighbouring
+	// triangles that watertightness relies on)
+	const double U = static_cast<double>(Cx) * By - static_cast<double>(Cy) * Bx;
+	const double V = static_cast<double>(Ax) * Cy - static_cast<double>(Ay) * Cx;
+	const double W = static_cast<double>(Bx) * Ay - static_cast<double>(By) * Ax;
+	if ((U < 0.0 || V < 0.0 || W < 0.0) && (U > 0.0 || V > 0.0 || W > 0.0))
+	{
+		return false;
+	}
+
+	const double det = U + V + W;
+	if (det == 0.0)
+	{
+		return false;
+	}
+
+	const double T = SeparatelyRounded(U * (rp.Sz * A[rp.kz])) + SeparatelyRounded(V * (rp.Sz * B[rp.kz])) + SeparatelyRounded(W * (rp.Sz * C[rp.kz]));
+	const double rcpDet = 1.0 / det;
+	const float t = static_cast<float>(T * rcpDet);
+	if (!(t >= tMin && t <= tMax))
+	{
+		return false;
+	}
+
+	*outT = t;
+	*outU = static_cast<float>(V * rcpDet);
+	*outV = static_cast<float>(W * rcpDet);
+	return true;
+}
+
+// Separating-axis triangle/box test (Akenine-Moller 2001); box given as center + half-extents
+inline bool TriangleBoxOverlap(Vec3 center, Vec3 halfExtents, const float4& tv0, const float4& tv1, const float4& tv2)
+{
+	const Vec3 v[3] = { Sub3(ToVec3(tv0), center), Sub3(ToVec3(tv1), center), Sub3(ToVec3(tv2), center) };
+	const Vec3 e[3] = { Sub3(v[1], v[0]), Sub3(v[2], v[1]), Sub3(v[0], v[2]) };
+	const float h[3] = { halfExtents.x, halfExtents.y, halfExtents.z };
+
+	// Box face normals (triangle AABB against the box)
+	for (uint32_t a = 0; a < 3; a++)
+	{
+		const float p0 = (&v[0].x)[a], p1 = (&v[1].x)[a], p2 = (&v[2].x)[a];
+		if (std::min({ p0, p1, p2 }) > h[a] || std::max({ p0, p1, p2 }) < -h[a])
+		{
+			return false;
+		}
+	}
+
+	// Edge x box-axis cross products
+	for (uint32_t i = 0; i < 3; i++)
+	{
+		for (uint32_t a = 0; a < 3; a++)
+		{
+			Vec3 boxAxis = { 0.0f, 0.0f, 0.0f };
+			(&boxAxis.x)[a] = 1.0f;
+			const Vec3 axis = Cross3(boxAxis, e[i]);
+
+			const float p0 = Dot3(v[0], axis), p1 = Dot3(v[1], axis), p2 = Dot3(v[2], axis);
+			const float r = h[0] * std::abs(axis.x) + h[1] * std::abs(axis.y) + h[2] * std::abs(axis.z);
+			if (std::min({ p0, p1, p2 }) > r || std::max({ p0, p1, p2 }) < -r)
+			{
+				return false;
+			}
+		}
+	}
+
+	// Triangle plane
+	const Vec3 n = Cross3(e[0], e[1]);
+	const float r = h[0] * std::abs(n.x) + h[1] * std::abs(n.y) + h[2] * std::abs(n.z);
+	return std::abs(Dot3(n, v[0])) <= r;
+}
+
+// Closest point on a triangle to [p] (Ericson, Real-Time Collision Detection 5.1.5), as squared distance
+inline float PointTriangleDistSq(Vec3 p, const float4& tv0, const float4& tv1, const float4& tv2)
+{
+	const Vec3 a = ToVec3(tv0), b = ToVec3(tv1), c = ToVec3(tv2);
+	const Vec3 ab = Sub3(b, a), ac = Sub3(c, a), ap = Sub3(p, a);
+
+	Vec3 closest;
+	const float d1 = Dot3(ab, ap), d2 = Dot3(ac, ap);
+	const Vec3 bp = Sub3(p, b);
+	const float d3 = Dot3(ab, bp), d4 = Dot3(ac, bp);
+	const Vec3 cp = Sub3(p, c);
+	const float d5 = Dot3(ab, cp), d6 = Dot3(ac, cp);
+	const float vc = d1 * d4 - d3 * d2;
+	const float vb = d5 * d2 - d1 * d6;
+	const float va = d3 * d6 - d5 * d4;
+	if (d1 <= 0.0f && d2 <= 0.0f)
+	{
+		closest = a;
+	}
+	else if (d3 >= 0.0f && d4 <= d3)
+	{
+		closest = b;
+	}
+	else if (vc <= 0.0f && d1 >= 0.0f && d3 <= 0.0f)
+	{
+		closest = Add3(a, Scale3(ab, d1 / (d1 - d3)));
+	}
+	else if (d6 >= 0.0f && d5 <= d6)
+	{
+		closest = c;
+	}
+	else if (vb <= 0.0f && d2 >= 0.0f && d6 <= 0.0f)
+	{
+		closest = Add3(a, Scale3(ac, d2 / (d2 - d6)));
+	}
+	else if (va <= 0.0f && (d4 - d3) >= 0.0f && (d5 - d6) >= 0.0f)
+	{
+		closest = Add3(b, Scale3(Sub3(c, b), (d4 - d3) / ((d4 - d3) + (d5 - d6))));
+	}
+	else
+	{
+		const float denom = 1.0f / (va + vb + vc);
+		closest = Add3(a, Add3(Scale3(ab, vb * denom), Scale3(ac, vc * denom)));
+	}
+
+	const Vec3 d = Sub3(p, closest);
+	return Dot3(d, d);
+}
+
+inline float PointBoxDistSq(Vec3 p, const float* bmin, const float* bmax)
+{
+	const float dx = std::max({ bmin[0] - p.x, 0.0f, p.x - bmax[0] });
+	const float dy = std::max({ bmin[1] - p.y, 0.0f, p.y - bmax[1] });
+	const float dz = std::max({ bmin[2] - p.z, 0.0f, p.z - bmax[2] });
+	return dx * dx + dy * dy + dz * dz;
+}
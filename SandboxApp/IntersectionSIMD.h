@@ -0,0 +1,319 @@
+#pragma once
+
+#include "Intersection.h"
+#include "../Shaders/SharedStructs.h"
+
+#include <cstring>
+
+// One ray against 4 or 8 triangles/boxes at once, from SoA-packed leaf data
+// - 4-lane kernels use SSE2, 8-lane kernels AVX2 (running as two 4-lane calls without it); builds with neither, or defining
+//   INTERSECTION_SIMD_SCALAR, loop over RayTriangle/RayBox instead
+// - Every lane gives exactly RayTriangle's/RayBox's result, hit/miss and distances/barycentrics alike: the kernels run the same IEEE
+//   operations in the same order (shear in float, edge functions onwards in double), and take min/max operands in the order that
+//   reproduces the scalar code's NaN handling; products that feed adds are kept from fusing on both sides (see SeparatelyRounded)
+// - Kernels return hit masks (bit [i] for lane [i]); outputs in missed lanes are left unspecified
+// - Header-only + inline, like Intersection.h, so traversal loops can inline them
+
+#if !defined(INTERSECTION_SIMD_SCALAR) && (defined(__SSE2__) || defined(_M_X64))
+#define INTERSECTION_SSE
+#endif
+
+#if !defined(INTERSECTION_SIMD_SCALAR) && defined(__AVX2__)
+#define INTERSECTION_AVX2
+#endif
+
+#ifdef INTERSECTION_SSE
+#include <immintrin.h>
+#endif
+
+// Vertex positions for up to [lanes] triangles, by axis; lanes past [count] are never reported as hits
+// Packets are read with unaligned loads, so they can live in CPUMemory allocations (which aren't aligned)
+template<uint32_t lanes>
+struct TrianglePacket
+{
+	float v0[3][lanes];
+	float v1[3][lanes];
+	float v2[3][lanes];
+	uint32_t count;
+};
+
+// As above, for boxes
+template<uint32_t lanes>
+struct BoxPacket
+{
+	float bmin[3][lanes];
+	float bmax[3][lanes];
+	uint32_t count;
+};
+
+// Packs [count] (up to [lanes]) triangles, listed by [triNdces]; unused lanes are zeroed
+template<uint32_t lanes>
+inline void PackTriangles(const float4* positions, uint64_t strideBytes, const IndexedTriangle* tris, const uint32_t* triNdces, uint32_t count,
+						  TrianglePacket<lanes>* outPacket)
+{
+	*outPacket = {};
+	outPacket->count = count;
+	const uint8_t* positionBytes = reinterpret_cast<const uint8_t*>(positions);
+	for (uint32_t i = 0; i < count; i++)
+	{
+		const uint4& ndx = tris[triNdces[i]].xyz;
+		const float4& p0 = *reinterpret_cast<const float4*>(positionBytes + ndx.x * strideBytes);
+		const float4& p1 = *reinterpret_cast<const float4*>(positionBytes + ndx.y * strideBytes);
+		const float4& p2 = *reinterpret_cast<const float4*>(positionBytes + ndx.z * strideBytes);
+		const float c0[3] = { p0.x, p0.y, p0.z }, c1[3] = { p1.x, p1.y, p1.z }, c2[3] = { p2.x, p2.y, p2.z };
+		for (uint32_t a = 0; a < 3; a++)
+		{
+			outPacket->v0[a][i] = c0[a];
+			outPacket->v1[a][i] = c1[a];
+			outPacket->v2[a][i] = c2[a];
+		}
+	}
+}
+
+// Packs [count] (up to [lanes]) boxes, given as min/max corner triplets; unused lanes are zeroed
+template<uint32_t lanes>
+inline void PackBoxes(const float* const* bmins, const float* const* bmaxs, uint32_t count, BoxPacket<lanes>* outPacket)
+{
+	*outPacket = {};
+	outPacket->count = count;
+	for (uint32_t i = 0; i < count; i++)
+	{
+		for (uint32_t a = 0; a < 3; a++)
+		{
+			outPacket->bmin[a][i] = bmins[i][a];
+			outPacket->bmax[a][i] = bmaxs[i][a];
+		}
+	}
+}
+
+// Scalar versions, lane by lane (the fallback, and the reference the SIMD kernels are tested against)
+template<uint32_t lanes>
+inline uint32_t RayTrianglesScalar(const RayPrecomp& rp, const TrianglePacket<lanes>& packet, float tMin, float tMax, float* outT, float* outU, float* outV)
+{
+	uint32_t hitMask = 0;
+	for (uint32_t i = 0; i < packet.count; i++)
+	{
+		const float4 v0 = float4(packet.v0[0][i], packet.v0[1][i], packet.v0[2][i], 0.0f);
+		const float4 v1 = float4(packet.v1[0][i], packet.v1[1][i], packet.v1[2][i], 0.0f);
+		const float4 v2 = float4(packet.v2[0][i], packet.v2[1][i], packet.v2[2][i], 0.0f);
+		hitMask |= RayTriangle(rp, v0, v1, v2, tMin, tMax, &outT[i], &outU[i], &outV[i]) ? (1u << i) : 0u;
+	}
+	return hitMask;
+}
+
+template<uint32_t lanes>
+inline uint32_t RayBoxesScalar(const RayPrecomp& rp, const BoxPacket<lanes>& packet, float tMin, float tMax, float* outEntries)
+{
+	uint32_t hitMask = 0;
+	for (uint32_t i = 0; i < packet.count; i++)
+	{
+		const float bmin[3] = { packet.bmin[0][i], packet.bmin[1][i], packet.bmin[2][i] };
+		const float bmax[3] = { packet.bmax[0][i], packet.bmax[1][i], packet.bmax[2][i] };
+		hitMask |= RayBox(bmin, bmax, rp, tMin, tMax, &outEntries[i]) ? (1u << i) : 0u;
+	}
+	return hitMask;
+}
+
+#ifdef INTERSECTION_SSE
+
+// RayTriangle from the edge functions on, over two lanes of sheared vertices (converted to double); [outT]/[outU]/[outV] get the
+// lanes' results in their low halves, and the return value the lanes that passed the edge + determinant tests
+inline uint32_t TriangleTailSSE(const __m128d& Ax, const __m128d& Ay, const __m128d& Bx, const __m128d& By, const __m128d& Cx, const __m128d& Cy,
+								const __m128d& Az, const __m128d& Bz, const __m128d& Cz, __m128* outT, __m128* outU, __m128* outV)
+{
+	const __m128d zero = _mm_setzero_pd();
+	const __m128d U = _mm_sub_pd(_mm_mul_pd(Cx, By), _mm_mul_pd(Cy, Bx));
+	const __m128d V = _mm_sub_pd(_mm_mul_pd(Ax, Cy), _mm_mul_pd(Ay, Cx));
+	const __m128d W = _mm_sub_pd(_mm_mul_pd(Bx, Ay), _mm_mul_pd(By, Ax));
+	const __m128d anyNegative = _mm_or_pd(_mm_or_pd(_mm_cmplt_pd(U, zero), _mm_cmplt_pd(V, zero)), _mm_cmplt_pd(W, zero));
+	const __m128d anyPositive = _mm_or_pd(_mm_or_pd(_mm_cmpgt_pd(U, zero), _mm_cmpgt_pd(V, zero)), _mm_cmpgt_pd(W, zero));
+
+	const __m128d det = _mm_add_pd(_mm_add_pd(U, V), W);
+	const __m128d T = _mm_add_pd(_mm_add_pd(SeparatelyRounded(_mm_mul_pd(U, Az)), SeparatelyRounded(_mm_mul_pd(V, Bz))), SeparatelyRounded(_mm_mul_pd(W, Cz)));
+	const __m128d rcpDet = _mm_div_pd(_mm_set1_pd(1.0), det);
+	*outT = _mm_cvtpd_ps(_mm_mul_pd(T, rcpDet));
+	*outU = _mm_cvtpd_ps(_mm_mul_pd(V, rcpDet));
+	*outV = _mm_cvtpd_ps(_mm_mul_pd(W, rcpDet));
+
+	const __m128d passed = _mm_andnot_pd(_mm_and_pd(anyNegative, anyPositive), _mm_cmpneq_pd(det, zero));
+	return static_cast<uint32_t>(_mm_movemask_pd(passed));
+}
+
+#endif
+
+inline uint32_t RayTriangles4(const RayPrecomp& rp, const TrianglePacket<4>& packet, float tMin, float tMax, float* outT, float* outU, float* outV)
+{
+#ifdef INTERSECTION_SSE
+	const __m128 ox = _mm_set1_ps(rp.org[rp.kx]), oy = _mm_set1_ps(rp.org[rp.ky]), oz = _mm_set1_ps(rp.org[rp.kz]);
+	const __m128 Sx = _mm_set1_ps(rp.Sx), Sy = _mm_set1_ps(rp.Sy), Sz = _mm_set1_ps(rp.Sz);
+
+	// Translate + shear each vertex, keeping the depth scale for [T] as RayTriangle does
+	__m128 x[3], y[3], z[3];
+	const float (*verts[3])[4] = { packet.v0, packet.v1, packet.v2 };
+	for (uint32_t k = 0; k < 3; k++)
+	{
+		const __m128 dz = _mm_sub_ps(_mm_loadu_ps(verts[k][rp.kz]), oz);
+		x[k] = _mm_sub_ps(_mm_sub_ps(_mm_loadu_ps(verts[k][rp.kx]), ox), SeparatelyRounded(_mm_mul_ps(Sx, dz)));
+		y[k] = _mm_sub_ps(_mm_sub_ps(_mm_loadu_ps(verts[k][rp.ky]), oy), SeparatelyRounded(_mm_mul_ps(Sy, dz)));
+		z[k] = _mm_mul_ps(Sz, dz);
+	}
+
+	__m128 t[2], u[2], v[2];
+	uint32_t passed = 0;
+	for (uint32_t half = 0; half < 2; half++)
+	{
+		auto toDouble = [half](__m128 f) { return _mm_cvtps_pd((half == 0) ? f : _mm_movehl_ps(f, f)); };
+		passed |= TriangleTailSSE(toDouble(x[0]), toDouble(y[0]), toDouble(x[1]), toDouble(y[1]), toDouble(x[2]), toDouble(y[2]), toDouble(z[0]),
+								  toDouble(z[1]), toDouble(z[2]), &t[half], &u[half], &v[half]) << (half * 2);
+	}
+
+	const __m128 tLanes = _mm_movelh_ps(t[0], t[1]);
+	const __m128 inRange = _mm_and_ps(_mm_cmpge_ps(tLanes, _mm_set1_ps(tMin)), _mm_cmple_ps(tLanes, _mm_set1_ps(tMax)));
+	_mm_storeu_ps(outT, tLanes);
+	_mm_storeu_ps(outU, _mm_movelh_ps(u[0], u[1]));
+	_mm_storeu_ps(outV, _mm_movelh_ps(v[0], v[1]));
+	return passed & static_cast<uint32_t>(_mm_movemask_ps(inRange)) & ((1u << packet.count) - 1);
+#else
+	return RayTrianglesScalar(rp, packet, tMin, tMax, outT, outU, outV);
+#endif
+}
+
+inline uint32_t RayBoxes4(const RayPrecomp& rp, const BoxPacket<4>& packet, float tMin, float tMax, float* outEntries)
+{
+#ifdef INTERSECTION_SSE
+	const __m128 farScale = _mm_set1_ps(robustFarScale);
+	__m128 entry = _mm_set1_ps(tMin), exit = _mm_set1_ps(tMax);
+	for (uint32_t a = 0; a < 3; a++)
+	{
+		const __m128 org = _mm_set1_ps(rp.org[a]), invDir = _mm_set1_ps(rp.invDir[a]);
+		const __m128 t0 = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(packet.bmin[a]), org), invDir);
+		const __m128 t1 = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(packet.bmax[a]), org), invDir);
+
+		// minps/maxps return their second operand on NaNs, so these orders pick what RayBox's swap + selects do
+		const __m128 tNear = _mm_min_ps(t1, t0);
+		const __m128 tFar = _mm_mul_ps(_mm_max_ps(t0, t1), farScale);
+		entry = _mm_max_ps(tNear, entry);
+		exit = _mm_min_ps(tFar, exit);
+	}
+
+	_mm_storeu_ps(outEntries, entry);
+	return static_cast<uint32_t>(_mm_movemask_ps(_mm_cmple_ps(entry, exit))) & ((1u << packet.count) - 1);
+#else
+	return RayBoxesScalar(rp, packet, tMin, tMax, outEntries);
+#endif
+}
+
+#ifdef INTERSECTION_AVX2
+
+// As TriangleTailSSE, over four lanes
+inline uint32_t TriangleTailAVX2(const __m256d& Ax, const __m256d& Ay, const __m256d& Bx, const __m256d& By, const __m256d& Cx, const __m256d& Cy,
+								 const __m256d& Az, const __m256d& Bz, const __m256d& Cz, __m128* outT, __m128* outU, __m128* outV)
+{
+	const __m256d zero = _mm256_setzero_pd();
+	const __m256d U = _mm256_sub_pd(_mm256_mul_pd(Cx, By), _mm256_mul_pd(Cy, Bx));
+	const __m256d V = _mm256_sub_pd(_mm256_mul_pd(Ax, Cy), _mm256_mul_pd(Ay, Cx));
+	const __m256d W = _mm256_sub_pd(_mm256_mul_pd(Bx, Ay), _mm256_mul_pd(By, Ax));
+	const __m256d anyNegative = _mm256_or_pd(_mm256_or_pd(_mm256_cmp_pd(U, zero, _CMP_LT_OQ), _mm256_cmp_pd(V, zero, _CMP_LT_OQ)), _mm256_cmp_pd(W, zero, _CMP_LT_OQ));
+	const __m256d anyPositive = _mm256_or_pd(_mm256_or_pd(_mm256_cmp_pd(U, zero, _CMP_GT_OQ), _mm256_cmp_pd(V, zero, _CMP_GT_OQ)), _mm256_cmp_pd(W, zero, _CMP_GT_OQ));
+
+	const __m256d det = _mm256_add_pd(_mm256_add_pd(U, V), W);
+	const __m256d T = _mm256_add_pd(_mm256_add_pd(SeparatelyRounded(_mm256_mul_pd(U, Az)), SeparatelyRounded(_mm256_mul_pd(V, Bz))),
+									SeparatelyRounded(_mm256_mul_pd(W, Cz)));
+	const __m256d rcpDet = _mm256_div_pd(_mm256_set1_pd(1.0), det);
+	*outT = _mm256_cvtpd_ps(_mm256_mul_pd(T, rcpDet));
+	*outU = _mm256_cvtpd_ps(_mm256_mul_pd(V, rcpDet));
+	*outV = _mm256_cvtpd_ps(_mm256_mul_pd(W, rcpDet));
+
+	const __m256d passed = _mm256_andnot_pd(_mm256_and_pd(anyNegative, anyPositive), _mm256_cmp_pd(det, zero, _CMP_NEQ_UQ));
+	return static_cast<uint32_t>(_mm256_movemask_pd(passed));
+}
+
+#endif
+
+inline uint32_t RayTriangles8(const RayPrecomp& rp, const TrianglePacket<8>& packet, float tMin, float tMax, float* outT, float* outU, float* outV)
+{
+#ifdef INTERSECTION_AVX2
+	const __m256 ox = _mm256_set1_ps(rp.org[rp.kx]), oy = _mm256_set1_ps(rp.org[rp.ky]), oz = _mm256_set1_ps(rp.org[rp.kz]);
+	const __m256 Sx = _mm256_set1_ps(rp.Sx), Sy = _mm256_set1_ps(rp.Sy), Sz = _mm256_set1_ps(rp.Sz);
+
+	__m256 x[3], y[3], z[3];
+	const float (*verts[3])[8] = { packet.v0, packet.v1, packet.v2 };
+	for (uint32_t k = 0; k < 3; k++)
+	{
+		const __m256 dz = _mm256_sub_ps(_mm256_loadu_ps(verts[k][rp.kz]), oz);
+		x[k] = _mm256_sub_ps(_mm256_sub_ps(_mm256_loadu_ps(verts[k][rp.kx]), ox), SeparatelyRounded(_mm256_mul_ps(Sx, dz)));
+		y[k] = _mm256_sub_ps(_mm256_sub_ps(_mm256_loadu_ps(verts[k][rp.ky]), oy), SeparatelyRounded(_mm256_mul_ps(Sy, dz)));
+		z[k] = _mm256_mul_ps(Sz, dz);
+	}
+
+	__m128 t[2], u[2], v[2];
+	uint32_t passed = 0;
+	for (uint32_t half = 0; half < 2; half++)
+	{
+		auto toDouble = [half](__m256 f) { return _mm256_cvtps_pd((half == 0) ? _mm256_castps256_ps128(f) : _mm256_extractf128_ps(f, 1)); };
+		passed |= TriangleTailAVX2(toDouble(x[0]), toDouble(y[0]), toDouble(x[1]), toDouble(y[1]), toDouble(x[2]), toDouble(y[2]), toDouble(z[0]),
+								   toDouble(z[1]), toDouble(z[2]), &t[half], &u[half], &v[half]) << (half * 4);
+	}
+
+	const __m256 tLanes = _mm256_set_m128(t[1], t[0]);
+	const __m256 inRange = _mm256_and_ps(_mm256_cmp_ps(tLanes, _mm256_set1_ps(tMin), _CMP_GE_OQ), _mm256_cmp_ps(tLanes, _mm256_set1_ps(tMax), _CMP_LE_OQ));
+	_mm256_storeu_ps(outT, tLanes);
+	_mm256_storeu_ps(outU, _mm256_set_m128(u[1], u[0]));
+	_mm256_storeu_ps(outV, _mm256_set_m128(v[1], v[0]));
+	return passed & static_cast<uint32_t>(_mm256_movemask_ps(inRange)) & ((1u << packet.count) - 1);
+#elif defined(INTERSECTION_SSE)
+	uint32_t hitMask = 0;
+	for (uint32_t half = 0; half < 2; half++)
+	{
+		TrianglePacket<4> halfPacket;
+		halfPacket.count = std::min(std::max(packet.count, half * 4) - half * 4, 4u);
+		for (uint32_t a = 0; a < 3; a++)
+		{
+			memcpy(halfPacket.v0[a], &packet.v0[a][half * 4], sizeof(halfPacket.v0[a]));
+			memcpy(halfPacket.v1[a], &packet.v1[a][half * 4], sizeof(halfPacket.v1[a]));
+			memcpy(halfPacket.v2[a], &packet.v2[a][half * 4], sizeof(halfPacket.v2[a]));
+		}
+		hitMask |= RayTriangles4(rp, halfPacket, tMin, tMax, &outT[half * 4], &outU[half * 4], &outV[half * 4]) << (half * 4);
+	}
+	return hitMask;
+#else
+	return RayTrianglesScalar(rp, packet, tMin, tMax, outT, outU, outV);
+#endif
+}
+
+inline uint32_t RayBoxes8(const RayPrecomp& rp, const BoxPacket<8>& packet, float tMin, float tMax, float* outEntries)
+{
+#ifdef INTERSECTION_AVX2
+	const __m256 farScale = _mm256_set1_ps(robustFarScale);
+	__m256 entry = _mm256_set1_ps(tMin), exit = _mm256_set1_ps(tMax);
+	for (uint32_t a = 0; a < 3; a++)
+	{
+		const __m256 org = _mm256_set1_ps(rp.org[a]), invDir = _mm256_set1_ps(rp.invDir[a]);
+		const __m256 t0 = _mm256_mul_ps(_mm256_sub_ps(_mm256_loadu_ps(packet.bmin[a]), org), invDir);
+		const __m256 t1 = _mm256_mul_ps(_mm256_sub_ps(_mm256_loadu_ps(packet.bmax[a]), org), invDir);
+		const __m256 tNear = _mm256_min_ps(t1, t0);
+		const __m256 tFar = _mm256_mul_ps(_mm256_max_ps(t0, t1), farScale);
+		entry = _mm256_max_ps(tNear, entry);
+		exit = _mm256_min_ps(tFar, exit);
+	}
+
+	_mm256_storeu_ps(outEntries, entry);
+	return static_cast<uint32_t>(_mm256_movemask_ps(_mm256_cmp_ps(entry, exit, _CMP_LE_OQ))) & ((1u << packet.count) - 1);
+#elif defined(INTERSECTION_SSE)
+	uint32_t hitMask = 0;
+	for (uint32_t half = 0; half < 2; half++)
+	{
+		BoxPacket<4> halfPacket;
+		halfPacket.count = std::min(std::max(packet.count, half * 4) - half * 4, 4u);
+		for (uint32_t a = 0; a < 3; a++)
+		{
+			memcpy(halfPacket.bmin[a], &packet.bmin[a][half * 4], sizeof(halfPacket.bmin[a]));
+			memcpy(halfPacket.bmax[a], &packet.bmax[a][half * 4], sizeof(halfPacket.bmax[a]));
+		}
+		hitMask |= RayBoxes4(rp, halfPacket, tMin, tMax, &outEntries[half * 4]) << (half * 4);
+	}
+	return hitMask;
+#else
+	return RayBoxesScalar(rp, packet, tMin, tMax, outEntries);
+#endif
+}
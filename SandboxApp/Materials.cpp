@@ -1,3 +1,3 @@
 #include "Materials.h"
 
-#include "..\Shaders\spectralCurveImplementations.h"
\ No newline at end of file
+#include "../Shaders/spectralCurveImplementations.h"
\ No newline at end of file
@@ -1,8 +1,8 @@
 #pragma once
 
 #include <stdint.h>
-#include "..\CPUMemory.h"
-#include "..\Shaders\materials.h"
+#include "../CPUMemory.h"
+#include "../Shaders/materials.h"
 
 // Three "basic" ones for now, perhaps more later
 enum class SCATTERING_FUNCTIONS
@@ -14,6 +14,13 @@ enum class SCATTERING_FUNCTIONS
 
 struct Material
 {
+	// Uniform materials describe the whole model with one spectral curve + one roughness value, and skip texture allocation/atlassing
+	// entirely; shading reads them straight out of [MaterialPropertyEntry] instead of sampling the material atlases
+	// Every OBJ import starts out uniform (white, smooth, diffuse) until it's painted in the Sandbox and exported as DXRS
+	bool isUniform;
+	MaterialSPD_Piecewise uniformSPD;
+	float uniformRoughness;
+
 	// Roughness is standard 2D greyscale texture
 	CPUMemory::ArrayAllocHandle<float> roughnessData;
 	uint64_t roughnessDataSize;
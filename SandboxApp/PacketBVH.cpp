@@ -0,0 +1,770 @@
+#include "PacketBVH.h"
+#include "Intersection.h"
+
+#include <algorithm>
+#include <bit>
+#include <cassert>
+#include <cmath>
+#include <cstring>
+
+// Depth-first walks hold one pending child per level
+constexpr uint32_t traversalStackSize = AS_BVH_MAX_DEPTH + 1;
+
+// Stream lists filtered down to this many rays finish their subtree one ray at a time (filtering a near-empty list costs more than
+// it shares)
+constexpr uint32_t streamSingleRays = 4;
+
+// Packet/stream rays in SoA form (for eight-at-a-time box tests), plus each ray's shear constants for its triangle tests
+template<uint32_t capacity>
+struct RayBlock
+{
+	float org[3][capacity];
+	float invDir[3][capacity];
+	float tMin[capacity], tMax[capacity];
+	RayPrecomp rp[capacity];
+};
+
+template<uint32_t capacity>
+static void LoadRay(RayBlock<capacity>& block, uint32_t slot, const PacketBVH::Ray& ray)
+{
+	block.rp[slot] = PrecomputeRay(ray.origin, ray.dir);
+	for (uint32_t a = 0; a < 3; a++)
+	{
+		block.org[a][slot] = block.rp[slot].org[a];
+		block.invDir[a][slot] = block.rp[slot].invDir[a];
+	}
+	block.tMin[slot] = ray.tMin;
+	block.tMax[slot] = ray.tMax;
+}
+
+// Eight rays (slots [first, first + 8) of [block]) against one box, with RayBox's arithmetic per lane; returns the lanes that hit
+template<uint32_t capacity>
+static uint32_t BoxHits8(const RayBlock<capacity>& block, uint32_t first, const float* bmin, const float* bmax)
+{
+#ifdef INTERSECTION_AVX2
+	const __m256 farScale = _mm256_set1_ps(robustFarScale);
+	__m256 entry = _mm256_loadu_ps(&block.tMin[first]), exit = _mm256_loadu_ps(&block.tMax[first]);
+	for (uint32_t a = 0; a < 3; a++)
+	{
+		const __m256 org = _mm256_loadu_ps(&block.org[a][first]), invDir = _mm256_loadu_ps(&block.invDir[a][first]);
+		const __m256 t0 = _mm256_mul_ps(_mm256_sub_ps(_mm256_set1_ps(bmin[a]), org), invDir);
+		const __m256 t1 = _mm256_mul_ps(_mm256_sub_ps(_mm256_set1_ps(bmax[a]), org), invDir);
+		entry = _mm256_max_ps(_mm256_min_ps(t1, t0), entry);
+		exit = _mm256_min_ps(_mm256_mul_ps(_mm256_max_ps(t0, t1), farScale), exit);
+	}
+	return static_cast<uint32_t>(_mm256_movemask_ps(_mm256_cmp_ps(entry, exit, _CMP_LE_OQ)));
+#else
+	uint32_t hitMask = 0;
+	for (uint32_t i = 0; i < 8; i++)
+	{
+		float entry;
+		hitMask |= RayBox(bmin, bmax, block.rp[first + i], block.tMin[first + i], block.tMax[first + i], &entry) ? (1u << i) : 0u;
+	}
+	return hitMask;
+#endif
+}
+
+// As above, for the first [count] (up to eight) rays listed at [ndces]; lanes past [count] never hit
+template<uint32_t capacity>
+static uint32_t BoxHits8(const RayBlock<capacity>& block, const uint16_t* ndces, uint32_t count, const float* bmin, const float* bmax)
+{
+	const uint32_t laneMask = (count >= 8) ? 0xffu : ((1u << count) - 1);
+#ifdef INTERSECTION_AVX2
+	// Unused lanes gather ray zero, so list entries past [count] needn't hold valid indices
+	const __m256i laneNdces = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+	const __m256i used = _mm256_cmpgt_epi32(_mm256_set1_epi32(static_cast<int>(std::min(count, 8u))), laneNdces);
+	const __m256i lanes = _mm256_and_si256(_mm256_cvtepu16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(ndces))), used);
+	const __m256 farScale = _mm256_set1_ps(robustFarScale);
+	__m256 entry = _mm256_i32gather_ps(block.tMin, lanes, 4), exit = _mm256_i32gather_ps(block.tMax, lanes, 4);
+	for (uint32_t a = 0; a < 3; a++)
+	{
+		const __m256 org = _mm256_i32gather_ps(block.org[a], lanes, 4), invDir = _mm256_i32gather_ps(block.invDir[a], lanes, 4);
+		const __m256 t0 = _mm256_mul_ps(_mm256_sub_ps(_mm256_set1_ps(bmin[a]), org), invDir);
+		const __m256 t1 = _mm256_mul_ps(_mm256_sub_ps(_mm256_set1_ps(bmax[a]), org), invDir);
+		entry = _mm256_max_ps(_mm256_min_ps(t1, t0), entry);
+		exit = _mm256_min_ps(_mm256_mul_ps(_mm256_max_ps(t0, t1), farScale), exit);
+	}
+	return static_cast<uint32_t>(_mm256_movemask_ps(_mm256_cmp_ps(entry, exit, _CMP_LE_OQ))) & laneMask;
+#else
+	uint32_t hitMask = 0;
+	for (uint32_t i = 0; i < std::min(count, 8u); i++)
+	{
+		float entry;
+		hitMask |= RayBox(bmin, bmax, block.rp[ndces[i]], block.tMin[ndces[i]], block.tMax[ndces[i]], &entry) ? (1u << i) : 0u;
+	}
+	return hitMask & laneMask;
+#endif
+}
+
+// Bounds every ray of a packet sharing one origin: rays leave the origin within [sMin, sMax] of slope (along [kx]/[ky], per unit of
+// depth along [kz] in the packet's direction)
+struct PacketFrustum
+{
+	bool valid;
+	double origin[3];
+	uint32_t kx, ky, kz;
+	double depthSign;
+	double sMin[2], sMax[2];
+};
+
+static PacketFrustum BuildFrustum(const PacketBVH::Ray* rays, uint32_t numRays, const float* meanDir)
+{
+	PacketFrustum frustum = {};
+	for (uint32_t i = 1; i < numRays; i++)
+	{
+		if (memcmp(&rays[i].origin, &rays[0].origin, 3 * sizeof(float)) != 0)
+		{
+			return frustum;
+		}
+	}
+
+	frustum.kz = (std::abs(meanDir[0]) > std::abs(meanDir[1])) ? ((std::abs(meanDir[0]) > std::abs(meanDir[2])) ? 0 : 2) : ((std::abs(meanDir[1]) > std::abs(meanDir[2])) ? 1 : 2);
+	frustum.kx = (frustum.kz + 1) % 3;
+	frustum.ky = (frustum.kz + 2) % 3;
+	frustum.depthSign = (meanDir[frustum.kz] < 0.0f) ? -1.0 : 1.0;
+	const float origin[3] = { rays[0].origin.x, rays[0].origin.y, rays[0].origin.z };
+	for (uint32_t a = 0; a < 3; a++)
+	{
+		frustum.origin[a] = origin[a];
+	}
+
+	const uint32_t slopeAxes[2] = { frustum.kx, frustum.ky };
+	for (uint32_t s = 0; s < 2; s++)
+	{
+		frustum.sMin[s] = INFINITY;
+		frustum.sMax[s] = -INFINITY;
+	}
+	for (uint32_t i = 0; i < numRays; i++)
+	{
+		const float dir[3] = { rays[i].dir.x, rays[i].dir.y, rays[i].dir.z };
+		const double depth = dir[frustum.kz] * frustum.depthSign;
+		if (!(depth > 0.0) || !std::isfinite(depth))
+		{
+			return frustum; // Some ray runs sideways/backwards along the packet's direction; no frustum bounds it
+		}
+		for (uint32_t s = 0; s < 2; s++)
+		{
+			const double slope = dir[slopeAxes[s]] / depth;
+			frustum.sMin[s] = std::min(frustum.sMin[s], slope);
+			frustum.sMax[s] = std::max(frustum.sMax[s], slope);
+		}
+	}
+	frustum.valid = std::isfinite(frustum.sMin[0]) && std::isfinite(frustum.sMax[0]) && std::isfinite(frustum.sMin[1]) && std::isfinite(frustum.sMax[1]);
+	return frustum;
+}
+
+// Whether [bmin, bmax] lies wholly outside [frustum] (so no ray of its packet can hit it)
+// Each plane is tested at the box corner furthest inside it; boxes are only culled past a margin (relative to the coordinates
+// involved) that covers RayBox's rounding and far-distance padding, so nothing a ray of the packet could hit is culled
+static bool FrustumCulls(const PacketFrustum& frustum, const float* bmin, const float* bmax)
+{
+	constexpr double margin = 1e-5;
+	const uint32_t kz = frustum.kz;
+	const double oz = frustum.origin[kz];
+
+	// Behind the origin
+	const double zFar = (frustum.depthSign > 0.0) ? bmax[kz] : bmin[kz];
+	if ((zFar - oz) * frustum.depthSign < -margin * (std::abs(zFar) + std::abs(oz)))
+	{
+		return true;
+	}
+
+	// Side planes: (p - o)[axis] - slope * depth >= 0 (lower), or slope * depth - (p - o)[axis] >= 0 (upper), for points at positive depth
+	const uint32_t slopeAxes[2] = { frustum.kx, frustum.ky };
+	for (uint32_t s = 0; s < 2; s++)
+	{
+		const uint32_t axis = slopeAxes[s];
+		const double o = frustum.origin[axis];
+		for (uint32_t side = 0; side < 2; side++)
+		{
+			const double slope = (side == 0) ? frustum.sMin[s] : frustum.sMax[s];
+			const double sign = (side == 0) ? 1.0 : -1.0;
+			const double p = (side == 0) ? bmax[axis] : bmin[axis];
+			const double zCoef = -sign * slope * frustum.depthSign;
+			const double z = (zCoef >= 0.0) ? bmax[kz] : bmin[kz];
+			const double distance = sign * ((p - o) - slope * (z - oz) * frustum.depthSign);
+			const double scale = std::abs(p) + std::abs(o) + std::abs(slope) * (std::abs(z) + std::abs(oz));
+			if (distance < -margin * scale)
+			{
+				return true;
+			}
+		}
+	}
+	return false;
+}
+
+// Whether [left] should be visited before [right] by rays heading along [dir]; compares their centers along the axis separating
+// them most
+static bool LeftFirst(const float* leftMin, const float* leftMax, const float* rightMin, const float* rightMax, const float* dir)
+{
+	uint32_t axis = 0;
+	float bestSeparation = -1.0f, separation = 0.0f;
+	for (uint32_t a = 0; a < 3; a++)
+	{
+		const float d = (rightMin[a] + rightMax[a]) - (leftMin[a] + leftMax[a]);
+		if (std::abs(d) > bestSeparation)
+		{
+			bestSeparation = std::abs(d);
+			separation = d;
+			axis = a;
+		}
+	}
+	return separation * dir[axis] >= 0.0f;
+}
+
+// One ray against one leaf packet, shrinking [tMax] to the nearest hit (ties keep the earlier triangle, as sequential tests would);
+// returns whether the packet held a hit
+template<bool anyHit>
+static bool PacketHit(const RayPrecomp& rp, const TrianglePacket<8>& packet, const uint32_t* triNdces, float tMin, float& tMax, bool& found,
+					  PacketBVH::Hit* outHit, PacketBVH::TraceCounts* counts)
+{
+	if (counts != nullptr)
+	{
+		counts->triTests += packet.count;
+	}
+
+	float t[8], u[8], v[8];
+	uint32_t mask = RayTriangles8(rp, packet, tMin, tMax, t, u, v);
+	if (mask == 0)
+	{
+		return false;
+	}
+	if constexpr (anyHit)
+	{
+		found = true;
+		return true;
+	}
+
+	uint32_t best = static_cast<uint32_t>(std::countr_zero(mask));
+	for (mask &= mask - 1; mask != 0; mask &= mask - 1)
+	{
+		const uint32_t lane = static_cast<uint32_t>(std::countr_zero(mask));
+		best = (t[lane] < t[best]) ? lane : best;
+	}
+	if (!found || t[best] < tMax)
+	{
+		found = true;
+		tMax = t[best];
+		*outHit = { t[best], u[best], v[best], triNdces[best] };
+	}
+	return true;
+}
+
+void PacketBVH::Build(const BVH& bvh, const float4* positions, [[maybe_unused]] uint64_t numVerts, uint64_t strideBytes, const IndexedTriangle* tris)
+{
+	assert(BVH::TriIndicesInRange(tris, bvh.NumTris(), numVerts));
+	numNodes = bvh.NumNodes();
+	numTris = bvh.NumTris();
+	numPackets = 0;
+	const ComputeBVH_Node* sourceNodes = &bvh.Nodes()[0];
+	for (uint32_t n = 0; n < numNodes; n++)
+	{
+		numPackets += (sourceNodes[n].triCount + 7) / 8;
+	}
+
+	nodes = CPUMemory::AllocateArray<Node>(std::max(numNodes, 1u));
+	packets = CPUMemory::AllocateArray<LeafPacket>(std::max(numPackets, 1u));
+
+	// New allocations never move older ones, so the source tree can be resolved once
+	sourceNodes = &bvh.Nodes()[0];
+	const uint32_t* triList = &bvh.TriList()[0];
+	Node* nodeData = &nodes[0];
+	LeafPacket* packetData = &packets[0];
+	uint32_t nextPacket = 0;
+	for (uint32_t n = 0; n < numNodes; n++)
+	{
+		const ComputeBVH_Node& source = sourceNodes[n];
+		Node& node = nodeData[n];
+		node.bmin[0] = source.boundsMin.x;
+		node.bmin[1] = source.boundsMin.y;
+		node.bmin[2] = source.boundsMin.z;
+		node.bmax[0] = source.boundsMax.x;
+		node.bmax[1] = source.boundsMax.y;
+		node.bmax[2] = source.boundsMax.z;
+		if (source.triCount == 0)
+		{
+			node.rightOrFirstPacket = source.rightOrFirstTri;
+			node.numPackets = 0;
+			continue;
+		}
+
+		node.rightOrFirstPacket = nextPacket;
+		node.numPackets = (source.triCount + 7) / 8;
+		for (uint32_t first = 0; first < source.triCount; first += 8)
+		{
+			LeafPacket& packet = packetData[nextPacket++];
+			const uint32_t count = std::min(source.triCount - first, 8u);
+			PackTriangles(positions, strideBytes, tris, &triList[source.rightOrFirstTri + first], count, &packet.tris);
+			for (uint32_t lane = 0; lane < 8; lane++)
+			{
+				packet.triNdces[lane] = (lane < count) ? triList[source.rightOrFirstTri + first + lane] : invalidTri;
+			}
+		}
+	}
+	assert(nextPacket == numPackets);
+}
+
+void PacketBVH::DeInit()
+{
+	CPUMemory::Free(packets);
+	CPUMemory::Free(nodes);
+	packets = {};
+	nodes = {};
+	numNodes = 0;
+	numPackets = 0;
+	numTris = 0;
+}
+
+template<bool anyHit>
+bool PacketBVH::TraceRay(const Ray& ray, Hit* outHit, TraceCounts* counts) const
+{
+	if constexpr (!anyHit)
+	{
+		outHit->tri = invalidTri;
+	}
+	if (numTris == 0)
+	{
+		return false;
+	}
+
+	const Node& root = nodes[0];
+	const RayPrecomp rp = PrecomputeRay(ray.origin, ray.dir);
+	float tMax = ray.tMax;
+	bool found = false;
+
+	float entry;
+	if (counts != nullptr)
+	{
+		counts->boxTests++;
+	}
+	if (!RayBox(root.bmin, root.bmax, rp, ray.tMin, tMax, &entry))
+	{
+		return false;
+	}
+
+	return TraceSubtree<anyHit>(0, rp, ray.tMin, tMax, found, outHit, counts);
+}
+
+template<bool anyHit>
+bool PacketBVH::TraceSubtree(uint32_t rootNdx, const RayPrecomp& rp, float tMin, float& tMax, bool& found, Hit* outHit, TraceCounts* counts) const
+{
+	const Node* nodeData = &nodes[0];
+	const LeafPacket* packetData = &packets[0];
+	uint32_t stackNodes[traversalStackSize];
+	float stackEntries[traversalStackSize];
+	uint32_t stackSize = 0;
+	uint32_t nodeNdx = rootNdx;
+	while (true)
+	{
+		if (counts != nullptr)
+		{
+			counts->nodeVisits++;
+		}
+
+		const Node& node = nodeData[nodeNdx];
+		if (node.numPackets > 0)
+		{
+			for (uint32_t p = 0; p < node.numPackets; p++)
+			{
+				const LeafPacket& packet = packetData[node.rightOrFirstPacket + p];
+				if (PacketHit<anyHit>(rp, packet.tris, packet.triNdces, tMin, tMax, found, outHit, counts) && anyHit)
+				{
+					return true;
+				}
+			}
+		}
+		else
+		{
+			const uint32_t left = nodeNdx + 1, right = node.rightOrFirstPacket;
+			float leftEntry, rightEntry;
+			const bool hitLeft = RayBox(nodeData[left].bmin, nodeData[left].bmax, rp, tMin, tMax, &leftEntry);
+			const bool hitRight = RayBox(nodeData[right].bmin, nodeData[right].bmax, rp, tMin, tMax, &rightEntry);
+			if (counts != nullptr)
+			{
+				counts->boxTests += 2;
+			}
+
+			if (hitLeft && hitRight)
+			{
+				const bool leftNear = (leftEntry <= rightEntry);
+				stackNodes[stackSize] = leftNear ? right : left;
+				stackEntries[stackSize] = leftNear ? rightEntry : leftEntry;
+				stackSize++;
+				nodeNdx = leftNear ? left : right;
+				continue;
+			}
+			else if (hitLeft || hitRight)
+			{
+				nodeNdx = hitLeft ? left : right;
+				continue;
+			}
+		}
+
+		bool pending = false;
+		while (stackSize > 0 && !pending)
+		{
+			stackSize--;
+			pending = (stackEntries[stackSize] <= tMax);
+			nodeNdx = stackNodes[stackSize];
+		}
+		if (!pending)
+		{
+			return found;
+		}
+	}
+}
+
+template<bool anyHit>
+uint64_t PacketBVH::TracePacket(const Ray* rays, uint32_t numRays, Hit* outHits, TraceCounts* counts) const
+{
+	assert(numRays <= maxPacketRays);
+	if constexpr (!anyHit)
+	{
+		for (uint32_t i = 0; i < numRays; i++)
+		{
+			outHits[i].tri = invalidTri;
+		}
+	}
+	if (numTris == 0 || numRays == 0)
+	{
+		return 0;
+	}
+
+	// Lanes past [numRays] get empty ranges, so they never hit anything
+	RayBlock<maxPacketRays> block;
+	float meanDir[3] = { 0.0f, 0.0f, 0.0f };
+	for (uint32_t i = 0; i < maxPacketRays; i++)
+	{
+		if (i < numRays)
+		{
+			LoadRay(block, i, rays[i]);
+			meanDir[0] += rays[i].dir.x;
+			meanDir[1] += rays[i].dir.y;
+			meanDir[2] += rays[i].dir.z;
+		}
+		else
+		{
+			LoadRay(block, i, rays[0]);
+			block.tMin[i] = INFINITY;
+			block.tMax[i] = -INFINITY;
+		}
+	}
+	const PacketFrustum frustum = BuildFrustum(rays, numRays, meanDir);
+
+	const Node* nodeData = &nodes[0];
+	const LeafPacket* packetData = &packets[0];
+	const uint64_t allRays = (numRays == 64) ? ~0ull : ((1ull << numRays) - 1);
+	uint64_t foundMask = 0;
+
+	uint32_t stackNodes[traversalStackSize];
+	uint64_t stackMasks[traversalStackSize];
+	uint32_t stackSize = 1;
+	stackNodes[0] = 0;
+	stackMasks[0] = allRays;
+	while (stackSize > 0)
+	{
+		stackSize--;
+		const uint32_t nodeNdx = stackNodes[stackSize];
+		const uint64_t candidates = anyHit ? (stackMasks[stackSize] & ~foundMask) : stackMasks[stackSize];
+		if (candidates == 0)
+		{
+			continue;
+		}
+
+		const Node& node = nodeData[nodeNdx];
+		if (counts != nullptr)
+		{
+			counts->nodeVisits++;
+		}
+		if (frustum.valid && FrustumCulls(frustum, node.bmin, node.bmax))
+		{
+			if (counts != nullptr)
+			{
+				counts->frustumCulls++;
+			}
+			continue;
+		}
+
+		// Only groups of eight holding a candidate are tested
+		uint64_t hitMask = 0;
+		for (uint32_t group = 0; group < maxPacketRays / 8; group++)
+		{
+			if (((candidates >> (group * 8)) & 0xff) != 0)
+			{
+				hitMask |= static_cast<uint64_t>(BoxHits8(block, group * 8, node.bmin, node.bmax)) << (group * 8);
+			}
+		}
+		hitMask &= candidates;
+		if (counts != nullptr)
+		{
+			counts->boxTests += static_cast<uint64_t>(std::popcount(candidates));
+		}
+		if (hitMask == 0)
+		{
+			continue;
+		}
+
+		if (node.numPackets == 0)
+		{
+			const uint32_t left = nodeNdx + 1, right = node.rightOrFirstPacket;
+			const bool leftFirst = LeftFirst(nodeData[left].bmin, nodeData[left].bmax, nodeData[right].bmin, nodeData[right].bmax, meanDir);
+			stackNodes[stackSize] = leftFirst ? right : left;
+			stackMasks[stackSize] = hitMask;
+			stackNodes[stackSize + 1] = leftFirst ? left : right;
+			stackMasks[stackSize + 1] = hitMask;
+			stackSize += 2;
+			continue;
+		}
+
+		for (uint64_t bits = hitMask; bits != 0; bits &= bits - 1)
+		{
+			const uint32_t i = static_cast<uint32_t>(std::countr_zero(bits));
+			bool found = (foundMask >> i) & 1;
+			for (uint32_t p = 0; p < node.numPackets; p++)
+			{
+				const LeafPacket& packet = packetData[node.rightOrFirstPacket + p];
+				if (PacketHit<anyHit>(block.rp[i], packet.tris, packet.triNdces, block.tMin[i], block.tMax[i], found, anyHit ? nullptr : &outHits[i], counts) &&
+					anyHit)
+				{
+					break;
+				}
+			}
+			foundMask |= static_cast<uint64_t>(found) << i;
+		}
+	}
+	return foundMask;
+}
+
+template<bool anyHit>
+uint32_t PacketBVH::TraceStream(const Ray* rays, const uint32_t* order, uint32_t numRays, Hit* outHits, bool* outOccluded, TraceCounts* counts) const
+{
+	for (uint32_t i = 0; i < numRays; i++)
+	{
+		if constexpr (anyHit)
+		{
+			outOccluded[i] = false;
+		}
+		else
+		{
+			outHits[i].tri = invalidTri;
+		}
+	}
+	if (numTris == 0)
+	{
+		return 0;
+	}
+
+	const Node* nodeData = &nodes[0];
+	const LeafPacket* packetData = &packets[0];
+	uint32_t numHits = 0;
+
+	// Each pending node refers to the filtered list its parent left; lists stack up one per level (plus a group of padding, since
+	// filters read ray indices eight at a time)
+	RayBlock<streamRays> block;
+	uint16_t lists[(traversalStackSize + 1) * streamRays + 8];
+	uint32_t stackNodes[traversalStackSize + 1], stackLists[traversalStackSize + 1], stackCounts[traversalStackSize + 1];
+	bool found[streamRays];
+
+	for (uint32_t first = 0; first < numRays; first += streamRays)
+	{
+		const uint32_t count = std::min(numRays - first, streamRays);
+		for (uint32_t i = 0; i < count; i++)
+		{
+			LoadRay(block, i, rays[order[first + i]]);
+			lists[i] = static_cast<uint16_t>(i);
+			found[i] = false;
+		}
+
+		uint32_t stackSize = 1;
+		stackNodes[0] = 0;
+		stackLists[0] = 0;
+		stackCounts[0] = count;
+		while (stackSize > 0)
+		{
+			stackSize--;
+			const uint32_t nodeNdx = stackNodes[stackSize];
+			const uint16_t* inList = &lists[stackLists[stackSize]];
+			const uint32_t inCount = stackCounts[stackSize];
+			const Node& node = nodeData[nodeNdx];
+			if (counts != nullptr)
+			{
+				counts->nodeVisits++;
+				counts->boxTests += inCount;
+			}
+
+			// Filter into the space after the list being read (which nothing deeper needs any more)
+			const uint32_t outOffset = stackLists[stackSize] + inCount;
+			uint16_t* outList = &lists[outOffset];
+			uint32_t outCount = 0;
+			for (uint32_t i = 0; i < inCount; i += 8)
+			{
+				for (uint32_t mask = BoxHits8(block, &inList[i], inCount - i, node.bmin, node.bmax); mask != 0; mask &= mask - 1)
+				{
+					outList[outCount++] = inList[i + std::countr_zero(mask)];
+				}
+			}
+			if (outCount == 0)
+			{
+				continue;
+			}
+
+			if (node.numPackets == 0 && outCount <= streamSingleRays)
+			{
+				for (uint32_t r = 0; r < outCount; r++)
+				{
+					const uint32_t slot = outList[r];
+					if (TraceSubtree<anyHit>(nodeNdx, block.rp[slot], block.tMin[slot], block.tMax[slot], found[slot], anyHit ? nullptr : &outHits[order[first + slot]], counts) &&
+						anyHit)
+					{
+						block.tMin[slot] = INFINITY;
+						block.tMax[slot] = -INFINITY;
+					}
+				}
+				continue;
+			}
+
+			if (node.numPackets == 0)
+			{
+				const uint32_t left = nodeNdx + 1, right = node.rightOrFirstPacket;
+				const float dir[3] = { block.invDir[0][outList[0]], block.invDir[1][outList[0]], block.invDir[2][outList[0]] }; // Same signs as the direction
+				const bool leftFirst = LeftFirst(nodeData[left].bmin, nodeData[left].bmax, nodeData[right].bmin, nodeData[right].bmax, dir);
+				for (uint32_t c = 0; c < 2; c++)
+				{
+					stackNodes[stackSize] = ((c == 0) == leftFirst) ? right : left;
+					stackLists[stackSize] = outOffset;
+					stackCounts[stackSize] = outCount;
+					stackSize++;
+				}
+				continue;
+			}
+
+			for (uint32_t r = 0; r < outCount; r++)
+			{
+				const uint32_t slot = outList[r];
+				const uint32_t rayNdx = order[first + slot];
+				for (uint32_t p = 0; p < node.numPackets; p++)
+				{
+					const LeafPacket& packet = packetData[node.rightOrFirstPacket + p];
+					if (PacketHit<anyHit>(block.rp[slot], packet.tris, packet.triNdces, block.tMin[slot], block.tMax[slot], found[slot], anyHit ? nullptr : &outHits[rayNdx],
+										  counts) &&
+						anyHit)
+					{
+						// Occluded rays get an empty range, so later filters drop them
+						block.tMin[slot] = INFINITY;
+						block.tMax[slot] = -INFINITY;
+						break;
+					}
+				}
+			}
+		}
+
+		for (uint32_t i = 0; i < count; i++)
+		{
+			numHits += found[i] ? 1 : 0;
+			if constexpr (anyHit)
+			{
+				outOccluded[order[first + i]] = found[i];
+			}
+		}
+	}
+	return numHits;
+}
+
+bool PacketBVH::ClosestHit(const Ray& ray, Hit* outHit, TraceCounts* counts) const
+{
+	return TraceRay<false>(ray, outHit, counts);
+}
+
+bool PacketBVH::AnyHit(const Ray& ray, TraceCounts* counts) const
+{
+	return TraceRay<true>(ray, nullptr, counts);
+}
+
+uint64_t PacketBVH::ClosestHitPacket(const Ray* rays, uint32_t numRays, Hit* outHits, TraceCounts* counts) const
+{
+	return TracePacket<false>(rays, numRays, outHits, counts);
+}
+
+uint64_t PacketBVH::AnyHitPacket(const Ray* rays, uint32_t numRays, TraceCounts* counts) const
+{
+	return TracePacket<true>(rays, numRays, nullptr, counts);
+}
+
+uint32_t PacketBVH::ClosestHitStream(const Ray* rays, const uint32_t* order, uint32_t numRays, Hit* outHits, TraceCounts* counts) const
+{
+	return TraceStream<false>(rays, order, numRays, outHits, nullptr, counts);
+}
+
+uint32_t PacketBVH::AnyHitStream(const Ray* rays, const uint32_t* order, uint32_t numRays, bool* outOccluded, TraceCounts* counts) const
+{
+	return TraceStream<true>(rays, order, numRays, nullptr, outOccluded, counts);
+}
+
+// Spreads the low 9 bits of [v] three bits apart
+static uint32_t ExpandBits9(uint32_t v)
+{
+	v &= 0x1ff;
+	v = (v | (v << 16)) & 0x030000ff;
+	v = (v | (v << 8)) & 0x0300f00f;
+	v = (v | (v << 4)) & 0x030c30c3;
+	v = (v | (v << 2)) & 0x09249249;
+	return v;
+}
+
+void PacketBVH::SortStream(const Ray* rays, uint32_t numRays, uint64_t* scratch, uint32_t* outOrder) const
+{
+	float rootMin[3] = { 0.0f, 0.0f, 0.0f }, scale[3] = { 0.0f, 0.0f, 0.0f };
+	if (numNodes > 0)
+	{
+		const Node& root = nodes[0];
+		for (uint32_t a = 0; a < 3; a++)
+		{
+			rootMin[a] = root.bmin[a];
+			scale[a] = (root.bmax[a] > root.bmin[a]) ? 511.0f / (root.bmax[a] - root.bmin[a]) : 0.0f;
+		}
+	}
+
+	// Keys: direction octant over a 27-bit Morton code of the origin (clamped into the root's bounds), then the ray's index
+	uint64_t* keys = scratch;
+	uint64_t* sorted = scratch + numRays;
+	for (uint32_t i = 0; i < numRays; i++)
+	{
+		const float origin[3] = { rays[i].origin.x, rays[i].origin.y, rays[i].origin.z };
+		uint32_t morton = 0;
+		for (uint32_t a = 0; a < 3; a++)
+		{
+			const float cell = std::clamp((origin[a] - rootMin[a]) * scale[a], 0.0f, 511.0f);
+			morton |= ExpandBits9(static_cast<uint32_t>(cell == cell ? cell : 0.0f)) << a;
+		}
+		const uint32_t octant = (rays[i].dir.x < 0.0f ? 1u : 0u) | (rays[i].dir.y < 0.0f ? 2u : 0u) | (rays[i].dir.z < 0.0f ? 4u : 0u);
+		keys[i] = (static_cast<uint64_t>((octant << 27) | morton) << 32) | i;
+	}
+
+	// LSD radix sort over the upper 32 bits, eight at a time; an even number of passes leaves the result back in [keys]
+	for (uint32_t pass = 0; pass < 4; pass++)
+	{
+		const uint32_t shift = 32 + pass * 8;
+		uint32_t offsets[256] = {};
+		for (uint32_t i = 0; i < numRays; i++)
+		{
+			offsets[(keys[i] >> shift) & 0xff]++;
+		}
+		uint32_t sum = 0;
+		for (uint32_t& offset : offsets)
+		{
+			const uint32_t bucketSize = offset;
+			offset = sum;
+			sum += bucketSize;
+		}
+		for (uint32_t i = 0; i < numRays; i++)
+		{
+			sorted[offsets[(keys[i] >> shift) & 0xff]++] = keys[i];
+		}
+		std::swap(keys, sorted);
+	}
+
+	for (uint32_t i = 0; i < numRays; i++)
+	{
+		outOrder[i] = static_cast<uint32_t>(keys[i]);
+	}
+}
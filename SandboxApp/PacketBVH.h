@@ -0,0 +1,120 @@
+#pragma once
+
+#include <stdint.h>
+#include "../CPUMemory.h"
+#include "../Math.h"
+#include "../Shaders/SharedStructs.h"
+#include "BVH.h"
+#include "IntersectionSIMD.h"
+
+// Binary BVH with SoA-packed leaves, for tracing rays one at a time, in coherent packets, or in sorted streams (see HeadlessTracer's
+// tracing modes)
+// - Converted from a finished binary BVH (same depth-first order); each leaf's triangles are packed eight to a TrianglePacket, so
+//   leaves test a ray against eight triangles at once (IntersectionSIMD.h); source trees built with 8-triangle leaves fill them best
+// - Packets hold up to [maxPacketRays] rays (an 8x8 pixel tile, say) that traverse together, near-to-far along their mean direction;
+//   each visit tests the node's box against every ray still active, eight at a time. Packets whose rays share an origin (camera rays,
+//   or shadow rays traced back from one light sample) first test boxes against a frustum bounding the whole packet, and skip boxes
+//   outside it without any per-ray tests
+// - Streams sort any number of rays by direction octant, then along a Morton curve through their origins (so neighbouring rays take
+//   similar paths), and trace [streamRays] of them at a time: each visit filters the node's list of active rays down to the ones that
+//   hit its box, eight at a time, and its children start from the filtered list (ray stream filtering, Gribble & Ramani 2008)
+// - Every mode runs RayBox/RayTriangle's arithmetic (the frustum test is conservative), so hit distances match single-ray traversal
+//   exactly; ties between triangles at the same distance may resolve to either
+// - Positions are copied into the leaf packets, so meshes needn't outlive the structure; queries are const + allocation-free
+class PacketBVH
+{
+	public:
+		static constexpr uint32_t invalidTri = UINT32_MAX;
+		static constexpr uint32_t maxPacketRays = 64;
+		static constexpr uint32_t streamRays = 256;
+
+		struct Ray
+		{
+			float4 origin; // w unused
+			float4 dir; // w unused; needn't be normalized (distances are in units of |dir|)
+			float tMin, tMax;
+		};
+
+		struct Hit
+		{
+			float t;
+			float u, v; // Barycentric weights for the triangle's second/third vertices
+			uint32_t tri;
+		};
+
+		// Work done by a set of queries; accumulated, so one can cover many calls
+		struct TraceCounts
+		{
+			uint64_t nodeVisits; // Nodes popped (per packet/stream for those modes, per ray for single rays)
+			uint64_t boxTests; // Ray/box tests
+			uint64_t triTests; // Ray/triangle lane tests
+			uint64_t frustumCulls; // Boxes packets skipped by their frustum alone
+		};
+
+		// [bvh] must have been built over [positions]/[tris]; it isn't referenced after conversion
+		void Build(const BVH& bvh, const float4* positions, uint64_t numVerts, uint64_t strideBytes, const IndexedTriangle* tris);
+		void DeInit();
+
+		// Nearest intersection within [tMin, tMax]; misses return false, with [outHit->tri] set to [invalidTri]
+		bool ClosestHit(const Ray& ray, Hit* outHit, TraceCounts* counts = nullptr) const;
+
+		// Whether anything intersects the ray within [tMin, tMax] (occlusion/shadow rays)
+		bool AnyHit(const Ray& ray, TraceCounts* counts = nullptr) const;
+
+		// Up to [maxPacketRays] rays at once; returns the rays that hit (bit [i] for ray [i]), with [outHits] as [ClosestHit] fills them
+		uint64_t ClosestHitPacket(const Ray* rays, uint32_t numRays, Hit* outHits, TraceCounts* counts = nullptr) const;
+
+		// Up to [maxPacketRays] rays at once; returns the occluded ones
+		uint64_t AnyHitPacket(const Ray* rays, uint32_t numRays, TraceCounts* counts = nullptr) const;
+
+		// Orders [rays] for streaming (by direction octant, then origin Morton code within the root bounds); [scratch] holds 2 * [numRays]
+		// entries
+		void SortStream(const Ray* rays, uint32_t numRays, uint64_t* scratch, uint32_t* outOrder) const;
+
+		// Traces [rays] in the order [order] lists them (e.g. from [SortStream]), [streamRays] at a time; [outHits] is indexed as [rays],
+		// and the return value counts hits
+		uint32_t ClosestHitStream(const Ray* rays, const uint32_t* order, uint32_t numRays, Hit* outHits, TraceCounts* counts = nullptr) const;
+
+		// As above, for occlusion; [outOccluded] is indexed as [rays]
+		uint32_t AnyHitStream(const Ray* rays, const uint32_t* order, uint32_t numRays, bool* outOccluded, TraceCounts* counts = nullptr) const;
+
+		uint32_t NumNodes() const { return numNodes; }
+		uint32_t NumPackets() const { return numPackets; }
+		uint32_t NumTris() const { return numTris; }
+
+	private:
+		// Depth-first, as the source tree; branches' left children follow them, leaves list [numPackets] leaf packets from [rightOrFirstPacket]
+		struct Node
+		{
+			float bmin[3];
+			uint32_t rightOrFirstPacket;
+			float bmax[3];
+			uint32_t numPackets;
+		};
+
+		// One leaf packet's triangles, and which source triangle each lane holds
+		struct LeafPacket
+		{
+			TrianglePacket<8> tris;
+			uint32_t triNdces[8];
+		};
+
+		template<bool anyHit>
+		bool TraceRay(const Ray& ray, Hit* outHit, TraceCounts* counts) const;
+
+		// Ordered single-ray traversal below [rootNdx] (whose box the ray is known to hit), shrinking [tMax] to the nearest hit so far
+		template<bool anyHit>
+		bool TraceSubtree(uint32_t rootNdx, const RayPrecomp& rp, float tMin, float& tMax, bool& found, Hit* outHit, TraceCounts* counts) const;
+
+		template<bool anyHit>
+		uint64_t TracePacket(const Ray* rays, uint32_t numRays, Hit* outHits, TraceCounts* counts) const;
+
+		template<bool anyHit>
+		uint32_t TraceStream(const Ray* rays, const uint32_t* order, uint32_t numRays, Hit* outHits, bool* outOccluded, TraceCounts* counts) const;
+
+		CPUMemory::ArrayAllocHandle<Node> nodes;
+		CPUMemory::ArrayAllocHandle<LeafPacket> packets;
+		uint32_t numNodes = 0;
+		uint32_t numPackets = 0;
+		uint32_t numTris = 0;
+};
@@ -9,6 +9,7 @@
 #include "..\Shaders\SharedPRNG_Code.h"
 
 #include "RenderDebug.h"
+#include "TileScheduler.h"
 
 #include <cassert>
 #include <algorithm>
@@ -113,17 +114,20 @@ void GPU_PRNG_SeedAndJump(GPU_PRNG_Channel* channel, const GPU_PRNG_Channel seed
 	*channel = u;
 }
 
-void PRNGThreadInterface(uint32_t screenWidth, CPUMemory::ArrayAllocHandle<GPU_PRNG_Channel> prngState, uint32_t screenRowNdx, uint32_t screenHeight)
+void PRNGTileInterface(const TileScheduler::Tile& tile, uint32_t screenWidth, CPUMemory::ArrayAllocHandle<GPU_PRNG_Channel> prngState)
 {
-	for (uint32_t j = 0; j < screenWidth; j++)
+	for (uint32_t y = tile.y0; y < tile.y1; y++)
 	{
-		std::ranlux48 rngSeeder;
+		for (uint32_t x = tile.x0; x < tile.x1; x++)
+		{
+			std::ranlux48 rngSeeder;
 
-		const uint64_t currTime = std::chrono::steady_clock::now().time_since_epoch().count();
-		rngSeeder.seed(currTime);
+			const uint64_t currTime = std::chrono::steady_clock::now().time_since_epoch().count();
+			rngSeeder.seed(currTime);
 
-		const GPU_PRNG_Channel prngSeed = GetGPU_PRNG_Seed(rngSeeder());
-		GPU_PRNG_SeedAndJump(&prngState[j + screenRowNdx * screenHeight], prngSeed, 16);
+			const GPU_PRNG_Channel prngSeed = GetGPU_PRNG_Seed(rngSeeder());
+			GPU_PRNG_SeedAndJump(&prngState[x + y * screenWidth], prngSeed, 16);
+		}
 	}
 }
 
@@ -144,7 +148,7 @@ void UpdateComputeConstants(CPUMemory::SingleAllocHandle<Render::FrameConstants>
 // Roughness data (in texture) - sample as normal (so we get GPU interpolation), but constrain UVs to just inside each atlas entry to prevent bleeding (so (width-1, height-1))
 // Roughness processing might be somewhat easier with manual texel loading & blending, unsure
 
-void Render::Init(HWND hwnd, RENDER_MODE mode, XPlatUtils::BakedGeoBuffers& sceneGeo, XPlatUtils::BakedGeoBuffers& viewGeo, CPUMemory::ArrayAllocHandle<Material> sceneMaterials, uint32_t sceneMaterialCount, CPUMemory::SingleAllocHandle<FrameConstants> frameConstants)
+void Render::Init(HWND hwnd, RENDER_MODE mode, XPlatUtils::BakedGeoBuffers& sceneGeo, XPlatUtils::BakedGeoBuffers& viewGeo, const SceneBuffers& sceneMirror, CPUMemory::SingleAllocHandle<FrameConstants> frameConstants)
 {
 	// Store the active render mode
 	currMode = mode;
@@ -187,17 +191,8 @@ void Render::Init(HWND hwnd, RENDER_MODE mode, XPlatUtils::BakedGeoBuffers& scen
 
 	UpdateComputeConstants(frameConstants);
 
-	// Current packing algorithm sits on the x-axis
-	// Should drive runtime atlas dimensions from calculations here
-	computeConstants->screenAndLensOptions.materialAtlasDims = float4(0.0f, sceneMaterials[0].spectralTexY, 0.0f, sceneMaterials[0].roughnessTexY);
-	for (uint32_t i = 0; i < sceneMaterialCount; i++)
-	{
-		computeConstants->screenAndLensOptions.materialAtlasDims.x += sceneMaterials[0].spectralTexX;
-		computeConstants->screenAndLensOptions.materialAtlasDims.y = std::max(computeConstants->screenAndLensOptions.materialAtlasDims.y, static_cast<float>(sceneMaterials[i].spectralTexY));
-
-		computeConstants->screenAndLensOptions.materialAtlasDims.z += sceneMaterials[0].roughnessTexX;
-		computeConstants->screenAndLensOptions.materialAtlasDims.w = std::max(computeConstants->screenAndLensOptions.materialAtlasDims.w, static_cast<float>(sceneMaterials[i].roughnessTexY));
-	}
+	// Atlas dimensions come from the scene's material mirror (see SceneBuffers), which packs textured materials along x
+	computeConstants->screenAndLensOptions.materialAtlasDims = sceneMirror.MaterialAtlasDims();
 
 	computeCBufDesc.initForCBuffer<ComputeTypes::ComputeConstants>(L"computeConstants", computeConstants);
 	computeCBufHandle = compute_frame.pipes[0].RegisterCBuffer(computeCBufDesc, GENERIC_RESRC_ACCESS_DIRECT_READS);
@@ -208,177 +203,47 @@ void Render::Init(HWND hwnd, RENDER_MODE mode, XPlatUtils::BakedGeoBuffers& scen
 	structuredVbufferDesc.initForStructBuffer(sceneGeo.vbufferDesc.dimensions[0], sceneGeo.vbufferDesc.stride, L"structuredVbuffer", sceneGeo.vbufferDesc.srcData);
 	auto structuredVbuffer = compute_frame.pipes[0].RegisterStructBuffer(structuredVbufferDesc, GENERIC_RESRC_ACCESS_DIRECT_WRITES | GENERIC_RESRC_ACCESS_DIRECT_READS);
 
-	const uint32_t numTris = sceneGeo.ibufferDesc.dimensions[0] / 3;
+	const uint32_t numTris = static_cast<uint32_t>(sceneMirror.NumTris());
 	GPUResource<ResourceViews::STRUCTBUFFER_RW>::resrc_desc structuredTribufferDesc;
-
-	uint64_t* sourceNdces = reinterpret_cast<uint64_t*>(&sceneGeo.ibufferDesc.srcData[0]);
-	auto tribufferMemory = CPUMemory::AllocateArray<IndexedTriangle>(numTris);
-	for (uint32_t i = 0; i < numTris; i++)
-	{
-		const uint32_t indexProvoking = i * 3;
-		tribufferMemory[i].xyz.x = sourceNdces[indexProvoking];
-		tribufferMemory[i].xyz.y = sourceNdces[indexProvoking + 1];
-		tribufferMemory[i].xyz.z = sourceNdces[indexProvoking + 2];
-		tribufferMemory[i].xyz.w = 0;
-	}
-
-	structuredTribufferDesc.initForStructBuffer(numTris, sizeof(IndexedTriangle), L"structuredTribuffer", tribufferMemory.GetBytesHandle());
+	structuredTribufferDesc.initForStructBuffer(numTris, sizeof(IndexedTriangle), L"structuredTribuffer", sceneMirror.BufferContents(SceneBuffers::TRIBUFFER));
 	auto tribufferHandle = compute_frame.pipes[0].RegisterStructBuffer(structuredTribufferDesc, GENERIC_RESRC_ACCESS_DIRECT_READS | GENERIC_RESRC_ACCESS_DIRECT_WRITES);
 
-	// AS write-out (16M cells, at most two children each)
+	// Compute AS over the scene's triangles, built CPU-side (see BVH.h/SparseOctree.h); nodes + triangle lists are uploaded as-is
+	const GeoTypes::Vertex3D* sceneVerts = reinterpret_cast<const GeoTypes::Vertex3D*>(&sceneMirror.BufferContents(SceneBuffers::VBUFFER)[0]);
+	const IndexedTriangle* sceneTris = reinterpret_cast<const IndexedTriangle*>(&sceneMirror.BufferContents(SceneBuffers::TRIBUFFER)[0]);
 	GPUResource<ResourceViews::STRUCTBUFFER_RW>::resrc_desc as_Desc;
-
-	constexpr uint64_t maxOctreeRank = 6;
-	constexpr auto computeNumOctreeNodes = []()
-	{
-		uint32_t numOctreeNodes = 1;
-		for (uint32_t i = 0; i < maxOctreeRank; i++)
-		{
-			uint32_t rankLen = 1;
-			for (uint32_t k = 0; k <= i; k++)
-			{
-				rankLen *= 8;
-			}
-			numOctreeNodes += rankLen; // We need storage per-rank, not just for leaf nodes (the ones with rank size 8^maxOctreeRank)
-		}
-		return numOctreeNodes;
-	};
-	constexpr uint64_t numOctreeNodes = computeNumOctreeNodes(); // Up to eight children per node, supporting more than 1M triangles feels unnecessary
-	CPUMemory::ArrayAllocHandle<ComputeAS_Node> octreeAS = CPUMemory::AllocateArray<ComputeAS_Node>(numOctreeNodes);
-
-	// Octree layout like
-	// [0] (first rank)
-	// [1...8] (second rank)
-	// [9...72] (third rank)
-	// [..etc..]
-
-	const float sceneHeight = static_cast<uint32_t>(frameConstants->sceneBoundsMax.y - frameConstants->sceneBoundsMin.y);
-	const float sceneWidth = static_cast<uint32_t>(frameConstants->sceneBoundsMax.x - frameConstants->sceneBoundsMin.x);
-	const float sceneDepth = static_cast<uint32_t>(frameConstants->sceneBoundsMax.z - frameConstants->sceneBoundsMin.z);
-
-#ifdef DEBUG
-	const float sceneMinX = frameConstants->sceneBoundsMin.x;
-	const float sceneMinY = frameConstants->sceneBoundsMin.y;
-	const float sceneMinZ = frameConstants->sceneBoundsMin.z;
-
-	const float sceneMaxX = frameConstants->sceneBoundsMax.x;
-	const float sceneMaxY = frameConstants->sceneBoundsMax.y;
-	const float sceneMaxZ = frameConstants->sceneBoundsMax.z;
+	GPUResource<ResourceViews::STRUCTBUFFER_RW>::resrc_desc asTriList_Desc;
+#if COMPUTE_AS_BVH
+	BVH::BinnedSAHSettings bvhSettings;
+	bvhSettings.spatialSplits = COMPUTE_AS_SPATIAL_SPLITS;
+	sceneBVH.BuildBinnedSAH(&sceneVerts[0].pos, sceneMirror.NumVerts(), sizeof(GeoTypes::Vertex3D), sceneTris, numTris, bvhSettings);
+#if COMPUTE_AS_STACKLESS
+	sceneSkipBVH.Build(sceneBVH, &sceneVerts[0].pos, sceneMirror.NumVerts(), sizeof(GeoTypes::Vertex3D), sceneTris);
+	as_Desc.initForStructBuffer<ComputeBVH_SkipNode>(sceneSkipBVH.NumNodes(), L"bvhAS", sceneSkipBVH.Nodes());
+	asTriList_Desc.initForStructBuffer<uint32_t>(std::max(sceneSkipBVH.TriListLen(), 1u), L"bvhTriList", sceneSkipBVH.TriList());
+#else
+	as_Desc.initForStructBuffer<ComputeBVH_Node>(sceneBVH.NumNodes(), L"bvhAS", sceneBVH.Nodes());
+	asTriList_Desc.initForStructBuffer<uint32_t>(std::max(sceneBVH.TriListLen(), 1u), L"bvhTriList", sceneBVH.TriList());
 #endif
-
-	float cellWidth = sceneWidth;
-	float cellHeight = sceneHeight;
-	float cellDepth = sceneDepth;
-
-	// Octree is contained by a 1x1x1 supercell
-	uint32_t rankWidthCells = 1;
-	uint32_t rankHeightCells = 1;
-	uint32_t rankDepthCells = 1;
-
-	uint32_t childOffset = 1;
-	uint32_t octreeRankCtr = 0;
-	uint32_t rankSize = 1;
-
-	uint32_t octreeRankCellNdx = 0;
-
-	for (uint32_t i = 0; i < numOctreeNodes; i++)
-	{
-		if (octreeRankCtr < maxOctreeRank)
-		{
-			for (uint32_t j = 0; j < 8; j++)
-			{
-				octreeAS[i].children[j] = j + childOffset;
-				octreeAS[i].isBranchNode = TRUE;
-			}
-
-			octreeAS[i].numChildren = 8;
-		}
-		else
-		{
-			// Zero-initialize leaves (triangle children)
-			for (uint32_t j = 0; j < 8; j++)
-			{
-				octreeAS[i].children[j] = 0;
-			}
-			octreeAS[i].numChildren = 0;
-		}
-
-		octreeAS[i].bounds[0].x = static_cast<float>(octreeRankCellNdx % rankWidthCells) * cellWidth; // Count x up to width, then reset
-		octreeAS[i].bounds[0].y = static_cast<float>((octreeRankCellNdx / rankWidthCells) % rankHeightCells) * cellHeight; // Step y every width, and reset every height (new slice/plane)
-		octreeAS[i].bounds[0].z = static_cast<float>(octreeRankCellNdx / (rankWidthCells * rankHeightCells)) * cellDepth; // Step every width * height (every slice/plane)
-
-		octreeAS[i].bounds[0].x += frameConstants->sceneBoundsMin.x;
-		octreeAS[i].bounds[0].y += frameConstants->sceneBoundsMin.y;
-		octreeAS[i].bounds[0].z += frameConstants->sceneBoundsMin.z;
-
-		octreeAS[i].bounds[1].x = octreeAS[i].bounds[0].x + cellWidth;
-		octreeAS[i].bounds[1].y = octreeAS[i].bounds[0].y + cellHeight;
-		octreeAS[i].bounds[1].z = octreeAS[i].bounds[0].z + cellDepth;
-
-#ifdef DEBUG
-		if (octreeAS[i].bounds[1].x > sceneMaxX || octreeAS[i].bounds[1].y > sceneMaxY || octreeAS[i].bounds[1].z > sceneMaxZ)
-		{
-			const float cellMinX = octreeAS[i].bounds[0].x;
-			const float cellMinY = octreeAS[i].bounds[0].y;
-			const float cellMinZ = octreeAS[i].bounds[0].z;
-
-			const float cellMaxX = octreeAS[i].bounds[1].x;
-			const float cellMaxY = octreeAS[i].bounds[1].y;
-			const float cellMaxZ = octreeAS[i].bounds[1].z;
-
-			__debugbreak();
-		}
+#else
+	sceneAS.Build(&sceneVerts[0].pos, sceneMirror.NumVerts(), sizeof(GeoTypes::Vertex3D), sceneTris, numTris, SparseOctree::Settings());
+	as_Desc.initForStructBuffer<ComputeAS_Node>(sceneAS.NumNodes(), L"octreeAS", sceneAS.Nodes());
+	asTriList_Desc.initForStructBuffer<uint32_t>(static_cast<uint32_t>(sceneAS.TriListLen()), L"octreeTriList", sceneAS.TriList());
 #endif
-
-		octreeRankCellNdx++;
-		if (octreeRankCtr <= maxOctreeRank)
-		{
-			if (octreeRankCellNdx == rankSize)
-			{
-				octreeRankCellNdx = 0;
-				octreeRankCtr++;
-				rankSize *= 8;
-				childOffset += rankSize < 8 ? rankSize : 8;
-
-				cellWidth /= 2.0f;
-				cellHeight /= 2.0f;
-				cellDepth /= 2.0f;
-
-				rankWidthCells *= 2;
-				rankHeightCells *= 2;
-				rankDepthCells *= 2;
-			}
-			else
-			{
-				childOffset += 8;
-			}
-		}
-		else
-		{
-			childOffset += 8;
-		}
-	}
-
-	as_Desc.initForStructBuffer<ComputeAS_Node>(numOctreeNodes, L"octreeAS", octreeAS);
-	auto customAS = compute_frame.pipes[0].RegisterStructBuffer(as_Desc, GENERIC_RESRC_ACCESS_DIRECT_WRITES);
+	auto customAS = compute_frame.pipes[0].RegisterStructBuffer(as_Desc, GENERIC_RESRC_ACCESS_DIRECT_READS | GENERIC_RESRC_ACCESS_DIRECT_WRITES);
+	auto customASTriList = compute_frame.pipes[0].RegisterStructBuffer(asTriList_Desc, GENERIC_RESRC_ACCESS_DIRECT_READS | GENERIC_RESRC_ACCESS_DIRECT_WRITES);
 
 	// GPU PRNG state (one stream per-pixel/ray-path)
 	CPUMemory::ArrayAllocHandle<GPU_PRNG_Channel> prngState = CPUMemory::AllocateArray<GPU_PRNG_Channel>(screenWidth * screenHeight);
 	
-	const uint32_t groupSize = std::min(64u, std::thread::hardware_concurrency());
-	for (uint32_t i = 0; i < screenHeight; i += groupSize)
+	// Seeded in tiles over the machine's cores; tiles write disjoint pixels, and nothing allocates while they run
+	TileScheduler prngTiles;
+	prngTiles.Init();
+	prngTiles.Run(screenWidth, screenHeight, 64, TileScheduler::TileOrder::Hilbert, [&](const TileScheduler::Tile& tile, uint32_t)
 	{
-		std::thread threads[64] = {};
-		for (uint32_t t = 0; t < groupSize; t++)
-		{
-			threads[t] = std::thread(PRNGThreadInterface, screenWidth, prngState, i + t, screenHeight);
-		}
-		
-		for (uint32_t t = 0; t < groupSize; t++)
-		{
-			threads[t].join();
-		}
-	}
+		PRNGTileInterface(tile, screenWidth, prngState);
+	});
+	prngTiles.DeInit();
 
 	GPUResource<ResourceViews::STRUCTBUFFER_RW>::resrc_desc prng_Desc;
 	prng_Desc.initForStructBuffer<GPU_PRNG_Channel>(screenWidth * screenHeight, L"prngState", prngState);
@@ -387,7 +252,7 @@ void Render::Init(HWND hwnd, RENDER_MODE mode, XPlatUtils::BakedGeoBuffers& scen
 
 	// Shader registration
 	// Move onto this after verifying resource set-up
-	auto csAS_ResolutionHandle = compute_frame.pipes[0].RegisterComputeShader("ComputeAS_Resolve.cso", std::max(numTris / 512, 1u), 1, 1);
+	auto csAS_ResolutionHandle = compute_frame.pipes[0].RegisterComputeShader("ComputeAS_Resolve.cso", 1, 1, 1); // The AS arrives pre-built, so this is a placeholder
 	compute_frame.pipes[0].AppendComputeExec(csAS_ResolutionHandle);
 
 	// Work-submission legwork quietly automates when we call (or JIT if we wait until SubmitCmdList, whichever)
@@ -403,90 +268,28 @@ void Render::Init(HWND hwnd, RENDER_MODE mode, XPlatUtils::BakedGeoBuffers& scen
 	// Load/bind materials
 	//////////////////////
 
-	// Local material type definitions
-	using spectralType = decltype(Material::spectralData)::innerType;
-	using roughnessType = decltype(Material::roughnessData)::innerType;
-
 	// Material resource descriptions
+	// Table/atlas contents are mirrored CPU-side, so later edits can patch them instead of rebuilding from every material
+	const float4 atlasDims = sceneMirror.MaterialAtlasDims();
 	GPUResource<ResourceViews::STRUCTBUFFER_RW>::resrc_desc spectralAtlas = {};
 	GPUResource<ResourceViews::TEXTURE_SUPPORTS_SAMPLING>::resrc_desc roughnessAtlas = {};
 
-	// Set material properties known ahead of time
-	spectralAtlas.stride = sizeof(spectralType);
+	spectralAtlas.initForStructBuffer(static_cast<uint32_t>(atlasDims.x * atlasDims.y), sizeof(MaterialSPD_Piecewise), L"spectralAtlas", sceneMirror.BufferContents(SceneBuffers::SPECTRAL_ATLAS));
+
 	roughnessAtlas.fmt = StandardResrcFmts::FP32_1; // For now
 	roughnessAtlas.msaa.enabled = false;
 	roughnessAtlas.msaa.expectedSamples = 1;
 	roughnessAtlas.msaa.forcedSamples = 1;
 	roughnessAtlas.msaa.qualityTier = 0;
-	roughnessAtlas.stride = sizeof(roughnessType);
-
+	roughnessAtlas.stride = sizeof(float);
+	roughnessAtlas.dimensions[0] = static_cast<uint32_t>(atlasDims.z);
+	roughnessAtlas.dimensions[1] = static_cast<uint32_t>(atlasDims.w);
 	roughnessAtlas.resrcName = L"roughnessAtlas";
-	spectralAtlas.resrcName = L"spectralAtlas";
-
-	// Compute material dimensions
-	spectralAtlas.dimensions[0] = static_cast<uint32_t>(computeConstants->screenAndLensOptions.materialAtlasDims.x * computeConstants->screenAndLensOptions.materialAtlasDims.y);
-	roughnessAtlas.dimensions[0] = static_cast<uint32_t>(computeConstants->screenAndLensOptions.materialAtlasDims.z);
-	roughnessAtlas.dimensions[1] = static_cast<uint32_t>(computeConstants->screenAndLensOptions.materialAtlasDims.w);
-
-	// Material memory allocations
-	const uint32_t spectralAtlasFootprint = spectralAtlas.dimensions[0] * spectralAtlas.stride;
-	const uint32_t roughnessAtlasFootprint = roughnessAtlas.dimensions[0] * roughnessAtlas.dimensions[1] * roughnessAtlas.stride;
-
-	CPUMemory::ArrayAllocHandle<uint8_t> spectralAtlasData = CPUMemory::AllocateArray<uint8_t>(spectralAtlasFootprint);
-	CPUMemory::ArrayAllocHandle<uint8_t> roughnessAtlasData = CPUMemory::AllocateArray<uint8_t>(roughnessAtlasFootprint);
-	CPUMemory::ArrayAllocHandle<MaterialPropertyEntry> materialEntries = CPUMemory::AllocateArray<MaterialPropertyEntry>(sceneMaterialCount);
-
-	// Atlas into allocated memory
-	// Very naive packing, all on X
-	uint16_t atlasX_OffsSpectral = 0;
-	uint16_t atlasX_OffsRoughness = 0;
-	for (uint32_t i = 0; i < sceneMaterialCount; i++)
-	{
-		// Atlas spectral data
-		//////////////////////
-
-		const uint32_t spectralSubresrcWidth = spectralAtlas.stride * sceneMaterials[i].spectralTexX;
-		const uint32_t spectralResrcWidth = spectralAtlas.stride * spectralAtlas.dimensions[0];
-
-		materialEntries[i].spectralWidth = sceneMaterials[i].spectralTexX;
-		materialEntries[i].spectralHeight = sceneMaterials[i].spectralTexY;
-		materialEntries[i].spectralOffsetU = static_cast<float>(atlasX_OffsSpectral) / spectralResrcWidth;
-		materialEntries[i].spectralOffsetV = 0; // For now! May change if we use a different packing algorithm
-
-		uint16_t atlasY_OffsSpectral = 0;
-		for (uint32_t y = 0; y < sceneMaterials[i].spectralTexY; y++)
-		{
-			memcpy(&spectralAtlasData[0] + atlasX_OffsSpectral + atlasY_OffsSpectral, &sceneMaterials[i].spectralData[0], spectralSubresrcWidth);
-			atlasY_OffsSpectral += spectralResrcWidth;
-		}
-		atlasX_OffsSpectral += spectralSubresrcWidth;
-
-		// Atlas roughness data
-		///////////////////////
-
-		const uint32_t roughnessSubresrcWidth = roughnessAtlas.stride * sceneMaterials[i].roughnessTexX;
-		const uint32_t roughnessResrcWidth = roughnessAtlas.stride * roughnessAtlas.dimensions[0];
-
-		materialEntries[i].roughnessWidth = sceneMaterials[i].roughnessTexX;
-		materialEntries[i].roughnessHeight = sceneMaterials[i].roughnessTexY;
-		materialEntries[i].roughnessOffsetU = static_cast<float>(atlasX_OffsRoughness) / roughnessResrcWidth;
-		materialEntries[i].roughnessOffsetV = 0; // For now! May change if we use a different packing algorithm
-
-		uint16_t atlasY_OffsRoughness = 0;
-		for (uint32_t y = 0; y < sceneMaterials[i].roughnessTexY; y++)
-		{
-			memcpy(&roughnessAtlasData[0] + atlasX_OffsRoughness + atlasY_OffsRoughness, &sceneMaterials[i].roughnessData[0] + (roughnessSubresrcWidth * y), roughnessSubresrcWidth);
-			atlasY_OffsRoughness += roughnessResrcWidth;
-		}
-		atlasX_OffsRoughness += roughnessSubresrcWidth;
-	}
-
-	spectralAtlas.srcData = spectralAtlasData;
-	roughnessAtlas.srcData = roughnessAtlasData;
+	roughnessAtlas.srcData = sceneMirror.BufferContents(SceneBuffers::ROUGHNESS_ATLAS);
 
 	// Bind materials & material metadata ^_^
 	GPUResource<ResourceViews::STRUCTBUFFER_RW>::resrc_desc materialTable;
-	materialTable.initForStructBuffer<MaterialPropertyEntry>(sceneMaterialCount, L"materialTable", materialEntries);
+	materialTable.initForStructBuffer(sceneMirror.NumModels(), sizeof(MaterialPropertyEntry), L"materialTable", sceneMirror.BufferContents(SceneBuffers::MATERIAL_TABLE));
 	compute_frame.pipes[1].RegisterStructBuffer(materialTable, GENERIC_RESRC_ACCESS_DIRECT_READS | GENERIC_RESRC_ACCESS_DIRECT_WRITES); // Kind of incredibly cumbersome - should add support for read-only structbuffers (are they new? they feel new)
 	compute_frame.pipes[1].RegisterStructBuffer(spectralAtlas, GENERIC_RESRC_ACCESS_DIRECT_READS | GENERIC_RESRC_ACCESS_DIRECT_WRITES);
 	compute_frame.pipes[1].RegisterTextureSampleable(roughnessAtlas, TEXTURE_ACCESS_DIRECT_READS);
@@ -523,6 +326,7 @@ void Render::Init(HWND hwnd, RENDER_MODE mode, XPlatUtils::BakedGeoBuffers& scen
 	compute_frame.pipes[1].RegisterTextureDirectWrite(sppCounter, GENERIC_RESRC_ACCESS_DIRECT_READS | GENERIC_RESRC_ACCESS_DIRECT_WRITES);
 	compute_frame.pipes[1].RegisterStructBuffer(tribufferHandle);
 	compute_frame.pipes[1].RegisterStructBuffer(customAS);
+	compute_frame.pipes[1].RegisterStructBuffer(customASTriList);
 	compute_frame.pipes[1].RegisterStructBuffer(gpuPRNG);
 
 	auto computeTarget = compute_frame.pipes[1].RegisterTextureDirectWrite(uavTexDesc, GPU_RESRC_ACCESS_PERMISSIONS_TEXTURES::TEXTURE_ACCESS_DIRECT_WRITES | GPU_RESRC_ACCESS_PERMISSIONS_TEXTURES::TEXTURE_ACCESS_DIRECT_READS);
@@ -601,12 +405,7 @@ void Render::Init(HWND hwnd, RENDER_MODE mode, XPlatUtils::BakedGeoBuffers& scen
 	//shader_table_frame.pipes[0].BakeCmdList();
 
 	// Memory clean-up
-	CPUMemory::Free(spectralAtlasData);
-	CPUMemory::Free(roughnessAtlasData);
-	CPUMemory::Free(materialEntries);
 	CPUMemory::Free(prngState);
-	CPUMemory::Free(octreeAS);
-	CPUMemory::Free(tribufferMemory);
 }
 
 void Render::UpdateFrameConstants(CPUMemory::SingleAllocHandle<FrameConstants> frameConstants)
@@ -3,6 +3,10 @@
 #include "..\Pipeline.h"
 #include "..\Shaders\SharedStructs.h"
 #include "Materials.h"
+#include "SceneBuffers.h"
+#include "BVH.h"
+#include "StacklessBVH.h"
+#include "SparseOctree.h"
 
 // Constructs & stores command-lists for compute, hybrid, and fixed-function RT pipelines, then invokes them through DXWrapper::DrawFrame()
 class Render
@@ -29,7 +33,7 @@ class Render
 		};
 
 		// Command-lists generated here
-		void Init(HWND hwnd, RENDER_MODE mode, XPlatUtils::BakedGeoBuffers& sceneGeo, XPlatUtils::BakedGeoBuffers& viewGeo, CPUMemory::ArrayAllocHandle<Material> sceneMaterials, uint32_t sceneMaterialCount, CPUMemory::SingleAllocHandle<FrameConstants> frameConstants);
+		void Init(HWND hwnd, RENDER_MODE mode, XPlatUtils::BakedGeoBuffers& sceneGeo, XPlatUtils::BakedGeoBuffers& viewGeo, const SceneBuffers& sceneMirror, CPUMemory::SingleAllocHandle<FrameConstants> frameConstants);
 
 		// Update constant buffer data (e.g. time, film SPD, camera transforms...)
 		void UpdateFrameConstants(CPUMemory::SingleAllocHandle<FrameConstants> frameConstants);
@@ -54,5 +58,11 @@ class Render
 		Frame<3> compute_frame; // AS generation, ubershader, presentation
 		Frame<3> hybrid_frame; // Primary rays, ubershader, presentation
 		Frame<2> shader_table_frame; // Ray/path dispatch, presentation
+
+		// CPU-built acceleration structure for the compute pipeline (kept alive alongside the frames that upload it); COMPUTE_AS_BVH picks
+		// which one, and COMPUTE_AS_STACKLESS uploads the BVH's skip-linked form
+		BVH sceneBVH;
+		StacklessBVH sceneSkipBVH;
+		SparseOctree sceneAS;
 };
 
@@ -53,20 +53,32 @@ int APIENTRY wWinMain(_In_ HINSTANCE hInstance,
     // In the very long term (>1 year) I would like to use this project as a sandbox for technical rendering concepts (ofc eventually including BDPT, if I ever figure it out, but probably volumetrics and layered materials first)
 
     // Scene/geo setup, render init
+    const auto startupTimer = std::chrono::steady_clock::now(); // Load + setup costs grow with scene size, so keep an eye on them
+
     transform modelTransform = {}; // Quite awkward - eventually we want to push these model input stuffs entirely into scene files
     modelTransform.rotation = float4(0, 0, 0, 1); // Identity quaternion
     modelTransform.translationAndScale = float4(0, 0, 0, 1); // Test model sits at the origin, unit scale
 
     CPUMemory::ArrayAllocHandle<Scene::Model> testModels = CPUMemory::AllocateArray<Scene::Model>(MAX_SUPPORTED_OBJ_TRANSFORMS);
+
+//#define STARTUP_TEST_SCENE // Fifty cows in a 10x5 grid, for measuring load/setup times on busier scenes
+#ifdef STARTUP_TEST_SCENE
+    constexpr uint32_t numTestModels = 50;
+    for (uint32_t i = 0; i < numTestModels; i++)
+    {
+        transform gridTransform = modelTransform;
+        gridTransform.translationAndScale.x = static_cast<float>(i % 10) * 2.0f;
+        gridTransform.translationAndScale.z = static_cast<float>(i / 10) * 2.0f;
+        testModels[i] = { "../Tests/Models/spot.obj", SCENE_MODEL_FORMATS::OBJ, gridTransform };
+    }
+#else
+    constexpr uint32_t numTestModels = 1;
     testModels[0] = { "../Tests/Models/stanford-bunny.obj", SCENE_MODEL_FORMATS::OBJ, modelTransform }; // Implement loading for scenes/scene definitions eventually
+#endif
 
-    Scene testScene(testModels, 1);
+    Scene testScene(testModels, numTestModels);
     Geo::Init(1, &testScene);
 
-    uint32_t numMaterials = 0;
-    CPUMemory::ArrayAllocHandle<Material> sceneMaterials = {};
-    Geo::SceneMaterialList(sceneMaterials, &numMaterials, 0);
-
     CPUMemory::SingleAllocHandle<Render::FrameConstants> frameConstants = CPUMemory::AllocateSingle<Render::FrameConstants>();
 
     frameConstants->screenWidth = ui::window_width;
@@ -85,7 +97,7 @@ int APIENTRY wWinMain(_In_ HINSTANCE hInstance,
 
     for (uint32_t i = 0; i < testScene.numModels; i++)
     {
-        frameConstants->sceneTransforms[i] = testScene.models[i].transformations;
+        frameConstants->sceneTransforms[i] = testScene.graph.GetWorldTransform(i); // Models are the first [numModels] nodes in the scene graph
     }
 
     frameConstants->sceneBoundsMin = testScene.sceneBoundsMin;
@@ -94,7 +106,12 @@ int APIENTRY wWinMain(_In_ HINSTANCE hInstance,
     frameConstants->numTransforms = testScene.numModels;
 
     CPUMemory::SingleAllocHandle<Render> rndr = CPUMemory::AllocateSingle<Render>();
-    rndr->Init(hwnd, Render::RENDER_MODE::MODE_COMPUTE, Geo::SceneGeo(0), Geo::ViewGeo(), sceneMaterials, numMaterials, frameConstants); // Default to compute mode - simplest CPU side setup, likely easiest to test
+    rndr->Init(hwnd, Render::RENDER_MODE::MODE_COMPUTE, Geo::SceneGeo(0), Geo::ViewGeo(), Geo::SceneMirror(0), frameConstants); // Default to compute mode - simplest CPU side setup, likely easiest to test
+
+    char startupTimingPrintable[128] = {};
+    const double startupMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startupTimer).count();
+    sprintf_s(startupTimingPrintable, "startup (%u models, scene load + render setup) took %.2fms\n", testScene.numModels, startupMs);
+    OutputDebugStringA(startupTimingPrintable);
 
     HACCEL hAccelTable = LoadAccelerators(hInstance, MAKEINTRESOURCE(IDC_DXRSANDBOX));
 
@@ -1,31 +1,113 @@
-#include "Scene.h"`
-#include "..\CPUMemory.h"
-#include "..\Shaders\filmSPD.h"
-#include "..\Shaders\SharedStructs.h"
-#include "..\Shaders\materials.h"
+#include "Scene.h"
+#include "../CPUMemory.h"
+#include "../Shaders/filmSPD.h"
+#include "../Shaders/SharedStructs.h"
+#include "../Shaders/materials.h"
 
 #include <fstream>
 #include <filesystem>
+#include <cstring>
 
-Scene::Scene(CPUMemory::ArrayAllocHandle<Model> _models, uint32_t _numModels) : models(_models), numModels(_numModels)
+// Models are flat (every model is a root node) for now, but meshes are instanced - every model with the same path shares a mesh
+// Mesh bounds are a placeholder unit cube (models cover their centroid +/- [scale] on each axis) until Geo::Init fits them to loaded geometry
+static uint32_t ModelMesh(SceneGraph& graph, CPUMemory::ArrayAllocHandle<Scene::Model> models, uint32_t modelNdx)
 {
-	memset(&sceneBoundsMin, 0xff, sizeof(float4)); // If we initialize to a small value, some values will never be low enough
-	memset(&sceneBoundsMax, 0, sizeof(float4));
+	for (uint32_t j = 0; j < modelNdx; j++)
+	{
+		if (strcmp(models[modelNdx].path, models[j].path) == 0)
+		{
+			return graph.NodeMesh(j);
+		}
+	}
 
-	assert(_numModels < MAX_SUPPORTED_OBJ_TRANSFORMS);
-	for (uint32_t i = 0; i < _numModels; i++)
+	return graph.AddMesh(float4(-1.0f, -1.0f, -1.0f, 0.0f), float4(1.0f, 1.0f, 1.0f, 0.0f));
+}
+
+// Graph storage covers the whole model array (not just the models in use), so models can be added without rebuilding it
+static void BuildSceneGraph(SceneGraph& graph, CPUMemory::ArrayAllocHandle<Scene::Model> models, uint32_t numModels)
+{
+	const uint32_t capacity = std::max(static_cast<uint32_t>(models.arrayLen), numModels);
+	graph.Init(capacity, capacity);
+	for (uint32_t i = 0; i < numModels; i++)
 	{
-		// DOD users weep at this code
-		// (when I need to handle thousands of concurrent transform updates I'll fix it)
-		// Model translations are centroids, so we should add +/- [scale] on each axis
-		sceneBoundsMin.x = std::min(models[i].transformations.translationAndScale.x, sceneBoundsMin.x) - models[i].transformations.translationAndScale.w;
-		sceneBoundsMin.y = std::min(models[i].transformations.translationAndScale.y, sceneBoundsMin.y) - models[i].transformations.translationAndScale.w;
-		sceneBoundsMin.z = std::min(models[i].transformations.translationAndScale.z, sceneBoundsMin.z) - models[i].transformations.translationAndScale.w;
-
-		sceneBoundsMax.x = std::max(models[i].transformations.translationAndScale.x, sceneBoundsMax.x) + models[i].transformations.translationAndScale.w;
-		sceneBoundsMax.y = std::max(models[i].transformations.translationAndScale.y, sceneBoundsMax.y) + models[i].transformations.translationAndScale.w;
-		sceneBoundsMax.z = std::max(models[i].transformations.translationAndScale.z, sceneBoundsMax.z) + models[i].transformations.translationAndScale.w;
+		graph.AddNode(SceneGraph::invalidNdx, models[i].transformations, ModelMesh(graph, models, i));
 	}
+}
+
+void Scene::BuildGraph()
+{
+	if (graph.Initialized())
+	{
+		graph.DeInit();
+	}
+
+	BuildSceneGraph(graph, models, numModels);
+	UpdateTransforms();
+}
+
+uint32_t Scene::AddModel(Model model)
+{
+	assert(numModels + 1 < MAX_SUPPORTED_OBJ_TRANSFORMS);
+
+	// Grow into a new model array if we're out of space; arrays passed in stay with whoever allocated them, and arrays we allocated are
+	// freed as they're replaced
+	if (numModels == models.arrayLen)
+	{
+		auto grownModels = CPUMemory::AllocateArray<Model>(std::min(std::max(numModels * 2, 8u), static_cast<uint32_t>(MAX_SUPPORTED_OBJ_TRANSFORMS)));
+		memcpy(&grownModels[0], &models[0], numModels * sizeof(Model));
+		if (ownsModels)
+		{
+			CPUMemory::Free(models);
+		}
+		models = grownModels;
+		ownsModels = true;
+	}
+
+	const uint32_t modelNdx = numModels;
+	models[modelNdx] = model;
+	numModels++;
+
+	// The graph only needs rebuilding once the model array has outgrown it, or removals have left it without spare mesh slots
+	if (graph.NumNodes() == graph.MaxNodes() || graph.NumMeshes() == graph.MaxMeshes())
+	{
+		BuildGraph();
+	}
+	else
+	{
+		graph.AddNode(SceneGraph::invalidNdx, model.transformations, ModelMesh(graph, models, modelNdx));
+		UpdateTransforms();
+	}
+	return modelNdx;
+}
+
+void Scene::RemoveModel(uint32_t modelNdx)
+{
+	assert(modelNdx < numModels);
+	memmove(&models[modelNdx], &models[modelNdx + 1], (numModels - modelNdx - 1) * sizeof(Model));
+	numModels--;
+
+	graph.RemoveNode(modelNdx); // Models are root nodes, so nothing hangs off them
+	UpdateTransforms();
+}
+
+void Scene::MoveModel(uint32_t modelNdx, transform modelTransform)
+{
+	assert(modelNdx < numModels);
+	models[modelNdx].transformations = modelTransform;
+	graph.SetLocalTransform(modelNdx, modelTransform); // Models are root nodes, so local == world
+	UpdateTransforms();
+}
+
+void Scene::UpdateTransforms()
+{
+	graph.Update();
+	graph.GetSceneBounds(&sceneBoundsMin, &sceneBoundsMax);
+}
+
+Scene::Scene(CPUMemory::ArrayAllocHandle<Model> _models, uint32_t _numModels) : models(_models), numModels(_numModels)
+{
+	assert(_numModels < MAX_SUPPORTED_OBJ_TRANSFORMS);
+	BuildGraph();
 
 	cameraPosition = float4(0, 0, 0, 1);
 	cameraRotation = float4(0, 0, 0, 1); // (sin(0) * v, cos(0))
@@ -65,8 +147,6 @@ struct DXRSS_Header
 	FilmSPD_Piecewise filmCMF;
 };
 
-CPUMemory::ArrayAllocHandle<Scene::Model> modelData = {};
-
 Scene::Scene(const char* path)
 {
 	std::fstream scene(path);
@@ -88,9 +168,10 @@ Scene::Scene(const char* path)
 	assert(numModels < MAX_SUPPORTED_OBJ_TRANSFORMS);
 
 	// Load models
-	modelData = CPUMemory::AllocateArray<Model>(numModels);
-	scene.read(reinterpret_cast<char*>(&modelData.GetBytesHandle()[0]), numModels * sizeof(Model));
-	models = modelData;
+	models = CPUMemory::AllocateArray<Model>(numModels);
+	ownsModels = true;
+	scene.read(reinterpret_cast<char*>(&models.GetBytesHandle()[0]), numModels * sizeof(Model));
+	BuildGraph(); // Recomputes bounds from the loaded models
 
 	// Release memory
 	CPUMemory::Free(header);
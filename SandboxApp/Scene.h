@@ -1,9 +1,10 @@
 #pragma once
 
 #include <stdint.h>
-#include "..\CPUMemory.h"
-#include "..\Math.h"
-#include "..\Shaders\filmSPD.h"
+#include "../CPUMemory.h"
+#include "../Math.h"
+#include "../Shaders/filmSPD.h"
+#include "SceneGraph.h"
 
 enum SCENE_MODEL_FORMATS
 {
@@ -27,8 +28,26 @@ struct Scene
 	Scene(const char* path);
 	void EncodeScene(const char* path);
 
+	// Resolve world transforms/bounds after moving models around, and refresh [sceneBoundsMin]/[sceneBoundsMax]
+	void UpdateTransforms();
+
+	// (Re)build [graph] from [models]
+	void BuildGraph();
+
+	// Model edits; additions/removals add/remove one node in [graph] (it's only rebuilt after the model array grows), and moves only
+	// re-resolve transforms
+	// Geometry/material changes for edited models are handled by Geo (see Geo::AddModel etc.)
+	uint32_t AddModel(Model model);
+	void RemoveModel(uint32_t modelNdx);
+	void MoveModel(uint32_t modelNdx, transform modelTransform);
+
 	CPUMemory::ArrayAllocHandle<Model> models = {};
 	uint32_t numModels = {};
+	bool ownsModels = false; // Set once [models] was allocated here (by loading a scene, or growing the array), so it's ours to free
+
+	// Transform hierarchy + instancing for [models]; model [i] is node [i] in the graph, and models sharing a path share a mesh
+	SceneGraph graph;
+
 	float4 sceneBoundsMin, sceneBoundsMax, cameraPosition, cameraRotation;
 	float vfov, focalDepth, aberration;
 	uint16_t spp;
@@ -0,0 +1,441 @@
+#include "SceneBuffers.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+
+void SceneBuffers::Init(uint64_t _maxVerts, uint64_t _maxTris, uint32_t _maxModels)
+{
+	maxVerts = _maxVerts;
+	maxTris = _maxTris;
+	maxModels = _maxModels;
+
+	numVerts = 0;
+	numTris = 0;
+	numModels = 0;
+
+	vbuffer = CPUMemory::AllocateArray<GeoTypes::Vertex3D>(maxVerts);
+	tribuffer = CPUMemory::AllocateArray<IndexedTriangle>(maxTris);
+	materialTable = CPUMemory::AllocateArray<MaterialPropertyEntry>(maxModels);
+	materials = CPUMemory::AllocateArray<Material>(maxModels);
+	modelRanges = CPUMemory::AllocateArray<ModelRange>(maxModels);
+	spectralAtlasX = CPUMemory::AllocateArray<uint32_t>(maxModels);
+	roughnessAtlasX = CPUMemory::AllocateArray<uint32_t>(maxModels);
+	atlasFootprints = CPUMemory::AllocateArray<uint64_t>(maxModels);
+	numAtlasFootprints = 0;
+
+	// Unused space stays zeroed, so bytes past the end of each buffer never depend on edit history
+	CPUMemory::ZeroData(vbuffer);
+	CPUMemory::ZeroData(tribuffer);
+	CPUMemory::ZeroData(materialTable);
+
+	// Scenes made up entirely of uniform materials still need (tiny) atlases to bind against
+	spectralAtlasWidth = spectralAtlasHeight = 1;
+	roughnessAtlasWidth = roughnessAtlasHeight = 1;
+	spectralAtlas = CPUMemory::AllocateArray<MaterialSPD_Piecewise>(1);
+	roughnessAtlas = CPUMemory::AllocateArray<float>(1);
+	CPUMemory::ZeroData(spectralAtlas);
+	CPUMemory::ZeroData(roughnessAtlas);
+
+	ClearPatches();
+}
+
+void SceneBuffers::DeInit()
+{
+	CPUMemory::Free(roughnessAtlas);
+	CPUMemory::Free(spectralAtlas);
+	CPUMemory::Free(atlasFootprints);
+	CPUMemory::Free(roughnessAtlasX);
+	CPUMemory::Free(spectralAtlasX);
+	CPUMemory::Free(modelRanges);
+	CPUMemory::Free(materials);
+	CPUMemory::Free(materialTable);
+	CPUMemory::Free(tribuffer);
+	CPUMemory::Free(vbuffer);
+
+	numVerts = 0;
+	numTris = 0;
+	numModels = 0;
+}
+
+CPUMemory::ArrayAllocHandle<GeoTypes::Vertex3D> SceneBuffers::FreeVertices()
+{
+	auto freeVts = vbuffer + numVerts;
+	freeVts.arrayLen = maxVerts - numVerts;
+	return freeVts;
+}
+
+uint32_t SceneBuffers::AddModel(uint64_t numModelVts, const uint64_t* ndces, uint64_t numNdces, const Material& material)
+{
+	assert(numModels < maxModels);
+	assert(numVerts + numModelVts <= maxVerts);
+	assert(numTris + (numNdces / 3) <= maxTris);
+
+	const uint32_t modelNdx = numModels;
+	ModelRange& range = modelRanges[modelNdx];
+	range.firstVert = numVerts;
+	range.numVerts = numModelVts;
+	range.firstTri = numTris;
+	range.numTris = numNdces / 3;
+
+	// Vertices are already in place (see [FreeVertices]); just stamp their material IDs
+	GeoTypes::Vertex3D* vts = &vbuffer[0];
+	for (uint64_t i = range.firstVert; i < range.firstVert + range.numVerts; i++)
+	{
+		vts[i].mat.z = static_cast<float>(modelNdx);
+	}
+
+	IndexedTriangle* tris = &tribuffer[0];
+	for (uint64_t i = 0; i < range.numTris; i++)
+	{
+		assert(ndces[i * 3] >= numVerts && ndces[i * 3] < numVerts + numModelVts);
+		assert(ndces[i * 3 + 1] >= numVerts && ndces[i * 3 + 1] < numVerts + numModelVts);
+		assert(ndces[i * 3 + 2] >= numVerts && ndces[i * 3 + 2] < numVerts + numModelVts);
+
+		IndexedTriangle& tri = tris[range.firstTri + i];
+		tri.xyz.x = static_cast<uint32_t>(ndces[i * 3]);
+		tri.xyz.y = static_cast<uint32_t>(ndces[i * 3 + 1]);
+		tri.xyz.z = static_cast<uint32_t>(ndces[i * 3 + 2]);
+		tri.xyz.w = 0;
+	}
+
+	MarkDirty(VBUFFER, range.firstVert * sizeof(GeoTypes::Vertex3D), range.numVerts * sizeof(GeoTypes::Vertex3D));
+	MarkDirty(TRIBUFFER, range.firstTri * sizeof(IndexedTriangle), range.numTris * sizeof(IndexedTriangle));
+
+	numModels++;
+	numVerts += range.numVerts;
+	numTris += range.numTris;
+
+	materials[modelNdx] = material;
+	if (LayoutAtlases(false))
+	{
+		for (uint32_t i = 0; i < numModels; i++)
+		{
+			ResolveMaterialEntry(i);
+		}
+	}
+	else
+	{
+		ResolveMaterialEntry(modelNdx);
+	}
+
+	return modelNdx;
+}
+
+void SceneBuffers::RemoveModel(uint32_t modelNdx)
+{
+	assert(modelNdx < numModels);
+	const ModelRange removed = modelRanges[modelNdx];
+
+	// Close the gap in the vbuffer/tribuffer, and zero the space freed up at the end
+	const uint64_t tailVerts = numVerts - (removed.firstVert + removed.numVerts);
+	const uint64_t tailTris = numTris - (removed.firstTri + removed.numTris);
+
+	GeoTypes::Vertex3D* vts = &vbuffer[0];
+	IndexedTriangle* tris = &tribuffer[0];
+	memmove(vts + removed.firstVert, vts + removed.firstVert + removed.numVerts, tailVerts * sizeof(GeoTypes::Vertex3D));
+	memmove(tris + removed.firstTri, tris + removed.firstTri + removed.numTris, tailTris * sizeof(IndexedTriangle));
+	memset(vts + removed.firstVert + tailVerts, 0, removed.numVerts * sizeof(GeoTypes::Vertex3D));
+	memset(tris + removed.firstTri + tailTris, 0, removed.numTris * sizeof(IndexedTriangle));
+
+	// Rebase shifted triangles onto the shifted vertices
+	for (uint64_t i = removed.firstTri; i < removed.firstTri + tailTris; i++)
+	{
+		tris[i].xyz.x -= static_cast<uint32_t>(removed.numVerts);
+		tris[i].xyz.y -= static_cast<uint32_t>(removed.numVerts);
+		tris[i].xyz.z -= static_cast<uint32_t>(removed.numVerts);
+	}
+
+	// Shift model ranges/materials down, and re-stamp material IDs to match
+	for (uint32_t i = modelNdx + 1; i < numModels; i++)
+	{
+		ModelRange range = modelRanges[i];
+		range.firstVert -= removed.numVerts;
+		range.firstTri -= removed.numTris;
+		modelRanges[i - 1] = range;
+		materials[i - 1] = materials[i];
+
+		for (uint64_t v = range.firstVert; v < range.firstVert + range.numVerts; v++)
+		{
+			vts[v].mat.z = static_cast<float>(i - 1);
+		}
+	}
+
+	MarkDirty(VBUFFER, removed.firstVert * sizeof(GeoTypes::Vertex3D), tailVerts * sizeof(GeoTypes::Vertex3D));
+	MarkDirty(TRIBUFFER, removed.firstTri * sizeof(IndexedTriangle), tailTris * sizeof(IndexedTriangle));
+
+	numModels--;
+	numVerts -= removed.numVerts;
+	numTris -= removed.numTris;
+	memset(&materialTable[numModels], 0, sizeof(MaterialPropertyEntry));
+
+	// Entries after the removed model shift down; every entry moves if the atlases had to be re-laid
+	const uint32_t firstChangedEntry = LayoutAtlases(false) ? 0 : modelNdx;
+	for (uint32_t i = firstChangedEntry; i < numModels; i++)
+	{
+		ResolveMaterialEntry(i);
+	}
+}
+
+void SceneBuffers::ReplaceMaterial(uint32_t modelNdx, const Material& material)
+{
+	assert(modelNdx < numModels);
+	materials[modelNdx] = material;
+
+	if (LayoutAtlases(false))
+	{
+		for (uint32_t i = 0; i < numModels; i++)
+		{
+			ResolveMaterialEntry(i);
+		}
+	}
+	else
+	{
+		// Same footprint as before, so only this material's texels + table entry change
+		CopyIntoAtlases(modelNdx);
+		ResolveMaterialEntry(modelNdx);
+	}
+}
+
+void SceneBuffers::ResolveMaterialEntry(uint32_t modelNdx)
+{
+	const Material& mat = materials[modelNdx];
+
+	MaterialPropertyEntry entry;
+	memset(&entry, 0, sizeof(entry)); // Padding included, so entries compare/upload deterministically
+
+	// Uniform materials skip the atlases and pass their properties straight through the material table
+	entry.isUniform = mat.isUniform ? TRUE : FALSE;
+	entry.uniformRoughness = mat.uniformRoughness;
+	memcpy(&entry.uniformSPD, &mat.uniformSPD, sizeof(MaterialSPD_Piecewise));
+
+	if (!mat.isUniform)
+	{
+		// Offsets are normalized against atlas widths (see [materialAtlasDims] in GenericRenderConstants)
+		entry.spectralWidth = mat.spectralTexX;
+		entry.spectralHeight = mat.spectralTexY;
+		entry.spectralOffsetU = static_cast<float>(spectralAtlasX[modelNdx]) / spectralAtlasWidth;
+		entry.spectralOffsetV = 0; // For now! May change if we use a different packing algorithm
+
+		entry.roughnessWidth = mat.roughnessTexX;
+		entry.roughnessHeight = mat.roughnessTexY;
+		entry.roughnessOffsetU = static_cast<float>(roughnessAtlasX[modelNdx]) / roughnessAtlasWidth;
+		entry.roughnessOffsetV = 0;
+	}
+
+	// Only dirty entries that actually changed; removals/re-layouts re-resolve lots of entries that usually don't
+	if (memcmp(&materialTable[modelNdx], &entry, sizeof(entry)) != 0)
+	{
+		materialTable[modelNdx] = entry;
+		MarkDirty(MATERIAL_TABLE, modelNdx * sizeof(MaterialPropertyEntry), sizeof(MaterialPropertyEntry));
+	}
+}
+
+bool SceneBuffers::LayoutAtlases(bool force)
+{
+	// Very naive packing, all on X; the layout is fully described by the footprints of each textured material, in model order
+	bool changed = force;
+	uint32_t numFootprints = 0;
+	uint32_t spectralX = 0, roughnessX = 0;
+	uint32_t spectralHeight = 1, roughnessHeight = 1;
+	for (uint32_t i = 0; i < numModels; i++)
+	{
+		const Material& mat = materials[i];
+		if (mat.isUniform)
+		{
+			spectralAtlasX[i] = 0;
+			roughnessAtlasX[i] = 0;
+			continue;
+		}
+
+		const uint64_t footprint = static_cast<uint64_t>(mat.spectralTexX) | (static_cast<uint64_t>(mat.spectralTexY) << 16) |
+								   (static_cast<uint64_t>(mat.roughnessTexX) << 32) | (static_cast<uint64_t>(mat.roughnessTexY) << 48);
+		changed |= (numFootprints >= numAtlasFootprints) || (atlasFootprints[numFootprints] != footprint);
+		atlasFootprints[numFootprints] = footprint;
+		numFootprints++;
+
+		spectralAtlasX[i] = spectralX;
+		roughnessAtlasX[i] = roughnessX;
+		spectralX += mat.spectralTexX;
+		roughnessX += mat.roughnessTexX;
+		spectralHeight = std::max(spectralHeight, static_cast<uint32_t>(mat.spectralTexY));
+		roughnessHeight = std::max(roughnessHeight, static_cast<uint32_t>(mat.roughnessTexY));
+	}
+
+	changed |= (numFootprints != numAtlasFootprints);
+	numAtlasFootprints = numFootprints;
+	if (!changed)
+	{
+		return false;
+	}
+
+	spectralAtlasWidth = std::max(spectralX, 1u);
+	spectralAtlasHeight = spectralHeight;
+	roughnessAtlasWidth = std::max(roughnessX, 1u);
+	roughnessAtlasHeight = roughnessHeight;
+
+	CPUMemory::Free(roughnessAtlas);
+	CPUMemory::Free(spectralAtlas);
+	spectralAtlas = CPUMemory::AllocateArray<MaterialSPD_Piecewise>(spectralAtlasWidth * spectralAtlasHeight);
+	roughnessAtlas = CPUMemory::AllocateArray<float>(roughnessAtlasWidth * roughnessAtlasHeight);
+	CPUMemory::ZeroData(spectralAtlas);
+	CPUMemory::ZeroData(roughnessAtlas);
+
+	for (uint32_t i = 0; i < numModels; i++)
+	{
+		CopyIntoAtlases(i);
+	}
+
+	// New dimensions mean new row pitches, so the whole atlas has to go up again
+	dirty[SPECTRAL_ATLAS].num = 0;
+	dirty[ROUGHNESS_ATLAS].num = 0;
+	MarkDirty(SPECTRAL_ATLAS, 0, BufferBytes(SPECTRAL_ATLAS));
+	MarkDirty(ROUGHNESS_ATLAS, 0, BufferBytes(ROUGHNESS_ATLAS));
+	return true;
+}
+
+void SceneBuffers::CopyIntoAtlases(uint32_t modelNdx)
+{
+	const Material& mat = materials[modelNdx];
+	if (mat.isUniform)
+	{
+		return;
+	}
+
+	// One patchable row per texture row
+	MaterialSPD_Piecewise* spectralTexels = &spectralAtlas[0];
+	for (uint32_t y = 0; y < mat.spectralTexY; y++)
+	{
+		const uint64_t dstTexel = spectralAtlasX[modelNdx] + (y * spectralAtlasWidth);
+		memcpy(spectralTexels + dstTexel, &mat.spectralData[y * mat.spectralTexX], mat.spectralTexX * sizeof(MaterialSPD_Piecewise));
+		MarkDirty(SPECTRAL_ATLAS, dstTexel * sizeof(MaterialSPD_Piecewise), mat.spectralTexX * sizeof(MaterialSPD_Piecewise));
+	}
+
+	float* roughnessTexels = &roughnessAtlas[0];
+	for (uint32_t y = 0; y < mat.roughnessTexY; y++)
+	{
+		const uint64_t dstTexel = roughnessAtlasX[modelNdx] + (y * roughnessAtlasWidth);
+		memcpy(roughnessTexels + dstTexel, &mat.roughnessData[y * mat.roughnessTexX], mat.roughnessTexX * sizeof(float));
+		MarkDirty(ROUGHNESS_ATLAS, dstTexel * sizeof(float), mat.roughnessTexX * sizeof(float));
+	}
+}
+
+void SceneBuffers::MarkDirty(BUFFER_IDS buffer, uint64_t byteOffset, uint64_t numBytes)
+{
+	if (numBytes == 0)
+	{
+		return;
+	}
+
+	DirtyRanges& ranges = dirty[buffer];
+	if (ranges.num == maxDirtyRanges)
+	{
+		// Out of slots; collapse everything into one covering range and keep going
+		uint64_t begin = ranges.begin[0], end = ranges.end[0];
+		for (uint32_t i = 1; i < ranges.num; i++)
+		{
+			begin = std::min(begin, ranges.begin[i]);
+			end = std::max(end, ranges.end[i]);
+		}
+
+		ranges.begin[0] = begin;
+		ranges.end[0] = end;
+		ranges.num = 1;
+	}
+
+	ranges.begin[ranges.num] = byteOffset;
+	ranges.end[ranges.num] = byteOffset + numBytes;
+	ranges.num++;
+}
+
+uint32_t SceneBuffers::CollectPatches(Patch* outPatches) const
+{
+	uint32_t numPatches = 0;
+	for (uint32_t b = 0; b < NUM_BUFFERS; b++)
+	{
+		const DirtyRanges& ranges = dirty[b];
+		const uint64_t bufferBytes = BufferBytes(static_cast<BUFFER_IDS>(b));
+
+		// Sort by start (insertion sort; there are never more than [maxDirtyRanges] of these)
+		uint32_t order[maxDirtyRanges];
+		for (uint32_t i = 0; i < ranges.num; i++)
+		{
+			uint32_t j = i;
+			while (j > 0 && ranges.begin[order[j - 1]] > ranges.begin[i])
+			{
+				order[j] = order[j - 1];
+				j--;
+			}
+			order[j] = i;
+		}
+
+		// Merge overlapping/touching ranges, and clip anything left hanging past the end of a buffer that shrank
+		uint32_t i = 0;
+		while (i < ranges.num)
+		{
+			const uint64_t begin = ranges.begin[order[i]];
+			uint64_t end = ranges.end[order[i]];
+			i++;
+
+			while (i < ranges.num && ranges.begin[order[i]] <= end)
+			{
+				end = std::max(end, ranges.end[order[i]]);
+				i++;
+			}
+
+			end = std::min(end, bufferBytes);
+			if (begin < end)
+			{
+				if (outPatches != nullptr)
+				{
+					outPatches[numPatches] = { static_cast<BUFFER_IDS>(b), begin, end - begin };
+				}
+				numPatches++;
+			}
+		}
+	}
+
+	return numPatches;
+}
+
+void SceneBuffers::ClearPatches()
+{
+	for (uint32_t b = 0; b < NUM_BUFFERS; b++)
+	{
+		dirty[b].num = 0;
+	}
+}
+
+CPUMemory::ArrayAllocHandle<uint8_t> SceneBuffers::BufferContents(BUFFER_IDS buffer) const
+{
+	CPUMemory::AllocHandle handle = CPUMemory::emptyAllocHandle;
+	switch (buffer)
+	{
+		case VBUFFER: handle = vbuffer.handle; break;
+		case TRIBUFFER: handle = tribuffer.handle; break;
+		case MATERIAL_TABLE: handle = materialTable.handle; break;
+		case SPECTRAL_ATLAS: handle = spectralAtlas.handle; break;
+		case ROUGHNESS_ATLAS: handle = roughnessAtlas.handle; break;
+		default: assert(false); break;
+	}
+
+	return CPUMemory::ArrayAllocHandle<uint8_t>(BufferBytes(buffer), handle);
+}
+
+uint64_t SceneBuffers::BufferBytes(BUFFER_IDS buffer) const
+{
+	switch (buffer)
+	{
+		case VBUFFER: return numVerts * sizeof(GeoTypes::Vertex3D);
+		case TRIBUFFER: return numTris * sizeof(IndexedTriangle);
+		case MATERIAL_TABLE: return numModels * sizeof(MaterialPropertyEntry);
+		case SPECTRAL_ATLAS: return static_cast<uint64_t>(spectralAtlasWidth) * spectralAtlasHeight * sizeof(MaterialSPD_Piecewise);
+		case ROUGHNESS_ATLAS: return static_cast<uint64_t>(roughnessAtlasWidth) * roughnessAtlasHeight * sizeof(float);
+		default: assert(false); return 0;
+	}
+}
+
+float4 SceneBuffers::MaterialAtlasDims() const
+{
+	return float4(static_cast<float>(spectralAtlasWidth), static_cast<float>(spectralAtlasHeight), static_cast<float>(roughnessAtlasWidth), static_cast<float>(roughnessAtlasHeight));
+}
@@ -0,0 +1,123 @@
+#pragma once
+
+#include <stdint.h>
+#include "../CPUMemory.h"
+#include "../Math.h"
+#include "../Shaders/SharedStructs.h"
+#include "GeoTypes.h"
+#include "Materials.h"
+
+// CPU-side mirrors of the scene data compute rendering reads from the GPU (structured vbuffer, tribuffer, material table, spectral +
+// roughness atlases), kept editable so scenes don't need a full Geo::Init/Render::Init round-trip for every change
+// - Models own contiguous vertex/triangle ranges, in model order; model [i] uses material [i] (written into each vertex's mat.z)
+// - Edits record the bytes they touch as dirty ranges, per-buffer; [CollectPatches] merges those into sorted byte-range patches, which
+//   applied over the previous buffer contents reproduce a full rebuild exactly
+// - Atlases pack textured materials along X (uniform materials live entirely in the material table); edits that keep every
+//   material's footprint patch single atlas rows, edits that change the packing re-lay the atlases and dirty them completely
+// - Texture data referenced by [Material]s stays owned by the caller
+class SceneBuffers
+{
+	public:
+		enum BUFFER_IDS
+		{
+			VBUFFER,
+			TRIBUFFER,
+			MATERIAL_TABLE,
+			SPECTRAL_ATLAS,
+			ROUGHNESS_ATLAS,
+			NUM_BUFFERS
+		};
+
+		struct Patch
+		{
+			BUFFER_IDS buffer;
+			uint64_t byteOffset;
+			uint64_t numBytes;
+		};
+
+		void Init(uint64_t _maxVerts, uint64_t _maxTris, uint32_t _maxModels);
+		void DeInit();
+
+		// Models are added in two steps, so loaders can write vertices straight into the vbuffer mirror: loaders target [FreeVertices()],
+		// then [AddModel] commits however many vertices they produced
+		// [ndces] index the scene vbuffer (so they start at [NumVerts()]), three per triangle
+		CPUMemory::ArrayAllocHandle<GeoTypes::Vertex3D> FreeVertices();
+		uint32_t AddModel(uint64_t numModelVts, const uint64_t* ndces, uint64_t numNdces, const Material& material);
+
+		// Later models shift down to fill the gap (with rebased indices/material IDs), so removals patch everything after [modelNdx]
+		void RemoveModel(uint32_t modelNdx);
+		void ReplaceMaterial(uint32_t modelNdx, const Material& material);
+
+		// Write merged, sorted patches for everything edited since the last [ClearPatches] into [outPatches], and return how many there
+		// were ([outPatches] may be null, to count them first)
+		// Buffers can also shrink or grow between patches; compare [BufferBytes] against the GPU allocation before applying
+		uint32_t CollectPatches(Patch* outPatches) const;
+		void ClearPatches();
+
+		// Current contents of each mirror ([arrayLen] is the buffer's size in bytes)
+		CPUMemory::ArrayAllocHandle<uint8_t> BufferContents(BUFFER_IDS buffer) const;
+		uint64_t BufferBytes(BUFFER_IDS buffer) const;
+
+		// Spectral atlas width/height, roughness atlas width/height (as in [GenericRenderConstants])
+		float4 MaterialAtlasDims() const;
+
+		uint32_t NumModels() const { return numModels; }
+		uint64_t NumVerts() const { return numVerts; }
+		uint64_t NumTris() const { return numTris; }
+		uint64_t ModelFirstVert(uint32_t modelNdx) const { return modelRanges[modelNdx].firstVert; }
+		uint64_t ModelNumVerts(uint32_t modelNdx) const { return modelRanges[modelNdx].numVerts; }
+		uint64_t ModelFirstTri(uint32_t modelNdx) const { return modelRanges[modelNdx].firstTri; }
+		uint64_t ModelNumTris(uint32_t modelNdx) const { return modelRanges[modelNdx].numTris; }
+		const Material& ModelMaterial(uint32_t modelNdx) const { return materials[modelNdx]; }
+		CPUMemory::ArrayAllocHandle<Material> Materials() const { return materials; }
+
+	private:
+		struct ModelRange
+		{
+			uint64_t firstVert, numVerts;
+			uint64_t firstTri, numTris;
+		};
+
+		// Dirty byte ranges per-buffer; when a buffer runs out of slots its ranges collapse into one covering range
+		static constexpr uint32_t maxDirtyRanges = 64;
+		struct DirtyRanges
+		{
+			uint64_t begin[maxDirtyRanges];
+			uint64_t end[maxDirtyRanges];
+			uint32_t num = 0;
+		};
+
+		void MarkDirty(BUFFER_IDS buffer, uint64_t byteOffset, uint64_t numBytes);
+
+		// Write model [modelNdx]'s material table entry from its material + atlas placement
+		void ResolveMaterialEntry(uint32_t modelNdx);
+
+		// Pack every textured material into freshly-sized atlases; returns false if the atlas layout (dimensions + offsets) didn't
+		// change, in which case nothing was written
+		bool LayoutAtlases(bool force);
+		void CopyIntoAtlases(uint32_t modelNdx);
+
+		CPUMemory::ArrayAllocHandle<GeoTypes::Vertex3D> vbuffer;
+		CPUMemory::ArrayAllocHandle<IndexedTriangle> tribuffer;
+		CPUMemory::ArrayAllocHandle<MaterialPropertyEntry> materialTable;
+		CPUMemory::ArrayAllocHandle<Material> materials;
+		CPUMemory::ArrayAllocHandle<ModelRange> modelRanges;
+
+		// Atlas placement per-model (texels from the left edge of each atlas; uniform materials don't take up atlas space)
+		CPUMemory::ArrayAllocHandle<uint32_t> spectralAtlasX;
+		CPUMemory::ArrayAllocHandle<uint32_t> roughnessAtlasX;
+		CPUMemory::ArrayAllocHandle<uint64_t> atlasFootprints; // Packed spectral/roughness texture dimensions for each textured material
+		uint32_t numAtlasFootprints = 0;
+		CPUMemory::ArrayAllocHandle<MaterialSPD_Piecewise> spectralAtlas;
+		CPUMemory::ArrayAllocHandle<float> roughnessAtlas;
+		uint32_t spectralAtlasWidth = 0, spectralAtlasHeight = 0;
+		uint32_t roughnessAtlasWidth = 0, roughnessAtlasHeight = 0;
+
+		DirtyRanges dirty[NUM_BUFFERS];
+
+		uint64_t maxVerts = 0, maxTris = 0;
+		uint32_t maxModels = 0;
+
+		uint64_t numVerts = 0, numTris = 0;
+		uint32_t numModels = 0;
+};
@@ -0,0 +1,542 @@
+#include "SceneGraph.h"
+
+#include <immintrin.h>
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+// Quaternions follow [transform] (xyz = sin(theta/2) * axis, w = cos(theta/2))
+static void RotateByQuat(const float qx, const float qy, const float qz, const float qw, float& vx, float& vy, float& vz)
+{
+	// v' = v + 2w(q x v) + 2(q x (q x v))
+	const float tx = 2.0f * (qy * vz - qz * vy);
+	const float ty = 2.0f * (qz * vx - qx * vz);
+	const float tz = 2.0f * (qx * vy - qy * vx);
+
+	const float rx = vx + qw * tx + (qy * tz - qz * ty);
+	const float ry = vy + qw * ty + (qz * tx - qx * tz);
+	const float rz = vz + qw * tz + (qx * ty - qy * tx);
+
+	vx = rx;
+	vy = ry;
+	vz = rz;
+}
+
+void SceneGraph::AllocTransforms(TransformSoA& soa, uint32_t num)
+{
+	soa.posX = CPUMemory::AllocateArray<float>(num);
+	soa.posY = CPUMemory::AllocateArray<float>(num);
+	soa.posZ = CPUMemory::AllocateArray<float>(num);
+	soa.scale = CPUMemory::AllocateArray<float>(num);
+	soa.rotX = CPUMemory::AllocateArray<float>(num);
+	soa.rotY = CPUMemory::AllocateArray<float>(num);
+	soa.rotZ = CPUMemory::AllocateArray<float>(num);
+	soa.rotW = CPUMemory::AllocateArray<float>(num);
+}
+
+void SceneGraph::FreeTransforms(TransformSoA& soa)
+{
+	// Reverse allocation order, so each free trims the end of the allocator instead of shuffling memory around
+	CPUMemory::Free(soa.rotW);
+	CPUMemory::Free(soa.rotZ);
+	CPUMemory::Free(soa.rotY);
+	CPUMemory::Free(soa.rotX);
+	CPUMemory::Free(soa.scale);
+	CPUMemory::Free(soa.posZ);
+	CPUMemory::Free(soa.posY);
+	CPUMemory::Free(soa.posX);
+}
+
+void SceneGraph::AllocBounds(BoundsSoA& soa, uint32_t num)
+{
+	soa.minX = CPUMemory::AllocateArray<float>(num);
+	soa.minY = CPUMemory::AllocateArray<float>(num);
+	soa.minZ = CPUMemory::AllocateArray<float>(num);
+	soa.maxX = CPUMemory::AllocateArray<float>(num);
+	soa.maxY = CPUMemory::AllocateArray<float>(num);
+	soa.maxZ = CPUMemory::AllocateArray<float>(num);
+}
+
+void SceneGraph::FreeBounds(BoundsSoA& soa)
+{
+	CPUMemory::Free(soa.maxZ);
+	CPUMemory::Free(soa.maxY);
+	CPUMemory::Free(soa.maxX);
+	CPUMemory::Free(soa.minZ);
+	CPUMemory::Free(soa.minY);
+	CPUMemory::Free(soa.minX);
+}
+
+void SceneGraph::Init(uint32_t _maxNodes, uint32_t _maxMeshes)
+{
+	// Round node storage up to the SIMD width, so the bounds pass never needs to mask loads/stores
+	maxNodes = (_maxNodes + 7) & ~7u;
+	maxMeshes = std::max(_maxMeshes, 1u);
+	numNodes = 0;
+	numMeshes = 0;
+	firstDirtyNode = invalidNdx;
+
+	AllocTransforms(localTransforms, maxNodes);
+	AllocTransforms(worldTransforms, maxNodes);
+	AllocBounds(worldBounds, maxNodes);
+	AllocBounds(meshBounds, maxMeshes);
+
+	parents = CPUMemory::AllocateArray<uint32_t>(maxNodes);
+	meshes = CPUMemory::AllocateArray<uint32_t>(maxNodes);
+	dirty = CPUMemory::AllocateArray<uint8_t>(maxNodes);
+	dirtyList = CPUMemory::AllocateArray<uint32_t>(maxNodes);
+	isParent = CPUMemory::AllocateArray<uint8_t>(maxNodes);
+
+	CPUMemory::FlushData(parents); // Every node starts out parentless...
+	CPUMemory::FlushData(meshes); // ...and meshless
+	CPUMemory::ZeroData(dirty);
+	CPUMemory::ZeroData(isParent);
+	numDirty = 0;
+	dirtySubtrees = false;
+
+	// Padding nodes (beyond [numNodes]) read as identity transforms
+	TransformSoA* soas[2] = { &localTransforms, &worldTransforms };
+	for (TransformSoA* soa : soas)
+	{
+		CPUMemory::ZeroData(soa->posX);
+		CPUMemory::ZeroData(soa->posY);
+		CPUMemory::ZeroData(soa->posZ);
+		CPUMemory::ZeroData(soa->rotX);
+		CPUMemory::ZeroData(soa->rotY);
+		CPUMemory::ZeroData(soa->rotZ);
+		std::fill_n(&soa->scale[0], maxNodes, 1.0f);
+		std::fill_n(&soa->rotW[0], maxNodes, 1.0f);
+	}
+}
+
+void SceneGraph::DeInit()
+{
+	CPUMemory::Free(isParent);
+	CPUMemory::Free(dirtyList);
+	CPUMemory::Free(dirty);
+	CPUMemory::Free(meshes);
+	CPUMemory::Free(parents);
+
+	FreeBounds(meshBounds);
+	FreeBounds(worldBounds);
+	FreeTransforms(worldTransforms);
+	FreeTransforms(localTransforms);
+
+	maxNodes = 0;
+	maxMeshes = 0;
+	numNodes = 0;
+	numMeshes = 0;
+}
+
+uint32_t SceneGraph::AddMesh(float4 boundsMin, float4 boundsMax)
+{
+	assert(numMeshes < maxMeshes);
+	const uint32_t meshNdx = numMeshes;
+	numMeshes++;
+
+	SetMeshBounds(meshNdx, boundsMin, boundsMax);
+	return meshNdx;
+}
+
+void SceneGraph::SetMeshBounds(uint32_t meshNdx, float4 boundsMin, float4 boundsMax)
+{
+	assert(meshNdx < numMeshes);
+	meshBounds.minX[meshNdx] = boundsMin.x;
+	meshBounds.minY[meshNdx] = boundsMin.y;
+	meshBounds.minZ[meshNdx] = boundsMin.z;
+	meshBounds.maxX[meshNdx] = boundsMax.x;
+	meshBounds.maxY[meshNdx] = boundsMax.y;
+	meshBounds.maxZ[meshNdx] = boundsMax.z;
+
+	// Every instance of the mesh needs new world bounds
+	for (uint32_t i = 0; i < numNodes; i++)
+	{
+		if (meshes[i] == meshNdx)
+		{
+			MarkDirty(i);
+		}
+	}
+}
+
+uint32_t SceneGraph::AddNode(uint32_t parentNdx, transform localTransform, uint32_t meshNdx)
+{
+	assert(numNodes < maxNodes);
+	assert(parentNdx == invalidNdx || parentNdx < numNodes); // Parents before children, always
+	assert(meshNdx == invalidNdx || meshNdx < numMeshes);
+
+	const uint32_t nodeNdx = numNodes;
+	numNodes++;
+
+	parents[nodeNdx] = parentNdx;
+	meshes[nodeNdx] = meshNdx;
+	if (parentNdx != invalidNdx)
+	{
+		isParent[parentNdx] = 1;
+		dirtySubtrees |= (dirty[parentNdx] != 0); // Children of freshly-dirtied nodes need the full sweep
+	}
+
+	SetLocalTransform(nodeNdx, localTransform);
+	return nodeNdx;
+}
+
+void SceneGraph::RemoveNode(uint32_t nodeNdx)
+{
+	assert(nodeNdx < numNodes);
+	assert(!isParent[nodeNdx]);
+
+	// Parents losing their last child stop being parents (so they can be removed in turn, and don't force subtree sweeps)
+	const uint32_t parentNdx = parents[nodeNdx];
+	if (parentNdx != invalidNdx)
+	{
+		bool hasSiblings = false;
+		for (uint32_t i = 0; i < numNodes && !hasSiblings; i++)
+		{
+			hasSiblings = (i != nodeNdx && parents[i] == parentNdx);
+		}
+		isParent[parentNdx] = hasSiblings ? 1 : 0;
+	}
+
+	// Shift every later node down over [nodeNdx]
+	const uint32_t numShifted = numNodes - nodeNdx - 1;
+	auto shiftDown = [nodeNdx, numShifted](auto& handle)
+	{
+		memmove(&handle[nodeNdx], &handle[nodeNdx + 1], numShifted * sizeof(handle[0]));
+	};
+
+	TransformSoA* transformSoAs[2] = { &localTransforms, &worldTransforms };
+	for (TransformSoA* soa : transformSoAs)
+	{
+		shiftDown(soa->posX); shiftDown(soa->posY); shiftDown(soa->posZ); shiftDown(soa->scale);
+		shiftDown(soa->rotX); shiftDown(soa->rotY); shiftDown(soa->rotZ); shiftDown(soa->rotW);
+	}
+
+	shiftDown(worldBounds.minX); shiftDown(worldBounds.minY); shiftDown(worldBounds.minZ);
+	shiftDown(worldBounds.maxX); shiftDown(worldBounds.maxY); shiftDown(worldBounds.maxZ);
+	shiftDown(parents);
+	shiftDown(meshes);
+	shiftDown(dirty);
+	shiftDown(isParent);
+
+	for (uint32_t i = nodeNdx; i < (numNodes - 1); i++)
+	{
+		if (parents[i] != invalidNdx && parents[i] > nodeNdx)
+		{
+			parents[i]--;
+		}
+	}
+
+	// Pending updates follow their nodes (the removed node's own is dropped)
+	uint32_t numKept = 0;
+	for (uint32_t i = 0; i < numDirty; i++)
+	{
+		const uint32_t n = dirtyList[i];
+		if (n != nodeNdx)
+		{
+			dirtyList[numKept] = (n > nodeNdx) ? (n - 1) : n;
+			numKept++;
+		}
+	}
+	numDirty = numKept;
+	if (firstDirtyNode != invalidNdx && firstDirtyNode > nodeNdx)
+	{
+		firstDirtyNode = (numDirty > 0 || dirtySubtrees) ? nodeNdx : invalidNdx; // Conservative; sweeps still check each node's flag
+	}
+
+	// The vacated slot becomes padding again (see Init())
+	numNodes--;
+	parents[numNodes] = invalidNdx;
+	meshes[numNodes] = invalidNdx;
+	dirty[numNodes] = 0;
+	isParent[numNodes] = 0;
+	for (TransformSoA* soa : transformSoAs)
+	{
+		soa->posX[numNodes] = 0.0f; soa->posY[numNodes] = 0.0f; soa->posZ[numNodes] = 0.0f; soa->scale[numNodes] = 1.0f;
+		soa->rotX[numNodes] = 0.0f; soa->rotY[numNodes] = 0.0f; soa->rotZ[numNodes] = 0.0f; soa->rotW[numNodes] = 1.0f;
+	}
+}
+
+transform SceneGraph::GetLocalTransform(uint32_t nodeNdx) const
+{
+	transform t;
+	t.translationAndScale = float4(localTransforms.posX[nodeNdx], localTransforms.posY[nodeNdx], localTransforms.posZ[nodeNdx], localTransforms.scale[nodeNdx]);
+	t.rotation = float4(localTransforms.rotX[nodeNdx], localTransforms.rotY[nodeNdx], localTransforms.rotZ[nodeNdx], localTransforms.rotW[nodeNdx]);
+	return t;
+}
+
+transform SceneGraph::GetWorldTransform(uint32_t nodeNdx) const
+{
+	transform t;
+	t.translationAndScale = float4(worldTransforms.posX[nodeNdx], worldTransforms.posY[nodeNdx], worldTransforms.posZ[nodeNdx], worldTransforms.scale[nodeNdx]);
+	t.rotation = float4(worldTransforms.rotX[nodeNdx], worldTransforms.rotY[nodeNdx], worldTransforms.rotZ[nodeNdx], worldTransforms.rotW[nodeNdx]);
+	return t;
+}
+
+void SceneGraph::SetLocalTransform(uint32_t nodeNdx, transform localTransform)
+{
+	assert(nodeNdx < numNodes);
+	localTransforms.posX[nodeNdx] = localTransform.translationAndScale.x;
+	localTransforms.posY[nodeNdx] = localTransform.translationAndScale.y;
+	localTransforms.posZ[nodeNdx] = localTransform.translationAndScale.z;
+	localTransforms.scale[nodeNdx] = localTransform.translationAndScale.w;
+	localTransforms.rotX[nodeNdx] = localTransform.rotation.x;
+	localTransforms.rotY[nodeNdx] = localTransform.rotation.y;
+	localTransforms.rotZ[nodeNdx] = localTransform.rotation.z;
+	localTransforms.rotW[nodeNdx] = localTransform.rotation.w;
+
+	MarkDirty(nodeNdx);
+}
+
+void SceneGraph::MarkDirty(uint32_t nodeNdx)
+{
+	if (!dirty[nodeNdx])
+	{
+		dirty[nodeNdx] = 1;
+		dirtyList[numDirty] = nodeNdx;
+		numDirty++;
+	}
+
+	dirtySubtrees |= (isParent[nodeNdx] != 0);
+	firstDirtyNode = std::min(firstDirtyNode, nodeNdx);
+}
+
+uint32_t SceneGraph::Update()
+{
+	if (firstDirtyNode == invalidNdx)
+	{
+		return 0;
+	}
+
+	ResolveWorldTransforms();
+	ResolveWorldBounds();
+
+	// Count + clear dirty flags
+	uint32_t numUpdated = 0;
+	uint8_t* dirtyFlags = &dirty[0];
+	if (dirtySubtrees)
+	{
+		for (uint32_t i = firstDirtyNode; i < numNodes; i++)
+		{
+			numUpdated += dirtyFlags[i];
+			dirtyFlags[i] = 0;
+		}
+	}
+	else
+	{
+		const uint32_t* dirtyNdces = &dirtyList[0];
+		for (uint32_t i = 0; i < numDirty; i++)
+		{
+			dirtyFlags[dirtyNdces[i]] = 0;
+		}
+		numUpdated = numDirty;
+	}
+
+	firstDirtyNode = invalidNdx;
+	numDirty = 0;
+	dirtySubtrees = false;
+	return numUpdated;
+}
+
+void SceneGraph::ResolveWorldTransforms()
+{
+	// Cache raw pointers for the sweep; nothing below allocates or frees, so they stay valid
+	const uint32_t* parentNdces = &parents[0];
+	uint8_t* dirtyFlags = &dirty[0];
+
+	const float* lpx = &localTransforms.posX[0]; const float* lpy = &localTransforms.posY[0]; const float* lpz = &localTransforms.posZ[0];
+	const float* ls = &localTransforms.scale[0];
+	const float* lqx = &localTransforms.rotX[0]; const float* lqy = &localTransforms.rotY[0]; const float* lqz = &localTransforms.rotZ[0]; const float* lqw = &localTransforms.rotW[0];
+
+	float* wpx = &worldTransforms.posX[0]; float* wpy = &worldTransforms.posY[0]; float* wpz = &worldTransforms.posZ[0];
+	float* ws = &worldTransforms.scale[0];
+	float* wqx = &worldTransforms.rotX[0]; float* wqy = &worldTransforms.rotY[0]; float* wqz = &worldTransforms.rotZ[0]; float* wqw = &worldTransforms.rotW[0];
+
+	auto resolveNode = [&](const uint32_t i, const uint32_t p)
+	{
+		if (p == invalidNdx)
+		{
+			wpx[i] = lpx[i]; wpy[i] = lpy[i]; wpz[i] = lpz[i];
+			ws[i] = ls[i];
+			wqx[i] = lqx[i]; wqy[i] = lqy[i]; wqz[i] = lqz[i]; wqw[i] = lqw[i];
+		}
+		else
+		{
+			// Position; scale + rotate the local offset into the parent's frame
+			float ox = lpx[i] * ws[p];
+			float oy = lpy[i] * ws[p];
+			float oz = lpz[i] * ws[p];
+			RotateByQuat(wqx[p], wqy[p], wqz[p], wqw[p], ox, oy, oz);
+
+			wpx[i] = wpx[p] + ox;
+			wpy[i] = wpy[p] + oy;
+			wpz[i] = wpz[p] + oz;
+
+			// Uniform scale composes multiplicatively
+			ws[i] = ws[p] * ls[i];
+
+			// Rotation (parent * local)
+			const float pqx = wqx[p], pqy = wqy[p], pqz = wqz[p], pqw = wqw[p];
+			wqw[i] = pqw * lqw[i] - pqx * lqx[i] - pqy * lqy[i] - pqz * lqz[i];
+			wqx[i] = pqw * lqx[i] + pqx * lqw[i] + pqy * lqz[i] - pqz * lqy[i];
+			wqy[i] = pqw * lqy[i] - pqx * lqz[i] + pqy * lqw[i] + pqz * lqx[i];
+			wqz[i] = pqw * lqz[i] + pqx * lqy[i] - pqy * lqx[i] + pqz * lqw[i];
+		}
+	};
+
+	if (!dirtySubtrees)
+	{
+		// Only leaves moved; their parents are clean, so each one resolves independently
+		const uint32_t* dirtyNdces = &dirtyList[0];
+		for (uint32_t i = 0; i < numDirty; i++)
+		{
+			const uint32_t n = dirtyNdces[i];
+			resolveNode(n, parentNdces[n]);
+		}
+		return;
+	}
+
+	// Parents always precede their children, so one forward sweep propagates dirty flags through whole subtrees
+	for (uint32_t i = firstDirtyNode; i < numNodes; i++)
+	{
+		const uint32_t p = parentNdces[i];
+		if (p != invalidNdx)
+		{
+			dirtyFlags[i] |= dirtyFlags[p];
+		}
+
+		if (dirtyFlags[i])
+		{
+			resolveNode(i, p);
+		}
+	}
+}
+
+void SceneGraph::ResolveWorldBounds()
+{
+	const uint8_t* dirtyFlags = &dirty[0];
+	const uint32_t* meshNdces = &meshes[0];
+
+	const float* px = &worldTransforms.posX[0]; const float* py = &worldTransforms.posY[0]; const float* pz = &worldTransforms.posZ[0];
+	const float* s = &worldTransforms.scale[0];
+	const float* qx = &worldTransforms.rotX[0]; const float* qy = &worldTransforms.rotY[0]; const float* qz = &worldTransforms.rotZ[0]; const float* qw = &worldTransforms.rotW[0];
+
+	const float* mMinX = &meshBounds.minX[0]; const float* mMinY = &meshBounds.minY[0]; const float* mMinZ = &meshBounds.minZ[0];
+	const float* mMaxX = &meshBounds.maxX[0]; const float* mMaxY = &meshBounds.maxY[0]; const float* mMaxZ = &meshBounds.maxZ[0];
+
+	float* bMinX = &worldBounds.minX[0]; float* bMinY = &worldBounds.minY[0]; float* bMinZ = &worldBounds.minZ[0];
+	float* bMaxX = &worldBounds.maxX[0]; float* bMaxY = &worldBounds.maxY[0]; float* bMaxZ = &worldBounds.maxZ[0];
+
+	// Node storage is padded to a multiple of eight (see Init()), so whole blocks are always safe to load/store
+	const uint32_t firstBlock = firstDirtyNode & ~7u;
+	const __m256 half = _mm256_set1_ps(0.5f);
+	const __m256 one = _mm256_set1_ps(1.0f);
+	const __m256 two = _mm256_set1_ps(2.0f);
+	const __m256 absMask = _mm256_castsi256_ps(_mm256_set1_epi32(0x7fffffff));
+	const __m256i invalidMesh = _mm256_set1_epi32(static_cast<int>(invalidNdx));
+	for (uint32_t i = firstBlock; i < numNodes; i += 8)
+	{
+		// Skip blocks without any moving nodes (most of them, most frames)
+		uint64_t blockFlags = 0;
+		memcpy(&blockFlags, dirtyFlags + i, sizeof(uint64_t));
+		if (blockFlags == 0)
+		{
+			continue;
+		}
+
+		// Gather object-space bounds for each instance; nodes without meshes get zero-sized bounds at their origin
+		const __m256i meshNdx = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(meshNdces + i));
+		const __m256 hasMesh = _mm256_castsi256_ps(_mm256_xor_si256(_mm256_cmpeq_epi32(meshNdx, invalidMesh), _mm256_set1_epi32(-1)));
+		const __m256 zero = _mm256_setzero_ps();
+		const __m256 lMinX = _mm256_mask_i32gather_ps(zero, mMinX, meshNdx, hasMesh, 4);
+		const __m256 lMinY = _mm256_mask_i32gather_ps(zero, mMinY, meshNdx, hasMesh, 4);
+		const __m256 lMinZ = _mm256_mask_i32gather_ps(zero, mMinZ, meshNdx, hasMesh, 4);
+		const __m256 lMaxX = _mm256_mask_i32gather_ps(zero, mMaxX, meshNdx, hasMesh, 4);
+		const __m256 lMaxY = _mm256_mask_i32gather_ps(zero, mMaxY, meshNdx, hasMesh, 4);
+		const __m256 lMaxZ = _mm256_mask_i32gather_ps(zero, mMaxZ, meshNdx, hasMesh, 4);
+
+		// Scaled object-space centre/extents
+		const __m256 scale = _mm256_loadu_ps(s + i);
+		const __m256 cx = _mm256_mul_ps(_mm256_mul_ps(_mm256_add_ps(lMinX, lMaxX), half), scale);
+		const __m256 cy = _mm256_mul_ps(_mm256_mul_ps(_mm256_add_ps(lMinY, lMaxY), half), scale);
+		const __m256 cz = _mm256_mul_ps(_mm256_mul_ps(_mm256_add_ps(lMinZ, lMaxZ), half), scale);
+		const __m256 ex = _mm256_and_ps(_mm256_mul_ps(_mm256_mul_ps(_mm256_sub_ps(lMaxX, lMinX), half), scale), absMask);
+		const __m256 ey = _mm256_and_ps(_mm256_mul_ps(_mm256_mul_ps(_mm256_sub_ps(lMaxY, lMinY), half), scale), absMask);
+		const __m256 ez = _mm256_and_ps(_mm256_mul_ps(_mm256_mul_ps(_mm256_sub_ps(lMaxZ, lMinZ), half), scale), absMask);
+
+		// Rotation matrix from each quaternion
+		const __m256 x = _mm256_loadu_ps(qx + i);
+		const __m256 y = _mm256_loadu_ps(qy + i);
+		const __m256 z = _mm256_loadu_ps(qz + i);
+		const __m256 w = _mm256_loadu_ps(qw + i);
+
+		const __m256 xx = _mm256_mul_ps(x, x), yy = _mm256_mul_ps(y, y), zz = _mm256_mul_ps(z, z);
+		const __m256 xy = _mm256_mul_ps(x, y), xz = _mm256_mul_ps(x, z), yz = _mm256_mul_ps(y, z);
+		const __m256 wx = _mm256_mul_ps(w, x), wy = _mm256_mul_ps(w, y), wz = _mm256_mul_ps(w, z);
+
+		const __m256 r00 = _mm256_sub_ps(one, _mm256_mul_ps(two, _mm256_add_ps(yy, zz)));
+		const __m256 r01 = _mm256_mul_ps(two, _mm256_sub_ps(xy, wz));
+		const __m256 r02 = _mm256_mul_ps(two, _mm256_add_ps(xz, wy));
+		const __m256 r10 = _mm256_mul_ps(two, _mm256_add_ps(xy, wz));
+		const __m256 r11 = _mm256_sub_ps(one, _mm256_mul_ps(two, _mm256_add_ps(xx, zz)));
+		const __m256 r12 = _mm256_mul_ps(two, _mm256_sub_ps(yz, wx));
+		const __m256 r20 = _mm256_mul_ps(two, _mm256_sub_ps(xz, wy));
+		const __m256 r21 = _mm256_mul_ps(two, _mm256_add_ps(yz, wx));
+		const __m256 r22 = _mm256_sub_ps(one, _mm256_mul_ps(two, _mm256_add_ps(xx, yy)));
+
+		// World centre = position + R * centre
+		const __m256 wcx = _mm256_add_ps(_mm256_loadu_ps(px + i), _mm256_fmadd_ps(r00, cx, _mm256_fmadd_ps(r01, cy, _mm256_mul_ps(r02, cz))));
+		const __m256 wcy = _mm256_add_ps(_mm256_loadu_ps(py + i), _mm256_fmadd_ps(r10, cx, _mm256_fmadd_ps(r11, cy, _mm256_mul_ps(r12, cz))));
+		const __m256 wcz = _mm256_add_ps(_mm256_loadu_ps(pz + i), _mm256_fmadd_ps(r20, cx, _mm256_fmadd_ps(r21, cy, _mm256_mul_ps(r22, cz))));
+
+		// World extents = |R| * extents (Arvo's method)
+		const __m256 wex = _mm256_fmadd_ps(_mm256_and_ps(r00, absMask), ex, _mm256_fmadd_ps(_mm256_and_ps(r01, absMask), ey, _mm256_mul_ps(_mm256_and_ps(r02, absMask), ez)));
+		const __m256 wey = _mm256_fmadd_ps(_mm256_and_ps(r10, absMask), ex, _mm256_fmadd_ps(_mm256_and_ps(r11, absMask), ey, _mm256_mul_ps(_mm256_and_ps(r12, absMask), ez)));
+		const __m256 wez = _mm256_fmadd_ps(_mm256_and_ps(r20, absMask), ex, _mm256_fmadd_ps(_mm256_and_ps(r21, absMask), ey, _mm256_mul_ps(_mm256_and_ps(r22, absMask), ez)));
+
+		// Clean nodes inside dirty blocks get rewritten with identical values, which is cheaper than masking the stores
+		_mm256_storeu_ps(bMinX + i, _mm256_sub_ps(wcx, wex));
+		_mm256_storeu_ps(bMinY + i, _mm256_sub_ps(wcy, wey));
+		_mm256_storeu_ps(bMinZ + i, _mm256_sub_ps(wcz, wez));
+		_mm256_storeu_ps(bMaxX + i, _mm256_add_ps(wcx, wex));
+		_mm256_storeu_ps(bMaxY + i, _mm256_add_ps(wcy, wey));
+		_mm256_storeu_ps(bMaxZ + i, _mm256_add_ps(wcz, wez));
+	}
+}
+
+void SceneGraph::GetWorldBounds(uint32_t nodeNdx, float4* outMin, float4* outMax) const
+{
+	*outMin = float4(worldBounds.minX[nodeNdx], worldBounds.minY[nodeNdx], worldBounds.minZ[nodeNdx], 0.0f);
+	*outMax = float4(worldBounds.maxX[nodeNdx], worldBounds.maxY[nodeNdx], worldBounds.maxZ[nodeNdx], 0.0f);
+}
+
+void SceneGraph::GetSceneBounds(float4* outMin, float4* outMax) const
+{
+	const float inf = std::numeric_limits<float>::infinity();
+	*outMin = float4(inf, inf, inf, 0.0f);
+	*outMax = float4(-inf, -inf, -inf, 0.0f);
+
+	bool anyMeshes = false;
+	for (uint32_t i = 0; i < numNodes; i++)
+	{
+		if (meshes[i] == invalidNdx)
+		{
+			continue;
+		}
+
+		anyMeshes = true;
+		outMin->x = std::min(outMin->x, worldBounds.minX[i]);
+		outMin->y = std::min(outMin->y, worldBounds.minY[i]);
+		outMin->z = std::min(outMin->z, worldBounds.minZ[i]);
+		outMax->x = std::max(outMax->x, worldBounds.maxX[i]);
+		outMax->y = std::max(outMax->y, worldBounds.maxY[i]);
+		outMax->z = std::max(outMax->z, worldBounds.maxZ[i]);
+	}
+
+	// Empty scenes collapse to the origin
+	if (!anyMeshes)
+	{
+		*outMin = float4(0.0f, 0.0f, 0.0f, 0.0f);
+		*outMax = float4(0.0f, 0.0f, 0.0f, 0.0f);
+	}
+}
@@ -0,0 +1,98 @@
+#pragma once
+
+#include <stdint.h>
+#include "../CPUMemory.h"
+#include "../Math.h"
+
+// Data-oriented scene hierarchy
+// - Transforms are stored SoA (one array per SQT component), so updates stream through memory instead of hopping between fat node structs
+// - Nodes reference their parents by index, and parents are always added before their children; world transforms resolve in one forward sweep
+// - Local edits set a dirty flag, and only nodes with dirty flags (or dirty ancestors) are recomputed on update
+// - Nodes may reference a mesh; many nodes referencing the same mesh are instances of it (mesh data is loaded/stored once)
+// - World-space AABBs are computed eight instances at a time with AVX2 (the project builds with /arch:AVX2); node storage is padded to
+//   a multiple of eight so there's never a partial block to handle
+class SceneGraph
+{
+	public:
+		static constexpr uint32_t invalidNdx = UINT32_MAX;
+
+		void Init(uint32_t _maxNodes, uint32_t _maxMeshes);
+		void DeInit();
+
+		// Mesh registration; object-space bounds are needed to place each instance's bounds in world space
+		uint32_t AddMesh(float4 boundsMin, float4 boundsMax);
+		void SetMeshBounds(uint32_t meshNdx, float4 boundsMin, float4 boundsMax);
+
+		// Adds a node under [parentNdx] (or at the root, for [invalidNdx]); nodes with [meshNdx] != [invalidNdx] are mesh instances
+		uint32_t AddNode(uint32_t parentNdx, transform localTransform, uint32_t meshNdx = invalidNdx);
+
+		// Removes a node without children; later nodes shift down one index (parent indices follow them), and meshes stay registered
+		void RemoveNode(uint32_t nodeNdx);
+
+		transform GetLocalTransform(uint32_t nodeNdx) const;
+		transform GetWorldTransform(uint32_t nodeNdx) const;
+		void SetLocalTransform(uint32_t nodeNdx, transform localTransform);
+
+		// Resolve world transforms + world bounds for every node touched since the last update
+		// Returns the number of nodes recomputed
+		uint32_t Update();
+
+		// World bounds for a specific node/the whole scene (nodes without meshes are skipped when computing scene bounds)
+		void GetWorldBounds(uint32_t nodeNdx, float4* outMin, float4* outMax) const;
+		void GetSceneBounds(float4* outMin, float4* outMax) const;
+
+		bool Initialized() const { return maxNodes > 0; }
+		uint32_t NumNodes() const { return numNodes; }
+		uint32_t NumMeshes() const { return numMeshes; }
+		uint32_t MaxNodes() const { return maxNodes; }
+		uint32_t MaxMeshes() const { return maxMeshes; }
+		uint32_t NodeMesh(uint32_t nodeNdx) const { return meshes[nodeNdx]; }
+		uint32_t NodeParent(uint32_t nodeNdx) const { return parents[nodeNdx]; }
+
+	private:
+		// SQT components, SoA
+		struct TransformSoA
+		{
+			CPUMemory::ArrayAllocHandle<float> posX, posY, posZ, scale;
+			CPUMemory::ArrayAllocHandle<float> rotX, rotY, rotZ, rotW;
+		};
+
+		struct BoundsSoA
+		{
+			CPUMemory::ArrayAllocHandle<float> minX, minY, minZ;
+			CPUMemory::ArrayAllocHandle<float> maxX, maxY, maxZ;
+		};
+
+		void AllocTransforms(TransformSoA& soa, uint32_t num);
+		void FreeTransforms(TransformSoA& soa);
+		void AllocBounds(BoundsSoA& soa, uint32_t num);
+		void FreeBounds(BoundsSoA& soa);
+
+		void MarkDirty(uint32_t nodeNdx);
+		void ResolveWorldTransforms();
+		void ResolveWorldBounds();
+
+		TransformSoA localTransforms;
+		TransformSoA worldTransforms;
+		BoundsSoA worldBounds;
+		BoundsSoA meshBounds; // Object-space
+
+		CPUMemory::ArrayAllocHandle<uint32_t> parents;
+		CPUMemory::ArrayAllocHandle<uint32_t> meshes;
+
+		// Dirty flags are bytes rather than bits, so the bounds pass can test eight nodes at once with a single 64-bit load
+		CPUMemory::ArrayAllocHandle<uint8_t> dirty;
+
+		// Most frames only move leaves, which don't need a sweep to push changes into their subtrees; dirty nodes are listed
+		// here so those updates can visit just the nodes that changed
+		CPUMemory::ArrayAllocHandle<uint32_t> dirtyList;
+		CPUMemory::ArrayAllocHandle<uint8_t> isParent;
+		uint32_t numDirty = 0;
+		bool dirtySubtrees = false;
+
+		uint32_t maxNodes = 0;
+		uint32_t numNodes = 0;
+		uint32_t maxMeshes = 0;
+		uint32_t numMeshes = 0;
+		uint32_t firstDirtyNode = invalidNdx; // Nodes before this are known-clean, so sweeps can skip them
+};
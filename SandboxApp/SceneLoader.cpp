@@ -0,0 +1,109 @@
+#include "SceneLoader.h"
+#include "GeoLoader.h"
+#include "Bounds.h"
+#include "../CPUMemory.h"
+
+#include <limits>
+
+void LoadSceneModel(SceneBuffers& mirror, const Scene::Model& model, uint64_t* ndces)
+{
+	uint64_t numModelVts = 0;
+	uint64_t numModelNdces = 0;
+	Material material = {};
+
+	MeshLoadParams params = {};
+	params.outVerts = mirror.FreeVertices();
+	params.outNumVts = &numModelVts;
+	params.outNdces = ndces;
+	params.outNumNdces = &numModelNdces;
+	params.inNdxOffset = mirror.NumVerts(); // Models share the scene vbuffer, so their indices start after every vertex added so far
+
+	params.outSpectralTexAddr = &material.spectralData;
+	params.outSpectralTexFootprint = &material.spectralDataSize;
+	params.outSpectralTexWidth = &material.spectralTexX;
+	params.outSpectralTexHeight = &material.spectralTexY;
+
+	params.outRoughnessTexAddr = &material.roughnessData;
+	params.outRoughnessFootprint = &material.roughnessDataSize;
+	params.outRoughnessTexWidth = &material.roughnessTexX;
+	params.outRoughnessTexHeight = &material.roughnessTexY;
+
+	params.outUniformMaterial = &material.isUniform;
+	params.outUniformSPD = &material.uniformSPD;
+	params.outUniformRoughness = &material.uniformRoughness;
+	params.inMaterialID = mirror.NumModels(); // One material per model, for now (we have no way to support multi-material models)
+
+	if (model.fmt == OBJ)
+	{
+		GeoLoader::LoadObj(model.path, params);
+	}
+	else if (model.fmt == DXRS)
+	{
+		GeoLoader::LoadDXRS(model.path, params);
+	}
+
+	mirror.AddModel(numModelVts, ndces, numModelNdces, material);
+}
+
+void FreeMaterialTextures(const Material& material)
+{
+	if (material.roughnessData.handle != CPUMemory::emptyAllocHandle)
+	{
+		CPUMemory::Free(material.roughnessData);
+	}
+
+	if (material.spectralData.handle != CPUMemory::emptyAllocHandle)
+	{
+		CPUMemory::Free(material.spectralData);
+	}
+}
+
+void FitSceneBounds(Scene& scene, const SceneBuffers& mirror)
+{
+	const GeoTypes::Vertex3D* vts = reinterpret_cast<const GeoTypes::Vertex3D*>(&mirror.BufferContents(SceneBuffers::VBUFFER)[0]);
+	for (uint32_t j = 0; j < scene.numModels; j++)
+	{
+		if (mirror.ModelNumVerts(j) > 0)
+		{
+			float4 meshMin, meshMax;
+			VertexBounds(&vts[mirror.ModelFirstVert(j)].pos, mirror.ModelNumVerts(j), sizeof(GeoTypes::Vertex3D), &meshMin, &meshMax);
+			scene.graph.SetMeshBounds(scene.graph.NodeMesh(j), meshMin, meshMax);
+		}
+	}
+
+	scene.UpdateTransforms();
+
+	float4 sceneMin = float4(std::numeric_limits<float>::infinity(), std::numeric_limits<float>::infinity(), std::numeric_limits<float>::infinity(), 0.0f);
+	float4 sceneMax = float4(-std::numeric_limits<float>::infinity(), -std::numeric_limits<float>::infinity(), -std::numeric_limits<float>::infinity(), 0.0f);
+	for (uint32_t j = 0; j < scene.numModels; j++)
+	{
+		if (mirror.ModelNumVerts(j) > 0)
+		{
+			float4 modelMin, modelMax;
+			TransformedVertexBounds(&vts[mirror.ModelFirstVert(j)].pos, mirror.ModelNumVerts(j), sizeof(GeoTypes::Vertex3D), scene.graph.GetWorldTransform(j), &modelMin, &modelMax);
+			BoundsUnion(&sceneMin, &sceneMax, modelMin, modelMax);
+		}
+	}
+
+	if (mirror.NumVerts() > 0)
+	{
+		scene.sceneBoundsMin = sceneMin;
+		scene.sceneBoundsMax = sceneMax;
+	}
+}
+
+void LoadScene(Scene& scene, SceneBuffers& mirror, uint64_t maxVerts, uint64_t maxTris)
+{
+	mirror.Init(maxVerts, maxTris, MAX_SUPPORTED_OBJ_TRANSFORMS);
+
+	// Allocated after [mirror], so freeing it doesn't move anything
+	CPUMemory::ArrayAllocHandle<uint64_t> ndces = CPUMemory::AllocateArray<uint64_t>(maxTris * 3);
+	for (uint32_t i = 0; i < scene.numModels; i++)
+	{
+		LoadSceneModel(mirror, scene.models[i], &ndces[0]);
+	}
+	CPUMemory::Free(ndces);
+
+	mirror.ClearPatches();
+	FitSceneBounds(scene, mirror);
+}
@@ -0,0 +1,24 @@
+#pragma once
+
+#include <stdint.h>
+#include "Scene.h"
+#include "SceneBuffers.h"
+#include "Materials.h"
+
+// CPU-side scene loading (model files into SceneBuffers mirrors, bounds fitting), without Geo's GPU resources; Geo builds its scene
+// mirrors through these, and so does the headless tracer (see HeadlessTracer/)
+
+// Load [model] into the end of [mirror] (vertices in-place, indices through [ndces], which needs room for every index the model has)
+void LoadSceneModel(SceneBuffers& mirror, const Scene::Model& model, uint64_t* ndces);
+
+// Free the textures owned by [material] (uniform materials have none)
+void FreeMaterialTextures(const Material& material);
+
+// Fit mesh bounds in the scene graph to loaded geometry (replacing the placeholder cubes it starts with), then tighten the scene's
+// bounds against transformed vertices; the scene graph's per-instance boxes are conservative under rotation, but the bounds we hand
+// to AS builds/ray culling should be exact
+void FitSceneBounds(Scene& scene, const SceneBuffers& mirror);
+
+// Initialize [mirror] and load every model in [scene] into it, then fit the scene's bounds (with nothing left to patch)
+// Loader scratch is allocated and freed here, so [mirror] is the only allocation left behind
+void LoadScene(Scene& scene, SceneBuffers& mirror, uint64_t maxVerts, uint64_t maxTris);
@@ -0,0 +1,650 @@
+#include "SceneQuery.h"
+#include "SceneBuffers.h"
+#include "SceneGraph.h"
+#include "Intersection.h"
+
+#include <algorithm>
+#include <cassert>
+#include <limits>
+#include <thread>
+
+// Below this many queries per thread, spawning threads costs more than it saves
+constexpr uint32_t minQueriesPerThread = 64;
+
+// Past this depth the builder stops trusting midpoint splits and always splits at the object median, which bounds the remaining depth by
+// log2(triangle count); traversal stacks are sized from both
+constexpr uint32_t maxMidpointDepth = 48;
+constexpr uint32_t maxStackDepth = maxMidpointDepth + 64;
+
+constexpr float infinity = std::numeric_limits<float>::infinity();
+
+// SQT -> world, same convention as SceneGraph/Bounds (v' = q * v * q^-1)
+static Vec3 TransformPoint(const transform& xform, Vec3 p)
+{
+	const float x = xform.rotation.x, y = xform.rotation.y, z = xform.rotation.z, w = xform.rotation.w;
+	const float s = xform.translationAndScale.w;
+	const Vec3 c0 = { (1.0f - 2.0f * (y * y + z * z)) * s, 2.0f * (x * y + w * z) * s, 2.0f * (x * z - w * y) * s };
+	const Vec3 c1 = { 2.0f * (x * y - w * z) * s, (1.0f - 2.0f * (x * x + z * z)) * s, 2.0f * (y * z + w * x) * s };
+	const Vec3 c2 = { 2.0f * (x * z + w * y) * s, 2.0f * (y * z - w * x) * s, (1.0f - 2.0f * (x * x + y * y)) * s };
+	const Vec3 t = { xform.translationAndScale.x, xform.translationAndScale.y, xform.translationAndScale.z };
+	return Add3(t, Add3(Scale3(c0, p.x), Add3(Scale3(c1, p.y), Scale3(c2, p.z))));
+}
+
+void SceneQuery::Build(const SceneBuffers& buffers, const SceneGraph& graph)
+{
+	numTris = static_cast<uint32_t>(buffers.NumTris());
+	const uint32_t maxNodes = std::max(numTris * 2, 1u); // 2n - 1 for binary trees with single-triangle leaves
+
+	nodes = CPUMemory::AllocateArray<Node>(maxNodes);
+	tris = CPUMemory::AllocateArray<WorldTri>(std::max(numTris, 1u));
+	triIDs = CPUMemory::AllocateArray<uint32_t>(std::max(numTris, 1u));
+	triSlots = CPUMemory::AllocateArray<uint32_t>(std::max(numTris, 1u));
+	triModels = CPUMemory::AllocateArray<uint32_t>(std::max(numTris, 1u));
+
+	// Build scratch (freed in reverse order at the end, so frees stay cheap)
+	struct BuildTask
+	{
+		uint32_t node, first, count, depth;
+	};
+	auto worldTris = CPUMemory::AllocateArray<WorldTri>(std::max(numTris, 1u));
+	auto centroids = CPUMemory::AllocateArray<float4>(std::max(numTris, 1u));
+	auto tasks = CPUMemory::AllocateArray<BuildTask>(maxNodes);
+
+	Node* nodeData = &nodes[0];
+	WorldTri* world = &worldTris[0];
+	float4* cents = &centroids[0];
+	uint32_t* ids = &triIDs[0];
+	uint32_t* models = &triModels[0];
+
+	// Bake world-space triangles, model by model
+	const GeoTypes::Vertex3D* vts = reinterpret_cast<const GeoTypes::Vertex3D*>(&buffers.BufferContents(SceneBuffers::VBUFFER)[0]);
+	const IndexedTriangle* sceneTris = reinterpret_cast<const IndexedTriangle*>(&buffers.BufferContents(SceneBuffers::TRIBUFFER)[0]);
+	for (uint32_t m = 0; m < buffers.NumModels(); m++)
+	{
+		const transform xform = graph.GetWorldTransform(m); // Models are the first [numModels] nodes in the scene graph
+		const uint64_t firstTri = buffers.ModelFirstTri(m);
+		for (uint64_t t = firstTri; t < firstTri + buffers.ModelNumTris(m); t++)
+		{
+			const uint32_t ndces[3] = { sceneTris[t].xyz.x, sceneTris[t].xyz.y, sceneTris[t].xyz.z };
+			float4* dst[3] = { &world[t].v0, &world[t].v1, &world[t].v2 };
+			for (uint32_t k = 0; k < 3; k++)
+			{
+				const Vec3 p = TransformPoint(xform, ToVec3(vts[ndces[k]].pos));
+				*dst[k] = float4(p.x, p.y, p.z, 0.0f);
+			}
+
+			cents[t] = float4((world[t].v0.x + world[t].v1.x + world[t].v2.x) / 3.0f,
+							  (world[t].v0.y + world[t].v1.y + world[t].v2.y) / 3.0f,
+							  (world[t].v0.z + world[t].v1.z + world[t].v2.z) / 3.0f, 0.0f);
+			models[t] = m;
+			ids[t] = static_cast<uint32_t>(t);
+		}
+	}
+
+	// Build the BVH top-down, depth-first; sibling pairs are allocated together so interior nodes only need one child index
+	BuildTask* taskStack = &tasks[0];
+	uint32_t numTasks = 0;
+	taskStack[numTasks++] = { 0, 0, numTris, 0 };
+	numNodes = 1;
+	while (numTasks > 0)
+	{
+		const BuildTask task = taskStack[--numTasks];
+		Node& node = nodeData[task.node];
+
+		// Bounds over triangles + centroids
+		float bmin[3] = { infinity, infinity, infinity }, bmax[3] = { -infinity, -infinity, -infinity };
+		float cmin[3] = { infinity, infinity, infinity }, cmax[3] = { -infinity, -infinity, -infinity };
+		for (uint32_t i = task.first; i < task.first + task.count; i++)
+		{
+			const WorldTri& tri = world[ids[i]];
+			const float* c = &cents[ids[i]].x;
+			for (uint32_t a = 0; a < 3; a++)
+			{
+				bmin[a] = std::min({ bmin[a], (&tri.v0.x)[a], (&tri.v1.x)[a], (&tri.v2.x)[a] });
+				bmax[a] = std::max({ bmax[a], (&tri.v0.x)[a], (&tri.v1.x)[a], (&tri.v2.x)[a] });
+				cmin[a] = std::min(cmin[a], c[a]);
+				cmax[a] = std::max(cmax[a], c[a]);
+			}
+		}
+
+		for (uint32_t a = 0; a < 3; a++)
+		{
+			node.bmin[a] = bmin[a];
+			node.bmax[a] = bmax[a];
+		}
+
+		if (task.count <= maxLeafTris)
+		{
+			node.leftFirst = task.first;
+			node.numTris = task.count;
+			continue;
+		}
+
+		// Split at the middle of the widest centroid axis...
+		const float extents[3] = { cmax[0] - cmin[0], cmax[1] - cmin[1], cmax[2] - cmin[2] };
+		const uint32_t axis = (extents[0] > extents[1]) ? ((extents[0] > extents[2]) ? 0 : 2) : ((extents[1] > extents[2]) ? 1 : 2);
+		const float splitPos = cmin[axis] + extents[axis] * 0.5f;
+
+		uint32_t* rangeBegin = ids + task.first;
+		uint32_t* rangeEnd = rangeBegin + task.count;
+		uint32_t* mid = rangeBegin;
+		if (task.depth < maxMidpointDepth)
+		{
+			mid = std::partition(rangeBegin, rangeEnd, [&](uint32_t id) { return (&cents[id].x)[axis] < splitPos; });
+		}
+
+		// ...unless that leaves a side empty (or we're suspiciously deep), in which case split at the object median instead
+		if (mid == rangeBegin || mid == rangeEnd)
+		{
+			mid = rangeBegin + task.count / 2;
+			std::nth_element(rangeBegin, mid, rangeEnd, [&](uint32_t a, uint32_t b) { return (&cents[a].x)[axis] < (&cents[b].x)[axis]; });
+		}
+
+		const uint32_t leftCount = static_cast<uint32_t>(mid - rangeBegin);
+		node.leftFirst = numNodes;
+		node.numTris = 0;
+		taskStack[numTasks++] = { numNodes + 1, task.first + leftCount, task.count - leftCount, task.depth + 1 };
+		taskStack[numTasks++] = { numNodes, task.first, leftCount, task.depth + 1 };
+		numNodes += 2;
+	}
+	assert(numNodes <= maxNodes);
+
+	// Store triangles in BVH order
+	WorldTri* ordered = &tris[0];
+	uint32_t* slots = &triSlots[0];
+	for (uint32_t i = 0; i < numTris; i++)
+	{
+		ordered[i] = world[ids[i]];
+		slots[ids[i]] = i;
+	}
+
+	CPUMemory::Free(tasks);
+	CPUMemory::Free(centroids);
+	CPUMemory::Free(worldTris);
+}
+
+void SceneQuery::DeInit()
+{
+	CPUMemory::Free(triModels);
+	CPUMemory::Free(triSlots);
+	CPUMemory::Free(triIDs);
+	CPUMemory::Free(tris);
+	CPUMemory::Free(nodes);
+
+	numTris = 0;
+	numNodes = 0;
+}
+
+bool SceneQuery::ClosestHit(const Ray& ray, Hit* outHit) const
+{
+	outHit->t = ray.tMax;
+	outHit->u = 0.0f;
+	outHit->v = 0.0f;
+	outHit->tri = invalidTri;
+	if (numTris == 0)
+	{
+		return false;
+	}
+
+	const RayPrecomp rp = PrecomputeRay(ray.origin, ray.dir);
+	const Node* nodeData = &nodes[0];
+	const WorldTri* triData = &tris[0];
+
+	float entry;
+	if (!RayBox(nodeData[0].bmin, nodeData[0].bmax, rp, ray.tMin, ray.tMax, &entry))
+	{
+		return false;
+	}
+
+	// Near child first; far children wait on the stack with their entry distances, so they can be skipped once something closer is hit
+	uint32_t stackNodes[maxStackDepth];
+	float stackEntries[maxStackDepth];
+	uint32_t stackSize = 0;
+
+	float tMax = ray.tMax;
+	uint32_t hitSlot = invalidTri;
+	uint32_t nodeNdx = 0;
+	while (true)
+	{
+		const Node& node = nodeData[nodeNdx];
+		if (node.numTris > 0)
+		{
+			for (uint32_t i = node.leftFirst; i < node.leftFirst + node.numTris; i++)
+			{
+				float t, u, v;
+				if (RayTriangle(rp, triData[i].v0, triData[i].v1, triData[i].v2, ray.tMin, tMax, &t, &u, &v) && (hitSlot == invalidTri || t < tMax))
+				{
+					tMax = t;
+					hitSlot = i;
+					outHit->t = t;
+					outHit->u = u;
+					outHit->v = v;
+				}
+			}
+		}
+		else
+		{
+			const uint32_t left = node.leftFirst, right = node.leftFirst + 1;
+			float leftEntry, rightEntry;
+			const bool hitLeft = RayBox(nodeData[left].bmin, nodeData[left].bmax, rp, ray.tMin, tMax, &leftEntry);
+			const bool hitRight = RayBox(nodeData[right].bmin, nodeData[right].bmax, rp, ray.tMin, tMax, &rightEntry);
+			if (hitLeft && hitRight)
+			{
+				const bool leftFirst = leftEntry <= rightEntry;
+				stackNodes[stackSize] = leftFirst ? right : left;
+				stackEntries[stackSize] = leftFirst ? rightEntry : leftEntry;
+				stackSize++;
+				nodeNdx = leftFirst ? left : right;
+				continue;
+			}
+			else if (hitLeft || hitRight)
+			{
+				nodeNdx = hitLeft ? left : right;
+				continue;
+			}
+		}
+
+		// Pop the next candidate that could still beat the closest hit
+		bool found = false;
+		while (stackSize > 0)
+		{
+			stackSize--;
+			if (stackEntries[stackSize] <= tMax)
+			{
+				nodeNdx = stackNodes[stackSize];
+				found = true;
+				break;
+			}
+		}
+
+		if (!found)
+		{
+			break;
+		}
+	}
+
+	if (hitSlot != invalidTri)
+	{
+		outHit->tri = triIDs[hitSlot];
+		return true;
+	}
+	return false;
+}
+
+bool SceneQuery::AnyHit(const Ray& ray) const
+{
+	if (numTris == 0)
+	{
+		return false;
+	}
+
+	const RayPrecomp rp = PrecomputeRay(ray.origin, ray.dir);
+	const Node* nodeData = &nodes[0];
+	const WorldTri* triData = &tris[0];
+
+	uint32_t stack[maxStackDepth];
+	uint32_t stackSize = 0;
+	stack[stackSize++] = 0;
+	while (stackSize > 0)
+	{
+		const Node& node = nodeData[stack[--stackSize]];
+
+		float entry;
+		if (!RayBox(node.bmin, node.bmax, rp, ray.tMin, ray.tMax, &entry))
+		{
+			continue;
+		}
+
+		if (node.numTris > 0)
+		{
+			for (uint32_t i = node.leftFirst; i < node.leftFirst + node.numTris; i++)
+			{
+				float t, u, v;
+				if (RayTriangle(rp, triData[i].v0, triData[i].v1, triData[i].v2, ray.tMin, ray.tMax, &t, &u, &v))
+				{
+					return true;
+				}
+			}
+		}
+		else
+		{
+			stack[stackSize++] = node.leftFirst + 1;
+			stack[stackSize++] = node.leftFirst;
+		}
+	}
+
+	return false;
+}
+
+void SceneQuery::SubtreeRange(const Node& node, uint32_t* outFirst, uint32_t* outEnd) const
+{
+	// Subtrees own contiguous triangle ranges (the builder partitions in place), bounded by their leftmost/rightmost leaves
+	const Node* nodeData = &nodes[0];
+	const Node* first = &node;
+	while (first->numTris == 0)
+	{
+		first = &nodeData[first->leftFirst];
+	}
+
+	const Node* last = &node;
+	while (last->numTris == 0)
+	{
+		last = &nodeData[last->leftFirst + 1];
+	}
+
+	*outFirst = first->leftFirst;
+	*outEnd = last->leftFirst + last->numTris;
+}
+
+uint32_t SceneQuery::OverlapAABB(float4 boxMin, float4 boxMax, uint32_t* outTris, uint32_t maxTris) const
+{
+	if (numTris == 0)
+	{
+		return 0;
+	}
+
+	const Vec3 center = { (boxMin.x + boxMax.x) * 0.5f, (boxMin.y + boxMax.y) * 0.5f, (boxMin.z + boxMax.z) * 0.5f };
+	const Vec3 halfExtents = { (boxMax.x - boxMin.x) * 0.5f, (boxMax.y - boxMin.y) * 0.5f, (boxMax.z - boxMin.z) * 0.5f };
+	const float qmin[3] = { boxMin.x, boxMin.y, boxMin.z }, qmax[3] = { boxMax.x, boxMax.y, boxMax.z };
+
+	const Node* nodeData = &nodes[0];
+	const WorldTri* triData = &tris[0];
+
+	uint32_t numFound = 0;
+	auto emit = [&](uint32_t slot)
+	{
+		if (outTris != nullptr && numFound < maxTris)
+		{
+			outTris[numFound] = triIDs[slot];
+		}
+		numFound++;
+	};
+
+	uint32_t stack[maxStackDepth];
+	uint32_t stackSize = 0;
+	stack[stackSize++] = 0;
+	while (stackSize > 0)
+	{
+		const Node& node = nodeData[stack[--stackSize]];
+		if (node.bmin[0] > qmax[0] || node.bmin[1] > qmax[1] || node.bmin[2] > qmax[2] ||
+			node.bmax[0] < qmin[0] || node.bmax[1] < qmin[1] || node.bmax[2] < qmin[2])
+		{
+			continue;
+		}
+
+		// Everything under nodes inside the box overlaps it, so large boxes skip most per-triangle tests
+		if (node.bmin[0] >= qmin[0] && node.bmin[1] >= qmin[1] && node.bmin[2] >= qmin[2] &&
+			node.bmax[0] <= qmax[0] && node.bmax[1] <= qmax[1] && node.bmax[2] <= qmax[2])
+		{
+			uint32_t first, end;
+			SubtreeRange(node, &first, &end);
+			for (uint32_t i = first; i < end; i++)
+			{
+				emit(i);
+			}
+			continue;
+		}
+
+		if (node.numTris > 0)
+		{
+			for (uint32_t i = node.leftFirst; i < node.leftFirst + node.numTris; i++)
+			{
+				if (TriangleBoxOverlap(center, halfExtents, triData[i].v0, triData[i].v1, triData[i].v2))
+				{
+					emit(i);
+				}
+			}
+		}
+		else
+		{
+			stack[stackSize++] = node.leftFirst + 1;
+			stack[stackSize++] = node.leftFirst;
+		}
+	}
+
+	return numFound;
+}
+
+uint32_t SceneQuery::FrustumCull(const Frustum& frustum, uint32_t* outTris, uint32_t maxTris) const
+{
+	if (numTris == 0)
+	{
+		return 0;
+	}
+
+	const Node* nodeData = &nodes[0];
+	const WorldTri* triData = &tris[0];
+
+	uint32_t numFound = 0;
+	auto emit = [&](uint32_t slot)
+	{
+		if (outTris != nullptr && numFound < maxTris)
+		{
+			outTris[numFound] = triIDs[slot];
+		}
+		numFound++;
+	};
+
+	uint32_t stack[maxStackDepth];
+	uint32_t stackSize = 0;
+	stack[stackSize++] = 0;
+	while (stackSize > 0)
+	{
+		const Node& node = nodeData[stack[--stackSize]];
+
+		// Classify against each plane through the box corners furthest along/against its normal
+		bool outside = false, inside = true;
+		for (const float4& plane : frustum.planes)
+		{
+			const float n[3] = { plane.x, plane.y, plane.z };
+			float farDist = plane.w, nearDist = plane.w;
+			for (uint32_t a = 0; a < 3; a++)
+			{
+				farDist += n[a] * ((n[a] >= 0.0f) ? node.bmax[a] : node.bmin[a]);
+				nearDist += n[a] * ((n[a] >= 0.0f) ? node.bmin[a] : node.bmax[a]);
+			}
+
+			outside |= (farDist < 0.0f);
+			inside &= (nearDist >= 0.0f);
+		}
+
+		if (outside)
+		{
+			continue;
+		}
+
+		if (inside)
+		{
+			uint32_t first, end;
+			SubtreeRange(node, &first, &end);
+			for (uint32_t i = first; i < end; i++)
+			{
+				emit(i);
+			}
+			continue;
+		}
+
+		if (node.numTris > 0)
+		{
+			for (uint32_t i = node.leftFirst; i < node.leftFirst + node.numTris; i++)
+			{
+				bool culled = false;
+				for (const float4& plane : frustum.planes)
+				{
+					const Vec3 n = ToVec3(plane);
+					culled |= (Dot3(n, ToVec3(triData[i].v0)) + plane.w < 0.0f) &&
+							  (Dot3(n, ToVec3(triData[i].v1)) + plane.w < 0.0f) &&
+							  (Dot3(n, ToVec3(triData[i].v2)) + plane.w < 0.0f);
+				}
+
+				if (!culled)
+				{
+					emit(i);
+				}
+			}
+		}
+		else
+		{
+			stack[stackSize++] = node.leftFirst + 1;
+			stack[stackSize++] = node.leftFirst;
+		}
+	}
+
+	return numFound;
+}
+
+uint32_t SceneQuery::KNearest(float4 point, uint32_t k, Nearest* outNearest) const
+{
+	k = std::min(k, maxNearest);
+	if (numTris == 0 || k == 0)
+	{
+		return 0;
+	}
+
+	const Vec3 p = ToVec3(point);
+	const Node* nodeData = &nodes[0];
+	const WorldTri* triData = &tris[0];
+
+	// Results stay sorted nearest-first; once we have [k], anything further than the last one is pruned
+	uint32_t numFound = 0;
+	auto cutoff = [&]() { return (numFound == k) ? outNearest[k - 1].distSq : infinity; };
+
+	uint32_t stackNodes[maxStackDepth];
+	float stackDists[maxStackDepth];
+	uint32_t stackSize = 0;
+
+	uint32_t nodeNdx = 0;
+	while (true)
+	{
+		const Node& node = nodeData[nodeNdx];
+		if (node.numTris > 0)
+		{
+			for (uint32_t i = node.leftFirst; i < node.leftFirst + node.numTris; i++)
+			{
+				const float distSq = PointTriangleDistSq(p, triData[i].v0, triData[i].v1, triData[i].v2);
+				if (numFound < k || distSq < outNearest[k - 1].distSq)
+				{
+					uint32_t j = (numFound < k) ? numFound++ : (k - 1);
+					while (j > 0 && outNearest[j - 1].distSq > distSq)
+					{
+						outNearest[j] = outNearest[j - 1];
+						j--;
+					}
+					outNearest[j] = { distSq, triIDs[i] };
+				}
+			}
+		}
+		else
+		{
+			const uint32_t left = node.leftFirst, right = node.leftFirst + 1;
+			const float leftDist = PointBoxDistSq(p, nodeData[left].bmin, nodeData[left].bmax);
+			const float rightDist = PointBoxDistSq(p, nodeData[right].bmin, nodeData[right].bmax);
+			const float maxDist = cutoff();
+			const bool visitLeft = leftDist <= maxDist, visitRight = rightDist <= maxDist;
+			if (visitLeft && visitRight)
+			{
+				const bool leftFirst = leftDist <= rightDist;
+				stackNodes[stackSize] = leftFirst ? right : left;
+				stackDists[stackSize] = leftFirst ? rightDist : leftDist;
+				stackSize++;
+				nodeNdx = leftFirst ? left : right;
+				continue;
+			}
+			else if (visitLeft || visitRight)
+			{
+				nodeNdx = visitLeft ? left : right;
+				continue;
+			}
+		}
+
+		bool found = false;
+		while (stackSize > 0)
+		{
+			stackSize--;
+			if (stackDists[stackSize] <= cutoff())
+			{
+				nodeNdx = stackNodes[stackSize];
+				found = true;
+				break;
+			}
+		}
+
+		if (!found)
+		{
+			break;
+		}
+	}
+
+	return numFound;
+}
+
+template<typename queryFn>
+void SceneQuery::RunBatch(uint32_t numQueries, uint32_t numThreads, queryFn fn) const
+{
+	if (numThreads == 0)
+	{
+		numThreads = std::max(std::thread::hardware_concurrency(), 1u);
+	}
+	numThreads = std::min({ numThreads, 64u, std::max(numQueries / minQueriesPerThread, 1u) });
+
+	if (numThreads <= 1)
+	{
+		fn(0u, numQueries);
+		return;
+	}
+
+	std::thread threads[64] = {};
+	const uint32_t queriesPerThread = numQueries / numThreads;
+	for (uint32_t t = 0; t < numThreads; t++)
+	{
+		const uint32_t first = t * queriesPerThread;
+		const uint32_t num = (t == numThreads - 1) ? (numQueries - first) : queriesPerThread;
+		threads[t] = std::thread(fn, first, num);
+	}
+
+	for (uint32_t t = 0; t < numThreads; t++)
+	{
+		threads[t].join();
+	}
+}
+
+void SceneQuery::ClosestHitBatch(const Ray* rays, Hit* outHits, uint32_t numRays, uint32_t numThreads) const
+{
+	RunBatch(numRays, numThreads, [=, this](uint32_t first, uint32_t num)
+	{
+		for (uint32_t i = first; i < first + num; i++)
+		{
+			ClosestHit(rays[i], outHits + i);
+		}
+	});
+}
+
+void SceneQuery::AnyHitBatch(const Ray* rays, bool* outOccluded, uint32_t numRays, uint32_t numThreads) const
+{
+	RunBatch(numRays, numThreads, [=, this](uint32_t first, uint32_t num)
+	{
+		for (uint32_t i = first; i < first + num; i++)
+		{
+			outOccluded[i] = AnyHit(rays[i]);
+		}
+	});
+}
+
+void SceneQuery::KNearestBatch(const float4* points, uint32_t k, Nearest* outNearest, uint32_t* outNumFound, uint32_t numPoints, uint32_t numThreads) const
+{
+	RunBatch(numPoints, numThreads, [=, this](uint32_t first, uint32_t num)
+	{
+		for (uint32_t i = first; i < first + num; i++)
+		{
+			outNumFound[i] = KNearest(points[i], k, outNearest + static_cast<uint64_t>(i) * k);
+		}
+	});
+}
+
+void SceneQuery::GetTriangle(uint32_t tri, float4* outVerts) const
+{
+	const WorldTri& worldTri = tris[triSlots[tri]];
+	outVerts[0] = worldTri.v0;
+	outVerts[1] = worldTri.v1;
+	outVerts[2] = worldTri.v2;
+}
@@ -0,0 +1,113 @@
+#pragma once
+
+#include <stdint.h>
+#include "../CPUMemory.h"
+#include "../Math.h"
+
+class SceneBuffers;
+class SceneGraph;
+
+// CPU-side spatial queries over a loaded scene (editor picking, camera collision, brush painting)
+// - Built from a scene's buffer mirror (see SceneBuffers, e.g. [Geo::SceneMirror]) and scene graph; triangles are baked into world
+//   space, so rebuild after edits/moves
+// - Backed by a binary BVH over world-space triangles; nodes split at the middle of their widest centroid axis (falling back to an
+//   object-median split when that leaves a side empty), with up to [maxLeafTris] triangles per leaf
+// - Queries are const + allocation-free, so any number of threads can run them at once (as long as nothing allocates/frees through
+//   CPUMemory meanwhile); the batch variants split their inputs across hardware threads
+// - Triangle IDs match the scene tribuffer (see [SceneBuffers]); [TriModel] maps them back to models
+class SceneQuery
+{
+	public:
+		static constexpr uint32_t invalidTri = UINT32_MAX;
+		static constexpr uint32_t maxLeafTris = 4;
+		static constexpr uint32_t maxNearest = 64;
+
+		struct Ray
+		{
+			float4 origin; // w unused
+			float4 dir; // w unused; needn't be normalized (distances are in units of |dir|)
+			float tMin, tMax;
+		};
+
+		struct Hit
+		{
+			float t;
+			float u, v; // Barycentric weights for the triangle's second/third vertices
+			uint32_t tri;
+		};
+
+		// Planes as (normal, offset); points are inside a plane when dot(normal, p) + offset >= 0
+		struct Frustum
+		{
+			float4 planes[6];
+		};
+
+		struct Nearest
+		{
+			float distSq;
+			uint32_t tri;
+		};
+
+		void Build(const SceneBuffers& buffers, const SceneGraph& graph);
+		void DeInit();
+
+		// Nearest intersection within [tMin, tMax]; misses return false, with [outHit->tri] set to [invalidTri]
+		// Intersections are watertight (Woop et al. 2013), so rays can't slip between triangles sharing an edge
+		bool ClosestHit(const Ray& ray, Hit* outHit) const;
+
+		// Whether anything intersects the ray within [tMin, tMax] (occlusion/shadow rays)
+		bool AnyHit(const Ray& ray) const;
+
+		// Triangles touching the box (exact separating-axis test); writes up to [maxTris] IDs into [outTris] (which may be null, to
+		// count them first) and returns how many there were in total
+		uint32_t OverlapAABB(float4 boxMin, float4 boxMax, uint32_t* outTris, uint32_t maxTris) const;
+
+		// Triangles which might be inside the frustum; triangles are culled when all three vertices sit outside the same plane, so
+		// large triangles straddling a frustum's corners can pass (outputs work as for [OverlapAABB])
+		uint32_t FrustumCull(const Frustum& frustum, uint32_t* outTris, uint32_t maxTris) const;
+
+		// The [k] triangles closest to [point] (k <= [maxNearest]), nearest-first; returns how many were found (fewer than [k] for
+		// very small scenes)
+		uint32_t KNearest(float4 point, uint32_t k, Nearest* outNearest) const;
+
+		// Batched queries, split into contiguous ranges across [numThreads] threads (zero for one per hardware thread)
+		// [KNearestBatch] writes [k] results per point into [outNearest], and how many were found into [outNumFound]
+		void ClosestHitBatch(const Ray* rays, Hit* outHits, uint32_t numRays, uint32_t numThreads = 0) const;
+		void AnyHitBatch(const Ray* rays, bool* outOccluded, uint32_t numRays, uint32_t numThreads = 0) const;
+		void KNearestBatch(const float4* points, uint32_t k, Nearest* outNearest, uint32_t* outNumFound, uint32_t numPoints, uint32_t numThreads = 0) const;
+
+		uint32_t NumTris() const { return numTris; }
+		uint32_t NumNodes() const { return numNodes; }
+		uint32_t TriModel(uint32_t tri) const { return triModels[tri]; }
+		void GetTriangle(uint32_t tri, float4* outVerts) const; // World-space, three vertices
+
+	private:
+		struct Node
+		{
+			float bmin[3];
+			uint32_t leftFirst; // Left child for interior nodes (the right child follows it), first triangle for leaves
+			float bmax[3];
+			uint32_t numTris; // Zero for interior nodes
+		};
+
+		// World-space vertices, stored in BVH order so leaves read their triangles contiguously
+		struct WorldTri
+		{
+			float4 v0, v1, v2;
+		};
+
+		// Triangles (in BVH order) under [node], as [first, end)
+		void SubtreeRange(const Node& node, uint32_t* outFirst, uint32_t* outEnd) const;
+
+		template<typename queryFn>
+		void RunBatch(uint32_t numQueries, uint32_t numThreads, queryFn fn) const;
+
+		CPUMemory::ArrayAllocHandle<Node> nodes;
+		CPUMemory::ArrayAllocHandle<WorldTri> tris; // BVH order
+		CPUMemory::ArrayAllocHandle<uint32_t> triIDs; // BVH order -> tribuffer order
+		CPUMemory::ArrayAllocHandle<uint32_t> triSlots; // Tribuffer order -> BVH order
+		CPUMemory::ArrayAllocHandle<uint32_t> triModels; // Tribuffer order
+
+		uint32_t numTris = 0;
+		uint32_t numNodes = 0;
+};
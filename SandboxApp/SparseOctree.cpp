@@ -0,0 +1,485 @@
+#include "SparseOctree.h"
+#include "Bounds.h"
+#include "Intersection.h"
+
+#include <algorithm>
+#include <bit>
+#include <cassert>
+#include <cstring>
+#include <thread>
+
+// Below these amounts of work per thread, spawning threads costs more than it saves
+constexpr uint64_t minRefsPerThread = 4096;
+constexpr uint64_t minCellsPerThread = 256;
+
+// Cells for the level being built; their triangle references are contiguous in the level's reference array, and their bounds live in
+// their nodes (written by the parent level)
+struct Cell
+{
+	uint32_t firstRef;
+	uint32_t numRefs;
+	uint32_t firstChildRef; // Children's references in the next level (branches only)
+};
+
+// Split [numItems] into contiguous ranges across up to [numThreads] threads, calling [fn(first, end)] for each
+template<typename rangeFn>
+static void ParallelRanges(uint64_t numItems, uint64_t minItemsPerThread, uint32_t numThreads, rangeFn fn)
+{
+	numThreads = static_cast<uint32_t>(std::min<uint64_t>({ numThreads, 64u, std::max<uint64_t>(numItems / minItemsPerThread, 1u) }));
+	if (numThreads <= 1)
+	{
+		fn(uint64_t(0), numItems);
+		return;
+	}
+
+	std::thread threads[64] = {};
+	const uint64_t itemsPerThread = numItems / numThreads;
+	for (uint32_t t = 0; t < numThreads; t++)
+	{
+		const uint64_t first = t * itemsPerThread;
+		const uint64_t end = (t == numThreads - 1) ? numItems : first + itemsPerThread;
+		threads[t] = std::thread(fn, first, end);
+	}
+
+	for (uint32_t t = 0; t < numThreads; t++)
+	{
+		threads[t].join();
+	}
+}
+
+// Output arrays grow as levels land; re-allocated at the back of the allocator, so scratch allocated after them shifts down when the
+// old copy is freed (handles survive that, raw pointers don't)
+template<typename type>
+static void ResizeArray(CPUMemory::ArrayAllocHandle<type>& handle, uint64_t numUsed, uint64_t newLen)
+{
+	auto resized = CPUMemory::AllocateArray<type>(std::max<uint64_t>(newLen, 1));
+	if (numUsed > 0)
+	{
+		memcpy(&resized[0], &handle[0], numUsed * sizeof(type));
+	}
+	CPUMemory::Free(handle);
+	handle = resized;
+}
+
+static void OctantBounds(const ComputeAS_Node& node, const float* mid, uint32_t octant, float* outMin, float* outMax)
+{
+	const float* bmin = &node.boundsMin.x;
+	const float* bmax = &node.boundsMax.x;
+	for (uint32_t a = 0; a < 3; a++)
+	{
+		const bool upper = (octant >> a) & 1;
+		outMin[a] = upper ? mid[a] : bmin[a];
+		outMax[a] = upper ? bmax[a] : mid[a];
+	}
+}
+
+static void NodeMidpoint(const ComputeAS_Node& node, float* outMid)
+{
+	outMid[0] = (node.boundsMin.x + node.boundsMax.x) * 0.5f;
+	outMid[1] = (node.boundsMin.y + node.boundsMax.y) * 0.5f;
+	outMid[2] = (node.boundsMin.z + node.boundsMax.z) * 0.5f;
+}
+
+// Octants of [node] touched by a triangle already known to touch the node
+static uint8_t ClassifyTriangle(const ComputeAS_Node& node, const float* mid, const float4& v0, const float4& v1, const float4& v2)
+{
+	// Candidate octants from the triangle's bounds; a single candidate must be touched, several need exact tests
+	const float triMin[3] = { std::min({ v0.x, v1.x, v2.x }), std::min({ v0.y, v1.y, v2.y }), std::min({ v0.z, v1.z, v2.z }) };
+	const float triMax[3] = { std::max({ v0.x, v1.x, v2.x }), std::max({ v0.y, v1.y, v2.y }), std::max({ v0.z, v1.z, v2.z }) };
+
+	uint32_t lower[3], upper[3];
+	for (uint32_t a = 0; a < 3; a++)
+	{
+		lower[a] = (triMin[a] <= mid[a]) ? 0 : 1;
+		upper[a] = (triMax[a] >= mid[a]) ? 1 : 0;
+	}
+
+	uint8_t candidates = 0;
+	for (uint32_t z = lower[2]; z <= upper[2]; z++)
+	{
+		for (uint32_t y = lower[1]; y <= upper[1]; y++)
+		{
+			for (uint32_t x = lower[0]; x <= upper[0]; x++)
+			{
+				candidates |= 1u << (x + y * 2 + z * 4);
+			}
+		}
+	}
+
+	if ((candidates & (candidates - 1)) == 0)
+	{
+		return candidates;
+	}
+
+	uint8_t mask = 0;
+	for (uint32_t octant = 0; octant < 8; octant++)
+	{
+		if (candidates & (1u << octant))
+		{
+			float octMin[3], octMax[3];
+			OctantBounds(node, mid, octant, octMin, octMax);
+			const Vec3 center = { (octMin[0] + octMax[0]) * 0.5f, (octMin[1] + octMax[1]) * 0.5f, (octMin[2] + octMax[2]) * 0.5f };
+			const Vec3 halfExtents = { (octMax[0] - octMin[0]) * 0.5f, (octMax[1] - octMin[1]) * 0.5f, (octMax[2] - octMin[2]) * 0.5f };
+			if (TriangleBoxOverlap(center, halfExtents, v0, v1, v2))
+			{
+				mask |= 1u << octant;
+			}
+		}
+	}
+
+	// Rounding in the separating-axis test can reject every candidate for triangles grazing the split planes; keep those everywhere
+	// they might be, rather than dropping them from the tree
+	return (mask != 0) ? mask : candidates;
+}
+
+void SparseOctree::Build(const float4* positions, uint64_t numVerts, uint64_t strideBytes, const IndexedTriangle* tris, uint32_t numTris, const Settings& settings)
+{
+	stats = {};
+	const uint32_t maxDepth = std::min(settings.maxDepth, static_cast<uint32_t>(AS_OCTREE_MAX_DEPTH));
+	const uint32_t leafTris = std::max(settings.leafTris, 1u);
+	const uint32_t numThreads = (settings.numThreads == 0) ? std::max(std::thread::hardware_concurrency(), 1u) : settings.numThreads;
+
+	auto vertex = [positions, strideBytes](uint32_t ndx) -> const float4&
+	{
+		return *reinterpret_cast<const float4*>(reinterpret_cast<const uint8_t*>(positions) + ndx * strideBytes);
+	};
+
+	// Nodes start with enough room for most meshes (see [ResizeArray]); each level's leaves go into their own exactly-sized chunk of the
+	// triangle list instead, which get joined once the tree is done (growing one list would briefly hold two copies of it)
+	uint64_t nodeCapacity = std::max<uint64_t>((static_cast<uint64_t>(numTris) / leafTris) * 2, 64);
+	nodes = CPUMemory::AllocateArray<ComputeAS_Node>(nodeCapacity);
+	uint64_t numNodes = 0;
+	CPUMemory::ArrayAllocHandle<uint32_t> leafChunks[AS_OCTREE_MAX_DEPTH + 1] = {};
+	uint64_t leafChunkLens[AS_OCTREE_MAX_DEPTH + 1] = {};
+	triListLen = 0;
+
+	// Root cell spans every vertex, and references every triangle
+	auto cells = CPUMemory::AllocateArray<Cell>(1);
+	auto refs = CPUMemory::AllocateArray<uint32_t>(std::max(numTris, 1u));
+	{
+		float4 rootMin = float4(0.0f, 0.0f, 0.0f, 0.0f), rootMax = float4(0.0f, 0.0f, 0.0f, 0.0f);
+		if (numTris > 0)
+		{
+			VertexBounds(positions, numVerts, strideBytes, &rootMin, &rootMax);
+		}
+
+		// Cubic cells; flat bounds would otherwise split their short axis down to slivers, and every sliver copies the triangles crossing it
+		const float halfSize = std::max({ rootMax.x - rootMin.x, rootMax.y - rootMin.y, rootMax.z - rootMin.z }) * 0.5f;
+		const float boundsMin[3] = { rootMin.x, rootMin.y, rootMin.z }, boundsMax[3] = { rootMax.x, rootMax.y, rootMax.z };
+		float cubeMin[3], cubeMax[3];
+		for (uint32_t a = 0; a < 3; a++)
+		{
+			const float center = (boundsMin[a] + boundsMax[a]) * 0.5f;
+			cubeMin[a] = std::min(center - halfSize, boundsMin[a]); // Rounding shouldn't clip the mesh
+			cubeMax[a] = std::max(center + halfSize, boundsMax[a]);
+		}
+		nodes[0].boundsMin = float3(cubeMin[0], cubeMin[1], cubeMin[2]);
+		nodes[0].boundsMax = float3(cubeMax[0], cubeMax[1], cubeMax[2]);
+
+		cells[0].firstRef = 0;
+		cells[0].numRefs = numTris;
+
+		uint32_t* refData = &refs[0];
+		for (uint32_t i = 0; i < numTris; i++)
+		{
+			refData[i] = i;
+		}
+	}
+
+	// One level at a time: classify references into octants, lay out the level's nodes, then scatter references into the next level
+	// (and child bounds into the next level's nodes)
+	uint64_t numCells = 1;
+	uint64_t numRefs = numTris;
+	for (uint32_t level = 0; numCells > 0; level++)
+	{
+		const bool lastLevel = (level == maxDepth);
+		const uint64_t levelBase = numNodes;
+
+		// Octant masks per reference; cells which end up as leaves either way skip this (and levels with no cells left to split don't
+		// allocate them at all)
+		bool anySplits = false;
+		for (const Cell* cell = &cells[0]; cell < &cells[0] + numCells && !lastLevel && !anySplits; cell++)
+		{
+			anySplits = (cell->numRefs > leafTris);
+		}
+
+		auto masks = CPUMemory::AllocateArray<uint8_t>(anySplits ? std::max<uint64_t>(numRefs, 1) : 1);
+		if (anySplits)
+		{
+			const Cell* cellData = &cells[0];
+			const ComputeAS_Node* nodeData = &nodes[levelBase];
+			const uint32_t* refData = &refs[0];
+			uint8_t* maskData = &masks[0];
+			ParallelRanges(numRefs, minRefsPerThread, numThreads, [=](uint64_t first, uint64_t end)
+			{
+				// Cells are laid out in reference order, so find the first one for this range and walk forward from there
+				uint64_t c = std::upper_bound(cellData, cellData + numCells, first, [](uint64_t ref, const Cell& cell) { return ref < cell.firstRef; }) - cellData - 1;
+				float mid[3];
+				NodeMidpoint(nodeData[c], mid);
+				for (uint64_t r = first; r < end; r++)
+				{
+					while (r >= static_cast<uint64_t>(cellData[c].firstRef) + cellData[c].numRefs)
+					{
+						c++;
+						NodeMidpoint(nodeData[c], mid);
+					}
+
+					if (cellData[c].numRefs > leafTris)
+					{
+						const IndexedTriangle& tri = tris[refData[r]];
+						maskData[r] = ClassifyTriangle(nodeData[c], mid, vertex(tri.xyz.x), vertex(tri.xyz.y), vertex(tri.xyz.z));
+					}
+				}
+			});
+		}
+
+		// Per-cell child masks, and the number of references they pass down
+		{
+			Cell* cellData = &cells[0];
+			ComputeAS_Node* nodeData = &nodes[levelBase];
+			const uint8_t* maskData = &masks[0];
+			ParallelRanges(numCells, minCellsPerThread, numThreads, [=](uint64_t first, uint64_t end)
+			{
+				for (uint64_t c = first; c < end; c++)
+				{
+					Cell& cell = cellData[c];
+					nodeData[c].childMask = 0;
+					cell.firstChildRef = 0;
+					if (!anySplits || cell.numRefs <= leafTris)
+					{
+						continue;
+					}
+
+					uint32_t counts[8] = {};
+					for (uint64_t r = cell.firstRef; r < static_cast<uint64_t>(cell.firstRef) + cell.numRefs; r++)
+					{
+						for (uint32_t octant = 0; octant < 8; octant++)
+						{
+							counts[octant] += (maskData[r] >> octant) & 1;
+						}
+					}
+
+					// Splits stop paying off when every occupied octant inherits all of the cell's triangles (unless there's only one, which
+					// still shrinks the cell around them)
+					uint32_t childMask = 0, childRefs = 0;
+					bool separates = false;
+					for (uint32_t octant = 0; octant < 8; octant++)
+					{
+						if (counts[octant] > 0)
+						{
+							childMask |= 1u << octant;
+							childRefs += counts[octant];
+							separates |= (counts[octant] < cell.numRefs);
+						}
+					}
+					separates |= (childMask & (childMask - 1)) == 0;
+
+					if (separates)
+					{
+						nodeData[c].childMask = childMask;
+						cell.firstChildRef = childRefs; // Becomes an offset during layout
+					}
+				}
+			});
+		}
+
+		// Lay out this level's nodes; children land in the next level in parent order, so each parent's children stay contiguous
+		const uint64_t nextLevelBase = levelBase + numCells;
+		const uint64_t levelTriListBase = triListLen;
+		uint64_t numNextCells = 0, numNextRefs = 0;
+		{
+			Cell* cellData = &cells[0];
+			ComputeAS_Node* nodeData = &nodes[levelBase];
+			for (uint64_t c = 0; c < numCells; c++)
+			{
+				Cell& cell = cellData[c];
+				ComputeAS_Node& node = nodeData[c];
+				if (node.childMask == 0)
+				{
+					assert(triListLen + 1 + cell.numRefs <= UINT32_MAX);
+					node.firstChild = static_cast<uint32_t>(triListLen);
+					triListLen += 1 + cell.numRefs;
+
+					stats.numLeaves++;
+					stats.numTriRefs += cell.numRefs;
+					stats.maxLeafTris = std::max(stats.maxLeafTris, cell.numRefs);
+				}
+				else
+				{
+					node.firstChild = static_cast<uint32_t>(nextLevelBase + numNextCells);
+					numNextCells += std::popcount(node.childMask);
+
+					const uint32_t childRefs = cell.firstChildRef;
+					cell.firstChildRef = static_cast<uint32_t>(numNextRefs);
+					numNextRefs += childRefs;
+				}
+			}
+		}
+		assert(numNextRefs <= UINT32_MAX);
+
+		stats.nodesPerLevel[level] = static_cast<uint32_t>(numCells);
+		stats.depth = level;
+		numNodes += numCells;
+
+		// Make room for the next level's nodes (their bounds are written below), and this level's leaves
+		if (numNodes + numNextCells > nodeCapacity)
+		{
+			nodeCapacity = std::max(nodeCapacity + nodeCapacity / 2, numNodes + numNextCells);
+			ResizeArray(nodes, numNodes, nodeCapacity);
+		}
+
+		leafChunkLens[level] = triListLen - levelTriListBase;
+		if (leafChunkLens[level] > 0)
+		{
+			leafChunks[level] = CPUMemory::AllocateArray<uint32_t>(leafChunkLens[level]);
+		}
+
+		// Scatter references into child cells, or out to the triangle list for leaves
+		auto nextCells = CPUMemory::AllocateArray<Cell>(std::max<uint64_t>(numNextCells, 1));
+		auto nextRefs = CPUMemory::AllocateArray<uint32_t>(std::max<uint64_t>(numNextRefs, 1));
+		{
+			const Cell* cellData = &cells[0];
+			const uint32_t* refData = &refs[0];
+			const uint8_t* maskData = &masks[0];
+			ComputeAS_Node* nodeData = &nodes[0];
+			uint32_t* leafData = (leafChunkLens[level] > 0) ? &leafChunks[level][0] : nullptr;
+			Cell* nextCellData = &nextCells[0];
+			uint32_t* nextRefData = &nextRefs[0];
+			ParallelRanges(numCells, minCellsPerThread, numThreads, [=](uint64_t first, uint64_t end)
+			{
+				for (uint64_t c = first; c < end; c++)
+				{
+					const Cell& cell = cellData[c];
+					const ComputeAS_Node& node = nodeData[levelBase + c];
+					const uint32_t* cellRefs = refData + cell.firstRef;
+					if (node.childMask == 0)
+					{
+						uint32_t* leaf = leafData + (node.firstChild - levelTriListBase);
+						leaf[0] = cell.numRefs;
+						if (cell.numRefs > 0)
+						{
+							memcpy(leaf + 1, cellRefs, cell.numRefs * sizeof(uint32_t));
+						}
+						continue;
+					}
+
+					// Recount per-octant references (cheaper than keeping eight counters per cell around), then hand out child ranges
+					uint32_t cursors[8] = {};
+					for (uint32_t r = 0; r < cell.numRefs; r++)
+					{
+						for (uint32_t octant = 0; octant < 8; octant++)
+						{
+							cursors[octant] += (maskData[cell.firstRef + r] >> octant) & 1;
+						}
+					}
+
+					float mid[3];
+					NodeMidpoint(node, mid);
+					uint32_t nextRef = cell.firstChildRef;
+					uint64_t child = node.firstChild;
+					for (uint32_t octant = 0; octant < 8; octant++)
+					{
+						if (node.childMask & (1u << octant))
+						{
+							float childMin[3], childMax[3];
+							OctantBounds(node, mid, octant, childMin, childMax);
+							nodeData[child].boundsMin = float3(childMin[0], childMin[1], childMin[2]);
+							nodeData[child].boundsMax = float3(childMax[0], childMax[1], childMax[2]);
+
+							Cell& childCell = nextCellData[child - nextLevelBase];
+							childCell.firstRef = nextRef;
+							childCell.numRefs = cursors[octant];
+							cursors[octant] = nextRef;
+							nextRef += childCell.numRefs;
+							child++;
+						}
+					}
+
+					for (uint32_t r = 0; r < cell.numRefs; r++)
+					{
+						const uint8_t mask = maskData[cell.firstRef + r];
+						for (uint32_t octant = 0; octant < 8; octant++)
+						{
+							if (mask & (1u << octant))
+							{
+								nextRefData[cursors[octant]++] = cellRefs[r];
+							}
+						}
+					}
+				}
+			});
+		}
+
+		// Scratch goes in reverse allocation order where possible, then the next level takes over
+		CPUMemory::Free(masks);
+		CPUMemory::Free(refs);
+		CPUMemory::Free(cells);
+		cells = nextCells;
+		refs = nextRefs;
+		numCells = numNextCells;
+		numRefs = numNextRefs;
+	}
+
+	CPUMemory::Free(refs);
+	CPUMemory::Free(cells);
+
+	// Trim nodes to size, so uploads (which read whole arrays) skip the spare capacity, then join the leaf chunks
+	if (numNodes < nodeCapacity)
+	{
+		ResizeArray(nodes, numNodes, numNodes);
+	}
+
+	triList = CPUMemory::AllocateArray<uint32_t>(std::max<uint64_t>(triListLen, 1));
+	uint64_t triListOffset = 0;
+	for (uint32_t level = 0; level <= stats.depth; level++)
+	{
+		if (leafChunkLens[level] > 0)
+		{
+			memcpy(&triList[triListOffset], &leafChunks[level][0], leafChunkLens[level] * sizeof(uint32_t));
+			triListOffset += leafChunkLens[level];
+		}
+	}
+
+	for (uint32_t level = stats.depth + 1; level-- > 0;)
+	{
+		if (leafChunkLens[level] > 0)
+		{
+			CPUMemory::Free(leafChunks[level]);
+		}
+	}
+
+	stats.numNodes = static_cast<uint32_t>(numNodes);
+	stats.nodeBytes = numNodes * sizeof(ComputeAS_Node);
+	stats.triListBytes = triListLen * sizeof(uint32_t);
+
+	// SAH cost with unit triangle costs, comparable with [BVH::Stats::sahCost]; a binary BVH branch costs one unit for testing its two
+	// children, so branches here cost half a unit per occupied child
+	{
+		auto halfArea = [](const ComputeAS_Node& node)
+		{
+			const float dx = node.boundsMax.x - node.boundsMin.x, dy = node.boundsMax.y - node.boundsMin.y, dz = node.boundsMax.z - node.boundsMin.z;
+			return static_cast<double>(dx) * dy + static_cast<double>(dy) * dz + static_cast<double>(dz) * dx;
+		};
+
+		const ComputeAS_Node* nodeData = &nodes[0];
+		const uint32_t* triListData = &triList[0];
+		const double rootArea = halfArea(nodeData[0]);
+		double sahCost = 0.0;
+		for (uint64_t n = 0; n < numNodes && rootArea > 0.0; n++)
+		{
+			const ComputeAS_Node& node = nodeData[n];
+			sahCost += (halfArea(node) / rootArea) * ((node.childMask == 0) ? triListData[node.firstChild] : std::popcount(node.childMask) * 0.5);
+		}
+		stats.sahCost = static_cast<float>(sahCost);
+	}
+}
+
+void SparseOctree::DeInit()
+{
+	CPUMemory::Free(triList);
+	CPUMemory::Free(nodes);
+	triList = {};
+	nodes = {};
+	triListLen = 0;
+	stats = {};
+}
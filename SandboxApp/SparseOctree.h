@@ -0,0 +1,53 @@
+#pragma once
+
+#include <stdint.h>
+#include "../CPUMemory.h"
+#include "../Math.h"
+#include "../Shaders/SharedStructs.h"
+
+// CPU-side sparse octree builder for the compute AS (see ComputeAS_Node in SharedStructs.h)
+// - Only occupied cells are subdivided; cells become leaves once they hold [leafTris] triangles or fewer, reach [maxDepth], or stop
+//   separating their triangles (every occupied octant would inherit all of them), so depth adapts to local triangle density
+// - Triangles are assigned to every cell they touch (separating-axis tests, conservative for slivers), so leaves can share triangles
+// - Output is a compact breadth-first node array plus a triangle list; both are uploaded as-is
+// - Levels are classified in parallel across [numThreads] threads (zero for one per hardware thread); allocates through CPUMemory,
+//   so nothing else should allocate/free while a build runs
+class SparseOctree
+{
+	public:
+		struct Settings
+		{
+			uint32_t maxDepth = 12; // Clamped to [AS_OCTREE_MAX_DEPTH]
+			uint32_t leafTris = 8;
+			uint32_t numThreads = 0;
+		};
+
+		struct Stats
+		{
+			uint32_t numNodes;
+			uint32_t numLeaves;
+			uint32_t depth; // Deepest level reached (the root is level zero)
+			uint32_t nodesPerLevel[AS_OCTREE_MAX_DEPTH + 1];
+			uint64_t numTriRefs; // Leaf triangle references; straddling triangles count once per leaf
+			uint32_t maxLeafTris;
+			float sahCost; // Expected cost per ray hitting the root, in triangle tests (child box tests cost half as much; see BVH::Stats)
+			uint64_t nodeBytes;
+			uint64_t triListBytes;
+		};
+
+		// [positions] are strided (e.g. &vbuffer[0].pos), and indexed by [tris]; the root cell is a cube around them
+		void Build(const float4* positions, uint64_t numVerts, uint64_t strideBytes, const IndexedTriangle* tris, uint32_t numTris, const Settings& settings);
+		void DeInit();
+
+		CPUMemory::ArrayAllocHandle<ComputeAS_Node> Nodes() const { return nodes; }
+		CPUMemory::ArrayAllocHandle<uint32_t> TriList() const { return triList; }
+		uint32_t NumNodes() const { return stats.numNodes; }
+		uint64_t TriListLen() const { return triListLen; }
+		const Stats& GetStats() const { return stats; }
+
+	private:
+		CPUMemory::ArrayAllocHandle<ComputeAS_Node> nodes;
+		CPUMemory::ArrayAllocHandle<uint32_t> triList;
+		uint64_t triListLen = 0;
+		Stats stats = {};
+};
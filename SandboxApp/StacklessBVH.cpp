@@ -0,0 +1,329 @@
+#include "StacklessBVH.h"
+#include "Intersection.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstring>
+
+// Mesh + ray state shared by every traversal
+struct StacklessTraceContext
+{
+	const ComputeBVH_SkipNode* nodes;
+	const uint32_t* triList;
+	const IndexedTriangle* tris;
+	const uint8_t* positionBytes;
+	uint64_t strideBytes;
+	RayPrecomp rp;
+	float tMin, tMax; // [tMax] shrinks to the nearest hit found so far
+	bool found;
+};
+
+static bool NodeHit(StacklessTraceContext& ctx, uint32_t nodeNdx, StacklessBVH::TraceCounts* counts, float* outEntry)
+{
+	if (counts != nullptr)
+	{
+		counts->nodes++;
+	}
+	const ComputeBVH_SkipNode& node = ctx.nodes[nodeNdx];
+	return RayBox(&node.boundsMin.x, &node.boundsMax.x, ctx.rp, ctx.tMin, ctx.tMax, outEntry);
+}
+
+// Tests leaf [node]'s triangles, shrinking [ctx.tMax] to the nearest hit; any-hit queries stop at the first one
+template<bool anyHit>
+static void LeafHit(StacklessTraceContext& ctx, const ComputeBVH_SkipNode& node, StacklessBVH::Hit* outHit, StacklessBVH::TraceCounts* counts)
+{
+	if (counts != nullptr)
+	{
+		counts->triTests += node.triCount;
+	}
+
+	for (uint32_t i = node.skipOrFirstTri; i < node.skipOrFirstTri + node.triCount; i++)
+	{
+		const uint32_t tri = ctx.triList[i];
+		const uint4& ndx = ctx.tris[tri].xyz;
+		const float4& v0 = *reinterpret_cast<const float4*>(ctx.positionBytes + ndx.x * ctx.strideBytes);
+		const float4& v1 = *reinterpret_cast<const float4*>(ctx.positionBytes + ndx.y * ctx.strideBytes);
+		const float4& v2 = *reinterpret_cast<const float4*>(ctx.positionBytes + ndx.z * ctx.strideBytes);
+
+		float t, u, v;
+		if (RayTriangle(ctx.rp, v0, v1, v2, ctx.tMin, ctx.tMax, &t, &u, &v) && (!ctx.found || t < ctx.tMax))
+		{
+			ctx.found = true;
+			ctx.tMax = t;
+			if constexpr (anyHit)
+			{
+				return;
+			}
+			else
+			{
+				*outHit = { t, u, v, tri };
+			}
+		}
+	}
+}
+
+void StacklessBVH::Build(const BVH& bvh, const float4* _positions, [[maybe_unused]] uint64_t numVerts, uint64_t _strideBytes, const IndexedTriangle* _tris)
+{
+	assert(BVH::TriIndicesInRange(_tris, bvh.NumTris(), numVerts));
+	positions = _positions;
+	strideBytes = _strideBytes;
+	tris = _tris;
+	numNodes = bvh.NumNodes();
+	numTris = bvh.NumTris();
+	triListLen = bvh.TriListLen();
+
+	nodes = CPUMemory::AllocateArray<ComputeBVH_SkipNode>(numNodes);
+	triList = CPUMemory::AllocateArray<uint32_t>(std::max(triListLen, 1u));
+	triList[0] = 0;
+	if (triListLen > 0)
+	{
+		memcpy(&triList[0], &bvh.TriList()[0], triListLen * sizeof(uint32_t));
+	}
+
+	// Children are stored after their parents, so walking back-to-front resolves every subtree's end before its parent needs it
+	const ComputeBVH_Node* sourceNodes = &bvh.Nodes()[0];
+	ComputeBVH_SkipNode* skipNodes = &nodes[0];
+	for (uint32_t n = numNodes; n-- > 0;)
+	{
+		const ComputeBVH_Node& source = sourceNodes[n];
+		ComputeBVH_SkipNode& node = skipNodes[n];
+		node.boundsMin = source.boundsMin;
+		node.boundsMax = source.boundsMax;
+		node.triCount = source.triCount;
+		if (source.triCount > 0)
+		{
+			node.skipOrFirstTri = source.rightOrFirstTri;
+		}
+		else if (numTris == 0)
+		{
+			node.skipOrFirstTri = 1; // Empty trees are a lone (inverted) root
+		}
+		else
+		{
+			assert(source.rightOrFirstTri == SubtreeEnd(skipNodes, n + 1)); // Right children directly follow their left siblings' subtrees
+			node.skipOrFirstTri = SubtreeEnd(skipNodes, source.rightOrFirstTri);
+		}
+	}
+	assert(SubtreeEnd(skipNodes, 0) == numNodes);
+}
+
+void StacklessBVH::DeInit()
+{
+	CPUMemory::Free(triList);
+	CPUMemory::Free(nodes);
+	triList = {};
+	nodes = {};
+	numNodes = 0;
+	numTris = 0;
+	triListLen = 0;
+}
+
+template<bool anyHit>
+bool StacklessBVH::TraceSkipLinks(const Ray& ray, Hit* outHit, TraceCounts* counts) const
+{
+	StacklessTraceContext ctx = { &nodes[0], &triList[0], tris, reinterpret_cast<const uint8_t*>(positions), strideBytes, PrecomputeRay(ray.origin, ray.dir),
+								  ray.tMin, ray.tMax, false };
+
+	// Every node tests its own box; leaves continue with the next node whether they're hit or not
+	const uint32_t end = SubtreeEnd(ctx.nodes, 0);
+	uint32_t nodeNdx = 0;
+	while (nodeNdx < end)
+	{
+		float entry;
+		if (!NodeHit(ctx, nodeNdx, counts, &entry))
+		{
+			nodeNdx = SubtreeEnd(ctx.nodes, nodeNdx);
+			continue;
+		}
+
+		const ComputeBVH_SkipNode& node = ctx.nodes[nodeNdx];
+		if (node.triCount > 0)
+		{
+			LeafHit<anyHit>(ctx, node, outHit, counts);
+			if (anyHit && ctx.found)
+			{
+				return true;
+			}
+		}
+		nodeNdx++;
+	}
+	return ctx.found;
+}
+
+bool StacklessBVH::TraceRestartTrail(const Ray& ray, Hit* outHit, TraceCounts* counts) const
+{
+	StacklessTraceContext ctx = { &nodes[0], &triList[0], tris, reinterpret_cast<const uint8_t*>(positions), strideBytes, PrecomputeRay(ray.origin, ray.dir),
+								  ray.tMin, ray.tMax, false };
+	float entry;
+	if (!NodeHit(ctx, 0, counts, &entry))
+	{
+		return false;
+	}
+
+	// Bit (63 - depth) of [trail] belongs to the child taken from depth [depth - 1]; [level] is the current node's bit (zero for the root),
+	// and [restartLevel] the bit the last pop moved on
+	uint64_t trail = 0, level = 0, restartLevel = 0;
+	uint32_t nodeNdx = 0;
+	while (true)
+	{
+		const ComputeBVH_SkipNode& node = ctx.nodes[nodeNdx];
+		if (node.triCount == 0)
+		{
+			const uint32_t left = LeftChild(nodeNdx), right = RightChild(ctx.nodes, nodeNdx);
+			float leftEntry, rightEntry;
+			const bool hitLeft = NodeHit(ctx, left, counts, &leftEntry);
+			const bool hitRight = NodeHit(ctx, right, counts, &rightEntry);
+			const uint64_t childLevel = (level == 0) ? (1ull << 63) : (level >> 1);
+			assert(childLevel != 0); // Trees are at most 64 levels deep
+
+			// Clear bits mean both children were hit and the near one was taken; set bits mean the last child left was taken (the far
+			// one, or the only one hit), so it's taken again on the way back down. The level a pop moved on is the far child's turn
+			// instead: both children were hit there, so their entry distances still order them, even if the far one's culled by now
+			const bool leftNear = (leftEntry <= rightEntry);
+			const uint32_t nearChild = leftNear ? left : right, farChild = leftNear ? right : left;
+			const bool hitFar = leftNear ? hitRight : hitLeft;
+			uint32_t next = UINT32_MAX;
+			if (childLevel == restartLevel)
+			{
+				next = hitFar ? farChild : next;
+			}
+			else if (hitLeft && hitRight)
+			{
+				next = ((trail & childLevel) != 0) ? farChild : nearChild;
+			}
+			else if (hitLeft || hitRight)
+			{
+				next = hitLeft ? left : right;
+				trail |= childLevel;
+			}
+
+			if (next != UINT32_MAX)
+			{
+				nodeNdx = next;
+				level = childLevel;
+				continue;
+			}
+		}
+		else
+		{
+			LeafHit<false>(ctx, node, outHit, counts);
+		}
+
+		// Finished this subtree; move the trail on to the deepest pending far child above it (carrying past levels with nothing left),
+		// then restart from the root
+		if (level == 0)
+		{
+			break;
+		}
+		trail = (trail & ~(level - 1)) + level;
+		if (trail == 0)
+		{
+			break;
+		}
+		restartLevel = trail & (~trail + 1);
+		level = 0;
+		nodeNdx = 0;
+		if (counts != nullptr)
+		{
+			counts->restarts++;
+		}
+	}
+	return ctx.found;
+}
+
+bool StacklessBVH::TraceStack(const Ray& ray, Hit* outHit, TraceCounts* counts) const
+{
+	StacklessTraceContext ctx = { &nodes[0], &triList[0], tris, reinterpret_cast<const uint8_t*>(positions), strideBytes, PrecomputeRay(ray.origin, ray.dir),
+								  ray.tMin, ray.tMax, false };
+	float entry;
+	if (!NodeHit(ctx, 0, counts, &entry))
+	{
+		return false;
+	}
+
+	uint32_t stackNodes[AS_BVH_MAX_DEPTH];
+	float stackEntries[AS_BVH_MAX_DEPTH];
+	uint32_t stackSize = 0;
+	uint32_t nodeNdx = 0;
+	while (true)
+	{
+		const ComputeBVH_SkipNode& node = ctx.nodes[nodeNdx];
+		if (node.triCount == 0)
+		{
+			const uint32_t left = LeftChild(nodeNdx), right = RightChild(ctx.nodes, nodeNdx);
+			float leftEntry, rightEntry;
+			const bool hitLeft = NodeHit(ctx, left, counts, &leftEntry);
+			const bool hitRight = NodeHit(ctx, right, counts, &rightEntry);
+			if (hitLeft && hitRight)
+			{
+				const bool leftNear = (leftEntry <= rightEntry);
+				assert(stackSize < AS_BVH_MAX_DEPTH);
+				stackNodes[stackSize] = leftNear ? right : left;
+				stackEntries[stackSize] = leftNear ? rightEntry : leftEntry;
+				stackSize++;
+				nodeNdx = leftNear ? left : right;
+				continue;
+			}
+			else if (hitLeft || hitRight)
+			{
+				nodeNdx = hitLeft ? left : right;
+				continue;
+			}
+		}
+		else
+		{
+			LeafHit<false>(ctx, node, outHit, counts);
+		}
+
+		// Pop the nearest pending child that's still in range
+		bool pending = false;
+		while (stackSize > 0 && !pending)
+		{
+			stackSize--;
+			pending = (stackEntries[stackSize] <= ctx.tMax);
+			nodeNdx = stackNodes[stackSize];
+		}
+
+		if (!pending)
+		{
+			break;
+		}
+	}
+	return ctx.found;
+}
+
+bool StacklessBVH::ClosestHit(const Ray& ray, Hit* outHit, Traversal traversal, TraceCounts* outCounts) const
+{
+	*outHit = { ray.tMax, 0.0f, 0.0f, invalidTri };
+	if (outCounts != nullptr)
+	{
+		*outCounts = {};
+	}
+
+	if (numTris == 0)
+	{
+		return false;
+	}
+
+	switch (traversal)
+	{
+		case Traversal::RestartTrail:
+			return TraceRestartTrail(ray, outHit, outCounts);
+		case Traversal::Stack:
+			return TraceStack(ray, outHit, outCounts);
+		default:
+			return TraceSkipLinks<false>(ray, outHit, outCounts);
+	}
+}
+
+bool StacklessBVH::AnyHit(const Ray& ray) const
+{
+	if (numTris == 0)
+	{
+		return false;
+	}
+
+	Hit hit;
+	return TraceSkipLinks<true>(ray, &hit, nullptr);
+}
@@ -0,0 +1,92 @@
+#pragma once
+
+#include <stdint.h>
+#include "../CPUMemory.h"
+#include "../Math.h"
+#include "../Shaders/SharedStructs.h"
+#include "BVH.h"
+
+// Stackless encoding of a finished binary BVH (see ComputeBVH_SkipNode in SharedStructs.h), for traversal with O(1) state
+// - Same depth-first node order + triangle list as the source tree; branches swap their right child for a skip link (the first node
+//   past their subtree), and right children are recovered as the node after the left child's subtree
+// - [Traversal::SkipLinks] walks nodes in storage order: hit boxes continue with the next node, missed branches jump along their skip
+//   link, and the walk ends where the root's subtree does; its only state is the current node, but children are visited left-first
+//   whatever the ray's direction, so hits shrink the search less than ordered traversal would (this is what ComputeShader.hlsl runs)
+// - [Traversal::RestartTrail] visits children near-to-far with one bit per level (Laine 2010): set bits mark levels whose last pending
+//   child has been taken, and finishing a subtree increments the trail at its level (clearing deeper bits) and restarts from the root,
+//   which re-descends along the trail in place of popping a stack, so no parent links are needed; children are ordered by entry distance,
+//   which doesn't depend on [tMax], so every restart sees the same order
+// - [Traversal::Stack] is the conventional ordered walk (one pending child per level), kept as a baseline for the two above
+// - Like WideBVH, meshes aren't copied, so their positions/triangles must outlive the structure; queries are const + allocation-free
+class StacklessBVH
+{
+	public:
+		static constexpr uint32_t invalidTri = UINT32_MAX;
+
+		struct Ray
+		{
+			float4 origin; // w unused
+			float4 dir; // w unused; needn't be normalized (distances are in units of |dir|)
+			float tMin, tMax;
+		};
+
+		struct Hit
+		{
+			float t;
+			float u, v; // Barycentric weights for the triangle's second/third vertices
+			uint32_t tri;
+		};
+
+		enum class Traversal
+		{
+			SkipLinks,
+			RestartTrail,
+			Stack
+		};
+
+		// Work done by one query
+		struct TraceCounts
+		{
+			uint32_t nodes; // Box tests
+			uint32_t triTests;
+			uint32_t restarts; // Descents from the root after the first ([Traversal::RestartTrail] only)
+		};
+
+		// [bvh] must have been built over [positions]/[tris]; it isn't referenced after conversion
+		void Build(const BVH& bvh, const float4* positions, uint64_t numVerts, uint64_t strideBytes, const IndexedTriangle* tris);
+		void DeInit();
+
+		// Nearest intersection within [tMin, tMax]; misses return false, with [outHit->tri] set to [invalidTri]
+		bool ClosestHit(const Ray& ray, Hit* outHit, Traversal traversal = Traversal::SkipLinks, TraceCounts* outCounts = nullptr) const;
+
+		// Whether anything intersects the ray within [tMin, tMax] (occlusion/shadow rays); order doesn't matter here, so this always
+		// follows skip links
+		bool AnyHit(const Ray& ray) const;
+
+		// Branch [nodeNdx]'s children, and the first node past any node's subtree (where traversal goes when its box is missed)
+		static uint32_t LeftChild(uint32_t nodeNdx) { return nodeNdx + 1; }
+		static uint32_t RightChild(const ComputeBVH_SkipNode* nodes, uint32_t nodeNdx) { return SubtreeEnd(nodes, nodeNdx + 1); }
+		static uint32_t SubtreeEnd(const ComputeBVH_SkipNode* nodes, uint32_t nodeNdx) { return (nodes[nodeNdx].triCount > 0) ? nodeNdx + 1 : nodes[nodeNdx].skipOrFirstTri; }
+
+		CPUMemory::ArrayAllocHandle<ComputeBVH_SkipNode> Nodes() const { return nodes; }
+		CPUMemory::ArrayAllocHandle<uint32_t> TriList() const { return triList; }
+		uint32_t NumNodes() const { return numNodes; }
+		uint32_t NumTris() const { return numTris; }
+		uint32_t TriListLen() const { return triListLen; } // As BVH::TriListLen
+
+	private:
+		template<bool anyHit>
+		bool TraceSkipLinks(const Ray& ray, Hit* outHit, TraceCounts* counts) const;
+		bool TraceRestartTrail(const Ray& ray, Hit* outHit, TraceCounts* counts) const;
+		bool TraceStack(const Ray& ray, Hit* outHit, TraceCounts* counts) const;
+
+		CPUMemory::ArrayAllocHandle<ComputeBVH_SkipNode> nodes;
+		CPUMemory::ArrayAllocHandle<uint32_t> triList;
+		uint32_t numNodes = 0;
+		uint32_t numTris = 0;
+		uint32_t triListLen = 0;
+
+		const float4* positions = nullptr;
+		uint64_t strideBytes = 0;
+		const IndexedTriangle* tris = nullptr;
+};
@@ -0,0 +1,291 @@
+#include "TileScheduler.h"
+#include "../CPUMemory.h"
+
+#include <algorithm>
+#include <cassert>
+
+static uint64_t PackDeque(uint32_t front, uint32_t back)
+{
+	return (static_cast<uint64_t>(front) << 32) | back;
+}
+
+// Every other bit of [v], packed down
+static uint32_t CompactBits(uint32_t v)
+{
+	v &= 0x55555555;
+	v = (v | (v >> 1)) & 0x33333333;
+	v = (v | (v >> 2)) & 0x0f0f0f0f;
+	v = (v | (v >> 4)) & 0x00ff00ff;
+	v = (v | (v >> 8)) & 0x0000ffff;
+	return v;
+}
+
+// Cell [d] along the Hilbert curve through an [n] x [n] grid ([n] a power of two)
+static void HilbertCell(uint32_t n, uint32_t d, uint32_t* outX, uint32_t* outY)
+{
+	uint32_t x = 0, y = 0;
+	for (uint32_t s = 1; s < n; s *= 2)
+	{
+		const uint32_t rx = 1 & (d / 2);
+		const uint32_t ry = 1 & (d ^ rx);
+		if (ry == 0)
+		{
+			if (rx == 1)
+			{
+				x = s - 1 - x;
+				y = s - 1 - y;
+			}
+			std::swap(x, y);
+		}
+		x += s * rx;
+		y += s * ry;
+		d /= 4;
+	}
+	*outX = x;
+	*outY = y;
+}
+
+void TileScheduler::OrderTiles(uint32_t tilesX, uint32_t tilesY, TileOrder order, uint32_t* outOrder)
+{
+	const uint32_t numTiles = tilesX * tilesY;
+	if (order == TileOrder::RowMajor)
+	{
+		for (uint32_t i = 0; i < numTiles; i++)
+		{
+			outOrder[i] = i;
+		}
+		return;
+	}
+
+	uint32_t side = 1;
+	while (side < std::max(tilesX, tilesY))
+	{
+		side *= 2;
+	}
+
+	uint32_t numOrdered = 0;
+	for (uint64_t d = 0; d < static_cast<uint64_t>(side) * side && numOrdered < numTiles; d++)
+	{
+		uint32_t x, y;
+		if (order == TileOrder::Morton)
+		{
+			x = CompactBits(static_cast<uint32_t>(d));
+			y = CompactBits(static_cast<uint32_t>(d >> 1));
+		}
+		else
+		{
+			HilbertCell(side, static_cast<uint32_t>(d), &x, &y);
+		}
+
+		if (x < tilesX && y < tilesY)
+		{
+			outOrder[numOrdered++] = y * tilesX + x;
+		}
+	}
+	assert(numOrdered == numTiles);
+}
+
+void TileScheduler::Init(uint32_t threads)
+{
+	numThreads = std::clamp((threads == 0) ? std::thread::hardware_concurrency() : threads, 1u, maxThreads);
+	generation = 0;
+	activeWorkers = 0;
+	quitting = false;
+	for (uint32_t t = 0; t < numThreads; t++)
+	{
+		workerStates[t].deque.store(0);
+	}
+	for (uint32_t t = 1; t < numThreads; t++)
+	{
+		workers[t] = std::thread(&TileScheduler::WorkerLoop, this, t);
+	}
+}
+
+void TileScheduler::DeInit()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		quitting = true;
+	}
+	wake.notify_all();
+	for (uint32_t t = 1; t < numThreads; t++)
+	{
+		workers[t].join();
+	}
+	numThreads = 0;
+}
+
+TileScheduler::RunStats TileScheduler::Run(uint32_t width, uint32_t height, uint32_t tileSizePx, TileOrder order, TileFn fn, void* context)
+{
+	assert(numThreads > 0 && tileSizePx > 0);
+	RunStats stats = {};
+	tilesX = (width + tileSizePx - 1) / tileSizePx;
+	const uint32_t tilesY = (height + tileSizePx - 1) / tileSizePx;
+	stats.numTiles = tilesX * tilesY;
+	if (stats.numTiles == 0)
+	{
+		return stats;
+	}
+
+	CPUMemory::ArrayAllocHandle<uint32_t> orderAlloc = CPUMemory::AllocateArray<uint32_t>(stats.numTiles);
+	OrderTiles(tilesX, tilesY, order, &orderAlloc[0]);
+	tileOrder = &orderAlloc[0];
+	frameWidth = width;
+	frameHeight = height;
+	tileSize = tileSizePx;
+	runFn = fn;
+	runContext = context;
+
+	// One contiguous stretch of the curve per thread
+	for (uint32_t t = 0; t < numThreads; t++)
+	{
+		WorkerState& state = workerStates[t];
+		const uint32_t front = static_cast<uint32_t>((static_cast<uint64_t>(stats.numTiles) * t) / numThreads);
+		const uint32_t back = static_cast<uint32_t>((static_cast<uint64_t>(stats.numTiles) * (t + 1)) / numThreads);
+		state.deque.store(PackDeque(front, back));
+		state.tilesRun = 0;
+		state.steals = 0;
+		state.stolenTiles = 0;
+	}
+
+	if (numThreads > 1)
+	{
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			activeWorkers = numThreads - 1;
+			generation++;
+		}
+		wake.notify_all();
+	}
+
+	WorkOn(0);
+
+	if (numThreads > 1)
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		done.wait(lock, [this]() { return activeWorkers == 0; });
+	}
+
+	stats.minThreadTiles = UINT32_MAX;
+	for (uint32_t t = 0; t < numThreads; t++)
+	{
+		const WorkerState& state = workerStates[t];
+		stats.numSteals += state.steals;
+		stats.stolenTiles += state.stolenTiles;
+		stats.minThreadTiles = std::min(stats.minThreadTiles, state.tilesRun);
+		stats.maxThreadTiles = std::max(stats.maxThreadTiles, state.tilesRun);
+	}
+
+	tileOrder = nullptr;
+	CPUMemory::Free(orderAlloc);
+	return stats;
+}
+
+void TileScheduler::WorkerLoop(uint32_t threadNdx)
+{
+	uint64_t seenGeneration = 0;
+	while (true)
+	{
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			wake.wait(lock, [&]() { return quitting || generation != seenGeneration; });
+			if (quitting)
+			{
+				return;
+			}
+			seenGeneration = generation;
+		}
+
+		WorkOn(threadNdx);
+
+		bool last;
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			last = (--activeWorkers == 0);
+		}
+		if (last)
+		{
+			done.notify_one();
+		}
+	}
+}
+
+void TileScheduler::WorkOn(uint32_t threadNdx)
+{
+	WorkerState& state = workerStates[threadNdx];
+	while (true)
+	{
+		uint32_t orderNdx;
+		if (!PopFront(threadNdx, &orderNdx))
+		{
+			// Steals land in this thread's own deque, so they're popped as above; nothing left to steal means the run is (nearly)
+			// over, since tiles other threads are mid-way through stealing get run by those threads
+			if (Steal(threadNdx))
+			{
+				continue;
+			}
+			return;
+		}
+
+		const uint32_t tileNdx = tileOrder[orderNdx];
+		Tile tile;
+		tile.ndx = tileNdx;
+		tile.x0 = (tileNdx % tilesX) * tileSize;
+		tile.y0 = (tileNdx / tilesX) * tileSize;
+		tile.x1 = std::min(tile.x0 + tileSize, frameWidth);
+		tile.y1 = std::min(tile.y0 + tileSize, frameHeight);
+		runFn(tile, threadNdx, runContext);
+		state.tilesRun++;
+	}
+}
+
+bool TileScheduler::PopFront(uint32_t threadNdx, uint32_t* outTile)
+{
+	std::atomic<uint64_t>& deque = workerStates[threadNdx].deque;
+	uint64_t current = deque.load(std::memory_order_acquire);
+	while (true)
+	{
+		const uint32_t front = static_cast<uint32_t>(current >> 32), back = static_cast<uint32_t>(current);
+		if (front >= back)
+		{
+			return false;
+		}
+		if (deque.compare_exchange_weak(current, PackDeque(front + 1, back), std::memory_order_acq_rel, std::memory_order_acquire))
+		{
+			*outTile = front;
+			return true;
+		}
+	}
+}
+
+bool TileScheduler::Steal(uint32_t threadNdx)
+{
+	// Victims are tried from the next thread on, so hungry threads start out on different victims
+	for (uint32_t i = 1; i < numThreads; i++)
+	{
+		const uint32_t victimNdx = (threadNdx + i) % numThreads;
+		std::atomic<uint64_t>& victim = workerStates[victimNdx].deque;
+		uint64_t current = victim.load(std::memory_order_acquire);
+		while (true)
+		{
+			const uint32_t front = static_cast<uint32_t>(current >> 32), back = static_cast<uint32_t>(current);
+			if (front >= back)
+			{
+				break;
+			}
+
+			// The back half, rounded up (so lone tiles can be taken too)
+			const uint32_t count = (back - front + 1) / 2;
+			if (victim.compare_exchange_weak(current, PackDeque(front, back - count), std::memory_order_acq_rel, std::memory_order_acquire))
+			{
+				// Nobody else can shrink this thread's deque while it's empty, so it's safe to overwrite
+				WorkerState& state = workerStates[threadNdx];
+				state.deque.store(PackDeque(back - count, back), std::memory_order_release);
+				state.steals++;
+				state.stolenTiles += count;
+				return true;
+			}
+		}
+	}
+	return false;
+}
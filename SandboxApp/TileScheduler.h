@@ -0,0 +1,105 @@
+#pragma once
+
+#include <stdint.h>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+
+// Persistent worker pool for CPU rendering: frames split into square tiles, dealt along a space-filling curve, and balanced with
+// per-thread work-stealing deques
+// - Workers start once ([Init]) and sleep between runs, so each frame/pass costs a wake-up rather than thread creation; the thread
+//   calling [Run] works too (as thread zero), and [Run] returns once every tile has finished
+// - Each run orders its tiles along a Morton or Hilbert curve (so tiles that run close together in time cover neighbouring pixels,
+//   and share geometry + texels in cache) and deals each thread one contiguous stretch of the curve
+// - Threads take tiles from the front of their own stretch; once it runs dry they steal the back half of another thread's (so stolen
+//   work stays contiguous along the curve too), and stop when every stretch is empty
+// - Tiles are only dealt before a run starts, so each deque is one 64-bit word (front + back indices into the run's tile order),
+//   shrunk by compare-and-swap from either end; nothing locks while tiles run
+// - Tile callbacks shouldn't allocate through CPUMemory (which isn't thread-safe, and compacts on frees)
+class TileScheduler
+{
+	public:
+		static constexpr uint32_t maxThreads = 256;
+
+		enum class TileOrder
+		{
+			RowMajor,
+			Morton,
+			Hilbert
+		};
+
+		// Pixels [x0, x1) x [y0, y1); [ndx] is the tile's row-major position in the frame's tile grid
+		struct Tile
+		{
+			uint32_t x0, y0, x1, y1;
+			uint32_t ndx;
+		};
+
+		struct RunStats
+		{
+			uint32_t numTiles;
+			uint32_t numSteals; // Successful steals
+			uint32_t stolenTiles; // Tiles moved by them
+			uint32_t minThreadTiles, maxThreadTiles; // Tiles run by the least/most busy thread
+		};
+
+		using TileFn = void (*)(const Tile& tile, uint32_t threadNdx, void* context);
+
+		// Starts [numThreads] - 1 workers (zero for one thread per hardware thread, clamped to [maxThreads])
+		void Init(uint32_t numThreads = 0);
+		void DeInit();
+
+		// Runs [fn] over every tile of a [width] x [height] frame (tiles are [tileSize] pixels square, clipped at the frame's edges),
+		// visiting them along [order]; blocks until they're done
+		RunStats Run(uint32_t width, uint32_t height, uint32_t tileSize, TileOrder order, TileFn fn, void* context);
+
+		// As above, for callables taking (const Tile&, uint32_t threadNdx)
+		template<typename tileFn>
+		RunStats Run(uint32_t width, uint32_t height, uint32_t tileSize, TileOrder order, tileFn&& fn)
+		{
+			using fnType = std::remove_reference_t<tileFn>;
+			return Run(width, height, tileSize, order, [](const Tile& tile, uint32_t threadNdx, void* context) { (*static_cast<fnType*>(context))(tile, threadNdx); },
+					   const_cast<void*>(static_cast<const void*>(&fn)));
+		}
+
+		uint32_t NumThreads() const { return numThreads; }
+
+		// Row-major indices of a [tilesX] x [tilesY] grid's tiles, in [order]; curves run over the smallest power-of-two square covering
+		// the grid, skipping cells outside it
+		static void OrderTiles(uint32_t tilesX, uint32_t tilesY, TileOrder order, uint32_t* outOrder);
+
+	private:
+		// Padded to a cache line each, so threads popping their own deques don't contend over neighbours'
+		struct alignas(64) WorkerState
+		{
+			std::atomic<uint64_t> deque; // Front index in the high 32 bits, back (one past the last tile) in the low 32
+			uint32_t tilesRun;
+			uint32_t steals;
+			uint32_t stolenTiles;
+		};
+
+		void WorkerLoop(uint32_t threadNdx);
+		void WorkOn(uint32_t threadNdx);
+		bool PopFront(uint32_t threadNdx, uint32_t* outTile);
+		bool Steal(uint32_t threadNdx);
+
+		WorkerState workerStates[maxThreads];
+		std::thread workers[maxThreads];
+		uint32_t numThreads = 0;
+
+		// The current run's tiles (read-only while it runs)
+		const uint32_t* tileOrder = nullptr;
+		uint32_t tilesX = 0;
+		uint32_t frameWidth = 0, frameHeight = 0, tileSize = 0;
+		TileFn runFn = nullptr;
+		void* runContext = nullptr;
+
+		// Workers sleep on [wake] until [generation] moves on (a new run) or [quitting] is set; the last one out of a run signals [done]
+		std::mutex mutex;
+		std::condition_variable wake, done;
+		uint64_t generation = 0;
+		uint32_t activeWorkers = 0;
+		bool quitting = false;
+};
@@ -0,0 +1,299 @@
+#include "TwoLevelAS.h"
+#include "Intersection.h"
+
+#include <algorithm>
+#include <cassert>
+
+// Columns of the rotation for an SQT transform, same convention as SceneGraph/Bounds (v' = q * v * q^-1)
+static void RotationColumns(const transform& xform, Vec3* outColumns)
+{
+	const float x = xform.rotation.x, y = xform.rotation.y, z = xform.rotation.z, w = xform.rotation.w;
+	outColumns[0] = { 1.0f - 2.0f * (y * y + z * z), 2.0f * (x * y + w * z), 2.0f * (x * z - w * y) };
+	outColumns[1] = { 2.0f * (x * y - w * z), 1.0f - 2.0f * (x * x + z * z), 2.0f * (y * z + w * x) };
+	outColumns[2] = { 2.0f * (x * z + w * y), 2.0f * (y * z - w * x), 1.0f - 2.0f * (x * x + y * y) };
+}
+
+static Vec3 Abs3(Vec3 a) { return { std::abs(a.x), std::abs(a.y), std::abs(a.z) }; }
+
+// Ordered walk over a depth-first BVH (near children first, far children stacked with their entry distances, so they're skipped once
+// something closer turns up); [testLeaf(first, count)] tests a leaf's triangle list entries, shrinking [*tMax] as it finds hits, and
+// returns true to end the walk early
+template<typename leafFn>
+static void WalkBVH(const ComputeBVH_Node* nodes, const RayPrecomp& rp, float tMin, const float* tMax, leafFn testLeaf)
+{
+	float entry;
+	if (!RayBox(&nodes[0].boundsMin.x, &nodes[0].boundsMax.x, rp, tMin, *tMax, &entry))
+	{
+		return;
+	}
+
+	uint32_t stackNodes[AS_BVH_MAX_DEPTH];
+	float stackEntries[AS_BVH_MAX_DEPTH];
+	uint32_t stackSize = 0;
+	uint32_t nodeNdx = 0;
+	while (true)
+	{
+		const ComputeBVH_Node& node = nodes[nodeNdx];
+		if (node.triCount > 0)
+		{
+			if (testLeaf(node.rightOrFirstTri, node.triCount))
+			{
+				return;
+			}
+		}
+		else
+		{
+			const uint32_t left = nodeNdx + 1, right = node.rightOrFirstTri;
+			float leftEntry, rightEntry;
+			const bool hitLeft = RayBox(&nodes[left].boundsMin.x, &nodes[left].boundsMax.x, rp, tMin, *tMax, &leftEntry);
+			const bool hitRight = RayBox(&nodes[right].boundsMin.x, &nodes[right].boundsMax.x, rp, tMin, *tMax, &rightEntry);
+			if (hitLeft && hitRight)
+			{
+				const bool leftFirst = leftEntry <= rightEntry;
+				stackNodes[stackSize] = leftFirst ? right : left;
+				stackEntries[stackSize] = leftFirst ? rightEntry : leftEntry;
+				stackSize++;
+				nodeNdx = leftFirst ? left : right;
+				continue;
+			}
+			else if (hitLeft || hitRight)
+			{
+				nodeNdx = hitLeft ? left : right;
+				continue;
+			}
+		}
+
+		// Pop the next candidate that could still beat the closest hit
+		bool found = false;
+		while (stackSize > 0)
+		{
+			stackSize--;
+			if (stackEntries[stackSize] <= *tMax)
+			{
+				nodeNdx = stackNodes[stackSize];
+				found = true;
+				break;
+			}
+		}
+
+		if (!found)
+		{
+			return;
+		}
+	}
+}
+
+void TwoLevelAS::Init(uint32_t _maxInstances)
+{
+	maxInstances = _maxInstances;
+	instanceXforms = CPUMemory::AllocateArray<InstanceXform>(std::max(maxInstances, 1u));
+	instanceMeshes = CPUMemory::AllocateArray<uint32_t>(std::max(maxInstances, 1u));
+	instanceMins = CPUMemory::AllocateArray<float4>(std::max(maxInstances, 1u));
+	instanceMaxs = CPUMemory::AllocateArray<float4>(std::max(maxInstances, 1u));
+}
+
+void TwoLevelAS::DeInit()
+{
+	if (tlas.NumNodes() > 0)
+	{
+		tlas.DeInit();
+	}
+
+	for (uint32_t m = numMeshes; m > 0; m--)
+	{
+		blases[m - 1].DeInit();
+	}
+
+	CPUMemory::Free(instanceMaxs);
+	CPUMemory::Free(instanceMins);
+	CPUMemory::Free(instanceMeshes);
+	CPUMemory::Free(instanceXforms);
+
+	numMeshes = 0;
+	numInstances = 0;
+	maxInstances = 0;
+}
+
+uint32_t TwoLevelAS::AddMesh(const float4* positions, uint64_t numVerts, uint64_t strideBytes, const IndexedTriangle* tris, uint32_t numTris,
+							 const BVH::BinnedSAHSettings& settings)
+{
+	assert(numMeshes < maxMeshes);
+	blases[numMeshes].BuildBinnedSAH(positions, numVerts, strideBytes, tris, numTris, settings);
+	meshes[numMeshes] = { positions, strideBytes, tris };
+	return numMeshes++;
+}
+
+void TwoLevelAS::SetInstances(const transform* xforms, const uint32_t* _meshes, uint32_t _numInstances)
+{
+	assert(_numInstances <= maxInstances);
+	numInstances = _numInstances;
+
+	InstanceXform* instXforms = &instanceXforms[0];
+	uint32_t* instMeshes = &instanceMeshes[0];
+	float4* instMins = &instanceMins[0];
+	float4* instMaxs = &instanceMaxs[0];
+	for (uint32_t i = 0; i < numInstances; i++)
+	{
+		const transform& xform = xforms[i];
+		const float scale = xform.translationAndScale.w;
+		const Vec3 translation = ToVec3(xform.translationAndScale);
+		Vec3 columns[3];
+		RotationColumns(xform, columns);
+
+		// World -> object: undo the translation, then rotate by the transpose and undo the scale
+		InstanceXform& inst = instXforms[i];
+		for (uint32_t r = 0; r < 3; r++)
+		{
+			const Vec3 row = Scale3(columns[r], 1.0f / scale);
+			inst.rows[r] = float4(row.x, row.y, row.z, 0.0f);
+		}
+		inst.translation = float4(translation.x, translation.y, translation.z, 0.0f);
+		instMeshes[i] = _meshes[i];
+
+		// World bounds from the BLAS root's center/half-extents (Arvo 1990); empty meshes get a point at their origin (keeping TLAS
+		// centroids finite), and are skipped by traversal
+		const ComputeBVH_Node& root = blases[_meshes[i]].Nodes()[0];
+		if (blases[_meshes[i]].NumTris() == 0)
+		{
+			instMins[i] = inst.translation;
+			instMaxs[i] = inst.translation;
+			continue;
+		}
+
+		const Vec3 center = Scale3(Add3(Vec3{ root.boundsMin.x, root.boundsMin.y, root.boundsMin.z }, Vec3{ root.boundsMax.x, root.boundsMax.y, root.boundsMax.z }), 0.5f);
+		const Vec3 halfExtent = Scale3(Sub3(Vec3{ root.boundsMax.x, root.boundsMax.y, root.boundsMax.z }, Vec3{ root.boundsMin.x, root.boundsMin.y, root.boundsMin.z }), 0.5f);
+		const Vec3 worldCenter = Add3(translation, Scale3(Add3(Scale3(columns[0], center.x), Add3(Scale3(columns[1], center.y), Scale3(columns[2], center.z))), scale));
+		const Vec3 worldExtent = Scale3(Add3(Scale3(Abs3(columns[0]), halfExtent.x), Add3(Scale3(Abs3(columns[1]), halfExtent.y), Scale3(Abs3(columns[2]), halfExtent.z))),
+										std::abs(scale));
+		const Vec3 lo = Sub3(worldCenter, worldExtent), hi = Add3(worldCenter, worldExtent);
+		instMins[i] = float4(lo.x, lo.y, lo.z, 0.0f);
+		instMaxs[i] = float4(hi.x, hi.y, hi.z, 0.0f);
+	}
+
+	// Instance counts are small next to triangle counts, so the TLAS builds on this thread (spawning workers costs more than it saves)
+	BVH::LBVHSettings settings;
+	settings.maxLeafTris = 4;
+	settings.numThreads = 1;
+	if (tlas.NumNodes() > 0)
+	{
+		tlas.DeInit(); // Normally the newest allocation (meshes are added up-front), so freeing it moves nothing
+	}
+	tlas.BuildLBVH(instMins, instMaxs, numInstances, settings);
+}
+
+template<bool anyHit>
+bool TwoLevelAS::Trace(const Ray& ray, Hit* outHit) const
+{
+	if (numInstances == 0)
+	{
+		return false;
+	}
+
+	const RayPrecomp worldRay = PrecomputeRay(ray.origin, ray.dir);
+	const InstanceXform* instXforms = &instanceXforms[0];
+	const uint32_t* instMeshes = &instanceMeshes[0];
+	const uint32_t* tlasInstances = &tlas.TriList()[0];
+
+	float tMax = ray.tMax;
+	bool found = false;
+	WalkBVH(&tlas.Nodes()[0], worldRay, ray.tMin, &tMax, [&](uint32_t first, uint32_t count)
+	{
+		for (uint32_t i = first; i < first + count; i++)
+		{
+			const uint32_t instance = tlasInstances[i];
+			const BVH& blas = blases[instMeshes[instance]];
+			if (blas.NumTris() == 0)
+			{
+				continue; // Slab tests can't reject the inverted bounds of an empty root
+			}
+
+			const Ray local = ToObjectSpace(ray, instXforms[instance]);
+			const RayPrecomp objectRay = PrecomputeRay(local.origin, local.dir);
+			const Mesh& mesh = meshes[instMeshes[instance]];
+			const uint32_t* triList = &blas.TriList()[0];
+			const uint8_t* positionBytes = reinterpret_cast<const uint8_t*>(mesh.positions);
+			bool done = false;
+			WalkBVH(&blas.Nodes()[0], objectRay, ray.tMin, &tMax, [&](uint32_t firstTri, uint32_t triCount)
+			{
+				for (uint32_t j = firstTri; j < firstTri + triCount; j++)
+				{
+					const uint32_t tri = triList[j];
+					const uint4& ndx = mesh.tris[tri].xyz;
+					const float4& v0 = *reinterpret_cast<const float4*>(positionBytes + ndx.x * mesh.strideBytes);
+					const float4& v1 = *reinterpret_cast<const float4*>(positionBytes + ndx.y * mesh.strideBytes);
+					const float4& v2 = *reinterpret_cast<const float4*>(positionBytes + ndx.z * mesh.strideBytes);
+
+					float t, u, v;
+					if (RayTriangle(objectRay, v0, v1, v2, ray.tMin, tMax, &t, &u, &v) && (!found || t < tMax))
+					{
+						found = true;
+						tMax = t;
+						if constexpr (anyHit)
+						{
+							done = true;
+							return true;
+						}
+						else
+						{
+							*outHit = { t, u, v, tri, instance };
+						}
+					}
+				}
+				return false;
+			});
+
+			if (done)
+			{
+				return true;
+			}
+		}
+		return false;
+	});
+	return found;
+}
+
+TwoLevelAS::Ray TwoLevelAS::ToObjectSpace(const Ray& ray, uint32_t instance) const
+{
+	return ToObjectSpace(ray, instanceXforms[instance]);
+}
+
+TwoLevelAS::Ray TwoLevelAS::ToObjectSpace(const Ray& ray, const InstanceXform& xform)
+{
+	const Vec3 rows[3] = { ToVec3(xform.rows[0]), ToVec3(xform.rows[1]), ToVec3(xform.rows[2]) };
+	const Vec3 origin = Sub3(ToVec3(ray.origin), ToVec3(xform.translation)), dir = ToVec3(ray.dir);
+	return { float4(Dot3(rows[0], origin), Dot3(rows[1], origin), Dot3(rows[2], origin), 0.0f),
+			 float4(Dot3(rows[0], dir), Dot3(rows[1], dir), Dot3(rows[2], dir), 0.0f), ray.tMin, ray.tMax };
+}
+
+bool TwoLevelAS::ClosestHit(const Ray& ray, Hit* outHit) const
+{
+	*outHit = { ray.tMax, 0.0f, 0.0f, invalidNdx, invalidNdx };
+	return Trace<false>(ray, outHit);
+}
+
+bool TwoLevelAS::AnyHit(const Ray& ray) const
+{
+	Hit hit;
+	return Trace<true>(ray, &hit);
+}
+
+TwoLevelAS::Stats TwoLevelAS::GetStats() const
+{
+	Stats stats = {};
+	stats.numMeshes = numMeshes;
+	stats.numInstances = numInstances;
+	for (uint32_t m = 0; m < numMeshes; m++)
+	{
+		stats.blasBytes += blases[m].GetStats().nodeBytes + blases[m].GetStats().triListBytes;
+	}
+
+	const uint32_t* instMeshes = &instanceMeshes[0];
+	for (uint32_t i = 0; i < numInstances; i++)
+	{
+		stats.numInstancedTris += blases[instMeshes[i]].NumTris();
+	}
+
+	stats.tlasBytes = tlas.GetStats().nodeBytes + tlas.GetStats().triListBytes;
+	stats.instanceBytes = static_cast<uint64_t>(numInstances) * (sizeof(InstanceXform) + sizeof(uint32_t) + 2 * sizeof(float4));
+	return stats;
+}
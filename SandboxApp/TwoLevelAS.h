@@ -0,0 +1,102 @@
+#pragma once
+
+#include <stdint.h>
+#include "../CPUMemory.h"
+#include "../Math.h"
+#include "BVH.h"
+
+// Two-level CPU acceleration structure for instanced geometry
+// - Each mesh gets a BLAS (see BVH.h) over its object-space triangles, built once when it's added; instances reference meshes, so a
+//   hundred copies of a mesh share one BLAS and one copy of its vertices
+// - Instances are placed by SQT transforms (the same [transform]s as Render::FrameConstants::sceneTransforms); [SetInstances] boxes
+//   each instance's BLAS root in world space and rebuilds the TLAS (an LBVH over those boxes, see [BVH::BuildLBVH]) from scratch,
+//   which stays cheap enough to run every frame
+// - Rays are moved into each instance's object space at TLAS leaves instead of moving geometry into world space; hit distances stay in
+//   world-ray units (an affine change of space keeps ray parameters)
+// - Meshes aren't copied, so their positions/triangles must outlive the structure; like SceneQuery, queries are const +
+//   allocation-free, so any number of threads can run them at once
+class TwoLevelAS
+{
+	public:
+		static constexpr uint32_t maxMeshes = 64;
+		static constexpr uint32_t invalidNdx = UINT32_MAX;
+
+		struct Ray
+		{
+			float4 origin; // w unused
+			float4 dir; // w unused; needn't be normalized (distances are in units of |dir|)
+			float tMin, tMax;
+		};
+
+		struct Hit
+		{
+			float t;
+			float u, v; // Barycentric weights for the triangle's second/third vertices
+			uint32_t tri; // Within the instance's mesh
+			uint32_t instance;
+		};
+
+		struct Stats
+		{
+			uint32_t numMeshes;
+			uint32_t numInstances;
+			uint64_t numInstancedTris; // Triangles across every instance, as a flattened (single-level) structure would store them
+			uint64_t blasBytes; // Nodes + triangle lists, for every mesh
+			uint64_t tlasBytes;
+			uint64_t instanceBytes; // Per-instance transforms + bounds
+		};
+
+		void Init(uint32_t _maxInstances);
+		void DeInit();
+
+		// [positions] are strided (e.g. &vbuffer[0].pos), and indexed by [tris]; returns the mesh's index for [SetInstances]
+		uint32_t AddMesh(const float4* positions, uint64_t numVerts, uint64_t strideBytes, const IndexedTriangle* tris, uint32_t numTris,
+						 const BVH::BinnedSAHSettings& settings);
+
+		// Instance [i] places mesh [meshes[i]] with [xforms[i]]; replaces every instance, then rebuilds the TLAS
+		void SetInstances(const transform* xforms, const uint32_t* meshes, uint32_t numInstances);
+
+		// Nearest intersection within [tMin, tMax]; misses return false, with [outHit->tri]/[outHit->instance] set to [invalidNdx]
+		bool ClosestHit(const Ray& ray, Hit* outHit) const;
+
+		// Whether anything intersects the ray within [tMin, tMax] (occlusion/shadow rays)
+		bool AnyHit(const Ray& ray) const;
+
+		// [ray] in [instance]'s object space (where its BLAS, triangles and hit barycentrics live); t values carry over unchanged
+		Ray ToObjectSpace(const Ray& ray, uint32_t instance) const;
+
+		const BVH& TLAS() const { return tlas; }
+		const BVH& BLAS(uint32_t meshNdx) const { return blases[meshNdx]; }
+		Stats GetStats() const;
+
+	private:
+		struct Mesh
+		{
+			const float4* positions;
+			uint64_t strideBytes;
+			const IndexedTriangle* tris;
+		};
+
+		// World -> object rows (the transpose of the instance's rotation, over its scale), plus the instance's translation
+		struct InstanceXform
+		{
+			float4 rows[3];
+			float4 translation;
+		};
+
+		static Ray ToObjectSpace(const Ray& ray, const InstanceXform& xform);
+
+		template<bool anyHit>
+		bool Trace(const Ray& ray, Hit* outHit) const;
+
+		BVH blases[maxMeshes];
+		Mesh meshes[maxMeshes] = {};
+		uint32_t numMeshes = 0;
+
+		BVH tlas;
+		CPUMemory::ArrayAllocHandle<InstanceXform> instanceXforms;
+		CPUMemory::ArrayAllocHandle<uint32_t> instanceMeshes;
+		CPUMemory::ArrayAllocHandle<float4> instanceMins, instanceMaxs; // World-space
+		uint32_t maxInstances = 0;
+		uint32_t numInstances = 0;
+};
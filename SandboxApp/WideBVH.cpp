@@ -0,0 +1,881 @@
+#include "WideBVH.h"
+#include "Intersection.h"
+
+#include <immintrin.h>
+#include <algorithm>
+#include <bit>
+#include <cassert>
+#include <cmath>
+#include <cstring>
+
+// Deepest supported wide level; collapsing never deepens a tree, and splitting oversized leaves adds a few binary levels at most
+constexpr uint32_t maxWideDepth = AS_BVH_MAX_DEPTH + 8;
+
+// Each visit pops one node and pushes up to seven more than it pops
+constexpr uint32_t traversalStackSize = maxWideDepth * (WideBVH::width - 1) + 1;
+
+// Binary tree being collapsed; a copy of the source BVH whose oversized leaves get split (see [SplitLeaves])
+struct CollapseNode
+{
+	float bmin[3], bmax[3];
+	uint32_t left, right; // Branches
+	uint32_t firstTri, triCount; // Leaves ([triCount] > 0); [firstTri] indexes the scratch triangle list
+};
+
+struct CollapseContext
+{
+	CollapseNode* nodes;
+	uint32_t numNodes;
+	uint32_t* tris; // Scratch copy of the source BVH's triangle list, reordered within leaves as they split
+	const uint8_t* positionBytes;
+	uint64_t strideBytes;
+	const IndexedTriangle* meshTris;
+};
+
+static const float4& Vertex(const CollapseContext& ctx, uint32_t tri, uint32_t k)
+{
+	const uint32_t ndx = (k == 0) ? ctx.meshTris[tri].xyz.x : ((k == 1) ? ctx.meshTris[tri].xyz.y : ctx.meshTris[tri].xyz.z);
+	return *reinterpret_cast<const float4*>(ctx.positionBytes + ndx * ctx.strideBytes);
+}
+
+static void TriangleBounds(const CollapseContext& ctx, uint32_t firstTri, uint32_t triCount, float* outMin, float* outMax)
+{
+	for (uint32_t a = 0; a < 3; a++)
+	{
+		outMin[a] = INFINITY;
+		outMax[a] = -INFINITY;
+	}
+
+	for (uint32_t i = firstTri; i < firstTri + triCount; i++)
+	{
+		for (uint32_t k = 0; k < 3; k++)
+		{
+			const float4& v = Vertex(ctx, ctx.tris[i], k);
+			const float p[3] = { v.x, v.y, v.z };
+			for (uint32_t a = 0; a < 3; a++)
+			{
+				outMin[a] = std::min(outMin[a], p[a]);
+				outMax[a] = std::max(outMax[a], p[a]);
+			}
+		}
+	}
+}
+
+static float HalfArea(const float* bmin, const float* bmax)
+{
+	const float dx = bmax[0] - bmin[0], dy = bmax[1] - bmin[1], dz = bmax[2] - bmin[2];
+	return dx * dy + dy * dz + dz * dx;
+}
+
+// Triangles going left when splitting an oversized leaf; about half, rounded up to a multiple of [WideBVH::maxLeafTris] so the leaves
+// that finally come out are as full as possible
+static uint32_t SplitLeftCount(uint32_t triCount)
+{
+	const uint32_t half = (triCount + 1) / 2;
+	return std::min(triCount - 1, ((half + WideBVH::maxLeafTris - 1) / WideBVH::maxLeafTris) * WideBVH::maxLeafTris);
+}
+
+// Nodes added by splitting a [triCount]-triangle leaf until no part holds more than [WideBVH::maxLeafTris] (see [SplitLeaves])
+static uint64_t SplitNodeCount(uint32_t triCount)
+{
+	return (triCount <= WideBVH::maxLeafTris) ? 0 : (2 + SplitNodeCount(SplitLeftCount(triCount)) + SplitNodeCount(triCount - SplitLeftCount(triCount)));
+}
+
+// Splits leaves with more than [WideBVH::maxLeafTris] triangles (sorted along their longest centroid axis) until none are left; the
+// parts get tight bounds (within their leaf's), so the split leaves stay exact
+static void SplitLeaves(CollapseContext& ctx, uint32_t* stack)
+{
+	const uint32_t numSourceNodes = ctx.numNodes;
+	for (uint32_t n = 0; n < numSourceNodes; n++)
+	{
+		if (ctx.nodes[n].triCount <= WideBVH::maxLeafTris)
+		{
+			continue;
+		}
+
+		uint32_t stackSize = 0;
+		stack[stackSize++] = n;
+		while (stackSize > 0)
+		{
+			CollapseNode& node = ctx.nodes[stack[--stackSize]];
+			if (node.triCount <= WideBVH::maxLeafTris)
+			{
+				continue;
+			}
+
+			float cmin[3] = { INFINITY, INFINITY, INFINITY }, cmax[3] = { -INFINITY, -INFINITY, -INFINITY };
+			auto centroid = [&](uint32_t tri, uint32_t axis)
+			{
+				const float4 &v0 = Vertex(ctx, tri, 0), &v1 = Vertex(ctx, tri, 1), &v2 = Vertex(ctx, tri, 2);
+				return (axis == 0) ? (v0.x + v1.x + v2.x) : ((axis == 1) ? (v0.y + v1.y + v2.y) : (v0.z + v1.z + v2.z));
+			};
+			for (uint32_t i = node.firstTri; i < node.firstTri + node.triCount; i++)
+			{
+				for (uint32_t a = 0; a < 3; a++)
+				{
+					cmin[a] = std::min(cmin[a], centroid(ctx.tris[i], a));
+					cmax[a] = std::max(cmax[a], centroid(ctx.tris[i], a));
+				}
+			}
+
+			const uint32_t axis = (cmax[0] - cmin[0] >= cmax[1] - cmin[1]) ? ((cmax[0] - cmin[0] >= cmax[2] - cmin[2]) ? 0 : 2) : ((cmax[1] - cmin[1] >= cmax[2] - cmin[2]) ? 1 : 2);
+			std::sort(ctx.tris + node.firstTri, ctx.tris + node.firstTri + node.triCount, [&](uint32_t a, uint32_t b) { return centroid(a, axis) < centroid(b, axis); });
+
+			const uint32_t leftCount = SplitLeftCount(node.triCount);
+			const uint32_t left = ctx.numNodes++, right = ctx.numNodes++;
+			CollapseNode& leftNode = ctx.nodes[left];
+			CollapseNode& rightNode = ctx.nodes[right];
+			leftNode = { {}, {}, 0, 0, node.firstTri, leftCount };
+			rightNode = { {}, {}, 0, 0, node.firstTri + leftCount, node.triCount - leftCount };
+			TriangleBounds(ctx, leftNode.firstTri, leftNode.triCount, leftNode.bmin, leftNode.bmax);
+			TriangleBounds(ctx, rightNode.firstTri, rightNode.triCount, rightNode.bmin, rightNode.bmax);
+			for (uint32_t a = 0; a < 3; a++)
+			{
+				// Leaves from spatial-split trees (see BVH.h) only need to cover their triangles' pieces
+				leftNode.bmin[a] = std::max(leftNode.bmin[a], node.bmin[a]);
+				leftNode.bmax[a] = std::min(leftNode.bmax[a], node.bmax[a]);
+				rightNode.bmin[a] = std::max(rightNode.bmin[a], node.bmin[a]);
+				rightNode.bmax[a] = std::min(rightNode.bmax[a], node.bmax[a]);
+			}
+
+			node.left = left;
+			node.right = right;
+			node.triCount = 0;
+			stack[stackSize++] = left;
+			stack[stackSize++] = right;
+		}
+	}
+}
+
+// Picks a wide node's children: starting from [root], keep opening the largest-area branch until there are [WideBVH::width] children
+// or only leaves left; returns the number of children
+static uint32_t GatherChildren(const CollapseContext& ctx, uint32_t root, uint32_t* outChildren)
+{
+	uint32_t numChildren = 1;
+	outChildren[0] = root;
+	while (numChildren < WideBVH::width)
+	{
+		int32_t open = -1;
+		float openArea = -1.0f;
+		for (uint32_t i = 0; i < numChildren; i++)
+		{
+			const CollapseNode& child = ctx.nodes[outChildren[i]];
+			if (child.triCount == 0 && HalfArea(child.bmin, child.bmax) > openArea)
+			{
+				open = static_cast<int32_t>(i);
+				openArea = HalfArea(child.bmin, child.bmax);
+			}
+		}
+
+		if (open < 0)
+		{
+			break;
+		}
+
+		const CollapseNode& opened = ctx.nodes[outChildren[open]];
+		outChildren[open] = opened.left;
+		outChildren[numChildren++] = opened.right;
+	}
+	return numChildren;
+}
+
+// Slot [s] favours the child lying furthest along (±1, ±1, ±1), with bits 2/1/0 of [s] picking the negative direction for x/y/z; a ray
+// whose direction has sign bits [octant] (in the same order) tends to meet slot octant ^ 7's child first and slot [octant]'s last, so
+// visiting slots octant ^ 7, octant ^ 6, ..., octant runs roughly near-to-far; slots are assigned greedily, best (child, slot) pair first
+static void AssignSlots(const CollapseContext& ctx, const uint32_t* children, uint32_t numChildren, const float* parentMin, const float* parentMax, int32_t* outSlots)
+{
+	float cost[WideBVH::width][WideBVH::width];
+	for (uint32_t c = 0; c < numChildren; c++)
+	{
+		const CollapseNode& child = ctx.nodes[children[c]];
+		float offset[3];
+		for (uint32_t a = 0; a < 3; a++)
+		{
+			offset[a] = (child.bmin[a] + child.bmax[a]) - (parentMin[a] + parentMax[a]);
+		}
+
+		for (uint32_t s = 0; s < WideBVH::width; s++)
+		{
+			cost[c][s] = ((s & 4) ? -offset[0] : offset[0]) + ((s & 2) ? -offset[1] : offset[1]) + ((s & 1) ? -offset[2] : offset[2]);
+		}
+		outSlots[c] = -1;
+	}
+
+	uint32_t usedSlots = 0;
+	for (uint32_t assigned = 0; assigned < numChildren; assigned++)
+	{
+		uint32_t bestChild = 0, bestSlot = 0;
+		float bestCost = -INFINITY;
+		for (uint32_t c = 0; c < numChildren; c++)
+		{
+			for (uint32_t s = 0; s < WideBVH::width && outSlots[c] < 0; s++)
+			{
+				if (!(usedSlots & (1u << s)) && (cost[c][s] > bestCost || bestCost == -INFINITY))
+				{
+					bestChild = c;
+					bestSlot = s;
+					bestCost = cost[c][s];
+				}
+			}
+		}
+		outSlots[bestChild] = static_cast<int32_t>(bestSlot);
+		usedSlots |= 1u << bestSlot;
+	}
+}
+
+static float ExponentScale(uint32_t biasedExponent)
+{
+	return std::bit_cast<float>(biasedExponent << 23);
+}
+
+static float DecodeBound(float origin, uint32_t q, float scale)
+{
+	return origin + static_cast<float>(q) * scale; // q * scale is exact (eight bits times a power of two), so this rounds once, fused or not
+}
+
+// Quantises [numChildren] child boxes against [nodeMin] (which contains them all); every decoded box contains its child's
+static void Quantise(const CollapseContext& ctx, const uint32_t* children, const int32_t* slots, uint32_t numChildren, const float* nodeMin, const float* nodeMax,
+					 ComputeWideBVH_Node& out)
+{
+	uint8_t qlo[3][WideBVH::width] = {}, qhi[3][WideBVH::width] = {};
+	uint32_t exponents[3];
+	const float origin[3] = { nodeMin[0], nodeMin[1], nodeMin[2] };
+	for (uint32_t a = 0; a < 3; a++)
+	{
+		// Smallest power of two that spans the node in 255 steps; rounding while decoding can still fall short, in which case the next
+		// one up is tried
+		const float extent = nodeMax[a] - origin[a];
+		int32_t exponent = 0;
+		std::frexp(extent / 255.0f, &exponent);
+		uint32_t biased = static_cast<uint32_t>(std::clamp(exponent + 127, 1, 254));
+		while (true)
+		{
+			const float scale = ExponentScale(biased), invScale = 1.0f / scale;
+			bool fits = true;
+			for (uint32_t c = 0; c < numChildren && fits; c++)
+			{
+				const CollapseNode& child = ctx.nodes[children[c]];
+				int32_t lo = std::clamp(static_cast<int32_t>(std::floor((child.bmin[a] - origin[a]) * invScale)), 0, 255);
+				while (lo > 0 && DecodeBound(origin[a], lo, scale) > child.bmin[a])
+				{
+					lo--;
+				}
+
+				int32_t hi = std::clamp(static_cast<int32_t>(std::ceil((child.bmax[a] - origin[a]) * invScale)), lo, 255);
+				while (hi < 255 && DecodeBound(origin[a], hi, scale) < child.bmax[a])
+				{
+					hi++;
+				}
+
+				fits = (DecodeBound(origin[a], hi, scale) >= child.bmax[a]);
+				qlo[a][slots[c]] = static_cast<uint8_t>(lo);
+				qhi[a][slots[c]] = static_cast<uint8_t>(hi);
+			}
+
+			if (fits || biased == 254)
+			{
+				break;
+			}
+			biased++;
+		}
+		exponents[a] = biased;
+	}
+
+	out.origin = float3(origin[0], origin[1], origin[2]);
+	out.exponentsAndImask = (out.exponentsAndImask & 0xff000000u) | exponents[0] | (exponents[1] << 8) | (exponents[2] << 16);
+	for (uint32_t a = 0; a < 3; a++)
+	{
+		memcpy(&out.qlo[a * 2], qlo[a], WideBVH::width);
+		memcpy(&out.qhi[a * 2], qhi[a], WideBVH::width);
+	}
+}
+
+void WideBVH::Build(const BVH& bvh, const float4* _positions, [[maybe_unused]] uint64_t numVerts, uint64_t _strideBytes, const IndexedTriangle* _tris)
+{
+	assert(BVH::TriIndicesInRange(_tris, bvh.NumTris(), numVerts));
+	positions = _positions;
+	strideBytes = _strideBytes;
+	tris = _tris;
+	numTris = bvh.NumTris();
+	triListLen = bvh.TriListLen();
+	stats = {};
+
+	const ComputeBVH_Node* sourceNodes = &bvh.Nodes()[0];
+	const uint32_t numSourceNodes = bvh.NumNodes();
+	for (uint32_t a = 0; a < 3; a++)
+	{
+		rootMin[a] = (&sourceNodes[0].boundsMin.x)[a];
+		rootMax[a] = (&sourceNodes[0].boundsMax.x)[a];
+	}
+
+	// Scratch: the binary tree (plus the nodes splitting its leaves will add) + its triangle list, then the emitted wide nodes (at most
+	// one per binary branch, or just the root) + a work stack of (binary node, wide node, depth) triples
+	uint64_t numCollapseNodes = numSourceNodes;
+	for (uint32_t n = 0; n < numSourceNodes && numTris > 0; n++)
+	{
+		numCollapseNodes += SplitNodeCount(sourceNodes[n].triCount);
+	}
+	const uint64_t maxWideNodes = (numCollapseNodes - 1) / 2 + 1;
+	auto collapseNodes = CPUMemory::AllocateArray<CollapseNode>(numCollapseNodes);
+	auto scratchTris = CPUMemory::AllocateArray<uint32_t>(std::max(triListLen, 1u));
+	auto stack = CPUMemory::AllocateArray<uint32_t>(maxWideNodes * 3);
+	auto wideScratch = CPUMemory::AllocateArray<ComputeWideBVH_Node>(maxWideNodes);
+
+	CollapseContext ctx;
+	ctx.nodes = &collapseNodes[0];
+	ctx.numNodes = numSourceNodes;
+	ctx.tris = &scratchTris[0];
+	ctx.positionBytes = reinterpret_cast<const uint8_t*>(positions);
+	ctx.strideBytes = strideBytes;
+	ctx.meshTris = tris;
+	if (numTris > 0)
+	{
+		memcpy(ctx.tris, &bvh.TriList()[0], triListLen * sizeof(uint32_t));
+	}
+
+	for (uint32_t n = 0; n < numSourceNodes; n++)
+	{
+		const ComputeBVH_Node& src = sourceNodes[n];
+		CollapseNode& dst = ctx.nodes[n];
+		dst = { { src.boundsMin.x, src.boundsMin.y, src.boundsMin.z }, { src.boundsMax.x, src.boundsMax.y, src.boundsMax.z }, n + 1, src.rightOrFirstTri, 0, 0 };
+		if (src.triCount > 0 || numTris == 0)
+		{
+			dst.firstTri = src.rightOrFirstTri;
+			dst.triCount = src.triCount;
+		}
+	}
+	SplitLeaves(ctx, &stack[0]);
+
+	// Wide nodes top-down; a node's internal children are emitted together, so they're contiguous, and its leaves' triangles likewise
+	ComputeWideBVH_Node* wide = &wideScratch[0];
+	uint32_t* work = &stack[0]; // Pairs of (binary node, wide node)
+	uint32_t* workDepths = &stack[maxWideNodes * 2];
+	uint32_t workSize = 0;
+	uint32_t numWideNodes = 1, numWideTris = 0;
+	uint64_t numChildSlots = 0;
+	work[0] = 0;
+	work[1] = 0;
+	workDepths[0] = 0;
+	workSize = 1;
+	auto outTris = CPUMemory::AllocateArray<uint32_t>(std::max(triListLen, 1u));
+	uint32_t* outTriData = &outTris[0];
+	while (workSize > 0)
+	{
+		workSize--;
+		const uint32_t binaryNdx = work[workSize * 2], wideNdx = work[workSize * 2 + 1], depth = workDepths[workSize];
+		stats.depth = std::max(stats.depth, depth);
+		assert(depth < maxWideDepth);
+
+		ComputeWideBVH_Node& node = wide[wideNdx];
+		memset(&node, 0, sizeof(node));
+		if (numTris == 0)
+		{
+			node.exponentsAndImask = 127 | (127 << 8) | (127 << 16);
+			break;
+		}
+
+		uint32_t children[width];
+		int32_t slots[width];
+		const uint32_t numChildren = GatherChildren(ctx, binaryNdx, children);
+		const CollapseNode& binaryNode = ctx.nodes[binaryNdx];
+		AssignSlots(ctx, children, numChildren, binaryNode.bmin, binaryNode.bmax, slots);
+		numChildSlots += numChildren;
+
+		// Internal children in slot order
+		uint32_t imask = 0;
+		uint8_t meta[width] = {};
+		for (uint32_t c = 0; c < numChildren; c++)
+		{
+			imask |= (ctx.nodes[children[c]].triCount == 0) ? (1u << slots[c]) : 0;
+		}
+
+		node.childBase = numWideNodes;
+		node.triBase = numWideTris;
+		for (uint32_t s = 0; s < width; s++)
+		{
+			for (uint32_t c = 0; c < numChildren; c++)
+			{
+				if (slots[c] != static_cast<int32_t>(s))
+				{
+					continue;
+				}
+
+				const CollapseNode& child = ctx.nodes[children[c]];
+				if (child.triCount == 0)
+				{
+					meta[s] = static_cast<uint8_t>((1u << 5) | (24 + s));
+					work[workSize * 2] = children[c];
+					work[workSize * 2 + 1] = numWideNodes++;
+					workDepths[workSize] = depth + 1;
+					workSize++;
+				}
+				else
+				{
+					const uint32_t offset = numWideTris - node.triBase;
+					meta[s] = static_cast<uint8_t>((((1u << child.triCount) - 1) << 5) | offset);
+					memcpy(outTriData + numWideTris, ctx.tris + child.firstTri, child.triCount * sizeof(uint32_t));
+					numWideTris += child.triCount;
+					stats.numLeaves++;
+				}
+			}
+		}
+
+		node.exponentsAndImask = imask << 24;
+		memcpy(node.meta, meta, width);
+		Quantise(ctx, children, slots, numChildren, binaryNode.bmin, binaryNode.bmax, node);
+	}
+	assert(numWideTris == triListLen);
+
+	// Exact-size output
+	nodes = CPUMemory::AllocateArray<ComputeWideBVH_Node>(numWideNodes);
+	memcpy(&nodes[0], &wideScratch[0], numWideNodes * sizeof(ComputeWideBVH_Node));
+	triList = CPUMemory::AllocateArray<uint32_t>(std::max(triListLen, 1u));
+	if (numTris > 0)
+	{
+		memcpy(&triList[0], &outTris[0], triListLen * sizeof(uint32_t));
+	}
+
+	CPUMemory::Free(outTris);
+	CPUMemory::Free(wideScratch);
+	CPUMemory::Free(stack);
+	CPUMemory::Free(scratchTris);
+	CPUMemory::Free(collapseNodes);
+
+	stats.numNodes = numWideNodes;
+	stats.meanChildren = (numTris > 0) ? static_cast<float>(static_cast<double>(numChildSlots) / numWideNodes) : 0.0f;
+	stats.nodeBytes = static_cast<uint64_t>(numWideNodes) * sizeof(ComputeWideBVH_Node);
+	stats.triListBytes = static_cast<uint64_t>(triListLen) * sizeof(uint32_t);
+}
+
+// Relayout
+
+static uint32_t NumInternalChildren(const ComputeWideBVH_Node& node)
+{
+	return static_cast<uint32_t>(std::popcount(node.exponentsAndImask >> 24));
+}
+
+// Triangles under [node]'s leaf slots; they're contiguous from its [triBase]
+static uint32_t NumLeafTris(const ComputeWideBVH_Node& node)
+{
+	const uint8_t* meta = reinterpret_cast<const uint8_t*>(node.meta);
+	const uint32_t imask = node.exponentsAndImask >> 24;
+	uint32_t count = 0;
+	for (uint32_t s = 0; s < WideBVH::width; s++)
+	{
+		count += (imask & (1u << s)) ? 0 : static_cast<uint32_t>(std::popcount(static_cast<uint32_t>(meta[s] >> 5)));
+	}
+	return count;
+}
+
+// Nodes with internal children, in the order their child groups should be placed; each helper returns how many it wrote
+static uint32_t DepthFirstGroups(const ComputeWideBVH_Node* nodes, uint32_t* stack, uint32_t* outOrder)
+{
+	uint32_t numGroups = 0, stackSize = 1;
+	stack[0] = 0;
+	while (stackSize > 0)
+	{
+		const ComputeWideBVH_Node& node = nodes[stack[--stackSize]];
+		const uint32_t numChildren = NumInternalChildren(node);
+		if (numChildren > 0)
+		{
+			outOrder[numGroups++] = static_cast<uint32_t>(&node - nodes);
+			for (uint32_t c = numChildren; c > 0; c--)
+			{
+				stack[stackSize++] = node.childBase + c - 1;
+			}
+		}
+	}
+	return numGroups;
+}
+
+static uint32_t BreadthFirstGroups(const ComputeWideBVH_Node* nodes, uint32_t* queue, uint32_t* outOrder)
+{
+	uint32_t numGroups = 0, head = 0, tail = 1;
+	queue[0] = 0;
+	while (head < tail)
+	{
+		const ComputeWideBVH_Node& node = nodes[queue[head++]];
+		const uint32_t numChildren = NumInternalChildren(node);
+		if (numChildren > 0)
+		{
+			outOrder[numGroups++] = static_cast<uint32_t>(&node - nodes);
+			for (uint32_t c = 0; c < numChildren; c++)
+			{
+				queue[tail++] = node.childBase + c;
+			}
+		}
+	}
+	return numGroups;
+}
+
+// Clusters grow breadth-first from their roots until another child group would take them past [maxClusterNodes]; nodes whose groups
+// didn't fit root the next clusters, which follow depth-first
+static uint32_t TreeletGroups(const ComputeWideBVH_Node* nodes, uint32_t maxClusterNodes, uint32_t* stack, uint32_t* queue, uint32_t* deferred, uint32_t* outOrder)
+{
+	uint32_t numGroups = 0, stackSize = 1;
+	stack[0] = 0;
+	while (stackSize > 0)
+	{
+		uint32_t head = 0, tail = 1, numDeferred = 0, clusterNodes = 0;
+		queue[0] = stack[--stackSize];
+		while (head < tail)
+		{
+			const ComputeWideBVH_Node& node = nodes[queue[head++]];
+			const uint32_t numChildren = NumInternalChildren(node);
+			if (numChildren == 0)
+			{
+				continue;
+			}
+
+			if (clusterNodes > 0 && clusterNodes + numChildren > maxClusterNodes)
+			{
+				deferred[numDeferred++] = static_cast<uint32_t>(&node - nodes);
+				continue;
+			}
+
+			outOrder[numGroups++] = static_cast<uint32_t>(&node - nodes);
+			clusterNodes += numChildren;
+			for (uint32_t c = 0; c < numChildren; c++)
+			{
+				queue[tail++] = node.childBase + c;
+			}
+		}
+
+		for (uint32_t i = numDeferred; i > 0; i--)
+		{
+			stack[stackSize++] = deferred[i - 1];
+		}
+	}
+	return numGroups;
+}
+
+void WideBVH::Relayout(const LayoutSettings& settings)
+{
+	const uint32_t numNodes = stats.numNodes;
+	if (numTris == 0)
+	{
+		return;
+	}
+
+	// Scratch: group order (by parent), new node indices, and up to three node stacks/queues; hit-frequency layouts also count visits,
+	// logging each sample's nodes (closest-hit queries visit nodes once at most)
+	const bool byFrequency = (settings.layout == Layout::HitFrequency);
+	auto groupOrder = CPUMemory::AllocateArray<uint32_t>(numNodes);
+	auto newIndices = CPUMemory::AllocateArray<uint32_t>(numNodes);
+	auto work = CPUMemory::AllocateArray<uint32_t>(numNodes * 3ull);
+	auto visits = CPUMemory::AllocateArray<uint32_t>(byFrequency ? numNodes * 3ull : 1);
+	const ComputeWideBVH_Node* nodeData = &nodes[0];
+	uint32_t* order = &groupOrder[0];
+	uint32_t* stackData = &work[0];
+
+	uint32_t numGroups = 0;
+	switch (settings.layout)
+	{
+		case Layout::BreadthFirst:
+			numGroups = BreadthFirstGroups(nodeData, stackData, order);
+			break;
+		case Layout::DepthFirst:
+			numGroups = DepthFirstGroups(nodeData, stackData, order);
+			break;
+		case Layout::Treelets:
+			numGroups = TreeletGroups(nodeData, std::max(settings.treeletBytes / static_cast<uint32_t>(sizeof(ComputeWideBVH_Node)), 1u), stackData, stackData + numNodes,
+									  stackData + numNodes * 2ull, order);
+			break;
+		case Layout::HitFrequency:
+		{
+			uint32_t* visitData = &visits[0];
+			memset(visitData, 0, numNodes * sizeof(uint32_t));
+			TraceLog log = { visitData + numNodes, visitData + numNodes * 2ull, numNodes, 0, 0 };
+			for (uint32_t r = 0; r < settings.numSampleRays; r++)
+			{
+				Hit hit;
+				log.numNodes = 0;
+				log.numTris = 0;
+				ClosestHit(settings.sampleRays[r], &hit, &log);
+				for (uint32_t i = 0; i < std::min(log.numNodes, log.maxEntries); i++)
+				{
+					visitData[log.nodes[i]]++;
+				}
+			}
+
+			// Hot groups first; visits only fall going down the tree, so parents' groups still precede their children's, and ties (mostly
+			// unvisited subtrees) keep depth-first order
+			numGroups = DepthFirstGroups(nodeData, stackData + numNodes, order);
+			uint32_t* dfsRanks = stackData;
+			for (uint32_t i = 0; i < numGroups; i++)
+			{
+				dfsRanks[order[i]] = i;
+			}
+			std::sort(order, order + numGroups, [&](uint32_t a, uint32_t b)
+			{
+				return (visitData[a] != visitData[b]) ? (visitData[a] > visitData[b]) : (dfsRanks[a] < dfsRanks[b]);
+			});
+			break;
+		}
+	}
+
+	// Groups take consecutive indices after the root, in order
+	uint32_t* indexData = &newIndices[0];
+	uint32_t* oldIndices = stackData;
+	indexData[0] = 0;
+	oldIndices[0] = 0;
+	uint32_t numPlaced = 1;
+	for (uint32_t g = 0; g < numGroups; g++)
+	{
+		const ComputeWideBVH_Node& parent = nodeData[order[g]];
+		for (uint32_t c = 0; c < NumInternalChildren(parent); c++)
+		{
+			indexData[parent.childBase + c] = numPlaced;
+			oldIndices[numPlaced++] = parent.childBase + c;
+		}
+	}
+	assert(numPlaced == numNodes);
+
+	// Leaf triangles follow the new node order too
+	auto outNodes = CPUMemory::AllocateArray<ComputeWideBVH_Node>(numNodes);
+	auto outTris = CPUMemory::AllocateArray<uint32_t>(triListLen);
+	auto outLeafTris = settings.reorderTris ? CPUMemory::AllocateArray<IndexedTriangle>(triListLen) : CPUMemory::ArrayAllocHandle<IndexedTriangle>();
+	const uint32_t* triData = &triList[0];
+	uint32_t* outTriData = &outTris[0];
+	uint32_t numPlacedTris = 0;
+	for (uint32_t n = 0; n < numNodes; n++)
+	{
+		ComputeWideBVH_Node node = nodeData[oldIndices[n]];
+		if (NumInternalChildren(node) > 0)
+		{
+			node.childBase = indexData[node.childBase];
+		}
+
+		const uint32_t nodeTris = NumLeafTris(node);
+		memcpy(outTriData + numPlacedTris, triData + node.triBase, nodeTris * sizeof(uint32_t));
+		node.triBase = numPlacedTris;
+		numPlacedTris += nodeTris;
+		outNodes[n] = node;
+	}
+	assert(numPlacedTris == triListLen);
+
+	if (settings.reorderTris)
+	{
+		IndexedTriangle* leafTriData = &outLeafTris[0];
+		for (uint32_t i = 0; i < triListLen; i++)
+		{
+			leafTriData[i] = tris[outTriData[i]];
+		}
+	}
+
+	CPUMemory::Free(visits);
+	CPUMemory::Free(work);
+	CPUMemory::Free(newIndices);
+	CPUMemory::Free(groupOrder);
+	if (leafTris.arrayLen > 0)
+	{
+		CPUMemory::Free(leafTris);
+	}
+	CPUMemory::Free(triList);
+	CPUMemory::Free(nodes);
+	nodes = outNodes;
+	triList = outTris;
+	leafTris = outLeafTris;
+}
+
+void WideBVH::DeInit()
+{
+	if (leafTris.arrayLen > 0)
+	{
+		CPUMemory::Free(leafTris);
+	}
+	CPUMemory::Free(triList);
+	CPUMemory::Free(nodes);
+	triList = {};
+	nodes = {};
+	leafTris = {};
+	numTris = 0;
+	triListLen = 0;
+	stats = {};
+}
+
+void WideBVH::ChildBounds(const ComputeWideBVH_Node& node, uint32_t slot, float* outMin, float* outMax)
+{
+	const float origin[3] = { node.origin.x, node.origin.y, node.origin.z };
+	const uint8_t* qlo = reinterpret_cast<const uint8_t*>(node.qlo);
+	const uint8_t* qhi = reinterpret_cast<const uint8_t*>(node.qhi);
+	for (uint32_t a = 0; a < 3; a++)
+	{
+		const float scale = ExponentScale((node.exponentsAndImask >> (a * 8)) & 0xff);
+		outMin[a] = DecodeBound(origin[a], qlo[a * width + slot], scale);
+		outMax[a] = DecodeBound(origin[a], qhi[a * width + slot], scale);
+	}
+}
+
+template<bool anyHit, bool logged>
+bool WideBVH::Trace(const Ray& ray, Hit* outHit, TraceLog* log) const
+{
+	if (numTris == 0)
+	{
+		return false;
+	}
+
+	const RayPrecomp rp = PrecomputeRay(ray.origin, ray.dir);
+	float tMax = ray.tMax;
+	float rootEntry;
+	if (!RayBox(rootMin, rootMax, rp, ray.tMin, tMax, &rootEntry))
+	{
+		return false;
+	}
+
+	const ComputeWideBVH_Node* nodeData = &nodes[0];
+	const uint32_t* triData = &triList[0];
+	const IndexedTriangle* leafTriData = (leafTris.arrayLen > 0) ? &leafTris[0] : nullptr;
+	const uint8_t* positionBytes = reinterpret_cast<const uint8_t*>(positions);
+
+	// Per-axis ray constants, broadcast across the eight child slots
+	const __m256 org[3] = { _mm256_set1_ps(rp.org[0]), _mm256_set1_ps(rp.org[1]), _mm256_set1_ps(rp.org[2]) };
+	const __m256 invDir[3] = { _mm256_set1_ps(rp.invDir[0]), _mm256_set1_ps(rp.invDir[1]), _mm256_set1_ps(rp.invDir[2]) };
+	const __m256 farScale = _mm256_set1_ps(robustFarScale);
+	const __m256 rayTMin = _mm256_set1_ps(ray.tMin);
+
+	uint32_t stackNodes[traversalStackSize];
+	float stackEntries[traversalStackSize];
+	uint32_t stackSize = 1;
+	stackNodes[0] = 0;
+	stackEntries[0] = rootEntry;
+	bool found = false;
+	while (stackSize > 0)
+	{
+		stackSize--;
+		if (stackEntries[stackSize] > tMax)
+		{
+			continue;
+		}
+		const ComputeWideBVH_Node& node = nodeData[stackNodes[stackSize]];
+		if constexpr (logged)
+		{
+			if (log->numNodes < log->maxEntries)
+			{
+				log->nodes[log->numNodes] = stackNodes[stackSize];
+			}
+			log->numNodes++;
+		}
+
+		// Decode + slab-test every slot at once; same arithmetic as RayBox, so boxes are culled conservatively
+		__m256 entry = rayTMin, exit = _mm256_set1_ps(tMax);
+		const float origin[3] = { node.origin.x, node.origin.y, node.origin.z };
+		for (uint32_t a = 0; a < 3; a++)
+		{
+			const __m256 scale = _mm256_set1_ps(ExponentScale((node.exponentsAndImask >> (a * 8)) & 0xff));
+			const __m256 base = _mm256_set1_ps(origin[a]);
+			const __m256 lo = _mm256_fmadd_ps(_mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(&node.qlo[a * 2])))), scale, base);
+			const __m256 hi = _mm256_fmadd_ps(_mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(&node.qhi[a * 2])))), scale, base);
+			const __m256 t0 = _mm256_mul_ps(_mm256_sub_ps(lo, org[a]), invDir[a]);
+			const __m256 t1 = _mm256_mul_ps(_mm256_sub_ps(hi, org[a]), invDir[a]);
+			entry = _mm256_max_ps(_mm256_min_ps(t0, t1), entry);
+			exit = _mm256_min_ps(_mm256_mul_ps(_mm256_max_ps(t0, t1), farScale), exit);
+		}
+
+		uint64_t metaBits;
+		memcpy(&metaBits, node.meta, sizeof(metaBits));
+		const __m256i occupied = _mm256_cvtepu8_epi32(_mm_cvtsi64_si128(static_cast<long long>(metaBits)));
+		const uint32_t occupiedMask = static_cast<uint32_t>(_mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpgt_epi32(occupied, _mm256_setzero_si256()))));
+		uint32_t hitMask = static_cast<uint32_t>(_mm256_movemask_ps(_mm256_cmp_ps(entry, exit, _CMP_LE_OQ))) & occupiedMask;
+		if (hitMask == 0)
+		{
+			continue;
+		}
+
+		alignas(32) float entries[width];
+		_mm256_store_ps(entries, entry);
+		const uint32_t imask = node.exponentsAndImask >> 24;
+
+		// Leaves right away (shrinking [tMax] before children are pushed), internal children onto the stack far-to-near
+		uint32_t pending[width];
+		uint32_t numPending = 0;
+		while (hitMask != 0)
+		{
+			const uint32_t slot = static_cast<uint32_t>(std::countr_zero(hitMask));
+			hitMask &= hitMask - 1;
+			if (imask & (1u << slot))
+			{
+				pending[numPending++] = slot;
+				continue;
+			}
+
+			const uint32_t meta = node.meta[slot / 4] >> ((slot % 4) * 8);
+			const uint32_t first = node.triBase + (meta & 0x1f), count = static_cast<uint32_t>(std::popcount((meta >> 5) & 0x7));
+			for (uint32_t i = first; i < first + count; i++)
+			{
+				if constexpr (logged)
+				{
+					if (log->numTris < log->maxEntries)
+					{
+						log->tris[log->numTris] = i;
+					}
+					log->numTris++;
+				}
+
+				const uint32_t tri = triData[i];
+				const uint4& ndx = (leafTriData != nullptr) ? leafTriData[i].xyz : tris[tri].xyz;
+				const float4& v0 = *reinterpret_cast<const float4*>(positionBytes + ndx.x * strideBytes);
+				const float4& v1 = *reinterpret_cast<const float4*>(positionBytes + ndx.y * strideBytes);
+				const float4& v2 = *reinterpret_cast<const float4*>(positionBytes + ndx.z * strideBytes);
+
+				float t, u, v;
+				if (RayTriangle(rp, v0, v1, v2, ray.tMin, tMax, &t, &u, &v) && (!found || t < tMax))
+				{
+					found = true;
+					tMax = t;
+					if constexpr (anyHit)
+					{
+						return true;
+					}
+					else
+					{
+						*outHit = { t, u, v, tri };
+					}
+				}
+			}
+		}
+
+		// Insertion sort, nearest last so it's popped first
+		for (uint32_t i = 1; i < numPending; i++)
+		{
+			const uint32_t slot = pending[i];
+			uint32_t j = i;
+			while (j > 0 && entries[pending[j - 1]] < entries[slot])
+			{
+				pending[j] = pending[j - 1];
+				j--;
+			}
+			pending[j] = slot;
+		}
+
+		for (uint32_t i = 0; i < numPending; i++)
+		{
+			const uint32_t slot = pending[i];
+			if (entries[slot] <= tMax)
+			{
+				stackNodes[stackSize] = node.childBase + static_cast<uint32_t>(std::popcount(imask & ((1u << slot) - 1)));
+				stackEntries[stackSize] = entries[slot];
+				stackSize++;
+			}
+		}
+	}
+	return found;
+}
+
+bool WideBVH::ClosestHit(const Ray& ray, Hit* outHit) const
+{
+	*outHit = { ray.tMax, 0.0f, 0.0f, invalidTri };
+	return Trace<false, false>(ray, outHit, nullptr);
+}
+
+bool WideBVH::ClosestHit(const Ray& ray, Hit* outHit, TraceLog* log) const
+{
+	*outHit = { ray.tMax, 0.0f, 0.0f, invalidTri };
+	return Trace<false, true>(ray, outHit, log);
+}
+
+bool WideBVH::AnyHit(const Ray& ray) const
+{
+	Hit hit;
+	return Trace<true, false>(ray, &hit, nullptr);
+}
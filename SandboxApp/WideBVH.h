@@ -0,0 +1,118 @@
+#pragma once
+
+#include <stdint.h>
+#include "../CPUMemory.h"
+#include "../Math.h"
+#include "../Shaders/SharedStructs.h"
+#include "BVH.h"
+
+// Compressed 8-wide BVH (see ComputeWideBVH_Node in SharedStructs.h), collapsed from a finished binary BVH
+// - Leaves holding more than three triangles are first split (along their longest centroid axis) until none do; each wide node
+//   then greedily opens its largest-area internal descendants until it has eight children or runs out of internal ones to open
+// - Children are assigned to slots by the directions of their centroids from their parent's (Ylitie et al. 2017), so a shader can walk
+//   them near-to-far from a ray's octant alone
+// - Child bounds are quantised conservatively (decoded boxes always contain their subtrees), so traversal gives exactly the results of
+//   the binary tree it came from; the CPU traversal here decodes all eight children per node at once (AVX2), and orders hit children
+//   by entry distance
+// - Like TwoLevelAS, meshes aren't copied, so their positions/triangles must outlive the structure; queries are const + allocation-free
+// - Builds lay nodes out depth-first; [Relayout] can reorder them afterwards (each node's internal children stay contiguous, but their
+//   groups can go anywhere), breadth-first, in page-sized treelets (subtree clusters, as in cache-oblivious layouts), or by how often
+//   sampled rays reach them, and can copy triangles' vertex indices into leaf order so leaves read them sequentially
+class WideBVH
+{
+	public:
+		static constexpr uint32_t width = AS_WIDE_BVH_WIDTH;
+		static constexpr uint32_t maxLeafTris = 3; // Per child slot; larger binary leaves are split during conversion
+		static constexpr uint32_t invalidTri = UINT32_MAX;
+
+		struct Ray
+		{
+			float4 origin; // w unused
+			float4 dir; // w unused; needn't be normalized (distances are in units of |dir|)
+			float tMin, tMax;
+		};
+
+		struct Hit
+		{
+			float t;
+			float u, v; // Barycentric weights for the triangle's second/third vertices
+			uint32_t tri;
+		};
+
+		enum class Layout
+		{
+			BreadthFirst, // Level by level, as the sparse octree stores itself
+			DepthFirst, // Each node's children right after it, then their subtrees in slot order
+			Treelets, // Breadth-first clusters of up to [treeletBytes], each followed depth-first by the clusters below it
+			HitFrequency // Hottest nodes' children first, by visits from [sampleRays]; unvisited nodes fall back to depth-first order
+		};
+
+		struct LayoutSettings
+		{
+			Layout layout = Layout::DepthFirst;
+			uint32_t treeletBytes = 4096;
+			const Ray* sampleRays = nullptr;
+			uint32_t numSampleRays = 0;
+			bool reorderTris = true; // Copy triangles' vertex indices into triangle list order
+		};
+
+		// Node/triangle list positions a query touched, in order; entries past [maxEntries] are counted but not stored
+		struct TraceLog
+		{
+			uint32_t* nodes;
+			uint32_t* tris;
+			uint32_t maxEntries;
+			uint32_t numNodes, numTris;
+		};
+
+		struct Stats
+		{
+			uint32_t numNodes;
+			uint32_t numLeaves; // Leaf children (slots holding triangles)
+			uint32_t depth; // Deepest level reached (the root is level zero)
+			float meanChildren; // Occupied slots per node
+			uint64_t nodeBytes;
+			uint64_t triListBytes;
+		};
+
+		// [bvh] must have been built over [positions]/[tris]; it isn't referenced after conversion
+		void Build(const BVH& bvh, const float4* positions, uint64_t numVerts, uint64_t strideBytes, const IndexedTriangle* tris);
+		void Relayout(const LayoutSettings& settings);
+		void DeInit();
+
+		// Nearest intersection within [tMin, tMax]; misses return false, with [outHit->tri] set to [invalidTri]
+		bool ClosestHit(const Ray& ray, Hit* outHit) const;
+
+		// As above, recording what the query touched into [log] (for layout analysis)
+		bool ClosestHit(const Ray& ray, Hit* outHit, TraceLog* log) const;
+
+		// Whether anything intersects the ray within [tMin, tMax] (occlusion/shadow rays)
+		bool AnyHit(const Ray& ray) const;
+
+		// Child [slot]'s decoded bounds (only meaningful for occupied slots)
+		static void ChildBounds(const ComputeWideBVH_Node& node, uint32_t slot, float* outMin, float* outMax);
+
+		CPUMemory::ArrayAllocHandle<ComputeWideBVH_Node> Nodes() const { return nodes; }
+		CPUMemory::ArrayAllocHandle<uint32_t> TriList() const { return triList; }
+		CPUMemory::ArrayAllocHandle<IndexedTriangle> LeafTris() const { return leafTris; } // Empty unless [Relayout] reordered triangles
+		uint32_t NumNodes() const { return stats.numNodes; }
+		uint32_t NumTris() const { return numTris; }
+		uint32_t TriListLen() const { return triListLen; } // As BVH::TriListLen
+		const Stats& GetStats() const { return stats; }
+
+	private:
+		template<bool anyHit, bool logged>
+		bool Trace(const Ray& ray, Hit* outHit, TraceLog* log) const;
+
+		CPUMemory::ArrayAllocHandle<ComputeWideBVH_Node> nodes;
+		CPUMemory::ArrayAllocHandle<uint32_t> triList;
+		CPUMemory::ArrayAllocHandle<IndexedTriangle> leafTris;
+		uint32_t numTris = 0;
+		uint32_t triListLen = 0;
+		float rootMin[3] = {}, rootMax[3] = {};
+		Stats stats = {};
+
+		const float4* positions = nullptr;
+		uint64_t strideBytes = 0;
+		const IndexedTriangle* tris = nullptr;
+};
@@ -32,15 +32,30 @@ RWStructuredBuffer<Vertex3D> structuredVBuffer : register(u0);
 	RWStructuredBuffer<MaterialSPD_Piecewise> spectralAtlas : register(u2);
 #endif
 
+// Compute AS: a binary BVH (see BVH.h & ComputeBVH_Node, or its skip-linked form with COMPUTE_AS_STACKLESS, see StacklessBVH.h &
+// ComputeBVH_SkipNode) or the older sparse octree (see SparseOctree.h & ComputeAS_Node), picked by COMPUTE_AS_BVH; all are built
+// CPU-side and read by shading passes, and index triangles through a separate triangle list
+#if COMPUTE_AS_BVH
+#if COMPUTE_AS_STACKLESS
+	#define COMPUTE_AS_NODE ComputeBVH_SkipNode
+#else
+	#define COMPUTE_AS_NODE ComputeBVH_Node
+#endif
+#else
+	#define COMPUTE_AS_NODE ComputeAS_Node
+#endif
+
 #ifdef AS_RESOLVE_PASS
-	RWStructuredBuffer<IndexedTriangle> triBuffer : register(u1); // Indexed by grid acceleration structure
-	RWStructuredBuffer<ComputeAS_Node> octreeAS : register(u2); // Read by shading passes, written by AS resolve
-	RWStructuredBuffer<GPU_PRNG_Channel> prngPathStreams : register(u3);
+	RWStructuredBuffer<IndexedTriangle> triBuffer : register(u1); // Indexed by the AS' triangle list
+	RWStructuredBuffer<COMPUTE_AS_NODE> computeAS : register(u2);
+	RWStructuredBuffer<uint> asTriList : register(u3); // BVH: triangle indices in leaf order; octree: per-leaf lists (count, then indices)
+	RWStructuredBuffer<GPU_PRNG_Channel> prngPathStreams : register(u4);
 #else
 #ifdef SHADING_PASS
-	RWStructuredBuffer<IndexedTriangle> triBuffer : register(u3); // Indexed by grid acceleration structure
-	RWStructuredBuffer<ComputeAS_Node> octreeAS : register(u4); // Read by shading passes, written by AS resolve
-	RWStructuredBuffer<GPU_PRNG_Channel> prngPathStreams : register(u5);
+	RWStructuredBuffer<IndexedTriangle> triBuffer : register(u3); // Indexed by the AS' triangle list
+	RWStructuredBuffer<COMPUTE_AS_NODE> computeAS : register(u4);
+	RWStructuredBuffer<uint> asTriList : register(u5); // BVH: triangle indices in leaf order; octree: per-leaf lists (count, then indices)
+	RWStructuredBuffer<GPU_PRNG_Channel> prngPathStreams : register(u6);
 #endif
 #endif
 
@@ -50,7 +65,7 @@ RWStructuredBuffer<Vertex3D> structuredVBuffer : register(u0);
 	// texOut[xy].xyzw, so we just need this buffer to store the remaining data (sample counts, since we only have
 	// four texture channels; we need those so we can stop accumulating once sample-count == spp (or selectively
 	// restart sampling for scene interactions))
-	RWTexture2D<uint> sampleCountsPerPixel : register(u6);
+	RWTexture2D<uint> sampleCountsPerPixel : register(u7);
 
-	RWTexture2D<float4> texOut : register(u7);
+	RWTexture2D<float4> texOut : register(u8);
 #endif
\ No newline at end of file
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "..\\materials.h"
+#include "..\\SharedBxDFs.hlsli"
 
 RaytracingAccelerationStructure geom_access : register(t0);
 StructuredBuffer<Triangle> geom_materials : register(t1);
@@ -29,6 +29,9 @@ void camera_rays()
 
     // Considering russian-roulette here (bounce rays until probability < epsilon or weight < epsilon) instead of table recursion, but need to get further with infrastructure first
     // Russian roulette will be less biased & possibly cleaner, but might also be slower for complex scenes (maybe, definitely needs testing to make sure)
+    // The headless tracer runs it now (ShadePath, HeadlessTracer/TraceKernel.cpp): paths survive each bounce past a minimum with their
+    // brightest wavelength's throughput as the probability, and divide by it; it matches fixed-depth paths (the "roulette"
+    // verification test), with about half the bounces per path inside closed scenes. This loop should take the same policy once it traces bounces
     ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
     // Staging output inside the camera pass? @.@
@@ -53,6 +56,8 @@ void hit(inout PathVt path)
     // Material search & invoke
     // Unknown materials are treated as diffuse
     // (might use a fixed "error" SPD as well, unsure atm)
+    // Lambert, Oren-Nayar, smooth/GGX conductors and rough dielectrics have models in SharedBxDFs.hlsli (SampleBxDF/EvalBxDF/BxDFPdf),
+    // already running in the CPU tracer; they'll plug in here once hit groups trace bounce rays
     switch (tri.bxdf_id)
     {
         case BXDF_ID_DIFFUSE_LAMBERT:
@@ -85,6 +90,9 @@ void hit(inout PathVt path)
         case BXDF_ID_DIFFUSE_VOLUMETRIC_CLOUDY_MICROFLAKES:
             // Unimplemented atm
             break;
+        case BXDF_ID_DIELECTRIC_ROUGH:
+            // Unimplemented atm
+            break;
         default:
             // Default to lambertian diffuse
             break;
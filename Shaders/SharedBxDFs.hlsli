@@ -0,0 +1,452 @@
+#include "SharedPlatform.h"
+
+#ifdef CPU_SIDE
+#pragma once
+#endif
+
+// Shading functions supported by DXRSandbox
+// More planned? Maybe! Probably not though, I might look at layering support but otherwise this is a lot already
+#define BXDF_ID_DIFFUSE_LAMBERT 0
+#define BXDF_ID_DIFFUSE_OREN_NAYAR 1
+#define BXDF_ID_DIFFUSE_OREN_NAYAR_MULTISCATTER 2
+#define BXDF_ID_SPECULAR_CLASSICAL_SMOOTH 3
+#define BXDF_ID_SPECULAR_COOK_TORRANCE 4
+#define BXDF_ID_SPECULAR_COOK_TORRANCE_MULTISCATTER 5
+#define BXDF_ID_DIFFUSE_VOLUMETRIC_ORGANIC 6
+#define BXDF_ID_DIFFUSE_VOLUMETRIC_CLOUDY 7
+#define BXDF_ID_DIFFUSE_VOLUMETRIC_ORGANIC_MICROFLAKES 8
+#define BXDF_ID_DIFFUSE_VOLUMETRIC_CLOUDY_MICROFLAKES 9
+#define BXDF_ID_DIELECTRIC_ROUGH 10
+
+// BxDFs shared by the ray-tracing shaders and the headless CPU tracer (see HeadlessTracer/), validated on the CPU by
+// Tests/SandboxVerification/BxDFVerification.cpp
+// - Models: Lambert, Oren-Nayar (Oren & Nayar 1994, qualitative form), GGX conductors (Trowbridge-Reitz with height-correlated Smith
+//   masking, sampled from the distribution of visible normals (Heitz 2018)), and rough dielectrics (Walter et al. 2007, sampled
+//   the same way); the multiscatter ids take their single-scattering models, and everything without a model here is Lambertian
+// - Directions are in the shading frame (+z along the normal), both pointing away from the surface; [wo] has to be in the upper
+//   hemisphere (callers orient their frame towards it), and dielectric [eta]s are the far side's ior over [wo]'s
+// - Values are scalar, one per wavelength (the tracers are spectral); none of these models depend on wavelength for sampling, so hero
+//   wavelengths can share a sample (see SharedHeroWavelengths.hlsli)
+// - Each model has an eval (f, without the cosine), a solid-angle pdf, and a sampler that also returns f * |cos| / pdf in closed form,
+//   which tracers multiply their throughput by (so Lambert paths carry their albedo exactly)
+// - Microfacet lobes narrower than BXDF_SMOOTH_ALPHA (and classical smooth specular) are perfectly specular: their samples are
+//   marked [delta], with the chosen lobe's probability as their pdf, and eval/pdf are zero everywhere
+// - Transmitted weights leave out radiance's 1 / eta^2 scaling, which cancels for paths that leave the objects they enter (every path
+//   the sky can light), and keeps dielectrics energy-conserving in both directions
+#define BXDF_PI 3.14159265f
+#define BXDF_INV_PI 0.318309886f
+#define BXDF_TWO_PI 6.28318531f
+#define BXDF_SMOOTH_ALPHA 1e-3f
+
+struct BxDFParams
+{
+    uint id; // BXDF_ID_*
+    float albedo; // Diffuse reflectance
+    float roughness; // Perceptual, 0...1: Oren-Nayar sigma (radians) is [roughness], microfacet alpha is [roughness] squared
+    float eta; // Dielectric ior ratio, or a conductor's real ior
+    float k; // Conductor extinction
+};
+
+struct BxDFSample
+{
+    float3 wi;
+    float pdf; // Zero for failed samples (e.g. reflections below the surface)
+    float weight; // f * |cos(wi)| / pdf; zero for failed samples
+    bool delta;
+};
+
+#ifdef SHADER_CODE
+BxDFSample FailedBxDFSample()
+{
+    BxDFSample sample;
+    sample.wi = float3(0.0f, 0.0f, 1.0f);
+    sample.pdf = 0.0f;
+    sample.weight = 0.0f;
+    sample.delta = false;
+    return sample;
+}
+
+float3 BxDFReflect(float3 wo, float3 n)
+{
+    return n * (2.0f * dot(wo, n)) - wo;
+}
+
+// Refracts [wo] through a surface with normal [n] (on [wo]'s side) and ior ratio [eta]; false for total internal reflection
+bool BxDFRefract(float3 wo, float3 n, float eta, SHARED_OUT(float3) wt)
+{
+    float cosThetaI = dot(n, wo);
+    float sin2ThetaT = max(1.0f - cosThetaI * cosThetaI, 0.0f) / (eta * eta);
+    if (sin2ThetaT >= 1.0f)
+    {
+        return false;
+    }
+    float cosThetaT = sqrt(1.0f - sin2ThetaT);
+    wt = -wo / eta + n * (cosThetaI / eta - cosThetaT);
+    return true;
+}
+
+// Unpolarised Fresnel reflectance
+float DielectricFresnel(float cosThetaI, float eta)
+{
+    cosThetaI = min(max(cosThetaI, 0.0f), 1.0f);
+    float sin2ThetaT = (1.0f - cosThetaI * cosThetaI) / (eta * eta);
+    if (sin2ThetaT >= 1.0f)
+    {
+        return 1.0f;
+    }
+    float cosThetaT = sqrt(1.0f - sin2ThetaT);
+    float parallel = (eta * cosThetaI - cosThetaT) / (eta * cosThetaI + cosThetaT);
+    float perpendicular = (cosThetaI - eta * cosThetaT) / (cosThetaI + eta * cosThetaT);
+    return 0.5f * (parallel * parallel + perpendicular * perpendicular);
+}
+
+// Unpolarised Fresnel reflectance for a complex ior (eta + ik), as PBRT v3's FrConductor
+float ConductorFresnel(float cosThetaI, float eta, float k)
+{
+    cosThetaI = min(max(cosThetaI, 0.0f), 1.0f);
+    float cos2 = cosThetaI * cosThetaI;
+    float sin2 = 1.0f - cos2;
+    float t0 = eta * eta - k * k - sin2;
+    float a2PlusB2 = sqrt(t0 * t0 + 4.0f * eta * eta * k * k);
+    float t1 = a2PlusB2 + cos2;
+    float a = sqrt(max(0.5f * (a2PlusB2 + t0), 0.0f));
+    float t2 = 2.0f * cosThetaI * a;
+    float rs = (t1 - t2) / (t1 + t2);
+    float t3 = cos2 * a2PlusB2 + sin2 * sin2;
+    float t4 = t2 * sin2;
+    float rp = rs * (t3 - t4) / (t3 + t4);
+    return 0.5f * (rp + rs);
+}
+
+// Lambert
+////////////
+
+float3 CosineSampleLocal(float2 u)
+{
+    float r = sqrt(u.x);
+    float phi = BXDF_TWO_PI * u.y;
+    return float3(r * cos(phi), r * sin(phi), sqrt(max(1.0f - u.x, 0.0f)));
+}
+
+float CosineHemispherePdf(float3 wi)
+{
+    return max(wi.z, 0.0f) * BXDF_INV_PI;
+}
+
+float LambertEval(float albedo, float3 wo, float3 wi)
+{
+    return (wo.z > 0.0f && wi.z > 0.0f) ? albedo * BXDF_INV_PI : 0.0f;
+}
+
+BxDFSample LambertSample(float albedo, float2 u)
+{
+    BxDFSample sample;
+    sample.wi = CosineSampleLocal(u);
+    sample.pdf = CosineHemispherePdf(sample.wi);
+    sample.weight = albedo; // Cosine sampling cancels Lambert's cosine/pdf
+    sample.delta = false;
+    return sample;
+}
+
+// Oren-Nayar (sampled as Lambert)
+///////////////////////////////////
+
+// Oren-Nayar's scale on Lambert; one at [sigma] zero
+float OrenNayarTerm(float sigma, float3 wo, float3 wi)
+{
+    float sigma2 = sigma * sigma;
+    float a = 1.0f - sigma2 / (2.0f * (sigma2 + 0.33f));
+    float b = 0.45f * sigma2 / (sigma2 + 0.09f);
+
+    float sinThetaI = sqrt(max(1.0f - wi.z * wi.z, 0.0f));
+    float sinThetaO = sqrt(max(1.0f - wo.z * wo.z, 0.0f));
+    float maxCos = 0.0f;
+    if (sinThetaI > 1e-4f && sinThetaO > 1e-4f)
+    {
+        maxCos = max((wi.x * wo.x + wi.y * wo.y) / (sinThetaI * sinThetaO), 0.0f); // cos(phiI - phiO)
+    }
+
+    // alpha is the larger of the two polar angles, beta the smaller
+    float sinAlpha = (wi.z > wo.z) ? sinThetaO : sinThetaI;
+    float tanBeta = (wi.z > wo.z) ? sinThetaI / wi.z : sinThetaO / wo.z;
+    return a + b * maxCos * sinAlpha * tanBeta;
+}
+
+float OrenNayarEval(float albedo, float sigma, float3 wo, float3 wi)
+{
+    return (wo.z > 0.0f && wi.z > 0.0f) ? albedo * BXDF_INV_PI * OrenNayarTerm(sigma, wo, wi) : 0.0f;
+}
+
+BxDFSample OrenNayarSample(float albedo, float sigma, float3 wo, float2 u)
+{
+    BxDFSample sample = LambertSample(albedo, u);
+    sample.weight = (sample.wi.z > 0.0f) ? albedo * OrenNayarTerm(sigma, wo, sample.wi) : 0.0f;
+    return sample;
+}
+
+// GGX microfacets
+////////////////////
+
+float GGXD(float alpha, float3 h)
+{
+    if (h.z <= 0.0f)
+    {
+        return 0.0f;
+    }
+    float alpha2 = alpha * alpha;
+    float d = h.z * h.z * (alpha2 - 1.0f) + 1.0f;
+    return alpha2 / (BXDF_PI * d * d);
+}
+
+// sqrt(alpha^2 * sin^2 + cos^2) for [w]; Smith's lambda is (this / |cos| - 1) / 2, and writing masking through it keeps grazing
+// directions finite
+float GGXSmithRoot(float alpha, float3 w)
+{
+    return sqrt(alpha * alpha * (w.x * w.x + w.y * w.y) + w.z * w.z);
+}
+
+float GGXG1(float alpha, float3 w)
+{
+    float cosTheta = abs(w.z);
+    return 2.0f * cosTheta / (cosTheta + GGXSmithRoot(alpha, w));
+}
+
+// Height-correlated masking-shadowing, 1 / (1 + lambda(wo) + lambda(wi))
+float GGXG2(float alpha, float3 wo, float3 wi)
+{
+    float cosO = abs(wo.z), cosI = abs(wi.z);
+    float denominator = cosI * GGXSmithRoot(alpha, wo) + cosO * GGXSmithRoot(alpha, wi);
+    return (denominator > 0.0f) ? 2.0f * cosO * cosI / denominator : 0.0f;
+}
+
+// G2 / G1(wo), the part of a VNDF-sampled microfacet lobe's weight that doesn't cancel
+float GGXSampleMasking(float alpha, float3 wo, float3 wi)
+{
+    return GGXG2(alpha, wo, wi) / GGXG1(alpha, wo);
+}
+
+// Density of visible normal [h] from [wo]
+float GGXVisibleNormalPdf(float alpha, float3 wo, float3 h)
+{
+    return GGXG1(alpha, wo) * max(dot(wo, h), 0.0f) * GGXD(alpha, h) / wo.z;
+}
+
+// Heitz 2018, "Sampling the GGX Distribution of Visible Normals"
+float3 GGXSampleVisibleNormal(float alpha, float3 wo, float2 u)
+{
+    // Stretch [wo] to the hemisphere configuration, then sample a projected disk there
+    float3 vh = normalize(float3(alpha * wo.x, alpha * wo.y, wo.z));
+    float lensq = vh.x * vh.x + vh.y * vh.y;
+    float3 t1 = (lensq > 0.0f) ? float3(-vh.y, vh.x, 0.0f) / sqrt(lensq) : float3(1.0f, 0.0f, 0.0f);
+    float3 t2 = cross(vh, t1);
+
+    float r = sqrt(u.x);
+    float phi = BXDF_TWO_PI * u.y;
+    float p1 = r * cos(phi);
+    float p2 = r * sin(phi);
+    float s = 0.5f * (1.0f + vh.z);
+    p2 = (1.0f - s) * sqrt(max(1.0f - p1 * p1, 0.0f)) + s * p2;
+
+    float3 nh = t1 * p1 + t2 * p2 + vh * sqrt(max(1.0f - p1 * p1 - p2 * p2, 0.0f));
+    return normalize(float3(alpha * nh.x, alpha * nh.y, max(nh.z, 1e-6f)));
+}
+
+// GGX conductors
+///////////////////
+
+float GGXConductorEval(float alpha, float eta, float k, float3 wo, float3 wi)
+{
+    if (alpha < BXDF_SMOOTH_ALPHA || wo.z <= 0.0f || wi.z <= 0.0f)
+    {
+        return 0.0f;
+    }
+    float3 h = normalize(wo + wi);
+    return GGXD(alpha, h) * GGXG2(alpha, wo, wi) * ConductorFresnel(dot(wo, h), eta, k) / (4.0f * wo.z * wi.z);
+}
+
+float GGXConductorPdf(float alpha, float3 wo, float3 wi)
+{
+    if (alpha < BXDF_SMOOTH_ALPHA || wo.z <= 0.0f || wi.z <= 0.0f)
+    {
+        return 0.0f;
+    }
+    float3 h = normalize(wo + wi);
+    return GGXVisibleNormalPdf(alpha, wo, h) / (4.0f * dot(wo, h));
+}
+
+BxDFSample GGXConductorSample(float alpha, float eta, float k, float3 wo, float2 u)
+{
+    BxDFSample sample;
+    if (alpha < BXDF_SMOOTH_ALPHA)
+    {
+        sample.wi = float3(-wo.x, -wo.y, wo.z);
+        sample.pdf = 1.0f;
+        sample.weight = ConductorFresnel(wo.z, eta, k);
+        sample.delta = true;
+        return sample;
+    }
+
+    float3 h = GGXSampleVisibleNormal(alpha, wo, u);
+    sample.wi = BxDFReflect(wo, h);
+    if (sample.wi.z <= 0.0f)
+    {
+        return FailedBxDFSample();
+    }
+    sample.pdf = GGXVisibleNormalPdf(alpha, wo, h) / (4.0f * dot(wo, h));
+    sample.weight = ConductorFresnel(dot(wo, h), eta, k) * GGXSampleMasking(alpha, wo, sample.wi);
+    sample.delta = false;
+    return sample;
+}
+
+// Rough dielectrics
+//////////////////////
+
+// Microfacet normal between [wo] and [wi] (the generalised half vector for transmission), facing +z; false where there isn't one
+bool DielectricHalfVector(float eta, float3 wo, float3 wi, SHARED_OUT(float3) h)
+{
+    float3 halfVector = (wi.z > 0.0f) ? wo + wi : wo + wi * eta;
+    float lengthSq = dot(halfVector, halfVector);
+    if (lengthSq <= 0.0f)
+    {
+        return false;
+    }
+    h = halfVector / sqrt(lengthSq);
+    h = (h.z < 0.0f) ? -h : h;
+
+    // Microfacets facing away from either direction can't connect them
+    return dot(h, wi) * wi.z > 0.0f && dot(h, wo) > 0.0f;
+}
+
+float RoughDielectricEval(float alpha, float eta, float3 wo, float3 wi)
+{
+    float3 h = float3(0.0f, 0.0f, 1.0f);
+    if (alpha < BXDF_SMOOTH_ALPHA || wo.z <= 0.0f || wi.z == 0.0f || !DielectricHalfVector(eta, wo, wi, h))
+    {
+        return 0.0f;
+    }
+
+    float fresnel = DielectricFresnel(dot(wo, h), eta);
+    if (wi.z > 0.0f)
+    {
+        return GGXD(alpha, h) * GGXG2(alpha, wo, wi) * fresnel / (4.0f * wo.z * wi.z);
+    }
+    float denominator = dot(wi, h) + dot(wo, h) / eta;
+    return (1.0f - fresnel) * GGXD(alpha, h) * GGXG2(alpha, wo, wi) * abs(dot(wi, h) * dot(wo, h) / (wi.z * wo.z * denominator * denominator));
+}
+
+float RoughDielectricPdf(float alpha, float eta, float3 wo, float3 wi)
+{
+    float3 h = float3(0.0f, 0.0f, 1.0f);
+    if (alpha < BXDF_SMOOTH_ALPHA || wo.z <= 0.0f || wi.z == 0.0f || !DielectricHalfVector(eta, wo, wi, h))
+    {
+        return 0.0f;
+    }
+
+    float fresnel = DielectricFresnel(dot(wo, h), eta);
+    if (wi.z > 0.0f)
+    {
+        return GGXVisibleNormalPdf(alpha, wo, h) / (4.0f * dot(wo, h)) * fresnel;
+    }
+    float denominator = dot(wi, h) + dot(wo, h) / eta;
+    return GGXVisibleNormalPdf(alpha, wo, h) * abs(dot(wi, h)) / (denominator * denominator) * (1.0f - fresnel);
+}
+
+// [uLobe] picks reflection (with the Fresnel reflectance's probability) or transmission
+BxDFSample RoughDielectricSample(float alpha, float eta, float3 wo, float2 u, float uLobe)
+{
+    float3 h = (alpha < BXDF_SMOOTH_ALPHA) ? float3(0.0f, 0.0f, 1.0f) : GGXSampleVisibleNormal(alpha, wo, u);
+    float fresnel = DielectricFresnel(dot(wo, h), eta);
+
+    BxDFSample sample;
+    sample.delta = (alpha < BXDF_SMOOTH_ALPHA);
+    if (uLobe < fresnel)
+    {
+        sample.wi = BxDFReflect(wo, h);
+        if (sample.wi.z <= 0.0f)
+        {
+            return FailedBxDFSample();
+        }
+        sample.pdf = sample.delta ? fresnel : GGXVisibleNormalPdf(alpha, wo, h) / (4.0f * dot(wo, h)) * fresnel;
+    }
+    else
+    {
+        float3 wt = float3(0.0f, 0.0f, -1.0f);
+        if (!BxDFRefract(wo, h, eta, wt) || wt.z >= 0.0f)
+        {
+            return FailedBxDFSample();
+        }
+        sample.wi = wt;
+        float denominator = dot(wt, h) + dot(wo, h) / eta;
+        sample.pdf = sample.delta ? 1.0f - fresnel : GGXVisibleNormalPdf(alpha, wo, h) * abs(dot(wt, h)) / (denominator * denominator) * (1.0f - fresnel);
+    }
+
+    // The Fresnel term cancels against the lobe choice, leaving masking
+    sample.weight = sample.delta ? 1.0f : GGXSampleMasking(alpha, wo, sample.wi);
+    return sample;
+}
+
+// Dispatch
+/////////////
+
+float BxDFAlpha(SHARED_IN(BxDFParams) bxdf)
+{
+    return (bxdf.id == BXDF_ID_SPECULAR_CLASSICAL_SMOOTH) ? 0.0f : bxdf.roughness * bxdf.roughness;
+}
+
+// True for BxDFs that use [SampleBxDF]'s [uLobe]; others leave it unread, so callers can skip drawing it
+bool BxDFSamplesLobes(uint id)
+{
+    return id == BXDF_ID_DIELECTRIC_ROUGH;
+}
+
+float EvalBxDF(SHARED_IN(BxDFParams) bxdf, float3 wo, float3 wi)
+{
+    switch (bxdf.id)
+    {
+        case BXDF_ID_DIFFUSE_OREN_NAYAR:
+        case BXDF_ID_DIFFUSE_OREN_NAYAR_MULTISCATTER:
+            return OrenNayarEval(bxdf.albedo, bxdf.roughness, wo, wi);
+        case BXDF_ID_SPECULAR_CLASSICAL_SMOOTH:
+        case BXDF_ID_SPECULAR_COOK_TORRANCE:
+        case BXDF_ID_SPECULAR_COOK_TORRANCE_MULTISCATTER:
+            return GGXConductorEval(BxDFAlpha(bxdf), bxdf.eta, bxdf.k, wo, wi);
+        case BXDF_ID_DIELECTRIC_ROUGH:
+            return RoughDielectricEval(BxDFAlpha(bxdf), bxdf.eta, wo, wi);
+        default:
+            return LambertEval(bxdf.albedo, wo, wi);
+    }
+}
+
+float BxDFPdf(SHARED_IN(BxDFParams) bxdf, float3 wo, float3 wi)
+{
+    switch (bxdf.id)
+    {
+        case BXDF_ID_SPECULAR_CLASSICAL_SMOOTH:
+        case BXDF_ID_SPECULAR_COOK_TORRANCE:
+        case BXDF_ID_SPECULAR_COOK_TORRANCE_MULTISCATTER:
+            return GGXConductorPdf(BxDFAlpha(bxdf), wo, wi);
+        case BXDF_ID_DIELECTRIC_ROUGH:
+            return RoughDielectricPdf(BxDFAlpha(bxdf), bxdf.eta, wo, wi);
+        default:
+            return CosineHemispherePdf(wi); // Both diffuse models sample as Lambert
+    }
+}
+
+BxDFSample SampleBxDF(SHARED_IN(BxDFParams) bxdf, float3 wo, float2 u, float uLobe)
+{
+    switch (bxdf.id)
+    {
+        case BXDF_ID_DIFFUSE_OREN_NAYAR:
+        case BXDF_ID_DIFFUSE_OREN_NAYAR_MULTISCATTER:
+            return OrenNayarSample(bxdf.albedo, bxdf.roughness, wo, u);
+        case BXDF_ID_SPECULAR_CLASSICAL_SMOOTH:
+        case BXDF_ID_SPECULAR_COOK_TORRANCE:
+        case BXDF_ID_SPECULAR_COOK_TORRANCE_MULTISCATTER:
+            return GGXConductorSample(BxDFAlpha(bxdf), bxdf.eta, bxdf.k, wo, u);
+        case BXDF_ID_DIELECTRIC_ROUGH:
+            return RoughDielectricSample(BxDFAlpha(bxdf), bxdf.eta, wo, u, uLobe);
+        default:
+            return LambertSample(bxdf.albedo, u);
+    }
+}
+#endif
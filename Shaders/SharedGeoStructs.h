@@ -1,8 +1,10 @@
 
-#if defined(VERTEX) || defined(_WIN32) || defined(COMPUTE)
+#include "SharedPlatform.h"
+
+#if defined(VERTEX) || defined(CPU_SIDE) || defined(COMPUTE)
 struct Vertex2D
 {
-	#ifdef _WIN32
+	#ifdef CPU_SIDE
 		float4 pos; // Throwing everything in POSITION will confuse the rasterizer
 		float4 uv; // XY active, ZW unused
 	#else
@@ -15,7 +17,7 @@ struct Vertex2D
 // Not a concern until we get to DXR testing though, we just want to load/generate geometry for now
 struct Vertex3D
 {
-	#ifdef _WIN32
+	#ifdef CPU_SIDE
 		float4 pos; // W is unused
 		float4 mat; // UVs in x,y, material/model ID in z, scattering function ID in w
 		float4 normals; // W is unused
@@ -0,0 +1,48 @@
+#include "SharedPlatform.h"
+#include "SharedStructs.h"
+
+#ifdef CPU_SIDE
+#pragma once
+#endif
+
+// Hero-wavelength spectral sampling (Wilkie et al. 2014), shared by the compute shaders and the headless CPU tracer (see HeadlessTracer/)
+// - Each path carries HERO_WAVELENGTHS wavelengths: the hero (one uniform spectral sample, as RaySetup draws it) and the rest rotated
+//   evenly around the spectrum from it, so every path covers the whole film curve instead of one point on it
+// - Wavelengths are averaged evenly: no surface samples by wavelength yet, so every wavelength shares the hero's path pdf, [pdfRatios]
+//   stay at 1, and the weight is 1 / HERO_WAVELENGTHS
+// - [pdfRatios] leaves room for the balance heuristic (spectral MIS) once sampling does depend on wavelength (dispersion, spectral
+//   BSDFs): each ratio would take its wavelength's pdf over the hero's at every bounce, making 1 / sum(pdfRatios) the hero's pdf over
+//   the sum of every wavelength's
+#define HERO_WAVELENGTHS 4
+
+#ifdef SHADER_CODE
+float RotateHeroWavelength(float heroSample, float offset)
+{
+    float wavelength = heroSample + offset;
+    return wavelength - floor(wavelength); // Wraps back into (0...1), as ResolveSpectralColor expects
+}
+
+float4 HeroWavelengths(float heroSample)
+{
+    return float4(heroSample,
+                  RotateHeroWavelength(heroSample, 0.25f),
+                  RotateHeroWavelength(heroSample, 0.5f),
+                  RotateHeroWavelength(heroSample, 0.75f));
+}
+
+float HeroMISWeight(float4 pdfRatios)
+{
+    return 1.0f / (pdfRatios.x + pdfRatios.y + pdfRatios.z + pdfRatios.w);
+}
+
+// Film response to a path carrying [radiance] at each of its [wavelengths], weighted by [HeroMISWeight] (a plain average for now)
+// Wavelengths accumulate in order (hero first), which the CPU tracer's SIMD resolve matches exactly
+float3 ResolveHeroSpectralColor(float4 wavelengths, float4 radiance, float4 pdfRatios, SHARED_IN(FilmSPD_Piecewise) filmSPD)
+{
+    float3 film = ResolveSpectralColor(wavelengths.x, filmSPD) * radiance.x;
+    film += ResolveSpectralColor(wavelengths.y, filmSPD) * radiance.y;
+    film += ResolveSpectralColor(wavelengths.z, filmSPD) * radiance.z;
+    film += ResolveSpectralColor(wavelengths.w, filmSPD) * radiance.w;
+    return film * HeroMISWeight(pdfRatios);
+}
+#endif
@@ -0,0 +1,170 @@
+#include "SharedPlatform.h"
+
+#ifdef CPU_SIDE
+#pragma once
+#endif
+
+// Ray/triangle & ray/box tests, shared by the compute shaders and the headless CPU tracer (see HeadlessTracer/)
+
+struct Ray
+{
+    float3 dir;
+    float3 origin;
+
+    // Axis permutation for vertices + ray directions (aligns triangle intersections with Z)
+    uint3 axisPermu;
+    
+    // Shear transform (resolved from ray directions, applied to tri verts) 
+    // Ensures ray/triangle intersections are aligned with +Z specifically instead of -Z
+    // Vaguely resembles gradient math in fast voxel raymarching :o
+    float3 shearParams;
+};
+
+uint FindMaxDim(float3 v)
+{
+    if (v.x > v.y && v.x > v.z)
+    {
+        return 0;
+    }
+    else if (v.y > v.x && v.y > v.z)
+    {
+        return 1;
+    }
+    else // if (v.z > v.x && v.z > v.y)
+    {
+        return 2;
+    }
+}
+
+float3 ApplyVectorPermu(float3 v, uint3 permu)
+{
+    float3 vCopy = v;
+    vCopy.x = v[permu.x];
+    vCopy.y = v[permu.y];
+    vCopy.z = v[permu.z];
+    return vCopy;
+}
+
+// Declared locally because hardware intersections will track these values internally (I expect)
+void ResolveRayTransforms(SHARED_INOUT(Ray) ray)
+{
+    ray.axisPermu.z = FindMaxDim(ray.dir);
+    ray.axisPermu.x = (ray.axisPermu.z + 1) % 3;
+    ray.axisPermu.y = (ray.axisPermu.x + 1) % 3;
+
+    float3 d = ApplyVectorPermu(ray.dir, ray.axisPermu);
+    ray.shearParams.x = -d.x / d.z;
+    ray.shearParams.y = -d.y / d.z;
+    ray.shearParams.z = 1.0f / d.z;
+}
+
+float3 MapTriToIsectSpace(float3 vertex, SHARED_IN(Ray) ray)
+{
+    // Good old relative translation for vertices ^_^
+    vertex -= ray.origin;
+    
+    // Permute input vector
+    // (move largest direction axis to Z - roughly 
+    // aligns the triangle with the given ray)
+    vertex = ApplyVectorPermu(vertex, ray.axisPermu);
+
+    // Permute vertex position
+    // Shears positions to complete the approximate alignment we
+    // performed with [ApplyVectorPermu]
+    vertex.x += ray.shearParams.x * vertex.z;
+    vertex.y += ray.shearParams.y * vertex.z;
+    vertex.z *= ray.shearParams.z;
+
+    return vertex;
+}
+
+// Implemented from Physically Based Rendering: From Theory to Implementation, pages 158-164
+// (Pharr, Jakob, Humphreys)
+// Should modify to return distance + barycentrics (if applicable)
+bool triHit(float3x3 triVerts, SHARED_IN(Ray) ray, SHARED_OUT(float) distance, SHARED_OUT(float3) bary)
+{
+    // Transform tri vertices to intersection space
+    // - implicitly transforms ray-directions
+    // - plane embeds the triangle, ray is on Z with origin at the hypothetical hit pos
+    // - much simplifies the problem, allows solving in 2D, similar to my old custom method
+    ///////////////////////////////////////////////////////////////////////////////////////
+    
+    // Transform tri vertices
+    triVerts[0] = MapTriToIsectSpace(triVerts[0], ray);
+    triVerts[1] = MapTriToIsectSpace(triVerts[1], ray);
+    triVerts[2] = MapTriToIsectSpace(triVerts[2], ray);
+
+    // Edge functions!
+    // Sign of these tells us if the origin of our local coordinate system (= the hit pos) is inside the triangle (a hit) or not (a miss)
+    // Signs only have to agree (all positive or all negative, depending on which way the triangle faces the ray), so triangles are
+    // two-sided, as in the CPU-side test (see RayTriangle in Intersection.h)
+    float e0 = triVerts[1].x * triVerts[2].y - triVerts[1].y * triVerts[2].x;
+    float e1 = triVerts[2].x * triVerts[0].y - triVerts[2].y * triVerts[0].x;
+    float e2 = triVerts[0].x * triVerts[1].y - triVerts[0].y * triVerts[1].x;
+    float eSum = e0 + e1 + e2;
+
+    bool hit = ((sign(e0) >= 0 && sign(e1) >= 0 && sign(e2) >= 0) ||
+                (sign(e0) <= 0 && sign(e1) <= 0 && sign(e2) <= 0)) && eSum != 0;
+
+    if (hit)
+    {
+        // Resolve hit depth (interpolated z) using edge distances
+        // (effectively - vertex z-coordinates interpolated at the ray's XY coordinates (= its origin))
+        // This wouldn't work normally! We'd end up with a junk interpolated worldspace z-coordinate
+        // The math works out specifically because we transformed the triangle into the same space as the ray (see MapTriToIsectSpace)
+        float z = (e0 * triVerts[0].z + 
+                   e1 * triVerts[1].z +
+                   e2 * triVerts[2].z) / eSum; // Division by eSum removes bias from summing eN * vertN products (I think??)
+
+        distance = z; // The power of coordinate transforms ^_^ (tbh I don't really understand this - need to think about it further)
+        bary = float3(e0, e1, e2) / eSum; // Division by eSum converts from 0...triangleSize range to 0...1
+
+        return z >= 0; // Negative Z indicates tris behind the camera
+    }   
+    else
+    {
+        distance = 9999.0f; // Close enough to infinity ^_^'
+        return false;
+    } 
+}
+
+// Not sure where to put this yet, but extremely useful to have for area-based transport algorithms
+// (e.g. some kinds of volumetric transport, implementations of BDPT)
+// Insight: Cross product gives the area of a parallelogram defined by two edge vectors
+// Triangles are half the area of a parallelogram
+// thus area = 0.5 * cross(edge0, edge1);
+float FindTriArea(float3x3 triVerts)
+{
+    float3 edge0 = triVerts[0] - triVerts[1];
+    float3 edge1 = triVerts[0] - triVerts[2];
+    return 0.5f * length(cross(edge0, edge1));
+}
+
+// Basic AABB intersection test from
+// https://tavianator.com/2011/ray_box.html
+bool aabbHit(SHARED_IN(Ray) ray, float3 aabbMin, float3 aabbMax)
+{
+    float2 tMinMax = float2(0.0f, 0.0f);
+
+    if (ray.dir.x != 0.0f)
+    {
+        float2 tx = (float2(aabbMin.x, aabbMax.x) - float2(ray.origin.x, ray.origin.x)) / float2(ray.dir.x, ray.dir.x);
+        tMinMax = tx.x < tx.y ? tx : float2(tx.y, tx.x); //  float2(min(tx.x, tx.y), max(tx.x, tx.y));
+    }
+
+    if (ray.dir.y != 0.0f)
+    {
+        float2 ty = (float2(aabbMin.y, aabbMax.y) - float2(ray.origin.y, ray.origin.y)) / float2(ray.dir.y, ray.dir.y);
+        tMinMax = float2(max(tMinMax.x, min(ty.x, ty.y)), 
+                         min(tMinMax.y, max(ty.x, ty.y)));
+    }
+
+    if (ray.dir.z != 0.0f)
+    {
+        float2 tz = (float2(aabbMin.z, aabbMax.z) - float2(ray.origin.z, ray.origin.z)) / float2(ray.dir.z, ray.dir.z);
+        tMinMax = float2(max(tMinMax.x, min(tz.x, tz.y)), 
+                         min(tMinMax.y, max(tz.x, tz.y)));        
+    }
+
+    return tMinMax.x <= tMinMax.y;
+}
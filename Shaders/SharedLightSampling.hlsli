@@ -0,0 +1,65 @@
+#include "SharedPlatform.h"
+#include "SharedStructs.h"
+
+#ifdef CPU_SIDE
+#pragma once
+#endif
+
+// Emissive-triangle sampling for next-event estimation, shared by the shaders and the headless CPU tracer (see HeadlessTracer/)
+// - Emitters are triangles with uniform radiance, lit on their front face only (clockwise, as the loaders wind meshes); the CPU
+//   extracts them at scene load and lays them out as an alias table (Walker 1977; see HeadlessTracer/EmitterTable.h), so picking one
+//   takes one random number and at most two reads however many there are
+// - Tables weigh emitters by power (radiance * area) or evenly; each entry carries its own pick probability, so hits found by BxDF
+//   sampling can look up the light pdf they'd have had
+// - Points are uniform over the picked triangle; pdfs convert to solid angle at the shading point, and combine with the BxDF's through
+//   the power heuristic (Veach 1997)
+struct EmitterAliasEntry
+{
+    uint tri; // Index into the scene's triangles
+    float radiance;
+    float area;
+    float pdf; // Probability of picking this emitter
+    float threshold; // Slots keep their own emitter below this fraction, and hand over to [alias] above it
+    uint alias;
+};
+
+#ifdef SHADER_CODE
+// The alias-table slot [u] lands in, out of [numEmitters]; [fraction] is where it landed inside the slot (uniform again), for
+// [ResolveEmitterAlias]
+uint EmitterTableSlot(float u, uint numEmitters, SHARED_OUT(float) fraction)
+{
+    float scaled = u * numEmitters;
+    uint slot = min(uint(scaled), numEmitters - 1);
+    fraction = min(scaled - slot, 1.0f);
+    return slot;
+}
+
+// Emitter picked from [slot] (holding [entry]) at [fraction]
+uint ResolveEmitterAlias(SHARED_IN(EmitterAliasEntry) entry, uint slot, float fraction)
+{
+    return (fraction < entry.threshold) ? slot : entry.alias;
+}
+
+// Uniform point on the triangle [p0, p1, p2]
+float3 SampleTrianglePoint(float3 p0, float3 p1, float3 p2, float2 u)
+{
+    float su = sqrt(u.x);
+    float b1 = 1.0f - su;
+    float b2 = u.y * su;
+    return p0 * (1.0f - b1 - b2) + p1 * b1 + p2 * b2;
+}
+
+// Solid-angle density of a point [distance] away on an emitter picked with probability [pickPdf], seen at [cosLight] to its normal
+float EmitterSolidAnglePdf(float pickPdf, float area, float distance, float cosLight)
+{
+    return (cosLight > 0.0f && area > 0.0f) ? pickPdf * distance * distance / (area * cosLight) : 0.0f;
+}
+
+// Power heuristic (beta = 2) for a sample drawn with density [pdfA], which the other strategy would have drawn with [pdfB]
+float PowerHeuristic(float pdfA, float pdfB)
+{
+    float a = pdfA * pdfA;
+    float b = pdfB * pdfB;
+    return (a > 0.0f) ? a / (a + b) : 0.0f;
+}
+#endif
@@ -8,7 +8,9 @@
 
 #define GPU_PRNG
 
-#ifndef _WIN32
+#include "SharedPlatform.h"
+
+#ifndef CPU_SIDE
 #define uint32_t uint
 #endif
 
@@ -18,11 +20,7 @@ struct GPU_PRNG_Channel
 	uint32_t state[GPU_PRNG_STREAM_STATE_SIZE];
 };
 
-#ifdef _WIN32
-#define GPU_PRNG_ChannelType GPU_PRNG_Channel&
-#else
-#define GPU_PRNG_ChannelType inout GPU_PRNG_Channel
-#endif
+#define GPU_PRNG_ChannelType SHARED_INOUT(GPU_PRNG_Channel)
 
 // Iteration from xoshiro128+ implementation, here: https://prng.di.unimi.it/xoshiro128plus.c
 uint GPU_PRNG_Next(GPU_PRNG_ChannelType channel)
@@ -40,7 +38,7 @@ uint GPU_PRNG_Next(GPU_PRNG_ChannelType channel)
 	return result;
 }
 
-#ifndef _WIN32
+#ifdef SHADER_CODE
 // Convert full-range uint to float in 0...1
 float iToFloat(uint i)
 {
@@ -0,0 +1,33 @@
+// Shared headers compile as HLSL and as C++
+// - CPU_SIDE marks C++ builds on any platform (the Windows app/tests define _WIN32, headless Linux builds define __linux__), and gates
+//   CPU-only declarations
+// - Shader code (functions written for the GPU) compiles in HLSL builds, and in C++ translation units that define CPU_SHADER_CODE
+//   ahead of every shared header, with HLSL-style vector types in scope (see HeadlessTracer/ShaderTypes.h)
+// - Shader code keeps to the subset of HLSL that also parses as C++: no literal/member swizzles, vector construction through
+//   constructors, out/inout/by-value parameters through the macros below, and parameters a function doesn't read yet through
+//   SHARED_UNUSED (so C++ builds stay clean under -Wunused-parameter)
+
+#ifndef SHARED_PLATFORM
+#define SHARED_PLATFORM
+
+#if defined(_WIN32) || defined(__linux__)
+#define CPU_SIDE
+#endif
+
+#if !defined(CPU_SIDE) || defined(CPU_SHADER_CODE)
+#define SHADER_CODE
+#endif
+
+#ifdef CPU_SIDE
+#define SHARED_OUT(type) type&
+#define SHARED_INOUT(type) type&
+#define SHARED_IN(type) const type& // Large structs (e.g. film curves) would otherwise copy on every call
+#define SHARED_UNUSED(name) (void)(name)
+#else
+#define SHARED_OUT(type) out type
+#define SHARED_INOUT(type) inout type
+#define SHARED_IN(type) type
+#define SHARED_UNUSED(name)
+#endif
+
+#endif
@@ -1,3 +1,4 @@
+#include "SharedPlatform.h"
 
 #ifndef GPU_PRNG
 #include "SharedPRNG_Code.h"
@@ -16,7 +17,7 @@ float MitchellNetravali1D(float x)
     float xCub = xSqr * x;
     return ((12.0f * 9.0f * b - sixC) * xCub +
            (-18.0f + 12.0f * b + sixC) * xSqr +
-           (6.0f - 2.0f * b)) * 0.16666666; // Mitchell/Netravali polynomial divides by 1/6th
+           (6.0f - 2.0f * b)) * 0.16666666f; // Mitchell/Netravali polynomial divides by 1/6th
 }
 
 // Anti-aliasing filter function (e.g. triangle, blackman-harris, etc)
@@ -50,7 +51,7 @@ float AAFilter(float2 sampleOffset)
 //
 //               r = 0.5y / tan(0.5 * fov); (theta/fov is the vertical angle inside the frustum - think TOA)
 //
-float4 RaySetup(float2 sampleCoordinate, float fov, float2 imageDims, float spp, GPU_PRNG_ChannelType prngChannel, out float spectralSample)
+float4 RaySetup(float2 sampleCoordinate, float fov, float2 imageDims, float spp, GPU_PRNG_ChannelType prngChannel, SHARED_OUT(float) spectralSample)
 { 
     // No need for spp to make the image any larger - I had a brain bug that conflated multisampling with super-sampling, they're different concepts ^_^'
     // Which is to say - spp is a one-dimensional property that sets the number of samples per pixel/film cell
@@ -58,6 +59,7 @@ float4 RaySetup(float2 sampleCoordinate, float fov, float2 imageDims, float spp,
     // The concepts may be entangled if e.g. your samples per pixel are always squares, or always non-prime, but 2 samples per pixel is two samples per pixel,
     // sampling at 2spp doesn't double your image res (and it wouldn't make sense if it did - 2x supersampling has four subpixels per pixel, not two)
     //////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    SHARED_UNUSED(spp);
 
     // Jitter locally
     // Really need some smarter sampling code oof
@@ -66,7 +68,7 @@ float4 RaySetup(float2 sampleCoordinate, float fov, float2 imageDims, float spp,
     // Stratified and R2 both require a sample index to work, iirc
     // https://extremelearning.com.au/unreasonable-effectiveness-of-quasirandom-sequences/
     float2 jitter = rand2d(prngChannel); 
-    jitter = (jitter - 0.5f.xx) * 2.0f;
+    jitter = (jitter - float2(0.5f, 0.5f)) * 2.0f;
     sampleCoordinate += jitter;
 
     // Compute ray direction (see diagram above)
@@ -1,11 +1,12 @@
 
+#include "SharedPlatform.h"
 #include "filmSPD.h"
 
 #ifndef SHADER_MATH
 #include "shaderMath.h"
 #endif
 
-#ifdef _WIN32
+#ifdef CPU_SIDE
 using uint = uint32_t;
 #pragma once
 #endif
@@ -35,34 +36,102 @@ struct IndexedTriangle
 #define FALSE 0
 #endif
 
+// Sparse octree nodes, built on the CPU (see SparseOctree.h) and stored breadth-first
+// - Branches set one [childMask] bit per occupied octant (x + 2y + 4z); occupied children are stored contiguously from [firstChild],
+//   in octant order, so octant [i] lives at firstChild + countbits(childMask & ((1 << i) - 1))
+// - Leaves have an empty [childMask]; [firstChild] points into the octree's triangle list, which holds the leaf's triangle count
+//   followed by its triangle indices (triangles straddling cells are listed in every leaf they touch)
 struct ComputeAS_Node
 {
-	float4 bounds[2]; // 16x2 bytes (32)
-
-	// Children are either triangle indices (bit 25 zero), or indices to another node (bit 25 set)
-	// Bit 26 determines if child indices are active or not
-	// Using an octree AS now, so each node has (up to) eight children
-	uint children[8]; // 4x8 bytes (32)
-
-	// Metadata + padding for 16B alignment
-	uint numChildren;
-	uint isBranchNode;
-	uint containsTrisEventually;
-	uint padding;
+	float3 boundsMin;
+	uint childMask;
+	float3 boundsMax;
+	uint firstChild;
 };
 
+// Deepest supported octree level (the root is level zero); traversal stacks hold up to seven pending siblings per level, plus the root
+#define AS_OCTREE_MAX_DEPTH 16
+#define AS_OCTREE_STACK_SIZE (AS_OCTREE_MAX_DEPTH * 7 + 1)
+
+// Binary BVH nodes, built on the CPU (see BVH.h) and stored depth-first
+// - Left children directly follow their parents, so branches ([triCount] zero) only store their right child in [rightOrFirstTri]
+// - Leaves cover [triCount] entries of the BVH's triangle list from [rightOrFirstTri]; each triangle is listed exactly once, unless
+//   the tree was built with spatial splits
+struct ComputeBVH_Node
+{
+	float3 boundsMin;
+	uint rightOrFirstTri;
+	float3 boundsMax;
+	uint triCount;
+};
+
+// Deepest supported BVH level (builders fall back to median splits before exceeding it); traversal stacks hold one pending right child
+// per level
+#define AS_BVH_MAX_DEPTH 64
+
+// Stackless encoding of the binary BVH, converted on the CPU (see StacklessBVH.h); same depth-first order + triangle list
+// - Branches store a skip link in [skipOrFirstTri] instead of their right child: the first node past their subtree, where traversal
+//   continues when their box is missed (right children follow their left siblings' subtrees, so they're still recoverable)
+// - Leaves are as in ComputeBVH_Node, and always continue with the next node; traversal ends at the root's skip link (or after the
+//   root, if it's a leaf)
+struct ComputeBVH_SkipNode
+{
+	float3 boundsMin;
+	uint skipOrFirstTri;
+	float3 boundsMax;
+	uint triCount;
+};
+
+// Compressed 8-wide BVH nodes (80 bytes), collapsed from a binary BVH on the CPU (see WideBVH.h); layout follows Ylitie et al. 2017
+// - Child bounds are quantised to bytes against the node's [origin]: each axis scales by a power of two, stored as a biased float
+//   exponent in the low three bytes of [exponentsAndImask]; child [i]'s min/max along an axis decode as origin + q * scale, from byte
+//   [i] of that axis' pair of [qlo]/[qhi] words (x in words 0-1, y in 2-3, z in 4-5)
+// - The top byte of [exponentsAndImask] flags the slots holding internal children; those children are stored contiguously from
+//   [childBase], in slot order, so slot [i] lives at childBase + countbits(imask & ((1 << i) - 1))
+// - [meta] holds a byte per slot: zero for empty slots, 0b001 in the top three bits + (24 + slot) in the low five for internal
+//   children, and for leaves, 1-3 triangles in unary (0b001/0b011/0b111) over an offset from [triBase] into the triangle list
+struct ComputeWideBVH_Node
+{
+	float3 origin;
+	uint exponentsAndImask;
+	uint childBase;
+	uint triBase;
+	uint meta[2];
+	uint qlo[6];
+	uint qhi[6];
+};
+
+#define AS_WIDE_BVH_WIDTH 8
+
+// Acceleration structure used by the compute path (see Render::Init, ComputeShader.hlsl); zero falls back to the sparse octree
+#define COMPUTE_AS_BVH 1
+
+// Whether the compute path's BVH weighs spatial splits (see BVH::BinnedSAHSettings); CPU-side only, since traversal doesn't change
+#define COMPUTE_AS_SPATIAL_SPLITS 0
+
+// Whether the compute path walks its BVH through skip links (ComputeBVH_SkipNode, one node index of state per ray) rather than with a
+// per-ray stack (ComputeBVH_Node)
+#define COMPUTE_AS_STACKLESS 1
+
 struct MaterialPropertyEntry
 {
 	uint spectralWidth, spectralHeight, roughnessWidth, roughnessHeight;
 	float spectralOffsetU, spectralOffsetV, roughnessOffsetU, roughnessOffsetV; // X/Y offset within spectral/roughness data
+
+	// Constant materials bypass the atlases above (their widths/heights/offsets are zero)
+	// [uniformSPD] holds the raw 128 bits of a MaterialSPD_Piecewise
+	uint4 uniformSPD;
+	uint isUniform;
+	float uniformRoughness;
+	uint padding[2];
 };
 
-#ifndef _WIN32
-void ResolveNearestFilmCurveConstraints(float spectralSample, out uint2 constraints, out float blendFac)
+#ifdef SHADER_CODE
+void ResolveNearestFilmCurveConstraints(float spectralSample, SHARED_OUT(uint2) constraints, SHARED_OUT(float) blendFac)
 {
 	// Below assumes spectralSample in the range (0...1)
 	float interval = MAX_FILM_CURVE_CONSTRAINT * spectralSample;
-	uint closestConstraint = floor(interval);
+	uint closestConstraint = uint(floor(interval));
 	constraints.y = (closestConstraint < MAX_FILM_CURVE_CONSTRAINT) ? closestConstraint + 1 : closestConstraint; // Icky loss of continuity at the edges of our curve, we can compensate by blending towards zero/100% power
 	constraints.x = closestConstraint;
 	blendFac = interval - closestConstraint;
@@ -87,21 +156,25 @@ float ResolveChannelRightResponse(bool upwardCurveTail, float channelConstraintR
 	}
 }
 
-float3 ResolveSpectralColor(float spectralSample, FilmSPD_Piecewise filmSPD)
+float3 ResolveSpectralColor(float spectralSample, SHARED_IN(FilmSPD_Piecewise) filmSPD)
 {
 	float blend = 0.0f;
-	uint2 constraints = 0.xx;
+	uint2 constraints = uint2(0, 0);
 	ResolveNearestFilmCurveConstraints(spectralSample, constraints, blend);
 
+	float4 curveTail = filmSPD.spd_sample[MAX_FILM_CURVE_CONSTRAINT];
+	float4 curveTailPrev = filmSPD.spd_sample[MAX_FILM_CURVE_CONSTRAINT - 1];
 	bool intervalOutOfBounds = constraints.x == MAX_FILM_CURVE_CONSTRAINT; // Left constraint is always the smaller index, so if it's the max constraint then its interval will be OOB
-	bool redHasUpwardTail = filmSPD.spd_sample[MAX_FILM_CURVE_CONSTRAINT - 1].r < filmSPD.spd_sample[MAX_FILM_CURVE_CONSTRAINT].r; 
-	bool greenHasUpwardTail = filmSPD.spd_sample[MAX_FILM_CURVE_CONSTRAINT - 1].g < filmSPD.spd_sample[MAX_FILM_CURVE_CONSTRAINT].g; 
-	bool blueHasUpwardTail = filmSPD.spd_sample[MAX_FILM_CURVE_CONSTRAINT - 1].b < filmSPD.spd_sample[MAX_FILM_CURVE_CONSTRAINT].b; 
-	
-	float3 rgbResponsesRight = float3(ResolveChannelRightResponse(redHasUpwardTail, filmSPD.spd_sample[constraints.y].r, intervalOutOfBounds, blend),
-									  ResolveChannelRightResponse(greenHasUpwardTail, filmSPD.spd_sample[constraints.y].g, intervalOutOfBounds, blend), 
-									  ResolveChannelRightResponse(blueHasUpwardTail, filmSPD.spd_sample[constraints.y].b, intervalOutOfBounds, blend));
-
-    return lerp(filmSPD.spd_sample[constraints.x], float4(rgbResponsesRight, 1.0f), blend).rgb;
+	bool redHasUpwardTail = curveTailPrev.x < curveTail.x;
+	bool greenHasUpwardTail = curveTailPrev.y < curveTail.y;
+	bool blueHasUpwardTail = curveTailPrev.z < curveTail.z;
+
+	float4 left = filmSPD.spd_sample[constraints.x];
+	float4 right = filmSPD.spd_sample[constraints.y];
+	float3 rgbResponsesRight = float3(ResolveChannelRightResponse(redHasUpwardTail, right.x, intervalOutOfBounds, blend),
+									  ResolveChannelRightResponse(greenHasUpwardTail, right.y, intervalOutOfBounds, blend),
+									  ResolveChannelRightResponse(blueHasUpwardTail, right.z, intervalOutOfBounds, blend));
+
+    return lerp(float3(left.x, left.y, left.z), rgbResponsesRight, blend);
 }
 #endif
\ No newline at end of file
@@ -3,7 +3,9 @@
 #define FILM_SPD_NUM_SAMPLES 256
 #define MAX_FILM_CURVE_CONSTRAINT (FILM_SPD_NUM_SAMPLES - 1)
 
-#ifdef _WIN32
+#include "SharedPlatform.h"
+
+#ifdef CPU_SIDE
 #pragma once
 #endif
 
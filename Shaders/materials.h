@@ -1,12 +1,16 @@
 
+#include "SharedPlatform.h"
+
 // CPU-only settings
-#ifdef _WIN32
+#ifdef CPU_SIDE
 using uint = uint32_t;
-#include "..\Math.h"
+#ifndef CPU_SHADER_CODE
+#include "../Math.h"
+#endif
 #pragma once
 #endif
 
-#ifdef _WIN32
+#ifdef CPU_SIDE
 #define MATERIAL_SPD_POINTS 16
 #else
 #define MATERIAL_SPD_POINTS 4
@@ -16,7 +20,7 @@ using uint = uint32_t;
 
 struct MaterialSPD_Piecewise
 {
-#ifdef _WIN32
+#ifdef CPU_SIDE
     // Each curve sample contains 32 points uniformly distributed on X (0-1), and each of those has 16 degrees of freedom on Y (four bits)
     // Spectral curves can just (barely) be encoded 1:1 using uint32_t texture objects on the GPU
     uint8_t points[MATERIAL_SPD_POINTS]; // Byte-wide type, 16 points, 128 bits
@@ -25,9 +29,9 @@ struct MaterialSPD_Piecewise
 #endif
 };
 
-#ifndef _WIN32 // GPU-only code
+#ifdef SHADER_CODE // GPU code (or CPU-side shader code, see SharedPlatform.h)
 // Spectrum is normalized photometric (so 0-1 by the time we get here, not 740-440nm)
-float ResolveMaterialSPDResponse(float spectralSample, MaterialSPD_Piecewise matSPD)
+float ResolveMaterialSPDResponse(float spectralSample, SHARED_IN(MaterialSPD_Piecewise) matSPD)
 {
     //uint bitRange = spectralSample * MATERIAL_SPD_BITS;
 	//float interval = (FILM_SPD_NUM_SAMPLES - 1) * spectralSample;
@@ -36,6 +40,8 @@ float ResolveMaterialSPDResponse(float spectralSample, MaterialSPD_Piecewise mat
 	//centroid = closestConstraint;
 	//blendFac = interval - closestConstraint;
     // Oops, forgot I hadn't fixed this ^_^'
+    SHARED_UNUSED(spectralSample);
+    SHARED_UNUSED(matSPD);
     return 1.0f;
 }
 
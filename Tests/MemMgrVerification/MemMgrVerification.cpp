@@ -39,10 +39,15 @@ int main()
     static constexpr uint16_t numRandArrays = 65535;
     CPUMemory::ArrayAllocHandle<CPUMemory::ArrayAllocHandle<char>> randArrays = {};
     randArrays = CPUMemory::AllocateArrayStatic<CPUMemory::ArrayAllocHandle<char>, numRandArrays>();
+    static bool randArraysFreed[numRandArrays] = {};
 
     for (uint32_t i = 0; i < numRandArrays; i++)
     {
         randArrays[i] = CPUMemory::AllocateArray<char>(ranlux() % 1024);
+        for (uint32_t j = 0; j < randArrays[i].arrayLen; j++)
+        {
+            randArrays[i][j] = static_cast<char>(i);
+        }
     }
 
     // Perform random frees, up to a limit (...since I can't see how to make the random frees converge without introducing another array)
@@ -76,12 +81,31 @@ int main()
         //printf("freeing blah arrays, clearing index %u\n", blahArrayFreeIndex);
         CPUMemory::Free(blah_array[blahArrayFreeIndex]);
         CPUMemory::Free(randArrays[randArrayFreeIndex]);
+        randArraysFreed[randArrayFreeIndex] = true;
         freeCtr++;
 
         // Short-term loan test
         CPUMemoryLoan loanTest(ranlux() % 65535);
     }
 
+    // Surviving arrays should still hold what we wrote into them (compaction moves data around underneath handles)
+    for (uint32_t i = 0; i < numRandArrays; i++)
+    {
+        if (randArraysFreed[i])
+        {
+            continue;
+        }
+
+        for (uint32_t j = 0; j < randArrays[i].arrayLen; j++)
+        {
+            if (randArrays[i][j] != static_cast<char>(i))
+            {
+                printf("array %u lost its contents after compaction\n", i);
+                return 1;
+            }
+        }
+    }
+
     // Clear remaining allocs
     for (uint32_t i = 0; i < range; i++)
     {
@@ -0,0 +1,160 @@
+#include "Benchmarks.h"
+#include "../TestScenes.h"
+#include "../../SandboxApp/ASReport.h"
+#include "../../SandboxApp/BVH.h"
+#include "../../SandboxApp/StacklessBVH.h"
+#include "../../SandboxApp/WideBVH.h"
+#include "../../SandboxApp/SparseOctree.h"
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <vector>
+
+// Rays from outside [boundsMin, boundsMax] towards random points inside it
+static std::vector<ASReport::Ray> ReportRaysInto(const float* boundsMin, const float* boundsMax, uint32_t numRays)
+{
+	std::mt19937 rng(1234);
+	std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+	const float extent = std::max({ boundsMax[0] - boundsMin[0], boundsMax[1] - boundsMin[1], boundsMax[2] - boundsMin[2] });
+	auto pointIn = [&](float margin)
+	{
+		return float4(boundsMin[0] - margin + unit(rng) * (boundsMax[0] - boundsMin[0] + 2.0f * margin),
+					  boundsMin[1] - margin + unit(rng) * (boundsMax[1] - boundsMin[1] + 2.0f * margin),
+					  boundsMin[2] - margin + unit(rng) * (boundsMax[2] - boundsMin[2] + 2.0f * margin), 0.0f);
+	};
+
+	std::vector<ASReport::Ray> rays(numRays);
+	for (ASReport::Ray& ray : rays)
+	{
+		ray.origin = pointIn(extent);
+		const float4 target = pointIn(0.0f);
+		ray.dir = float4(target.x - ray.origin.x, target.y - ray.origin.y, target.z - ray.origin.z, 0.0f);
+		ray.tMin = 0.0f;
+		ray.tMax = INFINITY;
+	}
+	return rays;
+}
+
+// Reports every structure (and both binary builders) over one scene, appending them to [outReports]
+static void ReportScene(const char* label, const float4* positions, uint64_t numVerts, uint64_t strideBytes, const IndexedTriangle* tris, uint32_t numTris,
+						uint32_t numRays, std::vector<ASReport::Report>& outReports)
+{
+	float boundsMin[3] = { INFINITY, INFINITY, INFINITY }, boundsMax[3] = { -INFINITY, -INFINITY, -INFINITY };
+	const uint8_t* positionBytes = reinterpret_cast<const uint8_t*>(positions);
+	for (uint64_t i = 0; i < numVerts; i++)
+	{
+		const float4& p = *reinterpret_cast<const float4*>(positionBytes + i * strideBytes);
+		const float c[3] = { p.x, p.y, p.z };
+		for (uint32_t a = 0; a < 3; a++)
+		{
+			boundsMin[a] = std::min(boundsMin[a], c[a]);
+			boundsMax[a] = std::max(boundsMax[a], c[a]);
+		}
+	}
+	const std::vector<ASReport::Ray> rays = ReportRaysInto(boundsMin, boundsMax, numRays);
+
+	ASReport::Settings settings;
+	settings.label = label;
+	settings.rays = rays.data();
+	settings.numRays = numRays;
+
+	std::vector<ASReport::Report> reports;
+	std::vector<double> reportMs;
+	auto analyse = [&](auto&& run)
+	{
+		ASReport::Report report;
+		BenchTimer timer;
+		run(&report);
+		reportMs.push_back(timer.ElapsedMs());
+		reports.push_back(report);
+	};
+
+	BVH bvh;
+	bvh.BuildBinnedSAH(positions, numVerts, strideBytes, tris, numTris, BVH::BinnedSAHSettings());
+	analyse([&](ASReport::Report* report) { ASReport::Analyse(bvh, positions, strideBytes, tris, settings, report); });
+
+	StacklessBVH stackless;
+	stackless.Build(bvh, positions, numVerts, strideBytes, tris);
+	analyse([&](ASReport::Report* report) { ASReport::Analyse(stackless, positions, strideBytes, tris, settings, report); });
+
+	WideBVH wide;
+	wide.Build(bvh, positions, numVerts, strideBytes, tris);
+	analyse([&](ASReport::Report* report) { ASReport::Analyse(wide, positions, strideBytes, tris, settings, report); });
+
+	// Spatial splits trade references for overlap, which EPO shows and SAH alone doesn't
+	BVH::BinnedSAHSettings splitSettings;
+	splitSettings.spatialSplits = true;
+	BVH splitBVH;
+	splitBVH.BuildBinnedSAH(positions, numVerts, strideBytes, tris, numTris, splitSettings);
+	analyse([&](ASReport::Report* report)
+	{
+		ASReport::Analyse(splitBVH, positions, strideBytes, tris, settings, report);
+		report->structure = "binary BVH (spatial splits)";
+	});
+
+	SparseOctree octree;
+	octree.Build(positions, numVerts, strideBytes, tris, numTris, SparseOctree::Settings());
+	analyse([&](ASReport::Report* report) { ASReport::Analyse(octree, positions, strideBytes, tris, numTris, settings, report); });
+
+	for (size_t i = 0; i < reports.size(); i++)
+	{
+		const ASReport::Report& report = reports[i];
+		printf("%s, %s: %u nodes (depth %u), SAH %.2f, EPO %.3f, %.1f nodes + %.1f triangles per ray, %.1f bytes per triangle (reported in %.1fms)\n", label,
+			   report.structure, report.numNodes, report.depth, report.sahCost, report.epo, report.nodesPerRay, report.trisPerRay,
+			   static_cast<double>(report.nodeBytes + report.triListBytes + report.otherBytes) / numTris, reportMs[i]);
+		outReports.push_back(report);
+	}
+
+	octree.DeInit();
+	splitBVH.DeInit();
+	wide.DeInit();
+	stackless.DeInit();
+	bvh.DeInit();
+}
+
+// Every report as one JSON array
+static void WriteReports(const std::vector<ASReport::Report>& reports, FILE* file)
+{
+	fprintf(file, "[\n");
+	for (size_t i = 0; i < reports.size(); i++)
+	{
+		ASReport::WriteJSON(reports[i], file, 1);
+		fprintf(file, (i + 1 < reports.size()) ? ",\n" : "\n");
+	}
+	fprintf(file, "]\n");
+}
+
+void ASReportBenchmark()
+{
+	constexpr uint32_t numRays = 64 * 1024;
+	std::vector<ASReport::Report> reports;
+
+	SceneBuffers buffers;
+	buffers.Init(64 * 1024, 128 * 1024, 1);
+	if (LoadTestObj("../Models/stanford-bunny.obj", buffers))
+	{
+		const GeoTypes::Vertex3D* vts = reinterpret_cast<const GeoTypes::Vertex3D*>(&buffers.BufferContents(SceneBuffers::VBUFFER)[0]);
+		const IndexedTriangle* tris = reinterpret_cast<const IndexedTriangle*>(&buffers.BufferContents(SceneBuffers::TRIBUFFER)[0]);
+		ReportScene("bunny", &vts[0].pos, buffers.NumVerts(), sizeof(GeoTypes::Vertex3D), tris, static_cast<uint32_t>(buffers.NumTris()), numRays, reports);
+	}
+	else
+	{
+		printf("couldn't open ../Models/stanford-bunny.obj\n");
+	}
+	buffers.DeInit();
+
+	std::vector<float4> positions;
+	std::vector<IndexedTriangle> tris;
+	BuildArchitecturalScene(4, 8, 8, positions, tris);
+	ReportScene("building", positions.data(), positions.size(), sizeof(float4), tris.data(), static_cast<uint32_t>(tris.size()), numRays, reports);
+
+	// Also written to asreport.json, so runs can be diffed against each other
+	WriteReports(reports, stdout);
+	FILE* file = fopen("asreport.json", "w");
+	if (file != nullptr)
+	{
+		WriteReports(reports, file);
+		fclose(file);
+	}
+}
@@ -0,0 +1,414 @@
+#include "Benchmarks.h"
+#include "../TestScenes.h"
+#include "../../SandboxApp/BVH.h"
+#include "../../SandboxApp/SparseOctree.h"
+#include "../../SandboxApp/Intersection.h"
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <thread>
+#include <vector>
+
+template<typename buildFn>
+static double TimeBuilds(uint32_t numBuilds, buildFn build)
+{
+	BenchTimer timer;
+	for (uint32_t i = 0; i < numBuilds; i++)
+	{
+		build(i == numBuilds - 1);
+	}
+	return timer.ElapsedMs() / numBuilds;
+}
+
+// Binned SAH and LBVH builds against the sparse octree over the same mesh; SAH costs use unit node/triangle costs on both sides, so they compare
+// directly (lower is better: expected node visits + triangle tests per ray hitting the root)
+static void CompareBuilders(const char* label, const float4* positions, uint64_t numVerts, uint64_t strideBytes, const IndexedTriangle* tris, uint32_t numTris,
+							uint32_t numBuilds)
+{
+	printf("%s (%u tris)\n", label, numTris);
+
+	SparseOctree octree;
+	const SparseOctree::Settings octreeSettings;
+	const double octreeMs = TimeBuilds(numBuilds, [&](bool last)
+	{
+		octree.Build(positions, numVerts, strideBytes, tris, numTris, octreeSettings);
+		if (!last)
+		{
+			octree.DeInit();
+		}
+	});
+
+	const SparseOctree::Stats& octreeStats = octree.GetStats();
+	printf("    sparse octree (leaf threshold %u, max depth %u): %.3fms, SAH cost %.2f, %u nodes, depth %u, %.2fMB\n", octreeSettings.leafTris, octreeSettings.maxDepth, octreeMs,
+		   octreeStats.sahCost, octreeStats.numNodes, octreeStats.depth, (octreeStats.nodeBytes + octreeStats.triListBytes) / (1024.0 * 1024.0));
+	const float octreeSAH = octreeStats.sahCost;
+	octree.DeInit();
+
+	const uint32_t leafSizes[] = { 1, 2, 4, 8 };
+	const uint32_t threadCounts[] = { 1, 0 };
+	for (uint32_t leafTris : leafSizes)
+	{
+		for (uint32_t numThreads : threadCounts)
+		{
+			BVH::BinnedSAHSettings settings;
+			settings.leafTris = leafTris;
+			settings.numThreads = numThreads;
+
+			BVH bvh;
+			const double bvhMs = TimeBuilds(numBuilds, [&](bool last)
+			{
+				bvh.BuildBinnedSAH(positions, numVerts, strideBytes, tris, numTris, settings);
+				if (!last)
+				{
+					bvh.DeInit();
+				}
+			});
+
+			const BVH::Stats& stats = bvh.GetStats();
+			printf("    binned SAH (leaves %u-%u tris, %s): %.3fms, SAH cost %.2f (%.2fx the octree's), %u nodes, depth %u, %.2fMB\n", settings.leafTris, settings.maxLeafTris,
+				   (numThreads == 1) ? "1 thread" : "all threads", bvhMs, stats.sahCost, stats.sahCost / octreeSAH, stats.numNodes, stats.depth,
+				   (stats.nodeBytes + stats.triListBytes) / (1024.0 * 1024.0));
+			bvh.DeInit();
+		}
+	}
+
+	// LBVH builds, with and without treelet restructuring; SAH ratios are against the octree's like the binned builds above, so the
+	// two builders compare through it
+	struct LBVHVariant
+	{
+		bool wideCodes;
+		uint32_t treeletSize;
+	};
+	const LBVHVariant variants[] = { { false, 0 }, { true, 0 }, { false, 5 }, { false, 7 } };
+	for (const LBVHVariant& variant : variants)
+	{
+		for (uint32_t numThreads : threadCounts)
+		{
+			BVH::LBVHSettings settings;
+			settings.wideCodes = variant.wideCodes;
+			settings.treeletSize = variant.treeletSize;
+			settings.numThreads = numThreads;
+
+			BVH bvh;
+			const double bvhMs = TimeBuilds(numBuilds, [&](bool last)
+			{
+				bvh.BuildLBVH(positions, numVerts, strideBytes, tris, numTris, settings);
+				if (!last)
+				{
+					bvh.DeInit();
+				}
+			});
+
+			const BVH::Stats& stats = bvh.GetStats();
+			printf("    LBVH (%s-bit codes, treelets of %u, leaves up to %u tris, %s): %.3fms, SAH cost %.2f (%.2fx the octree's), %u nodes, depth %u, %.2fMB\n",
+				   settings.wideCodes ? "63" : "30", settings.treeletSize, settings.maxLeafTris, (numThreads == 1) ? "1 thread" : "all threads", bvhMs, stats.sahCost,
+				   stats.sahCost / octreeSAH, stats.numNodes, stats.depth, (stats.nodeBytes + stats.triListBytes) / (1024.0 * 1024.0));
+			bvh.DeInit();
+		}
+	}
+}
+
+// Ordered closest-hit (as ComputeShader.hlsl walks the tree), counting the nodes it visits and the triangles it tests
+static bool CountedClosestHit(const BVH& bvh, const float4* positions, uint64_t strideBytes, const IndexedTriangle* tris, float4 origin, float4 dir,
+							  uint32_t* outNodes, uint32_t* outTriTests)
+{
+	const ComputeBVH_Node* nodes = &bvh.Nodes()[0];
+	const uint32_t* triList = &bvh.TriList()[0];
+	const uint8_t* positionBytes = reinterpret_cast<const uint8_t*>(positions);
+	const RayPrecomp rp = PrecomputeRay(origin, dir);
+	float tMax = INFINITY, entry;
+	bool found = false;
+	*outNodes = 1;
+	*outTriTests = 0;
+	if (!RayBox(&nodes[0].boundsMin.x, &nodes[0].boundsMax.x, rp, 0.0f, tMax, &entry))
+	{
+		return false;
+	}
+
+	uint32_t stackNodes[AS_BVH_MAX_DEPTH];
+	float stackEntries[AS_BVH_MAX_DEPTH];
+	uint32_t stackSize = 0;
+	uint32_t nodeNdx = 0;
+	while (true)
+	{
+		const ComputeBVH_Node& node = nodes[nodeNdx];
+		if (node.triCount > 0)
+		{
+			*outTriTests += node.triCount;
+			for (uint32_t i = node.rightOrFirstTri; i < node.rightOrFirstTri + node.triCount; i++)
+			{
+				const uint4& ndx = tris[triList[i]].xyz;
+				float t, u, v;
+				if (RayTriangle(rp, *reinterpret_cast<const float4*>(positionBytes + ndx.x * strideBytes), *reinterpret_cast<const float4*>(positionBytes + ndx.y * strideBytes),
+								*reinterpret_cast<const float4*>(positionBytes + ndx.z * strideBytes), 0.0f, tMax, &t, &u, &v) && (!found || t < tMax))
+				{
+					tMax = t;
+					found = true;
+				}
+			}
+		}
+		else
+		{
+			const uint32_t left = nodeNdx + 1, right = node.rightOrFirstTri;
+			float leftEntry, rightEntry;
+			const bool hitLeft = RayBox(&nodes[left].boundsMin.x, &nodes[left].boundsMax.x, rp, 0.0f, tMax, &leftEntry);
+			const bool hitRight = RayBox(&nodes[right].boundsMin.x, &nodes[right].boundsMax.x, rp, 0.0f, tMax, &rightEntry);
+			*outNodes += 2;
+			if (hitLeft && hitRight)
+			{
+				const bool leftFirst = leftEntry <= rightEntry;
+				stackNodes[stackSize] = leftFirst ? right : left;
+				stackEntries[stackSize] = leftFirst ? rightEntry : leftEntry;
+				stackSize++;
+				nodeNdx = leftFirst ? left : right;
+				continue;
+			}
+			else if (hitLeft || hitRight)
+			{
+				nodeNdx = hitLeft ? left : right;
+				continue;
+			}
+		}
+
+		bool pending = false;
+		while (stackSize > 0 && !pending)
+		{
+			stackSize--;
+			pending = (stackEntries[stackSize] <= tMax);
+			nodeNdx = stackNodes[stackSize];
+		}
+
+		if (!pending)
+		{
+			return found;
+		}
+	}
+}
+
+// Binned SAH builds with and without spatial splits (at a few duplication budgets), comparing references, SAH costs, build times, and
+// traversal steps (node tests + triangle tests) + throughput for [numRays] rays between random points in the mesh's bounds
+static void CompareSpatialSplits(const char* label, const float4* positions, uint64_t numVerts, uint64_t strideBytes, const IndexedTriangle* tris, uint32_t numTris,
+								 uint32_t numRays)
+{
+	float meshMin[3] = { INFINITY, INFINITY, INFINITY }, meshMax[3] = { -INFINITY, -INFINITY, -INFINITY };
+	const uint8_t* positionBytes = reinterpret_cast<const uint8_t*>(positions);
+	for (uint64_t i = 0; i < numVerts; i++)
+	{
+		const float4& p = *reinterpret_cast<const float4*>(positionBytes + i * strideBytes);
+		meshMin[0] = std::min(meshMin[0], p.x), meshMin[1] = std::min(meshMin[1], p.y), meshMin[2] = std::min(meshMin[2], p.z);
+		meshMax[0] = std::max(meshMax[0], p.x), meshMax[1] = std::max(meshMax[1], p.y), meshMax[2] = std::max(meshMax[2], p.z);
+	}
+
+	std::mt19937 rng(37);
+	std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+	auto pointIn = [&]()
+	{
+		return float4(meshMin[0] + unit(rng) * (meshMax[0] - meshMin[0]), meshMin[1] + unit(rng) * (meshMax[1] - meshMin[1]), meshMin[2] + unit(rng) * (meshMax[2] - meshMin[2]), 0.0f);
+	};
+	std::vector<float4> origins(numRays), dirs(numRays);
+	for (uint32_t i = 0; i < numRays; i++)
+	{
+		origins[i] = pointIn();
+		const float4 target = pointIn();
+		dirs[i] = float4(target.x - origins[i].x, target.y - origins[i].y, target.z - origins[i].z, 0.0f);
+	}
+
+	printf("%s (%u tris), spatial splits\n", label, numTris);
+	const float budgets[] = { -1.0f, 0.1f, 0.3f, 1.0f };
+	double baseSteps = 0.0, baseMs = 0.0;
+	for (float budget : budgets)
+	{
+		BVH::BinnedSAHSettings settings;
+		settings.numThreads = 1;
+		settings.spatialSplits = (budget >= 0.0f);
+		settings.splitBudget = std::max(budget, 0.0f);
+
+		BVH bvh;
+		const double buildMs = TimeBuilds(1, [&](bool) { bvh.BuildBinnedSAH(positions, numVerts, strideBytes, tris, numTris, settings); });
+
+		uint64_t numNodes = 0, numTriTests = 0;
+		uint32_t numHits = 0;
+		for (uint32_t i = 0; i < numRays; i++)
+		{
+			uint32_t rayNodes, rayTriTests;
+			numHits += CountedClosestHit(bvh, positions, strideBytes, tris, origins[i], dirs[i], &rayNodes, &rayTriTests) ? 1 : 0;
+			numNodes += rayNodes;
+			numTriTests += rayTriTests;
+		}
+
+		BenchTimer timer;
+		for (uint32_t i = 0; i < numRays; i++)
+		{
+			uint32_t rayNodes, rayTriTests;
+			CountedClosestHit(bvh, positions, strideBytes, tris, origins[i], dirs[i], &rayNodes, &rayTriTests);
+		}
+		const double traceMs = timer.ElapsedMs();
+
+		const double steps = static_cast<double>(numNodes + numTriTests) / numRays;
+		if (budget < 0.0f)
+		{
+			baseSteps = steps;
+			baseMs = traceMs;
+			printf("    object splits only:");
+		}
+		else
+		{
+			printf("    spatial splits (%.0f%% budget):", budget * 100.0f);
+		}
+
+		const BVH::Stats& stats = bvh.GetStats();
+		printf(" %.3fms build, %u references (%.2f per tri), %u nodes, SAH cost %.2f; per ray %.1f node tests + %.1f triangle tests (%.2fx steps), %.2fM rays/sec (%.2fx, %u hits)\n",
+			   buildMs, bvh.TriListLen(), static_cast<double>(bvh.TriListLen()) / numTris, stats.numNodes, stats.sahCost, static_cast<double>(numNodes) / numRays,
+			   static_cast<double>(numTriTests) / numRays, steps / baseSteps, (numRays / 1000000.0) / (traceMs / 1000.0), baseMs / traceMs, numHits);
+		bvh.DeInit();
+	}
+}
+
+// Bunny vertices twisted around the vertical axis (by more the further up they are) and rippled; [frame] scales both, so trees built
+// over the rest pose degrade steadily as frames go by
+static void AnimateBunny(const GeoTypes::Vertex3D* rest, uint64_t numVerts, uint32_t frame, std::vector<float4>& outPositions)
+{
+	const float twist = 0.08f * frame, ripple = 0.0004f * frame;
+	outPositions.resize(numVerts);
+	for (uint64_t i = 0; i < numVerts; i++)
+	{
+		const float4& p = rest[i].pos;
+		const float angle = twist * p.y * 10.0f;
+		const float c = std::cos(angle), s = std::sin(angle);
+		outPositions[i] = float4(c * p.x - s * p.z + ripple * std::sin(p.y * 60.0f), p.y, s * p.x + c * p.z, 1.0f);
+	}
+}
+
+// Refitting an animated bunny against rebuilding it every frame, then refits with automatic rebuilds past the default SAH growth limit
+static void CompareRefits(const GeoTypes::Vertex3D* vts, uint64_t numVerts, const IndexedTriangle* tris, uint32_t numTris)
+{
+	constexpr uint32_t numFrames = 48;
+	std::vector<float4> positions;
+
+	const uint32_t threadCounts[] = { 1, 0 };
+	for (uint32_t numThreads : threadCounts)
+	{
+		printf("animated bunny, refit vs rebuild (%s)\n", (numThreads == 1) ? "1 thread" : "all threads");
+		AnimateBunny(vts, numVerts, 0, positions);
+
+		BVH::BinnedSAHSettings sahSettings;
+		sahSettings.numThreads = numThreads;
+		BVH::LBVHSettings lbvhSettings;
+		lbvhSettings.numThreads = numThreads;
+		BVH::RefitSettings refitSettings;
+		refitSettings.maxSAHGrowth = INFINITY;
+		refitSettings.numThreads = numThreads;
+
+		BVH refit;
+		refit.BuildBinnedSAH(positions.data(), numVerts, sizeof(float4), tris, numTris, sahSettings);
+
+		double refitMs = 0.0, sahMs = 0.0, lbvhMs = 0.0;
+		for (uint32_t frame = 1; frame <= numFrames; frame++)
+		{
+			AnimateBunny(vts, numVerts, frame, positions);
+
+			BenchTimer refitTimer;
+			refit.Refit(positions.data(), numVerts, sizeof(float4), tris, refitSettings);
+			refitMs += refitTimer.ElapsedMs();
+
+			// Fresh trees for comparison; both are allocated after [refit], so freeing them leaves it in place
+			BVH sah, lbvh;
+			BenchTimer sahTimer;
+			sah.BuildBinnedSAH(positions.data(), numVerts, sizeof(float4), tris, numTris, sahSettings);
+			sahMs += sahTimer.ElapsedMs();
+
+			BenchTimer lbvhTimer;
+			lbvh.BuildLBVH(positions.data(), numVerts, sizeof(float4), tris, numTris, lbvhSettings);
+			lbvhMs += lbvhTimer.ElapsedMs();
+
+			if (frame % 8 == 0)
+			{
+				printf("    frame %u: refit SAH cost %.2f (%.2fx built), rebuilt binned SAH %.2f, rebuilt LBVH %.2f\n", frame, refit.GetStats().sahCost, refit.SAHGrowth(),
+					   sah.GetStats().sahCost, lbvh.GetStats().sahCost);
+			}
+			lbvh.DeInit();
+			sah.DeInit();
+		}
+		printf("    per frame: refit %.3fms, binned SAH rebuild %.3fms, LBVH rebuild %.3fms\n", refitMs / numFrames, sahMs / numFrames, lbvhMs / numFrames);
+		refit.DeInit();
+
+		// The same animation, letting refits rebuild once the SAH cost grows past the default limit
+		refitSettings.maxSAHGrowth = BVH::RefitSettings().maxSAHGrowth;
+		AnimateBunny(vts, numVerts, 0, positions);
+		refit.BuildBinnedSAH(positions.data(), numVerts, sizeof(float4), tris, numTris, sahSettings);
+
+		uint32_t numRebuilds = 0;
+		double updateMs = 0.0, sahCostSum = 0.0;
+		for (uint32_t frame = 1; frame <= numFrames; frame++)
+		{
+			AnimateBunny(vts, numVerts, frame, positions);
+			BenchTimer timer;
+			numRebuilds += refit.Refit(positions.data(), numVerts, sizeof(float4), tris, refitSettings) ? 1 : 0;
+			updateMs += timer.ElapsedMs();
+			sahCostSum += refit.GetStats().sahCost;
+		}
+		printf("    refit with rebuilds past %.2fx SAH growth: %u rebuilds over %u frames, %.3fms per frame, mean SAH cost %.2f\n", refitSettings.maxSAHGrowth, numRebuilds,
+			   numFrames, updateMs / numFrames, sahCostSum / numFrames);
+		refit.DeInit();
+	}
+}
+
+// BVH builders against the sparse octree on the Stanford bunny (plus refits as it animates, and spatial splits), then spatial splits on a
+// procedural building, then builders on a ~1M triangle heightfield
+void BVHBenchmark()
+{
+	printf("%u hardware threads\n", std::thread::hardware_concurrency());
+
+	SceneBuffers buffers;
+	buffers.Init(64 * 1024, 128 * 1024, 1);
+	if (LoadTestObj("../Models/stanford-bunny.obj", buffers))
+	{
+		const GeoTypes::Vertex3D* vts = reinterpret_cast<const GeoTypes::Vertex3D*>(&buffers.BufferContents(SceneBuffers::VBUFFER)[0]);
+		const IndexedTriangle* tris = reinterpret_cast<const IndexedTriangle*>(&buffers.BufferContents(SceneBuffers::TRIBUFFER)[0]);
+		CompareBuilders("bunny", &vts[0].pos, buffers.NumVerts(), sizeof(GeoTypes::Vertex3D), tris, static_cast<uint32_t>(buffers.NumTris()), 8);
+		CompareRefits(vts, buffers.NumVerts(), tris, static_cast<uint32_t>(buffers.NumTris()));
+		CompareSpatialSplits("bunny", &vts[0].pos, buffers.NumVerts(), sizeof(GeoTypes::Vertex3D), tris, static_cast<uint32_t>(buffers.NumTris()), 256 * 1024);
+	}
+	else
+	{
+		printf("couldn't open ../Models/stanford-bunny.obj\n");
+	}
+	buffers.DeInit();
+
+	// Building-spanning floors/walls are where spatial splits pay off
+	{
+		std::vector<float4> positions;
+		std::vector<IndexedTriangle> tris;
+		BuildArchitecturalScene(4, 8, 8, positions, tris);
+		CompareSpatialSplits("building", positions.data(), positions.size(), sizeof(float4), tris.data(), static_cast<uint32_t>(tris.size()), 256 * 1024);
+	}
+
+	// Rolling heightfield, two triangles per grid quad
+	constexpr uint32_t gridQuads = 708;
+	constexpr uint32_t gridVerts = gridQuads + 1;
+	std::vector<float4> positions(static_cast<size_t>(gridVerts) * gridVerts);
+	for (uint32_t y = 0; y < gridVerts; y++)
+	{
+		for (uint32_t x = 0; x < gridVerts; x++)
+		{
+			const float fx = static_cast<float>(x) / gridQuads, fy = static_cast<float>(y) / gridQuads;
+			const float height = 0.08f * std::sin(fx * 7.0f) * std::cos(fy * 5.0f) + 0.01f * std::sin((fx + fy) * 31.0f);
+			positions[static_cast<size_t>(y) * gridVerts + x] = float4(fx, height, fy, 1.0f);
+		}
+	}
+
+	std::vector<IndexedTriangle> tris(static_cast<size_t>(gridQuads) * gridQuads * 2);
+	for (uint32_t y = 0; y < gridQuads; y++)
+	{
+		for (uint32_t x = 0; x < gridQuads; x++)
+		{
+			const uint32_t v00 = y * gridVerts + x, v10 = v00 + 1, v01 = v00 + gridVerts, v11 = v01 + 1;
+			IndexedTriangle* quad = &tris[(static_cast<size_t>(y) * gridQuads + x) * 2];
+			quad[0].xyz = uint4(v00, v10, v11, 0);
+			quad[1].xyz = uint4(v00, v11, v01, 0);
+		}
+	}
+
+	CompareBuilders("heightfield", positions.data(), positions.size(), sizeof(float4), tris.data(), static_cast<uint32_t>(tris.size()), 1);
+}
@@ -0,0 +1,97 @@
+#pragma once
+
+#include <chrono>
+#include <stdint.h>
+#include <stdio.h>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <cstring>
+#endif
+
+// CPU-side benchmarks for scene/AS/tracing code
+// Each benchmark prints its own results; SandboxBenchmarks.cpp runs all of them, or just the ones named on the command line
+
+void SceneGraphBenchmark();
+void BoundsBenchmark();
+void SceneQueryBenchmark();
+void SparseOctreeBenchmark();
+void StacklessBVHBenchmark();
+void BVHBenchmark();
+void TwoLevelASBenchmark();
+void WideBVHBenchmark();
+void ASReportBenchmark();
+void IntersectionSIMDBenchmark();
+void PacketBVHBenchmark();
+void TileSchedulerBenchmark();
+
+// Simple wall-clock timer, reports milliseconds
+struct BenchTimer
+{
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+	double ElapsedMs() const
+	{
+		return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	}
+
+	void Reset()
+	{
+		start = std::chrono::steady_clock::now();
+	}
+};
+
+// Last-level cache misses on the calling thread, from hardware counters (Linux perf events); [available] is false elsewhere, or where
+// the kernel/hypervisor doesn't expose them
+struct BenchCacheMisses
+{
+	bool available = false;
+
+#ifdef __linux__
+	int fd = -1;
+
+	BenchCacheMisses()
+	{
+		perf_event_attr attr;
+		memset(&attr, 0, sizeof(attr));
+		attr.size = sizeof(attr);
+		attr.type = PERF_TYPE_HARDWARE;
+		attr.config = PERF_COUNT_HW_CACHE_MISSES;
+		attr.exclude_kernel = 1;
+		attr.exclude_hv = 1;
+		fd = static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+		available = (fd >= 0);
+	}
+
+	BenchCacheMisses(const BenchCacheMisses&) = delete;
+	BenchCacheMisses& operator=(const BenchCacheMisses&) = delete;
+
+	~BenchCacheMisses()
+	{
+		if (fd >= 0)
+		{
+			close(fd);
+		}
+	}
+
+	void Reset()
+	{
+		if (fd >= 0)
+		{
+			ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+		}
+	}
+
+	uint64_t Count() const
+	{
+		uint64_t count = 0;
+		return (fd >= 0 && read(fd, &count, sizeof(count)) == sizeof(count)) ? count : 0;
+	}
+#else
+	void Reset() {}
+	uint64_t Count() const { return 0; }
+#endif
+};
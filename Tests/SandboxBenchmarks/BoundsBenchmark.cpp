@@ -0,0 +1,70 @@
+#include "Benchmarks.h"
+#include "../../CPUMemory.h"
+#include "../../SandboxApp/Bounds.h"
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <thread>
+
+// Object/world-space vertex bounds over 4M vertices (Vertex3D-sized stride, so ~200MB - most of the allocator's budget), against a plain scalar loop
+void BoundsBenchmark()
+{
+	struct BenchVertex
+	{
+		float4 pos;
+		float4 mat;
+		float4 normals;
+	};
+
+	constexpr uint64_t numVerts = 4 * 1024 * 1024;
+	constexpr uint32_t numRuns = 8;
+
+	std::mt19937 rng(91011);
+	std::uniform_real_distribution<float> dist(-100.0f, 100.0f);
+
+	auto verts = CPUMemory::AllocateArray<BenchVertex>(numVerts);
+	BenchVertex* vts = &verts[0];
+	for (uint64_t i = 0; i < numVerts; i++)
+	{
+		vts[i].pos = float4(dist(rng), dist(rng), dist(rng), 0.0f);
+	}
+
+	transform xform;
+	xform.translationAndScale = float4(1.0f, 2.0f, 3.0f, 2.0f);
+	xform.rotation = float4(0.0f, 0.38268343f, 0.0f, 0.92387953f); // 45 degrees around y
+
+	float4 mn, mx;
+	BenchTimer timer;
+	float scalarMin = INFINITY, scalarMax = -INFINITY;
+	for (uint32_t r = 0; r < numRuns; r++)
+	{
+		for (uint64_t i = 0; i < numVerts; i++)
+		{
+			scalarMin = std::min(scalarMin, vts[i].pos.x);
+			scalarMax = std::max(scalarMax, vts[i].pos.x);
+		}
+	}
+	const double scalarMs = timer.ElapsedMs() / numRuns;
+
+	timer.Reset();
+	for (uint32_t r = 0; r < numRuns; r++)
+	{
+		VertexBounds(&vts[0].pos, numVerts, sizeof(BenchVertex), &mn, &mx);
+	}
+	const double objectMs = timer.ElapsedMs() / numRuns;
+
+	timer.Reset();
+	for (uint32_t r = 0; r < numRuns; r++)
+	{
+		TransformedVertexBounds(&vts[0].pos, numVerts, sizeof(BenchVertex), xform, &mn, &mx);
+	}
+	const double worldMs = timer.ElapsedMs() / numRuns;
+
+	printf("%llu vertices, %u hardware threads\n", static_cast<unsigned long long>(numVerts), std::thread::hardware_concurrency());
+	printf("scalar min/max (x only): %.3fms (%.1f..%.1f)\n", scalarMs, scalarMin, scalarMax);
+	printf("object-space bounds: %.3fms\n", objectMs);
+	printf("world-space bounds: %.3fms -> (%.1f, %.1f, %.1f) .. (%.1f, %.1f, %.1f)\n", worldMs, mn.x, mn.y, mn.z, mx.x, mx.y, mx.z);
+
+	CPUMemory::Free(verts);
+}
@@ -0,0 +1,223 @@
+#include "Benchmarks.h"
+#include "../TestScenes.h"
+#include "../../SandboxApp/IntersectionSIMD.h"
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <random>
+#include <vector>
+
+// Every triangle of a mesh (or its bounds) against every ray, without a tree in the way: per-lane scalar tests over indexed vertices
+// (as the traversals read them), the scalar fallback over SoA packets, then the 4- and 8-lane kernels. Hit counts have to match,
+// since the kernels are bit-compatible with the scalar tests
+struct SIMDBenchMesh
+{
+	const float4* positions;
+	uint64_t strideBytes;
+	const IndexedTriangle* tris;
+	uint32_t numTris;
+};
+
+template<uint32_t lanes>
+static std::vector<TrianglePacket<lanes>> PackMesh(const SIMDBenchMesh& mesh)
+{
+	std::vector<TrianglePacket<lanes>> packets((mesh.numTris + lanes - 1) / lanes);
+	std::vector<uint32_t> ndces(mesh.numTris);
+	for (uint32_t i = 0; i < mesh.numTris; i++)
+	{
+		ndces[i] = i;
+	}
+	for (uint32_t p = 0; p < packets.size(); p++)
+	{
+		PackTriangles(mesh.positions, mesh.strideBytes, mesh.tris, &ndces[p * lanes], std::min(lanes, mesh.numTris - p * lanes), &packets[p]);
+	}
+	return packets;
+}
+
+template<uint32_t lanes>
+static std::vector<BoxPacket<lanes>> PackBounds(const std::vector<float>& bounds, uint32_t numBoxes)
+{
+	std::vector<BoxPacket<lanes>> packets((numBoxes + lanes - 1) / lanes);
+	for (uint32_t p = 0; p < packets.size(); p++)
+	{
+		const float* mins[lanes];
+		const float* maxs[lanes];
+		const uint32_t count = std::min(lanes, numBoxes - p * lanes);
+		for (uint32_t i = 0; i < count; i++)
+		{
+			mins[i] = &bounds[(p * lanes + i) * 6];
+			maxs[i] = &bounds[(p * lanes + i) * 6 + 3];
+		}
+		PackBoxes(mins, maxs, count, &packets[p]);
+	}
+	return packets;
+}
+
+static void PrintRate(const char* label, const char* unit, uint64_t numTests, uint64_t numHits, double ms, double baselineMs)
+{
+	printf("    %-28s %8.1fM %s/sec (%.2fx), %llu hits\n", label, (static_cast<double>(numTests) / 1000000.0) / (ms / 1000.0), unit, baselineMs / ms,
+		   static_cast<unsigned long long>(numHits));
+}
+
+static void BenchmarkMesh(const char* label, const SIMDBenchMesh& mesh, uint32_t numRays)
+{
+	const uint8_t* positionBytes = reinterpret_cast<const uint8_t*>(mesh.positions);
+	auto vertex = [&](uint32_t ndx) -> const float4& { return *reinterpret_cast<const float4*>(positionBytes + ndx * mesh.strideBytes); };
+
+	// Triangle bounds stand in for leaf/child boxes
+	std::vector<float> bounds(static_cast<size_t>(mesh.numTris) * 6);
+	float meshMin[3] = { INFINITY, INFINITY, INFINITY }, meshMax[3] = { -INFINITY, -INFINITY, -INFINITY };
+	for (uint32_t i = 0; i < mesh.numTris; i++)
+	{
+		const float4* v[3] = { &vertex(mesh.tris[i].xyz.x), &vertex(mesh.tris[i].xyz.y), &vertex(mesh.tris[i].xyz.z) };
+		for (uint32_t a = 0; a < 3; a++)
+		{
+			const float c[3] = { (&v[0]->x)[a], (&v[1]->x)[a], (&v[2]->x)[a] };
+			bounds[i * 6 + a] = std::min({ c[0], c[1], c[2] });
+			bounds[i * 6 + 3 + a] = std::max({ c[0], c[1], c[2] });
+			meshMin[a] = std::min(meshMin[a], bounds[i * 6 + a]);
+			meshMax[a] = std::max(meshMax[a], bounds[i * 6 + 3 + a]);
+		}
+	}
+
+	// Rays from a shell around the mesh towards random points inside its bounds
+	std::mt19937 rng(4243);
+	std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+	const float extent = std::max({ meshMax[0] - meshMin[0], meshMax[1] - meshMin[1], meshMax[2] - meshMin[2] });
+	std::vector<RayPrecomp> rays(numRays);
+	for (RayPrecomp& rp : rays)
+	{
+		float origin[3], target[3];
+		for (uint32_t a = 0; a < 3; a++)
+		{
+			origin[a] = meshMin[a] - extent + unit(rng) * (meshMax[a] - meshMin[a] + 2.0f * extent);
+			target[a] = meshMin[a] + unit(rng) * (meshMax[a] - meshMin[a]);
+		}
+		rp = PrecomputeRay(float4(origin[0], origin[1], origin[2], 0.0f), float4(target[0] - origin[0], target[1] - origin[1], target[2] - origin[2], 0.0f));
+	}
+
+	const std::vector<TrianglePacket<4>> tris4 = PackMesh<4>(mesh);
+	const std::vector<TrianglePacket<8>> tris8 = PackMesh<8>(mesh);
+	const std::vector<BoxPacket<4>> boxes4 = PackBounds<4>(bounds, mesh.numTris);
+	const std::vector<BoxPacket<8>> boxes8 = PackBounds<8>(bounds, mesh.numTris);
+	const uint64_t numTests = static_cast<uint64_t>(mesh.numTris) * numRays;
+	printf("%s: %u triangles x %u rays\n", label, mesh.numTris, numRays);
+
+	alignas(32) float t[8], u[8], v[8], entries[8];
+	auto timeTests = [&](auto&& test, uint64_t* outHits)
+	{
+		BenchTimer timer;
+		uint64_t hits = 0;
+		for (const RayPrecomp& rp : rays)
+		{
+			hits += test(rp);
+		}
+		*outHits = hits;
+		return timer.ElapsedMs();
+	};
+
+	uint64_t hits;
+	const double indexedMs = timeTests([&](const RayPrecomp& rp)
+	{
+		uint64_t rayHits = 0;
+		for (uint32_t i = 0; i < mesh.numTris; i++)
+		{
+			const uint4& ndx = mesh.tris[i].xyz;
+			rayHits += RayTriangle(rp, vertex(ndx.x), vertex(ndx.y), vertex(ndx.z), 0.0f, INFINITY, &t[0], &u[0], &v[0]) ? 1 : 0;
+		}
+		return rayHits;
+	}, &hits);
+	PrintRate("scalar, indexed vertices:", "tris", numTests, hits, indexedMs, indexedMs);
+
+	const double soaMs = timeTests([&](const RayPrecomp& rp)
+	{
+		uint64_t rayHits = 0;
+		for (const TrianglePacket<8>& packet : tris8)
+		{
+			rayHits += std::popcount(RayTrianglesScalar(rp, packet, 0.0f, INFINITY, t, u, v));
+		}
+		return rayHits;
+	}, &hits);
+	PrintRate("scalar, 8-lane packets:", "tris", numTests, hits, soaMs, indexedMs);
+
+	const double tris4Ms = timeTests([&](const RayPrecomp& rp)
+	{
+		uint64_t rayHits = 0;
+		for (const TrianglePacket<4>& packet : tris4)
+		{
+			rayHits += std::popcount(RayTriangles4(rp, packet, 0.0f, INFINITY, t, u, v));
+		}
+		return rayHits;
+	}, &hits);
+	PrintRate("4-lane:", "tris", numTests, hits, tris4Ms, indexedMs);
+
+	const double tris8Ms = timeTests([&](const RayPrecomp& rp)
+	{
+		uint64_t rayHits = 0;
+		for (const TrianglePacket<8>& packet : tris8)
+		{
+			rayHits += std::popcount(RayTriangles8(rp, packet, 0.0f, INFINITY, t, u, v));
+		}
+		return rayHits;
+	}, &hits);
+	PrintRate("8-lane:", "tris", numTests, hits, tris8Ms, indexedMs);
+
+	const double boxesMs = timeTests([&](const RayPrecomp& rp)
+	{
+		uint64_t rayHits = 0;
+		for (uint32_t i = 0; i < mesh.numTris; i++)
+		{
+			rayHits += RayBox(&bounds[i * 6], &bounds[i * 6 + 3], rp, 0.0f, INFINITY, &entries[0]) ? 1 : 0;
+		}
+		return rayHits;
+	}, &hits);
+	PrintRate("scalar boxes:", "boxes", numTests, hits, boxesMs, boxesMs);
+
+	const double boxes4Ms = timeTests([&](const RayPrecomp& rp)
+	{
+		uint64_t rayHits = 0;
+		for (const BoxPacket<4>& packet : boxes4)
+		{
+			rayHits += std::popcount(RayBoxes4(rp, packet, 0.0f, INFINITY, entries));
+		}
+		return rayHits;
+	}, &hits);
+	PrintRate("4-lane boxes:", "boxes", numTests, hits, boxes4Ms, boxesMs);
+
+	const double boxes8Ms = timeTests([&](const RayPrecomp& rp)
+	{
+		uint64_t rayHits = 0;
+		for (const BoxPacket<8>& packet : boxes8)
+		{
+			rayHits += std::popcount(RayBoxes8(rp, packet, 0.0f, INFINITY, entries));
+		}
+		return rayHits;
+	}, &hits);
+	PrintRate("8-lane boxes:", "boxes", numTests, hits, boxes8Ms, boxesMs);
+}
+
+void IntersectionSIMDBenchmark()
+{
+#if defined(INTERSECTION_AVX2)
+	printf("kernels: SSE2 (4 lanes), AVX2 (8 lanes)\n");
+#elif defined(INTERSECTION_SSE)
+	printf("kernels: SSE2 (4 lanes, 8 lanes as two halves)\n");
+#else
+	printf("kernels: scalar fallback\n");
+#endif
+
+	SceneBuffers buffers;
+	buffers.Init(64 * 1024, 128 * 1024, 1);
+	if (LoadTestObj("../Models/stanford-bunny.obj", buffers))
+	{
+		const GeoTypes::Vertex3D* vts = reinterpret_cast<const GeoTypes::Vertex3D*>(&buffers.BufferContents(SceneBuffers::VBUFFER)[0]);
+		const IndexedTriangle* tris = reinterpret_cast<const IndexedTriangle*>(&buffers.BufferContents(SceneBuffers::TRIBUFFER)[0]);
+		BenchmarkMesh("bunny", { &vts[0].pos, sizeof(GeoTypes::Vertex3D), tris, static_cast<uint32_t>(buffers.NumTris()) }, 256);
+	}
+	else
+	{
+		printf("couldn't open ../Models/stanford-bunny.obj\n");
+	}
+	buffers.DeInit();
+}
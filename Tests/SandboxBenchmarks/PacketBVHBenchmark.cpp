@@ -0,0 +1,199 @@
+#include "Benchmarks.h"
+#include "../TestScenes.h"
+#include "../../SandboxApp/PacketBVH.h"
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <vector>
+
+// A camera's worth of rays through a mesh, then its diffuse bounces depth by depth, traced one ray at a time, in 4x4/8x8 packets,
+// and as sorted streams (HeadlessTracer's tracing modes, without shading in the way). Camera packets are pixel tiles; later depths'
+// packets are consecutive rays (from neighbouring pixels, but bounced independently). Every mode has to report the same hits
+struct PacketBenchMesh
+{
+	const float4* positions;
+	uint64_t numVerts;
+	uint64_t strideBytes;
+	const IndexedTriangle* tris;
+	uint32_t numTris;
+};
+
+// Best of a few runs, since these are short
+template<typename Trace>
+static double BestMs(Trace&& trace)
+{
+	double bestMs = INFINITY;
+	for (uint32_t run = 0; run < 5; run++)
+	{
+		BenchTimer timer;
+		trace();
+		bestMs = std::min(bestMs, timer.ElapsedMs());
+	}
+	return bestMs;
+}
+
+static void BenchmarkDepths(const char* label, const PacketBenchMesh& mesh, uint32_t imageSize, uint32_t numDepths)
+{
+	BVH::BinnedSAHSettings settings;
+	settings.leafTris = 8;
+	settings.maxLeafTris = 16;
+	BVH bvh;
+	bvh.BuildBinnedSAH(mesh.positions, mesh.numVerts, mesh.strideBytes, mesh.tris, mesh.numTris, settings);
+	PacketBVH packetBVH;
+	packetBVH.Build(bvh, mesh.positions, mesh.numVerts, mesh.strideBytes, mesh.tris);
+	const ComputeBVH_Node root = bvh.Nodes()[0];
+	bvh.DeInit();
+
+	const float center[3] = { 0.5f * (root.boundsMin.x + root.boundsMax.x), 0.5f * (root.boundsMin.y + root.boundsMax.y), 0.5f * (root.boundsMin.z + root.boundsMax.z) };
+	const float extent[3] = { root.boundsMax.x - root.boundsMin.x, root.boundsMax.y - root.boundsMin.y, root.boundsMax.z - root.boundsMin.z };
+	const float radius = 0.5f * std::sqrt(extent[0] * extent[0] + extent[1] * extent[1] + extent[2] * extent[2]);
+	printf("%s: %u triangles, %u nodes, %u leaf packets; %ux%u camera rays, %u depths\n", label, mesh.numTris, packetBVH.NumNodes(), packetBVH.NumPackets(),
+		   imageSize, imageSize, numDepths);
+
+	// Camera rays from -z, with the mesh's middle filling the image (row-major, so tiles of [side] x [side] rays are pixel tiles)
+	std::vector<PacketBVH::Ray> rays(static_cast<size_t>(imageSize) * imageSize);
+	const float4 eye = float4(center[0], center[1], center[2] - 3.0f * radius, 0.0f);
+	for (uint32_t y = 0; y < imageSize; y++)
+	{
+		for (uint32_t x = 0; x < imageSize; x++)
+		{
+			const float px = ((x + 0.5f) / imageSize - 0.5f) * 0.6f, py = ((y + 0.5f) / imageSize - 0.5f) * 0.6f;
+			rays[y * imageSize + x] = { eye, float4(px, py, 1.0f, 0.0f), 0.0f, INFINITY };
+		}
+	}
+
+	std::mt19937 rng(4344);
+	std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+	for (uint32_t depth = 0; depth < numDepths && !rays.empty(); depth++)
+	{
+		const uint32_t numRays = static_cast<uint32_t>(rays.size());
+		std::vector<PacketBVH::Hit> hits(numRays), checkHits(numRays);
+		PacketBVH::TraceCounts singleCounts = {}, streamCounts = {};
+
+		const double singleMs = BestMs([&]()
+		{
+			singleCounts = {};
+			for (uint32_t i = 0; i < numRays; i++)
+			{
+				packetBVH.ClosestHit(rays[i], &hits[i], &singleCounts);
+			}
+		});
+		printf("  depth %u, %u rays:\n", depth, numRays);
+		printf("    %-14s %8.2f Mrays/s (1.00x), %.1f box tests/ray\n", "single rays", numRays / (singleMs * 1000.0), static_cast<double>(singleCounts.boxTests) / numRays);
+
+		auto checkAgainstSingle = [&](const char* mode)
+		{
+			uint32_t numMismatches = 0;
+			for (uint32_t i = 0; i < numRays; i++)
+			{
+				numMismatches += ((hits[i].tri == PacketBVH::invalidTri) != (checkHits[i].tri == PacketBVH::invalidTri) || (hits[i].tri != PacketBVH::invalidTri && hits[i].t != checkHits[i].t)) ? 1 : 0;
+			}
+			if (numMismatches > 0)
+			{
+				printf("    %s: %u hits differ from single rays'!\n", mode, numMismatches);
+			}
+		};
+
+		const uint32_t sides[] = { 4, 8 };
+		for (uint32_t side : sides)
+		{
+			PacketBVH::TraceCounts packetCounts = {};
+			const double packetMs = BestMs([&]()
+			{
+				packetCounts = {};
+				PacketBVH::Ray packetRays[PacketBVH::maxPacketRays];
+				PacketBVH::Hit packetHits[PacketBVH::maxPacketRays];
+				uint32_t packetNdces[PacketBVH::maxPacketRays];
+				const uint32_t packetSize = side * side;
+				for (uint32_t first = 0; first < numRays; first += packetSize)
+				{
+					uint32_t count = 0;
+					for (uint32_t i = 0; i < packetSize; i++)
+					{
+						// Pixel tiles for camera rays, runs of consecutive rays after that
+						const uint32_t tile = first / packetSize;
+						const uint32_t ndx = (depth == 0) ? ((tile / (imageSize / side)) * side + i / side) * imageSize + (tile % (imageSize / side)) * side + i % side : first + i;
+						if (ndx < numRays)
+						{
+							packetNdces[count] = ndx;
+							packetRays[count++] = rays[ndx];
+						}
+					}
+					packetBVH.ClosestHitPacket(packetRays, count, packetHits, &packetCounts);
+					for (uint32_t i = 0; i < count; i++)
+					{
+						checkHits[packetNdces[i]] = packetHits[i];
+					}
+				}
+			});
+			char mode[32];
+			snprintf(mode, sizeof(mode), "%ux%u packets", side, side);
+			printf("    %-14s %8.2f Mrays/s (%.2fx), %.1f box tests/ray, %.1f frustum culls/packet\n", mode, numRays / (packetMs * 1000.0), singleMs / packetMs,
+				   static_cast<double>(packetCounts.boxTests) / numRays, static_cast<double>(packetCounts.frustumCulls) / ((numRays + side * side - 1) / (side * side)));
+			checkAgainstSingle(mode);
+		}
+
+		std::vector<uint64_t> scratch(numRays * 2);
+		std::vector<uint32_t> order(numRays);
+		const double streamMs = BestMs([&]()
+		{
+			streamCounts = {};
+			packetBVH.SortStream(rays.data(), numRays, scratch.data(), order.data());
+			packetBVH.ClosestHitStream(rays.data(), order.data(), numRays, checkHits.data(), &streamCounts);
+		});
+		printf("    %-14s %8.2f Mrays/s (%.2fx), %.1f box tests/ray (sorting included)\n", "sorted streams", numRays / (streamMs * 1000.0), singleMs / streamMs,
+			   static_cast<double>(streamCounts.boxTests) / numRays);
+		checkAgainstSingle("streams");
+
+		// Diffuse bounces off every hit, nudged off the surface
+		std::vector<PacketBVH::Ray> bounces;
+		for (uint32_t i = 0; i < numRays; i++)
+		{
+			if (hits[i].tri == PacketBVH::invalidTri)
+			{
+				continue;
+			}
+			const IndexedTriangle& tri = mesh.tris[hits[i].tri];
+			auto vertex = [&](uint32_t ndx) { return *reinterpret_cast<const float4*>(reinterpret_cast<const uint8_t*>(mesh.positions) + ndx * mesh.strideBytes); };
+			const float4 p0 = vertex(tri.xyz.x), p1 = vertex(tri.xyz.y), p2 = vertex(tri.xyz.z);
+			const float e1[3] = { p1.x - p0.x, p1.y - p0.y, p1.z - p0.z }, e2[3] = { p2.x - p0.x, p2.y - p0.y, p2.z - p0.z };
+			float n[3] = { e1[1] * e2[2] - e1[2] * e2[1], e1[2] * e2[0] - e1[0] * e2[2], e1[0] * e2[1] - e1[1] * e2[0] };
+			const float* d = &rays[i].dir.x;
+			const float facing = (n[0] * d[0] + n[1] * d[1] + n[2] * d[2] > 0.0f) ? -1.0f : 1.0f;
+			const float invLength = facing / std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+			for (float& c : n)
+			{
+				c *= invLength;
+			}
+
+			// Cosine-weighted: a uniform point on the unit sphere, offset along the normal
+			const float z = 2.0f * unit(rng) - 1.0f, phi = 6.2831853f * unit(rng), r = std::sqrt(std::max(1.0f - z * z, 0.0f));
+			const float dir[3] = { n[0] + r * std::cos(phi), n[1] + r * std::sin(phi), n[2] + z };
+			const float* o = &rays[i].origin.x;
+			const float t = hits[i].t;
+			bounces.push_back({ float4(o[0] + d[0] * t + n[0] * 1e-4f * radius, o[1] + d[1] * t + n[1] * 1e-4f * radius, o[2] + d[2] * t + n[2] * 1e-4f * radius, 0.0f),
+								float4(dir[0], dir[1], dir[2], 0.0f), 0.0f, INFINITY });
+		}
+		rays.swap(bounces);
+	}
+
+	packetBVH.DeInit();
+}
+
+void PacketBVHBenchmark()
+{
+	SceneBuffers buffers;
+	buffers.Init(64 * 1024, 128 * 1024, 1);
+	if (LoadTestObj("../Models/stanford-bunny.obj", buffers))
+	{
+		const GeoTypes::Vertex3D* vts = reinterpret_cast<const GeoTypes::Vertex3D*>(&buffers.BufferContents(SceneBuffers::VBUFFER)[0]);
+		const IndexedTriangle* tris = reinterpret_cast<const IndexedTriangle*>(&buffers.BufferContents(SceneBuffers::TRIBUFFER)[0]);
+		BenchmarkDepths("bunny", { &vts[0].pos, buffers.NumVerts(), sizeof(GeoTypes::Vertex3D), tris, static_cast<uint32_t>(buffers.NumTris()) }, 256, 4);
+	}
+	else
+	{
+		printf("couldn't open ../Models/stanford-bunny.obj\n");
+	}
+	buffers.DeInit();
+}
@@ -0,0 +1,51 @@
+#include <iostream>
+#include <cstring>
+
+#include "../../CPUMemory.h"
+#include "Benchmarks.h"
+
+struct BenchmarkEntry
+{
+    const char* name;
+    void (*run)();
+};
+
+static const BenchmarkEntry benchmarks[] =
+{
+    { "scenegraph", SceneGraphBenchmark },
+    { "bounds", BoundsBenchmark },
+    { "scenequery", SceneQueryBenchmark },
+    { "sparseoctree", SparseOctreeBenchmark },
+    { "bvh", BVHBenchmark },
+    { "stacklessbvh", StacklessBVHBenchmark },
+    { "twolevelas", TwoLevelASBenchmark },
+    { "widebvh", WideBVHBenchmark },
+    { "asreport", ASReportBenchmark },
+    { "intersectionsimd", IntersectionSIMDBenchmark },
+    { "packetbvh", PacketBVHBenchmark },
+    { "tilescheduler", TileSchedulerBenchmark },
+};
+
+int main(int argc, char** argv)
+{
+    CPUMemory::Init();
+
+    // Run everything by default, or just the benchmarks named on the command line
+    for (const BenchmarkEntry& bench : benchmarks)
+    {
+        bool selected = (argc <= 1);
+        for (int i = 1; i < argc; i++)
+        {
+            selected |= (strcmp(argv[i], bench.name) == 0);
+        }
+
+        if (selected)
+        {
+            printf("== %s ==\n", bench.name);
+            bench.run();
+            printf("\n");
+        }
+    }
+
+    CPUMemory::DeInit();
+}
@@ -0,0 +1,95 @@
+#include "Benchmarks.h"
+#include "../../SandboxApp/SceneGraph.h"
+
+#include <random>
+#include <cmath>
+
+// 100k instances of 64 meshes, parented under 1000 groups; 1% of instances move each frame
+void SceneGraphBenchmark()
+{
+	constexpr uint32_t numGroups = 1000;
+	constexpr uint32_t instancesPerGroup = 100;
+	constexpr uint32_t numInstances = numGroups * instancesPerGroup;
+	constexpr uint32_t numMeshes = 64;
+	constexpr uint32_t numFrames = 256;
+	constexpr uint32_t movesPerFrame = numInstances / 100;
+
+	std::mt19937 rng(1234);
+	std::uniform_real_distribution<float> unitDist(-1.0f, 1.0f);
+
+	SceneGraph graph;
+	graph.Init(numGroups + numInstances, numMeshes);
+
+	for (uint32_t i = 0; i < numMeshes; i++)
+	{
+		const float extent = 0.5f + (static_cast<float>(i) / numMeshes);
+		graph.AddMesh(float4(-extent, -extent, -extent, 0.0f), float4(extent, extent, extent, 0.0f));
+	}
+
+	auto randomTransform = [&](float spread)
+	{
+		transform t;
+		t.translationAndScale = float4(unitDist(rng) * spread, unitDist(rng) * spread, unitDist(rng) * spread, 1.0f + 0.5f * unitDist(rng));
+
+		// Random unit quaternion
+		float qx = unitDist(rng), qy = unitDist(rng), qz = unitDist(rng), qw = unitDist(rng);
+		const float invLen = 1.0f / std::sqrt(qx * qx + qy * qy + qz * qz + qw * qw);
+		t.rotation = float4(qx * invLen, qy * invLen, qz * invLen, qw * invLen);
+		return t;
+	};
+
+	// Build hierarchy; instance node indices are recorded so we can move them later
+	auto instanceNodes = CPUMemory::AllocateArray<uint32_t>(numInstances);
+	BenchTimer timer;
+	for (uint32_t g = 0; g < numGroups; g++)
+	{
+		const uint32_t groupNode = graph.AddNode(SceneGraph::invalidNdx, randomTransform(500.0f));
+		for (uint32_t i = 0; i < instancesPerGroup; i++)
+		{
+			instanceNodes[g * instancesPerGroup + i] = graph.AddNode(groupNode, randomTransform(20.0f), rng() % numMeshes);
+		}
+	}
+	const double buildMs = timer.ElapsedMs();
+
+	timer.Reset();
+	const uint32_t numInitialUpdates = graph.Update();
+	const double fullUpdateMs = timer.ElapsedMs();
+
+	// Per-frame updates with 1% of instances moving
+	double totalFrameMs = 0.0;
+	uint64_t totalRecomputed = 0;
+	for (uint32_t f = 0; f < numFrames; f++)
+	{
+		for (uint32_t m = 0; m < movesPerFrame; m++)
+		{
+			const uint32_t node = instanceNodes[rng() % numInstances];
+			graph.SetLocalTransform(node, randomTransform(20.0f));
+		}
+
+		timer.Reset();
+		totalRecomputed += graph.Update();
+		totalFrameMs += timer.ElapsedMs();
+	}
+
+	// Moving a handful of groups drags their whole subtrees along
+	timer.Reset();
+	for (uint32_t g = 0; g < numGroups / 100; g++)
+	{
+		graph.SetLocalTransform(rng() % numGroups * (instancesPerGroup + 1), randomTransform(500.0f));
+	}
+	const uint32_t numGroupUpdates = graph.Update();
+	const double groupUpdateMs = timer.ElapsedMs();
+
+	float4 sceneMin, sceneMax;
+	graph.GetSceneBounds(&sceneMin, &sceneMax);
+
+	printf("%u instances (%u meshes, %u groups)\n", numInstances, numMeshes, numGroups);
+	printf("build: %.3fms\n", buildMs);
+	printf("full update (%u nodes): %.3fms\n", numInitialUpdates, fullUpdateMs);
+	printf("1%% moving (%u moves/frame, %.1f nodes recomputed/frame): %.4fms/frame over %u frames\n", movesPerFrame, static_cast<double>(totalRecomputed) / numFrames, totalFrameMs / numFrames, numFrames);
+	printf("1%% of groups moving (%u nodes recomputed): %.4fms\n", numGroupUpdates, groupUpdateMs);
+	printf("scene bounds: (%.1f, %.1f, %.1f) -> (%.1f, %.1f, %.1f)\n", sceneMin.x, sceneMin.y, sceneMin.z, sceneMax.x, sceneMax.y, sceneMax.z);
+
+	CPUMemory::Free(instanceNodes);
+	graph.DeInit();
+}
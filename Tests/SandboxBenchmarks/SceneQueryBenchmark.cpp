@@ -0,0 +1,231 @@
+#include "Benchmarks.h"
+#include "../TestScenes.h"
+#include "../../SandboxApp/SceneQuery.h"
+#include "../../SandboxApp/Intersection.h"
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <thread>
+#include <vector>
+
+// BVH build + query throughput on the Stanford bunny, single-threaded and batched; closest-hit also runs against a brute-force loop
+// over a small ray set, to show what the BVH buys
+void SceneQueryBenchmark()
+{
+	SceneBuffers buffers;
+	buffers.Init(64 * 1024, 128 * 1024, 1);
+	if (!LoadTestObj("../Models/stanford-bunny.obj", buffers))
+	{
+		printf("couldn't open ../Models/stanford-bunny.obj\n");
+		buffers.DeInit();
+		return;
+	}
+
+	SceneGraph graph;
+	BuildTestGraph(buffers, graph, IdentityTransform());
+
+	constexpr uint32_t numBuilds = 8;
+	SceneQuery query;
+	BenchTimer timer;
+	for (uint32_t i = 0; i < numBuilds; i++)
+	{
+		query.Build(buffers, graph);
+		if (i < numBuilds - 1)
+		{
+			query.DeInit();
+		}
+	}
+	const double buildMs = timer.ElapsedMs() / numBuilds;
+	printf("%u triangles, %u nodes, %u hardware threads\n", query.NumTris(), query.NumNodes(), std::thread::hardware_concurrency());
+	printf("build: %.3fms\n", buildMs);
+
+	// Rays from a shell around the model toward random points inside its bounds (roughly half of them hit)
+	float4 sceneMin = float4(INFINITY, INFINITY, INFINITY, 0.0f), sceneMax = float4(-INFINITY, -INFINITY, -INFINITY, 0.0f);
+	for (uint32_t i = 0; i < query.NumTris(); i++)
+	{
+		float4 v[3];
+		query.GetTriangle(i, v);
+		for (const float4& p : v)
+		{
+			sceneMin = float4(std::min(sceneMin.x, p.x), std::min(sceneMin.y, p.y), std::min(sceneMin.z, p.z), 0.0f);
+			sceneMax = float4(std::max(sceneMax.x, p.x), std::max(sceneMax.y, p.y), std::max(sceneMax.z, p.z), 0.0f);
+		}
+	}
+	const float4 center = float4((sceneMin.x + sceneMax.x) * 0.5f, (sceneMin.y + sceneMax.y) * 0.5f, (sceneMin.z + sceneMax.z) * 0.5f, 0.0f);
+	const float extent = std::max({ sceneMax.x - sceneMin.x, sceneMax.y - sceneMin.y, sceneMax.z - sceneMin.z });
+
+	std::mt19937 rng(1415);
+	std::uniform_real_distribution<float> unit(0.0f, 1.0f), signedUnit(-1.0f, 1.0f);
+	auto pointInBounds = [&]()
+	{
+		return float4(sceneMin.x + unit(rng) * (sceneMax.x - sceneMin.x), sceneMin.y + unit(rng) * (sceneMax.y - sceneMin.y),
+					  sceneMin.z + unit(rng) * (sceneMax.z - sceneMin.z), 0.0f);
+	};
+
+	constexpr uint32_t numRays = 256 * 1024;
+	std::vector<SceneQuery::Ray> rays(numRays);
+	for (SceneQuery::Ray& ray : rays)
+	{
+		Vec3 offset = { signedUnit(rng), signedUnit(rng), signedUnit(rng) };
+		offset = Scale3(offset, extent / std::sqrt(std::max(Dot3(offset, offset), 1e-6f)));
+		ray.origin = float4(center.x + offset.x, center.y + offset.y, center.z + offset.z, 0.0f);
+
+		const float4 target = pointInBounds();
+		ray.dir = float4(target.x - ray.origin.x, target.y - ray.origin.y, target.z - ray.origin.z, 0.0f);
+		ray.tMin = 0.0f;
+		ray.tMax = INFINITY;
+	}
+
+	auto report = [](const char* label, uint32_t numQueries, double ms)
+	{
+		printf("%s: %.3fms (%.2fM queries/sec)\n", label, ms, (numQueries / 1000000.0) / (ms / 1000.0));
+	};
+
+	// Single-threaded
+	std::vector<SceneQuery::Hit> hits(numRays);
+	timer.Reset();
+	uint32_t numHits = 0;
+	for (uint32_t i = 0; i < numRays; i++)
+	{
+		numHits += query.ClosestHit(rays[i], &hits[i]) ? 1 : 0;
+	}
+	report("closest-hit", numRays, timer.ElapsedMs());
+	printf("(%u of %u rays hit)\n", numHits, numRays);
+
+	timer.Reset();
+	uint32_t numOccluded = 0;
+	for (uint32_t i = 0; i < numRays; i++)
+	{
+		numOccluded += query.AnyHit(rays[i]) ? 1 : 0;
+	}
+	report("any-hit", numRays, timer.ElapsedMs());
+	printf("(%u of %u rays occluded)\n", numOccluded, numRays);
+
+	// Batched
+	timer.Reset();
+	query.ClosestHitBatch(rays.data(), hits.data(), numRays);
+	report("closest-hit (batched)", numRays, timer.ElapsedMs());
+
+	std::vector<uint8_t> occluded(numRays);
+	timer.Reset();
+	query.AnyHitBatch(rays.data(), reinterpret_cast<bool*>(occluded.data()), numRays);
+	report("any-hit (batched)", numRays, timer.ElapsedMs());
+
+	// Brute force over the first few rays, for scale
+	constexpr uint32_t numBruteForceRays = 256;
+	std::vector<float4> triVerts(query.NumTris() * 3);
+	for (uint32_t i = 0; i < query.NumTris(); i++)
+	{
+		query.GetTriangle(i, &triVerts[i * 3]);
+	}
+
+	timer.Reset();
+	uint32_t numBruteForceHits = 0;
+	for (uint32_t r = 0; r < numBruteForceRays; r++)
+	{
+		const RayPrecomp rp = PrecomputeRay(rays[r].origin, rays[r].dir);
+		float tMax = rays[r].tMax;
+		bool hit = false;
+		for (uint32_t i = 0; i < query.NumTris(); i++)
+		{
+			float t, u, v;
+			if (RayTriangle(rp, triVerts[i * 3], triVerts[i * 3 + 1], triVerts[i * 3 + 2], rays[r].tMin, tMax, &t, &u, &v))
+			{
+				tMax = t;
+				hit = true;
+			}
+		}
+		numBruteForceHits += hit ? 1 : 0;
+	}
+	report("closest-hit (brute force)", numBruteForceRays, timer.ElapsedMs());
+	printf("(%u of %u rays hit)\n", numBruteForceHits, numBruteForceRays);
+
+	// Box overlap + frustum culling, at a few sizes
+	constexpr uint32_t numBoxes = 16 * 1024;
+	const float boxScales[] = { 0.01f, 0.05f, 0.2f };
+	for (float scale : boxScales)
+	{
+		std::vector<float4> boxCenters(numBoxes);
+		for (float4& c : boxCenters)
+		{
+			c = pointInBounds();
+		}
+
+		const float halfSize = extent * scale;
+		timer.Reset();
+		uint64_t numFound = 0;
+		for (const float4& c : boxCenters)
+		{
+			numFound += query.OverlapAABB(float4(c.x - halfSize, c.y - halfSize, c.z - halfSize, 0.0f), float4(c.x + halfSize, c.y + halfSize, c.z + halfSize, 0.0f), nullptr, 0);
+		}
+
+		char label[64] = {};
+		snprintf(label, sizeof(label), "AABB overlap (%.0f%% of extent)", scale * 200.0f);
+		report(label, numBoxes, timer.ElapsedMs());
+		printf("(%.1f triangles per box)\n", static_cast<double>(numFound) / numBoxes);
+	}
+
+	constexpr uint32_t numFrusta = 4096;
+	std::vector<SceneQuery::Frustum> frusta(numFrusta);
+	for (SceneQuery::Frustum& frustum : frusta)
+	{
+		// Narrow frusta (~20 degrees) looking at random points from outside the model
+		const SceneQuery::Ray& view = rays[rng() % numRays];
+		const float len = std::sqrt(Dot3(ToVec3(view.dir), ToVec3(view.dir)));
+		const Vec3 fwd = Scale3(ToVec3(view.dir), 1.0f / len);
+		const Vec3 upHint = (std::abs(fwd.y) < 0.9f) ? Vec3{ 0.0f, 1.0f, 0.0f } : Vec3{ 1.0f, 0.0f, 0.0f };
+		Vec3 right = Cross3(upHint, fwd);
+		right = Scale3(right, 1.0f / std::sqrt(Dot3(right, right)));
+		const Vec3 up = Cross3(fwd, right);
+		const Vec3 eye = ToVec3(view.origin);
+
+		constexpr float invTanHalf = 5.67f;
+		auto plane = [&](Vec3 n)
+		{
+			n = Scale3(n, 1.0f / std::sqrt(Dot3(n, n)));
+			return float4(n.x, n.y, n.z, -Dot3(n, eye));
+		};
+		frustum.planes[0] = plane(Add3(fwd, Scale3(right, invTanHalf)));
+		frustum.planes[1] = plane(Sub3(fwd, Scale3(right, invTanHalf)));
+		frustum.planes[2] = plane(Add3(fwd, Scale3(up, invTanHalf)));
+		frustum.planes[3] = plane(Sub3(fwd, Scale3(up, invTanHalf)));
+		frustum.planes[4] = float4(fwd.x, fwd.y, fwd.z, -Dot3(fwd, eye));
+		frustum.planes[5] = float4(-fwd.x, -fwd.y, -fwd.z, Dot3(fwd, eye) + len * 2.0f);
+	}
+
+	timer.Reset();
+	uint64_t numVisible = 0;
+	for (const SceneQuery::Frustum& frustum : frusta)
+	{
+		numVisible += query.FrustumCull(frustum, nullptr, 0);
+	}
+	report("frustum cull", numFrusta, timer.ElapsedMs());
+	printf("(%.1f triangles per frustum)\n", static_cast<double>(numVisible) / numFrusta);
+
+	// k-nearest
+	constexpr uint32_t numPoints = 64 * 1024;
+	constexpr uint32_t k = 8;
+	std::vector<float4> points(numPoints);
+	for (float4& p : points)
+	{
+		p = pointInBounds();
+	}
+
+	std::vector<SceneQuery::Nearest> nearest(numPoints * k);
+	std::vector<uint32_t> numFound(numPoints);
+	timer.Reset();
+	for (uint32_t i = 0; i < numPoints; i++)
+	{
+		numFound[i] = query.KNearest(points[i], k, &nearest[i * k]);
+	}
+	report("8-nearest", numPoints, timer.ElapsedMs());
+
+	timer.Reset();
+	query.KNearestBatch(points.data(), k, nearest.data(), numFound.data(), numPoints);
+	report("8-nearest (batched)", numPoints, timer.ElapsedMs());
+
+	query.DeInit();
+	graph.DeInit();
+	buffers.DeInit();
+}
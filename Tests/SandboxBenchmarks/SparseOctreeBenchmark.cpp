@@ -0,0 +1,120 @@
+#include "Benchmarks.h"
+#include "../TestScenes.h"
+#include "../../SandboxApp/SparseOctree.h"
+
+#include <cmath>
+#include <thread>
+#include <vector>
+
+// The dense octree Render::Init used to allocate: every node down to rank 6, whatever the geometry
+static constexpr uint64_t denseOctreeNodes = (((8ull * 8 * 8 * 8 * 8 * 8 * 8) - 1) / 7);
+
+static void ReportOctree(const char* label, const SparseOctree& octree, double buildMs)
+{
+	const SparseOctree::Stats& stats = octree.GetStats();
+	printf("%s: %.3fms, %u nodes (%u leaves), depth %u, %llu triangle refs, largest leaf %u\n", label, buildMs, stats.numNodes, stats.numLeaves, stats.depth,
+		   static_cast<unsigned long long>(stats.numTriRefs), stats.maxLeafTris);
+	printf("    %.2fMB nodes + %.2fMB triangle lists (dense grid: %.2fMB nodes)\n", stats.nodeBytes / (1024.0 * 1024.0), stats.triListBytes / (1024.0 * 1024.0),
+		   (denseOctreeNodes * sizeof(ComputeAS_Node)) / (1024.0 * 1024.0));
+
+	printf("    nodes per level:");
+	for (uint32_t level = 0; level <= stats.depth; level++)
+	{
+		printf(" %u", stats.nodesPerLevel[level]);
+	}
+	printf("\n");
+}
+
+static double TimeBuild(SparseOctree& octree, const float4* positions, uint64_t numVerts, uint64_t strideBytes, const IndexedTriangle* tris, uint32_t numTris,
+						const SparseOctree::Settings& settings, uint32_t numBuilds)
+{
+	BenchTimer timer;
+	for (uint32_t i = 0; i < numBuilds; i++)
+	{
+		octree.Build(positions, numVerts, strideBytes, tris, numTris, settings);
+		if (i < numBuilds - 1)
+		{
+			octree.DeInit();
+		}
+	}
+	return timer.ElapsedMs() / numBuilds;
+}
+
+// Sparse octree builds on the Stanford bunny across leaf thresholds/depth limits, then on a ~10M triangle heightfield
+void SparseOctreeBenchmark()
+{
+	printf("%u hardware threads\n", std::thread::hardware_concurrency());
+
+	SceneBuffers buffers;
+	buffers.Init(64 * 1024, 128 * 1024, 1);
+	if (LoadTestObj("../Models/stanford-bunny.obj", buffers))
+	{
+		const GeoTypes::Vertex3D* vts = reinterpret_cast<const GeoTypes::Vertex3D*>(&buffers.BufferContents(SceneBuffers::VBUFFER)[0]);
+		const IndexedTriangle* tris = reinterpret_cast<const IndexedTriangle*>(&buffers.BufferContents(SceneBuffers::TRIBUFFER)[0]);
+		const uint32_t numTris = static_cast<uint32_t>(buffers.NumTris());
+
+		// Thresholds below the mesh's vertex valence (~6) mostly buy depth; every fan around a vertex keeps splitting until the depth limit
+		const uint32_t leafThresholds[] = { 4, 8, 16, 32 };
+		const uint32_t depthLimits[] = { 6, 9, 12 };
+		for (uint32_t maxDepth : depthLimits)
+		{
+			for (uint32_t leafTris : leafThresholds)
+			{
+				SparseOctree::Settings settings;
+				settings.maxDepth = maxDepth;
+				settings.leafTris = leafTris;
+
+				SparseOctree octree;
+				const double ms = TimeBuild(octree, &vts[0].pos, buffers.NumVerts(), sizeof(GeoTypes::Vertex3D), tris, numTris, settings, 4);
+
+				char label[96] = {};
+				snprintf(label, sizeof(label), "bunny (%u tris, leaf threshold %u, max depth %u)", numTris, leafTris, maxDepth);
+				ReportOctree(label, octree, ms);
+				octree.DeInit();
+			}
+		}
+	}
+	else
+	{
+		printf("couldn't open ../Models/stanford-bunny.obj\n");
+	}
+	buffers.DeInit();
+
+	// Rolling heightfield, two triangles per grid quad
+	constexpr uint32_t gridQuads = 2237;
+	constexpr uint32_t gridVerts = gridQuads + 1;
+	std::vector<float4> positions(static_cast<size_t>(gridVerts) * gridVerts);
+	for (uint32_t y = 0; y < gridVerts; y++)
+	{
+		for (uint32_t x = 0; x < gridVerts; x++)
+		{
+			const float fx = static_cast<float>(x) / gridQuads, fy = static_cast<float>(y) / gridQuads;
+			const float height = 0.08f * std::sin(fx * 7.0f) * std::cos(fy * 5.0f) + 0.01f * std::sin((fx + fy) * 31.0f);
+			positions[static_cast<size_t>(y) * gridVerts + x] = float4(fx, height, fy, 1.0f);
+		}
+	}
+
+	std::vector<IndexedTriangle> tris(static_cast<size_t>(gridQuads) * gridQuads * 2);
+	for (uint32_t y = 0; y < gridQuads; y++)
+	{
+		for (uint32_t x = 0; x < gridQuads; x++)
+		{
+			const uint32_t v00 = y * gridVerts + x, v10 = v00 + 1, v01 = v00 + gridVerts, v11 = v01 + 1;
+			IndexedTriangle* quad = &tris[(static_cast<size_t>(y) * gridQuads + x) * 2];
+			quad[0].xyz = uint4(v00, v10, v11, 0);
+			quad[1].xyz = uint4(v00, v11, v01, 0);
+		}
+	}
+
+	// Only the coarser leaf threshold fits; at 8 triangles per leaf the finished tree alone (~230MB) fills CPUMemory's scratch budget
+	SparseOctree::Settings settings;
+	settings.leafTris = 32;
+
+	SparseOctree octree;
+	const double ms = TimeBuild(octree, positions.data(), positions.size(), sizeof(float4), tris.data(), static_cast<uint32_t>(tris.size()), settings, 1);
+
+	char label[96] = {};
+	snprintf(label, sizeof(label), "heightfield (%zu tris, leaf threshold %u, max depth %u)", tris.size(), settings.leafTris, settings.maxDepth);
+	ReportOctree(label, octree, ms);
+	octree.DeInit();
+}
@@ -0,0 +1,142 @@
+#include "Benchmarks.h"
+#include "../TestScenes.h"
+#include "../../SandboxApp/StacklessBVH.h"
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <vector>
+
+// Rays from outside [boundsMin, boundsMax] towards random points inside it
+static std::vector<StacklessBVH::Ray> StacklessRaysInto(const float* boundsMin, const float* boundsMax, uint32_t numRays)
+{
+	std::mt19937 rng(1234);
+	std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+	const float extent = std::max({ boundsMax[0] - boundsMin[0], boundsMax[1] - boundsMin[1], boundsMax[2] - boundsMin[2] });
+	auto pointIn = [&](float margin)
+	{
+		return float4(boundsMin[0] - margin + unit(rng) * (boundsMax[0] - boundsMin[0] + 2.0f * margin),
+					  boundsMin[1] - margin + unit(rng) * (boundsMax[1] - boundsMin[1] + 2.0f * margin),
+					  boundsMin[2] - margin + unit(rng) * (boundsMax[2] - boundsMin[2] + 2.0f * margin), 0.0f);
+	};
+
+	std::vector<StacklessBVH::Ray> rays(numRays);
+	for (StacklessBVH::Ray& ray : rays)
+	{
+		ray.origin = pointIn(extent);
+		const float4 target = pointIn(0.0f);
+		ray.dir = float4(target.x - ray.origin.x, target.y - ray.origin.y, target.z - ray.origin.z, 0.0f);
+		ray.tMin = 0.0f;
+		ray.tMax = INFINITY;
+	}
+	return rays;
+}
+
+// Closest-hit work + throughput for each traversal over the same encoding, next to the per-ray state each one needs (what a shader
+// would keep in registers/scratch)
+static void CompareTraversals(const char* label, const float4* positions, uint64_t numVerts, uint64_t strideBytes, const IndexedTriangle* tris, uint32_t numTris,
+							  const float* boundsMin, const float* boundsMax, uint32_t numRays)
+{
+	BVH bvh;
+	bvh.BuildBinnedSAH(positions, numVerts, strideBytes, tris, numTris, BVH::BinnedSAHSettings());
+
+	StacklessBVH stackless;
+	BenchTimer timer;
+	stackless.Build(bvh, positions, numVerts, strideBytes, tris);
+	const double convertMs = timer.ElapsedMs();
+	printf("%s (%u tris, %u nodes, depth %u), encoded in %.3fms\n", label, numTris, stackless.NumNodes(), bvh.GetStats().depth, convertMs);
+
+	const std::vector<StacklessBVH::Ray> rays = StacklessRaysInto(boundsMin, boundsMax, numRays);
+	const StacklessBVH::Traversal traversals[] = { StacklessBVH::Traversal::Stack, StacklessBVH::Traversal::SkipLinks, StacklessBVH::Traversal::RestartTrail };
+	const char* traversalNames[] = { "stack", "skip links", "restart trail" };
+	const uint32_t stateBytes[] = { AS_BVH_MAX_DEPTH * (sizeof(uint32_t) + sizeof(float)) + 2 * sizeof(uint32_t), sizeof(uint32_t), 2 * sizeof(uint64_t) + sizeof(uint32_t) };
+	double baseMs = 0.0;
+	for (uint32_t i = 0; i < 3; i++)
+	{
+		uint64_t boxTests = 0, triTests = 0, restarts = 0;
+		uint32_t numHits = 0;
+		for (const StacklessBVH::Ray& ray : rays)
+		{
+			StacklessBVH::Hit hit;
+			StacklessBVH::TraceCounts counts;
+			numHits += stackless.ClosestHit(ray, &hit, traversals[i], &counts) ? 1 : 0;
+			boxTests += counts.nodes;
+			triTests += counts.triTests;
+			restarts += counts.restarts;
+		}
+
+		timer.Reset();
+		for (const StacklessBVH::Ray& ray : rays)
+		{
+			StacklessBVH::Hit hit;
+			stackless.ClosestHit(ray, &hit, traversals[i]);
+		}
+		const double traceMs = timer.ElapsedMs();
+		baseMs = (i == 0) ? traceMs : baseMs;
+
+		printf("    %s (%u bytes of state): per ray %.1f box tests + %.1f triangle tests", traversalNames[i], stateBytes[i], static_cast<double>(boxTests) / numRays,
+			   static_cast<double>(triTests) / numRays);
+		if (traversals[i] == StacklessBVH::Traversal::RestartTrail)
+		{
+			printf(" (%.2f restarts)", static_cast<double>(restarts) / numRays);
+		}
+		printf(", %.2fM rays/sec (%.2fx, %u hits)\n", (numRays / 1000000.0) / (traceMs / 1000.0), baseMs / traceMs, numHits);
+	}
+
+	timer.Reset();
+	uint32_t numOccluded = 0;
+	for (const StacklessBVH::Ray& ray : rays)
+	{
+		numOccluded += stackless.AnyHit(ray) ? 1 : 0;
+	}
+	const double anyMs = timer.ElapsedMs();
+	printf("    skip-link any-hit: %.2fM rays/sec (%u occluded)\n", (numRays / 1000000.0) / (anyMs / 1000.0), numOccluded);
+
+	stackless.DeInit();
+	bvh.DeInit();
+}
+
+void StacklessBVHBenchmark()
+{
+	constexpr uint32_t numRays = 256 * 1024;
+
+	SceneBuffers buffers;
+	buffers.Init(64 * 1024, 128 * 1024, 1);
+	if (LoadTestObj("../Models/stanford-bunny.obj", buffers))
+	{
+		const GeoTypes::Vertex3D* vts = reinterpret_cast<const GeoTypes::Vertex3D*>(&buffers.BufferContents(SceneBuffers::VBUFFER)[0]);
+		const IndexedTriangle* tris = reinterpret_cast<const IndexedTriangle*>(&buffers.BufferContents(SceneBuffers::TRIBUFFER)[0]);
+		float meshMin[3] = { INFINITY, INFINITY, INFINITY }, meshMax[3] = { -INFINITY, -INFINITY, -INFINITY };
+		for (uint64_t i = 0; i < buffers.NumVerts(); i++)
+		{
+			const float p[3] = { vts[i].pos.x, vts[i].pos.y, vts[i].pos.z };
+			for (uint32_t a = 0; a < 3; a++)
+			{
+				meshMin[a] = std::min(meshMin[a], p[a]);
+				meshMax[a] = std::max(meshMax[a], p[a]);
+			}
+		}
+		CompareTraversals("bunny", &vts[0].pos, buffers.NumVerts(), sizeof(GeoTypes::Vertex3D), tris, static_cast<uint32_t>(buffers.NumTris()), meshMin, meshMax, numRays);
+	}
+	else
+	{
+		printf("couldn't open ../Models/stanford-bunny.obj\n");
+	}
+	buffers.DeInit();
+
+	// Interiors: most rays end on a nearby wall, so near-to-far order matters more than it does around a single closed mesh
+	std::vector<float4> positions;
+	std::vector<IndexedTriangle> tris;
+	BuildArchitecturalScene(4, 8, 8, positions, tris);
+	float sceneMin[3] = { INFINITY, INFINITY, INFINITY }, sceneMax[3] = { -INFINITY, -INFINITY, -INFINITY };
+	for (const float4& p : positions)
+	{
+		const float c[3] = { p.x, p.y, p.z };
+		for (uint32_t a = 0; a < 3; a++)
+		{
+			sceneMin[a] = std::min(sceneMin[a], c[a]);
+			sceneMax[a] = std::max(sceneMax[a], c[a]);
+		}
+	}
+	CompareTraversals("building", positions.data(), positions.size(), sizeof(float4), tris.data(), static_cast<uint32_t>(tris.size()), sceneMin, sceneMax, numRays);
+}
@@ -0,0 +1,207 @@
+#include "Benchmarks.h"
+#include "../TestScenes.h"
+#include "../../SandboxApp/PacketBVH.h"
+#include "../../SandboxApp/TileScheduler.h"
+
+#include <algorithm>
+#include <cmath>
+#include <thread>
+#include <vector>
+
+// Scaling of a CPU render's tiles over thread counts: camera rays through a mesh, with a few extra shadow-style rays wherever they hit
+// (so tiles over the mesh cost several times those over the background, the imbalance stealing has to even out). Compares the old
+// static split (each thread a fixed band of rows) against stolen tiles in row-major, Morton, and Hilbert order, plus the pool's
+// per-run overhead on empty frames
+struct TileBenchScene
+{
+	const PacketBVH* packetBVH;
+	float eye[3];
+	float lightDir[3];
+	uint32_t imageSize;
+	uint32_t extraRays; // Traced from each hit
+};
+
+// Traces one pixel; returns a checksum of its hits, so nothing's optimised out and every schedule can be checked against the others
+static uint32_t TracePixel(const TileBenchScene& scene, uint32_t x, uint32_t y)
+{
+	const float px = ((x + 0.5f) / scene.imageSize - 0.5f) * 0.6f, py = ((y + 0.5f) / scene.imageSize - 0.5f) * 0.6f;
+	PacketBVH::Ray ray = { float4(scene.eye[0], scene.eye[1], scene.eye[2], 0.0f), float4(px, py, 1.0f, 0.0f), 0.0f, INFINITY };
+	PacketBVH::Hit hit;
+	scene.packetBVH->ClosestHit(ray, &hit);
+	if (hit.tri == PacketBVH::invalidTri)
+	{
+		return 0;
+	}
+
+	uint32_t checksum = hit.tri;
+	const float t = hit.t * 0.999f;
+	const float4 origin = float4(scene.eye[0] + px * t, scene.eye[1] + py * t, scene.eye[2] + t, 0.0f);
+	for (uint32_t i = 0; i < scene.extraRays; i++)
+	{
+		// Fanned out around the light so each ray takes its own path through the tree
+		const float spread = 0.1f * i;
+		PacketBVH::Ray extra = { origin, float4(scene.lightDir[0] + spread, scene.lightDir[1], scene.lightDir[2] - spread, 0.0f), 0.0f, INFINITY };
+		checksum += scene.packetBVH->AnyHit(extra) ? 1 : 0;
+	}
+	return checksum;
+}
+
+static void TraceTile(const TileBenchScene& scene, uint32_t x0, uint32_t y0, uint32_t x1, uint32_t y1, uint32_t* checksums)
+{
+	for (uint32_t y = y0; y < y1; y++)
+	{
+		for (uint32_t x = x0; x < x1; x++)
+		{
+			checksums[y * scene.imageSize + x] = TracePixel(scene, x, y);
+		}
+	}
+}
+
+// Best of a few runs, since these are short
+template<typename Render>
+static double BestMs(Render&& render)
+{
+	double bestMs = INFINITY;
+	for (uint32_t run = 0; run < 3; run++)
+	{
+		BenchTimer timer;
+		render();
+		bestMs = std::min(bestMs, timer.ElapsedMs());
+	}
+	return bestMs;
+}
+
+static void BenchmarkScaling(const TileBenchScene& scene)
+{
+	const uint32_t imageSize = scene.imageSize;
+	std::vector<uint32_t> reference(imageSize * imageSize), checksums(imageSize * imageSize);
+	TraceTile(scene, 0, 0, imageSize, imageSize, reference.data());
+
+	const uint32_t maxThreads = std::min(std::max(std::thread::hardware_concurrency(), 1u), TileScheduler::maxThreads);
+	std::vector<uint32_t> threadCounts;
+	for (uint32_t threads = 1; threads < maxThreads; threads *= 2)
+	{
+		threadCounts.push_back(threads);
+	}
+	threadCounts.push_back(maxThreads);
+
+	const char* orderNames[] = { "row-major", "morton", "hilbert" };
+	const uint32_t tileSize = 16;
+	printf("%ux%u pixels, %u extra rays per hit, %ux%u tiles; ms (speedup over one thread, efficiency)\n", imageSize, imageSize, scene.extraRays, tileSize, tileSize);
+	printf("%-8s %26s", "threads", "static rows");
+	for (const char* name : orderNames)
+	{
+		printf(" %26s", name);
+	}
+	printf(" %10s\n", "steals");
+
+	double oneThreadMs[4] = {};
+	for (uint32_t numThreads : threadCounts)
+	{
+		uint32_t numMismatches = 0;
+		auto check = [&]()
+		{
+			numMismatches += (checksums != reference) ? 1 : 0;
+			std::fill(checksums.begin(), checksums.end(), UINT32_MAX);
+		};
+		auto report = [&](uint32_t column, double ms)
+		{
+			if (numThreads == 1)
+			{
+				oneThreadMs[column] = ms;
+			}
+			const double speedup = oneThreadMs[column] / ms;
+			printf(" %9.1f (%5.2fx, %5.1f%%)", ms, speedup, 100.0 * speedup / numThreads);
+		};
+		printf("%-8u", numThreads);
+
+		// Static split: threads created per frame, each given an equal band of rows up front (as the sandbox seeded its PRNGs)
+		const double staticMs = BestMs([&]()
+		{
+			std::vector<std::thread> threads;
+			for (uint32_t t = 0; t < numThreads; t++)
+			{
+				threads.emplace_back([&, t]()
+				{
+					TraceTile(scene, 0, imageSize * t / numThreads, imageSize, imageSize * (t + 1) / numThreads, checksums.data());
+				});
+			}
+			for (std::thread& thread : threads)
+			{
+				thread.join();
+			}
+		});
+		check();
+		report(0, staticMs);
+
+		TileScheduler scheduler;
+		scheduler.Init(numThreads);
+		uint32_t hilbertSteals = 0;
+		for (uint32_t order = 0; order < 3; order++)
+		{
+			TileScheduler::RunStats stats = {};
+			const double ms = BestMs([&]()
+			{
+				stats = scheduler.Run(imageSize, imageSize, tileSize, static_cast<TileScheduler::TileOrder>(order), [&](const TileScheduler::Tile& tile, uint32_t)
+				{
+					TraceTile(scene, tile.x0, tile.y0, tile.x1, tile.y1, checksums.data());
+				});
+			});
+			check();
+			report(1 + order, ms);
+			hilbertSteals = stats.numSteals;
+		}
+		printf(" %10u\n", hilbertSteals);
+
+		// Per-run overhead: waking the pool and waiting for it, with nothing to trace
+		const uint32_t numEmptyRuns = 1000;
+		BenchTimer wakeTimer;
+		for (uint32_t i = 0; i < numEmptyRuns; i++)
+		{
+			scheduler.Run(tileSize, tileSize, tileSize, TileScheduler::TileOrder::Hilbert, [](const TileScheduler::Tile&, uint32_t) {});
+		}
+		const double wakeUs = wakeTimer.ElapsedMs() * 1000.0 / numEmptyRuns;
+		scheduler.DeInit();
+
+		if (numMismatches > 0)
+		{
+			printf("  %u schedules on %u threads traced different hits!\n", numMismatches, numThreads);
+		}
+		printf("  (one-tile run: %.1fus)\n", wakeUs);
+	}
+}
+
+void TileSchedulerBenchmark()
+{
+	SceneBuffers buffers;
+	buffers.Init(64 * 1024, 128 * 1024, 1);
+	if (LoadTestObj("../Models/stanford-bunny.obj", buffers))
+	{
+		const GeoTypes::Vertex3D* vts = reinterpret_cast<const GeoTypes::Vertex3D*>(&buffers.BufferContents(SceneBuffers::VBUFFER)[0]);
+		const IndexedTriangle* tris = reinterpret_cast<const IndexedTriangle*>(&buffers.BufferContents(SceneBuffers::TRIBUFFER)[0]);
+		const uint32_t numTris = static_cast<uint32_t>(buffers.NumTris());
+		BVH::BinnedSAHSettings settings;
+		settings.leafTris = 8;
+		settings.maxLeafTris = 16;
+		BVH bvh;
+		bvh.BuildBinnedSAH(&vts[0].pos, buffers.NumVerts(), sizeof(GeoTypes::Vertex3D), tris, numTris, settings);
+		PacketBVH packetBVH;
+		packetBVH.Build(bvh, &vts[0].pos, buffers.NumVerts(), sizeof(GeoTypes::Vertex3D), tris);
+		const ComputeBVH_Node root = bvh.Nodes()[0];
+		bvh.DeInit();
+
+		const float center[3] = { 0.5f * (root.boundsMin.x + root.boundsMax.x), 0.5f * (root.boundsMin.y + root.boundsMax.y), 0.5f * (root.boundsMin.z + root.boundsMax.z) };
+		const float extent[3] = { root.boundsMax.x - root.boundsMin.x, root.boundsMax.y - root.boundsMin.y, root.boundsMax.z - root.boundsMin.z };
+		const float radius = 0.5f * std::sqrt(extent[0] * extent[0] + extent[1] * extent[1] + extent[2] * extent[2]);
+
+		// The mesh fills the middle of the frame, so bands/tiles through it are the expensive ones
+		TileBenchScene scene = { &packetBVH, { center[0], center[1], center[2] - 3.0f * radius }, { 0.3f, 0.8f, -0.5f }, 384, 4 };
+		BenchmarkScaling(scene);
+		packetBVH.DeInit();
+	}
+	else
+	{
+		printf("couldn't open ../Models/stanford-bunny.obj\n");
+	}
+	buffers.DeInit();
+}
@@ -0,0 +1,133 @@
+#include "Benchmarks.h"
+#include "../TestScenes.h"
+#include "../../SandboxApp/TwoLevelAS.h"
+#include "../../SandboxApp/Intersection.h"
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <vector>
+
+// Bunny instances on a jittered grid, each spinning about its own axis at its own rate
+static void PlaceInstances(uint32_t numInstances, uint32_t frame, float spacing, std::vector<transform>& outXforms)
+{
+	const uint32_t side = static_cast<uint32_t>(std::ceil(std::cbrt(static_cast<float>(numInstances))));
+	std::mt19937 rng(numInstances);
+	std::uniform_real_distribution<float> unit(0.0f, 1.0f), signedUnit(-1.0f, 1.0f);
+	outXforms.resize(numInstances);
+	for (uint32_t i = 0; i < numInstances; i++)
+	{
+		const uint32_t x = i % side, y = (i / side) % side, z = i / (side * side);
+		Vec3 axis = { signedUnit(rng), signedUnit(rng), signedUnit(rng) };
+		axis = Scale3(axis, 1.0f / std::sqrt(std::max(Dot3(axis, axis), 1e-6f)));
+		const float halfAngle = (unit(rng) * 6.2831853f + frame * 0.05f * (0.5f + unit(rng))) * 0.5f;
+
+		transform& xform = outXforms[i];
+		xform.translationAndScale = float4((x + signedUnit(rng) * 0.25f) * spacing, (y + signedUnit(rng) * 0.25f) * spacing, (z + signedUnit(rng) * 0.25f) * spacing,
+										   0.5f + unit(rng));
+		xform.rotation = float4(axis.x * std::sin(halfAngle), axis.y * std::sin(halfAngle), axis.z * std::sin(halfAngle), std::cos(halfAngle));
+	}
+}
+
+// Per-frame TLAS rebuilds over thousands of bunny instances, memory against flattening every instance into one world-space BVH, and
+// closest-hit throughput through both levels
+void TwoLevelASBenchmark()
+{
+	SceneBuffers buffers;
+	buffers.Init(64 * 1024, 128 * 1024, 1);
+	if (!LoadTestObj("../Models/stanford-bunny.obj", buffers))
+	{
+		printf("couldn't open ../Models/stanford-bunny.obj\n");
+		buffers.DeInit();
+		return;
+	}
+
+	const GeoTypes::Vertex3D* vts = reinterpret_cast<const GeoTypes::Vertex3D*>(&buffers.BufferContents(SceneBuffers::VBUFFER)[0]);
+	const IndexedTriangle* tris = reinterpret_cast<const IndexedTriangle*>(&buffers.BufferContents(SceneBuffers::TRIBUFFER)[0]);
+	const uint64_t numVerts = buffers.NumVerts();
+	const uint32_t numTris = static_cast<uint32_t>(buffers.NumTris());
+
+	float4 meshMin = float4(INFINITY, INFINITY, INFINITY, 0.0f), meshMax = float4(-INFINITY, -INFINITY, -INFINITY, 0.0f);
+	for (uint64_t i = 0; i < numVerts; i++)
+	{
+		meshMin = float4(std::min(meshMin.x, vts[i].pos.x), std::min(meshMin.y, vts[i].pos.y), std::min(meshMin.z, vts[i].pos.z), 0.0f);
+		meshMax = float4(std::max(meshMax.x, vts[i].pos.x), std::max(meshMax.y, vts[i].pos.y), std::max(meshMax.z, vts[i].pos.z), 0.0f);
+	}
+	const float spacing = std::max({ meshMax.x - meshMin.x, meshMax.y - meshMin.y, meshMax.z - meshMin.z }) * 1.5f;
+
+	const uint32_t instanceCounts[] = { 100, 1000, 4000, 16000 };
+	constexpr uint32_t numFrames = 32;
+	for (uint32_t numInstances : instanceCounts)
+	{
+		TwoLevelAS as;
+		as.Init(numInstances);
+		BenchTimer timer;
+		as.AddMesh(&vts[0].pos, numVerts, sizeof(GeoTypes::Vertex3D), tris, numTris, BVH::BinnedSAHSettings());
+		const double blasMs = timer.ElapsedMs();
+
+		// One TLAS rebuild per animated frame (transforms are placed outside the timed region)
+		std::vector<uint32_t> instanceMeshes(numInstances, 0);
+		std::vector<transform> xforms;
+		double tlasMs = 0.0, maxTLASMs = 0.0;
+		for (uint32_t frame = 0; frame < numFrames; frame++)
+		{
+			PlaceInstances(numInstances, frame, spacing, xforms);
+			timer.Reset();
+			as.SetInstances(xforms.data(), instanceMeshes.data(), numInstances);
+			const double frameMs = timer.ElapsedMs();
+			tlasMs += frameMs;
+			maxTLASMs = std::max(maxTLASMs, frameMs);
+		}
+
+		// Flattening copies every instance's vertices/indices into world space, and builds nodes over all of them; node + triangle list
+		// bytes scale with triangle counts, so the BLAS's per-triangle costs stand in for a flattened build's
+		const TwoLevelAS::Stats stats = as.GetStats();
+		const BVH::Stats& blasStats = as.BLAS(0).GetStats();
+		const double meshBytes = static_cast<double>(numVerts) * sizeof(float4) + static_cast<double>(numTris) * sizeof(IndexedTriangle);
+		const double instancedMB = (stats.blasBytes + stats.tlasBytes + stats.instanceBytes + meshBytes) / (1024.0 * 1024.0);
+		const double flattenedMB = numInstances * (blasStats.nodeBytes + blasStats.triListBytes + meshBytes) / (1024.0 * 1024.0);
+		printf("%u instances (%.1fM instanced tris): BLAS built once in %.3fms; TLAS rebuilds %.3fms mean, %.3fms worst, SAH cost %.2f, %u nodes\n", numInstances,
+			   stats.numInstancedTris / 1000000.0, blasMs, tlasMs / numFrames, maxTLASMs, as.TLAS().GetStats().sahCost, as.TLAS().NumNodes());
+		printf("    memory: %.2fMB two-level (%.3f bytes per instanced tri), ~%.1fMB flattened (%.1f bytes per tri)\n", instancedMB,
+			   instancedMB * 1024.0 * 1024.0 / stats.numInstancedTris, flattenedMB, flattenedMB * 1024.0 * 1024.0 / stats.numInstancedTris);
+
+		// Rays from outside the grid toward random points inside it
+		std::mt19937 rng(1234);
+		std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+		const uint32_t side = static_cast<uint32_t>(std::ceil(std::cbrt(static_cast<float>(numInstances))));
+		const float gridExtent = side * spacing;
+		constexpr uint32_t numRays = 64 * 1024;
+		std::vector<TwoLevelAS::Ray> rays(numRays);
+		for (TwoLevelAS::Ray& ray : rays)
+		{
+			ray.origin = float4((unit(rng) * 2.0f - 0.5f) * gridExtent, (unit(rng) * 2.0f - 0.5f) * gridExtent, -gridExtent, 0.0f);
+			const float4 target = float4(unit(rng) * gridExtent, unit(rng) * gridExtent, unit(rng) * gridExtent, 0.0f);
+			ray.dir = float4(target.x - ray.origin.x, target.y - ray.origin.y, target.z - ray.origin.z, 0.0f);
+			ray.tMin = 0.0f;
+			ray.tMax = INFINITY;
+		}
+
+		timer.Reset();
+		uint32_t numHits = 0;
+		for (const TwoLevelAS::Ray& ray : rays)
+		{
+			TwoLevelAS::Hit hit;
+			numHits += as.ClosestHit(ray, &hit) ? 1 : 0;
+		}
+		const double closestMs = timer.ElapsedMs();
+
+		timer.Reset();
+		uint32_t numOccluded = 0;
+		for (const TwoLevelAS::Ray& ray : rays)
+		{
+			numOccluded += as.AnyHit(ray) ? 1 : 0;
+		}
+		const double anyMs = timer.ElapsedMs();
+		printf("    closest-hit: %.2fM rays/sec (%u of %u hit); any-hit: %.2fM rays/sec (%u occluded)\n", (numRays / 1000000.0) / (closestMs / 1000.0), numHits, numRays,
+			   (numRays / 1000000.0) / (anyMs / 1000.0), numOccluded);
+
+		as.DeInit();
+	}
+
+	buffers.DeInit();
+}
@@ -0,0 +1,433 @@
+#include "Benchmarks.h"
+#include "../TestScenes.h"
+#include "../../SandboxApp/WideBVH.h"
+#include "../../SandboxApp/Intersection.h"
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <random>
+#include <vector>
+
+// Ordered closest-hit through the binary tree (as the compute shader/TwoLevelAS walk it), for comparison
+static bool BinaryClosestHit(const BVH& bvh, const float4* positions, uint64_t strideBytes, const IndexedTriangle* tris, const WideBVH::Ray& ray, float* outT)
+{
+	const ComputeBVH_Node* nodes = &bvh.Nodes()[0];
+	const uint32_t* triList = &bvh.TriList()[0];
+	const uint8_t* positionBytes = reinterpret_cast<const uint8_t*>(positions);
+	const RayPrecomp rp = PrecomputeRay(ray.origin, ray.dir);
+	float tMax = ray.tMax, entry;
+	bool found = false;
+	if (!RayBox(&nodes[0].boundsMin.x, &nodes[0].boundsMax.x, rp, ray.tMin, tMax, &entry))
+	{
+		return false;
+	}
+
+	uint32_t stackNodes[AS_BVH_MAX_DEPTH];
+	float stackEntries[AS_BVH_MAX_DEPTH];
+	uint32_t stackSize = 0;
+	uint32_t nodeNdx = 0;
+	while (true)
+	{
+		const ComputeBVH_Node& node = nodes[nodeNdx];
+		if (node.triCount > 0)
+		{
+			for (uint32_t i = node.rightOrFirstTri; i < node.rightOrFirstTri + node.triCount; i++)
+			{
+				const uint4& ndx = tris[triList[i]].xyz;
+				float t, u, v;
+				if (RayTriangle(rp, *reinterpret_cast<const float4*>(positionBytes + ndx.x * strideBytes), *reinterpret_cast<const float4*>(positionBytes + ndx.y * strideBytes),
+								*reinterpret_cast<const float4*>(positionBytes + ndx.z * strideBytes), ray.tMin, tMax, &t, &u, &v) && (!found || t < tMax))
+				{
+					tMax = t;
+					found = true;
+				}
+			}
+		}
+		else
+		{
+			const uint32_t left = nodeNdx + 1, right = node.rightOrFirstTri;
+			float leftEntry, rightEntry;
+			const bool hitLeft = RayBox(&nodes[left].boundsMin.x, &nodes[left].boundsMax.x, rp, ray.tMin, tMax, &leftEntry);
+			const bool hitRight = RayBox(&nodes[right].boundsMin.x, &nodes[right].boundsMax.x, rp, ray.tMin, tMax, &rightEntry);
+			if (hitLeft && hitRight)
+			{
+				const bool leftFirst = leftEntry <= rightEntry;
+				stackNodes[stackSize] = leftFirst ? right : left;
+				stackEntries[stackSize] = leftFirst ? rightEntry : leftEntry;
+				stackSize++;
+				nodeNdx = leftFirst ? left : right;
+				continue;
+			}
+			else if (hitLeft || hitRight)
+			{
+				nodeNdx = hitLeft ? left : right;
+				continue;
+			}
+		}
+
+		bool pending = false;
+		while (stackSize > 0 && !pending)
+		{
+			stackSize--;
+			pending = (stackEntries[stackSize] <= tMax);
+			nodeNdx = stackNodes[stackSize];
+		}
+
+		if (!pending)
+		{
+			*outT = tMax;
+			return found;
+		}
+	}
+}
+
+// Converts a binned SAH tree over [tris] and compares memory + closest-hit throughput for [rays] on both
+static void CompareWidths(const char* label, const float4* positions, uint64_t numVerts, uint64_t strideBytes, const IndexedTriangle* tris, uint32_t numTris,
+						  const std::vector<WideBVH::Ray>& rays)
+{
+	BVH bvh;
+	bvh.BuildBinnedSAH(positions, numVerts, strideBytes, tris, numTris, BVH::BinnedSAHSettings());
+
+	WideBVH wide;
+	BenchTimer timer;
+	wide.Build(bvh, positions, numVerts, strideBytes, tris);
+	const double convertMs = timer.ElapsedMs();
+
+	const BVH::Stats& binaryStats = bvh.GetStats();
+	const WideBVH::Stats& wideStats = wide.GetStats();
+	printf("%s (%u tris), converted in %.3fms\n", label, numTris, convertMs);
+	printf("    binary: %u nodes, depth %u, %.2f bytes per tri (%.2f nodes + %.2f triangle list)\n", bvh.NumNodes(), binaryStats.depth,
+		   static_cast<double>(binaryStats.nodeBytes + binaryStats.triListBytes) / numTris, static_cast<double>(binaryStats.nodeBytes) / numTris,
+		   static_cast<double>(binaryStats.triListBytes) / numTris);
+	printf("    8-wide: %u nodes, depth %u, %.2f children per node, %.2f bytes per tri (%.2f nodes + %.2f triangle list)\n", wideStats.numNodes, wideStats.depth,
+		   wideStats.meanChildren, static_cast<double>(wideStats.nodeBytes + wideStats.triListBytes) / numTris, static_cast<double>(wideStats.nodeBytes) / numTris,
+		   static_cast<double>(wideStats.triListBytes) / numTris);
+
+	timer.Reset();
+	uint32_t binaryHits = 0;
+	for (const WideBVH::Ray& ray : rays)
+	{
+		float t;
+		binaryHits += BinaryClosestHit(bvh, positions, strideBytes, tris, ray, &t) ? 1 : 0;
+	}
+	const double binaryMs = timer.ElapsedMs();
+
+	timer.Reset();
+	uint32_t wideHits = 0;
+	for (const WideBVH::Ray& ray : rays)
+	{
+		WideBVH::Hit hit;
+		wideHits += wide.ClosestHit(ray, &hit) ? 1 : 0;
+	}
+	const double wideMs = timer.ElapsedMs();
+
+	timer.Reset();
+	uint32_t numOccluded = 0;
+	for (const WideBVH::Ray& ray : rays)
+	{
+		numOccluded += wide.AnyHit(ray) ? 1 : 0;
+	}
+	const double anyMs = timer.ElapsedMs();
+
+	const double numRays = static_cast<double>(rays.size());
+	printf("    closest-hit: binary %.2fM rays/sec, 8-wide %.2fM rays/sec (%.2fx; %u/%u hits); 8-wide any-hit %.2fM rays/sec (%u occluded)\n",
+		   (numRays / 1000000.0) / (binaryMs / 1000.0), (numRays / 1000000.0) / (wideMs / 1000.0), binaryMs / wideMs, binaryHits, wideHits,
+		   (numRays / 1000000.0) / (anyMs / 1000.0), numOccluded);
+
+	wide.DeInit();
+	bvh.DeInit();
+}
+
+// Rays from outside [boundsMin, boundsMax] towards random points inside it
+static std::vector<WideBVH::Ray> RaysInto(const float* boundsMin, const float* boundsMax, uint32_t numRays)
+{
+	std::mt19937 rng(1234);
+	std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+	const float extent = std::max({ boundsMax[0] - boundsMin[0], boundsMax[1] - boundsMin[1], boundsMax[2] - boundsMin[2] });
+	auto pointIn = [&](float margin)
+	{
+		return float4(boundsMin[0] - margin + unit(rng) * (boundsMax[0] - boundsMin[0] + 2.0f * margin),
+					  boundsMin[1] - margin + unit(rng) * (boundsMax[1] - boundsMin[1] + 2.0f * margin),
+					  boundsMin[2] - margin + unit(rng) * (boundsMax[2] - boundsMin[2] + 2.0f * margin), 0.0f);
+	};
+
+	std::vector<WideBVH::Ray> rays(numRays);
+	for (WideBVH::Ray& ray : rays)
+	{
+		ray.origin = pointIn(extent);
+		const float4 target = pointIn(0.0f);
+		ray.dir = float4(target.x - ray.origin.x, target.y - ray.origin.y, target.z - ray.origin.z, 0.0f);
+		ray.tMin = 0.0f;
+		ray.tMax = INFINITY;
+	}
+	return rays;
+}
+
+// Set-associative LRU cache, standing in for hardware counters where they aren't exposed (also models TLBs, with page-sized lines)
+struct CacheModel
+{
+	uint32_t lineBytes, numSets, numWays;
+	std::vector<uint64_t> lines, lastUsed;
+	uint64_t clock = 0, misses = 0;
+
+	CacheModel(uint32_t sizeBytes, uint32_t _lineBytes, uint32_t ways) : lineBytes(_lineBytes), numSets(sizeBytes / (_lineBytes * ways)), numWays(ways),
+		lines(numSets * ways, UINT64_MAX), lastUsed(numSets * ways, 0) {}
+
+	// Returns whether [address]'s line missed
+	bool Access(uint64_t address)
+	{
+		const uint64_t line = address / lineBytes;
+		const uint32_t set = static_cast<uint32_t>(line % numSets);
+		uint32_t victim = 0;
+		clock++;
+		for (uint32_t w = 0; w < numWays; w++)
+		{
+			const uint32_t slot = set * numWays + w;
+			if (lines[slot] == line)
+			{
+				lastUsed[slot] = clock;
+				return false;
+			}
+			victim = (lastUsed[slot] < lastUsed[set * numWays + victim]) ? w : victim;
+		}
+		lines[set * numWays + victim] = line;
+		lastUsed[set * numWays + victim] = clock;
+		misses++;
+		return true;
+	}
+};
+
+// Pinhole camera rays in raster order (so neighbouring queries are coherent, as in a frame), from in front of + above [boundsMin,
+// boundsMax] towards its center; [jitter] offsets every pixel by the same fraction
+static std::vector<WideBVH::Ray> CameraRays(const float* boundsMin, const float* boundsMax, uint32_t resolution, float jitter)
+{
+	const float center[3] = { (boundsMin[0] + boundsMax[0]) * 0.5f, (boundsMin[1] + boundsMax[1]) * 0.5f, (boundsMin[2] + boundsMax[2]) * 0.5f };
+	const float extent = std::max({ boundsMax[0] - boundsMin[0], boundsMax[1] - boundsMin[1], boundsMax[2] - boundsMin[2] });
+	const float4 eye = float4(center[0] + extent * 0.3f, center[1] + extent * 0.6f, center[2] - extent * 1.2f, 0.0f);
+
+	// Orthonormal basis looking at the center, with y up
+	float forward[3] = { center[0] - eye.x, center[1] - eye.y, center[2] - eye.z };
+	const float forwardLen = std::sqrt(forward[0] * forward[0] + forward[1] * forward[1] + forward[2] * forward[2]);
+	for (float& f : forward)
+	{
+		f /= forwardLen;
+	}
+	float right[3] = { forward[2], 0.0f, -forward[0] };
+	const float rightLen = std::sqrt(right[0] * right[0] + right[2] * right[2]);
+	right[0] /= rightLen;
+	right[2] /= rightLen;
+	const float up[3] = { forward[1] * right[2] - forward[2] * right[1], forward[2] * right[0] - forward[0] * right[2], forward[0] * right[1] - forward[1] * right[0] };
+
+	std::vector<WideBVH::Ray> rays(static_cast<size_t>(resolution) * resolution);
+	for (uint32_t y = 0; y < resolution; y++)
+	{
+		for (uint32_t x = 0; x < resolution; x++)
+		{
+			const float u = ((x + jitter) / resolution - 0.5f) * 0.9f, v = (0.5f - (y + jitter) / resolution) * 0.9f;
+			WideBVH::Ray& ray = rays[static_cast<size_t>(y) * resolution + x];
+			ray.origin = eye;
+			ray.dir = float4(forward[0] + u * right[0] + v * up[0], forward[1] + u * right[1] + v * up[1], forward[2] + u * right[2] + v * up[2], 0.0f);
+			ray.tMin = 0.0f;
+			ray.tMax = INFINITY;
+		}
+	}
+	return rays;
+}
+
+// Relays [wide] out each way, comparing closest-hit throughput on coherent (camera) and incoherent rays, plus cache misses: hardware
+// counts where they're available, and always misses per ray in a modelled 32KB L1, 1MB L2 and 64-entry TLB (over the first
+// [maxModelledRays] rays, evenly spaced through each set), from the nodes, triangle list, triangle indices and vertices the queries touch
+static void CompareLayouts(const char* label, WideBVH& wide, uint64_t strideBytes, const IndexedTriangle* tris,
+						   const std::vector<WideBVH::Ray>& cameraRays, const std::vector<WideBVH::Ray>& sampleRays, const std::vector<WideBVH::Ray>& randomRays)
+{
+	struct Variant
+	{
+		const char* name;
+		WideBVH::Layout layout;
+		bool reorderTris;
+	};
+	const Variant variants[] = { { "breadth-first", WideBVH::Layout::BreadthFirst, true }, { "depth-first, triangles unordered", WideBVH::Layout::DepthFirst, false },
+								 { "depth-first", WideBVH::Layout::DepthFirst, true }, { "treelets", WideBVH::Layout::Treelets, true },
+								 { "hit frequency", WideBVH::Layout::HitFrequency, true } };
+
+	constexpr uint32_t maxModelledRays = 64 * 1024;
+	BenchCacheMisses hardwareMisses;
+	printf("%s layouts (%u nodes; %zu camera rays, hit frequencies from %zu jittered ones)\n", label, wide.NumNodes(), cameraRays.size(), sampleRays.size());
+	if (!hardwareMisses.available)
+	{
+		printf("    (no hardware cache counters here; modelled misses only)\n");
+	}
+
+	std::vector<uint32_t> logNodes(wide.NumNodes()), logTris(wide.TriListLen());
+	for (const Variant& variant : variants)
+	{
+		WideBVH::LayoutSettings settings;
+		settings.layout = variant.layout;
+		settings.reorderTris = variant.reorderTris;
+		settings.sampleRays = sampleRays.data();
+		settings.numSampleRays = static_cast<uint32_t>(sampleRays.size());
+		BenchTimer timer;
+		wide.Relayout(settings);
+		const double layoutMs = timer.ElapsedMs();
+
+		double rates[2], hardwareCounts[2];
+		const std::vector<WideBVH::Ray>* rayLists[2] = { &cameraRays, &randomRays };
+		for (uint32_t l = 0; l < 2; l++)
+		{
+			uint32_t numHits = 0;
+			timer.Reset();
+			hardwareMisses.Reset();
+			for (const WideBVH::Ray& ray : *rayLists[l])
+			{
+				WideBVH::Hit hit;
+				numHits += wide.ClosestHit(ray, &hit) ? 1 : 0;
+			}
+			hardwareCounts[l] = static_cast<double>(hardwareMisses.Count()) / rayLists[l]->size();
+			rates[l] = (rayLists[l]->size() / 1000000.0) / (timer.ElapsedMs() / 1000.0);
+		}
+
+		// Addresses of each structure in its own region; vertices are shared by every layout, but reordering triangles changes the order
+		// they're fetched in
+		double modelled[2][3];
+		for (uint32_t l = 0; l < 2; l++)
+		{
+			CacheModel l1(32 * 1024, 64, 8), l2(1024 * 1024, 64, 16), tlb(64 * 4096, 4096, 4);
+			auto access = [&](uint64_t address, uint32_t bytes)
+			{
+				for (uint64_t line = address / 64; line <= (address + bytes - 1) / 64; line++)
+				{
+					tlb.Access(line * 64);
+					if (l1.Access(line * 64))
+					{
+						l2.Access(line * 64);
+					}
+				}
+			};
+
+			constexpr uint64_t nodeRegion = 1ull << 40, triListRegion = 2ull << 40, triRegion = 3ull << 40, vertexRegion = 4ull << 40;
+			const uint32_t numModelled = std::min(static_cast<uint32_t>(rayLists[l]->size()), maxModelledRays);
+			const uint32_t modelStride = static_cast<uint32_t>(rayLists[l]->size()) / numModelled;
+			for (uint32_t r = 0; r < numModelled; r++)
+			{
+				WideBVH::TraceLog log = { logNodes.data(), logTris.data(), static_cast<uint32_t>(logNodes.size()), 0, 0 };
+				WideBVH::Hit hit;
+				wide.ClosestHit((*rayLists[l])[r * modelStride], &hit, &log);
+				uint32_t nextTri = 0;
+				for (uint32_t n = 0; n < log.numNodes; n++)
+				{
+					access(nodeRegion + logNodes[n] * sizeof(ComputeWideBVH_Node), sizeof(ComputeWideBVH_Node));
+
+					// Leaves are tested straight after their node is decoded; each node's leaves own a disjoint run of the triangle list
+					const ComputeWideBVH_Node& node = wide.Nodes()[logNodes[n]];
+					const uint8_t* meta = reinterpret_cast<const uint8_t*>(node.meta);
+					uint32_t nodeTris = 0;
+					for (uint32_t slot = 0; slot < WideBVH::width; slot++)
+					{
+						nodeTris += ((node.exponentsAndImask >> 24) & (1u << slot)) ? 0 : static_cast<uint32_t>(std::popcount(static_cast<uint32_t>(meta[slot] >> 5)));
+					}
+					while (nextTri < std::min(log.numTris, static_cast<uint32_t>(logTris.size())) && logTris[nextTri] >= node.triBase && logTris[nextTri] < node.triBase + nodeTris)
+					{
+						const uint32_t entry = logTris[nextTri++];
+						const uint32_t tri = wide.TriList()[entry];
+						access(triListRegion + entry * sizeof(uint32_t), sizeof(uint32_t));
+						access(variant.reorderTris ? (triRegion + entry * sizeof(IndexedTriangle)) : (triRegion + (1ull << 36) + tri * sizeof(IndexedTriangle)), sizeof(IndexedTriangle));
+						const uint32_t ndx[3] = { tris[tri].xyz.x, tris[tri].xyz.y, tris[tri].xyz.z };
+						for (uint32_t k : ndx)
+						{
+							access(vertexRegion + k * strideBytes, sizeof(float4));
+						}
+					}
+				}
+			}
+			modelled[l][0] = static_cast<double>(l1.misses) / numModelled;
+			modelled[l][1] = static_cast<double>(l2.misses) / numModelled;
+			modelled[l][2] = static_cast<double>(tlb.misses) / numModelled;
+		}
+
+		printf("    %s: laid out in %.3fms; %.2fM camera rays/sec, %.2fM random rays/sec; modelled L1/L2/TLB misses per ray %.2f/%.2f/%.2f camera, %.2f/%.2f/%.2f random",
+			   variant.name, layoutMs, rates[0], rates[1], modelled[0][0], modelled[0][1], modelled[0][2], modelled[1][0], modelled[1][1], modelled[1][2]);
+		if (hardwareMisses.available)
+		{
+			printf("; hardware misses per ray %.2f camera, %.2f random", hardwareCounts[0], hardwareCounts[1]);
+		}
+		printf("\n");
+	}
+}
+
+// Builds a binned SAH tree + its 8-wide conversion over a mesh bounded by [boundsMin, boundsMax], then compares layouts on a 512x512
+// camera (sampled at 128x128 for hit frequencies) and [numRandomRays] incoherent rays
+static void CompareMeshLayouts(const char* label, const float4* positions, uint64_t numVerts, uint64_t strideBytes, const IndexedTriangle* tris, uint32_t numTris,
+							   const float* boundsMin, const float* boundsMax, uint32_t numRandomRays)
+{
+	BVH bvh;
+	bvh.BuildBinnedSAH(positions, numVerts, strideBytes, tris, numTris, BVH::BinnedSAHSettings());
+	WideBVH wide;
+	wide.Build(bvh, positions, numVerts, strideBytes, tris);
+	CompareLayouts(label, wide, strideBytes, tris, CameraRays(boundsMin, boundsMax, 512, 0.5f), CameraRays(boundsMin, boundsMax, 128, 0.25f),
+				   RaysInto(boundsMin, boundsMax, numRandomRays));
+	wide.DeInit();
+	bvh.DeInit();
+}
+
+// Binary BVH against its 8-wide conversion on the Stanford bunny, then on a ~1M triangle heightfield; each is followed by wide-node
+// layout comparisons
+void WideBVHBenchmark()
+{
+	constexpr uint32_t numRays = 256 * 1024;
+
+	SceneBuffers buffers;
+	buffers.Init(64 * 1024, 128 * 1024, 1);
+	if (LoadTestObj("../Models/stanford-bunny.obj", buffers))
+	{
+		const GeoTypes::Vertex3D* vts = reinterpret_cast<const GeoTypes::Vertex3D*>(&buffers.BufferContents(SceneBuffers::VBUFFER)[0]);
+		const IndexedTriangle* tris = reinterpret_cast<const IndexedTriangle*>(&buffers.BufferContents(SceneBuffers::TRIBUFFER)[0]);
+		float meshMin[3] = { INFINITY, INFINITY, INFINITY }, meshMax[3] = { -INFINITY, -INFINITY, -INFINITY };
+		for (uint64_t i = 0; i < buffers.NumVerts(); i++)
+		{
+			const float p[3] = { vts[i].pos.x, vts[i].pos.y, vts[i].pos.z };
+			for (uint32_t a = 0; a < 3; a++)
+			{
+				meshMin[a] = std::min(meshMin[a], p[a]);
+				meshMax[a] = std::max(meshMax[a], p[a]);
+			}
+		}
+		CompareWidths("bunny", &vts[0].pos, buffers.NumVerts(), sizeof(GeoTypes::Vertex3D), tris, static_cast<uint32_t>(buffers.NumTris()), RaysInto(meshMin, meshMax, numRays));
+		CompareMeshLayouts("bunny", &vts[0].pos, buffers.NumVerts(), sizeof(GeoTypes::Vertex3D), tris, static_cast<uint32_t>(buffers.NumTris()), meshMin, meshMax, numRays);
+	}
+	else
+	{
+		printf("couldn't open ../Models/stanford-bunny.obj\n");
+	}
+	buffers.DeInit();
+
+	// Rolling heightfield, two triangles per grid quad (as in BVHBenchmark)
+	constexpr uint32_t gridQuads = 708;
+	constexpr uint32_t gridVerts = gridQuads + 1;
+	std::vector<float4> positions(static_cast<size_t>(gridVerts) * gridVerts);
+	for (uint32_t y = 0; y < gridVerts; y++)
+	{
+		for (uint32_t x = 0; x < gridVerts; x++)
+		{
+			const float fx = static_cast<float>(x) / gridQuads, fy = static_cast<float>(y) / gridQuads;
+			const float height = 0.08f * std::sin(fx * 7.0f) * std::cos(fy * 5.0f) + 0.01f * std::sin((fx + fy) * 31.0f);
+			positions[static_cast<size_t>(y) * gridVerts + x] = float4(fx, height, fy, 1.0f);
+		}
+	}
+
+	std::vector<IndexedTriangle> tris(static_cast<size_t>(gridQuads) * gridQuads * 2);
+	for (uint32_t y = 0; y < gridQuads; y++)
+	{
+		for (uint32_t x = 0; x < gridQuads; x++)
+		{
+			const uint32_t v00 = y * gridVerts + x, v10 = v00 + 1, v01 = v00 + gridVerts, v11 = v01 + 1;
+			IndexedTriangle* quad = &tris[(static_cast<size_t>(y) * gridQuads + x) * 2];
+			quad[0].xyz = uint4(v00, v10, v11, 0);
+			quad[1].xyz = uint4(v00, v11, v01, 0);
+		}
+	}
+
+	const float fieldMin[3] = { 0.0f, -0.1f, 0.0f }, fieldMax[3] = { 1.0f, 0.1f, 1.0f };
+	CompareWidths("heightfield", positions.data(), positions.size(), sizeof(float4), tris.data(), static_cast<uint32_t>(tris.size()), RaysInto(fieldMin, fieldMax, numRays));
+	CompareMeshLayouts("heightfield", positions.data(), positions.size(), sizeof(float4), tris.data(), static_cast<uint32_t>(tris.size()), fieldMin, fieldMax, numRays);
+}
@@ -0,0 +1,253 @@
+#include "Verification.h"
+#include "../../SandboxApp/ASReport.h"
+#include "../../SandboxApp/BVH.h"
+#include "../../SandboxApp/StacklessBVH.h"
+#include "../../SandboxApp/WideBVH.h"
+#include "../../SandboxApp/SparseOctree.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <random>
+#include <vector>
+
+struct ReportTestMesh
+{
+	std::vector<float4> positions;
+	std::vector<IndexedTriangle> tris;
+};
+
+static void AddReportTriangle(ReportTestMesh& mesh, float4 a, float4 b, float4 c)
+{
+	const uint32_t base = static_cast<uint32_t>(mesh.positions.size());
+	mesh.positions.push_back(a);
+	mesh.positions.push_back(b);
+	mesh.positions.push_back(c);
+	IndexedTriangle tri;
+	tri.xyz = uint4(base, base + 1, base + 2, 0);
+	mesh.tris.push_back(tri);
+}
+
+static ReportTestMesh ReportTriangleSoup(uint32_t numTris, float size, float triSize, std::mt19937& rng)
+{
+	std::uniform_real_distribution<float> centerDist(-size, size), offsetDist(-triSize, triSize);
+	ReportTestMesh mesh;
+	for (uint32_t i = 0; i < numTris; i++)
+	{
+		const float cx = centerDist(rng), cy = centerDist(rng), cz = centerDist(rng);
+		AddReportTriangle(mesh, float4(cx + offsetDist(rng), cy + offsetDist(rng), cz + offsetDist(rng), 0.0f),
+						  float4(cx + offsetDist(rng), cy + offsetDist(rng), cz + offsetDist(rng), 0.0f),
+						  float4(cx + offsetDist(rng), cy + offsetDist(rng), cz + offsetDist(rng), 0.0f));
+	}
+	return mesh;
+}
+
+static std::vector<ASReport::Ray> ReportRays(uint32_t numRays, float size, std::mt19937& rng)
+{
+	std::uniform_real_distribution<float> pointDist(-size, size);
+	std::vector<ASReport::Ray> rays(numRays);
+	for (ASReport::Ray& ray : rays)
+	{
+		ray.origin = float4(pointDist(rng) * 3.0f, pointDist(rng) * 3.0f, pointDist(rng) * 3.0f, 0.0f);
+		ray.dir = float4(pointDist(rng) - ray.origin.x, pointDist(rng) - ray.origin.y, pointDist(rng) - ray.origin.z, 0.0f);
+		ray.tMin = 0.0f;
+		ray.tMax = INFINITY;
+	}
+	return rays;
+}
+
+// Totals every histogram should agree with, whatever the structure
+static uint32_t VerifyReportConsistency(const ASReport::Report& report, const char* label)
+{
+	uint32_t numFailures = 0;
+	uint32_t interior = 0, leaves = 0, occupied = 0;
+	for (uint32_t d = 0; d < ASReport::maxDepthBins; d++)
+	{
+		interior += report.interiorPerDepth[d];
+		leaves += report.leavesPerDepth[d];
+		VERIFY(d <= report.depth || (report.interiorPerDepth[d] == 0 && report.leavesPerDepth[d] == 0), "%s (%s): nodes below the reported depth %u", label,
+			   report.structure, report.depth);
+	}
+	for (uint32_t i = 0; i < ASReport::leafOccupancyBins; i++)
+	{
+		occupied += report.leafOccupancy[i];
+	}
+	VERIFY(interior == report.numInterior && leaves == report.numLeaves && occupied == report.numLeaves, "%s (%s): histograms hold %u/%u/%u nodes, not %u/%u/%u", label,
+		   report.structure, interior, leaves, occupied, report.numInterior, report.numLeaves, report.numLeaves);
+	VERIFY(report.numTriRefs >= report.numTris, "%s (%s): %llu triangle references for %u triangles", label, report.structure,
+		   static_cast<unsigned long long>(report.numTriRefs), report.numTris);
+	VERIFY(report.emptySlotFraction >= 0.0f && report.emptySlotFraction < 1.0f, "%s (%s): empty slot fraction %f", label, report.structure, report.emptySlotFraction);
+	VERIFY(report.nodeBytes > 0 && report.triListBytes > 0, "%s (%s): no memory reported", label, report.structure);
+	return numFailures;
+}
+
+// Every structure over the same mesh: counts against each structure's own stats, and ray statistics against brute force (every
+// structure finds the same hits)
+static uint32_t VerifyStructures(const char* label, const ReportTestMesh& mesh, const std::vector<ASReport::Ray>& rays, bool computeEPO)
+{
+	uint32_t numFailures = 0;
+	const uint32_t numTris = static_cast<uint32_t>(mesh.tris.size());
+	ASReport::Settings settings;
+	settings.label = label;
+	settings.computeEPO = computeEPO;
+	settings.rays = rays.data();
+	settings.numRays = static_cast<uint32_t>(rays.size());
+
+	BVH bvh;
+	bvh.BuildBinnedSAH(mesh.positions.data(), mesh.positions.size(), sizeof(float4), mesh.tris.data(), numTris, BVH::BinnedSAHSettings());
+	ASReport::Report binary;
+	ASReport::Analyse(bvh, mesh.positions.data(), sizeof(float4), mesh.tris.data(), settings, &binary);
+	numFailures += VerifyReportConsistency(binary, label);
+	const BVH::Stats& stats = bvh.GetStats();
+	VERIFY(binary.numNodes == stats.numNodes && binary.numInterior + binary.numLeaves == stats.numNodes && binary.numLeaves == stats.numLeaves &&
+		   binary.depth == stats.depth && binary.maxLeafTris == stats.maxLeafTris, "%s: binary report counts don't match BVH::Stats", label);
+	VERIFY(std::fabs(binary.sahCost - stats.sahCost) <= 1e-3f * stats.sahCost, "%s: report SAH cost %f, BVH::Stats %f", label, binary.sahCost, stats.sahCost);
+	VERIFY(binary.emptySlotFraction == 0.0f && binary.emptyLeaves == 0, "%s: binary BVH with empty slots/leaves", label);
+
+	StacklessBVH stackless;
+	stackless.Build(bvh, mesh.positions.data(), mesh.positions.size(), sizeof(float4), mesh.tris.data());
+	ASReport::Report skip;
+	ASReport::Analyse(stackless, mesh.positions.data(), sizeof(float4), mesh.tris.data(), settings, &skip);
+	numFailures += VerifyReportConsistency(skip, label);
+	VERIFY(skip.numInterior == binary.numInterior && skip.numLeaves == binary.numLeaves && skip.sahCost == binary.sahCost &&
+		   memcmp(skip.leafOccupancy, binary.leafOccupancy, sizeof(skip.leafOccupancy)) == 0 && (!computeEPO || skip.epo == binary.epo),
+		   "%s: stackless report doesn't match the binary tree it encodes", label);
+	VERIFY(skip.numHits == binary.numHits && skip.trisPerRay >= binary.trisPerRay, "%s: stackless rays hit %u times (%.2f tests/ray), binary %u (%.2f)", label,
+		   skip.numHits, skip.trisPerRay, binary.numHits, binary.trisPerRay); // Skip links walk in a fixed order, so they can't cull more
+
+	WideBVH wide;
+	wide.Build(bvh, mesh.positions.data(), mesh.positions.size(), sizeof(float4), mesh.tris.data());
+	ASReport::Report wideReport;
+	ASReport::Analyse(wide, mesh.positions.data(), sizeof(float4), mesh.tris.data(), settings, &wideReport);
+	numFailures += VerifyReportConsistency(wideReport, label);
+	VERIFY(wideReport.numNodes == wide.GetStats().numNodes && wideReport.numInterior == wide.GetStats().numNodes && wideReport.numLeaves == wide.GetStats().numLeaves &&
+		   wideReport.depth == wide.GetStats().depth + 1, "%s: wide report counts don't match WideBVH::Stats", label);
+	VERIFY(wideReport.numTriRefs == numTris && wideReport.maxLeafTris <= WideBVH::maxLeafTris, "%s: wide report lists %llu triangles, up to %u per leaf", label,
+		   static_cast<unsigned long long>(wideReport.numTriRefs), wideReport.maxLeafTris);
+	VERIFY(wideReport.numHits == binary.numHits, "%s: wide rays hit %u times, binary %u", label, wideReport.numHits, binary.numHits);
+
+	SparseOctree octree;
+	octree.Build(mesh.positions.data(), mesh.positions.size(), sizeof(float4), mesh.tris.data(), numTris, SparseOctree::Settings());
+	ASReport::Report octreeReport;
+	ASReport::Analyse(octree, mesh.positions.data(), sizeof(float4), mesh.tris.data(), numTris, settings, &octreeReport);
+	numFailures += VerifyReportConsistency(octreeReport, label);
+	VERIFY(octreeReport.numNodes == octree.GetStats().numNodes && octreeReport.numLeaves == octree.GetStats().numLeaves &&
+		   octreeReport.depth == octree.GetStats().depth && octreeReport.numTriRefs == octree.GetStats().numTriRefs,
+		   "%s: octree report counts don't match SparseOctree::Stats", label);
+	VERIFY(octreeReport.numHits == binary.numHits, "%s: octree rays hit %u times, binary %u", label, octreeReport.numHits, binary.numHits);
+
+	printf("%s: SAH %.2f/%.2f/%.2f, EPO %.3f/%.3f/%.3f (binary/wide/octree), %.1f/%.1f/%.1f nodes per ray\n", label, binary.sahCost, wideReport.sahCost,
+		   octreeReport.sahCost, binary.epo, wideReport.epo, octreeReport.epo, binary.nodesPerRay, wideReport.nodesPerRay, octreeReport.nodesPerRay);
+
+	octree.DeInit();
+	wide.DeInit();
+	stackless.DeInit();
+	bvh.DeInit();
+	return numFailures;
+}
+
+// Counts braces/brackets outside strings; balanced and never negative for well-formed output
+static bool JSONBalanced(const char* text)
+{
+	int32_t depth = 0;
+	bool inString = false;
+	for (const char* c = text; *c != '\0'; c++)
+	{
+		if (*c == '"')
+		{
+			inString = !inString;
+		}
+		else if (!inString)
+		{
+			depth += (*c == '{' || *c == '[') ? 1 : 0;
+			depth -= (*c == '}' || *c == ']') ? 1 : 0;
+			if (depth < 0)
+			{
+				return false;
+			}
+		}
+	}
+	return depth == 0 && !inString;
+}
+
+bool ASReportVerification()
+{
+	uint32_t numFailures = 0;
+	std::mt19937 rng(4242);
+
+	const std::vector<ASReport::Ray> rays = ReportRays(2000, 10.0f, rng);
+	numFailures += VerifyStructures("small soup", ReportTriangleSoup(300, 10.0f, 0.5f, rng), rays, true);
+	numFailures += VerifyStructures("long triangles", ReportTriangleSoup(300, 10.0f, 4.0f, rng), rays, true);
+	numFailures += VerifyStructures("large soup", ReportTriangleSoup(20000, 10.0f, 0.3f, rng), rays, false);
+
+	// Separated triangles never reach into each other's boxes, so nothing overlaps; an identical copy of a triangle always does
+	{
+		ReportTestMesh mesh;
+		for (uint32_t i = 0; i < 16; i++)
+		{
+			const float x = static_cast<float>(i) * 4.0f;
+			AddReportTriangle(mesh, float4(x, 0.0f, 0.0f, 0.0f), float4(x + 1.0f, 0.0f, 0.0f, 0.0f), float4(x, 1.0f, 0.0f, 0.0f));
+		}
+
+		BVH::BinnedSAHSettings bvhSettings;
+		bvhSettings.leafTris = 1;
+		bvhSettings.maxLeafTris = 1;
+		BVH bvh;
+		bvh.BuildBinnedSAH(mesh.positions.data(), mesh.positions.size(), sizeof(float4), mesh.tris.data(), static_cast<uint32_t>(mesh.tris.size()), bvhSettings);
+		ASReport::Report report;
+		ASReport::Analyse(bvh, mesh.positions.data(), sizeof(float4), mesh.tris.data(), ASReport::Settings(), &report);
+		VERIFY(report.epo == 0.0f, "separated triangles: EPO %f, not zero", report.epo);
+		bvh.DeInit();
+
+		AddReportTriangle(mesh, mesh.positions[0], mesh.positions[1], mesh.positions[2]);
+		bvh.BuildBinnedSAH(mesh.positions.data(), mesh.positions.size(), sizeof(float4), mesh.tris.data(), static_cast<uint32_t>(mesh.tris.size()), bvhSettings);
+		ASReport::Analyse(bvh, mesh.positions.data(), sizeof(float4), mesh.tris.data(), ASReport::Settings(), &report);
+		VERIFY(report.epo > 0.0f, "duplicated triangle: EPO %f, not positive", report.epo);
+		bvh.DeInit();
+	}
+
+	// Empty structures report a lone empty leaf
+	{
+		ReportTestMesh mesh;
+		mesh.positions.push_back(float4(0.0f, 0.0f, 0.0f, 0.0f));
+		BVH bvh;
+		bvh.BuildBinnedSAH(mesh.positions.data(), mesh.positions.size(), sizeof(float4), nullptr, 0, BVH::BinnedSAHSettings());
+		ASReport::Settings settings;
+		settings.rays = rays.data();
+		settings.numRays = 16;
+		ASReport::Report report;
+		ASReport::Analyse(bvh, mesh.positions.data(), sizeof(float4), nullptr, settings, &report);
+		VERIFY(report.numLeaves == 1 && report.emptyLeaves == 1 && report.numInterior == 0 && report.numHits == 0 && report.epo < 0.0f,
+			   "empty BVH: %u leaves (%u empty), %u interior nodes, %u hits", report.numLeaves, report.emptyLeaves, report.numInterior, report.numHits);
+		bvh.DeInit();
+	}
+
+	// JSON output is one balanced object, with skipped EPO written as null
+	{
+		ReportTestMesh mesh = ReportTriangleSoup(200, 10.0f, 0.5f, rng);
+		BVH bvh;
+		bvh.BuildBinnedSAH(mesh.positions.data(), mesh.positions.size(), sizeof(float4), mesh.tris.data(), static_cast<uint32_t>(mesh.tris.size()), BVH::BinnedSAHSettings());
+		ASReport::Settings settings;
+		settings.label = "json";
+		settings.computeEPO = false;
+		ASReport::Report report;
+		ASReport::Analyse(bvh, mesh.positions.data(), sizeof(float4), mesh.tris.data(), settings, &report);
+
+		char text[8192] = {};
+		FILE* file = tmpfile();
+		if (file != nullptr)
+		{
+			ASReport::WriteJSON(report, file, 1);
+			rewind(file);
+			const size_t len = fread(text, 1, sizeof(text) - 1, file);
+			fclose(file);
+			text[len] = '\0';
+			VERIFY(len > 0 && JSONBalanced(text), "JSON output isn't balanced:\n%s", text);
+			VERIFY(strstr(text, "\"epo\": null") != nullptr && strstr(text, "\"label\": \"json\"") != nullptr, "JSON output is missing fields:\n%s", text);
+		}
+		bvh.DeInit();
+	}
+
+	printf("asreport: %u failures\n", numFailures);
+	return numFailures == 0;
+}
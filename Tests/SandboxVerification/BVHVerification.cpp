@@ -0,0 +1,558 @@
+#include "Verification.h"
+#include "../TestScenes.h"
+#include "../../SandboxApp/BVH.h"
+#include "../../SandboxApp/Intersection.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <random>
+#include <vector>
+
+struct BVHTestMesh
+{
+	std::vector<float4> positions;
+	std::vector<IndexedTriangle> tris;
+};
+
+static void AddTriangle(BVHTestMesh& mesh, float4 v0, float4 v1, float4 v2)
+{
+	const uint32_t base = static_cast<uint32_t>(mesh.positions.size());
+	mesh.positions.push_back(v0);
+	mesh.positions.push_back(v1);
+	mesh.positions.push_back(v2);
+
+	IndexedTriangle tri;
+	tri.xyz = uint4(base, base + 1, base + 2, 0);
+	mesh.tris.push_back(tri);
+}
+
+static bool SameBounds(const ComputeBVH_Node& node, const float* bmin, const float* bmax)
+{
+	return node.boundsMin.x == bmin[0] && node.boundsMin.y == bmin[1] && node.boundsMin.z == bmin[2] &&
+		   node.boundsMax.x == bmax[0] && node.boundsMax.y == bmax[1] && node.boundsMax.z == bmax[2];
+}
+
+// Closest hit through the BVH, walked the same way as ComputeShader.hlsl (left children first, right children on a fixed-size stack)
+static float BVHClosestHit(const BVH& bvh, const BVHTestMesh& mesh, const RayPrecomp& rp, uint32_t* outNodesVisited)
+{
+	const ComputeBVH_Node* nodes = &bvh.Nodes()[0];
+	const uint32_t* triList = &bvh.TriList()[0];
+
+	float tMax = INFINITY;
+	uint32_t stack[AS_BVH_MAX_DEPTH];
+	uint32_t stackSize = 0, nodeNdx = 0;
+	*outNodesVisited = 0;
+	while (true)
+	{
+		const ComputeBVH_Node& node = nodes[nodeNdx];
+		(*outNodesVisited)++;
+
+		const float bmin[3] = { node.boundsMin.x, node.boundsMin.y, node.boundsMin.z };
+		const float bmax[3] = { node.boundsMax.x, node.boundsMax.y, node.boundsMax.z };
+		float entry;
+		if (RayBox(bmin, bmax, rp, 0.0f, tMax, &entry))
+		{
+			if (node.triCount == 0)
+			{
+				if (stackSize >= AS_BVH_MAX_DEPTH)
+				{
+					return -1.0f; // Overflowed the shader's stack
+				}
+				stack[stackSize++] = node.rightOrFirstTri;
+				nodeNdx++;
+				continue;
+			}
+
+			for (uint32_t i = 0; i < node.triCount; i++)
+			{
+				const IndexedTriangle& tri = mesh.tris[triList[node.rightOrFirstTri + i]];
+				float t, u, v;
+				if (RayTriangle(rp, mesh.positions[tri.xyz.x], mesh.positions[tri.xyz.y], mesh.positions[tri.xyz.z], 0.0f, tMax, &t, &u, &v))
+				{
+					tMax = t;
+				}
+			}
+		}
+
+		if (stackSize == 0)
+		{
+			break;
+		}
+		nodeNdx = stack[--stackSize];
+	}
+
+	return tMax;
+}
+
+static void BuildBVH(BVH& bvh, const BVHTestMesh& mesh, const BVH::BinnedSAHSettings& settings)
+{
+	bvh.BuildBinnedSAH(mesh.positions.data(), mesh.positions.size(), sizeof(float4), mesh.tris.data(), static_cast<uint32_t>(mesh.tris.size()), settings);
+}
+
+static void BuildBVH(BVH& bvh, const BVHTestMesh& mesh, const BVH::LBVHSettings& settings)
+{
+	bvh.BuildLBVH(mesh.positions.data(), mesh.positions.size(), sizeof(float4), mesh.tris.data(), static_cast<uint32_t>(mesh.tris.size()), settings);
+}
+
+static void DescribeSettings(const BVH::BinnedSAHSettings& settings, char* out, size_t outSize)
+{
+	if (settings.spatialSplits)
+	{
+		snprintf(out, outSize, "binned SAH + spatial splits (%.0f%% budget), leaves %u-%u tris", settings.splitBudget * 100.0f, settings.leafTris, settings.maxLeafTris);
+		return;
+	}
+	snprintf(out, outSize, "binned SAH, leaves %u-%u tris", settings.leafTris, settings.maxLeafTris);
+}
+
+static void DescribeSettings(const BVH::LBVHSettings& settings, char* out, size_t outSize)
+{
+	snprintf(out, outSize, "LBVH, %s-bit codes, treelets of %u, leaves up to %u tris", settings.wideCodes ? "63" : "30", settings.treeletSize, settings.maxLeafTris);
+}
+
+// Builds over [restMesh], then refits to the verified mesh (same triangles, moved vertices); [maxLeafTris]/costs/[numThreads] mirror the
+// builder settings' fields for [VerifyBVH]
+struct RefitCase
+{
+	const BVHTestMesh* restMesh;
+	BVH::BinnedSAHSettings build;
+	BVH::RefitSettings refit;
+	uint32_t maxLeafTris;
+	float traversalCost, triangleCost;
+	uint32_t numThreads;
+};
+
+static RefitCase MakeRefitCase(const BVHTestMesh& restMesh, const BVH::BinnedSAHSettings& build)
+{
+	RefitCase refitCase = {};
+	refitCase.restMesh = &restMesh;
+	refitCase.build = build;
+	refitCase.refit.maxSAHGrowth = INFINITY; // Never rebuild, so the checks see the refit tree
+	refitCase.maxLeafTris = build.maxLeafTris;
+	refitCase.traversalCost = build.traversalCost;
+	refitCase.triangleCost = build.triangleCost;
+	refitCase.numThreads = build.numThreads;
+	return refitCase;
+}
+
+static void BuildBVH(BVH& bvh, const BVHTestMesh& mesh, const RefitCase& refitCase)
+{
+	BVH::BinnedSAHSettings build = refitCase.build;
+	build.numThreads = refitCase.numThreads;
+	BuildBVH(bvh, *refitCase.restMesh, build);
+
+	BVH::RefitSettings refit = refitCase.refit;
+	refit.numThreads = refitCase.numThreads;
+	bvh.Refit(mesh.positions.data(), mesh.positions.size(), sizeof(float4), mesh.tris.data(), refit);
+}
+
+static void DescribeSettings(const RefitCase& refitCase, char* out, size_t outSize)
+{
+	char buildDescription[96] = {};
+	DescribeSettings(refitCase.build, buildDescription, sizeof(buildDescription));
+	snprintf(out, outSize, "%s, refit", buildDescription);
+}
+
+// Spatial splits can list triangles more than once, and leave leaves bounding just their triangles' pieces (until they're refit)
+static float DuplicateBudget(const BVH::BinnedSAHSettings& settings) { return settings.spatialSplits ? settings.splitBudget : 0.0f; }
+static float DuplicateBudget(const BVH::LBVHSettings&) { return 0.0f; }
+static float DuplicateBudget(const RefitCase& refitCase) { return DuplicateBudget(refitCase.build); }
+static bool ClippedLeaves(const BVH::BinnedSAHSettings& settings) { return settings.spatialSplits; }
+static bool ClippedLeaves(const BVH::LBVHSettings&) { return false; }
+static bool ClippedLeaves(const RefitCase&) { return false; }
+
+// Smooth per-vertex motion, roughly what skinning/vertex animation does to a mesh between frames
+static BVHTestMesh AnimateMesh(const BVHTestMesh& mesh, float amplitude, float phase)
+{
+	BVHTestMesh moved = mesh;
+	for (float4& p : moved.positions)
+	{
+		p.x += amplitude * std::sin(p.y * 9.0f + phase);
+		p.y += amplitude * std::sin(p.z * 7.0f + phase * 1.3f);
+		p.z += amplitude * std::cos(p.x * 8.0f + phase * 0.7f);
+	}
+	return moved;
+}
+
+// Checks the tree's layout, bounds, triangle coverage and stats, then determinism across thread counts and closest hits against
+// brute force; works for either builder's settings
+template<typename settingsType>
+static uint32_t VerifyBVH(const char* label, const BVHTestMesh& mesh, const settingsType& settings, std::mt19937& rng)
+{
+	uint32_t numFailures = 0;
+	const uint32_t numTris = static_cast<uint32_t>(mesh.tris.size());
+
+	BVH bvh;
+	BuildBVH(bvh, mesh, settings);
+
+	const BVH::Stats& stats = bvh.GetStats();
+	const ComputeBVH_Node* nodes = &bvh.Nodes()[0];
+	const uint32_t* triList = &bvh.TriList()[0];
+	char description[128] = {};
+	DescribeSettings(settings, description, sizeof(description));
+	printf("%s (%u tris, %s): %u nodes (%u leaves), depth %u, largest leaf %u, SAH cost %.2f\n", label, numTris, description, stats.numNodes, stats.numLeaves,
+		   stats.depth, stats.maxLeafTris, stats.sahCost);
+
+	const uint32_t triListLen = bvh.TriListLen();
+	const bool clipped = ClippedLeaves(settings);
+	VERIFY(bvh.NumNodes() == bvh.Nodes().arrayLen && std::max(triListLen, 1u) == bvh.TriList().arrayLen, "%s: outputs aren't sized to the tree", label);
+	VERIFY(stats.nodeBytes == stats.numNodes * sizeof(ComputeBVH_Node) && stats.triListBytes == triListLen * sizeof(uint32_t), "%s: byte counts are off", label);
+	VERIFY(triListLen >= numTris && triListLen <= numTris + static_cast<uint64_t>(numTris * DuplicateBudget(settings)), "%s: %u triangle list entries for %u triangles",
+		   label, triListLen, numTris);
+
+	// Depth-first layout: walking the tree (left child at n + 1, right child where the branch says) visits every node once, in order,
+	// and leaves tile the triangle list in order
+	std::vector<uint32_t> visitOrder;
+	std::vector<uint32_t> triCounts(numTris, 0);
+	uint32_t numLeaves = 0, maxLeafTris = 0, depth = 0, nextTri = 0;
+	double sahCost = 0.0;
+	const double rootArea = (static_cast<double>(nodes[0].boundsMax.x) - nodes[0].boundsMin.x) * (static_cast<double>(nodes[0].boundsMax.y) - nodes[0].boundsMin.y) +
+							(static_cast<double>(nodes[0].boundsMax.y) - nodes[0].boundsMin.y) * (static_cast<double>(nodes[0].boundsMax.z) - nodes[0].boundsMin.z) +
+							(static_cast<double>(nodes[0].boundsMax.z) - nodes[0].boundsMin.z) * (static_cast<double>(nodes[0].boundsMax.x) - nodes[0].boundsMin.x);
+	{
+		struct Pending
+		{
+			uint32_t node, depth;
+		};
+		std::vector<Pending> stack = { { 0, 0 } };
+		while (!stack.empty() && numFailures == 0)
+		{
+			const Pending pending = stack.back();
+			stack.pop_back();
+			VERIFY(pending.node < stats.numNodes && pending.node == visitOrder.size(), "%s: reached node %u out of depth-first order (expected %zu)", label, pending.node, visitOrder.size());
+			if (numFailures > 0)
+			{
+				break;
+			}
+
+			visitOrder.push_back(pending.node);
+			depth = std::max(depth, pending.depth);
+
+			const ComputeBVH_Node& node = nodes[pending.node];
+			const float dx = node.boundsMax.x - node.boundsMin.x, dy = node.boundsMax.y - node.boundsMin.y, dz = node.boundsMax.z - node.boundsMin.z;
+			const double areaRatio = (numTris > 0 && rootArea > 0.0) ? (static_cast<double>(dx) * dy + static_cast<double>(dy) * dz + static_cast<double>(dz) * dx) / rootArea : 1.0;
+			if (node.triCount > 0 || numTris == 0)
+			{
+				numLeaves++;
+				maxLeafTris = std::max(maxLeafTris, node.triCount);
+				sahCost += areaRatio * node.triCount * settings.triangleCost;
+				VERIFY(node.triCount > 0 || numTris == 0, "%s: leaf %u is empty", label, pending.node);
+				VERIFY(node.triCount <= settings.maxLeafTris, "%s: leaf %u holds %u triangles (limit %u)", label, pending.node, node.triCount, settings.maxLeafTris);
+				VERIFY(node.rightOrFirstTri == nextTri, "%s: leaf %u starts at triangle %u, expected %u", label, pending.node, node.rightOrFirstTri, nextTri);
+				nextTri += node.triCount;
+
+				// Leaf bounds are exactly their triangles' bounds (or within them, for pieces)
+				float bmin[3] = { INFINITY, INFINITY, INFINITY }, bmax[3] = { -INFINITY, -INFINITY, -INFINITY };
+				for (uint32_t i = 0; i < node.triCount && node.rightOrFirstTri + i < triListLen; i++)
+				{
+					const uint32_t t = triList[node.rightOrFirstTri + i];
+					VERIFY(t < numTris, "%s: leaf %u lists triangle %u, which doesn't exist", label, pending.node, t);
+					if (t >= numTris)
+					{
+						continue;
+					}
+
+					triCounts[t]++;
+					for (uint32_t v = 0; v < 3; v++)
+					{
+						const float4& p = mesh.positions[(&mesh.tris[t].xyz.x)[v]];
+						bmin[0] = std::min(bmin[0], p.x), bmin[1] = std::min(bmin[1], p.y), bmin[2] = std::min(bmin[2], p.z);
+						bmax[0] = std::max(bmax[0], p.x), bmax[1] = std::max(bmax[1], p.y), bmax[2] = std::max(bmax[2], p.z);
+					}
+				}
+				const bool within = node.boundsMin.x >= bmin[0] && node.boundsMin.y >= bmin[1] && node.boundsMin.z >= bmin[2] && node.boundsMax.x <= bmax[0] &&
+									node.boundsMax.y <= bmax[1] && node.boundsMax.z <= bmax[2];
+				VERIFY(numTris == 0 || (clipped ? within : SameBounds(node, bmin, bmax)), "%s: leaf %u's bounds don't match its triangles", label, pending.node);
+			}
+			else
+			{
+				sahCost += areaRatio * settings.traversalCost;
+				const uint32_t left = pending.node + 1, right = node.rightOrFirstTri;
+				VERIFY(right > left && right < stats.numNodes, "%s: branch %u's right child (%u) is out of range", label, pending.node, right);
+				if (numFailures > 0)
+				{
+					break;
+				}
+
+				// Branch bounds are exactly their children's bounds
+				const float bmin[3] = { std::min(nodes[left].boundsMin.x, nodes[right].boundsMin.x), std::min(nodes[left].boundsMin.y, nodes[right].boundsMin.y), std::min(nodes[left].boundsMin.z, nodes[right].boundsMin.z) };
+				const float bmax[3] = { std::max(nodes[left].boundsMax.x, nodes[right].boundsMax.x), std::max(nodes[left].boundsMax.y, nodes[right].boundsMax.y), std::max(nodes[left].boundsMax.z, nodes[right].boundsMax.z) };
+				const bool within = node.boundsMin.x <= bmin[0] && node.boundsMin.y <= bmin[1] && node.boundsMin.z <= bmin[2] && node.boundsMax.x >= bmax[0] &&
+									node.boundsMax.y >= bmax[1] && node.boundsMax.z >= bmax[2];
+				VERIFY(clipped ? within : SameBounds(node, bmin, bmax), "%s: branch %u's bounds don't match its children", label, pending.node);
+
+				stack.push_back({ right, pending.depth + 1 });
+				stack.push_back({ left, pending.depth + 1 });
+			}
+		}
+	}
+
+	VERIFY(visitOrder.size() == stats.numNodes, "%s: walked %zu of %u nodes", label, visitOrder.size(), stats.numNodes);
+	VERIFY(nextTri == triListLen, "%s: leaves cover %u of %u triangle list entries", label, nextTri, triListLen);
+	if (DuplicateBudget(settings) > 0.0f)
+	{
+		VERIFY(std::all_of(triCounts.begin(), triCounts.end(), [](uint32_t c) { return c >= 1; }), "%s: some triangles aren't listed", label);
+	}
+	else
+	{
+		VERIFY(std::all_of(triCounts.begin(), triCounts.end(), [](uint32_t c) { return c == 1; }), "%s: some triangles aren't listed exactly once", label);
+	}
+	VERIFY(numLeaves == stats.numLeaves && maxLeafTris == stats.maxLeafTris && depth == stats.depth, "%s: stats don't match the tree", label);
+	VERIFY(stats.depth < AS_BVH_MAX_DEPTH, "%s: depth %u is past the traversal limit (%u)", label, stats.depth, AS_BVH_MAX_DEPTH);
+	VERIFY(std::abs(sahCost - stats.sahCost) <= 1e-4 * std::max(sahCost, 1.0), "%s: SAH cost is %f, stats say %f", label, sahCost, stats.sahCost);
+
+	// Threading doesn't change the tree
+	{
+		settingsType serialSettings = settings;
+		serialSettings.numThreads = 1;
+
+		BVH serial;
+		BuildBVH(serial, mesh, serialSettings);
+		const bool same = (serial.NumNodes() == bvh.NumNodes()) &&
+						  memcmp(&serial.Nodes()[0], &bvh.Nodes()[0], bvh.NumNodes() * sizeof(ComputeBVH_Node)) == 0 &&
+						  memcmp(&serial.TriList()[0], &bvh.TriList()[0], bvh.TriList().arrayLen * sizeof(uint32_t)) == 0;
+		VERIFY(same, "%s: serial and threaded builds differ", label);
+		serial.DeInit();
+
+		// [serial] was allocated after [bvh], so freeing it leaves [bvh]'s handles (and these pointers) where they were
+		nodes = &bvh.Nodes()[0];
+		triList = &bvh.TriList()[0];
+	}
+
+	// Closest hits through the BVH match brute force
+	if (numTris > 0 && numFailures == 0)
+	{
+		const ComputeBVH_Node& root = nodes[0];
+		std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+		auto pointNear = [&](float margin)
+		{
+			return float4(root.boundsMin.x - margin + unit(rng) * (root.boundsMax.x - root.boundsMin.x + 2.0f * margin),
+						  root.boundsMin.y - margin + unit(rng) * (root.boundsMax.y - root.boundsMin.y + 2.0f * margin),
+						  root.boundsMin.z - margin + unit(rng) * (root.boundsMax.z - root.boundsMin.z + 2.0f * margin), 0.0f);
+		};
+		const float extent = std::max({ root.boundsMax.x - root.boundsMin.x, root.boundsMax.y - root.boundsMin.y, root.boundsMax.z - root.boundsMin.z });
+
+		constexpr uint32_t numRays = 512;
+		uint32_t numHits = 0;
+		uint64_t numNodesVisited = 0;
+		for (uint32_t r = 0; r < numRays; r++)
+		{
+			const float4 origin = pointNear(extent * 0.5f), target = pointNear(0.0f);
+			const RayPrecomp rp = PrecomputeRay(origin, float4(target.x - origin.x, target.y - origin.y, target.z - origin.z, 0.0f));
+
+			float refT = INFINITY;
+			for (const IndexedTriangle& tri : mesh.tris)
+			{
+				float t, u, v;
+				if (RayTriangle(rp, mesh.positions[tri.xyz.x], mesh.positions[tri.xyz.y], mesh.positions[tri.xyz.z], 0.0f, refT, &t, &u, &v))
+				{
+					refT = t;
+				}
+			}
+
+			uint32_t nodesVisited;
+			const float t = BVHClosestHit(bvh, mesh, rp, &nodesVisited);
+			VERIFY(t == refT, "%s: ray %u hit at t = %f through the BVH, brute force found t = %f", label, r, t, refT);
+			numHits += (refT < INFINITY) ? 1 : 0;
+			numNodesVisited += nodesVisited;
+		}
+		printf("checked %u rays against brute force (%u hits, %.1f nodes visited per ray)\n", numRays, numHits, static_cast<double>(numNodesVisited) / numRays);
+	}
+
+	bvh.DeInit();
+	return numFailures;
+}
+
+bool BVHVerification()
+{
+	uint32_t numFailures = 0;
+	std::mt19937 rng(2007);
+	std::uniform_real_distribution<float> centerDist(-10.0f, 10.0f), offsetDist(-0.5f, 0.5f);
+
+	BVH::BinnedSAHSettings settings;
+	settings.numThreads = 4;
+
+	BVH::LBVHSettings lbvhSettings;
+	lbvhSettings.treeletSize = 7;
+	lbvhSettings.numThreads = 4;
+
+	// Empty + single-triangle scenes
+	{
+		BVHTestMesh mesh;
+		numFailures += VerifyBVH("empty", mesh, settings, rng);
+		numFailures += VerifyBVH("empty", mesh, lbvhSettings, rng);
+
+		AddTriangle(mesh, float4(0.0f, 0.0f, 0.0f, 0.0f), float4(1.0f, 0.0f, 0.0f, 0.0f), float4(0.0f, 1.0f, 0.0f, 0.0f));
+		numFailures += VerifyBVH("single triangle", mesh, settings, rng);
+		numFailures += VerifyBVH("single triangle", mesh, lbvhSettings, rng);
+
+		AddTriangle(mesh, float4(2.0f, 0.0f, 0.0f, 0.0f), float4(3.0f, 0.0f, 0.0f, 0.0f), float4(2.0f, 1.0f, 0.0f, 0.0f));
+		numFailures += VerifyBVH("two triangles", mesh, lbvhSettings, rng);
+	}
+
+	// Stacked copies of one triangle share a centroid, so they can only be split down the middle
+	{
+		BVHTestMesh mesh;
+		for (uint32_t i = 0; i < 100; i++)
+		{
+			AddTriangle(mesh, float4(0.0f, 0.0f, 0.0f, 0.0f), float4(1.0f, 0.0f, 0.0f, 0.0f), float4(0.0f, 1.0f, 1.0f, 0.0f));
+		}
+		numFailures += VerifyBVH("stacked triangles", mesh, settings, rng);
+
+		// Every Morton code is the same, so the radix tree splits on triangle positions alone
+		numFailures += VerifyBVH("stacked triangles", mesh, lbvhSettings, rng);
+	}
+
+	// Tiny triangles at geometrically growing distances (~16 orders of magnitude); most centroids land in the first bin at every level,
+	// so splits only peel off a few triangles at a time
+	{
+		BVHTestMesh mesh;
+		float x = 1.0f;
+		for (uint32_t i = 0; i < 200; i++, x *= 1.2f)
+		{
+			AddTriangle(mesh, float4(x, 0.0f, 0.0f, 0.0f), float4(x * 1.0001f, 0.0f, 0.0f, 0.0f), float4(x, x * 0.0001f, 0.0f, 0.0f));
+		}
+		numFailures += VerifyBVH("geometric series", mesh, settings, rng);
+
+		// Most centroids quantise to the same 30-bit code here too; 63-bit codes separate a few more
+		numFailures += VerifyBVH("geometric series", mesh, lbvhSettings, rng);
+
+		BVH::LBVHSettings wideSettings = lbvhSettings;
+		wideSettings.wideCodes = true;
+		numFailures += VerifyBVH("geometric series", mesh, wideSettings, rng);
+	}
+
+	// Random soup, plus a cluster of tiny triangles, under a few settings
+	{
+		BVHTestMesh mesh;
+		for (uint32_t i = 0; i < 4000; i++)
+		{
+			const float4 c = float4(centerDist(rng), centerDist(rng), centerDist(rng), 0.0f);
+			AddTriangle(mesh, float4(c.x + offsetDist(rng), c.y + offsetDist(rng), c.z + offsetDist(rng), 0.0f),
+							  float4(c.x + offsetDist(rng), c.y + offsetDist(rng), c.z + offsetDist(rng), 0.0f),
+							  float4(c.x + offsetDist(rng), c.y + offsetDist(rng), c.z + offsetDist(rng), 0.0f));
+		}
+
+		for (uint32_t i = 0; i < 1000; i++)
+		{
+			const float4 c = float4(5.0f + offsetDist(rng) * 0.01f, 5.0f + offsetDist(rng) * 0.01f, 5.0f + offsetDist(rng) * 0.01f, 0.0f);
+			AddTriangle(mesh, c, float4(c.x + offsetDist(rng) * 0.001f, c.y + offsetDist(rng) * 0.001f, c.z, 0.0f), float4(c.x, c.y + offsetDist(rng) * 0.001f, c.z + offsetDist(rng) * 0.001f, 0.0f));
+		}
+
+		numFailures += VerifyBVH("soup", mesh, settings, rng);
+
+		BVH::BinnedSAHSettings fineSettings = settings;
+		fineSettings.leafTris = 1;
+		fineSettings.maxLeafTris = 1;
+		numFailures += VerifyBVH("soup", mesh, fineSettings, rng);
+
+		BVH::BinnedSAHSettings coarseSettings = settings;
+		coarseSettings.leafTris = 16;
+		coarseSettings.maxLeafTris = 64;
+		coarseSettings.traversalCost = 4.0f;
+		coarseSettings.numThreads = 3;
+		numFailures += VerifyBVH("soup", mesh, coarseSettings, rng);
+
+		BVH::BinnedSAHSettings spatialSettings = settings;
+		spatialSettings.spatialSplits = true;
+		numFailures += VerifyBVH("soup", mesh, spatialSettings, rng);
+
+		// A zero budget can still chop straddling triangles' bounds, as long as splits unsplit them all again
+		spatialSettings.splitBudget = 0.0f;
+		spatialSettings.leafTris = 1;
+		spatialSettings.maxLeafTris = 1;
+		numFailures += VerifyBVH("soup", mesh, spatialSettings, rng);
+
+		BVH::LBVHSettings plainSettings = lbvhSettings;
+		plainSettings.treeletSize = 0;
+		numFailures += VerifyBVH("soup", mesh, plainSettings, rng);
+		numFailures += VerifyBVH("soup", mesh, lbvhSettings, rng);
+
+		BVH::LBVHSettings wideSettings = lbvhSettings;
+		wideSettings.wideCodes = true;
+		wideSettings.treeletSize = BVH::maxTreeletSize;
+		wideSettings.treeletPasses = 3;
+		wideSettings.maxLeafTris = 1;
+		wideSettings.numThreads = 3;
+		numFailures += VerifyBVH("soup", mesh, wideSettings, rng);
+
+		// Refits keep the tree exact over moved vertices; large enough subtrees refit across threads
+		const BVHTestMesh moved = AnimateMesh(mesh, 0.5f, 1.0f);
+		numFailures += VerifyBVH("animated soup", moved, MakeRefitCase(mesh, settings), rng);
+		numFailures += VerifyBVH("animated soup", moved, MakeRefitCase(mesh, fineSettings), rng);
+
+		// Mild motion refits in place; scrambling every vertex degrades the tree past the rebuild threshold
+		BVH bvh;
+		bvh.BuildBinnedSAH(mesh.positions.data(), mesh.positions.size(), sizeof(float4), mesh.tris.data(), static_cast<uint32_t>(mesh.tris.size()), settings);
+		const uint32_t builtNodes = bvh.NumNodes();
+		const BVHTestMesh nudged = AnimateMesh(mesh, 0.01f, 0.0f);
+		const bool nudgeRebuilt = bvh.Refit(nudged.positions.data(), nudged.positions.size(), sizeof(float4), nudged.tris.data(), BVH::RefitSettings());
+		printf("nudged soup: SAH growth %.3f\n", bvh.SAHGrowth());
+		VERIFY(!nudgeRebuilt && bvh.NumNodes() == builtNodes && bvh.SAHGrowth() < BVH::RefitSettings().maxSAHGrowth, "small movements shouldn't trigger a rebuild");
+
+		BVHTestMesh scrambled = mesh;
+		std::shuffle(scrambled.positions.begin(), scrambled.positions.end(), rng);
+		const bool scrambleRebuilt = bvh.Refit(scrambled.positions.data(), scrambled.positions.size(), sizeof(float4), scrambled.tris.data(), BVH::RefitSettings());
+		printf("scrambled soup: rebuilt %s, SAH growth %.3f\n", scrambleRebuilt ? "yes" : "no", bvh.SAHGrowth());
+		VERIFY(scrambleRebuilt && bvh.SAHGrowth() == 1.0f, "scrambled vertices should trigger a rebuild");
+		bvh.DeInit();
+	}
+
+	// Building-spanning floors + walls over small clutter; spatial splits chop the long triangles into many references
+	{
+		BVHTestMesh mesh;
+		BuildArchitecturalScene(3, 4, 6, mesh.positions, mesh.tris);
+		numFailures += VerifyBVH("building", mesh, settings, rng);
+
+		BVH::BinnedSAHSettings spatialSettings = settings;
+		spatialSettings.spatialSplits = true;
+		numFailures += VerifyBVH("building", mesh, spatialSettings, rng);
+
+		spatialSettings.splitBudget = 4.0f;
+		spatialSettings.leafTris = 1;
+		spatialSettings.maxLeafTris = 1;
+		numFailures += VerifyBVH("building", mesh, spatialSettings, rng);
+
+		// Refits go back to whole-triangle bounds, keeping the duplicated references
+		numFailures += VerifyBVH("animated building", AnimateMesh(mesh, 0.1f, 1.0f), MakeRefitCase(mesh, spatialSettings), rng);
+	}
+
+	// Real geometry
+	{
+		SceneBuffers buffers;
+		buffers.Init(64 * 1024, 128 * 1024, 1);
+		if (LoadTestObj("../Models/stanford-bunny.obj", buffers))
+		{
+			BVHTestMesh mesh;
+			const GeoTypes::Vertex3D* vts = reinterpret_cast<const GeoTypes::Vertex3D*>(&buffers.BufferContents(SceneBuffers::VBUFFER)[0]);
+			const IndexedTriangle* tris = reinterpret_cast<const IndexedTriangle*>(&buffers.BufferContents(SceneBuffers::TRIBUFFER)[0]);
+			for (uint64_t i = 0; i < buffers.NumVerts(); i++)
+			{
+				mesh.positions.push_back(vts[i].pos);
+			}
+			mesh.tris.assign(tris, tris + buffers.NumTris());
+
+			numFailures += VerifyBVH("stanford-bunny.obj", mesh, settings, rng);
+
+			BVH::BinnedSAHSettings spatialSettings = settings;
+			spatialSettings.spatialSplits = true;
+			numFailures += VerifyBVH("stanford-bunny.obj", mesh, spatialSettings, rng);
+			numFailures += VerifyBVH("stanford-bunny.obj", mesh, lbvhSettings, rng);
+
+			BVH::LBVHSettings wideSettings = lbvhSettings;
+			wideSettings.wideCodes = true;
+			wideSettings.treeletSize = 0;
+			numFailures += VerifyBVH("stanford-bunny.obj", mesh, wideSettings, rng);
+
+			// Movements up to ~7% of the bunny's size (it's ~0.15 units across)
+			numFailures += VerifyBVH("animated stanford-bunny.obj", AnimateMesh(mesh, 0.01f, 2.0f), MakeRefitCase(mesh, settings), rng);
+		}
+		else
+		{
+			printf("couldn't open ../Models/stanford-bunny.obj, skipping real-geometry checks\n");
+		}
+		buffers.DeInit();
+	}
+
+	return numFailures == 0;
+}
@@ -0,0 +1,235 @@
+#include "Verification.h"
+#include "../../SandboxApp/Bounds.h"
+#include "../../SandboxApp/SceneGraph.h"
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <random>
+#include <string>
+
+// Same layout as Geo::Vertex3D (position first, 48-byte stride), without pulling in the GPU-side headers
+struct TestVertex
+{
+	float4 pos;
+	float4 mat;
+	float4 normals;
+};
+
+// Double-precision reference bounds, via the textbook quaternion sandwich product
+static void ReferenceBounds(const TestVertex* verts, uint64_t numVerts, const transform& xform, double* outMin, double* outMax)
+{
+	const double qx = xform.rotation.x, qy = xform.rotation.y, qz = xform.rotation.z, qw = xform.rotation.w;
+	const double s = xform.translationAndScale.w;
+	for (uint32_t a = 0; a < 3; a++)
+	{
+		outMin[a] = INFINITY;
+		outMax[a] = -INFINITY;
+	}
+
+	for (uint64_t i = 0; i < numVerts; i++)
+	{
+		const double vx = verts[i].pos.x * s, vy = verts[i].pos.y * s, vz = verts[i].pos.z * s;
+
+		// q * v
+		const double tw = -qx * vx - qy * vy - qz * vz;
+		const double tx = qw * vx + qy * vz - qz * vy;
+		const double ty = qw * vy + qz * vx - qx * vz;
+		const double tz = qw * vz + qx * vy - qy * vx;
+
+		// (q * v) * q^-1
+		const double p[3] = { -tw * qx + tx * qw - ty * qz + tz * qy + xform.translationAndScale.x,
+							  -tw * qy + ty * qw - tz * qx + tx * qz + xform.translationAndScale.y,
+							  -tw * qz + tz * qw - tx * qy + ty * qx + xform.translationAndScale.z };
+
+		for (uint32_t a = 0; a < 3; a++)
+		{
+			outMin[a] = std::min(outMin[a], p[a]);
+			outMax[a] = std::max(outMax[a], p[a]);
+		}
+	}
+}
+
+static transform RandomTransform(std::mt19937& rng, bool rotated)
+{
+	std::uniform_real_distribution<float> unitDist(-1.0f, 1.0f);
+
+	transform t;
+	t.translationAndScale = float4(unitDist(rng) * 100.0f, unitDist(rng) * 100.0f, unitDist(rng) * 100.0f, 1.5f + unitDist(rng));
+	t.rotation = float4(0.0f, 0.0f, 0.0f, 1.0f);
+	if (rotated)
+	{
+		float qx = unitDist(rng), qy = unitDist(rng), qz = unitDist(rng), qw = unitDist(rng);
+		const float invLen = 1.0f / std::sqrt(qx * qx + qy * qy + qz * qz + qw * qw);
+		t.rotation = float4(qx * invLen, qy * invLen, qz * invLen, qw * invLen);
+	}
+	return t;
+}
+
+// Tight = every face of [mn]/[mx] sits on the reference bounds (so the box contains every vertex, and touches the outermost ones)
+static uint32_t VerifyTight(const char* label, float4 mn, float4 mx, const double* refMin, const double* refMax)
+{
+	uint32_t numFailures = 0;
+	const float sseMin[3] = { mn.x, mn.y, mn.z };
+	const float sseMax[3] = { mx.x, mx.y, mx.z };
+	for (uint32_t a = 0; a < 3; a++)
+	{
+		const double tolerance = 1e-5 * std::max(1.0, std::max(std::abs(refMin[a]), std::abs(refMax[a])));
+		VERIFY(std::abs(sseMin[a] - refMin[a]) <= tolerance, "%s: min[%u] = %f, expected %f", label, a, sseMin[a], refMin[a]);
+		VERIFY(std::abs(sseMax[a] - refMax[a]) <= tolerance, "%s: max[%u] = %f, expected %f", label, a, sseMax[a], refMax[a]);
+	}
+	VERIFY(mn.w == 0.0f && mx.w == 0.0f, "%s: bounds carry non-zero w", label);
+	return numFailures;
+}
+
+static uint32_t VerifyVertexSet(const char* label, const TestVertex* verts, uint64_t numVerts, std::mt19937& rng)
+{
+	uint32_t numFailures = 0;
+
+	// Object-space bounds are plain min/max, so they should match exactly
+	float4 mn, mx;
+	VertexBounds(&verts[0].pos, numVerts, sizeof(TestVertex), &mn, &mx);
+
+	float refMin[3] = { INFINITY, INFINITY, INFINITY }, refMax[3] = { -INFINITY, -INFINITY, -INFINITY };
+	for (uint64_t i = 0; i < numVerts; i++)
+	{
+		const float p[3] = { verts[i].pos.x, verts[i].pos.y, verts[i].pos.z };
+		for (uint32_t a = 0; a < 3; a++)
+		{
+			refMin[a] = std::min(refMin[a], p[a]);
+			refMax[a] = std::max(refMax[a], p[a]);
+		}
+	}
+	VERIFY(mn.x == refMin[0] && mn.y == refMin[1] && mn.z == refMin[2] && mx.x == refMax[0] && mx.y == refMax[1] && mx.z == refMax[2],
+		   "%s: object-space bounds differ from scalar min/max", label);
+
+	// World-space bounds should hug the transformed vertices under arbitrary SQTs
+	for (uint32_t i = 0; i < 16; i++)
+	{
+		const transform xform = RandomTransform(rng, i > 0);
+
+		float4 worldMin, worldMax;
+		TransformedVertexBounds(&verts[0].pos, numVerts, sizeof(TestVertex), xform, &worldMin, &worldMax);
+
+		double worldRefMin[3], worldRefMax[3];
+		ReferenceBounds(verts, numVerts, xform, worldRefMin, worldRefMax);
+		numFailures += VerifyTight(label, worldMin, worldMax, worldRefMin, worldRefMax);
+
+		// Scene graph bounds transform the object-space box instead; they should be exact without rotation and never smaller than the
+		// real bounds with it
+		SceneGraph graph;
+		graph.Init(1, 1);
+		graph.AddMesh(mn, mx);
+		graph.AddNode(SceneGraph::invalidNdx, xform, 0);
+		graph.Update();
+
+		float4 nodeMin, nodeMax;
+		graph.GetWorldBounds(0, &nodeMin, &nodeMax);
+		if (i == 0)
+		{
+			numFailures += VerifyTight(label, nodeMin, nodeMax, worldRefMin, worldRefMax);
+		}
+		else
+		{
+			const double tolerance = 1e-5 * 200.0;
+			VERIFY(nodeMin.x <= worldRefMin[0] + tolerance && nodeMin.y <= worldRefMin[1] + tolerance && nodeMin.z <= worldRefMin[2] + tolerance &&
+				   nodeMax.x >= worldRefMax[0] - tolerance && nodeMax.y >= worldRefMax[1] - tolerance && nodeMax.z >= worldRefMax[2] - tolerance,
+				   "%s: scene graph bounds don't contain the transformed mesh", label);
+		}
+		graph.DeInit();
+	}
+
+	return numFailures;
+}
+
+bool BoundsVerification()
+{
+	uint32_t numFailures = 0;
+	std::mt19937 rng(5678);
+	std::uniform_real_distribution<float> dist(-10.0f, 10.0f);
+
+	// Empty sets produce inverted bounds
+	{
+		TestVertex unused = {};
+		float4 mn, mx;
+		VertexBounds(&unused.pos, 0, sizeof(TestVertex), &mn, &mx);
+		VERIFY(mn.x > mx.x && mn.y > mx.y && mn.z > mx.z, "empty vertex set should produce inverted bounds");
+	}
+
+	// Removing a node's only child leaves it childless, so it can be removed in turn (RemoveNode asserts on parents); the root added
+	// after them shifts down to index zero with its bounds intact
+	{
+		SceneGraph graph;
+		graph.Init(3, 1);
+		graph.AddMesh(float4(-1.0f, -1.0f, -1.0f, 0.0f), float4(1.0f, 1.0f, 1.0f, 0.0f));
+		transform offset = {};
+		offset.translationAndScale = float4(5.0f, 0.0f, 0.0f, 2.0f);
+		offset.rotation = float4(0.0f, 0.0f, 0.0f, 1.0f);
+		const uint32_t parent = graph.AddNode(SceneGraph::invalidNdx, offset, 0);
+		const uint32_t child = graph.AddNode(parent, offset, 0);
+		graph.AddNode(SceneGraph::invalidNdx, offset, 0);
+		graph.Update();
+
+		graph.RemoveNode(child);
+		graph.RemoveNode(parent);
+		graph.Update();
+		float4 nodeMin, nodeMax;
+		graph.GetWorldBounds(0, &nodeMin, &nodeMax);
+		VERIFY(graph.NumNodes() == 1 && graph.NodeParent(0) == SceneGraph::invalidNdx, "removing a child and then its parent left %u nodes",
+			   graph.NumNodes());
+		VERIFY(nodeMin.x == 3.0f && nodeMax.x == 7.0f && nodeMin.y == -2.0f && nodeMax.y == 2.0f, "the remaining root's bounds moved to x %f..%f",
+			   nodeMin.x, nodeMax.x);
+		graph.DeInit();
+	}
+
+	// Random clouds; sizes straddle the multithreading threshold, and odd counts exercise the unpaired tail vertex. W holds junk to
+	// make sure it never leaks into the results
+	const uint64_t cloudSizes[] = { 1, 2, 7, 1000, 1024 * 1024 + 3 };
+	for (uint64_t numVerts : cloudSizes)
+	{
+		auto verts = CPUMemory::AllocateArray<TestVertex>(numVerts);
+		for (uint64_t i = 0; i < numVerts; i++)
+		{
+			verts[i].pos = float4(dist(rng), dist(rng) * 0.25f, dist(rng) + 3.0f, 12345.0f);
+			verts[i].mat = float4(-1e9f, -1e9f, -1e9f, -1e9f);
+			verts[i].normals = float4(1e9f, 1e9f, 1e9f, 1e9f);
+		}
+
+		char label[64] = {};
+		snprintf(label, sizeof(label), "random cloud (%llu verts)", static_cast<unsigned long long>(numVerts));
+		numFailures += VerifyVertexSet(label, &verts[0], numVerts, rng);
+		printf("checked %s\n", label);
+
+		CPUMemory::Free(verts);
+	}
+
+	// Real geometry; positions only, straight from the OBJ
+	std::ifstream bunny("../Models/stanford-bunny.obj");
+	if (bunny.is_open())
+	{
+		auto verts = CPUMemory::AllocateArray<TestVertex>(64 * 1024);
+		uint64_t numVerts = 0;
+
+		std::string line;
+		while (std::getline(bunny, line) && numVerts < verts.arrayLen)
+		{
+			float x, y, z;
+			if (sscanf(line.c_str(), "v %f %f %f", &x, &y, &z) == 3)
+			{
+				verts[numVerts].pos = float4(x, y, z, 0.0f);
+				numVerts++;
+			}
+		}
+
+		numFailures += VerifyVertexSet("stanford-bunny.obj", &verts[0], numVerts, rng);
+		printf("checked stanford-bunny.obj (%llu verts)\n", static_cast<unsigned long long>(numVerts));
+
+		CPUMemory::Free(verts);
+	}
+	else
+	{
+		printf("couldn't open ../Models/stanford-bunny.obj, skipping real-geometry checks\n");
+	}
+
+	return numFailures == 0;
+}
@@ -0,0 +1,275 @@
+#include "Verification.h"
+#include "../../HeadlessTracer/ShaderTypes.h"
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <vector>
+
+// Shared shader code compiles here as C++, as in HeadlessTracer/TraceKernel.cpp; nothing else in this file may include the shared
+// headers (or Math.h), since they'd then resolve outside [ShaderCode]
+#define CPU_SHADER_CODE
+namespace ShaderCode
+{
+#include "../../Shaders/SharedBxDFs.hlsli"
+}
+
+using ShaderCode::float2;
+using ShaderCode::float3;
+using ShaderCode::BxDFParams;
+using ShaderCode::BxDFSample;
+
+// Every BxDF in SharedBxDFs.hlsli, checked three ways from a few outgoing angles:
+// - Chi-square: sampled directions binned over the sphere (in theta/phi) against each bin's integral of the pdf, with failed samples
+//   as one more bin (against the pdf's missing mass); the statistic goes through Wilson-Hilferty's normal approximation, and fails
+//   past 4 sigma (p ~ 3e-5 per test, so the whole run stays well under 1% to fail by chance)
+// - Consistency: each sample's pdf and weight match BxDFPdf and EvalBxDF * |cos| / pdf at its direction
+// - White furnace: energy conserving (albedo <= 1 with unit reflectance/no absorption, exactly 1 where nothing should be lost), and
+//   the sampled albedo agrees with one from uniform sphere samples of EvalBxDF, which doesn't go through the sampler at all
+struct BxDFCase
+{
+	const char* name;
+	BxDFParams params;
+	float minAlbedo; // Of white versions (unit albedo, conductors with extinction ~infinity)
+};
+
+static float Unit(std::mt19937& rng)
+{
+	return static_cast<float>(rng() >> 8) * (1.0f / 16777216.0f);
+}
+
+static float3 OutgoingDirection(float cosTheta)
+{
+	return float3(std::sqrt(1.0f - cosTheta * cosTheta), 0.0f, cosTheta);
+}
+
+static float3 SphericalDirection(double theta, double phi)
+{
+	return float3(static_cast<float>(std::sin(theta) * std::cos(phi)), static_cast<float>(std::sin(theta) * std::sin(phi)), static_cast<float>(std::cos(theta)));
+}
+
+static uint32_t ChiSquare(const BxDFCase& bxdfCase, float3 wo, std::mt19937& rng)
+{
+	uint32_t numFailures = 0;
+	const uint32_t thetaBins = 40, phiBins = 80, numSamples = 1000000;
+	const double pi = 3.14159265358979;
+	const double thetaStep = pi / thetaBins, phiStep = 2.0 * pi / phiBins;
+
+	std::vector<double> observed(thetaBins * phiBins + 1, 0.0);
+	uint32_t numMismatches = 0;
+	for (uint32_t i = 0; i < numSamples; i++)
+	{
+		const float u0 = Unit(rng), u1 = Unit(rng), uLobe = Unit(rng);
+		const BxDFSample sample = SampleBxDF(bxdfCase.params, wo, float2(u0, u1), uLobe);
+		if (sample.pdf <= 0.0f)
+		{
+			observed.back()++;
+			continue;
+		}
+
+		const double theta = std::acos(std::min(std::max(static_cast<double>(sample.wi.z), -1.0), 1.0));
+		double phi = std::atan2(static_cast<double>(sample.wi.y), static_cast<double>(sample.wi.x));
+		phi = (phi < 0.0) ? phi + 2.0 * pi : phi;
+		const uint32_t thetaBin = std::min(static_cast<uint32_t>(theta / thetaStep), thetaBins - 1);
+		const uint32_t phiBin = std::min(static_cast<uint32_t>(phi / phiStep), phiBins - 1);
+		observed[thetaBin * phiBins + phiBin]++;
+
+		// Sampled pdfs + weights should be what BxDFPdf/EvalBxDF give for the same direction
+		const float pdf = BxDFPdf(bxdfCase.params, wo, sample.wi);
+		const float weight = EvalBxDF(bxdfCase.params, wo, sample.wi) * std::fabs(sample.wi.z) / pdf;
+		const bool pdfMatches = std::fabs(pdf - sample.pdf) <= 1e-3f * sample.pdf;
+		const bool weightMatches = std::fabs(weight - sample.weight) <= 1e-3f * std::max(sample.weight, 1e-3f);
+		numMismatches += (pdfMatches && weightMatches) ? 0 : 1;
+	}
+	VERIFY(numMismatches <= numSamples / 100000, "%s (cos(wo) %.2f): %u of %u samples disagree with BxDFPdf/EvalBxDF", bxdfCase.name, wo.z, numMismatches,
+		   numSamples);
+
+	// Each bin's expected share is its integral of pdf * sin(theta), by the midpoint rule over a 16x16 grid; bins the pdf cuts off
+	// inside (lobe edges, the horizon for grazing lobes) come out wrong at that resolution, so bins with both zero and non-zero points
+	// are integrated again 8x finer
+	auto integrateBin = [&](uint32_t t, uint32_t p, uint32_t steps, bool* outPartial)
+	{
+		double integral = 0.0;
+		uint32_t numZero = 0;
+		for (uint32_t a = 0; a < steps; a++)
+		{
+			const double theta = (t + (a + 0.5) / steps) * thetaStep;
+			for (uint32_t b = 0; b < steps; b++)
+			{
+				const double phi = (p + (b + 0.5) / steps) * phiStep;
+				const float pdf = BxDFPdf(bxdfCase.params, wo, SphericalDirection(theta, phi));
+				integral += pdf * std::sin(theta);
+				numZero += (pdf == 0.0f) ? 1 : 0;
+			}
+		}
+		*outPartial = (numZero > 0 && numZero < steps * steps);
+		return integral * (thetaStep / steps) * (phiStep / steps);
+	};
+
+	std::vector<double> expected(thetaBins * phiBins + 1, 0.0);
+	double totalMass = 0.0;
+	for (uint32_t t = 0; t < thetaBins; t++)
+	{
+		for (uint32_t p = 0; p < phiBins; p++)
+		{
+			bool partial = false;
+			double integral = integrateBin(t, p, 16, &partial);
+			if (partial)
+			{
+				integral = integrateBin(t, p, 128, &partial);
+			}
+			expected[t * phiBins + p] = integral * numSamples;
+			totalMass += integral;
+		}
+	}
+	expected.back() = std::max(1.0 - totalMass, 0.0) * numSamples;
+
+	// Bins expecting fewer than five samples are pooled into one, as chi-square needs
+	double statistic = 0.0, pooledObserved = 0.0, pooledExpected = 0.0;
+	uint32_t numCells = 0;
+	for (size_t i = 0; i < expected.size(); i++)
+	{
+		if (expected[i] < 5.0)
+		{
+			pooledObserved += observed[i];
+			pooledExpected += expected[i];
+			continue;
+		}
+		const double difference = observed[i] - expected[i];
+		statistic += difference * difference / expected[i];
+		numCells++;
+	}
+	if (pooledExpected >= 5.0)
+	{
+		statistic += (pooledObserved - pooledExpected) * (pooledObserved - pooledExpected) / pooledExpected;
+		numCells++;
+	}
+	else
+	{
+		VERIFY(pooledObserved <= 10.0 + 2.0 * pooledExpected, "%s (cos(wo) %.2f): %.0f samples where the pdf expects %.2f", bxdfCase.name, wo.z, pooledObserved,
+			   pooledExpected);
+	}
+
+	const double dof = static_cast<double>(numCells - 1);
+	const double sigma = (std::cbrt(statistic / dof) - (1.0 - 2.0 / (9.0 * dof))) / std::sqrt(2.0 / (9.0 * dof));
+	VERIFY(sigma < 4.0, "%s (cos(wo) %.2f): chi-square %.1f over %.0f dof (%.1f sigma)", bxdfCase.name, wo.z, statistic, dof, sigma);
+	printf("  %-22s cos(wo) %.2f: chi-square %9.1f, %4.0f dof (%5.2f sigma), %5.2f%% failed samples, pdf mass %.4f\n", bxdfCase.name, wo.z, statistic, dof, sigma,
+		   100.0 * observed.back() / numSamples, totalMass);
+	return numFailures;
+}
+
+static uint32_t WhiteFurnace(const BxDFCase& bxdfCase, float3 wo, std::mt19937& rng)
+{
+	uint32_t numFailures = 0;
+	const uint32_t numSamples = 1000000;
+
+	// Importance-sampled albedo: the mean sample weight
+	double sampledSum = 0.0, sampledSqSum = 0.0;
+	bool anyDelta = false;
+	for (uint32_t i = 0; i < numSamples; i++)
+	{
+		const float u0 = Unit(rng), u1 = Unit(rng), uLobe = Unit(rng);
+		const BxDFSample sample = SampleBxDF(bxdfCase.params, wo, float2(u0, u1), uLobe);
+		sampledSum += sample.weight;
+		sampledSqSum += static_cast<double>(sample.weight) * sample.weight;
+		anyDelta |= sample.delta;
+	}
+	const double sampled = sampledSum / numSamples;
+	const double sampledError = std::sqrt(std::max(sampledSqSum / numSamples - sampled * sampled, 0.0) / numSamples);
+
+	VERIFY(sampled <= 1.0 + 4.0 * sampledError + 1e-5, "%s (cos(wo) %.2f): albedo %.5f gains energy", bxdfCase.name, wo.z, sampled);
+	VERIFY(sampled >= bxdfCase.minAlbedo, "%s (cos(wo) %.2f): albedo %.5f, expected at least %.3f", bxdfCase.name, wo.z, sampled, bxdfCase.minAlbedo);
+	if (anyDelta)
+	{
+		printf("  %-22s cos(wo) %.2f: albedo %.5f (specular)\n", bxdfCase.name, wo.z, sampled);
+		return numFailures;
+	}
+
+	// Uniform sphere samples of EvalBxDF, independent of the sampler
+	double uniformSum = 0.0, uniformSqSum = 0.0;
+	for (uint32_t i = 0; i < numSamples; i++)
+	{
+		const float z = 1.0f - 2.0f * Unit(rng), phi = 6.28318531f * Unit(rng);
+		const float r = std::sqrt(std::max(1.0f - z * z, 0.0f));
+		const float3 wi = float3(r * std::cos(phi), r * std::sin(phi), z);
+		const double estimate = EvalBxDF(bxdfCase.params, wo, wi) * std::fabs(z) * (4.0 * 3.14159265358979);
+		uniformSum += estimate;
+		uniformSqSum += estimate * estimate;
+	}
+	const double uniform = uniformSum / numSamples;
+	const double uniformError = std::sqrt(std::max(uniformSqSum / numSamples - uniform * uniform, 0.0) / numSamples);
+	const double tolerance = 4.0 * std::sqrt(sampledError * sampledError + uniformError * uniformError) + 1e-4;
+	VERIFY(std::fabs(sampled - uniform) <= tolerance, "%s (cos(wo) %.2f): sampled albedo %.5f, uniformly integrated %.5f (+-%.5f)", bxdfCase.name, wo.z, sampled,
+		   uniform, tolerance);
+	printf("  %-22s cos(wo) %.2f: albedo %.5f sampled, %.5f +- %.5f integrated\n", bxdfCase.name, wo.z, sampled, uniform, uniformError);
+	return numFailures;
+}
+
+bool BxDFVerification()
+{
+	uint32_t numFailures = 0;
+	std::mt19937 rng(48);
+
+	// White versions: unit albedo, no absorption, and conductors with (nearly) unit reflectance; single-scattering microfacets lose
+	// energy as they roughen (and dielectrics leaving through rough interfaces lose the most), hence the lower bounds
+	const float whiteEta = 1.0f, whiteK = 1e4f;
+	const BxDFCase whiteCases[] =
+	{
+		{ "lambert", { BXDF_ID_DIFFUSE_LAMBERT, 1.0f, 0.0f, 1.0f, 0.0f }, 1.0f },
+		{ "oren-nayar 0.3", { BXDF_ID_DIFFUSE_OREN_NAYAR, 1.0f, 0.3f, 1.0f, 0.0f }, 0.85f },
+		{ "oren-nayar 1.0", { BXDF_ID_DIFFUSE_OREN_NAYAR, 1.0f, 1.0f, 1.0f, 0.0f }, 0.5f },
+		{ "mirror", { BXDF_ID_SPECULAR_CLASSICAL_SMOOTH, 0.0f, 0.0f, whiteEta, whiteK }, 0.9999f },
+		{ "conductor 0.3", { BXDF_ID_SPECULAR_COOK_TORRANCE, 0.0f, 0.3f, whiteEta, whiteK }, 0.85f },
+		{ "conductor 0.6", { BXDF_ID_SPECULAR_COOK_TORRANCE, 0.0f, 0.6f, whiteEta, whiteK }, 0.75f },
+		{ "conductor 0.9", { BXDF_ID_SPECULAR_COOK_TORRANCE, 0.0f, 0.9f, whiteEta, whiteK }, 0.4f },
+		{ "dielectric smooth", { BXDF_ID_DIELECTRIC_ROUGH, 0.0f, 0.0f, 1.5f, 0.0f }, 0.9999f },
+		{ "dielectric 0.4", { BXDF_ID_DIELECTRIC_ROUGH, 0.0f, 0.4f, 1.5f, 0.0f }, 0.9f },
+		{ "dielectric 0.8", { BXDF_ID_DIELECTRIC_ROUGH, 0.0f, 0.8f, 1.5f, 0.0f }, 0.7f },
+		{ "dielectric exit 0.4", { BXDF_ID_DIELECTRIC_ROUGH, 0.0f, 0.4f, 1.0f / 1.5f, 0.0f }, 0.7f },
+	};
+
+	// Absorbing versions for the distributions; chi-square checks densities, so albedo/reflectance only matter through
+	// Fresnel-weighted lobe choices
+	const BxDFCase sampledCases[] =
+	{
+		{ "lambert", { BXDF_ID_DIFFUSE_LAMBERT, 0.8f, 0.0f, 1.0f, 0.0f }, 0.0f },
+		{ "oren-nayar 0.6", { BXDF_ID_DIFFUSE_OREN_NAYAR, 0.8f, 0.6f, 1.0f, 0.0f }, 0.0f },
+		{ "conductor 0.3", { BXDF_ID_SPECULAR_COOK_TORRANCE, 0.0f, 0.3f, 0.2f, 3.0f }, 0.0f },
+		{ "conductor 0.7", { BXDF_ID_SPECULAR_COOK_TORRANCE, 0.0f, 0.7f, 0.2f, 3.0f }, 0.0f },
+		{ "dielectric 0.4", { BXDF_ID_DIELECTRIC_ROUGH, 0.0f, 0.4f, 1.5f, 0.0f }, 0.0f },
+		{ "dielectric 0.8", { BXDF_ID_DIELECTRIC_ROUGH, 0.0f, 0.8f, 1.5f, 0.0f }, 0.0f },
+		{ "dielectric exit 0.5", { BXDF_ID_DIELECTRIC_ROUGH, 0.0f, 0.5f, 1.0f / 1.5f, 0.0f }, 0.0f },
+	};
+	const float outgoingCosines[] = { 0.95f, 0.5f, 0.1f };
+
+	printf("chi-square + sample/pdf/eval agreement:\n");
+	for (const BxDFCase& bxdfCase : sampledCases)
+	{
+		for (float cosTheta : outgoingCosines)
+		{
+			numFailures += ChiSquare(bxdfCase, OutgoingDirection(cosTheta), rng);
+		}
+	}
+
+	printf("white furnace:\n");
+	for (const BxDFCase& bxdfCase : whiteCases)
+	{
+		for (float cosTheta : outgoingCosines)
+		{
+			numFailures += WhiteFurnace(bxdfCase, OutgoingDirection(cosTheta), rng);
+		}
+	}
+
+	// Lambert samples carry their albedo exactly, as the CPU tracer's default surfaces rely on
+	{
+		const BxDFParams lambert = { BXDF_ID_DIFFUSE_LAMBERT, 0.75f, 0.0f, 1.0f, 0.0f };
+		uint32_t numInexact = 0;
+		for (uint32_t i = 0; i < 1000; i++)
+		{
+			const float u0 = Unit(rng), u1 = Unit(rng);
+			numInexact += (SampleBxDF(lambert, OutgoingDirection(0.5f), float2(u0, u1), 0.0f).weight != 0.75f) ? 1 : 0;
+		}
+		VERIFY(numInexact == 0, "%u Lambert samples' weights weren't exactly their albedo", numInexact);
+	}
+	return numFailures == 0;
+}
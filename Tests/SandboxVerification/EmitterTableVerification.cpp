@@ -0,0 +1,176 @@
+#include "Verification.h"
+#include "../../HeadlessTracer/EmitterTable.h"
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <vector>
+
+// Emitter tables list exactly the light models' non-degenerate triangles, map every scene triangle to its emitter, and lay their alias
+// tables out so each emitter is picked with exactly its share of the total weight: both as the slots + aliases imply it, and as
+// stratified picks resolve them (the way SharedLightSampling.hlsli's EmitterTableSlot + ResolveEmitterAlias do)
+
+struct EmitterTableCase
+{
+	const char* name;
+	uint32_t numTris; // In the scene
+	uint32_t firstEmitter, numEmitters; // The light model's range
+	EmitterTable::Weighting weighting;
+	bool varyRadiance; // Split the emitters into two light models with different radiance
+};
+
+static uint32_t VerifyEmitterTable(const EmitterTableCase& tableCase)
+{
+	uint32_t numFailures = 0;
+
+	// Triangles with areas spanning three orders of magnitude, plus a degenerate one among the emitters (every third case)
+	std::mt19937 rng(tableCase.numTris * 31 + tableCase.numEmitters);
+	std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+	std::vector<GeoTypes::Vertex3D> vts(tableCase.numTris * 3);
+	std::vector<IndexedTriangle> tris(tableCase.numTris);
+	const uint32_t degenerateTri = (tableCase.numEmitters % 3 == 0) ? tableCase.firstEmitter + tableCase.numEmitters / 2 : UINT32_MAX;
+	for (uint32_t i = 0; i < tableCase.numTris; i++)
+	{
+		const float size = std::pow(10.0f, -3.0f * unit(rng)), x = unit(rng), y = unit(rng), z = unit(rng);
+		vts[i * 3] = {};
+		vts[i * 3].pos = float4(x, y, z, 0.0f);
+		vts[i * 3 + 1] = {};
+		vts[i * 3 + 1].pos = float4(x + size, y, z, 0.0f);
+		vts[i * 3 + 2] = {};
+		vts[i * 3 + 2].pos = (i == degenerateTri) ? float4(x + 2.0f * size, y, z, 0.0f) : float4(x, y + size * (0.2f + unit(rng)), z, 0.0f);
+		tris[i].xyz = uint4(i * 3, i * 3 + 1, i * 3 + 2, 0);
+	}
+
+	EmitterTable table;
+	table.Init(tableCase.numEmitters);
+	const uint32_t split = tableCase.varyRadiance ? tableCase.numEmitters / 2 : tableCase.numEmitters;
+	table.AddTriangles(vts.data(), tris.data(), tableCase.firstEmitter, split, 4.0f);
+	table.AddTriangles(vts.data(), tris.data(), tableCase.firstEmitter + split, tableCase.numEmitters - split, 0.25f);
+	table.Build(tableCase.weighting, tableCase.numTris);
+
+	const uint32_t expectedEmitters = tableCase.numEmitters - ((degenerateTri != UINT32_MAX) ? 1 : 0);
+	const uint32_t numEmitters = table.NumEmitters();
+	VERIFY(numEmitters == expectedEmitters, "%s: %u emitters listed, expected %u", tableCase.name, numEmitters, expectedEmitters);
+
+	// Every emitter maps back from its triangle, and nothing else maps anywhere
+	const EmitterAliasEntry* entries = table.Entries();
+	uint32_t numMapped = 0, numMismapped = 0;
+	for (uint32_t t = 0; t < tableCase.numTris; t++)
+	{
+		const uint32_t emitterNdx = table.TriEmitters()[t];
+		if (emitterNdx != UINT32_MAX)
+		{
+			numMapped++;
+			numMismapped += (emitterNdx >= numEmitters || entries[emitterNdx].tri != t) ? 1 : 0;
+		}
+	}
+	VERIFY(numMapped == numEmitters && numMismapped == 0, "%s: %u triangles mapped to emitters (%u wrongly), expected %u", tableCase.name, numMapped,
+		   numMismapped, numEmitters);
+	if (numEmitters == 0)
+	{
+		table.DeInit();
+		return numFailures;
+	}
+
+	// Pick probabilities from the slots: each slot is 1 / n of the unit interval, split between its own emitter and its alias
+	double weightSum = 0.0;
+	for (uint32_t i = 0; i < numEmitters; i++)
+	{
+		weightSum += (tableCase.weighting == EmitterTable::Weighting::Power) ? static_cast<double>(entries[i].radiance) * entries[i].area : 1.0;
+	}
+	std::vector<double> slotShares(numEmitters, 0.0);
+	bool validSlots = true;
+	for (uint32_t i = 0; i < numEmitters; i++)
+	{
+		validSlots = validSlots && entries[i].threshold >= 0.0f && entries[i].threshold <= 1.0f && entries[i].alias < numEmitters;
+		slotShares[i] += entries[i].threshold / static_cast<double>(numEmitters);
+		slotShares[std::min(entries[i].alias, numEmitters - 1)] += (1.0 - entries[i].threshold) / numEmitters;
+	}
+	VERIFY(validSlots, "%s: thresholds outside [0, 1] or aliases past the table", tableCase.name);
+
+	double maxSlotError = 0.0, maxPdfError = 0.0, pdfSum = 0.0;
+	for (uint32_t i = 0; i < numEmitters; i++)
+	{
+		const double expected = ((tableCase.weighting == EmitterTable::Weighting::Power) ? static_cast<double>(entries[i].radiance) * entries[i].area : 1.0) / weightSum;
+		maxSlotError = std::max(maxSlotError, std::fabs(slotShares[i] - expected) / expected);
+		maxPdfError = std::max(maxPdfError, std::fabs(entries[i].pdf - expected) / expected);
+		pdfSum += entries[i].pdf;
+	}
+	VERIFY(maxSlotError < 1e-4, "%s: slots pick an emitter %.3g%% away from its share", tableCase.name, 100.0 * maxSlotError);
+	VERIFY(maxPdfError < 1e-5 && std::fabs(pdfSum - 1.0) < 1e-4, "%s: pdfs %.3g%% away from their shares (summing to %.6f)", tableCase.name,
+		   100.0 * maxPdfError, pdfSum);
+
+	// Stratified picks: [picksPerEmitter] evenly spaced numbers per slot, resolved as the shaders do, should match every emitter's share
+	// to within a pick per slot that leads to it (each stretch of a slot rounds by less than one); they're resolved in double precision
+	// here, since float [u]s only leave ten or so bits of [fraction] across ten thousand slots, which would blur the table's own error
+	const uint32_t picksPerEmitter = 1000;
+	const uint64_t numPicks = static_cast<uint64_t>(numEmitters) * picksPerEmitter;
+	std::vector<uint32_t> picks(numEmitters, 0);
+	for (uint64_t k = 0; k < numPicks; k++)
+	{
+		const double scaled = (k + 0.5) / numPicks * numEmitters;
+		const uint32_t slot = std::min(static_cast<uint32_t>(scaled), numEmitters - 1);
+		const double fraction = std::min(scaled - slot, 1.0);
+		picks[(fraction < entries[slot].threshold) ? slot : entries[slot].alias]++;
+	}
+	std::vector<uint32_t> emitterSlots(numEmitters, 0);
+	for (uint32_t i = 0; i < numEmitters; i++)
+	{
+		emitterSlots[i]++;
+		emitterSlots[std::min(entries[i].alias, numEmitters - 1)] += (entries[i].alias != i) ? 1 : 0;
+	}
+	double maxPickError = 0.0;
+	uint32_t numMispicked = 0;
+	for (uint32_t i = 0; i < numEmitters; i++)
+	{
+		const double pickError = std::fabs(picks[i] - static_cast<double>(entries[i].pdf) * numPicks);
+		maxPickError = std::max(maxPickError, pickError);
+		numMispicked += (pickError > emitterSlots[i]) ? 1 : 0;
+	}
+	VERIFY(numMispicked == 0, "%s: stratified picks land further from %u emitters' shares than their slots round (up to %.1f picks)", tableCase.name,
+		   numMispicked, maxPickError);
+
+	printf("%-28s %6u emitters of %6u triangles, power %9.4g: slot shares within %.2g, pdfs within %.2g, stratified picks within %.1f\n", tableCase.name,
+		   numEmitters, tableCase.numTris, table.Power(), maxSlotError, maxPdfError, maxPickError);
+	table.DeInit();
+	return numFailures;
+}
+
+// Tables built from nothing stay empty, with every triangle mapped to no emitter
+static uint32_t VerifyEmptyTable()
+{
+	uint32_t numFailures = 0;
+	EmitterTable table;
+	table.Init(0);
+	table.Build(EmitterTable::Weighting::Power, 16);
+	bool unmapped = true;
+	for (uint32_t t = 0; t < 16; t++)
+	{
+		unmapped = unmapped && table.TriEmitters()[t] == UINT32_MAX;
+	}
+	VERIFY(table.NumEmitters() == 0 && unmapped && table.Power() == 0.0, "empty table lists %u emitters", table.NumEmitters());
+	table.DeInit();
+	return numFailures;
+}
+
+bool EmitterTableVerification()
+{
+	const EmitterTableCase cases[] =
+	{
+		{ "one emitter", 8, 3, 1, EmitterTable::Weighting::Power, false },
+		{ "two emitters", 8, 0, 2, EmitterTable::Weighting::Power, false },
+		{ "degenerate among nine", 64, 20, 9, EmitterTable::Weighting::Power, true },
+		{ "uniform", 2000, 500, 1000, EmitterTable::Weighting::Uniform, true },
+		{ "power", 2000, 500, 1000, EmitterTable::Weighting::Power, true },
+		{ "10k, power", 50000, 40000, 10000, EmitterTable::Weighting::Power, true },
+		{ "whole scene, power", 12000, 0, 12000, EmitterTable::Weighting::Power, false },
+	};
+
+	uint32_t numFailures = 0;
+	for (const EmitterTableCase& tableCase : cases)
+	{
+		numFailures += VerifyEmitterTable(tableCase);
+	}
+	numFailures += VerifyEmptyTable();
+	return numFailures == 0;
+}
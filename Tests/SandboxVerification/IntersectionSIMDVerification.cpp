@@ -0,0 +1,372 @@
+#include "Verification.h"
+#include "../../SandboxApp/IntersectionSIMD.h"
+
+#include <bit>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <random>
+#include <vector>
+
+struct AgreementStats
+{
+	uint64_t laneTests = 0;
+	uint64_t hits = 0;
+	uint64_t mismatches = 0;
+};
+
+static bool SameBits(float a, float b)
+{
+	return memcmp(&a, &b, sizeof(float)) == 0;
+}
+
+static void PrintRay(const RayPrecomp& rp)
+{
+	printf("  ray origin (%a, %a, %a), inverse direction (%a, %a, %a)\n", rp.org[0], rp.org[1], rp.org[2], rp.invDir[0], rp.invDir[1], rp.invDir[2]);
+}
+
+// One packet through the SIMD kernel for its width and through RayTrianglesScalar; hit masks must match, and hit lanes' t/u/v bit for bit
+template<uint32_t lanes>
+static void CompareTriangles(const RayPrecomp& rp, const TrianglePacket<lanes>& packet, float tMin, float tMax, AgreementStats* stats)
+{
+	float refT[lanes], refU[lanes], refV[lanes], t[lanes], u[lanes], v[lanes];
+	const uint32_t refMask = RayTrianglesScalar(rp, packet, tMin, tMax, refT, refU, refV);
+	uint32_t mask;
+	if constexpr (lanes == 4)
+	{
+		mask = RayTriangles4(rp, packet, tMin, tMax, t, u, v);
+	}
+	else
+	{
+		mask = RayTriangles8(rp, packet, tMin, tMax, t, u, v);
+	}
+
+	bool agreed = (mask == refMask);
+	for (uint32_t bits = mask & refMask; bits != 0; bits &= bits - 1)
+	{
+		const uint32_t i = static_cast<uint32_t>(std::countr_zero(bits));
+		agreed &= SameBits(t[i], refT[i]) && SameBits(u[i], refU[i]) && SameBits(v[i], refV[i]);
+	}
+
+	stats->laneTests += packet.count;
+	stats->hits += static_cast<uint32_t>(std::popcount(refMask));
+	if (!agreed && stats->mismatches++ < 3)
+	{
+		printf("  %u-lane triangle mismatch: mask %02x, scalar %02x, range [%a, %a]\n", lanes, mask, refMask, tMin, tMax);
+		PrintRay(rp);
+	}
+}
+
+template<uint32_t lanes>
+static void CompareBoxes(const RayPrecomp& rp, const BoxPacket<lanes>& packet, float tMin, float tMax, AgreementStats* stats)
+{
+	float refEntries[lanes], entries[lanes];
+	const uint32_t refMask = RayBoxesScalar(rp, packet, tMin, tMax, refEntries);
+	uint32_t mask;
+	if constexpr (lanes == 4)
+	{
+		mask = RayBoxes4(rp, packet, tMin, tMax, entries);
+	}
+	else
+	{
+		mask = RayBoxes8(rp, packet, tMin, tMax, entries);
+	}
+
+	bool agreed = (mask == refMask);
+	for (uint32_t bits = mask & refMask; bits != 0; bits &= bits - 1)
+	{
+		const uint32_t i = static_cast<uint32_t>(std::countr_zero(bits));
+		agreed &= SameBits(entries[i], refEntries[i]);
+	}
+
+	stats->laneTests += packet.count;
+	stats->hits += static_cast<uint32_t>(std::popcount(refMask));
+	if (!agreed && stats->mismatches++ < 3)
+	{
+		printf("  %u-lane box mismatch: mask %02x, scalar %02x, range [%a, %a]\n", lanes, mask, refMask, tMin, tMax);
+		PrintRay(rp);
+	}
+}
+
+template<uint32_t lanes>
+static void SetTriangle(TrianglePacket<lanes>& packet, uint32_t lane, const float* p0, const float* p1, const float* p2)
+{
+	for (uint32_t a = 0; a < 3; a++)
+	{
+		packet.v0[a][lane] = p0[a];
+		packet.v1[a][lane] = p1[a];
+		packet.v2[a][lane] = p2[a];
+	}
+}
+
+template<uint32_t lanes>
+static void SetBox(BoxPacket<lanes>& packet, uint32_t lane, const float* bmin, const float* bmax)
+{
+	for (uint32_t a = 0; a < 3; a++)
+	{
+		packet.bmin[a][lane] = bmin[a];
+		packet.bmax[a][lane] = bmax[a];
+	}
+}
+
+static void Report(const char* label, const AgreementStats& stats, uint32_t& numFailures)
+{
+	printf("%s: %llu lane tests, %llu hits, %llu mismatches\n", label, static_cast<unsigned long long>(stats.laneTests), static_cast<unsigned long long>(stats.hits),
+		   static_cast<unsigned long long>(stats.mismatches));
+	VERIFY(stats.mismatches == 0, "%s: SIMD kernels disagreed with the scalar tests", label);
+	VERIFY(stats.hits > 0 && stats.hits < stats.laneTests, "%s: cases never split between hits and misses", label);
+}
+
+// Random triangles/boxes around random rays' paths (so lanes mix hits and misses), partially filled packets, random ranges, and
+// ranges ending exactly at hit distances
+template<uint32_t lanes>
+static void RandomCases(std::mt19937& rng, uint32_t numPackets, AgreementStats* triStats, AgreementStats* boxStats)
+{
+	std::uniform_real_distribution<float> unit(0.0f, 1.0f), signedUnit(-1.0f, 1.0f);
+	std::uniform_int_distribution<uint32_t> countDist(1, lanes);
+	for (uint32_t p = 0; p < numPackets; p++)
+	{
+		const float4 origin = float4(signedUnit(rng) * 4.0f, signedUnit(rng) * 4.0f, signedUnit(rng) * 4.0f, 0.0f);
+		const float target[3] = { signedUnit(rng), signedUnit(rng), signedUnit(rng) };
+		const float4 dir = float4(target[0] - origin.x, target[1] - origin.y, target[2] - origin.z, 0.0f);
+		const RayPrecomp rp = PrecomputeRay(origin, dir);
+
+		TrianglePacket<lanes> tris = {};
+		BoxPacket<lanes> boxes = {};
+		tris.count = countDist(rng);
+		boxes.count = countDist(rng);
+		for (uint32_t i = 0; i < lanes; i++)
+		{
+			const float size = 0.05f + unit(rng);
+			float corners[3][3];
+			for (uint32_t k = 0; k < 3; k++)
+			{
+				for (uint32_t a = 0; a < 3; a++)
+				{
+					corners[k][a] = target[a] + signedUnit(rng) * size;
+				}
+			}
+			SetTriangle(tris, i, corners[0], corners[1], corners[2]);
+
+			float bmin[3], bmax[3];
+			for (uint32_t a = 0; a < 3; a++)
+			{
+				bmin[a] = std::min(corners[0][a], corners[1][a]);
+				bmax[a] = std::max(corners[0][a], corners[1][a]);
+			}
+			SetBox(boxes, i, bmin, bmax);
+		}
+
+		const float tMin = (unit(rng) < 0.5f) ? 0.0f : unit(rng) * 0.5f;
+		const float tMax = (unit(rng) < 0.5f) ? INFINITY : 0.5f + unit(rng);
+		CompareTriangles(rp, tris, tMin, tMax, triStats);
+		CompareBoxes(rp, boxes, tMin, tMax, boxStats);
+
+		float t[lanes], u[lanes], v[lanes], entries[lanes];
+		const uint32_t triHits = RayTrianglesScalar(rp, tris, tMin, tMax, t, u, v);
+		if (triHits != 0)
+		{
+			const float hitT = t[std::countr_zero(triHits)];
+			CompareTriangles(rp, tris, tMin, hitT, triStats);
+			CompareTriangles(rp, tris, hitT, tMax, triStats);
+		}
+		const uint32_t boxHits = RayBoxesScalar(rp, boxes, tMin, tMax, entries);
+		if (boxHits != 0)
+		{
+			CompareBoxes(rp, boxes, entries[std::countr_zero(boxHits)], entries[std::countr_zero(boxHits)], boxStats);
+		}
+	}
+}
+
+// Every ordered triple of points on the {-1, 0, 1} lattice (collinear, repeated and zero-area triangles included) against rays
+// along every lattice direction, from origins on vertices, edges, and faces; most hits land exactly on edges or vertices
+template<uint32_t lanes>
+static void LatticeTriangles(AgreementStats* stats)
+{
+	std::vector<float> lattice;
+	for (int z = -1; z <= 1; z++)
+	{
+		for (int y = -1; y <= 1; y++)
+		{
+			for (int x = -1; x <= 1; x++)
+			{
+				lattice.insert(lattice.end(), { static_cast<float>(x), static_cast<float>(y), static_cast<float>(z) });
+			}
+		}
+	}
+
+	const float4 origins[] = { float4(0.0f, 0.0f, 0.0f, 0.0f), float4(0.5f, 0.0f, -3.0f, 0.0f), float4(-3.0f, 0.5f, 0.5f, 0.0f), float4(-2.0f, -2.0f, -2.0f, 0.0f),
+							   float4(0.25f, -0.75f, 4.0f, 0.0f) };
+	const uint32_t numLattice = static_cast<uint32_t>(lattice.size() / 3);
+	for (const float4& origin : origins)
+	{
+		for (int d = 0; d < 27; d++)
+		{
+			if (d == 13)
+			{
+				continue; // Zero direction
+			}
+			const RayPrecomp rp = PrecomputeRay(origin, float4(static_cast<float>(d % 3 - 1), static_cast<float>((d / 3) % 3 - 1), static_cast<float>(d / 9 - 1), 0.0f));
+
+			TrianglePacket<lanes> packet = {};
+			for (uint32_t tri = 0; tri < numLattice * numLattice * numLattice; tri++)
+			{
+				SetTriangle(packet, packet.count++, &lattice[(tri % numLattice) * 3], &lattice[((tri / numLattice) % numLattice) * 3],
+							&lattice[(tri / (numLattice * numLattice)) * 3]);
+				if (packet.count == lanes)
+				{
+					CompareTriangles(rp, packet, 0.0f, INFINITY, stats);
+					packet.count = 0;
+				}
+			}
+		}
+	}
+}
+
+// Every pair of lattice corners as a box (flat and inverted boxes included), against lattice-direction rays from origins inside,
+// outside, and on slab planes (zero direction components there make NaN slab distances)
+template<uint32_t lanes>
+static void LatticeBoxes(AgreementStats* stats)
+{
+	const float4 origins[] = { float4(0.0f, 0.0f, 0.0f, 0.0f), float4(1.0f, -1.0f, 0.0f, 0.0f), float4(-3.0f, 0.0f, 0.5f, 0.0f), float4(2.0f, 2.0f, -2.0f, 0.0f),
+							   float4(0.5f, 0.5f, 0.5f, 0.0f) };
+	const float ranges[][2] = { { 0.0f, INFINITY }, { 0.0f, 0.0f }, { 1.0f, 2.0f }, { -INFINITY, INFINITY } };
+	for (const float4& origin : origins)
+	{
+		for (int d = 0; d < 27; d++)
+		{
+			if (d == 13)
+			{
+				continue;
+			}
+			const RayPrecomp rp = PrecomputeRay(origin, float4(static_cast<float>(d % 3 - 1), static_cast<float>((d / 3) % 3 - 1), static_cast<float>(d / 9 - 1), 0.0f));
+			for (const auto& range : ranges)
+			{
+				BoxPacket<lanes> packet = {};
+				for (uint32_t box = 0; box < 27 * 27; box++)
+				{
+					const uint32_t lo = box % 27, hi = box / 27;
+					const float bmin[3] = { static_cast<float>(lo % 3) - 1.0f, static_cast<float>((lo / 3) % 3) - 1.0f, static_cast<float>(lo / 9) - 1.0f };
+					const float bmax[3] = { static_cast<float>(hi % 3) - 1.0f, static_cast<float>((hi / 3) % 3) - 1.0f, static_cast<float>(hi / 9) - 1.0f };
+					SetBox(packet, packet.count++, bmin, bmax);
+					if (packet.count == lanes)
+					{
+						CompareBoxes(rp, packet, range[0], range[1], stats);
+						packet.count = 0;
+					}
+				}
+			}
+		}
+	}
+}
+
+// Non-finite and extreme inputs: infinite/NaN vertices and bounds, denormal and huge coordinates, and near-parallel rays
+template<uint32_t lanes>
+static void SpecialValues(std::mt19937& rng, AgreementStats* triStats, AgreementStats* boxStats)
+{
+	const float inf = INFINITY, nan = std::numeric_limits<float>::quiet_NaN();
+	const float specials[] = { 0.0f, -0.0f, 1.0f, -1.0f, inf, -inf, nan, 1e-40f, -1e-40f, 1e30f, -1e30f, std::numeric_limits<float>::min(),
+							   std::numeric_limits<float>::max(), 0.5f };
+	constexpr uint32_t numSpecials = sizeof(specials) / sizeof(specials[0]);
+	std::uniform_int_distribution<uint32_t> pick(0, numSpecials - 1);
+	std::uniform_real_distribution<float> signedUnit(-1.0f, 1.0f);
+
+	for (uint32_t r = 0; r < 2000; r++)
+	{
+		// Half the rays have special components themselves; the rest are ordinary rays skimming nearly along an axis
+		const bool specialRay = (r % 2) == 0;
+		const float4 origin = specialRay ? float4(specials[pick(rng)], specials[pick(rng)], specials[pick(rng)], 0.0f) : float4(signedUnit(rng), signedUnit(rng), -2.0f, 0.0f);
+		const float4 dir = specialRay ? float4(specials[pick(rng)], specials[pick(rng)], specials[pick(rng)], 0.0f) : float4(signedUnit(rng) * 1e-7f, signedUnit(rng) * 1e-7f, 1.0f, 0.0f);
+		const RayPrecomp rp = PrecomputeRay(origin, dir);
+
+		TrianglePacket<lanes> tris = {};
+		BoxPacket<lanes> boxes = {};
+		tris.count = lanes;
+		boxes.count = lanes;
+		for (uint32_t i = 0; i < lanes; i++)
+		{
+			float corners[3][3];
+			for (uint32_t k = 0; k < 3; k++)
+			{
+				for (uint32_t a = 0; a < 3; a++)
+				{
+					corners[k][a] = (pick(rng) < 3) ? specials[pick(rng)] : signedUnit(rng);
+				}
+			}
+			SetTriangle(tris, i, corners[0], corners[1], corners[2]);
+			SetBox(boxes, i, corners[0], corners[1]);
+		}
+		CompareTriangles(rp, tris, 0.0f, INFINITY, triStats);
+		CompareBoxes(rp, boxes, 0.0f, INFINITY, boxStats);
+		CompareBoxes(rp, boxes, specials[pick(rng)], specials[pick(rng)], boxStats);
+	}
+}
+
+template<uint32_t lanes>
+static void VerifyWidth(std::mt19937& rng, uint32_t& numFailures)
+{
+	char label[64];
+	AgreementStats randomTris, randomBoxes;
+	RandomCases<lanes>(rng, 20000, &randomTris, &randomBoxes);
+	snprintf(label, sizeof(label), "%u-lane triangles, random", lanes);
+	Report(label, randomTris, numFailures);
+	snprintf(label, sizeof(label), "%u-lane boxes, random", lanes);
+	Report(label, randomBoxes, numFailures);
+
+	AgreementStats latticeTris, latticeBoxes;
+	LatticeTriangles<lanes>(&latticeTris);
+	LatticeBoxes<lanes>(&latticeBoxes);
+	snprintf(label, sizeof(label), "%u-lane triangles, lattice", lanes);
+	Report(label, latticeTris, numFailures);
+	snprintf(label, sizeof(label), "%u-lane boxes, lattice", lanes);
+	Report(label, latticeBoxes, numFailures);
+
+	AgreementStats specialTris, specialBoxes;
+	SpecialValues<lanes>(rng, &specialTris, &specialBoxes);
+	snprintf(label, sizeof(label), "%u-lane triangles, special values", lanes);
+	Report(label, specialTris, numFailures);
+	snprintf(label, sizeof(label), "%u-lane boxes, special values", lanes);
+	Report(label, specialBoxes, numFailures);
+}
+
+bool IntersectionSIMDVerification()
+{
+	uint32_t numFailures = 0;
+	std::mt19937 rng(4242);
+
+#if defined(INTERSECTION_AVX2)
+	printf("kernels: SSE2 (4 lanes), AVX2 (8 lanes)\n");
+#elif defined(INTERSECTION_SSE)
+	printf("kernels: SSE2 (4 lanes, 8 lanes as two halves)\n");
+#else
+	printf("kernels: scalar fallback\n");
+#endif
+
+	VerifyWidth<4>(rng, numFailures);
+	VerifyWidth<8>(rng, numFailures);
+
+	// Packing from indexed meshes; a lattice triangle list, with [count] past some of the packets' lanes
+	{
+		const float4 positions[] = { float4(-1.0f, -1.0f, 0.0f, 0.0f), float4(1.0f, -1.0f, 0.0f, 0.0f), float4(1.0f, 1.0f, 0.0f, 0.0f), float4(-1.0f, 1.0f, 0.0f, 0.0f) };
+		IndexedTriangle tris[2];
+		tris[0].xyz = uint4(0, 1, 2, 0);
+		tris[1].xyz = uint4(0, 2, 3, 0);
+		const uint32_t order[] = { 1, 0 };
+
+		TrianglePacket<8> packet;
+		PackTriangles(positions, sizeof(float4), tris, order, 2, &packet);
+		float t[8], u[8], v[8];
+		const RayPrecomp diagonal = PrecomputeRay(float4(0.0f, 0.0f, -1.0f, 0.0f), float4(0.0f, 0.0f, 1.0f, 0.0f));
+		const uint32_t mask = RayTriangles8(diagonal, packet, 0.0f, INFINITY, t, u, v);
+		VERIFY(mask == 3 && t[0] == 1.0f && t[1] == 1.0f, "packed quad: rays down its shared diagonal should hit both halves (mask %02x)", mask);
+
+		const float bmin[3] = { -1.0f, -1.0f, -1.0f }, bmax[3] = { 1.0f, 1.0f, 1.0f };
+		const float* mins[] = { bmin }, * maxs[] = { bmax };
+		BoxPacket<4> boxes;
+		PackBoxes(mins, maxs, 1, &boxes);
+		float entries[4];
+		VERIFY(RayBoxes4(diagonal, boxes, -INFINITY, INFINITY, entries) == 1, "packed box: zeroed lanes past [count] mustn't be reported");
+	}
+
+	return numFailures == 0;
+}
@@ -0,0 +1,313 @@
+#include "Verification.h"
+#include "../TestScenes.h"
+#include "../../SandboxApp/PacketBVH.h"
+#include "../../SandboxApp/Intersection.h"
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <vector>
+
+struct PacketTestMesh
+{
+	std::vector<float4> positions;
+	std::vector<IndexedTriangle> tris;
+};
+
+static PacketTestMesh PacketTriangleSoup(uint32_t numTris, float size, std::mt19937& rng)
+{
+	std::uniform_real_distribution<float> centerDist(-size, size), offsetDist(-0.05f * size, 0.05f * size);
+	PacketTestMesh mesh;
+	for (uint32_t i = 0; i < numTris; i++)
+	{
+		const float cx = centerDist(rng), cy = centerDist(rng), cz = centerDist(rng);
+		IndexedTriangle tri;
+		tri.xyz = uint4(i * 3, i * 3 + 1, i * 3 + 2, 0);
+		mesh.tris.push_back(tri);
+		for (uint32_t k = 0; k < 3; k++)
+		{
+			mesh.positions.push_back(float4(cx + offsetDist(rng), cy + offsetDist(rng), cz + offsetDist(rng), 0.0f));
+		}
+	}
+	return mesh;
+}
+
+static bool PacketBruteForceClosest(const PacketTestMesh& mesh, const PacketBVH::Ray& ray, float* outT)
+{
+	const RayPrecomp rp = PrecomputeRay(ray.origin, ray.dir);
+	float tMax = ray.tMax;
+	bool found = false;
+	for (const IndexedTriangle& tri : mesh.tris)
+	{
+		float t, u, v;
+		if (RayTriangle(rp, mesh.positions[tri.xyz.x], mesh.positions[tri.xyz.y], mesh.positions[tri.xyz.z], ray.tMin, tMax, &t, &u, &v) && (!found || t < tMax))
+		{
+			tMax = t;
+			found = true;
+		}
+	}
+	*outT = tMax;
+	return found;
+}
+
+// Whether [hit] is a valid answer for [ray], given the reference result: same distance, and a triangle that reproduces it
+static bool PacketHitMatches(const PacketTestMesh& mesh, const PacketBVH::Ray& ray, bool hasHit, const PacketBVH::Hit& hit, bool refHit, float refT)
+{
+	if (hasHit != refHit)
+	{
+		return false;
+	}
+	if (!hasHit)
+	{
+		return hit.tri == PacketBVH::invalidTri;
+	}
+	if (hit.t != refT || hit.tri >= mesh.tris.size())
+	{
+		return false;
+	}
+	const IndexedTriangle& tri = mesh.tris[hit.tri];
+	float t, u, v;
+	return RayTriangle(PrecomputeRay(ray.origin, ray.dir), mesh.positions[tri.xyz.x], mesh.positions[tri.xyz.y], mesh.positions[tri.xyz.z], ray.tMin, ray.tMax, &t, &u, &v) &&
+		   t == hit.t && u == hit.u && v == hit.v;
+}
+
+// Converts [bvh] (built over [mesh]) and checks single rays against brute force, then packets (sharing an origin, or not) and sorted
+// streams against single rays
+static uint32_t VerifyPacketBVH(const char* label, const BVH& bvh, const PacketTestMesh& mesh, uint32_t numRays, std::mt19937& rng)
+{
+	uint32_t numFailures = 0;
+	PacketBVH packetBVH;
+	packetBVH.Build(bvh, mesh.positions.data(), mesh.positions.size(), sizeof(float4), mesh.tris.data());
+	uint32_t expectedPackets = 0;
+	for (uint32_t n = 0; n < bvh.NumNodes(); n++)
+	{
+		expectedPackets += (bvh.Nodes()[n].triCount + 7) / 8;
+	}
+	VERIFY(packetBVH.NumNodes() == bvh.NumNodes() && packetBVH.NumTris() == mesh.tris.size() && packetBVH.NumPackets() == expectedPackets,
+		   "%s: unexpected node/packet/triangle counts", label);
+
+	if (mesh.tris.empty())
+	{
+		PacketBVH::Ray rays[3];
+		for (PacketBVH::Ray& ray : rays)
+		{
+			ray = { float4(0.0f, 0.0f, -1.0f, 0.0f), float4(0.0f, 0.0f, 1.0f, 0.0f), 0.0f, INFINITY };
+		}
+		PacketBVH::Hit hits[3];
+		uint32_t order[3] = { 0, 1, 2 };
+		bool occluded[3] = { true, true, true };
+		VERIFY(!packetBVH.ClosestHit(rays[0], &hits[0]) && hits[0].tri == PacketBVH::invalidTri && !packetBVH.AnyHit(rays[0]), "%s: an empty tree reported a hit", label);
+		VERIFY(packetBVH.ClosestHitPacket(rays, 3, hits) == 0 && hits[2].tri == PacketBVH::invalidTri && packetBVH.AnyHitPacket(rays, 3) == 0,
+			   "%s: an empty tree reported a packet hit", label);
+		VERIFY(packetBVH.ClosestHitStream(rays, order, 3, hits) == 0 && packetBVH.AnyHitStream(rays, order, 3, occluded) == 0 && !occluded[1],
+			   "%s: an empty tree reported a stream hit", label);
+		printf("%s: checked an empty tree\n", label);
+		packetBVH.DeInit();
+		return numFailures;
+	}
+
+	const ComputeBVH_Node& root = bvh.Nodes()[0];
+	const float sceneMin[3] = { root.boundsMin.x, root.boundsMin.y, root.boundsMin.z };
+	const float sceneMax[3] = { root.boundsMax.x, root.boundsMax.y, root.boundsMax.z };
+	std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+	const float extent = std::max({ sceneMax[0] - sceneMin[0], sceneMax[1] - sceneMin[1], sceneMax[2] - sceneMin[2], 1e-3f });
+	auto pointIn = [&](float margin)
+	{
+		return float4(sceneMin[0] - margin + unit(rng) * (sceneMax[0] - sceneMin[0] + 2.0f * margin),
+					  sceneMin[1] - margin + unit(rng) * (sceneMax[1] - sceneMin[1] + 2.0f * margin),
+					  sceneMin[2] - margin + unit(rng) * (sceneMax[2] - sceneMin[2] + 2.0f * margin), 0.0f);
+	};
+	auto rayTowards = [&](const float4& origin, const float4& target)
+	{
+		return PacketBVH::Ray{ origin, float4(target.x - origin.x, target.y - origin.y, target.z - origin.z, 0.0f), 0.0f, (rng() % 4 == 0) ? 0.5f : INFINITY };
+	};
+
+	// Single rays against brute force
+	uint32_t numHits = 0;
+	for (uint32_t r = 0; r < numRays; r++)
+	{
+		const PacketBVH::Ray ray = rayTowards(pointIn(extent * 0.5f), pointIn(0.0f));
+		float refT;
+		const bool refHit = PacketBruteForceClosest(mesh, ray, &refT);
+		PacketBVH::Hit hit;
+		const bool hasHit = packetBVH.ClosestHit(ray, &hit);
+		VERIFY(PacketHitMatches(mesh, ray, hasHit, hit, refHit, refT), "%s: ray %u closest-hit disagrees with brute force (t = %f vs %f)", label, r, hit.t, refT);
+		VERIFY(packetBVH.AnyHit(ray) == refHit, "%s: ray %u any-hit disagrees with brute force", label, r);
+		numHits += refHit ? 1 : 0;
+	}
+
+	// Packets against single rays: camera-style grids from one origin (from outside the scene and inside it, so frustums see boxes on
+	// every side), then rays from scattered origins; sizes include partial packets
+	PacketBVH::TraceCounts packetCounts = {};
+	const uint32_t packetSizes[] = { 64, 16, 37, 1 };
+	uint32_t numPackets = 0;
+	for (uint32_t p = 0; p < std::max(numRays / 16, 4u); p++)
+	{
+		const uint32_t kind = p % 3;
+		const uint32_t size = packetSizes[(p / 3) % 4];
+		const float4 origin = pointIn((kind == 0) ? extent : 0.0f);
+		const float4 center = pointIn(0.0f);
+		const float spread = extent * ((p % 2 == 0) ? 0.05f : 0.5f);
+		const uint32_t side = static_cast<uint32_t>(std::ceil(std::sqrt(static_cast<float>(size))));
+		PacketBVH::Ray rays[PacketBVH::maxPacketRays];
+		for (uint32_t i = 0; i < size; i++)
+		{
+			const float4 target = float4(center.x + spread * ((i % side) / static_cast<float>(side) - 0.5f),
+										 center.y + spread * ((i / side) / static_cast<float>(side) - 0.5f), center.z, 0.0f);
+			rays[i] = (kind == 2) ? rayTowards(pointIn(extent * 0.5f), pointIn(0.0f)) : rayTowards(origin, target);
+		}
+
+		PacketBVH::Hit hits[PacketBVH::maxPacketRays];
+		const uint64_t hitMask = packetBVH.ClosestHitPacket(rays, size, hits, &packetCounts);
+		const uint64_t occludedMask = packetBVH.AnyHitPacket(rays, size, &packetCounts);
+		for (uint32_t i = 0; i < size; i++)
+		{
+			PacketBVH::Hit refHit;
+			const bool refHasHit = packetBVH.ClosestHit(rays[i], &refHit);
+			VERIFY(PacketHitMatches(mesh, rays[i], ((hitMask >> i) & 1) != 0, hits[i], refHasHit, refHit.t), "%s: packet %u ray %u closest-hit disagrees with single rays",
+				   label, p, i);
+			VERIFY(((occludedMask >> i) & 1) == (refHasHit ? 1u : 0u), "%s: packet %u ray %u any-hit disagrees with single rays", label, p, i);
+		}
+		VERIFY(size == 64 || (hitMask >> size) == 0, "%s: packet %u reported hits past its %u rays", label, p, size);
+		numPackets++;
+	}
+
+	// Sorted streams against single rays, including a partial chunk
+	const uint32_t streamSize = PacketBVH::streamRays * 2 + 77;
+	std::vector<PacketBVH::Ray> streamRays(streamSize);
+	for (PacketBVH::Ray& ray : streamRays)
+	{
+		ray = rayTowards(pointIn(extent * 0.5f), pointIn(0.0f));
+	}
+	std::vector<uint64_t> scratch(streamSize * 2);
+	std::vector<uint32_t> order(streamSize);
+	packetBVH.SortStream(streamRays.data(), streamSize, scratch.data(), order.data());
+	std::vector<bool> seen(streamSize, false);
+	bool permutation = true;
+	for (uint32_t i = 0; i < streamSize; i++)
+	{
+		permutation = permutation && order[i] < streamSize && !seen[order[i]];
+		seen[order[i] % streamSize] = true;
+	}
+	VERIFY(permutation, "%s: the stream order isn't a permutation of the rays", label);
+
+	std::vector<PacketBVH::Hit> streamHits(streamSize);
+	bool occluded[streamSize];
+	PacketBVH::TraceCounts streamCounts = {};
+	const uint32_t numStreamHits = permutation ? packetBVH.ClosestHitStream(streamRays.data(), order.data(), streamSize, streamHits.data(), &streamCounts) : 0;
+	const uint32_t numOccluded = permutation ? packetBVH.AnyHitStream(streamRays.data(), order.data(), streamSize, occluded, &streamCounts) : 0;
+	uint32_t refStreamHits = 0;
+	for (uint32_t i = 0; i < streamSize && permutation; i++)
+	{
+		PacketBVH::Hit refHit;
+		const bool refHasHit = packetBVH.ClosestHit(streamRays[i], &refHit);
+		refStreamHits += refHasHit ? 1 : 0;
+		VERIFY(PacketHitMatches(mesh, streamRays[i], streamHits[i].tri != PacketBVH::invalidTri, streamHits[i], refHasHit, refHit.t),
+			   "%s: stream ray %u closest-hit disagrees with single rays", label, i);
+		VERIFY(occluded[i] == refHasHit, "%s: stream ray %u any-hit disagrees with single rays", label, i);
+	}
+	VERIFY(!permutation || (numStreamHits == refStreamHits && numOccluded == refStreamHits), "%s: stream hit counts (%u closest, %u any) don't match single rays (%u)",
+		   label, numStreamHits, numOccluded, refStreamHits);
+
+	printf("%s: %u nodes, %u leaf packets; checked %u rays against brute force (%u hits), %u packets (%llu frustum culls) and %u streamed rays against single rays\n",
+		   label, packetBVH.NumNodes(), packetBVH.NumPackets(), numRays, numHits, numPackets, static_cast<unsigned long long>(packetCounts.frustumCulls), streamSize);
+
+	packetBVH.DeInit();
+	return numFailures;
+}
+
+bool PacketBVHVerification()
+{
+	uint32_t numFailures = 0;
+	std::mt19937 rng(4343);
+
+	BVH::BinnedSAHSettings sahSettings;
+	sahSettings.numThreads = 1;
+
+	// Degenerate inputs
+	{
+		const PacketTestMesh empty, single = PacketTriangleSoup(1, 1.0f, rng);
+		BVH bvh;
+		bvh.BuildBinnedSAH(empty.positions.data(), 0, sizeof(float4), empty.tris.data(), 0, sahSettings);
+		numFailures += VerifyPacketBVH("empty", bvh, empty, 0, rng);
+		bvh.DeInit();
+
+		bvh.BuildBinnedSAH(single.positions.data(), single.positions.size(), sizeof(float4), single.tris.data(), 1, sahSettings);
+		numFailures += VerifyPacketBVH("one triangle", bvh, single, 256, rng);
+		bvh.DeInit();
+
+		// Identical triangles tie at every distance, so only the distance (and a triangle reproducing it) is checked
+		PacketTestMesh stacked = PacketTriangleSoup(1, 1.0f, rng);
+		for (uint32_t i = 1; i < 100; i++)
+		{
+			IndexedTriangle tri = stacked.tris[0];
+			stacked.tris.push_back(tri);
+		}
+		BVH::BinnedSAHSettings settings = sahSettings;
+		settings.leafTris = 4;
+		settings.maxLeafTris = 4;
+		bvh.BuildBinnedSAH(stacked.positions.data(), stacked.positions.size(), sizeof(float4), stacked.tris.data(), 100, settings);
+		numFailures += VerifyPacketBVH("stacked triangles", bvh, stacked, 256, rng);
+		bvh.DeInit();
+	}
+
+	// Soups under leaves filling part of a packet, one, and several; then a building with spatial splits (duplicated references)
+	{
+		const PacketTestMesh soup = PacketTriangleSoup(3000, 1.0f, rng);
+		const uint32_t leafSizes[] = { 1, 8, 20 };
+		for (uint32_t leafSize : leafSizes)
+		{
+			char label[64];
+			BVH::BinnedSAHSettings settings = sahSettings;
+			settings.leafTris = leafSize;
+			settings.maxLeafTris = leafSize;
+			BVH bvh;
+			bvh.BuildBinnedSAH(soup.positions.data(), soup.positions.size(), sizeof(float4), soup.tris.data(), static_cast<uint32_t>(soup.tris.size()), settings);
+			snprintf(label, sizeof(label), "soup, %u-triangle leaves", leafSize);
+			numFailures += VerifyPacketBVH(label, bvh, soup, 1024, rng);
+			bvh.DeInit();
+		}
+
+		PacketTestMesh building;
+		BuildArchitecturalScene(2, 3, 4, building.positions, building.tris);
+		BVH::BinnedSAHSettings spatialSettings = sahSettings;
+		spatialSettings.spatialSplits = true;
+		spatialSettings.leafTris = 8;
+		BVH bvh;
+		bvh.BuildBinnedSAH(building.positions.data(), building.positions.size(), sizeof(float4), building.tris.data(), static_cast<uint32_t>(building.tris.size()),
+						   spatialSettings);
+		numFailures += VerifyPacketBVH("building, spatial splits", bvh, building, 1024, rng);
+		bvh.DeInit();
+	}
+
+	// Real geometry
+	{
+		SceneBuffers buffers;
+		buffers.Init(64 * 1024, 128 * 1024, 1);
+		if (LoadTestObj("../Models/stanford-bunny.obj", buffers))
+		{
+			PacketTestMesh bunny;
+			const GeoTypes::Vertex3D* vts = reinterpret_cast<const GeoTypes::Vertex3D*>(&buffers.BufferContents(SceneBuffers::VBUFFER)[0]);
+			const IndexedTriangle* tris = reinterpret_cast<const IndexedTriangle*>(&buffers.BufferContents(SceneBuffers::TRIBUFFER)[0]);
+			for (uint64_t i = 0; i < buffers.NumVerts(); i++)
+			{
+				bunny.positions.push_back(vts[i].pos);
+			}
+			bunny.tris.assign(tris, tris + buffers.NumTris());
+
+			BVH::BinnedSAHSettings settings = sahSettings;
+			settings.leafTris = 8;
+			BVH bvh;
+			bvh.BuildBinnedSAH(bunny.positions.data(), bunny.positions.size(), sizeof(float4), bunny.tris.data(), static_cast<uint32_t>(bunny.tris.size()), settings);
+			numFailures += VerifyPacketBVH("bunny", bvh, bunny, 256, rng);
+			bvh.DeInit();
+		}
+		else
+		{
+			printf("couldn't load stanford-bunny.obj, skipped\n");
+		}
+		buffers.DeInit();
+	}
+
+	return numFailures == 0;
+}
@@ -0,0 +1,286 @@
+#include "Verification.h"
+#include "../../HeadlessTracer/TraceKernel.h"
+#include "../../HeadlessTracer/EmitterTable.h"
+#include "../../SandboxApp/BVH.h"
+#include "../../SandboxApp/StacklessBVH.h"
+#include "../../Shaders/filmSPD.h"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+// Russian roulette keeps the headless tracer's paths unbiased: inside a closed box whose walls all emit [boxRadiance] and reflect
+// [albedo] of what reaches them, every path with [maxBounces] bounces carries radiance * (1 + a + a^2 .. + a^maxBounces)
+// - Fixed-depth paths are the reference: they land on that sum, give or take the odd ray slipping out between two walls' triangles
+//   (which takes the rest of its path's light with it, roulette or not)
+// - Roulette paths end early, but weigh survivors up to make up for it, so their mean converges on the reference's: within four
+//   standard errors (of the two together) at each of a few sample counts, and closer as they grow
+// - The box is wound inwards (clockwise seen from inside), so its walls' front faces light the camera at its centre
+// - Cases cover roulette with and without next-event estimation, with hero wavelengths, from the first bounce, and with long caps
+constexpr float boxRadiance = 1.0f;
+constexpr uint32_t boxCells = 4; // Quads per box edge, two triangles each
+
+struct RouletteBox
+{
+	std::vector<GeoTypes::Vertex3D> vts;
+	std::vector<IndexedTriangle> tris;
+};
+
+// Unit box around the origin, wound so its front faces point inwards
+static RouletteBox InwardBox()
+{
+	RouletteBox box;
+	for (uint32_t axis = 0; axis < 3; axis++)
+	{
+		for (float side = -1.0f; side <= 1.0f; side += 2.0f)
+		{
+			for (uint32_t i = 0; i < boxCells; i++)
+			{
+				for (uint32_t j = 0; j < boxCells; j++)
+				{
+					// Corners of cell [i, j] on the face at [side] along [axis]
+					float corners[4][3];
+					for (uint32_t c = 0; c < 4; c++)
+					{
+						const float u = -1.0f + 2.0f * (i + ((c == 1 || c == 2) ? 1 : 0)) / boxCells;
+						const float v = -1.0f + 2.0f * (j + ((c >= 2) ? 1 : 0)) / boxCells;
+						corners[c][axis] = side;
+						corners[c][(axis + 1) % 3] = u;
+						corners[c][(axis + 2) % 3] = v;
+					}
+
+					const uint32_t quad[2][3] = { { 0, 1, 2 }, { 0, 2, 3 } };
+					for (uint32_t t = 0; t < 2; t++)
+					{
+						// Front-face normals are (v2 - v0) x (v1 - v0) (see TraceKernel.cpp); flip whichever way points out of the box
+						const float* p0 = corners[quad[t][0]];
+						const float* p1 = corners[quad[t][1]];
+						const float* p2 = corners[quad[t][2]];
+						const float e1[3] = { p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2] };
+						const float e2[3] = { p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2] };
+						const float normalOnAxis = e1[(axis + 1) % 3] * e2[(axis + 2) % 3] - e1[(axis + 2) % 3] * e2[(axis + 1) % 3];
+						const bool flip = (normalOnAxis * side > 0.0f);
+
+						const uint32_t first = static_cast<uint32_t>(box.vts.size());
+						for (uint32_t k = 0; k < 3; k++)
+						{
+							const float* p = corners[quad[t][(flip && k > 0) ? 3 - k : k]];
+							GeoTypes::Vertex3D vt = {};
+							vt.pos = float4(p[0], p[1], p[2], 0.0f);
+							box.vts.push_back(vt);
+						}
+						IndexedTriangle tri;
+						tri.xyz = uint4(first, first + 1, first + 2, 0);
+						box.tris.push_back(tri);
+					}
+				}
+			}
+		}
+	}
+	return box;
+}
+
+struct RouletteCase
+{
+	const char* name;
+	bool roulette;
+	uint32_t rouletteMinBounces;
+	uint32_t maxBounces;
+	float albedo;
+	bool sampleLights;
+	uint32_t wavelengths;
+};
+
+constexpr uint32_t rouletteCheckpoints = 3; // Sample counts means are compared at: 1/16, 1/4, and all of a case's paths
+
+// Mean radiance of a case's paths (and its standard error) at each checkpoint, and how long its paths ran
+struct RouletteEstimate
+{
+	double means[rouletteCheckpoints];
+	double standardErrors[rouletteCheckpoints];
+	uint32_t numPaths[rouletteCheckpoints];
+	double meanBounces;
+	double escapedShare, rouletteShare; // Of paths ending in a miss (escaping the box), or by roulette
+};
+
+// Renders [numPaths] paths for [rouletteCase] from the box's centre (through an 8x8 film), through the same stages as [TracePixel] so
+// each path's radiance can be read back as it ends
+static RouletteEstimate RenderRouletteCase(const RouletteCase& rouletteCase, const TraceKernelScene& scene, uint32_t numPaths)
+{
+	TraceKernelSettings settings = {};
+	settings.width = 8;
+	settings.height = 8;
+	settings.spp = 1;
+	settings.vfov = 1.0f;
+	settings.cameraRotation[3] = 1.0f;
+	settings.albedo = rouletteCase.albedo;
+	settings.skyRadiance = 0.0f;
+	settings.maxBounces = rouletteCase.maxBounces;
+	settings.rayOffset = 1e-4f;
+	settings.wavelengths = rouletteCase.wavelengths;
+	settings.bxdf = traceKernelBxDFs[0].id;
+	settings.roughness = 0.5f;
+	settings.ior = 1.5f;
+	settings.sampleLights = rouletteCase.sampleLights;
+	settings.roulette = rouletteCase.roulette;
+	settings.rouletteMinBounces = rouletteCase.rouletteMinBounces;
+
+	TracePath path = {};
+	path.prngState[0] = 0x9e3779b9u;
+	path.prngState[1] = 0x243f6a88u;
+	path.prngState[2] = 0xb7e15162u;
+	path.prngState[3] = 0x12345678u;
+
+	RouletteEstimate estimate = {};
+	double sum = 0.0, sumSquares = 0.0;
+	uint64_t numBounces = 0, numEscaped = 0, numRouletteEnded = 0;
+	uint32_t checkpoint = 0;
+	for (uint32_t p = 0; p < numPaths; p++)
+	{
+		float sums[4] = {};
+		BeginPath(settings, p % settings.width, (p / settings.width) % settings.height, &path);
+		uint32_t bounce = 0;
+		for (; ; bounce++)
+		{
+			float distance = 0.0f;
+			const uint32_t hitTri = TraceShaderRay(scene, path, &distance);
+			if (!ShadePath(scene, settings, &path, bounce, hitTri, distance, sums))
+			{
+				numEscaped += (hitTri == UINT32_MAX) ? 1 : 0;
+				break;
+			}
+		}
+		numBounces += bounce;
+		numRouletteEnded += path.rouletteEnded ? 1 : 0;
+
+		// Every wavelength sees the same grey box, so hero paths average theirs
+		double radiance = 0.0;
+		for (uint32_t i = 0; i < rouletteCase.wavelengths; i++)
+		{
+			radiance += path.radiance[i];
+		}
+		radiance /= rouletteCase.wavelengths;
+		sum += radiance;
+		sumSquares += radiance * radiance;
+
+		const uint32_t checkpointPaths = numPaths >> (2 * (rouletteCheckpoints - 1 - checkpoint));
+		if (p + 1 == checkpointPaths)
+		{
+			const double n = checkpointPaths, mean = sum / n;
+			estimate.means[checkpoint] = mean;
+			estimate.standardErrors[checkpoint] = std::sqrt(std::max(sumSquares / n - mean * mean, 0.0) / n);
+			estimate.numPaths[checkpoint] = checkpointPaths;
+			checkpoint++;
+		}
+	}
+	estimate.meanBounces = static_cast<double>(numBounces) / numPaths;
+	estimate.escapedShare = static_cast<double>(numEscaped) / numPaths;
+	estimate.rouletteShare = static_cast<double>(numRouletteEnded) / numPaths;
+	return estimate;
+}
+
+// Checks a fixed-depth [rouletteCase] against the analytic sum, and returns it as the reference for roulette cases with its cap
+static uint32_t VerifyReference(const RouletteCase& rouletteCase, const TraceKernelScene& scene, uint32_t numPaths, RouletteEstimate* outReference)
+{
+	uint32_t numFailures = 0;
+	double expected = 0.0, bouncePower = 1.0;
+	for (uint32_t k = 0; k <= rouletteCase.maxBounces; k++)
+	{
+		expected += boxRadiance * bouncePower;
+		bouncePower *= rouletteCase.albedo;
+	}
+
+	const RouletteEstimate reference = RenderRouletteCase(rouletteCase, scene, numPaths);
+	const double mean = reference.means[rouletteCheckpoints - 1];
+	VERIFY(std::fabs(mean - expected) <= 0.01 * expected, "%s: paths average %.6f, expected %.6f", rouletteCase.name, mean, expected);
+	const double rayEscapes = reference.escapedShare / (reference.meanBounces + 1.0);
+	VERIFY(reference.rouletteShare == 0.0 && rayEscapes < 1e-3, "%s: %.2f%% of paths ended by roulette, %.2f%% escaped the box (%.3f%% of rays)",
+		   rouletteCase.name, 100.0 * reference.rouletteShare, 100.0 * reference.escapedShare, 100.0 * rayEscapes);
+	printf("%-34s %7u paths average %8.5f (analytically %8.5f), %5.2f bounces per path (%.2f%% escaped the box)\n", rouletteCase.name, numPaths, mean,
+		   expected, reference.meanBounces, 100.0 * reference.escapedShare);
+	*outReference = reference;
+	return numFailures;
+}
+
+// Checks a roulette [rouletteCase]'s means against [reference]'s at every checkpoint, and that roulette shortened its paths
+static uint32_t VerifyRoulette(const RouletteCase& rouletteCase, const TraceKernelScene& scene, uint32_t numPaths, const RouletteEstimate& reference)
+{
+	uint32_t numFailures = 0;
+	const RouletteEstimate estimate = RenderRouletteCase(rouletteCase, scene, numPaths);
+	const double referenceMean = reference.means[rouletteCheckpoints - 1], referenceError = reference.standardErrors[rouletteCheckpoints - 1];
+	double maxSigmas = 0.0;
+	for (uint32_t c = 0; c < rouletteCheckpoints; c++)
+	{
+		const double error = std::fabs(estimate.means[c] - referenceMean);
+		const double standardError = std::sqrt(estimate.standardErrors[c] * estimate.standardErrors[c] + referenceError * referenceError);
+		VERIFY(error <= 4.0 * standardError, "%s: %u paths average %.6f, against the reference's %.6f (%.2f standard errors)", rouletteCase.name,
+			   estimate.numPaths[c], estimate.means[c], referenceMean, error / standardError);
+		maxSigmas = std::max(maxSigmas, error / standardError);
+	}
+	VERIFY(estimate.meanBounces >= rouletteCase.rouletteMinBounces && estimate.meanBounces < reference.meanBounces && estimate.rouletteShare > 0.0,
+		   "%s: roulette paths averaged %.2f bounces (%.1f%% ended by it), against the reference's %.2f", rouletteCase.name, estimate.meanBounces,
+		   100.0 * estimate.rouletteShare, reference.meanBounces);
+
+	const double finalError = std::fabs(estimate.means[rouletteCheckpoints - 1] - referenceMean) / referenceMean;
+	printf("%-34s %7u paths average %8.5f (%.2g from the reference, %.2f standard errors at worst), %5.2f bounces per path (%.1f%% ended by roulette)\n",
+		   rouletteCase.name, numPaths, estimate.means[rouletteCheckpoints - 1], finalError, maxSigmas, estimate.meanBounces, 100.0 * estimate.rouletteShare);
+	return numFailures;
+}
+
+bool RouletteVerification()
+{
+	uint32_t numFailures = 0;
+
+	RouletteBox box = InwardBox();
+	const uint32_t numTris = static_cast<uint32_t>(box.tris.size());
+	EmitterTable emitters;
+	emitters.Init(numTris);
+	emitters.AddTriangles(box.vts.data(), box.tris.data(), 0, numTris, boxRadiance);
+	emitters.Build(EmitterTable::Weighting::Power, numTris);
+
+	BVH bvh;
+	bvh.BuildBinnedSAH(&box.vts[0].pos, box.vts.size(), sizeof(GeoTypes::Vertex3D), box.tris.data(), numTris, BVH::BinnedSAHSettings());
+	StacklessBVH stackless;
+	stackless.Build(bvh, &box.vts[0].pos, box.vts.size(), sizeof(GeoTypes::Vertex3D), box.tris.data());
+	bvh.DeInit();
+
+	// A flat film (paths' radiance is read straight from them, but ending paths still resolve through it)
+	static FilmSPD_Piecewise flatFilm;
+	for (uint32_t i = 0; i < FILM_SPD_NUM_SAMPLES; i++)
+	{
+		flatFilm.spd_sample[i] = float4(1.0f, 1.0f, 1.0f, 0.0f);
+	}
+
+	TraceKernelScene scene;
+	scene.vertices = box.vts.data();
+	scene.tris = box.tris.data();
+	scene.nodes = &stackless.Nodes()[0];
+	scene.triList = &stackless.TriList()[0];
+	scene.filmSPD = &flatFilm;
+	scene.emitters = emitters.Entries();
+	scene.triEmitters = emitters.TriEmitters();
+	scene.numEmitters = emitters.NumEmitters();
+	VERIFY(scene.numEmitters == numTris, "the box lists %u emitters of %u triangles", scene.numEmitters, numTris);
+
+	// Each cap's fixed-depth reference first, then roulette cases against it
+	const RouletteCase cases[] =
+	{
+		{ "fixed depth (reference)", false, 0, 8, 0.75f, false, 1 },
+		{ "roulette after 3", true, 3, 8, 0.75f, false, 1 },
+		{ "roulette after 3, light sampling", true, 3, 8, 0.75f, true, 1 },
+		{ "roulette after 3, hero", true, 3, 8, 0.75f, false, traceKernelHeroWavelengths },
+		{ "fixed depth, dark walls", false, 0, 8, 0.3f, false, 1 },
+		{ "roulette after 0, dark walls", true, 0, 8, 0.3f, false, 1 },
+		{ "fixed depth, 64 bounces", false, 0, 64, 0.75f, false, 1 },
+		{ "roulette after 1, 64 bounces", true, 1, 64, 0.75f, true, 1 },
+	};
+	RouletteEstimate reference = {};
+	for (const RouletteCase& rouletteCase : cases)
+	{
+		numFailures += rouletteCase.roulette ? VerifyRoulette(rouletteCase, scene, 65536, reference) : VerifyReference(rouletteCase, scene, 65536, &reference);
+	}
+
+	stackless.DeInit();
+	emitters.DeInit();
+	return numFailures == 0;
+}
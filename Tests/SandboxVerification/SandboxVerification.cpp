@@ -0,0 +1,57 @@
+#include <iostream>
+#include <cstring>
+
+#include "../../CPUMemory.h"
+#include "Verification.h"
+
+struct TestEntry
+{
+    const char* name;
+    bool (*run)();
+};
+
+static const TestEntry tests[] =
+{
+    { "asreport", ASReportVerification },
+    { "bounds", BoundsVerification },
+    { "bvh", BVHVerification },
+    { "bxdf", BxDFVerification },
+    { "emittertable", EmitterTableVerification },
+    { "intersectionsimd", IntersectionSIMDVerification },
+    { "packetbvh", PacketBVHVerification },
+    { "roulette", RouletteVerification },
+    { "scenebuffers", SceneBuffersVerification },
+    { "scenequery", SceneQueryVerification },
+    { "sparseoctree", SparseOctreeVerification },
+    { "stacklessbvh", StacklessBVHVerification },
+    { "tilescheduler", TileSchedulerVerification },
+    { "twolevelas", TwoLevelASVerification },
+    { "widebvh", WideBVHVerification },
+};
+
+int main(int argc, char** argv)
+{
+    CPUMemory::Init();
+
+    // Run everything by default, or just the tests named on the command line
+    uint32_t numFailed = 0;
+    for (const TestEntry& test : tests)
+    {
+        bool selected = (argc <= 1);
+        for (int i = 1; i < argc; i++)
+        {
+            selected |= (strcmp(argv[i], test.name) == 0);
+        }
+
+        if (selected)
+        {
+            printf("== %s ==\n", test.name);
+            const bool passed = test.run();
+            printf("%s\n\n", passed ? "passed" : "FAILED");
+            numFailed += passed ? 0 : 1;
+        }
+    }
+
+    CPUMemory::DeInit();
+    return (numFailed > 0) ? 1 : 0;
+}
@@ -0,0 +1,304 @@
+#include "Verification.h"
+#include "../../SandboxApp/SceneBuffers.h"
+
+#include <cstring>
+#include <random>
+#include <vector>
+
+// Synthetic model; geometry is regenerated from [seed], so incremental edits and full rebuilds see identical inputs
+struct TestModel
+{
+	uint32_t seed;
+	uint64_t numVerts;
+	uint64_t numTris;
+	Material material;
+};
+
+static Material UniformMaterial(std::mt19937& rng)
+{
+	Material mat = {};
+	mat.isUniform = true;
+	mat.uniformRoughness = std::uniform_real_distribution<float>(0.0f, 1.0f)(rng);
+	for (uint32_t i = 0; i < MATERIAL_SPD_POINTS; i++)
+	{
+		mat.uniformSPD.points[i] = static_cast<uint8_t>(rng());
+	}
+	return mat;
+}
+
+static Material TexturedMaterial(std::mt19937& rng, uint16_t spectralX, uint16_t spectralY, uint16_t roughnessX, uint16_t roughnessY)
+{
+	Material mat = {};
+	mat.isUniform = false;
+
+	mat.spectralTexX = spectralX;
+	mat.spectralTexY = spectralY;
+	mat.spectralDataSize = spectralX * spectralY * sizeof(MaterialSPD_Piecewise);
+	mat.spectralData = CPUMemory::AllocateArray<MaterialSPD_Piecewise>(spectralX * spectralY);
+	for (uint32_t i = 0; i < spectralX * spectralY; i++)
+	{
+		for (uint32_t j = 0; j < MATERIAL_SPD_POINTS; j++)
+		{
+			mat.spectralData[i].points[j] = static_cast<uint8_t>(rng());
+		}
+	}
+
+	mat.roughnessTexX = roughnessX;
+	mat.roughnessTexY = roughnessY;
+	mat.roughnessDataSize = roughnessX * roughnessY * sizeof(float);
+	mat.roughnessData = CPUMemory::AllocateArray<float>(roughnessX * roughnessY);
+	for (uint32_t i = 0; i < roughnessX * roughnessY; i++)
+	{
+		mat.roughnessData[i] = std::uniform_real_distribution<float>(0.0f, 1.0f)(rng);
+	}
+
+	return mat;
+}
+
+static TestModel RandomModel(std::mt19937& rng, Material material)
+{
+	TestModel model;
+	model.seed = rng();
+	model.numVerts = 3 + rng() % 200;
+	model.numTris = 1 + rng() % 300;
+	model.material = material;
+	return model;
+}
+
+// Load-alike; writes vertices into the mirror's free space, then commits them with scene-global indices
+static void AddTestModel(SceneBuffers& buffers, const TestModel& model)
+{
+	std::mt19937 rng(model.seed);
+	std::uniform_real_distribution<float> dist(-10.0f, 10.0f);
+
+	auto vts = buffers.FreeVertices();
+	for (uint64_t i = 0; i < model.numVerts; i++)
+	{
+		vts[i].pos = float4(dist(rng), dist(rng), dist(rng), 0.0f);
+		vts[i].mat = float4(dist(rng), dist(rng), 12345.0f, 0.0f); // Junk material ID; [AddModel] should stamp over it
+		vts[i].normals = float4(dist(rng), dist(rng), dist(rng), 0.0f);
+	}
+
+	std::vector<uint64_t> ndces(model.numTris * 3);
+	for (uint64_t& ndx : ndces)
+	{
+		ndx = buffers.NumVerts() + (rng() % model.numVerts);
+	}
+
+	buffers.AddModel(model.numVerts, ndces.data(), ndces.size(), model.material);
+}
+
+// What the GPU holds: last-uploaded contents per-buffer
+struct GPUSnapshot
+{
+	std::vector<uint8_t> contents[SceneBuffers::NUM_BUFFERS];
+};
+
+static GPUSnapshot Snapshot(const SceneBuffers& buffers)
+{
+	GPUSnapshot snapshot;
+	for (uint32_t b = 0; b < SceneBuffers::NUM_BUFFERS; b++)
+	{
+		auto bytes = buffers.BufferContents(static_cast<SceneBuffers::BUFFER_IDS>(b));
+		snapshot.contents[b].assign(&bytes[0], &bytes[0] + bytes.arrayLen);
+	}
+	return snapshot;
+}
+
+// Resize to the mirror's current sizes (keeping existing contents, with grown space zeroed) and copy in patched bytes only
+// Returns patched bytes per-buffer through [outPatchedBytes]
+static void ApplyPatches(GPUSnapshot& snapshot, SceneBuffers& buffers, uint64_t* outPatchedBytes)
+{
+	const uint32_t numPatches = buffers.CollectPatches(nullptr);
+	std::vector<SceneBuffers::Patch> patches(numPatches);
+	buffers.CollectPatches(patches.data());
+
+	for (uint32_t b = 0; b < SceneBuffers::NUM_BUFFERS; b++)
+	{
+		const SceneBuffers::BUFFER_IDS buffer = static_cast<SceneBuffers::BUFFER_IDS>(b);
+		snapshot.contents[b].resize(buffers.BufferBytes(buffer), 0);
+		outPatchedBytes[b] = 0;
+	}
+
+	for (const SceneBuffers::Patch& patch : patches)
+	{
+		auto bytes = buffers.BufferContents(patch.buffer);
+		memcpy(snapshot.contents[patch.buffer].data() + patch.byteOffset, &bytes[0] + patch.byteOffset, patch.numBytes);
+		outPatchedBytes[patch.buffer] += patch.numBytes;
+	}
+
+	buffers.ClearPatches();
+}
+
+static const char* bufferNames[SceneBuffers::NUM_BUFFERS] = { "vbuffer", "tribuffer", "material table", "spectral atlas", "roughness atlas" };
+
+constexpr uint64_t testMaxVerts = 16 * 1024;
+constexpr uint64_t testMaxTris = 16 * 1024;
+constexpr uint32_t testMaxModels = 32;
+
+// Patched contents should match a from-scratch build of the same model list, byte-for-byte
+static uint32_t VerifyAgainstRebuild(const char* label, const GPUSnapshot& snapshot, const SceneBuffers& buffers, const std::vector<TestModel>& models)
+{
+	uint32_t numFailures = 0;
+
+	SceneBuffers rebuild;
+	rebuild.Init(testMaxVerts, testMaxTris, testMaxModels);
+	for (const TestModel& model : models)
+	{
+		AddTestModel(rebuild, model);
+	}
+
+	VERIFY(buffers.NumModels() == rebuild.NumModels() && buffers.NumVerts() == rebuild.NumVerts() && buffers.NumTris() == rebuild.NumTris(),
+		   "%s: edited mirror has %u models/%llu verts/%llu tris, rebuild has %u/%llu/%llu", label, buffers.NumModels(),
+		   static_cast<unsigned long long>(buffers.NumVerts()), static_cast<unsigned long long>(buffers.NumTris()), rebuild.NumModels(),
+		   static_cast<unsigned long long>(rebuild.NumVerts()), static_cast<unsigned long long>(rebuild.NumTris()));
+
+	const float4 dims = buffers.MaterialAtlasDims(), rebuildDims = rebuild.MaterialAtlasDims();
+	VERIFY(memcmp(&dims, &rebuildDims, sizeof(float4)) == 0, "%s: atlas dimensions differ from a full rebuild", label);
+
+	for (uint32_t b = 0; b < SceneBuffers::NUM_BUFFERS; b++)
+	{
+		auto expected = rebuild.BufferContents(static_cast<SceneBuffers::BUFFER_IDS>(b));
+		const std::vector<uint8_t>& patched = snapshot.contents[b];
+		VERIFY(patched.size() == expected.arrayLen, "%s: patched %s is %llu bytes, rebuild is %llu", label, bufferNames[b],
+			   static_cast<unsigned long long>(patched.size()), static_cast<unsigned long long>(expected.arrayLen));
+		if (patched.size() == expected.arrayLen && expected.arrayLen > 0)
+		{
+			VERIFY(memcmp(patched.data(), &expected[0], expected.arrayLen) == 0, "%s: patched %s differs from a full rebuild", label, bufferNames[b]);
+		}
+	}
+
+	rebuild.DeInit();
+	return numFailures;
+}
+
+bool SceneBuffersVerification()
+{
+	uint32_t numFailures = 0;
+	std::mt19937 rng(91011);
+
+	// Materials outlive the mirrors using them, so keep every one we make around until the end
+	std::vector<Material> allMaterials;
+	auto makeUniform = [&]() { allMaterials.push_back(UniformMaterial(rng)); return allMaterials.back(); };
+	auto makeTextured = [&](uint16_t sx, uint16_t sy, uint16_t rx, uint16_t ry) { allMaterials.push_back(TexturedMaterial(rng, sx, sy, rx, ry)); return allMaterials.back(); };
+
+	SceneBuffers buffers;
+	buffers.Init(testMaxVerts, testMaxTris, testMaxModels);
+
+	std::vector<TestModel> models;
+	models.push_back(RandomModel(rng, makeUniform()));
+	models.push_back(RandomModel(rng, makeTextured(4, 2, 3, 3)));
+	models.push_back(RandomModel(rng, makeUniform()));
+	models.push_back(RandomModel(rng, makeTextured(2, 5, 6, 1)));
+	models.push_back(RandomModel(rng, makeTextured(3, 3, 2, 4)));
+	for (const TestModel& model : models)
+	{
+		AddTestModel(buffers, model);
+	}
+
+	// Initial upload is a full copy
+	buffers.ClearPatches();
+	GPUSnapshot gpu = Snapshot(buffers);
+	numFailures += VerifyAgainstRebuild("initial build", gpu, buffers, models);
+	printf("checked initial build (%u models)\n", buffers.NumModels());
+
+	uint64_t patchedBytes[SceneBuffers::NUM_BUFFERS] = {};
+
+	// Remove a textured model from the middle (shifts geometry + re-lays the atlases)
+	buffers.RemoveModel(1);
+	models.erase(models.begin() + 1);
+	ApplyPatches(gpu, buffers, patchedBytes);
+	numFailures += VerifyAgainstRebuild("remove textured", gpu, buffers, models);
+	printf("checked textured removal\n");
+
+	// Add a textured model at the end
+	models.push_back(RandomModel(rng, makeTextured(5, 1, 1, 7)));
+	AddTestModel(buffers, models.back());
+	ApplyPatches(gpu, buffers, patchedBytes);
+	numFailures += VerifyAgainstRebuild("add textured", gpu, buffers, models);
+	VERIFY(patchedBytes[SceneBuffers::VBUFFER] == models.back().numVerts * sizeof(GeoTypes::Vertex3D), "add textured: patched %llu vbuffer bytes, expected just the new model's",
+		   static_cast<unsigned long long>(patchedBytes[SceneBuffers::VBUFFER]));
+	printf("checked textured addition\n");
+
+	// Same-footprint replacement only touches the replaced texels (the table entry keeps its dimensions + offsets)
+	{
+		const uint32_t modelNdx = 2;
+		const Material& prev = models[modelNdx].material;
+		models[modelNdx].material = makeTextured(prev.spectralTexX, prev.spectralTexY, prev.roughnessTexX, prev.roughnessTexY);
+		buffers.ReplaceMaterial(modelNdx, models[modelNdx].material);
+		ApplyPatches(gpu, buffers, patchedBytes);
+		numFailures += VerifyAgainstRebuild("replace textured (same footprint)", gpu, buffers, models);
+
+		const Material& mat = models[modelNdx].material;
+		VERIFY(patchedBytes[SceneBuffers::VBUFFER] == 0 && patchedBytes[SceneBuffers::TRIBUFFER] == 0 && patchedBytes[SceneBuffers::MATERIAL_TABLE] == 0,
+			   "replace textured (same footprint): patched geometry or the material table");
+		VERIFY(patchedBytes[SceneBuffers::SPECTRAL_ATLAS] == mat.spectralTexX * mat.spectralTexY * sizeof(MaterialSPD_Piecewise),
+			   "replace textured (same footprint): patched %llu spectral atlas bytes, expected %llu", static_cast<unsigned long long>(patchedBytes[SceneBuffers::SPECTRAL_ATLAS]),
+			   static_cast<unsigned long long>(mat.spectralTexX * mat.spectralTexY * sizeof(MaterialSPD_Piecewise)));
+		VERIFY(patchedBytes[SceneBuffers::ROUGHNESS_ATLAS] == mat.roughnessTexX * mat.roughnessTexY * sizeof(float),
+			   "replace textured (same footprint): patched %llu roughness atlas bytes, expected %llu", static_cast<unsigned long long>(patchedBytes[SceneBuffers::ROUGHNESS_ATLAS]),
+			   static_cast<unsigned long long>(mat.roughnessTexX * mat.roughnessTexY * sizeof(float)));
+		printf("checked same-footprint material replacement\n");
+	}
+
+	// Uniform -> uniform replacement is one table entry
+	{
+		models[0].material = makeUniform();
+		buffers.ReplaceMaterial(0, models[0].material);
+		ApplyPatches(gpu, buffers, patchedBytes);
+		numFailures += VerifyAgainstRebuild("replace uniform", gpu, buffers, models);
+		VERIFY(patchedBytes[SceneBuffers::MATERIAL_TABLE] == sizeof(MaterialPropertyEntry) && patchedBytes[SceneBuffers::SPECTRAL_ATLAS] == 0 &&
+			   patchedBytes[SceneBuffers::ROUGHNESS_ATLAS] == 0 && patchedBytes[SceneBuffers::VBUFFER] == 0 && patchedBytes[SceneBuffers::TRIBUFFER] == 0,
+			   "replace uniform: expected a single material table entry to be patched");
+		printf("checked uniform material replacement\n");
+	}
+
+	// Uniform -> textured replacement (re-lays the atlases)
+	models[0].material = makeTextured(6, 2, 2, 2);
+	buffers.ReplaceMaterial(0, models[0].material);
+	ApplyPatches(gpu, buffers, patchedBytes);
+	numFailures += VerifyAgainstRebuild("replace uniform with textured", gpu, buffers, models);
+	printf("checked uniform -> textured material replacement\n");
+
+	// Batch lots of edits between uploads, enough to overflow the dirty-range slots
+	for (uint32_t i = 0; i < 20; i++)
+	{
+		models.push_back(RandomModel(rng, (i % 3 == 0) ? makeTextured(1 + rng() % 4, 1 + rng() % 4, 1 + rng() % 4, 1 + rng() % 4) : makeUniform()));
+		AddTestModel(buffers, models.back());
+	}
+	buffers.RemoveModel(3);
+	models.erase(models.begin() + 3);
+	buffers.ReplaceMaterial(7, models[7].material = makeUniform());
+	ApplyPatches(gpu, buffers, patchedBytes);
+	numFailures += VerifyAgainstRebuild("batched edits", gpu, buffers, models);
+	printf("checked batched edits (%u models)\n", buffers.NumModels());
+
+	// Remove the last model (shrinks every buffer without shifting anything)
+	buffers.RemoveModel(buffers.NumModels() - 1);
+	models.pop_back();
+	ApplyPatches(gpu, buffers, patchedBytes);
+	numFailures += VerifyAgainstRebuild("remove last", gpu, buffers, models);
+	printf("checked trailing removal\n");
+
+	// Remove everything, front-to-back
+	while (buffers.NumModels() > 0)
+	{
+		buffers.RemoveModel(0);
+		models.erase(models.begin());
+	}
+	ApplyPatches(gpu, buffers, patchedBytes);
+	numFailures += VerifyAgainstRebuild("remove all", gpu, buffers, models);
+	printf("checked full removal\n");
+
+	buffers.DeInit();
+	for (Material& mat : allMaterials)
+	{
+		if (!mat.isUniform)
+		{
+			CPUMemory::Free(mat.roughnessData);
+			CPUMemory::Free(mat.spectralData);
+		}
+	}
+
+	return numFailures == 0;
+}
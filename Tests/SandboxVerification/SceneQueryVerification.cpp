@@ -0,0 +1,467 @@
+#include "Verification.h"
+#include "../TestScenes.h"
+#include "../../SandboxApp/SceneQuery.h"
+#include "../../SandboxApp/Intersection.h"
+#include "../../SandboxApp/Bounds.h"
+
+#include <algorithm>
+#include <cstring>
+#include <random>
+#include <vector>
+
+// Brute-force references run the same kernels (Intersection.h) over every triangle, so results should match exactly
+struct BruteForceScene
+{
+	std::vector<float4> verts; // Three per triangle, tribuffer order, world-space
+	uint32_t NumTris() const { return static_cast<uint32_t>(verts.size() / 3); }
+};
+
+static BruteForceScene Flatten(const SceneQuery& query)
+{
+	BruteForceScene scene;
+	scene.verts.resize(query.NumTris() * 3);
+	for (uint32_t i = 0; i < query.NumTris(); i++)
+	{
+		query.GetTriangle(i, &scene.verts[i * 3]);
+	}
+	return scene;
+}
+
+static bool BruteForceClosest(const BruteForceScene& scene, const SceneQuery::Ray& ray, float* outT)
+{
+	const RayPrecomp rp = PrecomputeRay(ray.origin, ray.dir);
+	float tMax = ray.tMax;
+	bool found = false;
+	for (uint32_t i = 0; i < scene.NumTris(); i++)
+	{
+		float t, u, v;
+		if (RayTriangle(rp, scene.verts[i * 3], scene.verts[i * 3 + 1], scene.verts[i * 3 + 2], ray.tMin, tMax, &t, &u, &v))
+		{
+			tMax = t;
+			found = true;
+		}
+	}
+	*outT = tMax;
+	return found;
+}
+
+// Unit cube split into [n]x[n] quads per face, two triangles each; vertices are shared across faces, so the mesh is closed
+static void AddTessellatedCube(SceneBuffers& buffers, uint32_t n)
+{
+	std::vector<float4> positions;
+	std::vector<uint64_t> ndces;
+	auto vertexNdx = [&](float4 p)
+	{
+		for (uint64_t i = 0; i < positions.size(); i++)
+		{
+			if (positions[i].x == p.x && positions[i].y == p.y && positions[i].z == p.z)
+			{
+				return i;
+			}
+		}
+		positions.push_back(p);
+		return static_cast<uint64_t>(positions.size() - 1);
+	};
+
+	for (uint32_t face = 0; face < 6; face++)
+	{
+		const uint32_t axis = face / 2;
+		const float side = (face & 1) ? 1.0f : -1.0f;
+		auto facePoint = [&](uint32_t i, uint32_t j)
+		{
+			float p[3];
+			p[axis] = side;
+			p[(axis + 1) % 3] = -1.0f + 2.0f * i / n;
+			p[(axis + 2) % 3] = -1.0f + 2.0f * j / n;
+			return float4(p[0], p[1], p[2], 0.0f);
+		};
+
+		for (uint32_t i = 0; i < n; i++)
+		{
+			for (uint32_t j = 0; j < n; j++)
+			{
+				const uint64_t a = vertexNdx(facePoint(i, j)), b = vertexNdx(facePoint(i + 1, j));
+				const uint64_t c = vertexNdx(facePoint(i + 1, j + 1)), d = vertexNdx(facePoint(i, j + 1));
+				const uint64_t quad[6] = { a, b, c, a, c, d };
+				for (uint64_t q : quad)
+				{
+					ndces.push_back(buffers.NumVerts() + q);
+				}
+			}
+		}
+	}
+
+	auto vts = buffers.FreeVertices();
+	for (uint64_t i = 0; i < positions.size(); i++)
+	{
+		vts[i] = {};
+		vts[i].pos = positions[i];
+	}
+
+	Material material = {};
+	material.isUniform = true;
+	buffers.AddModel(positions.size(), ndces.data(), ndces.size(), material);
+}
+
+static void AddTriangleSoup(SceneBuffers& buffers, uint32_t numTris, std::mt19937& rng)
+{
+	std::uniform_real_distribution<float> centerDist(-5.0f, 5.0f), offsetDist(-0.5f, 0.5f);
+
+	auto vts = buffers.FreeVertices();
+	std::vector<uint64_t> ndces(numTris * 3);
+	for (uint32_t i = 0; i < numTris; i++)
+	{
+		const float cx = centerDist(rng), cy = centerDist(rng), cz = centerDist(rng);
+		for (uint32_t k = 0; k < 3; k++)
+		{
+			vts[i * 3 + k] = {};
+			vts[i * 3 + k].pos = float4(cx + offsetDist(rng), cy + offsetDist(rng), cz + offsetDist(rng), 0.0f);
+			ndces[i * 3 + k] = buffers.NumVerts() + i * 3 + k;
+		}
+	}
+
+	Material material = {};
+	material.isUniform = true;
+	buffers.AddModel(numTris * 3, ndces.data(), ndces.size(), material);
+}
+
+static SceneQuery::Ray RandomRay(std::mt19937& rng, float4 sceneMin, float4 sceneMax)
+{
+	std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+	auto pointIn = [&](float margin)
+	{
+		return float4(sceneMin.x - margin + unit(rng) * (sceneMax.x - sceneMin.x + 2.0f * margin),
+					  sceneMin.y - margin + unit(rng) * (sceneMax.y - sceneMin.y + 2.0f * margin),
+					  sceneMin.z - margin + unit(rng) * (sceneMax.z - sceneMin.z + 2.0f * margin), 0.0f);
+	};
+
+	const float extent = std::max({ sceneMax.x - sceneMin.x, sceneMax.y - sceneMin.y, sceneMax.z - sceneMin.z });
+	SceneQuery::Ray ray;
+	ray.origin = pointIn(extent * 0.5f);
+	const float4 target = pointIn(0.0f);
+	ray.dir = float4(target.x - ray.origin.x, target.y - ray.origin.y, target.z - ray.origin.z, 0.0f);
+	ray.tMin = 0.0f;
+	ray.tMax = (rng() % 4 == 0) ? 0.5f : INFINITY; // Some rays stop halfway to their targets
+	return ray;
+}
+
+static uint32_t VerifyQueries(const char* label, const SceneQuery& query, std::mt19937& rng)
+{
+	uint32_t numFailures = 0;
+	const BruteForceScene scene = Flatten(query);
+
+	// Empty scenes should answer every query with nothing
+	if (scene.NumTris() == 0)
+	{
+		SceneQuery::Ray ray = { float4(0.0f, 0.0f, -1.0f, 0.0f), float4(0.0f, 0.0f, 1.0f, 0.0f), 0.0f, INFINITY };
+		SceneQuery::Hit hit;
+		SceneQuery::Nearest nearest[1];
+		VERIFY(!query.ClosestHit(ray, &hit) && hit.tri == SceneQuery::invalidTri && !query.AnyHit(ray), "%s: empty scene reported a hit", label);
+		VERIFY(query.OverlapAABB(float4(-1.0f, -1.0f, -1.0f, 0.0f), float4(1.0f, 1.0f, 1.0f, 0.0f), nullptr, 0) == 0, "%s: empty scene overlapped a box", label);
+		VERIFY(query.KNearest(float4(0.0f, 0.0f, 0.0f, 0.0f), 1, nearest) == 0, "%s: empty scene found a nearest triangle", label);
+		printf("checked empty-scene queries\n");
+		return numFailures;
+	}
+
+	float4 sceneMin = float4(INFINITY, INFINITY, INFINITY, 0.0f), sceneMax = float4(-INFINITY, -INFINITY, -INFINITY, 0.0f);
+	VertexBounds(scene.verts.data(), scene.verts.size(), sizeof(float4), &sceneMin, &sceneMax);
+	const float extent = std::max({ sceneMax.x - sceneMin.x, sceneMax.y - sceneMin.y, sceneMax.z - sceneMin.z });
+
+	// Closest/any hit, single + batched
+	constexpr uint32_t numRays = 2048;
+	std::vector<SceneQuery::Ray> rays(numRays);
+	for (SceneQuery::Ray& ray : rays)
+	{
+		ray = RandomRay(rng, sceneMin, sceneMax);
+	}
+
+	std::vector<SceneQuery::Hit> batchHits(numRays);
+	std::vector<uint8_t> batchOccluded(numRays);
+	query.ClosestHitBatch(rays.data(), batchHits.data(), numRays);
+	query.AnyHitBatch(rays.data(), reinterpret_cast<bool*>(batchOccluded.data()), numRays);
+
+	uint32_t numHits = 0;
+	for (uint32_t i = 0; i < numRays; i++)
+	{
+		float refT;
+		const bool refHit = BruteForceClosest(scene, rays[i], &refT);
+
+		SceneQuery::Hit hit;
+		const bool hasHit = query.ClosestHit(rays[i], &hit);
+		VERIFY(hasHit == refHit, "%s: ray %u closest-hit %s, brute force %s", label, i, hasHit ? "hit" : "missed", refHit ? "hit" : "missed");
+		if (hasHit && refHit)
+		{
+			VERIFY(hit.t == refT, "%s: ray %u hit at t = %f, brute force found t = %f", label, i, hit.t, refT);
+
+			// The reported triangle/barycentrics should reproduce the hit
+			float4 v[3];
+			query.GetTriangle(hit.tri, v);
+			float t, u, w;
+			const RayPrecomp rp = PrecomputeRay(rays[i].origin, rays[i].dir);
+			VERIFY(RayTriangle(rp, v[0], v[1], v[2], rays[i].tMin, rays[i].tMax, &t, &u, &w) && t == hit.t && u == hit.u && w == hit.v,
+				   "%s: ray %u reported triangle %u doesn't reproduce its hit", label, i, hit.tri);
+			numHits++;
+		}
+
+		VERIFY(query.AnyHit(rays[i]) == refHit, "%s: ray %u any-hit disagrees with brute force", label, i);
+		VERIFY(batchHits[i].tri == hit.tri && batchHits[i].t == hit.t, "%s: ray %u batched closest-hit differs from the single query", label, i);
+		VERIFY((batchOccluded[i] != 0) == refHit, "%s: ray %u batched any-hit disagrees with brute force", label, i);
+	}
+	printf("checked %u rays against brute force (%u hits)\n", numRays, numHits);
+
+	// AABB overlap
+	std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+	for (uint32_t i = 0; i < 64; i++)
+	{
+		const float halfSize = extent * (0.01f + 0.2f * unit(rng));
+		const float4 center = float4(sceneMin.x + unit(rng) * (sceneMax.x - sceneMin.x), sceneMin.y + unit(rng) * (sceneMax.y - sceneMin.y),
+									 sceneMin.z + unit(rng) * (sceneMax.z - sceneMin.z), 0.0f);
+		const float4 boxMin = float4(center.x - halfSize, center.y - halfSize * 0.5f, center.z - halfSize, 0.0f);
+		const float4 boxMax = float4(center.x + halfSize, center.y + halfSize * 0.5f, center.z + halfSize, 0.0f);
+
+		std::vector<uint32_t> found(query.OverlapAABB(boxMin, boxMax, nullptr, 0));
+		const uint32_t numFound = query.OverlapAABB(boxMin, boxMax, found.data(), static_cast<uint32_t>(found.size()));
+		std::sort(found.begin(), found.end());
+
+		// Center/extents derived from the box corners, as the query does (re-deriving them rounds differently from [center]/[halfSize])
+		const Vec3 boxCenter = { (boxMin.x + boxMax.x) * 0.5f, (boxMin.y + boxMax.y) * 0.5f, (boxMin.z + boxMax.z) * 0.5f };
+		const Vec3 halfExtents = { (boxMax.x - boxMin.x) * 0.5f, (boxMax.y - boxMin.y) * 0.5f, (boxMax.z - boxMin.z) * 0.5f };
+		std::vector<uint32_t> expected;
+		for (uint32_t t = 0; t < scene.NumTris(); t++)
+		{
+			if (TriangleBoxOverlap(boxCenter, halfExtents, scene.verts[t * 3], scene.verts[t * 3 + 1], scene.verts[t * 3 + 2]))
+			{
+				expected.push_back(t);
+			}
+		}
+		VERIFY(numFound == found.size() && found == expected, "%s: box %u overlaps %u triangles, brute force found %u", label, i, numFound, static_cast<uint32_t>(expected.size()));
+	}
+	printf("checked AABB overlap\n");
+
+	// Frustum culling; random look-at frusta from outside the scene
+	for (uint32_t i = 0; i < 32; i++)
+	{
+		const SceneQuery::Ray view = RandomRay(rng, sceneMin, sceneMax);
+		const float len = std::sqrt(view.dir.x * view.dir.x + view.dir.y * view.dir.y + view.dir.z * view.dir.z);
+		const Vec3 fwd = { view.dir.x / len, view.dir.y / len, view.dir.z / len };
+		const Vec3 upHint = (std::abs(fwd.y) < 0.9f) ? Vec3{ 0.0f, 1.0f, 0.0f } : Vec3{ 1.0f, 0.0f, 0.0f };
+		Vec3 right = Cross3(upHint, fwd);
+		right = Scale3(right, 1.0f / std::sqrt(Dot3(right, right)));
+		const Vec3 up = Cross3(fwd, right);
+		const Vec3 eye = ToVec3(view.origin);
+
+		// Side planes lean in by a random half-angle; near/far sit along the view direction
+		const float tanHalf = 0.1f + unit(rng) * 0.6f;
+		auto plane = [&](Vec3 n)
+		{
+			n = Scale3(n, 1.0f / std::sqrt(Dot3(n, n)));
+			return float4(n.x, n.y, n.z, -Dot3(n, eye));
+		};
+
+		SceneQuery::Frustum frustum;
+		frustum.planes[0] = plane(Add3(fwd, Scale3(right, 1.0f / tanHalf)));
+		frustum.planes[1] = plane(Sub3(fwd, Scale3(right, 1.0f / tanHalf)));
+		frustum.planes[2] = plane(Add3(fwd, Scale3(up, 1.0f / tanHalf)));
+		frustum.planes[3] = plane(Sub3(fwd, Scale3(up, 1.0f / tanHalf)));
+		frustum.planes[4] = float4(fwd.x, fwd.y, fwd.z, -Dot3(fwd, eye) - len * 0.1f);
+		frustum.planes[5] = float4(-fwd.x, -fwd.y, -fwd.z, Dot3(fwd, eye) + len * 1.5f);
+
+		std::vector<uint32_t> found(query.FrustumCull(frustum, nullptr, 0));
+		query.FrustumCull(frustum, found.data(), static_cast<uint32_t>(found.size()));
+		std::sort(found.begin(), found.end());
+
+		std::vector<uint32_t> expected;
+		for (uint32_t t = 0; t < scene.NumTris(); t++)
+		{
+			bool culled = false;
+			for (const float4& p : frustum.planes)
+			{
+				const Vec3 n = ToVec3(p);
+				culled |= (Dot3(n, ToVec3(scene.verts[t * 3])) + p.w < 0.0f) && (Dot3(n, ToVec3(scene.verts[t * 3 + 1])) + p.w < 0.0f) &&
+						  (Dot3(n, ToVec3(scene.verts[t * 3 + 2])) + p.w < 0.0f);
+			}
+
+			if (!culled)
+			{
+				expected.push_back(t);
+			}
+		}
+		VERIFY(found == expected, "%s: frustum %u kept %u triangles, brute force kept %u", label, i, static_cast<uint32_t>(found.size()), static_cast<uint32_t>(expected.size()));
+	}
+	printf("checked frustum culling\n");
+
+	// k-nearest, single + batched
+	constexpr uint32_t numPoints = 256;
+	constexpr uint32_t k = 8;
+	std::vector<float4> points(numPoints);
+	for (float4& p : points)
+	{
+		p = float4(sceneMin.x + unit(rng) * (sceneMax.x - sceneMin.x), sceneMin.y + unit(rng) * (sceneMax.y - sceneMin.y),
+				   sceneMin.z + unit(rng) * (sceneMax.z - sceneMin.z), 0.0f);
+	}
+
+	std::vector<SceneQuery::Nearest> batchNearest(numPoints * k);
+	std::vector<uint32_t> batchFound(numPoints);
+	query.KNearestBatch(points.data(), k, batchNearest.data(), batchFound.data(), numPoints);
+
+	std::vector<float> dists(scene.NumTris());
+	for (uint32_t i = 0; i < numPoints; i++)
+	{
+		for (uint32_t t = 0; t < scene.NumTris(); t++)
+		{
+			dists[t] = PointTriangleDistSq(ToVec3(points[i]), scene.verts[t * 3], scene.verts[t * 3 + 1], scene.verts[t * 3 + 2]);
+		}
+		const uint32_t expectedFound = std::min(k, scene.NumTris());
+		std::partial_sort(dists.begin(), dists.begin() + expectedFound, dists.end());
+
+		SceneQuery::Nearest nearest[k];
+		const uint32_t numFound = query.KNearest(points[i], k, nearest);
+		VERIFY(numFound == expectedFound, "%s: point %u found %u nearest triangles, expected %u", label, i, numFound, expectedFound);
+		for (uint32_t j = 0; j < std::min(numFound, expectedFound); j++)
+		{
+			VERIFY(nearest[j].distSq == dists[j], "%s: point %u nearest[%u] at distSq %f, brute force %f", label, i, j, nearest[j].distSq, dists[j]);
+			VERIFY(batchNearest[i * k + j].distSq == nearest[j].distSq, "%s: point %u batched nearest[%u] differs from the single query", label, i, j);
+
+			float4 v[3];
+			query.GetTriangle(nearest[j].tri, v);
+			VERIFY(PointTriangleDistSq(ToVec3(points[i]), v[0], v[1], v[2]) == nearest[j].distSq, "%s: point %u nearest[%u] reports the wrong triangle", label, i, j);
+		}
+		VERIFY(batchFound[i] == numFound, "%s: point %u batched nearest count differs from the single query", label, i);
+	}
+	printf("checked %u-nearest queries\n", k);
+
+	return numFailures;
+}
+
+bool SceneQueryVerification()
+{
+	uint32_t numFailures = 0;
+	std::mt19937 rng(1213);
+
+	transform rotated;
+	rotated.translationAndScale = float4(1.0f, -2.0f, 0.5f, 3.0f);
+	rotated.rotation = float4(0.2f, 0.4f, 0.1f, 0.8888194f); // Unit-length, roughly
+
+	// Triangle soups (multiple models under different transforms, plus tiny/empty edge cases)
+	{
+		const uint32_t soupSizes[] = { 0, 1, 3, 5000 };
+		for (uint32_t numTris : soupSizes)
+		{
+			SceneBuffers buffers;
+			buffers.Init(64 * 1024, 32 * 1024, 4);
+			AddTriangleSoup(buffers, numTris, rng);
+			AddTriangleSoup(buffers, numTris / 2, rng);
+
+			SceneGraph graph;
+			BuildTestGraph(buffers, graph, rotated);
+			graph.SetLocalTransform(1, IdentityTransform()); // Second soup stays put
+			graph.Update();
+
+			SceneQuery query;
+			query.Build(buffers, graph);
+
+			char label[64] = {};
+			snprintf(label, sizeof(label), "soup (%u tris)", query.NumTris());
+			printf("%s, %u nodes\n", label, query.NumNodes());
+			numFailures += VerifyQueries(label, query, rng);
+
+			// Triangle -> model mapping + world placement
+			for (uint32_t m = 0; m < buffers.NumModels(); m++)
+			{
+				float4 modelMin, modelMax;
+				const GeoTypes::Vertex3D* vts = reinterpret_cast<const GeoTypes::Vertex3D*>(&buffers.BufferContents(SceneBuffers::VBUFFER)[0]);
+				TransformedVertexBounds(&vts[buffers.ModelFirstVert(m)].pos, buffers.ModelNumVerts(m), sizeof(GeoTypes::Vertex3D), graph.GetWorldTransform(m), &modelMin, &modelMax);
+				for (uint64_t t = buffers.ModelFirstTri(m); t < buffers.ModelFirstTri(m) + buffers.ModelNumTris(m); t++)
+				{
+					float4 v[3];
+					query.GetTriangle(static_cast<uint32_t>(t), v);
+					const float tolerance = 1e-4f * 20.0f;
+					bool inside = true;
+					for (const float4& p : v)
+					{
+						inside &= p.x >= modelMin.x - tolerance && p.y >= modelMin.y - tolerance && p.z >= modelMin.z - tolerance &&
+								  p.x <= modelMax.x + tolerance && p.y <= modelMax.y + tolerance && p.z <= modelMax.z + tolerance;
+					}
+					VERIFY(query.TriModel(static_cast<uint32_t>(t)) == m && inside, "%s: triangle %llu isn't placed in model %u", label, static_cast<unsigned long long>(t), m);
+				}
+			}
+
+			query.DeInit();
+			graph.DeInit();
+			buffers.DeInit();
+		}
+	}
+
+	// Watertightness; rays from inside a closed mesh aimed straight at its vertices + edges must always hit something
+	{
+		constexpr uint32_t n = 8;
+		SceneBuffers buffers;
+		buffers.Init(1024, 1024, 1);
+		AddTessellatedCube(buffers, n);
+
+		SceneGraph graph;
+		BuildTestGraph(buffers, graph, IdentityTransform());
+
+		SceneQuery query;
+		query.Build(buffers, graph);
+
+		uint32_t numMissed = 0, numRays = 0;
+		std::uniform_real_distribution<float> originDist(-0.5f, 0.5f);
+		for (uint32_t face = 0; face < 6; face++)
+		{
+			for (uint32_t i = 0; i <= n * 2; i++)
+			{
+				for (uint32_t j = 0; j <= n * 2; j++)
+				{
+					// Half-steps land on grid vertices, quad edges and quad diagonals
+					float p[3];
+					p[face / 2] = (face & 1) ? 1.0f : -1.0f;
+					p[(face / 2 + 1) % 3] = -1.0f + static_cast<float>(i) / n;
+					p[(face / 2 + 2) % 3] = -1.0f + static_cast<float>(j) / n;
+
+					SceneQuery::Ray ray;
+					ray.origin = (numRays % 2 == 0) ? float4(0.0f, 0.0f, 0.0f, 0.0f) : float4(originDist(rng), originDist(rng), originDist(rng), 0.0f);
+					ray.dir = float4(p[0] - ray.origin.x, p[1] - ray.origin.y, p[2] - ray.origin.z, 0.0f);
+					ray.tMin = 0.0f;
+					ray.tMax = INFINITY;
+
+					SceneQuery::Hit hit;
+					numMissed += query.ClosestHit(ray, &hit) ? 0 : 1;
+					numRays++;
+				}
+			}
+		}
+		VERIFY(numMissed == 0, "tessellated cube: %u of %u rays through vertices/edges leaked out", numMissed, numRays);
+		printf("checked watertightness (%u rays through vertices/edges)\n", numRays);
+
+		query.DeInit();
+		graph.DeInit();
+		buffers.DeInit();
+	}
+
+	// Real geometry
+	{
+		SceneBuffers buffers;
+		buffers.Init(64 * 1024, 128 * 1024, 1);
+		if (LoadTestObj("../Models/stanford-bunny.obj", buffers))
+		{
+			SceneGraph graph;
+			BuildTestGraph(buffers, graph, rotated);
+
+			SceneQuery query;
+			query.Build(buffers, graph);
+			printf("stanford-bunny.obj (%u tris), %u nodes\n", query.NumTris(), query.NumNodes());
+			numFailures += VerifyQueries("stanford-bunny.obj", query, rng);
+
+			query.DeInit();
+			graph.DeInit();
+		}
+		else
+		{
+			printf("couldn't open ../Models/stanford-bunny.obj, skipping real-geometry checks\n");
+		}
+		buffers.DeInit();
+	}
+
+	return numFailures == 0;
+}
@@ -0,0 +1,378 @@
+#include "Verification.h"
+#include "../TestScenes.h"
+#include "../../SandboxApp/SparseOctree.h"
+#include "../../SandboxApp/Intersection.h"
+
+#include <algorithm>
+#include <bit>
+#include <random>
+#include <vector>
+
+struct OctreeTestMesh
+{
+	std::vector<float4> positions;
+	std::vector<IndexedTriangle> tris;
+};
+
+static void AddTriangle(OctreeTestMesh& mesh, float4 v0, float4 v1, float4 v2)
+{
+	const uint32_t base = static_cast<uint32_t>(mesh.positions.size());
+	mesh.positions.push_back(v0);
+	mesh.positions.push_back(v1);
+	mesh.positions.push_back(v2);
+
+	IndexedTriangle tri;
+	tri.xyz = uint4(base, base + 1, base + 2, 0);
+	mesh.tris.push_back(tri);
+}
+
+// The builder only promises this much for listed triangles; it skips exact tests when a triangle's bounds reach a single octant, and keeps
+// every candidate octant when slivers fail all of them to rounding
+static bool TriangleBoundsTouchBox(const float3& bmin, const float3& bmax, const float4& v0, const float4& v1, const float4& v2)
+{
+	return std::min({ v0.x, v1.x, v2.x }) <= bmax.x && std::max({ v0.x, v1.x, v2.x }) >= bmin.x &&
+		   std::min({ v0.y, v1.y, v2.y }) <= bmax.y && std::max({ v0.y, v1.y, v2.y }) >= bmin.y &&
+		   std::min({ v0.z, v1.z, v2.z }) <= bmax.z && std::max({ v0.z, v1.z, v2.z }) >= bmin.z;
+}
+
+static bool TriangleTouchesBox(const float3& bmin, const float3& bmax, const float4& v0, const float4& v1, const float4& v2)
+{
+	const Vec3 center = { (bmin.x + bmax.x) * 0.5f, (bmin.y + bmax.y) * 0.5f, (bmin.z + bmax.z) * 0.5f };
+	const Vec3 halfExtents = { (bmax.x - bmin.x) * 0.5f, (bmax.y - bmin.y) * 0.5f, (bmax.z - bmin.z) * 0.5f };
+	return TriangleBoxOverlap(center, halfExtents, v0, v1, v2);
+}
+
+// Closest hit through the octree, walked the same way as ComputeShader.hlsl (stack of nodes, children pushed in reverse octant order)
+static float OctreeClosestHit(const SparseOctree& octree, const OctreeTestMesh& mesh, const RayPrecomp& rp, uint32_t* outNodesVisited)
+{
+	const ComputeAS_Node* nodes = &octree.Nodes()[0];
+	const uint32_t* triList = &octree.TriList()[0];
+
+	float tMax = INFINITY;
+	uint32_t stack[AS_OCTREE_STACK_SIZE];
+	uint32_t stackSize = 0;
+	stack[stackSize++] = 0;
+	*outNodesVisited = 0;
+	while (stackSize > 0)
+	{
+		const ComputeAS_Node& node = nodes[stack[--stackSize]];
+		(*outNodesVisited)++;
+
+		const float bmin[3] = { node.boundsMin.x, node.boundsMin.y, node.boundsMin.z };
+		const float bmax[3] = { node.boundsMax.x, node.boundsMax.y, node.boundsMax.z };
+		float entry;
+		if (!RayBox(bmin, bmax, rp, 0.0f, tMax, &entry))
+		{
+			continue;
+		}
+
+		if (node.childMask != 0)
+		{
+			for (uint32_t i = std::popcount(node.childMask); i > 0; i--)
+			{
+				stack[stackSize++] = node.firstChild + i - 1;
+			}
+		}
+		else
+		{
+			for (uint32_t i = 0; i < triList[node.firstChild]; i++)
+			{
+				const IndexedTriangle& tri = mesh.tris[triList[node.firstChild + 1 + i]];
+				float t, u, v;
+				if (RayTriangle(rp, mesh.positions[tri.xyz.x], mesh.positions[tri.xyz.y], mesh.positions[tri.xyz.z], 0.0f, tMax, &t, &u, &v))
+				{
+					tMax = t;
+				}
+			}
+		}
+	}
+
+	return tMax;
+}
+
+static uint32_t VerifyOctree(const char* label, const OctreeTestMesh& mesh, const SparseOctree::Settings& settings, std::mt19937& rng)
+{
+	uint32_t numFailures = 0;
+	const uint32_t numTris = static_cast<uint32_t>(mesh.tris.size());
+
+	SparseOctree octree;
+	octree.Build(mesh.positions.data(), mesh.positions.size(), sizeof(float4), mesh.tris.data(), numTris, settings);
+
+	const SparseOctree::Stats& stats = octree.GetStats();
+	const ComputeAS_Node* nodes = &octree.Nodes()[0];
+	const uint32_t* triList = &octree.TriList()[0];
+	printf("%s (%u tris, leaf threshold %u, max depth %u): %u nodes (%u leaves), depth %u, %llu triangle refs, largest leaf %u\n", label, numTris,
+		   settings.leafTris, settings.maxDepth, stats.numNodes, stats.numLeaves, stats.depth, static_cast<unsigned long long>(stats.numTriRefs), stats.maxLeafTris);
+
+	VERIFY(octree.NumNodes() == octree.Nodes().arrayLen && octree.TriListLen() == octree.TriList().arrayLen, "%s: outputs aren't trimmed to size", label);
+	VERIFY(stats.nodeBytes == stats.numNodes * sizeof(ComputeAS_Node) && stats.triListBytes == octree.TriListLen() * sizeof(uint32_t), "%s: byte counts are off", label);
+
+	// Breadth-first layout; each branch's children follow the previous branch's, levels are contiguous, and child cells are exact octants
+	std::vector<uint32_t> levels(stats.numNodes, 0);
+	uint32_t nodesPerLevel[AS_OCTREE_MAX_DEPTH + 1] = {};
+	uint32_t nextChild = 1, numLeaves = 0, maxLeafTris = 0;
+	uint64_t numTriRefs = 0;
+	for (uint32_t i = 0; i < stats.numNodes; i++)
+	{
+		const ComputeAS_Node& node = nodes[i];
+		nodesPerLevel[levels[i]]++;
+		VERIFY(i == 0 || levels[i] >= levels[i - 1], "%s: node %u breaks level order", label, i);
+
+		if (node.childMask != 0)
+		{
+			VERIFY(node.firstChild == nextChild, "%s: node %u children start at %u, expected %u", label, i, node.firstChild, nextChild);
+
+			const float mid[3] = { (node.boundsMin.x + node.boundsMax.x) * 0.5f, (node.boundsMin.y + node.boundsMax.y) * 0.5f, (node.boundsMin.z + node.boundsMax.z) * 0.5f };
+			const float bmin[3] = { node.boundsMin.x, node.boundsMin.y, node.boundsMin.z }, bmax[3] = { node.boundsMax.x, node.boundsMax.y, node.boundsMax.z };
+			uint32_t child = node.firstChild;
+			for (uint32_t octant = 0; octant < 8; octant++)
+			{
+				if ((node.childMask & (1u << octant)) == 0 || child >= stats.numNodes)
+				{
+					continue;
+				}
+
+				bool exact = true;
+				const float* cmin = &nodes[child].boundsMin.x;
+				const float* cmax = &nodes[child].boundsMax.x;
+				for (uint32_t a = 0; a < 3; a++)
+				{
+					const bool upper = (octant >> a) & 1;
+					exact &= (cmin[a] == (upper ? mid[a] : bmin[a])) && (cmax[a] == (upper ? bmax[a] : mid[a]));
+				}
+				VERIFY(exact, "%s: node %u isn't octant %u of its parent %u", label, child, octant, i);
+
+				levels[child] = levels[i] + 1;
+				child++;
+			}
+			nextChild += std::popcount(node.childMask);
+		}
+		else
+		{
+			const uint32_t count = triList[node.firstChild];
+			numLeaves++;
+			numTriRefs += count;
+			maxLeafTris = std::max(maxLeafTris, count);
+			VERIFY(count > 0 || numTris == 0, "%s: leaf %u is empty", label, i);
+			VERIFY(node.firstChild + 1 + count <= octree.TriListLen(), "%s: leaf %u runs off the triangle list", label, i);
+
+			// Every listed triangle (conservatively) touches the leaf
+			for (uint32_t t = 0; t < count; t++)
+			{
+				const IndexedTriangle& tri = mesh.tris[triList[node.firstChild + 1 + t]];
+				const float4 &v0 = mesh.positions[tri.xyz.x], &v1 = mesh.positions[tri.xyz.y], &v2 = mesh.positions[tri.xyz.z];
+				VERIFY(TriangleBoundsTouchBox(node.boundsMin, node.boundsMax, v0, v1, v2), "%s: leaf %u lists triangle %u, which doesn't touch it", label, i, triList[node.firstChild + 1 + t]);
+			}
+
+			// Oversized leaves should only come from the depth limit, or from cells whose triangles can't be separated (all of them touch
+			// every occupied octant, and there's more than one)
+			if (count > settings.leafTris && levels[i] < settings.maxDepth)
+			{
+				const float mid[3] = { (node.boundsMin.x + node.boundsMax.x) * 0.5f, (node.boundsMin.y + node.boundsMax.y) * 0.5f, (node.boundsMin.z + node.boundsMax.z) * 0.5f };
+				uint32_t octantCounts[8] = {};
+				for (uint32_t t = 0; t < count; t++)
+				{
+					const IndexedTriangle& tri = mesh.tris[triList[node.firstChild + 1 + t]];
+					for (uint32_t octant = 0; octant < 8; octant++)
+					{
+						float3 omin, omax;
+						omin.x = (octant & 1) ? mid[0] : node.boundsMin.x;
+						omin.y = (octant & 2) ? mid[1] : node.boundsMin.y;
+						omin.z = (octant & 4) ? mid[2] : node.boundsMin.z;
+						omax.x = (octant & 1) ? node.boundsMax.x : mid[0];
+						omax.y = (octant & 2) ? node.boundsMax.y : mid[1];
+						omax.z = (octant & 4) ? node.boundsMax.z : mid[2];
+						octantCounts[octant] += TriangleTouchesBox(omin, omax, mesh.positions[tri.xyz.x], mesh.positions[tri.xyz.y], mesh.positions[tri.xyz.z]) ? 1 : 0;
+					}
+				}
+
+				bool inseparable = true;
+				uint32_t numOccupied = 0;
+				for (uint32_t c : octantCounts)
+				{
+					inseparable &= (c == 0 || c == count);
+					numOccupied += (c > 0) ? 1 : 0;
+				}
+				inseparable &= (numOccupied > 1);
+				VERIFY(inseparable, "%s: leaf %u holds %u triangles at level %u, but could have been split", label, i, count, levels[i]);
+			}
+		}
+	}
+
+	VERIFY(nextChild == stats.numNodes, "%s: branches reference %u nodes, but there are %u", label, nextChild, stats.numNodes);
+	VERIFY(numLeaves == stats.numLeaves && numTriRefs == stats.numTriRefs && maxLeafTris == stats.maxLeafTris, "%s: leaf stats don't match the tree", label);
+	for (uint32_t level = 0; level <= AS_OCTREE_MAX_DEPTH; level++)
+	{
+		VERIFY(nodesPerLevel[level] == stats.nodesPerLevel[level], "%s: level %u has %u nodes, stats say %u", label, level, nodesPerLevel[level], stats.nodesPerLevel[level]);
+	}
+	VERIFY(stats.depth <= settings.maxDepth && (stats.depth == 0 || nodesPerLevel[stats.depth] > 0), "%s: reported depth %u is off", label, stats.depth);
+
+	// Every triangle sits in every leaf it touches
+	{
+		uint64_t numReached = 0;
+		std::vector<uint32_t> stack;
+		for (uint32_t t = 0; t < numTris; t++)
+		{
+			const float4 &v0 = mesh.positions[mesh.tris[t].xyz.x], &v1 = mesh.positions[mesh.tris[t].xyz.y], &v2 = mesh.positions[mesh.tris[t].xyz.z];
+			stack.push_back(0);
+			while (!stack.empty())
+			{
+				const uint32_t n = stack.back();
+				stack.pop_back();
+				if (n != 0 && !TriangleTouchesBox(nodes[n].boundsMin, nodes[n].boundsMax, v0, v1, v2))
+				{
+					continue;
+				}
+
+				if (nodes[n].childMask != 0)
+				{
+					for (uint32_t c = 0; c < static_cast<uint32_t>(std::popcount(nodes[n].childMask)); c++)
+					{
+						stack.push_back(nodes[n].firstChild + c);
+					}
+				}
+				else
+				{
+					const uint32_t* leafTris = triList + nodes[n].firstChild + 1;
+					const bool listed = std::find(leafTris, leafTris + triList[nodes[n].firstChild], t) != leafTris + triList[nodes[n].firstChild];
+					VERIFY(listed, "%s: triangle %u touches leaf %u, but isn't listed there", label, t, n);
+					numReached++;
+				}
+			}
+		}
+		VERIFY(numReached <= stats.numTriRefs, "%s: triangles touch %llu leaves, but leaves only list %llu", label, static_cast<unsigned long long>(numReached), static_cast<unsigned long long>(stats.numTriRefs));
+	}
+
+	// Closest hits through the octree match brute force
+	if (numTris > 0)
+	{
+		const ComputeAS_Node& root = nodes[0];
+		std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+		auto pointNear = [&](float margin)
+		{
+			return float4(root.boundsMin.x - margin + unit(rng) * (root.boundsMax.x - root.boundsMin.x + 2.0f * margin),
+						  root.boundsMin.y - margin + unit(rng) * (root.boundsMax.y - root.boundsMin.y + 2.0f * margin),
+						  root.boundsMin.z - margin + unit(rng) * (root.boundsMax.z - root.boundsMin.z + 2.0f * margin), 0.0f);
+		};
+		const float extent = std::max({ root.boundsMax.x - root.boundsMin.x, root.boundsMax.y - root.boundsMin.y, root.boundsMax.z - root.boundsMin.z });
+
+		constexpr uint32_t numRays = 512;
+		uint32_t numHits = 0;
+		uint64_t numNodesVisited = 0;
+		for (uint32_t r = 0; r < numRays; r++)
+		{
+			const float4 origin = pointNear(extent * 0.5f), target = pointNear(0.0f);
+			const RayPrecomp rp = PrecomputeRay(origin, float4(target.x - origin.x, target.y - origin.y, target.z - origin.z, 0.0f));
+
+			float refT = INFINITY;
+			for (const IndexedTriangle& tri : mesh.tris)
+			{
+				float t, u, v;
+				if (RayTriangle(rp, mesh.positions[tri.xyz.x], mesh.positions[tri.xyz.y], mesh.positions[tri.xyz.z], 0.0f, refT, &t, &u, &v))
+				{
+					refT = t;
+				}
+			}
+
+			uint32_t nodesVisited;
+			const float t = OctreeClosestHit(octree, mesh, rp, &nodesVisited);
+			VERIFY(t == refT, "%s: ray %u hit at t = %f through the octree, brute force found t = %f", label, r, t, refT);
+			numHits += (refT < INFINITY) ? 1 : 0;
+			numNodesVisited += nodesVisited;
+		}
+		printf("checked %u rays against brute force (%u hits, %.1f nodes visited per ray)\n", numRays, numHits, static_cast<double>(numNodesVisited) / numRays);
+	}
+
+	octree.DeInit();
+	return numFailures;
+}
+
+bool SparseOctreeVerification()
+{
+	uint32_t numFailures = 0;
+	std::mt19937 rng(1617);
+	std::uniform_real_distribution<float> centerDist(-10.0f, 10.0f), offsetDist(-0.5f, 0.5f);
+
+	SparseOctree::Settings settings;
+
+	// Empty + single-triangle scenes
+	{
+		OctreeTestMesh mesh;
+		numFailures += VerifyOctree("empty", mesh, settings, rng);
+
+		AddTriangle(mesh, float4(0.0f, 0.0f, 0.0f, 0.0f), float4(1.0f, 0.0f, 0.0f, 0.0f), float4(0.0f, 1.0f, 0.0f, 0.0f));
+		numFailures += VerifyOctree("single triangle", mesh, settings, rng);
+	}
+
+	// Stacked copies of one triangle can't be separated, so the root should stay a leaf instead of recursing to the depth limit
+	{
+		OctreeTestMesh mesh;
+		for (uint32_t i = 0; i < 100; i++)
+		{
+			AddTriangle(mesh, float4(0.0f, 0.0f, 0.0f, 0.0f), float4(1.0f, 0.0f, 0.0f, 0.0f), float4(0.0f, 1.0f, 1.0f, 0.0f));
+		}
+
+		numFailures += VerifyOctree("stacked triangles", mesh, settings, rng);
+
+		SparseOctree octree;
+		octree.Build(mesh.positions.data(), mesh.positions.size(), sizeof(float4), mesh.tris.data(), 100, settings);
+		VERIFY(octree.NumNodes() == 1 && octree.GetStats().maxLeafTris == 100, "stacked triangles: built %u nodes, expected a single leaf", octree.NumNodes());
+		octree.DeInit();
+	}
+
+	// Random soup, plus a cluster of tiny triangles (exercises adaptive depth), under a few settings
+	{
+		OctreeTestMesh mesh;
+		for (uint32_t i = 0; i < 4000; i++)
+		{
+			const float4 c = float4(centerDist(rng), centerDist(rng), centerDist(rng), 0.0f);
+			AddTriangle(mesh, float4(c.x + offsetDist(rng), c.y + offsetDist(rng), c.z + offsetDist(rng), 0.0f),
+							  float4(c.x + offsetDist(rng), c.y + offsetDist(rng), c.z + offsetDist(rng), 0.0f),
+							  float4(c.x + offsetDist(rng), c.y + offsetDist(rng), c.z + offsetDist(rng), 0.0f));
+		}
+
+		for (uint32_t i = 0; i < 1000; i++)
+		{
+			const float4 c = float4(5.0f + offsetDist(rng) * 0.01f, 5.0f + offsetDist(rng) * 0.01f, 5.0f + offsetDist(rng) * 0.01f, 0.0f);
+			AddTriangle(mesh, c, float4(c.x + offsetDist(rng) * 0.001f, c.y + offsetDist(rng) * 0.001f, c.z, 0.0f), float4(c.x, c.y + offsetDist(rng) * 0.001f, c.z + offsetDist(rng) * 0.001f, 0.0f));
+		}
+
+		numFailures += VerifyOctree("soup", mesh, settings, rng);
+
+		SparseOctree::Settings fineSettings;
+		fineSettings.leafTris = 1;
+		fineSettings.maxDepth = AS_OCTREE_MAX_DEPTH;
+		numFailures += VerifyOctree("soup", mesh, fineSettings, rng);
+
+		SparseOctree::Settings shallowSettings;
+		shallowSettings.maxDepth = 3;
+		shallowSettings.numThreads = 3;
+		numFailures += VerifyOctree("soup", mesh, shallowSettings, rng);
+	}
+
+	// Real geometry
+	{
+		SceneBuffers buffers;
+		buffers.Init(64 * 1024, 128 * 1024, 1);
+		if (LoadTestObj("../Models/stanford-bunny.obj", buffers))
+		{
+			OctreeTestMesh mesh;
+			const GeoTypes::Vertex3D* vts = reinterpret_cast<const GeoTypes::Vertex3D*>(&buffers.BufferContents(SceneBuffers::VBUFFER)[0]);
+			const IndexedTriangle* tris = reinterpret_cast<const IndexedTriangle*>(&buffers.BufferContents(SceneBuffers::TRIBUFFER)[0]);
+			for (uint64_t i = 0; i < buffers.NumVerts(); i++)
+			{
+				mesh.positions.push_back(vts[i].pos);
+			}
+			mesh.tris.assign(tris, tris + buffers.NumTris());
+
+			numFailures += VerifyOctree("stanford-bunny.obj", mesh, settings, rng);
+		}
+		else
+		{
+			printf("couldn't open ../Models/stanford-bunny.obj, skipping real-geometry checks\n");
+		}
+		buffers.DeInit();
+	}
+
+	return numFailures == 0;
+}
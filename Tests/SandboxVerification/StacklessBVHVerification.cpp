@@ -0,0 +1,262 @@
+#include "Verification.h"
+#include "../TestScenes.h"
+#include "../../SandboxApp/StacklessBVH.h"
+#include "../../SandboxApp/Intersection.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <random>
+#include <vector>
+
+struct StacklessTestMesh
+{
+	std::vector<float4> positions;
+	std::vector<IndexedTriangle> tris;
+};
+
+static StacklessTestMesh StacklessTriangleSoup(uint32_t numTris, float size, std::mt19937& rng)
+{
+	std::uniform_real_distribution<float> centerDist(-size, size), offsetDist(-0.05f * size, 0.05f * size);
+	StacklessTestMesh mesh;
+	for (uint32_t i = 0; i < numTris; i++)
+	{
+		const float cx = centerDist(rng), cy = centerDist(rng), cz = centerDist(rng);
+		IndexedTriangle tri;
+		tri.xyz = uint4(i * 3, i * 3 + 1, i * 3 + 2, 0);
+		mesh.tris.push_back(tri);
+		for (uint32_t k = 0; k < 3; k++)
+		{
+			mesh.positions.push_back(float4(cx + offsetDist(rng), cy + offsetDist(rng), cz + offsetDist(rng), 0.0f));
+		}
+	}
+	return mesh;
+}
+
+static bool StacklessBruteForceClosest(const StacklessTestMesh& mesh, const StacklessBVH::Ray& ray, float* outT)
+{
+	const RayPrecomp rp = PrecomputeRay(ray.origin, ray.dir);
+	float tMax = ray.tMax;
+	bool found = false;
+	for (const IndexedTriangle& tri : mesh.tris)
+	{
+		float t, u, v;
+		if (RayTriangle(rp, mesh.positions[tri.xyz.x], mesh.positions[tri.xyz.y], mesh.positions[tri.xyz.z], ray.tMin, tMax, &t, &u, &v) && (!found || t < tMax))
+		{
+			tMax = t;
+			found = true;
+		}
+	}
+	*outT = tMax;
+	return found;
+}
+
+// Converts [bvh] (built over [mesh]) and checks the encoding node-by-node against it, then [numRays] closest/any hits from every
+// traversal against brute force
+static uint32_t VerifyStacklessBVH(const char* label, const BVH& bvh, const StacklessTestMesh& mesh, uint32_t numRays, std::mt19937& rng)
+{
+	uint32_t numFailures = 0;
+	StacklessBVH stackless;
+	stackless.Build(bvh, mesh.positions.data(), mesh.positions.size(), sizeof(float4), mesh.tris.data());
+	VERIFY(stackless.NumNodes() == bvh.NumNodes() && stackless.NumTris() == mesh.tris.size() && stackless.TriListLen() == bvh.TriListLen(),
+		   "%s: unexpected node/triangle counts", label);
+	VERIFY(stackless.TriListLen() == 0 || memcmp(&stackless.TriList()[0], &bvh.TriList()[0], stackless.TriListLen() * sizeof(uint32_t)) == 0,
+		   "%s: the triangle list doesn't match the source tree's", label);
+
+	// Same nodes as the source tree, with right children recoverable from the skip links
+	const ComputeBVH_SkipNode* nodes = &stackless.Nodes()[0];
+	const uint32_t numNodes = std::min(stackless.NumNodes(), bvh.NumNodes());
+	VERIFY(StacklessBVH::SubtreeEnd(nodes, 0) == numNodes, "%s: the root's subtree ends at %u, not after all %u nodes", label, StacklessBVH::SubtreeEnd(nodes, 0),
+		   numNodes);
+	for (uint32_t n = 0; n < numNodes && !mesh.tris.empty(); n++)
+	{
+		const ComputeBVH_Node& source = bvh.Nodes()[n];
+		const ComputeBVH_SkipNode& node = nodes[n];
+		VERIFY(memcmp(&node.boundsMin, &source.boundsMin, sizeof(float3)) == 0 && memcmp(&node.boundsMax, &source.boundsMax, sizeof(float3)) == 0 &&
+			   node.triCount == source.triCount, "%s: node %u's bounds/triangle count don't match the source tree's", label, n);
+		if (source.triCount > 0)
+		{
+			VERIFY(node.skipOrFirstTri == source.rightOrFirstTri, "%s: leaf %u starts at triangle %u, not %u", label, n, node.skipOrFirstTri, source.rightOrFirstTri);
+			continue;
+		}
+
+		VERIFY(node.skipOrFirstTri > n + 2 && node.skipOrFirstTri <= numNodes, "%s: branch %u's skip link (%u) is out of range", label, n, node.skipOrFirstTri);
+		if (node.skipOrFirstTri <= n + 2 || node.skipOrFirstTri > numNodes)
+		{
+			continue;
+		}
+
+		const uint32_t right = StacklessBVH::RightChild(nodes, n);
+		VERIFY(right == source.rightOrFirstTri, "%s: branch %u's right child decodes as %u, not %u", label, n, right, source.rightOrFirstTri);
+		VERIFY(right < numNodes && StacklessBVH::SubtreeEnd(nodes, right) == node.skipOrFirstTri, "%s: branch %u's skip link doesn't follow its right subtree", label, n);
+	}
+
+	if (mesh.tris.empty())
+	{
+		StacklessBVH::Ray ray = { float4(0.0f, 0.0f, -1.0f, 0.0f), float4(0.0f, 0.0f, 1.0f, 0.0f), 0.0f, INFINITY };
+		StacklessBVH::Hit hit;
+		VERIFY(!stackless.ClosestHit(ray, &hit) && hit.tri == StacklessBVH::invalidTri && !stackless.AnyHit(ray), "%s: an empty tree reported a hit", label);
+		printf("%s: checked an empty tree\n", label);
+		stackless.DeInit();
+		return numFailures;
+	}
+
+	// Rays from around the mesh towards points inside it
+	const float sceneMin[3] = { nodes[0].boundsMin.x, nodes[0].boundsMin.y, nodes[0].boundsMin.z };
+	const float sceneMax[3] = { nodes[0].boundsMax.x, nodes[0].boundsMax.y, nodes[0].boundsMax.z };
+	std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+	const float extent = std::max({ sceneMax[0] - sceneMin[0], sceneMax[1] - sceneMin[1], sceneMax[2] - sceneMin[2], 1e-3f });
+	auto pointIn = [&](float margin)
+	{
+		return float4(sceneMin[0] - margin + unit(rng) * (sceneMax[0] - sceneMin[0] + 2.0f * margin),
+					  sceneMin[1] - margin + unit(rng) * (sceneMax[1] - sceneMin[1] + 2.0f * margin),
+					  sceneMin[2] - margin + unit(rng) * (sceneMax[2] - sceneMin[2] + 2.0f * margin), 0.0f);
+	};
+
+	const StacklessBVH::Traversal traversals[] = { StacklessBVH::Traversal::SkipLinks, StacklessBVH::Traversal::RestartTrail, StacklessBVH::Traversal::Stack };
+	const char* traversalNames[] = { "skip-link", "restart-trail", "stack" };
+	uint64_t boxTests[3] = {}, restarts = 0;
+	uint32_t numHits = 0;
+	for (uint32_t r = 0; r < numRays; r++)
+	{
+		StacklessBVH::Ray ray;
+		ray.origin = pointIn(extent * 0.5f);
+		const float4 target = pointIn(0.0f);
+		ray.dir = float4(target.x - ray.origin.x, target.y - ray.origin.y, target.z - ray.origin.z, 0.0f);
+		ray.tMin = 0.0f;
+		ray.tMax = (rng() % 4 == 0) ? 0.5f : INFINITY;
+
+		float refT;
+		const bool refHit = StacklessBruteForceClosest(mesh, ray, &refT);
+		VERIFY(stackless.AnyHit(ray) == refHit, "%s: ray %u any-hit disagrees with brute force", label, r);
+		numHits += refHit ? 1 : 0;
+		for (uint32_t i = 0; i < 3; i++)
+		{
+			StacklessBVH::Hit hit;
+			StacklessBVH::TraceCounts counts;
+			const bool hasHit = stackless.ClosestHit(ray, &hit, traversals[i], &counts);
+			boxTests[i] += counts.nodes;
+			restarts += counts.restarts;
+			VERIFY(hasHit == refHit, "%s: ray %u %s closest-hit %s, brute force %s", label, r, traversalNames[i], hasHit ? "hit" : "missed", refHit ? "hit" : "missed");
+			if (!hasHit || !refHit)
+			{
+				continue;
+			}
+			VERIFY(hit.t == refT, "%s: ray %u %s hit at t = %f, brute force found t = %f", label, r, traversalNames[i], hit.t, refT);
+
+			// The reported triangle should reproduce the hit
+			const IndexedTriangle& tri = mesh.tris[hit.tri];
+			float t, u, v;
+			VERIFY(RayTriangle(PrecomputeRay(ray.origin, ray.dir), mesh.positions[tri.xyz.x], mesh.positions[tri.xyz.y], mesh.positions[tri.xyz.z], ray.tMin, ray.tMax, &t, &u, &v) &&
+				   t == hit.t && u == hit.u && v == hit.v, "%s: ray %u %s reported triangle %u doesn't reproduce its hit", label, r, traversalNames[i], hit.tri);
+		}
+	}
+
+	const double perRay = 1.0 / std::max(numRays, 1u);
+	printf("%s: %u nodes, checked %u rays against brute force (%u hits); box tests per ray: %.1f skip-link, %.1f restart-trail (%.1f restarts), %.1f stack\n",
+		   label, stackless.NumNodes(), numRays, numHits, boxTests[0] * perRay, boxTests[1] * perRay, restarts * perRay, boxTests[2] * perRay);
+
+	stackless.DeInit();
+	return numFailures;
+}
+
+bool StacklessBVHVerification()
+{
+	uint32_t numFailures = 0;
+	std::mt19937 rng(909);
+
+	BVH::BinnedSAHSettings sahSettings;
+	sahSettings.numThreads = 1;
+
+	// Degenerate inputs
+	{
+		const StacklessTestMesh empty, single = StacklessTriangleSoup(1, 1.0f, rng);
+		BVH bvh;
+		bvh.BuildBinnedSAH(empty.positions.data(), 0, sizeof(float4), empty.tris.data(), 0, sahSettings);
+		numFailures += VerifyStacklessBVH("empty", bvh, empty, 0, rng);
+		bvh.DeInit();
+
+		bvh.BuildBinnedSAH(single.positions.data(), single.positions.size(), sizeof(float4), single.tris.data(), 1, sahSettings);
+		numFailures += VerifyStacklessBVH("one triangle", bvh, single, 256, rng);
+		bvh.DeInit();
+
+		// Identical triangles can't be separated, so every split is a median split over one shared box (every ray hits both children,
+		// so restart trails visit whole subtrees)
+		StacklessTestMesh stacked = StacklessTriangleSoup(1, 1.0f, rng);
+		for (uint32_t i = 1; i < 100; i++)
+		{
+			IndexedTriangle tri = stacked.tris[0];
+			stacked.tris.push_back(tri);
+		}
+		BVH::BinnedSAHSettings settings = sahSettings;
+		settings.leafTris = 1;
+		settings.maxLeafTris = 1;
+		bvh.BuildBinnedSAH(stacked.positions.data(), stacked.positions.size(), sizeof(float4), stacked.tris.data(), 100, settings);
+		numFailures += VerifyStacklessBVH("stacked triangles", bvh, stacked, 256, rng);
+		bvh.DeInit();
+	}
+
+	// Soups under leaves of various sizes, from both builders, and trees with duplicated references
+	{
+		const StacklessTestMesh soup = StacklessTriangleSoup(3000, 1.0f, rng);
+		const uint32_t leafSizes[] = { 1, 4, 16 };
+		for (uint32_t leafSize : leafSizes)
+		{
+			char label[64];
+			BVH::BinnedSAHSettings settings = sahSettings;
+			settings.leafTris = leafSize;
+			settings.maxLeafTris = leafSize;
+			BVH bvh;
+			bvh.BuildBinnedSAH(soup.positions.data(), soup.positions.size(), sizeof(float4), soup.tris.data(), static_cast<uint32_t>(soup.tris.size()), settings);
+			snprintf(label, sizeof(label), "soup, binned SAH, %u-triangle leaves", leafSize);
+			numFailures += VerifyStacklessBVH(label, bvh, soup, 1024, rng);
+			bvh.DeInit();
+		}
+
+		BVH::LBVHSettings lbvhSettings;
+		lbvhSettings.treeletSize = 7;
+		lbvhSettings.numThreads = 1;
+		BVH bvh;
+		bvh.BuildLBVH(soup.positions.data(), soup.positions.size(), sizeof(float4), soup.tris.data(), static_cast<uint32_t>(soup.tris.size()), lbvhSettings);
+		numFailures += VerifyStacklessBVH("soup, LBVH", bvh, soup, 1024, rng);
+		bvh.DeInit();
+
+		StacklessTestMesh building;
+		BuildArchitecturalScene(2, 3, 4, building.positions, building.tris);
+		BVH::BinnedSAHSettings spatialSettings = sahSettings;
+		spatialSettings.spatialSplits = true;
+		bvh.BuildBinnedSAH(building.positions.data(), building.positions.size(), sizeof(float4), building.tris.data(), static_cast<uint32_t>(building.tris.size()),
+						   spatialSettings);
+		numFailures += VerifyStacklessBVH("building, spatial splits", bvh, building, 1024, rng);
+		bvh.DeInit();
+	}
+
+	// Real geometry
+	{
+		SceneBuffers buffers;
+		buffers.Init(64 * 1024, 128 * 1024, 1);
+		if (LoadTestObj("../Models/stanford-bunny.obj", buffers))
+		{
+			StacklessTestMesh bunny;
+			const GeoTypes::Vertex3D* vts = reinterpret_cast<const GeoTypes::Vertex3D*>(&buffers.BufferContents(SceneBuffers::VBUFFER)[0]);
+			const IndexedTriangle* tris = reinterpret_cast<const IndexedTriangle*>(&buffers.BufferContents(SceneBuffers::TRIBUFFER)[0]);
+			for (uint64_t i = 0; i < buffers.NumVerts(); i++)
+			{
+				bunny.positions.push_back(vts[i].pos);
+			}
+			bunny.tris.assign(tris, tris + buffers.NumTris());
+
+			BVH bvh;
+			bvh.BuildBinnedSAH(bunny.positions.data(), bunny.positions.size(), sizeof(float4), bunny.tris.data(), static_cast<uint32_t>(bunny.tris.size()), sahSettings);
+			numFailures += VerifyStacklessBVH("bunny", bvh, bunny, 256, rng);
+			bvh.DeInit();
+		}
+		else
+		{
+			printf("couldn't load stanford-bunny.obj, skipped\n");
+		}
+		buffers.DeInit();
+	}
+
+	return numFailures == 0;
+}
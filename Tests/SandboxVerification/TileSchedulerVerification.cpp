@@ -0,0 +1,144 @@
+#include "Verification.h"
+#include "../../SandboxApp/TileScheduler.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <thread>
+#include <vector>
+
+// Tile orders are permutations of the grid (curves included, for grids that aren't power-of-two squares), Hilbert steps only move
+// between neighbouring tiles, and every run covers every pixel exactly once for any thread count, pool reuse, and tile clipping
+static uint32_t VerifyTileOrders()
+{
+	uint32_t numFailures = 0;
+	const uint32_t grids[][2] = { { 1, 1 }, { 1, 7 }, { 7, 1 }, { 5, 3 }, { 8, 8 }, { 13, 9 }, { 16, 16 }, { 30, 17 }, { 64, 64 } };
+	const TileScheduler::TileOrder orders[] = { TileScheduler::TileOrder::RowMajor, TileScheduler::TileOrder::Morton, TileScheduler::TileOrder::Hilbert };
+	for (const auto& grid : grids)
+	{
+		const uint32_t numTiles = grid[0] * grid[1];
+		for (TileScheduler::TileOrder order : orders)
+		{
+			std::vector<uint32_t> tileOrder(numTiles, UINT32_MAX);
+			TileScheduler::OrderTiles(grid[0], grid[1], order, tileOrder.data());
+
+			std::vector<uint32_t> seen(numTiles, 0);
+			for (uint32_t ndx : tileOrder)
+			{
+				if (ndx < numTiles)
+				{
+					seen[ndx]++;
+				}
+			}
+			const bool permutation = std::all_of(seen.begin(), seen.end(), [](uint32_t count) { return count == 1; });
+			VERIFY(permutation, "order %u over %ux%u tiles isn't a permutation", static_cast<uint32_t>(order), grid[0], grid[1]);
+
+			// Curves over power-of-two squares never skip cells, so Hilbert steps are always one tile across
+			if (order == TileScheduler::TileOrder::Hilbert && grid[0] == grid[1] && (grid[0] & (grid[0] - 1)) == 0 && permutation)
+			{
+				uint32_t numJumps = 0;
+				for (uint32_t i = 1; i < numTiles; i++)
+				{
+					const int32_t dx = static_cast<int32_t>(tileOrder[i] % grid[0]) - static_cast<int32_t>(tileOrder[i - 1] % grid[0]);
+					const int32_t dy = static_cast<int32_t>(tileOrder[i] / grid[0]) - static_cast<int32_t>(tileOrder[i - 1] / grid[0]);
+					numJumps += (std::abs(dx) + std::abs(dy) != 1) ? 1 : 0;
+				}
+				VERIFY(numJumps == 0, "%u Hilbert steps over %ux%u tiles aren't between neighbours", numJumps, grid[0], grid[1]);
+			}
+		}
+	}
+	return numFailures;
+}
+
+static uint32_t VerifyCoverage()
+{
+	uint32_t numFailures = 0;
+	const uint32_t threadCounts[] = { 1, 2, 3, 8, 17 };
+	for (uint32_t numThreads : threadCounts)
+	{
+		TileScheduler scheduler;
+		scheduler.Init(numThreads);
+		VERIFY(scheduler.NumThreads() == numThreads, "asked for %u threads, got %u", numThreads, scheduler.NumThreads());
+
+		// Reuse the pool over many runs, with frames that do and don't divide into tiles
+		uint32_t numBadRuns = 0;
+		for (uint32_t run = 0; run < 100; run++)
+		{
+			const uint32_t width = 37 + run * 7 % 90, height = 11 + run * 13 % 70, tileSize = 1 + run % 16;
+			const TileScheduler::TileOrder order = static_cast<TileScheduler::TileOrder>(run % 3);
+			std::vector<std::atomic<uint32_t>> pixelHits(width * height);
+			std::vector<std::atomic<uint32_t>> tileHits((width + tileSize - 1) / tileSize * ((height + tileSize - 1) / tileSize));
+			std::atomic<uint32_t> badThreads = 0, badTiles = 0;
+			const TileScheduler::RunStats stats = scheduler.Run(width, height, tileSize, order, [&](const TileScheduler::Tile& tile, uint32_t threadNdx)
+			{
+				badThreads += (threadNdx >= numThreads) ? 1 : 0;
+				badTiles += (tile.ndx >= tileHits.size() || tile.x1 > width || tile.y1 > height || tile.x0 >= tile.x1 || tile.y0 >= tile.y1) ? 1 : 0;
+				if (tile.ndx < tileHits.size())
+				{
+					tileHits[tile.ndx]++;
+				}
+				for (uint32_t y = tile.y0; y < std::min(tile.y1, height); y++)
+				{
+					for (uint32_t x = tile.x0; x < std::min(tile.x1, width); x++)
+					{
+						pixelHits[y * width + x]++;
+					}
+				}
+			});
+
+			const bool pixelsOnce = std::all_of(pixelHits.begin(), pixelHits.end(), [](const std::atomic<uint32_t>& hits) { return hits == 1; });
+			const bool tilesOnce = std::all_of(tileHits.begin(), tileHits.end(), [](const std::atomic<uint32_t>& hits) { return hits == 1; });
+			const bool statsMatch = stats.numTiles == tileHits.size() && stats.maxThreadTiles <= stats.numTiles && stats.minThreadTiles <= stats.maxThreadTiles;
+			numBadRuns += (pixelsOnce && tilesOnce && statsMatch && badThreads == 0 && badTiles == 0) ? 0 : 1;
+		}
+		VERIFY(numBadRuns == 0, "%u of 100 runs on %u threads didn't cover every pixel + tile exactly once", numBadRuns, numThreads);
+
+		// Empty frames run nothing
+		uint32_t emptyCalls = 0;
+		const TileScheduler::RunStats emptyStats = scheduler.Run(0, 64, 8, TileScheduler::TileOrder::Hilbert, [&](const TileScheduler::Tile&, uint32_t) { emptyCalls++; });
+		VERIFY(emptyCalls == 0 && emptyStats.numTiles == 0, "an empty frame ran %u tiles", emptyCalls);
+		scheduler.DeInit();
+	}
+	return numFailures;
+}
+
+// Thread zero's stretch of the curve is slow, so the other threads should run out early and take tiles from it
+static uint32_t VerifyStealing()
+{
+	uint32_t numFailures = 0;
+	TileScheduler scheduler;
+	scheduler.Init(4);
+	std::vector<uint32_t> tileThreads(64, UINT32_MAX);
+	const TileScheduler::RunStats stats = scheduler.Run(64, 64, 8, TileScheduler::TileOrder::RowMajor, [&](const TileScheduler::Tile& tile, uint32_t threadNdx)
+	{
+		tileThreads[tile.ndx] = threadNdx;
+		if (tile.ndx < 16)
+		{
+			std::this_thread::sleep_for(std::chrono::milliseconds(2));
+		}
+	});
+	scheduler.DeInit();
+
+	uint32_t slowTilesStolen = 0;
+	for (uint32_t i = 0; i < 16; i++)
+	{
+		slowTilesStolen += (tileThreads[i] != 0) ? 1 : 0;
+	}
+	VERIFY(stats.numSteals > 0 && stats.stolenTiles > 0, "no steals with one slow thread");
+	VERIFY(slowTilesStolen > 0, "none of thread zero's slow tiles were stolen");
+	VERIFY(stats.minThreadTiles + stats.maxThreadTiles > 0 && stats.numTiles == 64, "bad stats: %u tiles, %u-%u per thread", stats.numTiles, stats.minThreadTiles,
+		   stats.maxThreadTiles);
+	printf("slow stretch: %u steals moved %u tiles (%u of thread zero's 16), %u-%u tiles per thread\n", stats.numSteals, stats.stolenTiles, slowTilesStolen,
+		   stats.minThreadTiles, stats.maxThreadTiles);
+	return numFailures;
+}
+
+bool TileSchedulerVerification()
+{
+	uint32_t numFailures = 0;
+	numFailures += VerifyTileOrders();
+	numFailures += VerifyCoverage();
+	numFailures += VerifyStealing();
+	return numFailures == 0;
+}
@@ -0,0 +1,253 @@
+#include "Verification.h"
+#include "../TestScenes.h"
+#include "../../SandboxApp/TwoLevelAS.h"
+#include "../../SandboxApp/Intersection.h"
+#include "../../SandboxApp/Bounds.h"
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <vector>
+
+struct InstancedTestMesh
+{
+	std::vector<float4> positions;
+	std::vector<IndexedTriangle> tris;
+};
+
+static InstancedTestMesh TriangleSoup(uint32_t numTris, float size, std::mt19937& rng)
+{
+	std::uniform_real_distribution<float> centerDist(-size, size), offsetDist(-0.2f * size, 0.2f * size);
+	InstancedTestMesh mesh;
+	for (uint32_t i = 0; i < numTris; i++)
+	{
+		const float cx = centerDist(rng), cy = centerDist(rng), cz = centerDist(rng);
+		IndexedTriangle tri;
+		tri.xyz = uint4(i * 3, i * 3 + 1, i * 3 + 2, 0);
+		mesh.tris.push_back(tri);
+		for (uint32_t k = 0; k < 3; k++)
+		{
+			mesh.positions.push_back(float4(cx + offsetDist(rng), cy + offsetDist(rng), cz + offsetDist(rng), 0.0f));
+		}
+	}
+	return mesh;
+}
+
+// Random placements inside a [spread]-sized cube, with random (unit) rotations and scales from [minScale, maxScale]
+static std::vector<transform> RandomPlacements(uint32_t numInstances, float spread, float minScale, float maxScale, std::mt19937& rng)
+{
+	std::uniform_real_distribution<float> posDist(-spread, spread), scaleDist(minScale, maxScale);
+	std::normal_distribution<float> quatDist;
+	std::vector<transform> xforms(numInstances);
+	for (transform& xform : xforms)
+	{
+		float q[4] = { quatDist(rng), quatDist(rng), quatDist(rng), quatDist(rng) };
+		const float len = std::sqrt(q[0] * q[0] + q[1] * q[1] + q[2] * q[2] + q[3] * q[3]);
+		xform.translationAndScale = float4(posDist(rng), posDist(rng), posDist(rng), scaleDist(rng));
+		xform.rotation = float4(q[0] / len, q[1] / len, q[2] / len, q[3] / len);
+	}
+	return xforms;
+}
+
+// Every instance's triangles, traced in its own object space (with the same ray transform as the structure); results should match exactly
+static bool BruteForceClosest(const TwoLevelAS& as, const std::vector<const InstancedTestMesh*>& meshes, const std::vector<uint32_t>& instanceMeshes,
+							  const TwoLevelAS::Ray& ray, float* outT)
+{
+	float tMax = ray.tMax;
+	bool found = false;
+	for (uint32_t i = 0; i < instanceMeshes.size(); i++)
+	{
+		const TwoLevelAS::Ray local = as.ToObjectSpace(ray, i);
+		const RayPrecomp rp = PrecomputeRay(local.origin, local.dir);
+		const InstancedTestMesh& mesh = *meshes[instanceMeshes[i]];
+		for (const IndexedTriangle& tri : mesh.tris)
+		{
+			float t, u, v;
+			if (RayTriangle(rp, mesh.positions[tri.xyz.x], mesh.positions[tri.xyz.y], mesh.positions[tri.xyz.z], ray.tMin, tMax, &t, &u, &v) && (!found || t < tMax))
+			{
+				tMax = t;
+				found = true;
+			}
+		}
+	}
+	*outT = tMax;
+	return found;
+}
+
+// Checks instance bounds + TLAS coverage, then [numRays] closest/any hits against brute force over [xforms]
+static uint32_t VerifyInstances(const char* label, TwoLevelAS& as, const std::vector<const InstancedTestMesh*>& meshes, const std::vector<transform>& xforms,
+								const std::vector<uint32_t>& instanceMeshes, uint32_t numRays, std::mt19937& rng)
+{
+	uint32_t numFailures = 0;
+	const uint32_t numInstances = static_cast<uint32_t>(xforms.size());
+	as.SetInstances(xforms.data(), instanceMeshes.data(), numInstances);
+
+	// The TLAS should list each instance exactly once, and its root should hold every (non-empty) instance's world-space mesh bounds
+	const BVH& tlas = as.TLAS();
+	std::vector<uint32_t> listed(&tlas.TriList()[0], &tlas.TriList()[0] + tlas.NumTris());
+	std::sort(listed.begin(), listed.end());
+	bool permutation = (listed.size() == numInstances);
+	for (uint32_t i = 0; i < listed.size() && permutation; i++)
+	{
+		permutation = (listed[i] == i);
+	}
+	VERIFY(permutation, "%s: the TLAS doesn't list every instance once", label);
+
+	float4 sceneMin = float4(INFINITY, INFINITY, INFINITY, 0.0f), sceneMax = float4(-INFINITY, -INFINITY, -INFINITY, 0.0f);
+	const ComputeBVH_Node& root = tlas.Nodes()[0];
+	for (uint32_t i = 0; i < numInstances; i++)
+	{
+		const InstancedTestMesh& mesh = *meshes[instanceMeshes[i]];
+		if (mesh.tris.empty())
+		{
+			continue;
+		}
+
+		float4 meshMin, meshMax;
+		TransformedVertexBounds(mesh.positions.data(), mesh.positions.size(), sizeof(float4), xforms[i], &meshMin, &meshMax);
+		BoundsUnion(&sceneMin, &sceneMax, meshMin, meshMax);
+
+		const float tolerance = 1e-4f * (std::abs(xforms[i].translationAndScale.x) + std::abs(xforms[i].translationAndScale.y) + std::abs(xforms[i].translationAndScale.z) +
+										 (meshMax.x - meshMin.x) + (meshMax.y - meshMin.y) + (meshMax.z - meshMin.z));
+		VERIFY(meshMin.x >= root.boundsMin.x - tolerance && meshMin.y >= root.boundsMin.y - tolerance && meshMin.z >= root.boundsMin.z - tolerance &&
+			   meshMax.x <= root.boundsMax.x + tolerance && meshMax.y <= root.boundsMax.y + tolerance && meshMax.z <= root.boundsMax.z + tolerance,
+			   "%s: instance %u pokes out of the TLAS root", label, i);
+	}
+
+	if (sceneMin.x > sceneMax.x)
+	{
+		TwoLevelAS::Ray ray = { float4(0.0f, 0.0f, -1.0f, 0.0f), float4(0.0f, 0.0f, 1.0f, 0.0f), 0.0f, INFINITY };
+		TwoLevelAS::Hit hit;
+		VERIFY(!as.ClosestHit(ray, &hit) && hit.tri == TwoLevelAS::invalidNdx && hit.instance == TwoLevelAS::invalidNdx && !as.AnyHit(ray),
+			   "%s: an empty scene reported a hit", label);
+		printf("%s: checked empty-scene queries\n", label);
+		return numFailures;
+	}
+
+	// Rays from around the scene towards points inside it
+	std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+	const float extent = std::max({ sceneMax.x - sceneMin.x, sceneMax.y - sceneMin.y, sceneMax.z - sceneMin.z });
+	auto pointIn = [&](float margin)
+	{
+		return float4(sceneMin.x - margin + unit(rng) * (sceneMax.x - sceneMin.x + 2.0f * margin),
+					  sceneMin.y - margin + unit(rng) * (sceneMax.y - sceneMin.y + 2.0f * margin),
+					  sceneMin.z - margin + unit(rng) * (sceneMax.z - sceneMin.z + 2.0f * margin), 0.0f);
+	};
+
+	uint32_t numHits = 0;
+	for (uint32_t r = 0; r < numRays; r++)
+	{
+		TwoLevelAS::Ray ray;
+		ray.origin = pointIn(extent * 0.5f);
+		const float4 target = pointIn(0.0f);
+		ray.dir = float4(target.x - ray.origin.x, target.y - ray.origin.y, target.z - ray.origin.z, 0.0f);
+		ray.tMin = 0.0f;
+		ray.tMax = (rng() % 4 == 0) ? 0.5f : INFINITY;
+
+		float refT;
+		const bool refHit = BruteForceClosest(as, meshes, instanceMeshes, ray, &refT);
+
+		TwoLevelAS::Hit hit;
+		const bool hasHit = as.ClosestHit(ray, &hit);
+		VERIFY(hasHit == refHit, "%s: ray %u closest-hit %s, brute force %s", label, r, hasHit ? "hit" : "missed", refHit ? "hit" : "missed");
+		VERIFY(as.AnyHit(ray) == refHit, "%s: ray %u any-hit disagrees with brute force", label, r);
+		if (!hasHit || !refHit)
+		{
+			continue;
+		}
+		VERIFY(hit.t == refT, "%s: ray %u hit at t = %f, brute force found t = %f", label, r, hit.t, refT);
+
+		// The reported instance/triangle should reproduce the hit, and land where the world-space ray does
+		const InstancedTestMesh& mesh = *meshes[instanceMeshes[hit.instance]];
+		const IndexedTriangle& tri = mesh.tris[hit.tri];
+		const float4 &v0 = mesh.positions[tri.xyz.x], &v1 = mesh.positions[tri.xyz.y], &v2 = mesh.positions[tri.xyz.z];
+		const TwoLevelAS::Ray local = as.ToObjectSpace(ray, hit.instance);
+		float t, u, v;
+		VERIFY(RayTriangle(PrecomputeRay(local.origin, local.dir), v0, v1, v2, ray.tMin, ray.tMax, &t, &u, &v) && t == hit.t && u == hit.u && v == hit.v,
+			   "%s: ray %u reported instance %u/triangle %u doesn't reproduce its hit", label, r, hit.instance, hit.tri);
+
+		const float4 objectPoint = float4(v0.x + u * (v1.x - v0.x) + v * (v2.x - v0.x), v0.y + u * (v1.y - v0.y) + v * (v2.y - v0.y),
+										  v0.z + u * (v1.z - v0.z) + v * (v2.z - v0.z), 0.0f);
+		float4 worldPoint, unused;
+		TransformedVertexBounds(&objectPoint, 1, sizeof(float4), xforms[hit.instance], &worldPoint, &unused);
+		const float dx = worldPoint.x - (ray.origin.x + hit.t * ray.dir.x), dy = worldPoint.y - (ray.origin.y + hit.t * ray.dir.y),
+					dz = worldPoint.z - (ray.origin.z + hit.t * ray.dir.z);
+		VERIFY(std::sqrt(dx * dx + dy * dy + dz * dz) <= extent * 1e-4f, "%s: ray %u hit point is %f away from the world-space ray", label, r,
+			   std::sqrt(dx * dx + dy * dy + dz * dz));
+		numHits++;
+	}
+	printf("%s: checked %u rays against brute force (%u hits)\n", label, numRays, numHits);
+	return numFailures;
+}
+
+bool TwoLevelASVerification()
+{
+	uint32_t numFailures = 0;
+	std::mt19937 rng(2024);
+
+	// Small meshes (including an empty one), under many overlapping instances; instances are then moved + reshuffled, as they would be
+	// between frames
+	{
+		const InstancedTestMesh soup = TriangleSoup(200, 1.0f, rng), shards = TriangleSoup(12, 0.5f, rng), empty;
+		const std::vector<const InstancedTestMesh*> meshes = { &soup, &shards, &empty };
+
+		TwoLevelAS as;
+		as.Init(600);
+		for (const InstancedTestMesh* mesh : meshes)
+		{
+			as.AddMesh(mesh->positions.data(), mesh->positions.size(), sizeof(float4), mesh->tris.data(), static_cast<uint32_t>(mesh->tris.size()), BVH::BinnedSAHSettings());
+		}
+
+		numFailures += VerifyInstances("no instances", as, meshes, {}, {}, 1024, rng);
+		numFailures += VerifyInstances("one empty instance", as, meshes, RandomPlacements(1, 1.0f, 1.0f, 1.0f, rng), { 2 }, 1024, rng);
+		numFailures += VerifyInstances("one instance", as, meshes, { IdentityTransform() }, { 0 }, 1024, rng);
+
+		std::vector<uint32_t> instanceMeshes(600);
+		for (uint32_t& m : instanceMeshes)
+		{
+			m = rng() % 3;
+		}
+		numFailures += VerifyInstances("600 small instances", as, meshes, RandomPlacements(600, 20.0f, 0.25f, 2.0f, rng), instanceMeshes, 1024, rng);
+
+		std::shuffle(instanceMeshes.begin(), instanceMeshes.end(), rng);
+		numFailures += VerifyInstances("600 small instances, moved", as, meshes, RandomPlacements(600, 10.0f, 0.5f, 4.0f, rng), instanceMeshes, 1024, rng);
+
+		// Stacked instances share a TLAS box
+		numFailures += VerifyInstances("stacked instances", as, meshes, std::vector<transform>(50, IdentityTransform()), std::vector<uint32_t>(50, 0), 1024, rng);
+
+		const TwoLevelAS::Stats stats = as.GetStats();
+		VERIFY(stats.numMeshes == 3 && stats.numInstances == 50 && stats.numInstancedTris == 50 * 200, "stats don't match the last instances");
+		as.DeInit();
+	}
+
+	// Real geometry
+	{
+		SceneBuffers buffers;
+		buffers.Init(64 * 1024, 128 * 1024, 1);
+		if (LoadTestObj("../Models/stanford-bunny.obj", buffers))
+		{
+			InstancedTestMesh bunny;
+			const GeoTypes::Vertex3D* vts = reinterpret_cast<const GeoTypes::Vertex3D*>(&buffers.BufferContents(SceneBuffers::VBUFFER)[0]);
+			const IndexedTriangle* tris = reinterpret_cast<const IndexedTriangle*>(&buffers.BufferContents(SceneBuffers::TRIBUFFER)[0]);
+			for (uint64_t i = 0; i < buffers.NumVerts(); i++)
+			{
+				bunny.positions.push_back(vts[i].pos);
+			}
+			bunny.tris.assign(tris, tris + buffers.NumTris());
+
+			// Brute force gets expensive here, so fewer instances + rays
+			TwoLevelAS as;
+			as.Init(8);
+			as.AddMesh(bunny.positions.data(), bunny.positions.size(), sizeof(float4), bunny.tris.data(), static_cast<uint32_t>(bunny.tris.size()), BVH::BinnedSAHSettings());
+			numFailures += VerifyInstances("8 bunnies", as, { &bunny }, RandomPlacements(8, 0.3f, 0.5f, 2.0f, rng), std::vector<uint32_t>(8, 0), 256, rng);
+			as.DeInit();
+		}
+		else
+		{
+			printf("couldn't load stanford-bunny.obj, skipped\n");
+		}
+		buffers.DeInit();
+	}
+
+	return numFailures == 0;
+}
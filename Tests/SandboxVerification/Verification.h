@@ -0,0 +1,36 @@
+#pragma once
+
+#include <stdio.h>
+
+// CPU-side correctness tests for scene/AS/tracing code
+// Each test prints what it checked and returns false on failure; SandboxVerification.cpp runs all of them (or just the ones named on
+// the command line) and exits non-zero if any failed
+
+bool ASReportVerification();
+bool BoundsVerification();
+bool BVHVerification();
+bool BxDFVerification();
+bool EmitterTableVerification();
+bool IntersectionSIMDVerification();
+bool PacketBVHVerification();
+bool RouletteVerification();
+bool SceneBuffersVerification();
+bool SceneQueryVerification();
+bool SparseOctreeVerification();
+bool StacklessBVHVerification();
+bool TileSchedulerVerification();
+bool TwoLevelASVerification();
+bool WideBVHVerification();
+
+// Report + count failed conditions without bailing out, so one run shows every broken case
+#define VERIFY(cond, ...) \
+	do \
+	{ \
+		if (!(cond)) \
+		{ \
+			printf("FAILED (%s:%d): ", __FILE__, __LINE__); \
+			printf(__VA_ARGS__); \
+			printf("\n"); \
+			numFailures++; \
+		} \
+	} while (0)
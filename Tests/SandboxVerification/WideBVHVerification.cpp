@@ -0,0 +1,375 @@
+#include "Verification.h"
+#include "../TestScenes.h"
+#include "../../SandboxApp/WideBVH.h"
+#include "../../SandboxApp/Intersection.h"
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <cstring>
+#include <random>
+#include <vector>
+
+struct WideTestMesh
+{
+	std::vector<float4> positions;
+	std::vector<IndexedTriangle> tris;
+};
+
+static WideTestMesh WideTriangleSoup(uint32_t numTris, float size, std::mt19937& rng)
+{
+	std::uniform_real_distribution<float> centerDist(-size, size), offsetDist(-0.05f * size, 0.05f * size);
+	WideTestMesh mesh;
+	for (uint32_t i = 0; i < numTris; i++)
+	{
+		const float cx = centerDist(rng), cy = centerDist(rng), cz = centerDist(rng);
+		IndexedTriangle tri;
+		tri.xyz = uint4(i * 3, i * 3 + 1, i * 3 + 2, 0);
+		mesh.tris.push_back(tri);
+		for (uint32_t k = 0; k < 3; k++)
+		{
+			mesh.positions.push_back(float4(cx + offsetDist(rng), cy + offsetDist(rng), cz + offsetDist(rng), 0.0f));
+		}
+	}
+	return mesh;
+}
+
+// Walks the subtree under [nodeNdx], counting every listed triangle and checking each slot's decoded box against the triangles beneath
+// it; returns the subtree's tight triangle bounds through [outMin]/[outMax]
+// Leaves of spatial-split trees only bound their triangles' pieces ([clipped]), so their boxes are only checked against brute-force rays
+static void VerifyWideNode(const char* label, const WideBVH& bvh, const WideTestMesh& mesh, uint32_t nodeNdx, uint32_t depth, bool clipped,
+						   std::vector<uint32_t>& listedCounts, float* outMin, float* outMax, uint32_t& numFailures)
+{
+	for (uint32_t a = 0; a < 3; a++)
+	{
+		outMin[a] = INFINITY;
+		outMax[a] = -INFINITY;
+	}
+
+	VERIFY(nodeNdx < bvh.NumNodes() && depth <= bvh.GetStats().depth, "%s: node %u is out of range (or deeper than reported)", label, nodeNdx);
+	if (nodeNdx >= bvh.NumNodes() || depth > bvh.GetStats().depth)
+	{
+		return;
+	}
+
+	const ComputeWideBVH_Node node = bvh.Nodes()[nodeNdx];
+	const uint8_t* meta = reinterpret_cast<const uint8_t*>(node.meta);
+	const uint32_t imask = node.exponentsAndImask >> 24;
+	for (uint32_t slot = 0; slot < WideBVH::width; slot++)
+	{
+		if (meta[slot] == 0)
+		{
+			VERIFY(!(imask & (1u << slot)), "%s: node %u flags empty slot %u as internal", label, nodeNdx, slot);
+			continue;
+		}
+
+		float childMin[3], childMax[3];
+		if (imask & (1u << slot))
+		{
+			VERIFY(meta[slot] == ((1u << 5) | (24 + slot)), "%s: node %u slot %u is internal, but its meta byte is %u", label, nodeNdx, slot, meta[slot]);
+			const uint32_t childNdx = node.childBase + static_cast<uint32_t>(std::popcount(imask & ((1u << slot) - 1)));
+			VERIFY(childNdx > nodeNdx, "%s: node %u's slot %u points backwards", label, nodeNdx, slot);
+			if (childNdx <= nodeNdx)
+			{
+				continue;
+			}
+			VerifyWideNode(label, bvh, mesh, childNdx, depth + 1, clipped, listedCounts, childMin, childMax, numFailures);
+		}
+		else
+		{
+			const uint32_t unary = meta[slot] >> 5;
+			VERIFY(unary == 1 || unary == 3 || unary == 7, "%s: node %u slot %u has a malformed triangle count (%u)", label, nodeNdx, slot, unary);
+			for (uint32_t a = 0; a < 3; a++)
+			{
+				childMin[a] = INFINITY;
+				childMax[a] = -INFINITY;
+			}
+
+			const uint32_t first = node.triBase + (meta[slot] & 0x1f);
+			for (uint32_t i = first; i < first + std::popcount(unary); i++)
+			{
+				VERIFY(i < bvh.TriListLen(), "%s: node %u slot %u runs off the triangle list", label, nodeNdx, slot);
+				if (i >= bvh.TriListLen())
+				{
+					break;
+				}
+
+				const uint32_t tri = bvh.TriList()[i];
+				listedCounts[tri]++;
+				const uint32_t ndx[3] = { mesh.tris[tri].xyz.x, mesh.tris[tri].xyz.y, mesh.tris[tri].xyz.z };
+				for (uint32_t k = 0; k < 3; k++)
+				{
+					const float p[3] = { mesh.positions[ndx[k]].x, mesh.positions[ndx[k]].y, mesh.positions[ndx[k]].z };
+					for (uint32_t a = 0; a < 3; a++)
+					{
+						childMin[a] = std::min(childMin[a], p[a]);
+						childMax[a] = std::max(childMax[a], p[a]);
+					}
+				}
+			}
+		}
+
+		float decodedMin[3], decodedMax[3];
+		WideBVH::ChildBounds(node, slot, decodedMin, decodedMax);
+		VERIFY(clipped || (decodedMin[0] <= childMin[0] && decodedMin[1] <= childMin[1] && decodedMin[2] <= childMin[2] && decodedMax[0] >= childMax[0] &&
+			   decodedMax[1] >= childMax[1] && decodedMax[2] >= childMax[2]), "%s: node %u slot %u's decoded box doesn't hold its triangles", label, nodeNdx, slot);
+		for (uint32_t a = 0; a < 3; a++)
+		{
+			outMin[a] = std::min(outMin[a], childMin[a]);
+			outMax[a] = std::max(outMax[a], childMax[a]);
+		}
+	}
+}
+
+static bool WideBruteForceClosest(const WideTestMesh& mesh, const WideBVH::Ray& ray, float* outT)
+{
+	const RayPrecomp rp = PrecomputeRay(ray.origin, ray.dir);
+	float tMax = ray.tMax;
+	bool found = false;
+	for (const IndexedTriangle& tri : mesh.tris)
+	{
+		float t, u, v;
+		if (RayTriangle(rp, mesh.positions[tri.xyz.x], mesh.positions[tri.xyz.y], mesh.positions[tri.xyz.z], ray.tMin, tMax, &t, &u, &v) && (!found || t < tMax))
+		{
+			tMax = t;
+			found = true;
+		}
+	}
+	*outT = tMax;
+	return found;
+}
+
+// Converts [bvh] (relaid out with [layout], if given), then checks the wide tree's structure and its hits against brute force
+static uint32_t VerifyWideBVH(const char* label, const BVH& bvh, const WideTestMesh& mesh, uint32_t numRays, std::mt19937& rng, bool clipped = false,
+							  const WideBVH::LayoutSettings* layout = nullptr)
+{
+	uint32_t numFailures = 0;
+	WideBVH wide;
+	wide.Build(bvh, mesh.positions.data(), mesh.positions.size(), sizeof(float4), mesh.tris.data());
+	if (layout != nullptr)
+	{
+		const uint32_t builtNodes = wide.NumNodes();
+		wide.Relayout(*layout);
+		VERIFY(wide.NumNodes() == builtNodes && wide.Nodes().arrayLen == builtNodes, "%s: relayout changed the node count", label);
+
+		// Reordered triangles mirror the triangle list
+		bool leafTrisMatch = !layout->reorderTris || mesh.tris.empty() || wide.LeafTris().arrayLen == wide.TriListLen();
+		for (uint32_t i = 0; i < wide.LeafTris().arrayLen && leafTrisMatch; i++)
+		{
+			leafTrisMatch = (memcmp(&wide.LeafTris()[i], &mesh.tris[wide.TriList()[i]], sizeof(IndexedTriangle)) == 0);
+		}
+		VERIFY(leafTrisMatch, "%s: reordered triangles don't follow the triangle list", label);
+	}
+	const WideBVH::Stats& stats = wide.GetStats();
+	VERIFY(wide.NumTris() == mesh.tris.size() && stats.numNodes >= 1 && stats.nodeBytes == stats.numNodes * sizeof(ComputeWideBVH_Node),
+		   "%s: unexpected node/triangle counts", label);
+
+	float sceneMin[3] = { INFINITY, INFINITY, INFINITY }, sceneMax[3] = { -INFINITY, -INFINITY, -INFINITY };
+	if (!mesh.tris.empty())
+	{
+		std::vector<uint32_t> listedCounts(mesh.tris.size(), 0);
+		VerifyWideNode(label, wide, mesh, 0, 0, clipped, listedCounts, sceneMin, sceneMax, numFailures);
+		VERIFY(wide.TriListLen() == bvh.TriListLen() && std::all_of(listedCounts.begin(), listedCounts.end(), [&](uint32_t c) { return c == 1 || (clipped && c > 1); }),
+			   "%s: triangles aren't all listed exactly once", label);
+		VERIFY(stats.meanChildren >= 2.0f || stats.numNodes == 1, "%s: only %.2f children per node", label, stats.meanChildren);
+	}
+	else
+	{
+		WideBVH::Ray ray = { float4(0.0f, 0.0f, -1.0f, 0.0f), float4(0.0f, 0.0f, 1.0f, 0.0f), 0.0f, INFINITY };
+		WideBVH::Hit hit;
+		VERIFY(!wide.ClosestHit(ray, &hit) && hit.tri == WideBVH::invalidTri && !wide.AnyHit(ray), "%s: an empty tree reported a hit", label);
+		printf("%s: checked an empty tree\n", label);
+		wide.DeInit();
+		return numFailures;
+	}
+
+	// Rays from around the mesh towards points inside it
+	std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+	const float extent = std::max({ sceneMax[0] - sceneMin[0], sceneMax[1] - sceneMin[1], sceneMax[2] - sceneMin[2], 1e-3f });
+	auto pointIn = [&](float margin)
+	{
+		return float4(sceneMin[0] - margin + unit(rng) * (sceneMax[0] - sceneMin[0] + 2.0f * margin),
+					  sceneMin[1] - margin + unit(rng) * (sceneMax[1] - sceneMin[1] + 2.0f * margin),
+					  sceneMin[2] - margin + unit(rng) * (sceneMax[2] - sceneMin[2] + 2.0f * margin), 0.0f);
+	};
+
+	uint32_t numHits = 0;
+	for (uint32_t r = 0; r < numRays; r++)
+	{
+		WideBVH::Ray ray;
+		ray.origin = pointIn(extent * 0.5f);
+		const float4 target = pointIn(0.0f);
+		ray.dir = float4(target.x - ray.origin.x, target.y - ray.origin.y, target.z - ray.origin.z, 0.0f);
+		ray.tMin = 0.0f;
+		ray.tMax = (rng() % 4 == 0) ? 0.5f : INFINITY;
+
+		float refT;
+		const bool refHit = WideBruteForceClosest(mesh, ray, &refT);
+
+		WideBVH::Hit hit;
+		const bool hasHit = wide.ClosestHit(ray, &hit);
+		VERIFY(hasHit == refHit, "%s: ray %u closest-hit %s, brute force %s", label, r, hasHit ? "hit" : "missed", refHit ? "hit" : "missed");
+		VERIFY(wide.AnyHit(ray) == refHit, "%s: ray %u any-hit disagrees with brute force", label, r);
+		if (!hasHit || !refHit)
+		{
+			continue;
+		}
+		VERIFY(hit.t == refT, "%s: ray %u hit at t = %f, brute force found t = %f", label, r, hit.t, refT);
+
+		// The reported triangle should reproduce the hit
+		const IndexedTriangle& tri = mesh.tris[hit.tri];
+		float t, u, v;
+		VERIFY(RayTriangle(PrecomputeRay(ray.origin, ray.dir), mesh.positions[tri.xyz.x], mesh.positions[tri.xyz.y], mesh.positions[tri.xyz.z], ray.tMin, ray.tMax, &t, &u, &v) &&
+			   t == hit.t && u == hit.u && v == hit.v, "%s: ray %u reported triangle %u doesn't reproduce its hit", label, r, hit.tri);
+		numHits++;
+	}
+	printf("%s: %u nodes (%.2f children each, depth %u), checked %u rays against brute force (%u hits)\n", label, stats.numNodes, stats.meanChildren, stats.depth,
+		   numRays, numHits);
+
+	wide.DeInit();
+	return numFailures;
+}
+
+bool WideBVHVerification()
+{
+	uint32_t numFailures = 0;
+	std::mt19937 rng(808);
+
+	BVH::BinnedSAHSettings sahSettings;
+	sahSettings.numThreads = 1;
+
+	// Degenerate inputs
+	{
+		const WideTestMesh empty, single = WideTriangleSoup(1, 1.0f, rng);
+		BVH bvh;
+		bvh.BuildBinnedSAH(empty.positions.data(), 0, sizeof(float4), empty.tris.data(), 0, sahSettings);
+		numFailures += VerifyWideBVH("empty", bvh, empty, 0, rng);
+		bvh.DeInit();
+
+		bvh.BuildBinnedSAH(single.positions.data(), single.positions.size(), sizeof(float4), single.tris.data(), 1, sahSettings);
+		numFailures += VerifyWideBVH("one triangle", bvh, single, 256, rng);
+		bvh.DeInit();
+
+		// Identical triangles can't be separated, so every split is a median split over one shared box
+		WideTestMesh stacked = WideTriangleSoup(1, 1.0f, rng);
+		for (uint32_t i = 1; i < 100; i++)
+		{
+			IndexedTriangle tri = stacked.tris[0];
+			stacked.tris.push_back(tri);
+		}
+		bvh.BuildBinnedSAH(stacked.positions.data(), stacked.positions.size(), sizeof(float4), stacked.tris.data(), 100, sahSettings);
+		numFailures += VerifyWideBVH("stacked triangles", bvh, stacked, 256, rng);
+		bvh.DeInit();
+	}
+
+	// Soups under binary leaves of various sizes (larger ones have to be split during conversion), from both builders; a wide spread
+	// of scales stresses quantisation
+	{
+		const WideTestMesh soup = WideTriangleSoup(3000, 1.0f, rng), farSoup = WideTriangleSoup(500, 4096.0f, rng);
+		const uint32_t leafSizes[] = { 1, 4, 16 };
+		for (uint32_t leafSize : leafSizes)
+		{
+			char label[64];
+			BVH::BinnedSAHSettings settings = sahSettings;
+			settings.leafTris = leafSize;
+			settings.maxLeafTris = leafSize;
+			BVH bvh;
+			bvh.BuildBinnedSAH(soup.positions.data(), soup.positions.size(), sizeof(float4), soup.tris.data(), static_cast<uint32_t>(soup.tris.size()), settings);
+			snprintf(label, sizeof(label), "soup, binned SAH, %u-triangle leaves", leafSize);
+			numFailures += VerifyWideBVH(label, bvh, soup, 1024, rng);
+			bvh.DeInit();
+		}
+
+		BVH::LBVHSettings lbvhSettings;
+		lbvhSettings.treeletSize = 7;
+		lbvhSettings.numThreads = 1;
+		BVH bvh;
+		bvh.BuildLBVH(soup.positions.data(), soup.positions.size(), sizeof(float4), soup.tris.data(), static_cast<uint32_t>(soup.tris.size()), lbvhSettings);
+		numFailures += VerifyWideBVH("soup, LBVH", bvh, soup, 1024, rng);
+		bvh.DeInit();
+
+		// Spatial splits leave leaves bounding pieces of triangles, listed more than once
+		BVH::BinnedSAHSettings spatialSettings = sahSettings;
+		spatialSettings.spatialSplits = true;
+		spatialSettings.splitBudget = 1.0f;
+		bvh.BuildBinnedSAH(soup.positions.data(), soup.positions.size(), sizeof(float4), soup.tris.data(), static_cast<uint32_t>(soup.tris.size()), spatialSettings);
+		numFailures += VerifyWideBVH("soup, spatial splits", bvh, soup, 1024, rng, true);
+		bvh.DeInit();
+
+		WideTestMesh building;
+		BuildArchitecturalScene(2, 3, 4, building.positions, building.tris);
+		bvh.BuildBinnedSAH(building.positions.data(), building.positions.size(), sizeof(float4), building.tris.data(), static_cast<uint32_t>(building.tris.size()),
+						   spatialSettings);
+		numFailures += VerifyWideBVH("building, spatial splits", bvh, building, 1024, rng, true);
+		bvh.DeInit();
+
+		bvh.BuildBinnedSAH(farSoup.positions.data(), farSoup.positions.size(), sizeof(float4), farSoup.tris.data(), static_cast<uint32_t>(farSoup.tris.size()), sahSettings);
+		numFailures += VerifyWideBVH("large-scale soup", bvh, farSoup, 1024, rng);
+		bvh.DeInit();
+	}
+
+	// Every layout keeps the tree's structure and hits; hit-frequency layouts sample rays through the soup first
+	{
+		const WideTestMesh soup = WideTriangleSoup(3000, 1.0f, rng);
+		std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+		std::vector<WideBVH::Ray> samples(512);
+		for (WideBVH::Ray& ray : samples)
+		{
+			ray.origin = float4(unit(rng) * 2.0f, unit(rng) * 2.0f, -3.0f, 0.0f);
+			ray.dir = float4(unit(rng) * 0.5f, unit(rng) * 0.5f, 1.0f, 0.0f);
+			ray.tMin = 0.0f;
+			ray.tMax = INFINITY;
+		}
+
+		BVH::BinnedSAHSettings settings = sahSettings;
+		settings.leafTris = 4;
+		BVH bvh;
+		bvh.BuildBinnedSAH(soup.positions.data(), soup.positions.size(), sizeof(float4), soup.tris.data(), static_cast<uint32_t>(soup.tris.size()), settings);
+
+		const WideBVH::Layout layouts[] = { WideBVH::Layout::BreadthFirst, WideBVH::Layout::DepthFirst, WideBVH::Layout::Treelets, WideBVH::Layout::HitFrequency };
+		const char* layoutNames[] = { "breadth-first", "depth-first", "treelets", "hit frequency" };
+		for (uint32_t i = 0; i < 4; i++)
+		{
+			WideBVH::LayoutSettings layout;
+			layout.layout = layouts[i];
+			layout.treeletBytes = 1024; // Small clusters, so the soup spans plenty of them
+			layout.sampleRays = samples.data();
+			layout.numSampleRays = static_cast<uint32_t>(samples.size());
+			layout.reorderTris = (i % 2 == 0);
+
+			char label[64];
+			snprintf(label, sizeof(label), "soup, %s layout", layoutNames[i]);
+			numFailures += VerifyWideBVH(label, bvh, soup, 1024, rng, false, &layout);
+		}
+		bvh.DeInit();
+	}
+
+	// Real geometry
+	{
+		SceneBuffers buffers;
+		buffers.Init(64 * 1024, 128 * 1024, 1);
+		if (LoadTestObj("../Models/stanford-bunny.obj", buffers))
+		{
+			WideTestMesh bunny;
+			const GeoTypes::Vertex3D* vts = reinterpret_cast<const GeoTypes::Vertex3D*>(&buffers.BufferContents(SceneBuffers::VBUFFER)[0]);
+			const IndexedTriangle* tris = reinterpret_cast<const IndexedTriangle*>(&buffers.BufferContents(SceneBuffers::TRIBUFFER)[0]);
+			for (uint64_t i = 0; i < buffers.NumVerts(); i++)
+			{
+				bunny.positions.push_back(vts[i].pos);
+			}
+			bunny.tris.assign(tris, tris + buffers.NumTris());
+
+			BVH bvh;
+			bvh.BuildBinnedSAH(bunny.positions.data(), bunny.positions.size(), sizeof(float4), bunny.tris.data(), static_cast<uint32_t>(bunny.tris.size()), sahSettings);
+			numFailures += VerifyWideBVH("bunny", bvh, bunny, 256, rng);
+			bvh.DeInit();
+		}
+		else
+		{
+			printf("couldn't load stanford-bunny.obj, skipped\n");
+		}
+		buffers.DeInit();
+	}
+
+	return numFailures == 0;
+}
@@ -0,0 +1,160 @@
+#pragma once
+
+#include <cmath>
+#include <fstream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "../SandboxApp/SceneBuffers.h"
+#include "../SandboxApp/SceneGraph.h"
+
+// Test/benchmark scene setup, shared between the CPU-side test projects
+// Tests read OBJ geometry themselves rather than through GeoLoader, so they only see positions + faces (faces are fan-triangulated)
+
+// Append [path] to [buffers] as one model with a uniform material; returns false if the file couldn't be opened
+inline bool LoadTestObj(const char* path, SceneBuffers& buffers)
+{
+	std::ifstream obj(path);
+	if (!obj.is_open())
+	{
+		return false;
+	}
+
+	auto vts = buffers.FreeVertices();
+	uint64_t numVerts = 0;
+	std::vector<uint64_t> ndces;
+
+	std::string line;
+	while (std::getline(obj, line))
+	{
+		if (line.size() > 2 && line[0] == 'v' && line[1] == ' ')
+		{
+			float x, y, z;
+			if (sscanf(line.c_str() + 2, "%f %f %f", &x, &y, &z) == 3)
+			{
+				vts[numVerts] = {};
+				vts[numVerts].pos = float4(x, y, z, 0.0f);
+				numVerts++;
+			}
+		}
+		else if (line.size() > 2 && line[0] == 'f' && line[1] == ' ')
+		{
+			// Vertex indices are the first number in each "v", "v/vt", "v//vn" or "v/vt/vn" group
+			uint64_t face[64];
+			uint32_t numFaceVerts = 0;
+			const char* c = line.c_str() + 2;
+			while (*c != '\0' && numFaceVerts < 64)
+			{
+				char* end = nullptr;
+				const long ndx = strtol(c, &end, 10);
+				if (end == c)
+				{
+					c++;
+					continue;
+				}
+
+				face[numFaceVerts++] = buffers.NumVerts() + ((ndx > 0) ? (ndx - 1) : (numVerts + ndx));
+				c = end;
+				while (*c != '\0' && *c != ' ')
+				{
+					c++;
+				}
+			}
+
+			for (uint32_t i = 2; i < numFaceVerts; i++)
+			{
+				ndces.push_back(face[0]);
+				ndces.push_back(face[i - 1]);
+				ndces.push_back(face[i]);
+			}
+		}
+	}
+
+	Material material = {};
+	material.isUniform = true;
+	buffers.AddModel(numVerts, ndces.data(), ndces.size(), material);
+	return true;
+}
+
+// [transform] value-initializes to zero scale, so tests start from this instead
+inline transform IdentityTransform()
+{
+	transform xform;
+	xform.translationAndScale = float4(0.0f, 0.0f, 0.0f, 1.0f);
+	xform.rotation = float4(0.0f, 0.0f, 0.0f, 1.0f);
+	return xform;
+}
+
+// Scene graph with one root node per model in [buffers], all placed at [xform]
+inline void BuildTestGraph(const SceneBuffers& buffers, SceneGraph& graph, transform xform)
+{
+	graph.Init(buffers.NumModels(), 1);
+	graph.AddMesh(float4(-1.0f, -1.0f, -1.0f, 0.0f), float4(1.0f, 1.0f, 1.0f, 0.0f));
+	for (uint32_t i = 0; i < buffers.NumModels(); i++)
+	{
+		graph.AddNode(SceneGraph::invalidNdx, xform, 0);
+	}
+	graph.Update();
+}
+
+// Procedural building: [storeys] floors of [roomsPerSide]^2 rooms (4x3x4 units each), with every floor slab and every wall line a
+// single building-spanning quad, plus [clutterPerRoom] small boxes per room; all turned 30 degrees about y, so the long triangles'
+// bounds overlap most of the scene (the worst case for object-split BVHs)
+inline void BuildArchitecturalScene(uint32_t storeys, uint32_t roomsPerSide, uint32_t clutterPerRoom, std::vector<float4>& outPositions,
+									std::vector<IndexedTriangle>& outTris)
+{
+	constexpr float roomWidth = 4.0f, roomHeight = 3.0f;
+	const float turnSin = std::sin(0.5235988f), turnCos = std::cos(0.5235988f);
+	auto addQuad = [&](float4 a, float4 b, float4 c, float4 d)
+	{
+		const uint32_t base = static_cast<uint32_t>(outPositions.size());
+		for (const float4& p : { a, b, c, d })
+		{
+			outPositions.push_back(float4(p.x * turnCos - p.z * turnSin, p.y, p.x * turnSin + p.z * turnCos, 0.0f));
+		}
+		IndexedTriangle tri;
+		tri.xyz = uint4(base, base + 1, base + 2, 0);
+		outTris.push_back(tri);
+		tri.xyz = uint4(base, base + 2, base + 3, 0);
+		outTris.push_back(tri);
+	};
+
+	const float span = roomWidth * roomsPerSide, top = roomHeight * storeys;
+	for (uint32_t i = 0; i <= storeys; i++)
+	{
+		const float y = roomHeight * i;
+		addQuad(float4(0.0f, y, 0.0f, 0.0f), float4(span, y, 0.0f, 0.0f), float4(span, y, span, 0.0f), float4(0.0f, y, span, 0.0f));
+	}
+
+	for (uint32_t i = 0; i <= roomsPerSide; i++)
+	{
+		const float w = roomWidth * i;
+		addQuad(float4(w, 0.0f, 0.0f, 0.0f), float4(w, top, 0.0f, 0.0f), float4(w, top, span, 0.0f), float4(w, 0.0f, span, 0.0f));
+		addQuad(float4(0.0f, 0.0f, w, 0.0f), float4(span, 0.0f, w, 0.0f), float4(span, top, w, 0.0f), float4(0.0f, top, w, 0.0f));
+	}
+
+	std::mt19937 rng(1929);
+	std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+	for (uint32_t s = 0; s < storeys; s++)
+	{
+		for (uint32_t rz = 0; rz < roomsPerSide; rz++)
+		{
+			for (uint32_t rx = 0; rx < roomsPerSide; rx++)
+			{
+				for (uint32_t i = 0; i < clutterPerRoom; i++)
+				{
+					const float size = 0.1f + 0.4f * unit(rng);
+					const float x0 = roomWidth * rx + 0.1f + (roomWidth - size - 0.2f) * unit(rng), x1 = x0 + size;
+					const float z0 = roomWidth * rz + 0.1f + (roomWidth - size - 0.2f) * unit(rng), z1 = z0 + size;
+					const float y0 = roomHeight * s, y1 = y0 + size * (0.5f + unit(rng));
+					addQuad(float4(x0, y0, z0, 0.0f), float4(x1, y0, z0, 0.0f), float4(x1, y1, z0, 0.0f), float4(x0, y1, z0, 0.0f));
+					addQuad(float4(x0, y0, z1, 0.0f), float4(x0, y1, z1, 0.0f), float4(x1, y1, z1, 0.0f), float4(x1, y0, z1, 0.0f));
+					addQuad(float4(x0, y0, z0, 0.0f), float4(x0, y1, z0, 0.0f), float4(x0, y1, z1, 0.0f), float4(x0, y0, z1, 0.0f));
+					addQuad(float4(x1, y0, z0, 0.0f), float4(x1, y0, z1, 0.0f), float4(x1, y1, z1, 0.0f), float4(x1, y1, z0, 0.0f));
+					addQuad(float4(x0, y1, z0, 0.0f), float4(x1, y1, z0, 0.0f), float4(x1, y1, z1, 0.0f), float4(x0, y1, z1, 0.0f));
+				}
+			}
+		}
+	}
+}
@@ -77,18 +77,7 @@ float ResolveSPDResponse(float sampledSpectrum, SPDRaw spd)
     return lerp(spd.spectra[lo], spd.spectra[hi], t);
 }
 
-// Shading functions supported by DXRSandbox
-// More planned? Maybe! Probably not though, I might look at layering support but otherwise this is a lot already
-#define BXDF_ID_DIFFUSE_LAMBERT 0
-#define BXDF_ID_DIFFUSE_OREN_NAYAR 1
-#define BXDF_ID_DIFFUSE_OREN_NAYAR_MULTISCATTER 2
-#define BXDF_ID_SPECULAR_CLASSICAL_SMOOTH 3
-#define BXDF_ID_SPECULAR_COOK_TORRANCE 4
-#define BXDF_ID_SPECULAR_COOK_TORRANCE_MULTISCATTER 5
-#define BXDF_ID_DIFFUSE_VOLUMETRIC_ORGANIC 6
-#define BXDF_ID_DIFFUSE_VOLUMETRIC_CLOUDY 7
-#define BXDF_ID_DIFFUSE_VOLUMETRIC_ORGANIC_MICROFLAKES 8
-#define BXDF_ID_DIFFUSE_VOLUMETRIC_CLOUDY_MICROFLAKES 9
+// Shading function ids (BXDF_ID_*) live with the BxDFs themselves, in Shaders/SharedBxDFs.hlsli
 
 struct Vertex
 {